@@ -30,6 +30,18 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define DEBUG_PERF 0   /* Debug timing performances: level [0..4] */
 
+#define LGW_BOARD_NB_MAX 4  /* Maximum number of concentrator boards driven by one process */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+/*
+Index of the concentrator board the calling thread is working with (see
+lgw_select). Modules holding per-board state keep one instance of it per board
+and access the current one through a macro using this index.
+*/
+extern __thread uint8_t lgw_board_cur;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
@@ -102,18 +114,24 @@ uint32_t lora_packet_time_on_air( const uint8_t bw,
                                   uint16_t * t_symbol_us);
 
 /**
-@brief Record the current time, for measure start
-@param tm Pointer to the current time value
+@brief Get the time of the host monotonic clock, to timestamp events
+@return the time elapsed since an unspecified point, in nanoseconds
+*/
+int64_t time_monotonic_ns(void);
+
+/**
+@brief Record the current time of the monotonic clock, for measure start
+@param tm Pointer to the current time value in nanoseconds, negative if not measured as profiling is disabled
 */
-void _meas_time_start(struct timeval *tm);
+void _meas_time_start(int64_t *tm);
 
 /**
-@brief Measure the ellapsed time since given time
+@brief Measure the ellapsed time since given time, and record it in the profiling probe of the same name (see loragw_perf)
 @param debug_level  debug print debug level to be used
 @param start_time   start time of the measure to be used
-@param str          string to be used for debug print
+@param str          name of the probe, also used for debug print
 */
-void _meas_time_stop(int debug_level, struct timeval start_time, const char *str);
+void _meas_time_stop(int debug_level, int64_t start_time, const char *str);
 
 /**
 @brief Get the current time for later timeout check
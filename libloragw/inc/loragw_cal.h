@@ -20,12 +20,16 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include <stdint.h>     /* C99 types*/
+#include <stdbool.h>    /* bool type */
 
 #include "config.h"     /* library configuration options (dynamically generated) */
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
+#define CAL_CACHE_TEMP_BAND     10                  /* width of the temperature bands of the calibration cache, in degC */
+#define CAL_CACHE_MAX_AGE_S     (30 * 24 * 3600)    /* cached calibration results older than this are not used */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
@@ -54,6 +58,45 @@ struct lgw_sx125x_cal_tx_result_s {
 
 int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, struct lgw_tx_gain_lut_s * txgain_lut);
 
+/**
+@brief Enable the fast calibration mode, where the sx125x RX image and TX DC offset calibrations
+       stop iterating as soon as two consistent results meet the quality thresholds
+@param enable true for fast mode, false to always run all iterations (default)
+*/
+void sx1302_cal_set_fast_mode(bool enable);
+
+/**
+@brief Set the file in which sx125x calibration results are cached between starts
+@param path path of the cache file, NULL or empty to disable the cache
+@return LGW_HAL_SUCCESS if no error, LGW_HAL_ERROR otherwise
+*/
+int sx1302_cal_cache_set_path(const char * path);
+
+/**
+@brief Get the path of the calibration cache file
+@return the path, NULL if the cache is disabled
+*/
+const char * sx1302_cal_cache_path(void);
+
+/**
+@brief Apply the cached results of a previous calibration done in the same conditions, if any
+@param eui concentrator chip EUI
+@param temperature current board temperature in degC, NULL if unknown
+@param rf_chain_cfg radio configuration, the cache entry must match frequencies and types
+@param txgain_lut TX gain tables, their DC offsets are filled from the cache
+@return LGW_HAL_SUCCESS if results were applied, LGW_HAL_ERROR if a calibration is needed
+*/
+int sx1302_cal_cache_load(uint64_t eui, const float * temperature, struct lgw_conf_rxrf_s * rf_chain_cfg, struct lgw_tx_gain_lut_s * txgain_lut);
+
+/**
+@brief Save the results of the last sx1302_cal_start() to the cache file
+@param eui concentrator chip EUI
+@param temperature board temperature in degC during calibration, NULL if unknown
+@param rf_chain_cfg radio configuration used for calibration
+@return LGW_HAL_SUCCESS if no error, LGW_HAL_ERROR otherwise
+*/
+int sx1302_cal_cache_store(uint64_t eui, const float * temperature, struct lgw_conf_rxrf_s * rf_chain_cfg);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -22,6 +22,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include <stdint.h>   /* C99 types*/
+#include <stdbool.h>  /* bool type */
 
 #include "config.h"   /* library configuration options (dynamically generated) */
 
@@ -35,12 +36,16 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define LGW_SPI_MUX_TARGET_RADIOA   0x01
 #define LGW_SPI_MUX_TARGET_RADIOB   0x02
 
+#define LGW_COM_STATS_LAT_NB        16  /* number of bins of the latency histograms */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC TYPES --------------------------------------------------------- */
 
 typedef enum com_type_e {
     LGW_COM_SPI,
     LGW_COM_USB,
+    LGW_COM_REPLAY,     /* replay of a recorded trace, see loragw_replay.h */
+    LGW_COM_SIM,        /* simulated concentrator, see loragw_sim.h */
     LGW_COM_UNKNOWN
 } lgw_com_type_t;
 
@@ -50,6 +55,63 @@ typedef enum com_write_mode_e {
     LGW_COM_WRITE_MODE_UNKNOWN
 } lgw_com_write_mode_t;
 
+/**
+@struct lgw_com_rb_s
+@brief One burst read of a multiple read request
+*/
+struct lgw_com_rb_s {
+    uint8_t     spi_mux_target; /*!> SX1302, RADIO_A or RADIO_B */
+    uint16_t    address;        /*!> address to read from */
+    uint8_t *   data;           /*!> buffer to hold the data read */
+    uint16_t    size;           /*!> number of bytes to read */
+};
+
+/**
+@enum lgw_com_stats_target_t
+@brief Device addressed by an access, for statistics
+*/
+typedef enum {
+    LGW_COM_STATS_SX1302,
+    LGW_COM_STATS_RADIOA,
+    LGW_COM_STATS_RADIOB,
+    LGW_COM_STATS_SX1261,
+    LGW_COM_STATS_TARGET_NB
+} lgw_com_stats_target_t;
+
+/**
+@enum lgw_com_stats_op_t
+@brief Kind of access, for statistics
+*/
+typedef enum {
+    LGW_COM_STATS_W,
+    LGW_COM_STATS_R,
+    LGW_COM_STATS_RMW,
+    LGW_COM_STATS_WB,
+    LGW_COM_STATS_RB,
+    LGW_COM_STATS_FLUSH,
+    LGW_COM_STATS_OP_NB
+} lgw_com_stats_op_t;
+
+/**
+@struct lgw_com_stats_op_s
+@brief Counters of one kind of access to one device
+*/
+struct lgw_com_stats_op_s {
+    uint32_t    nb_call;                        /*!> number of calls */
+    uint32_t    nb_error;                       /*!> number of calls which failed */
+    uint64_t    nb_byte;                        /*!> number of register/payload bytes moved */
+    uint64_t    time_us;                        /*!> total time spent in the calls, in microseconds */
+    uint32_t    lat_hist[LGW_COM_STATS_LAT_NB]; /*!> latency histogram: bin 0 is < 1us, bin i is [2^(i-1), 2^i[ us, the last bin also counts longer calls */
+};
+
+/**
+@struct lgw_com_stats_s
+@brief Counters of all the accesses done with the communication interface, by backend, device and kind of access
+*/
+struct lgw_com_stats_s {
+    struct lgw_com_stats_op_s op[LGW_COM_UNKNOWN][LGW_COM_STATS_TARGET_NB][LGW_COM_STATS_OP_NB];
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
@@ -63,6 +125,13 @@ int lgw_com_open(lgw_com_type_t com_type, const char *com_path);
 */
 int lgw_com_close(void);
 
+/**
+@brief Open again the link to the concentrator after an error, its state is kept (USB and simulated only)
+@param com_path path of the COM device
+@return LGW_COM_SUCCESS if the link is up again, LGW_COM_ERROR otherwise
+*/
+int lgw_com_reopen(const char * com_path);
+
 /**
  *
 */
@@ -88,6 +157,14 @@ int lgw_com_wb(uint8_t spi_mux_target, uint16_t address, const uint8_t *data, ui
 */
 int lgw_com_rb(uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t size);
 
+/**
+@brief Do several burst reads in a row, in a single transfer when the link supports it (USB)
+@param req array of read requests, their data buffers are filled on success
+@param nb_req number of requests in the array
+@return LGW_COM_SUCCESS if no error, LGW_COM_ERROR otherwise
+*/
+int lgw_com_rb_multi(struct lgw_com_rb_s * req, uint8_t nb_req);
+
 /**
  *
 */
@@ -118,6 +195,31 @@ void* lgw_com_target(void);
  **/
 lgw_com_type_t lgw_com_type(void);
 
+/**
+@brief Get the counters of the accesses done with the communication interface of the current board
+@param stats pointer to the structure to be filled
+@param reset set to true to clear the counters once copied
+@return LGW_COM_SUCCESS if no error, LGW_COM_ERROR otherwise
+*/
+int lgw_com_get_stats(struct lgw_com_stats_s * stats, bool reset);
+
+/**
+@brief Get the time, to be given to lgw_com_stats_update() at the end of an access
+@return the current monotonic time, in nanoseconds
+*/
+uint64_t lgw_com_stats_start(void);
+
+/**
+@brief Account an access in the statistics of the current board (for the com modules only)
+@param com_type backend used
+@param target device addressed
+@param op kind of access
+@param size number of bytes moved
+@param start_ns time at which the access started, from lgw_com_stats_start()
+@param status return code of the access
+*/
+void lgw_com_stats_update(lgw_com_type_t com_type, lgw_com_stats_target_t target, lgw_com_stats_op_t op, uint32_t size, uint64_t start_ns, int status);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
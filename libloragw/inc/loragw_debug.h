@@ -21,6 +21,12 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include "config.h"    /* library configuration options (dynamically generated) */
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define DBG_PER_LOG_NB      64  /* payload mismatches buffered for the log writer thread */
+#define DBG_PER_PERIOD_MS   100 /* time between two writes of the buffered mismatches to the log file */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
@@ -57,6 +63,44 @@ void dbg_generate_random_payload(uint32_t pkt_cnt, uint8_t * buffer_expected, ui
 */
 int dbg_check_payload(struct lgw_conf_debug_s * context, FILE * file, uint8_t * payload_received, uint8_t size, uint8_t ref_payload_idx, uint8_t sf);
 
+/**
+@brief Clear the packet error rate counters and the expected payloads of the fast check
+*/
+void dbg_per_reset(void);
+
+/**
+@brief Start the thread writing the payload mismatches found by dbg_per_check
+@param file log file, NULL to only count the mismatches
+@return 0 if no error, -1 otherwise
+*/
+int dbg_per_start(FILE * file);
+
+/**
+@brief Stop the thread writing the payload mismatches, after the pending ones are written
+*/
+void dbg_per_stop(void);
+
+/**
+@brief Fast check of a payload against the reference payloads, for the packet error rate tests
+@param context debug configuration, holding the reference payloads
+@param payload payload received
+@param size size of the payload
+@param sf spreading factor of the packet, for the counters
+@return 1 if the payload matches its reference, -1 if it differs, 0 if it is not from a reference device
+
+The payload expected for the next counter of each device is generated ahead, so that the check
+is a word-wise comparison for packets received in sequence. A mismatch is only copied in a
+buffer, its log is written by the thread started by dbg_per_start.
+*/
+int dbg_per_check(struct lgw_conf_debug_s * context, const uint8_t * payload, uint8_t size, uint8_t sf);
+
+/**
+@brief Get the packet error rate counters of the fast check
+@param stats pointer to receive the counters
+@param reset set to true to clear the counters once copied
+*/
+void dbg_per_get_stats(struct lgw_per_stats_s * stats, bool reset);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -23,6 +23,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define _GNU_SOURCE
 #include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
 #include <time.h>       /* time library */
 #include <termios.h>    /* speed_t */
 #include <unistd.h>     /* ssize_t */
@@ -44,6 +45,23 @@ struct tref {
     double          xtal_err;   /*!> raw clock error (eg. <1 'slow' XTAL) */
 };
 
+/**
+@struct lgw_clock_s
+@brief Estimator of the concentrator clock offset and drift against GPS time
+*/
+struct lgw_clock_s {
+    bool            init;       /*!> at least one synchronization was accepted */
+    uint32_t        count_us;   /*!> concentrator counter of the last synchronization */
+    struct timespec utc;        /*!> UTC time of the last synchronization */
+    struct timespec gps;        /*!> GPS time of the last synchronization */
+    time_t          systime;    /*!> system time of the last synchronization */
+    double          offset;     /*!> estimated counter value at that time, minus count_us (us) */
+    double          drift;      /*!> estimated counter frequency error (ppm, ie. us per second) */
+    double          p[2][2];    /*!> covariance of the [offset, drift] estimate */
+    uint32_t        nb_sync;    /*!> number of synchronizations accepted since start or reset */
+    uint32_t        nb_reject;  /*!> number of consecutive synchronizations rejected */
+};
+
 /**
 @struct coord_s
 @brief Geodesic coordinates
@@ -82,6 +100,23 @@ enum gps_msg {
     UBX_NAV_TIMEUTC  /*!> UTC Time Solution */
 };
 
+#define LGW_GPS_FRAME_MAX   (128)   /* longest NMEA sentence kept by the stream parser */
+
+/**
+@struct lgw_gps_stream_s
+@brief State of the incremental parser of the GPS serial stream
+*/
+struct lgw_gps_stream_s {
+    uint8_t     state;      /*!> position in the frame being received */
+    bool        nmea;       /*!> decode NMEA sentences, or only UBX NAV-TIMEGPS */
+    bool        keep;       /*!> the frame being received is stored to be decoded */
+    uint8_t     ck_a;       /*!> running checksum (UBX Fletcher A, or NMEA xor) */
+    uint8_t     ck_b;       /*!> running checksum (UBX Fletcher B) */
+    uint16_t    len;        /*!> UBX payload length */
+    uint32_t    idx;        /*!> number of bytes of the frame received so far */
+    char        buff[LGW_GPS_FRAME_MAX]; /*!> frame being received */
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
@@ -143,6 +178,34 @@ lock must be acquired before calling either function.
 */
 enum gps_msg lgw_parse_ubx(const char* serial_buff, size_t buff_size, size_t *msg_size);
 
+/**
+@brief Initialize the incremental parser of the GPS serial stream
+
+@param stream parser state to be initialized
+@param nmea true to decode NMEA sentences, false to decode UBX NAV-TIMEGPS only
+
+When NMEA decoding is disabled, the UTC time returned by lgw_gps_get is derived
+from the GPS time and the leap seconds given by UBX NAV-TIMEGPS, and no position
+is available.
+*/
+void lgw_gps_stream_init(struct lgw_gps_stream_s *stream, bool nmea);
+
+/**
+@brief Parse bytes received from the GPS serial port, one at a time
+
+@param stream parser state, keeping partial frames between calls
+@param data bytes received
+@param size number of bytes received
+@param msg pointer to return the type of the frame completed, UNKNOWN if none
+@return number of bytes consumed, less than size if a frame was completed
+
+The bytes are never scanned twice. Checksums are computed on the fly, only
+UBX NAV-TIMEGPS and NMEA RMC/GGA frames are decoded, with the same effect as
+lgw_parse_ubx and lgw_parse_nmea. The function returns as soon as a frame is
+completed, it has to be called again with the remaining bytes.
+*/
+size_t lgw_gps_stream_parse(struct lgw_gps_stream_s *stream, const uint8_t *data, size_t size, enum gps_msg *msg);
+
 /**
 @brief Get the GPS solution (space & time) for the concentrator
 
@@ -215,6 +278,22 @@ the order of a millisecond.
 */
 int lgw_cnt2gps(struct tref ref, uint32_t count_us, struct timespec* gps_time);
 
+/**
+@brief Convert an array of concentrator timestamp counter values to UTC and GPS time
+
+@param ref time reference structure required for time conversion
+@param count_us array of internal timestamp counter values of the LoRa concentrator
+@param nb number of values to be converted
+@param utc array to store UTC times, with ns precision (NULL to ignore)
+@param gps_time array to store GPS times, with ns precision (NULL to ignore)
+@return success if the reference was valid and all the values converted
+
+Same results as lgw_cnt2utc and lgw_cnt2gps called for each value, the
+reference being checked and the clock correction computed once for all values.
+Typically used for all the packets fetched at once from the concentrator.
+*/
+int lgw_cnt2time_array(struct tref ref, const uint32_t *count_us, int nb, struct timespec *utc, struct timespec *gps_time);
+
 /**
 @brief Convert GPS time to concentrator timestamp counter value
 
@@ -229,6 +308,50 @@ transform an absolute GPS time into a matching internal concentrator timestamp.
 */
 int lgw_gps2cnt(struct tref ref, struct timespec gps_time, uint32_t* count_us);
 
+/**
+@brief Initialize a clock estimator, no time reference being known
+
+@param clk clock estimator to be initialized
+*/
+void lgw_clock_init(struct lgw_clock_s *clk);
+
+/**
+@brief Update a clock estimator with a new synchronization point
+
+@param clk clock estimator to be updated
+@param count_us internal timestamp counter of the LoRa concentrator captured on PPS
+@param utc UTC time of the PPS
+@param gps_time GPS time of the PPS
+@return success if the point was accepted, error if rejected as aberrant
+
+The offset and drift of the concentrator counter are tracked by a Kalman filter,
+a constant drift model being extrapolated between synchronizations. A point too
+far from the prediction is rejected, after 3 consecutive rejections the offset
+is reset to the new point (keeping the drift estimate). Points may be missing.
+*/
+int lgw_clock_update(struct lgw_clock_s *clk, uint32_t count_us, struct timespec utc, struct timespec gps_time);
+
+/**
+@brief Get the time reference extrapolated from the clock estimator
+
+@param clk clock estimator
+@param ref pointer to store the time reference
+@return success if the estimator has been synchronized at least once
+
+The reference is to be used with the lgw_cnt2utc/lgw_utc2cnt/lgw_cnt2gps/lgw_gps2cnt
+functions, its systime is the system time of the last accepted synchronization.
+*/
+int lgw_clock_tref(const struct lgw_clock_s *clk, struct tref *ref);
+
+/**
+@brief Get the expected error of the counter extrapolated by the clock estimator
+
+@param clk clock estimator
+@param holdover time since the last accepted synchronization, in seconds
+@return standard deviation of the extrapolation error, in microseconds (negative if not synchronized)
+*/
+double lgw_clock_error_us(const struct lgw_clock_s *clk, double holdover);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -125,8 +125,15 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define RX_ON               2    /* RX modem is receiving */
 #define RX_SUSPENDED        3    /* RX is suspended while a TX is ongoing */
 
+#define LGW_RX_BUFFER_SIZE  4096 /* number of bytes of the SX1302 RX buffer */
+#define LGW_RX_FILL_STEP    512 /* width in bytes of the buckets of the RX buffer fill level histogram */
+#define LGW_RX_FILL_HIST_NB 16 /* buckets of the RX buffer fill level histogram, up to the 8191 bytes of the fill level register */
+#define LGW_CHAN_STAT_SF_NB 8  /* datarates of the per channel statistics, SF5 to SF12, FSK packets counted in the first one */
+#define LGW_ARB_STATS_PERIOD_MS 1000 /* period of the sampling of the ARB counters by lgw_receive() */
+
 /* Maximum size of Tx gain LUT */
 #define TX_GAIN_LUT_SIZE_MAX 16
+#define TX_GAIN_MAP_SIZE    256 /* one LUT index per requested power in dBm, over the int8_t range */
 
 /* Listen-Before-Talk */
 #define LGW_LBT_CHANNEL_NB_MAX 16 /* Maximum number of LBT channels */
@@ -224,6 +231,7 @@ struct lgw_pkt_rx_s {
     uint8_t     if_chain;       /*!> by which IF chain was packet received */
     uint8_t     status;         /*!> status of the received packet */
     uint32_t    count_us;       /*!> internal concentrator counter for timestamping, 1 microsecond resolution */
+    uint64_t    count_us64;     /*!> same as count_us, extended to 64 bits by the HAL: does not wrap while the concentrator runs */
     uint8_t     rf_chain;       /*!> through which RF chain the packet was received */
     uint8_t     modem_id;
     uint8_t     modulation;     /*!> modulation used by the packet */
@@ -235,11 +243,16 @@ struct lgw_pkt_rx_s {
     float       snr;            /*!> average packet SNR, in dB (LoRa only) */
     float       snr_min;        /*!> minimum packet SNR, in dB (LoRa only) */
     float       snr_max;        /*!> maximum packet SNR, in dB (LoRa only) */
+    int16_t     rssic_x10;      /*!> average RSSI of the channel, in 0.1 dB */
+    int16_t     rssis_x10;      /*!> average RSSI of the signal, in 0.1 dB */
+    int16_t     snr_x10;        /*!> average packet SNR, in 0.1 dB (LoRa only) */
     uint16_t    crc;            /*!> CRC that was received in the payload */
     uint16_t    size;           /*!> payload size in bytes */
     uint8_t     payload[256];   /*!> buffer containing the payload */
     bool        ftime_received; /*!> a fine timestamp has been received */
     uint32_t    ftime;          /*!> packet fine timestamp (nanoseconds since last PPS) */
+    int64_t     host_fetch_ns;  /*!> host monotonic time at which the packet was fetched from the RX buffer, in nanoseconds */
+    int64_t     host_parse_ns;  /*!> host monotonic time at which the packet was parsed, in nanoseconds */
 };
 
 /**
@@ -250,6 +263,7 @@ struct lgw_pkt_tx_s {
     uint32_t    freq_hz;        /*!> center frequency of TX */
     uint8_t     tx_mode;        /*!> select on what event/time the TX is triggered */
     uint32_t    count_us;       /*!> timestamp or delay in microseconds for TX trigger */
+    uint64_t    count_us64;     /*!> (optional) timestamp of a TIMESTAMPED TX on the 64 bits counter, replaces count_us if not 0 */
     uint8_t     rf_chain;       /*!> through which RF chain will the packet be sent */
     int8_t      rf_power;       /*!> TX power, in dBm */
     uint8_t     modulation;     /*!> modulation to use for the packet */
@@ -291,6 +305,11 @@ struct lgw_tx_gain_lut_s {
     uint8_t                 size;                       /*!> Number of LUT indexes */
 };
 
+/**
+@brief Hook giving the correction, in dB, added to the requested power of a TX chain before the TX gain LUT lookup
+*/
+typedef int8_t (*lgw_txgain_temp_hook_t)(uint8_t rf_chain, float temperature);
+
 /**
 @struct lgw_conf_debug_s
 @brief Configuration structure for debug
@@ -365,6 +384,99 @@ struct lgw_conf_sx1261_s {
     struct lgw_conf_lbt_s       lbt_conf;           /*!> listen-before-talk configuration */
 };
 
+/**
+@struct lgw_start_timing_s
+@brief Duration of the phases of the last lgw_start() call, in milliseconds
+*/
+struct lgw_start_timing_s {
+    uint32_t connect_ms;        /*!> connection to the concentrator */
+    uint32_t calibration_ms;    /*!> radio reset and calibration (or restore from cache) */
+    uint32_t radio_setup_ms;    /*!> radio reset and setup for RX */
+    uint32_t config_ms;         /*!> SX1302 configuration */
+    uint32_t firmware_ms;       /*!> AGC and ARB firmwares loading and start */
+    uint32_t other_ms;          /*!> TX configuration, GPS, I2C devices and SX1261 */
+    uint32_t total_ms;          /*!> whole lgw_start() duration */
+};
+
+/**
+@struct lgw_rx_stats_s
+@brief Counters of the fetches of the SX1302 RX buffer, since the start or the last reset
+*/
+struct lgw_rx_stats_s {
+    uint32_t nb_fetch;          /*!> number of fetches returning data */
+    uint64_t nb_byte;           /*!> number of bytes fetched */
+    uint16_t fill_max;          /*!> highest number of bytes waiting in the RX buffer at a fetch, read in several fetches above LGW_RX_BUFFER_SIZE */
+    uint32_t nb_split;          /*!> number of fetches limited by the host buffer size, the rest of the data being read by the next fetch */
+    uint32_t fill_hist[LGW_RX_FILL_HIST_NB]; /*!> number of fetches returning data, by fill level of the RX buffer in steps of LGW_RX_FILL_STEP bytes */
+    uint32_t nb_pkt;            /*!> number of packets parsed */
+    uint32_t nb_discard;        /*!> number of fetched data discarded as corrupted, with the packets they held */
+};
+
+/**
+@struct lgw_per_stats_s
+@brief Packet error rate counters of the reference payloads set by lgw_debug_setconf(), by datarate SF5 to SF12
+*/
+struct lgw_per_stats_s {
+    uint32_t nb_ok[LGW_CHAN_STAT_SF_NB];        /*!> payloads matching the expected ones */
+    uint32_t nb_err[LGW_CHAN_STAT_SF_NB];       /*!> payloads differing from the expected ones */
+    uint32_t nb_bit_err[LGW_CHAN_STAT_SF_NB];   /*!> bits differing in the payloads in error */
+    uint32_t nb_missed[LGW_CHAN_STAT_SF_NB];    /*!> packets missed, from the gaps in the packet counters */
+    uint32_t nb_log_dropped;                    /*!> payload errors not logged, the log buffer being full */
+};
+
+/**
+@struct lgw_rx_moments_s
+@brief Streaming range, mean and variance of a metric of the received packets, in 0.1 dB
+*/
+struct lgw_rx_moments_s {
+    uint32_t    nb;             /*!> number of values */
+    int16_t     min_x10;        /*!> lowest value */
+    int16_t     max_x10;        /*!> highest value */
+    int64_t     sum_x10;        /*!> sum of the values */
+    uint64_t    sumsq_x100;     /*!> sum of the squared values */
+};
+
+/**
+@struct lgw_chan_stat_s
+@brief Counters of the packets received on one IF chain with one datarate
+*/
+struct lgw_chan_stat_s {
+    uint32_t                nb_pkt;     /*!> number of packets received */
+    uint32_t                nb_crc_bad; /*!> number of packets received with a CRC error */
+    uint32_t                nb_no_crc;  /*!> number of packets received without CRC */
+    struct lgw_rx_moments_s rssi;       /*!> channel RSSI of all the packets */
+    struct lgw_rx_moments_s snr;        /*!> SNR of the LoRa packets */
+};
+
+/**
+@struct lgw_chan_stats_s
+@brief Counters of the received packets, per IF chain and datarate, since the start or the last reset
+*/
+struct lgw_chan_stats_s {
+    struct lgw_chan_stat_s  chan[LGW_IF_CHAIN_NB][LGW_CHAN_STAT_SF_NB]; /*!> indexed by IF chain and SF - 5 */
+};
+
+/**
+@struct lgw_arb_stats_s
+@brief Preambles detected and demodulators allocated by the ARB firmware, since the start or the last reset
+*/
+struct lgw_arb_stats_s {
+    uint8_t     sf;                         /*!> datarate counted by the ARB firmware */
+    uint32_t    nb_detect[LGW_MULTI_NB];    /*!> number of preambles detected, per multi-SF channel */
+    uint32_t    nb_alloc[LGW_MULTI_NB];     /*!> number of detects which got a demodulator, per multi-SF channel */
+};
+
+/**
+@struct lgw_tx_prepared_s
+@brief Packet uploaded to a TX chain by lgw_send_prepare(), waiting for lgw_send_commit()
+*/
+struct lgw_tx_prepared_s {
+    bool                        valid;          /*!> the TX chain registers and buffer still hold the packet */
+    uint16_t                    start_delay;    /*!> TX start delay programmed for the packet */
+    bool                        lbt_armed;      /*!> the SX1261 scans the TX channel of the packet since its preparation */
+    struct lgw_pkt_tx_s         pkt;            /*!> copy of the packet, as given to lgw_send_prepare() */
+};
+
 /**
 @struct lgw_context_s
 @brief Configuration context shared across modules
@@ -379,15 +491,28 @@ typedef struct lgw_context_s {
     struct lgw_conf_demod_s     demod_cfg;
     struct lgw_conf_rxif_s      lora_service_cfg;                       /* LoRa service channel config parameters */
     struct lgw_conf_rxif_s      fsk_cfg;                                /* FSK channel config parameters */
+    struct lgw_chan_stats_s     chan_stats;                             /* statistics of the packets received, updated by lgw_receive() */
     /* TX context */
     struct lgw_tx_gain_lut_s    tx_gain_lut[LGW_RF_CHAIN_NB];
+    uint8_t                     tx_gain_map[LGW_RF_CHAIN_NB][TX_GAIN_MAP_SIZE]; /* LUT index for each requested power, built by lgw_txgain_setconf() */
+    int8_t                      tx_gain_temp_offset[LGW_RF_CHAIN_NB];           /* dB added to the requested power, from the temperature hook */
+    struct lgw_tx_prepared_s    tx_prepared[LGW_RF_CHAIN_NB];
     /* Misc */
     struct lgw_conf_ftime_s     ftime_cfg;
     struct lgw_conf_sx1261_s    sx1261_cfg;
     /* Debug */
     struct lgw_conf_debug_s     debug_cfg;
+    struct lgw_start_timing_s   start_timing;
 } lgw_context_t;
 
+/**
+@struct lgw_handle_s
+@brief Handle on one of the concentrator boards driven by the process
+*/
+typedef struct lgw_handle_s {
+    uint8_t board;  /*!> index of the board, board 0 is used by threads which did not select any */
+} lgw_handle_t;
+
 /**
 @struct lgw_spectral_scan_status_t
 @brief Spectral Scan status
@@ -403,6 +528,29 @@ typedef enum lgw_spectral_scan_status_e {
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
+/**
+@brief Reserve a concentrator board, with a default configuration
+@brief Up to LGW_BOARD_NB_MAX boards can be driven in parallel by one process.
+@return a handle on the board, NULL if no more board is available
+*/
+lgw_handle_t * lgw_open(void);
+
+/**
+@brief Release a concentrator board reserved with lgw_open, it must be stopped
+@param handle the board handle
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_close(lgw_handle_t * handle);
+
+/**
+@brief Select the board all the following lgw_* calls of the calling thread apply to
+@brief Different threads can work with different boards in parallel, and threads
+@brief which never call it work with board 0 (single board applications).
+@param handle the board handle
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_select(lgw_handle_t * handle);
+
 /**
 @brief Set I2C device path
 @param path         Path to the I2C device driver
@@ -410,11 +558,38 @@ typedef enum lgw_spectral_scan_status_e {
 int lgw_i2c_set_path(const char *path);
 
 /**
-@brief Set I2C temperature sensor address
+@brief Set I2C temperature sensor address of the selected board
 @param addr         Address of the I2C temperature sensor.
 */
 int lgw_i2c_set_temp_sensor_addr(uint8_t addr);
 
+/**
+@brief Set the refresh period of the temperature used for RSSI compensation, sampled by a thread of each board
+@param period_ms    Sampling period in milliseconds, 0 to read the sensor on each lgw_receive call
+*/
+int lgw_i2c_set_temp_sensor_period(uint32_t period_ms);
+
+/**
+@brief Set the file in which SX1255/SX1257 calibration results are kept, to skip the calibration on restart in the same conditions
+@param path         Path of the cache file, NULL or empty to always calibrate (default)
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_cal_cache_set_path(const char * path);
+
+/**
+@brief Shorten the SX1255/SX1257 calibration by stopping the iterations once the results are consistent
+@param enable       true to enable the fast calibration mode, false to run all iterations (default)
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_cal_set_fast_mode(bool enable);
+
+/**
+@brief Check the AGC and ARB firmwares loaded by lgw_start() on windows of the image instead of a full read back
+@param enable       true to read back 1/8 of the image in a single transfer, false to read back the whole image (default)
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_fw_set_fast_check(bool enable);
+
 /**
 @brief Configure the gateway board
 @param conf structure containing the configuration parameters
@@ -452,6 +627,29 @@ int lgw_demod_setconf(struct lgw_conf_demod_s * conf);
 */
 int lgw_txgain_setconf(uint8_t rf_chain, struct lgw_tx_gain_lut_s * conf);
 
+/**
+@brief Get the TX gain LUT entry used for a requested power, without temperature correction
+@param rf_chain TX chain of the LUT
+@param rf_power requested power, in dBm
+@param lut_index pointer to return the index of the LUT entry, NULL if not needed
+@param rf_power_used pointer to return the power of the LUT entry, in dBm, NULL if not needed
+@return LGW_HAL_SUCCESS if the LUT has an entry for the requested power, LGW_HAL_ERROR otherwise
+
+The lookup table is built by lgw_txgain_setconf(). Without an entry for the
+requested power, the closest lower power is used, or the lowest one.
+*/
+int lgw_txgain_lookup(uint8_t rf_chain, int8_t rf_power, uint8_t * lut_index, int8_t * rf_power_used);
+
+/**
+@brief Set a hook to select the TX gain LUT entries according to the temperature
+@param hook function called with each new temperature measure, NULL to remove the correction
+@return LGW_HAL_SUCCESS
+
+The correction returned by the hook for each TX chain is applied by the TX
+functions to the requested power, until the next measure of the temperature.
+*/
+int lgw_txgain_set_temp_hook(lgw_txgain_temp_hook_t hook);
+
 /**
 @brief Configure the fine timestamping
 @param conf pointer to structure defining the config to be applied
@@ -485,6 +683,34 @@ int lgw_start(void);
 */
 int lgw_stop(void);
 
+/**
+@brief Apply a new channels plan to the running LoRa concentrator, without restarting it
+@param rf_conf array of LGW_RF_CHAIN_NB radio configurations, NULL to keep them
+@param if_conf array of LGW_IF_CHAIN_NB IF chain configurations, checked as by lgw_rxif_setconf()
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+Only the registers of the channels which changed are written. The frequency,
+type or mode of a radio can not be changed this way, lgw_stop()/lgw_start()
+are needed for that. If the new configuration is not valid, the running one
+is kept. lgw_demod_setconf() can be called before, to change the spreading
+factors enabled on the multi-SF channels.
+*/
+int lgw_reconfigure(struct lgw_conf_rxrf_s * rf_conf, struct lgw_conf_rxif_s * if_conf);
+
+/**
+@brief Reconnect to the running LoRa concentrator after a COM link error
+@param restarted pointer to return if the concentrator had to be restarted
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The COM link is opened again without resetting the concentrator. If it kept
+its configuration, its AGC firmware and its counter, it is used as it is,
+otherwise it is restarted with lgw_stop()/lgw_start() and the packets
+received meanwhile are lost. Only the USB link (and the simulator) is supported.
+After a restart the counter starts again from 0: the caller must drop the TX
+timestamps and the time references (GPS) computed from the previous counter.
+*/
+int lgw_recover(bool * restarted);
+
 /**
 @brief A non-blocking function that will fetch up to 'max_pkt' packets from the LoRa concentrator FIFO and data buffer
 @param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
@@ -493,6 +719,56 @@ int lgw_stop(void);
 */
 int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data);
 
+/**
+@brief Same as lgw_receive, but the packets are written in descriptors given by reference, eg. taken from a pool
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of references)
+@param pkt_ref array of pointers to the descriptors that will receive the packets
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+The references are reordered: the first ones point to the packets retrieved, the
+following ones to the descriptors left unused, so that none of them is lost.
+*/
+int lgw_receive_ref(uint8_t max_pkt, struct lgw_pkt_rx_s ** pkt_ref);
+
+/**
+@brief Fetch all the packets available from the LoRa concentrator into HAL-owned storage, to be walked with lgw_receive_next
+@return LGW_HAL_ERROR id the operation failed or if the previous cursor was not ended, else the number of packets retrieved
+
+Unlike lgw_receive with a small max_pkt, the storage can hold every packet of a
+fetch, so none is left in the RX buffer for the next call, and the packets are
+not copied to the caller. lgw_receive_end() must be called before the next
+lgw_receive_begin(), lgw_receive/lgw_receive_ref can still be used between two
+cursors.
+*/
+int lgw_receive_begin(void);
+
+/**
+@brief Get the next packet retrieved by lgw_receive_begin
+@param pkt pointer to the packet, valid until lgw_receive_end is called, or NULL when all the packets were given
+@return LGW_HAL_ERROR id the operation failed, 1 if a packet is given, 0 at the end of the packets
+*/
+int lgw_receive_next(struct lgw_pkt_rx_s ** pkt);
+
+/**
+@brief Release the packets retrieved by lgw_receive_begin, the pointers given by lgw_receive_next are not valid anymore
+@return LGW_HAL_ERROR id no cursor is open, LGW_HAL_SUCCESS else
+*/
+int lgw_receive_end(void);
+
+/**
+@brief Wait until packets are available to be fetched with lgw_receive, or until timeout
+
+The RX buffer is polled every 1 ms on SPI, every 3 ms on USB, the interval
+doubling up to the timeout (100 ms at most) while the buffer stays empty. The
+pacing is kept between the calls: a wait called right after an empty check, or
+an lgw_receive which returned no packet, does not check again before the
+interval has elapsed.
+
+@param timeout_ms maximum time to wait in milliseconds, 0 to only check once
+@return LGW_HAL_ERROR id the operation failed, 1 if packets are available, 0 on timeout
+*/
+int lgw_receive_wait(uint32_t timeout_ms);
+
 /**
 @brief Schedule a packet to be send immediately or after a delay depending on tx_mode
 @param pkt_data structure containing the data and metadata for the packet to send
@@ -519,6 +795,51 @@ the protocol.
 */
 int lgw_send(struct lgw_pkt_tx_s * pkt_data);
 
+/**
+@brief Upload a packet to its TX chain ahead of its emission, without triggering it
+@param pkt_data structure containing the data and metadata for the packet to send
+@return LGW_HAL_ERROR if the packet could not be uploaded (TX chain busy, invalid packet), LGW_HAL_SUCCESS else
+
+The modulation settings and the payload are written to the TX chain, so that
+lgw_send_commit() only has to arm the trigger. Only one packet can be prepared
+per TX chain: preparing another one, or sending one with lgw_send(), replaces it.
+Preparing again the packet already prepared does not access the concentrator.
+The TX chain must be free, a packet scheduled or being emitted is not disturbed.
+With Listen-Before-Talk enabled, the SX1261 starts to scan the TX channel at
+preparation, so that lgw_send_commit() does not have to wait for the scan time.
+Only one packet at a time can be scanned for.
+*/
+int lgw_send_prepare(struct lgw_pkt_tx_s * pkt_data);
+
+/**
+@brief Schedule the emission of a packet previously given to lgw_send_prepare()
+@param pkt_data structure containing the data and metadata for the packet to send
+@return same as lgw_send()
+
+If the TX chain still holds that packet, only the trigger (timestamp) is
+programmed. Otherwise, the packet is fully sent with lgw_send(), so calling this
+function is always safe. The emission mode and timestamp may differ from the
+ones given at preparation.
+*/
+int lgw_send_commit(struct lgw_pkt_tx_s * pkt_data);
+
+/**
+@brief Send several packets, at most one per TX chain, in a single transfer to the concentrator
+@param pkt_data array of the packets to send
+@param nb_pkt number of packets in the array
+@param status array of nb_pkt values to return the result of each packet, same as lgw_send()
+@return LGW_HAL_SUCCESS if all the packets have been sent, LGW_HAL_ERROR otherwise
+
+The packets are validated as by lgw_send(), then uploaded and triggered with a
+single bulk write, instead of one per packet. A packet previously given to
+lgw_send_prepare() only has its trigger armed, as with lgw_send_commit(). An
+invalid packet, or a second packet for the same TX chain, is rejected without
+preventing the other ones to be sent. With Listen-Before-Talk enabled, the
+packets are sent one by one with lgw_send_commit(), as the SX1261 can only scan
+one channel at a time.
+*/
+int lgw_send_batch(struct lgw_pkt_tx_s * pkt_data, uint8_t nb_pkt, int * status);
+
 /**
 @brief Give the the status of different part of the LoRa concentrator
 @param select is used to select what status we want to know
@@ -542,11 +863,35 @@ int lgw_get_trigcnt(uint32_t * trig_cnt_us);
 
 /**
 @brief Return instateneous value of internal counter
+@brief If the counter has been read less than 20ms ago, the value is extrapolated from that read with the host clock
 @param inst_cnt_us pointer to receive timestamp value
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
 */
 int lgw_get_instcnt(uint32_t * inst_cnt_us);
 
+/**
+@brief Return an estimate of the internal counter, extrapolated with the host clock from the last counter read done by the HAL
+@brief It does not access the concentrator, and can be called without holding the lock serializing the other HAL calls
+@param inst_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR if no counter read less than 1s old is available (use lgw_get_instcnt), LGW_HAL_SUCCESS else
+*/
+int lgw_get_instcnt_estimate(uint32_t * inst_cnt_us);
+
+/**
+@brief Same as lgw_get_instcnt, with the counter extended to 64 bits by the HAL
+@brief The extended counter does not wrap while the concentrator runs, its 32 LSBs are the value of lgw_get_instcnt
+@param inst_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_instcnt64(uint64_t * inst_cnt_us);
+
+/**
+@brief Same as lgw_get_instcnt_estimate, with the counter extended to 64 bits by the HAL
+@param inst_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR if no counter read less than 1s old is available (use lgw_get_instcnt64), LGW_HAL_SUCCESS else
+*/
+int lgw_get_instcnt_estimate64(uint64_t * inst_cnt_us);
+
 /**
 @brief Return the LoRa concentrator EUI
 @param eui pointer to receive eui
@@ -554,8 +899,75 @@ int lgw_get_instcnt(uint32_t * inst_cnt_us);
 */
 int lgw_get_eui(uint64_t * eui);
 
+/**
+@brief Return the duration of the phases of the last start of the LoRa concentrator
+@param timing pointer to receive the phases durations
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_start_timing(struct lgw_start_timing_s * timing);
+
+/**
+@brief Return the counters of the fetches of the RX buffer by lgw_receive()
+@param stats pointer to receive the counters
+@param reset set to true to clear the counters once copied
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_rx_stats(struct lgw_rx_stats_s * stats, bool reset);
+
+/**
+@brief Return the packet error rate counters of the reference payloads, checked by lgw_receive()
+@param stats pointer to receive the counters
+@param reset set to true to clear the counters once copied
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_per_stats(struct lgw_per_stats_s * stats, bool reset);
+
+/**
+@brief Get an upper bound of a percentile of the RX buffer fill levels seen by the fetches
+@param stats counters returned by lgw_get_rx_stats()
+@param per_mille percentile, in per mille (990 for p99)
+@return upper bound of the bucket holding the percentile, at most fill_max, in bytes, 0 if no fetch
+*/
+uint16_t lgw_rx_fill_percentile(const struct lgw_rx_stats_s * stats, uint32_t per_mille);
+
+/**
+@brief Return the counters of the ARB firmware, to see the detects which did not get a demodulator
+@param stats pointer to receive the counters
+@param reset set to true to clear the counters once copied
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The counters are read in a single transfer, and sampled by lgw_receive() every
+LGW_ARB_STATS_PERIOD_MS so that the 8-bit firmware counters never wrap unseen.
+*/
+int lgw_get_arb_stats(struct lgw_arb_stats_s * stats, bool reset);
+
+/**
+@brief Return the statistics of the packets received by lgw_receive(), per IF chain and datarate
+@param stats pointer to receive the statistics
+@param reset set to true to clear the statistics once copied
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_chan_stats(struct lgw_chan_stats_s * stats, bool reset);
+
+/**
+@brief Add the statistics of a channel and datarate to another one, to report them per channel or globally
+@param dst statistics to be updated
+@param src statistics to be added
+*/
+void lgw_chan_stat_merge(struct lgw_chan_stat_s * dst, const struct lgw_chan_stat_s * src);
+
+/**
+@brief Get the mean and the standard deviation of a metric
+@param m metric of a lgw_chan_stat_s
+@param mean_x10 pointer to receive the mean, in 0.1 dB
+@param stddev_x10 pointer to receive the standard deviation, in 0.1 dB, can be NULL
+@return number of values, 0 if the mean and deviation are not set
+*/
+uint32_t lgw_rx_moments_get(const struct lgw_rx_moments_s * m, int16_t * mean_x10, uint16_t * stddev_x10);
+
 /**
 @brief Return the temperature measured by the LoRa concentrator sensor
+@brief With an I2C sensor, this is the value cached by the background sampler (see lgw_i2c_set_temp_sensor_period)
 @param temperature The temperature measured, in degree celcius
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
 */
@@ -39,7 +39,21 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
 /**
-@brief Configure the SX1261 and start LBT channel scanning
+@brief Configure the SX1261 and start LBT channel scanning, returns without waiting for the scan time
+@param sx1261_context the sx1261 radio parameters to take into account for scanning
+@param pkt description of the packet to be transmitted
+@return 0 for success, -1 for failure
+*/
+int lgw_lbt_arm(const struct lgw_conf_sx1261_s * sx1261_context, const struct lgw_pkt_tx_s * pkt);
+
+/**
+@brief Wait until the channel has been scanned for the whole scan time since lgw_lbt_arm()
+@return 0 for success, -1 if LBT is not armed
+*/
+int lgw_lbt_wait_scan(void);
+
+/**
+@brief Configure the SX1261 and start LBT channel scanning, waiting for the scan time
 @param sx1261_context the sx1261 radio parameters to take into account for scanning
 @param pkt description of the packet to be transmitted
 @return 0 for success, -1 for failure
@@ -180,11 +180,81 @@ SPI answer when the function exits.
 */
 int mcu_spi_write(int fd, uint8_t * in_out_buf, size_t buf_size);
 
+/**
+@brief Send a single SX1302 read/write SPI request to the MCU, with the SPI frame payload in a separate buffer
+@param fd File descriptor of the device used to access the MCU
+@param in_out_buf The buffer containing the request metadata and SPI header, it
+will contain the beginning of the answer when the function exits
+@param buf_size The size of the given input/output buffer
+@param data The buffer containing the SPI frame payload, it will contain the
+rest of the answer when the function exits
+@param data_size The size of the given data buffer
+@return 0 for SUCCESS, -1 for failure
+*/
+int mcu_spi_write_sg(int fd, uint8_t * in_out_buf, size_t buf_size, uint8_t * data, size_t data_size);
+
+/**
+@brief Send a SX1302 write SPI request to the MCU, without waiting for its ACK if pipelining is enabled
+@param fd File descriptor of the device used to access the MCU
+@param in_out_buf The buffer containing the multiple requests to be sent, it can be reused when the function exits
+@param buf_size The size of the given input buffer
+@return 0 for SUCCESS, -1 for failure (of this request, or of a previous posted one)
+*/
+int mcu_spi_post(int fd, uint8_t * in_out_buf, size_t buf_size);
+
+/**
+@brief Same as mcu_spi_post, with the SPI frame payload of a single request in a separate buffer
+@param fd File descriptor of the device used to access the MCU
+@param in_buf The buffer containing the request metadata and SPI header
+@param buf_size The size of the given input buffer
+@param data The buffer containing the SPI frame payload, it can be reused when the function exits
+@param data_size The size of the given data buffer
+@return 0 for SUCCESS, -1 for failure (of this request, or of a previous posted one)
+*/
+int mcu_spi_post_sg(int fd, const uint8_t * in_buf, size_t buf_size, const uint8_t * data, size_t data_size);
+
+/**
+@brief Set the maximum number of requests sent to the MCU before their ACK is read
+@param fd File descriptor of the device used to access the MCU
+@param depth number of requests in flight, 1 for synchronous mode
+@return 0 for SUCCESS, -1 for failure
+*/
+int mcu_set_pipeline_depth(int fd, uint8_t depth);
+
+/**
+@brief Wait for the ACK of all requests in flight
+@param fd File descriptor of the device used to access the MCU
+@return 0 for SUCCESS, -1 if any of the requests failed
+*/
+int mcu_sync(int fd);
+
+/**
+@brief Discard the bytes received from the MCU and not parsed yet, the requests in flight and the stored
+ones, to be called when the link is (re)opened
+*/
+void mcu_rx_reset(void);
+
 /**
  *
 */
 int mcu_spi_store(uint8_t * in_out_buf, size_t buf_size);
 
+/**
+@brief Same as mcu_spi_store, with the SPI frame payload in a separate buffer
+@param in_buf The buffer containing the request metadata and SPI header
+@param buf_size The size of the given input buffer
+@param data The buffer containing the SPI frame payload
+@param data_size The size of the given data buffer
+@return 0 for SUCCESS, -1 for failure
+*/
+int mcu_spi_store_sg(const uint8_t * in_buf, size_t buf_size, const uint8_t * data, size_t data_size);
+
+/**
+@brief Get the room left in the bulk buffer for SPI requests to be stored
+@return the number of bytes which can still be stored, 0 if no more request can be stored
+*/
+uint16_t mcu_spi_bulk_room(void);
+
 /**
  *
 */
@@ -0,0 +1,98 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Runtime latency profiling of the library.
+    Each measure of _meas_time_start()/_meas_time_stop() is recorded in a named
+    probe, with a count, a sum and a histogram of the durations in log2 buckets.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_PERF_H
+#define _LORAGW_PERF_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_PERF_PROBE_NB_MAX   64  /* number of probes which can be recorded, must be a power of 2 */
+#define LGW_PERF_BUCKET_NB      32  /* bucket k > 0 holds the durations in [2^(k-1), 2^k[ ns, the last one all the longer ones */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_perf_probe_s
+@brief Latency statistics of one probe, since its first measure or the last reset
+*/
+struct lgw_perf_probe_s {
+    const char *    name;                       /*!> name given to _meas_time_stop() */
+    uint64_t        count;                      /*!> number of measures */
+    uint64_t        sum_ns;                     /*!> sum of the durations, in nanoseconds */
+    uint64_t        max_ns;                     /*!> longest duration, in nanoseconds */
+    uint64_t        hist[LGW_PERF_BUCKET_NB];   /*!> number of measures in each log2 bucket */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Enable or disable the recording of the measures, disabled by default
+@param enable true to record the measures in the probes
+*/
+void lgw_perf_enable(bool enable);
+
+/**
+@brief Check if the measures are recorded
+@return true if enabled
+*/
+bool lgw_perf_is_enabled(void);
+
+/**
+@brief Record a measure in a probe, created on its first measure
+@param name name of the probe, identified by the address of the string, which must stay valid
+@param duration_ns duration measured, in nanoseconds
+*/
+void lgw_perf_record(const char * name, uint64_t duration_ns);
+
+/**
+@brief Get the statistics of the probes
+@param probes array to return the probes, in the order of their first measure
+@param nb_max size of the probes array
+@return number of probes written
+
+The counters are read while being updated by the other threads, the fields of
+a probe can differ by the few measures recorded during the copy.
+*/
+int lgw_perf_get(struct lgw_perf_probe_s * probes, int nb_max);
+
+/**
+@brief Clear the statistics of all the probes, the probes are kept
+*/
+void lgw_perf_reset(void);
+
+/**
+@brief Get an upper bound of a percentile of the durations of a probe
+@param probe probe returned by lgw_perf_get()
+@param per_mille percentile, in per mille (990 for p99)
+@return upper bound of the bucket holding the percentile, in nanoseconds, 0 if no measure
+*/
+uint64_t lgw_perf_percentile(const struct lgw_perf_probe_s * probe, uint32_t per_mille);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
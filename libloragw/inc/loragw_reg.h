@@ -29,20 +29,54 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include "loragw_com.h"
 
+/* -------------------------------------------------------------------------- */
+/* --- INTERNAL SHARED CONSTANTS -------------------------------------------- */
+
+#define SX1302_REG_EXT_MEM_PAGED_BASE_ADDR 0x0
+#define SX1302_REG_RX_BUFFER_BASE_ADDR 0x4000
+#define SX1302_REG_TX_TOP_A_BASE_ADDR 0x5200
+#define SX1302_REG_TX_TOP_B_BASE_ADDR 0x5400
+#define SX1302_REG_COMMON_BASE_ADDR 0x5600
+#define SX1302_REG_GPIO_BASE_ADDR 0x5640
+#define SX1302_REG_MBIST_BASE_ADDR 0x56c0
+#define SX1302_REG_RADIO_FE_BASE_ADDR 0x5700
+#define SX1302_REG_AGC_MCU_BASE_ADDR 0x5780
+#define SX1302_REG_CLK_CTRL_BASE_ADDR 0x57c0
+#define SX1302_REG_RX_TOP_BASE_ADDR 0x5800
+#define SX1302_REG_RX_TOP_LORA_SERVICE_FSK_BASE_ADDR 0x5b00
+#define SX1302_REG_CAPTURE_RAM_BASE_ADDR 0x6000
+#define SX1302_REG_ARB_MCU_BASE_ADDR 0x6080
+#define SX1302_REG_TIMESTAMP_BASE_ADDR 0x6100
+#define SX1302_REG_OTP_BASE_ADDR 0x6180
+
+/* Descriptors of the registers accessed in the RX/TX loops, shared by the
+   register table and the inline accessors below */
+#define SX1302_REG_TX_TOP_A_TX_FSM_STATUS_TX_STATUS_DESC                {0,SX1302_REG_TX_TOP_A_BASE_ADDR+17,0,0,8,1,1,0}
+#define SX1302_REG_TX_TOP_B_TX_FSM_STATUS_TX_STATUS_DESC                {0,SX1302_REG_TX_TOP_B_BASE_ADDR+17,0,0,8,1,1,0}
+#define SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS_DESC      {0,SX1302_REG_TIMESTAMP_BASE_ADDR+1,0,0,8,1,1,0}
+#define SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES_DESC {0,SX1302_REG_RX_TOP_BASE_ADDR+200,0,0,5,1,1,0}
+
 /* -------------------------------------------------------------------------- */
 /* --- INTERNAL SHARED TYPES ------------------------------------------------ */
 
+/* packed in 8 bytes, instead of 16 with the padding of single fields */
 struct lgw_reg_s {
-    int8_t   page;        /*!< page containing the register (-1 for all pages) */
-    uint16_t addr;        /*!< base address of the register (15 bit) */
-    uint8_t  offs;        /*!< position of the register LSB (between 0 to 7) */
-    bool     sign;        /*!< 1 indicates the register is signed (2 complem.) */
-    uint8_t  leng;        /*!< number of bits in the register */
-    bool     rdon;        /*!< 1 indicates a read-only register */
-    bool     chck;        /*!< register can be checked or not: (pulse, w0clr, w1clr) */
-    int32_t  dflt;        /*!< register default value */
+    int32_t  page:2;      /*!< page containing the register (-1 for all pages) */
+    uint32_t addr:15;     /*!< base address of the register (15 bit) */
+    uint32_t offs:3;      /*!< position of the register LSB (between 0 to 7) */
+    uint32_t sign:1;      /*!< 1 indicates the register is signed (2 complem.) */
+    uint32_t leng:4;      /*!< number of bits in the register (between 1 to 8) */
+    uint32_t rdon:1;      /*!< 1 indicates a read-only register */
+    uint32_t chck:1;      /*!< register can be checked or not: (pulse, w0clr, w1clr) */
+    int16_t  dflt;        /*!< register default value */
 };
 
+/* -------------------------------------------------------------------------- */
+/* --- INTERNAL SHARED MACROS ----------------------------------------------- */
+
+/* Constant descriptor of a hot register, to be given to lgw_reg_hot_r/lgw_reg_hot_rb */
+#define LGW_REG_HOT(register_id) ((const struct lgw_reg_s)register_id##_DESC)
+
 /* -------------------------------------------------------------------------- */
 /* --- INTERNAL SHARED FUNCTIONS -------------------------------------------- */
 
@@ -1445,6 +1479,13 @@ int lgw_connect(const lgw_com_type_t com_type, const char * com_path);
 */
 int lgw_disconnect(void);
 
+/**
+@brief Reconnect LoRa concentrator after a COM link error, without resetting it
+@param com_path path to the COM device to be used to connect to the SX1302
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reconnect(const char * com_path);
+
 /**
 @brief LoRa concentrator register write
 @param register_id register number in the data structure describing registers
@@ -1479,6 +1520,16 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size);
 */
 int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size);
 
+/**
+@brief LoRa concentrator burst read of several registers, in a single COM transfer if supported
+@param register_id array of register numbers in the data structure describing registers
+@param data array of pointers to byte arrays to store the data read for each register
+@param size array of transfer sizes, in byte(s)
+@param nb_reg number of registers to be read
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_rb_multi(const uint16_t * register_id, uint8_t * const * data, const uint16_t * size, uint8_t nb_reg);
+
 /**
 @brief LoRa concentrator memory burst write
 @param mem_addr the address of the memory section to write to
@@ -1498,6 +1549,56 @@ int lgw_mem_wb(uint16_t mem_addr, const uint8_t *data, uint16_t size);
 */
 int lgw_mem_rb(uint16_t mem_addr, uint8_t *data, uint16_t size, bool fifo_mode);
 
+/**
+@brief Enable or disable the shadow copy of the SX1302 configuration registers
+@brief When enabled, sub-byte writes are merged locally and only written if the value changed,
+saving the read of a read-modify-write. Status, pulse and clear-on-write registers are never shadowed.
+It must only be enabled while no firmware is updating the configuration registers.
+@param enable true to load the shadow copy from the concentrator and use it, false to drop it
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_shadow_enable(bool enable);
+
+/* -------------------------------------------------------------------------- */
+/* --- INLINE FUNCTIONS DEFINITION ------------------------------------------ */
+
+/**
+@brief Read a hot register, from its constant descriptor
+@param r descriptor of the register, given by LGW_REG_HOT()
+@param reg_value pointer to a variable receiving the register value
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Same as lgw_reg_r, without the table lookup and checks: once inlined, the
+address, offset, length and sign are constants. Only for read-only registers,
+which are never held by the shadow copy.
+*/
+static inline int lgw_reg_hot_r(const struct lgw_reg_s r, int32_t *reg_value) {
+    uint8_t u = 0;
+    int com_stat;
+
+    com_stat = lgw_com_r(LGW_SPI_MUX_TARGET_SX1302, r.addr, &u);
+    if (r.sign == 1) {
+        *reg_value = (int32_t)((int8_t)(u << (8 - r.leng - r.offs)) >> (8 - r.leng));
+    } else {
+        *reg_value = (int32_t)((uint8_t)(u << (8 - r.leng - r.offs)) >> (8 - r.leng));
+    }
+
+    return (com_stat == LGW_COM_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/**
+@brief Burst read from a hot register, from its constant descriptor
+@param r descriptor of the register, given by LGW_REG_HOT()
+@param data pointer to the data buffer
+@param size number of bytes to be read
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Same as lgw_reg_rb, without the table lookup and checks.
+*/
+static inline int lgw_reg_hot_rb(const struct lgw_reg_s r, uint8_t *data, uint16_t size) {
+    return (lgw_com_rb(LGW_SPI_MUX_TARGET_SX1302, r.addr, data, size) == LGW_COM_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
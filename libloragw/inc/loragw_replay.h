@@ -0,0 +1,142 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Record and replay of the traffic exchanged with the concentrator.
+    The accesses done through the com modules (SX1302, radios, SX1261) can be
+    recorded to a compact binary trace, which is then replayed in place of the
+    concentrator by the LGW_COM_REPLAY communication type: reads return the
+    recorded data, writes are checked against the recorded ones.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_REPLAY_H
+#define _LORAGW_REPLAY_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_com.h"
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_REPLAY_SUCCESS   0
+#define LGW_REPLAY_ERROR    -1
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@enum lgw_replay_op_t
+@brief Kind of a recorded access, the meaning of the address and data depends on it
+*/
+typedef enum {
+    LGW_REPLAY_W,           /* register write, data: value written */
+    LGW_REPLAY_R,           /* register read, data: value read */
+    LGW_REPLAY_RMW,         /* register read-modify-write, data: offset, length, value */
+    LGW_REPLAY_WB,          /* burst write, data: bytes written */
+    LGW_REPLAY_RB,          /* burst read, data: bytes read */
+    LGW_REPLAY_RB_MULTI,    /* one burst read of a multiple read, data: bytes read */
+    LGW_REPLAY_WRITE_MODE,  /* write mode change, address: lgw_com_write_mode_t */
+    LGW_REPLAY_FLUSH,       /* flush of the bulk writes */
+    LGW_REPLAY_SX1250_W,    /* SX1250 command, address: op code, data: parameters */
+    LGW_REPLAY_SX1250_R,    /* SX1250 read command, address: op code, data: answer */
+    LGW_REPLAY_SX125X_W,    /* SX125x register write, data: value written */
+    LGW_REPLAY_SX125X_R,    /* SX125x register read, data: value read */
+    LGW_REPLAY_SX1261_W,    /* SX1261 command, address: op code, data: parameters */
+    LGW_REPLAY_SX1261_R,    /* SX1261 read command, address: op code, data: answer */
+    LGW_REPLAY_TEMPERATURE, /* board temperature, data: float in degC (not ordered with the other accesses) */
+    LGW_REPLAY_OP_NB
+} lgw_replay_op_t;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Start recording the accesses done with the current board to a trace file
+@param path path of the trace file, overwritten if it exists
+@return LGW_REPLAY_SUCCESS if no error, LGW_REPLAY_ERROR otherwise
+*/
+int lgw_replay_record_start(const char * path);
+
+/**
+@brief Stop recording the accesses done with the current board, and close the trace file
+@return LGW_REPLAY_SUCCESS if no error, LGW_REPLAY_ERROR otherwise
+*/
+int lgw_replay_record_stop(void);
+
+/**
+@brief Append an access to the trace being recorded, if any (for the com modules only)
+@param op kind of access
+@param spi_mux_target SPI mux target of the access
+@param address register address or op code
+@param data data written or read
+@param size number of bytes of data
+@param status return code of the access
+*/
+void lgw_replay_log(lgw_replay_op_t op, uint8_t spi_mux_target, uint16_t address, const uint8_t * data, uint16_t size, int status);
+
+/**
+@brief Append a board temperature measurement to the trace being recorded, if any
+@param temperature temperature in degC
+*/
+void lgw_replay_log_temperature(float temperature);
+
+/**
+@brief Load a trace file to be replayed
+@param com_path path of the trace file
+@param com_target_ptr pointer on a generic pointer to the replay context
+@return LGW_REPLAY_SUCCESS if no error, LGW_REPLAY_ERROR otherwise
+*/
+int lgw_replay_open(const char * com_path, void ** com_target_ptr);
+
+/**
+@brief Release a replay context, and report the writes which differed from the trace
+@param com_target generic pointer to the replay context
+@return LGW_REPLAY_SUCCESS if no error, LGW_REPLAY_ERROR otherwise
+*/
+int lgw_replay_close(void * com_target);
+
+/**
+@brief Replay the next access of the trace
+@param com_target generic pointer to the replay context
+@param op kind of access, must match the next recorded one
+@param spi_mux_target SPI mux target, must match the next recorded one
+@param address register address or op code, must match the next recorded one
+@param data data to be checked (writes) or filled with the recorded data (reads)
+@param size number of bytes of data, must match the next recorded one
+@return the recorded status of the access, LGW_REPLAY_ERROR if it does not match the trace
+*/
+int lgw_replay_xfer(void * com_target, lgw_replay_op_t op, uint8_t spi_mux_target, uint16_t address, uint8_t * data, uint16_t size);
+
+/**
+@brief Get the maximum burst size of the recorded communication interface
+@param com_target generic pointer to the replay context
+@return the chunk size in bytes
+*/
+uint16_t lgw_replay_chunk_size(void * com_target);
+
+/**
+@brief Get the last temperature recorded before the current position in the trace
+@param com_target generic pointer to the replay context
+@param temperature pointer to the temperature in degC
+@return LGW_REPLAY_SUCCESS if no error, LGW_REPLAY_ERROR otherwise
+*/
+int lgw_replay_get_temperature(void * com_target, float * temperature);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
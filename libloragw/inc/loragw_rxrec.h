@@ -0,0 +1,110 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Recorder of the raw blocks fetched from the SX1302 RX buffer.
+    The bytes read by each fetch are copied to a ring buffer, and written to
+    rotating binary capture files by a background thread, for offline
+    analysis of the RX buffer parsing.
+
+    A capture file starts with a lgw_rxrec_file_hdr_s, followed by records
+    made of a lgw_rxrec_hdr_s and of the size bytes fetched. All the fields
+    are in the byte order of the host which wrote the file, given by the
+    endian field.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_RXREC_H
+#define _LORAGW_RXREC_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_RXREC_SUCCESS    0
+#define LGW_RXREC_ERROR     -1
+
+#define LGW_RXREC_RING_SIZE     (1 << 18)   /* bytes buffered for the writer thread, must be a power of 2 */
+#define LGW_RXREC_PERIOD_MS     20          /* time between two writes of the ring to the file */
+#define LGW_RXREC_FILE_NB_MAX   10          /* maximum number of files kept by the rotation */
+
+#define LGW_RXREC_MAGIC         "LGWRXRC"   /* NUL included, 8 bytes */
+#define LGW_RXREC_VERSION       1
+#define LGW_RXREC_ENDIAN        0x01020304  /* reads 0x04030201 in the other byte order */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_rxrec_file_hdr_s
+@brief Header at the start of each capture file
+*/
+struct lgw_rxrec_file_hdr_s {
+    char        magic[8];       /*!> LGW_RXREC_MAGIC */
+    uint32_t    version;        /*!> LGW_RXREC_VERSION */
+    uint32_t    endian;         /*!> LGW_RXREC_ENDIAN, written by the host */
+};
+
+/**
+@struct lgw_rxrec_hdr_s
+@brief Header of the record of one fetch
+*/
+struct lgw_rxrec_hdr_s {
+    int64_t     host_time_ns;   /*!> CLOCK_REALTIME at the end of the fetch, in ns */
+    uint16_t    size;           /*!> number of bytes fetched, following the header */
+    uint16_t    chip_size;      /*!> number of bytes waiting in the SX1302, above size if the fetch was split */
+    uint8_t     board;          /*!> index of the board fetched */
+    uint8_t     reserved[3];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Start recording the RX buffer fetches, and the thread writing them
+@param path path of the capture file, overwritten if it exists
+@param file_size_max size above which the file is rotated to path.1, path.2..., 0 to never rotate
+@param file_nb number of files kept by the rotation, including the current one [1..LGW_RXREC_FILE_NB_MAX]
+@return LGW_RXREC_SUCCESS if no error, LGW_RXREC_ERROR otherwise
+*/
+int lgw_rxrec_start(const char * path, uint32_t file_size_max, uint8_t file_nb);
+
+/**
+@brief Stop the writer thread, after the records pending are written, and close the file
+@return LGW_RXREC_SUCCESS if no error, LGW_RXREC_ERROR otherwise
+*/
+int lgw_rxrec_stop(void);
+
+/**
+@brief Record the bytes of a fetch, if the recording is started
+@brief Never blocks on the file, the record is dropped if the ring is full.
+@param board index of the board fetched
+@param data bytes fetched
+@param size number of bytes fetched
+@param chip_size number of bytes waiting in the SX1302 at the fetch
+*/
+void lgw_rxrec_put(uint8_t board, const uint8_t * data, uint16_t size, uint16_t chip_size);
+
+/**
+@brief Get the number of fetches not recorded because the ring buffer was full
+@return the number of records dropped since the recording was started
+*/
+uint32_t lgw_rxrec_dropped(void);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
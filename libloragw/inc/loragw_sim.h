@@ -0,0 +1,158 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Software model of a SX1302 concentrator with SX1250 radios, used by the
+    LGW_COM_SIM communication type to run the HAL and the packet forwarder
+    without hardware.
+    The model answers the AGC/ARB firmware handshakes, runs the timestamp
+    counter, fills the RX buffer with synthetic LoRa packets at a given rate,
+    and accepts TX requests.
+
+    The COM path gives the traffic profile, as a comma separated list of
+    <key>=<value> options (all optional):
+        rate=<float>    packets generated per second (default 10)
+        sf=<list>       spreading factors [5..12] (default 7-12)
+        chan=<list>     multi-SF channels [0..7] (default 0-7)
+        size=<min>-<max> payload size in bytes (default 16-51)
+        crc_bad=<pct>   percentage of packets with a bad CRC (default 0)
+        fifo=<bytes>    size of the RX buffer [512..8191] (default 4096)
+        seed=<uint>     seed of the pseudo-random generator (default 1)
+        chip=<model>    sx1302 or sx1303, which supports fine timestamping (default sx1302)
+        link_drop=<s>   the link drops every given number of seconds, all the
+                        accesses fail until it is reopened (default never)
+        link_reset=<0|1> the concentrator is reset during a link drop (default 0)
+    A list is a '/' separated list of values or ranges, each with an optional
+    weight: "7-12" is uniform, "7:6/8:3/9-12:1" favors SF7.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_SIM_H
+#define _LORAGW_SIM_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_com.h"
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_SIM_SUCCESS      0
+#define LGW_SIM_ERROR       -1
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Create a simulated concentrator
+@param com_path traffic profile options (see above)
+@param com_target_ptr pointer on a generic pointer to the simulated concentrator
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_open(const char * com_path, void ** com_target_ptr);
+
+/**
+@brief Release a simulated concentrator, and report its packet counters
+@param com_target generic pointer to the simulated concentrator
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_close(void * com_target);
+
+/**
+@brief Reopen the link to a simulated concentrator after a drop, its state is kept unless link_reset is set
+@param com_target generic pointer to the simulated concentrator
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_reopen(void * com_target);
+
+/**
+@brief Write bytes to the simulated SX1302
+@param com_target generic pointer to the simulated concentrator
+@param spi_mux_target SPI mux target, only LGW_SPI_MUX_TARGET_SX1302 is supported
+@param address first address to be written
+@param data data to be written
+@param size number of bytes to be written
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_wb(void * com_target, uint8_t spi_mux_target, uint16_t address, const uint8_t * data, uint16_t size);
+
+/**
+@brief Read bytes from the simulated SX1302
+@param com_target generic pointer to the simulated concentrator
+@param spi_mux_target SPI mux target, only LGW_SPI_MUX_TARGET_SX1302 is supported
+@param address first address to be read, the RX buffer is read as a FIFO
+@param data data read
+@param size number of bytes to be read
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_rb(void * com_target, uint8_t spi_mux_target, uint16_t address, uint8_t * data, uint16_t size);
+
+/**
+@brief Read-modify-write a register field of the simulated SX1302
+@param com_target generic pointer to the simulated concentrator
+@param spi_mux_target SPI mux target, only LGW_SPI_MUX_TARGET_SX1302 is supported
+@param address register address
+@param offs position of the field LSB
+@param leng number of bits of the field
+@param data field value
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_rmw(void * com_target, uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t leng, uint8_t data);
+
+/**
+@brief Send a command to a simulated SX1250 radio
+@param com_target generic pointer to the simulated concentrator
+@param spi_mux_target LGW_SPI_MUX_TARGET_RADIOA or LGW_SPI_MUX_TARGET_RADIOB
+@param op_code SX1250 command op code
+@param data command parameters, filled with the answer of read commands
+@param size number of bytes of parameters
+@param read true for a read command
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_radio_cmd(void * com_target, uint8_t spi_mux_target, uint8_t op_code, uint8_t * data, uint16_t size, bool read);
+
+/**
+@brief Set the write mode of the simulated link, the writes are applied at once in both modes
+@param com_target generic pointer to the simulated concentrator
+@param write_mode LGW_COM_WRITE_MODE_SINGLE or LGW_COM_WRITE_MODE_BULK
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_set_write_mode(void * com_target, lgw_com_write_mode_t write_mode);
+
+/**
+@brief End a bulk write sequence, as lgw_spi_flush() it fails in single write mode and restores it
+@param com_target generic pointer to the simulated concentrator
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_flush(void * com_target);
+
+/**
+@brief Get the maximum burst size accepted by the simulated concentrator
+@return the chunk size in bytes
+*/
+uint16_t lgw_sim_chunk_size(void);
+
+/**
+@brief Get the simulated board temperature
+@param com_target generic pointer to the simulated concentrator
+@param temperature pointer to the temperature in degC
+@return LGW_SIM_SUCCESS if no error, LGW_SIM_ERROR otherwise
+*/
+int lgw_sim_get_temperature(void * com_target, float * temperature);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,107 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Aggregation of the SX1261 spectral scan results over time.
+    The RSSI histogram of each scanned frequency is decimated and merged in a
+    rolling histogram of fixed size, from which percentiles are summarized.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_SPECTRAL_H
+#define _LORAGW_SPECTRAL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+#include "loragw_hal.h"
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_SPECTRAL_FREQ_NB_MAX    32  /* number of frequencies an aggregator can track */
+#define LGW_SPECTRAL_BIN_NB         (((LGW_SPECTRAL_SCAN_RESULT_SIZE - 1) / 2) + 1) /* 8 dB bins, and the one below the lowest level */
+#define LGW_SPECTRAL_HIST_ONE       32768 /* sum of the bins of a rolling histogram */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_spectral_freq_s
+@brief Rolling RSSI histogram of one frequency
+*/
+struct lgw_spectral_freq_s {
+    uint32_t    freq_hz;                    /*!> scanned frequency */
+    uint32_t    nb_scan;                    /*!> number of scans merged since the last summary */
+    uint32_t    nb_scan_total;              /*!> number of scans merged since the frequency is tracked */
+    int16_t     level_max;                  /*!> highest level with a sample since the last summary, in dBm */
+    uint16_t    hist[LGW_SPECTRAL_BIN_NB];  /*!> share of the samples in each bin, summing to LGW_SPECTRAL_HIST_ONE */
+};
+
+/**
+@struct lgw_spectral_agg_s
+@brief Aggregator of the spectral scans of several frequencies, fixed memory
+*/
+struct lgw_spectral_agg_s {
+    uint8_t     decay_shift;                /*!> a new scan weights 1/2^decay_shift in the rolling histogram */
+    uint8_t     nb_freq;                    /*!> number of frequencies tracked */
+    int16_t     level[LGW_SPECTRAL_BIN_NB]; /*!> lower level of each bin, in dBm, from the highest to the lowest */
+    struct lgw_spectral_freq_s freq[LGW_SPECTRAL_FREQ_NB_MAX];
+};
+
+/**
+@struct lgw_spectral_summary_s
+@brief Summary of the RSSI distribution of one frequency
+*/
+struct lgw_spectral_summary_s {
+    uint32_t    freq_hz;    /*!> scanned frequency */
+    uint32_t    nb_scan;    /*!> number of scans merged since the previous summary */
+    int16_t     p50;        /*!> median level of the rolling histogram, in dBm */
+    int16_t     p90;        /*!> level exceeded by 10% of the samples, in dBm */
+    int16_t     p99;        /*!> level exceeded by 1% of the samples, in dBm */
+    int16_t     max;        /*!> highest level seen since the previous summary, in dBm, the lowest level if no scan */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize an aggregator, with no frequency tracked
+@param agg the aggregator to be initialized
+@param decay_shift weight of a new scan, 1/2^decay_shift, 0 to only keep the latest scan
+*/
+void lgw_spectral_agg_init(struct lgw_spectral_agg_s * agg, uint8_t decay_shift);
+
+/**
+@brief Merge the results of a scan, as given by lgw_spectral_scan_get_results()
+@param agg the aggregator in which the scan is merged
+@param freq_hz frequency which has been scanned, tracked from its first scan
+@param levels_dbm levels of the histogram of the scan
+@param results number of samples in each level of the histogram of the scan
+@return LGW_HAL_SUCCESS, or LGW_HAL_ERROR if the scan is empty or too many frequencies are tracked
+*/
+int lgw_spectral_agg_merge(struct lgw_spectral_agg_s * agg, uint32_t freq_hz, const int16_t levels_dbm[static LGW_SPECTRAL_SCAN_RESULT_SIZE], const uint16_t results[static LGW_SPECTRAL_SCAN_RESULT_SIZE]);
+
+/**
+@brief Summarize the frequencies tracked, and start a new summary period
+@param agg the aggregator to be summarized
+@param summary array to return the summaries, in the order the frequencies were first scanned
+@param nb_max size of the summary array
+@return number of summaries written
+*/
+int lgw_spectral_agg_summary(struct lgw_spectral_agg_s * agg, struct lgw_spectral_summary_s * summary, int nb_max);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
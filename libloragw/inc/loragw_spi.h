@@ -24,6 +24,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include <stdint.h>        /* C99 types*/
 
+#include "loragw_com.h"
+
 #include "config.h"    /* library configuration options (dynamically generated) */
 
 /* -------------------------------------------------------------------------- */
@@ -108,6 +110,22 @@ int lgw_spi_rb(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8
  **/
 uint16_t lgw_spi_chunk_size(void);
 
+/**
+@brief Select the SPI write mode
+@brief In bulk mode, write frames are queued and sent together in a single ioctl
+@brief with CS toggled between frames; reads are not allowed until flushed
+@param write_mode LGW_COM_WRITE_MODE_SINGLE or LGW_COM_WRITE_MODE_BULK
+@return status of operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_set_write_mode(lgw_com_write_mode_t write_mode);
+
+/**
+@brief Send the write frames queued in bulk mode, and restore single write mode
+@param com_target generic pointer to SPI target (implementation dependant)
+@return status of operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_flush(void *com_target);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -86,6 +86,19 @@ typedef enum {
     RX_DFT_PEAK_MODE_AUTO        = 0x03
 } sx1302_rx_dft_peak_mode_t;
 
+/**
+@struct sx1302_tx_batch_s
+@brief Packet of a batch given to sx1302_send_batch, with the settings of its TX chain
+*/
+struct sx1302_tx_batch_s {
+    struct lgw_pkt_tx_s *       pkt;            /*!> packet to be sent, preamble may be adjusted to its allowed range */
+    lgw_radio_type_t            radio_type;     /*!> type of radio used by the TX chain */
+    const struct lgw_tx_gain_s * tx_gain;       /*!> TX gain LUT entry selected for the packet */
+    bool                        loaded;         /*!> the packet has been uploaded with sx1302_send_prepare, only the trigger is armed */
+    uint16_t                    start_delay;    /*!> TX start delay of a loaded packet, set when it is uploaded */
+    int                         err;            /*!> LGW_REG_SUCCESS if the packet has been sent, LGW_REG_ERROR otherwise */
+};
+
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
@@ -134,6 +147,13 @@ int sx1302_radio_clock_select(uint8_t rf_chain);
 */
 int sx1302_radio_reset(uint8_t rf_chain, lgw_radio_type_t type);
 
+/**
+@brief Apply the radio reset sequence to all the enabled RF chains at once, so that their reset delays overlap
+@param context_rf_chain The RF chains array from which to get RF chains current configuration
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_radio_reset_all(struct lgw_conf_rxrf_s * context_rf_chain);
+
 /**
 @brief Configure the radio type for the given RF chain
 @param rf_chain The RF chain index to be configured
@@ -154,9 +174,10 @@ int sx1302_radio_host_ctrl(bool host_ctrl);
 @param context_rf_chain The RF chains array from which to get RF chains current configuration
 @param clksrc           The RF chain index which provides the clock source
 @param txgain_lut       A pointer to the TX gain LUT to be filled
+@param temperature      The board temperature in degC, used to select sx125x cached calibration results (NULL if unknown)
 @return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
 */
-int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc, struct lgw_tx_gain_lut_s * txgain_lut);
+int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc, struct lgw_tx_gain_lut_s * txgain_lut, const float * temperature);
 
 /**
 @brief Configure the PA and LNA LUTs
@@ -187,6 +208,14 @@ uint8_t sx1302_get_ifmod_config(uint8_t if_chain);
 */
 int sx1302_channelizer_configure(struct lgw_conf_rxif_s * if_cfg, bool fix_gain);
 
+/**
+@brief Update the radio selection and the IF frequencies of the channelizer, while running
+@param if_cfg   A pointer to the channels configuration
+@param if_mask  Bitmask of the IF chains whose frequency is written (bit 0 for IF chain 0)
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_channelizer_update(struct lgw_conf_rxif_s * if_cfg, uint16_t if_mask);
+
 /**
 @brief Configure the correlator stage of the SX1302 LoRa multi-SF modems
 @param if_cfg       A pointer to the channels configuration
@@ -195,6 +224,14 @@ int sx1302_channelizer_configure(struct lgw_conf_rxif_s * if_cfg, bool fix_gain)
 */
 int sx1302_lora_correlator_configure(struct lgw_conf_rxif_s * if_cfg, struct lgw_conf_demod_s * demod_cfg);
 
+/**
+@brief Enable the correlators of the enabled LoRa multi-SF channels, for the selected spreading factors
+@param if_cfg       A pointer to the channels configuration
+@param demod_cfg    A pointer to the demodulators configuration
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_lora_correlator_enable(struct lgw_conf_rxif_s * if_cfg, struct lgw_conf_demod_s * demod_cfg);
+
 /**
 @brief Configure the correlator stage of the SX1302 LoRa single-SF modem
 @param cfg  A pointer to the channel configuration
@@ -239,6 +276,14 @@ int sx1302_fsk_configure(struct lgw_conf_rxif_s * cfg);
 */
 int sx1302_modem_enable(void);
 
+/**
+@brief Enable or disable the LoRa service and FSK modems, the LoRa multi-SF modems are left enabled
+@param lora_service true to enable the LoRa service modem
+@param fsk          true to enable the FSK modem
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_modem_select(bool lora_service, bool fsk);
+
 /**
 @brief Enable/Disable the GPS to allow PPS trigger and counter sampling
 @param enbale   Set to true to enable, false otherwise
@@ -249,9 +294,32 @@ int sx1302_gps_enable(bool enable);
 /**
 @brief Get the current SX1302 internal counter value
 @param pps      True for getting the counter value at last PPS
-@return the counter value in mciroseconds (32-bits)
+@return the counter value in mciroseconds, expanded to 64-bits
+*/
+uint64_t sx1302_timestamp_counter(bool pps);
+
+/**
+@brief Get the instantaneous counter, estimated from the last counter read if it is recent enough
+@param max_age_us   Maximum age of the last counter read to give an estimate, the counter is read otherwise
+@return the counter, expanded to 64-bits
 */
-uint32_t sx1302_timestamp_counter(bool pps);
+uint64_t sx1302_timestamp_counter_estimate(uint32_t max_age_us);
+
+/**
+@brief Get the instantaneous counter estimated from the last counter read, without accessing the concentrator (lock-free)
+@param max_age_us   Maximum age of the last counter read to give an estimate
+@param inst         Pointer to the estimated counter value
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR if no recent enough counter read is available
+*/
+int sx1302_timestamp_counter_snapshot(uint32_t max_age_us, uint64_t * inst);
+
+/**
+@brief Select how the firmwares loaded to the AGC and ARB MCUs are checked
+@param enable true to read back windows of the image in a single transfer, false to read back the whole image (default)
+
+The MCU memory parity is checked in both cases.
+*/
+void sx1302_fw_set_fast_check(bool enable);
 
 /**
 @brief Load firmware to AGC MCU memory
@@ -358,6 +426,24 @@ uint8_t sx1302_arb_get_debug_stats_alloc(uint8_t channel);
 */
 void sx1302_arb_print_debug_stats(void);
 
+/**
+@brief Accumulate the ARB detect and modem allocation counters, read in one transfer
+@param now_ns host monotonic time, in nanoseconds
+@param period_ms minimum time since the previous sample, 0 to always sample
+@return LGW_REG_ERROR if the counters could not be read, LGW_REG_SUCCESS otherwise
+
+The firmware counters wrap after 255 events, they must be sampled more often than that.
+*/
+int sx1302_arb_stats_update(int64_t now_ns, uint32_t period_ms);
+
+/**
+@brief Get the ARB detect and modem allocation counters, sampled first
+@param stats pointer to receive the counters
+@param reset set to true to clear the counters once copied
+@return LGW_REG_ERROR if the counters could not be read, LGW_REG_SUCCESS otherwise
+*/
+int sx1302_arb_get_stats(struct lgw_arb_stats_s * stats, bool reset);
+
 /**
 @brief TODO
 @param TODO
@@ -373,6 +459,20 @@ uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size);
 */
 int sx1302_fetch(uint8_t * nb_pkt);
 
+/**
+@brief Check if packets are waiting to be fetched, either in rx_buffer or in the SX1302 RX buffer.
+@param  pending A pointer to allocated memory to hold the result
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_rx_pending(bool * pending);
+
+/**
+@brief Derive the demodulation parameters of each IF chain from the configuration, used by sx1302_parse()
+@param context      Gateway configuration context
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_parse_configure(lgw_context_t * context);
+
 /**
 @brief Parse and return the next packet available in rx_buffer.
 @param context      Gateway configuration context
@@ -381,6 +481,14 @@ int sx1302_fetch(uint8_t * nb_pkt);
 */
 int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p);
 
+/**
+@brief Get the counters of the RX buffer fetches and parsing
+@param stats        The structure to get the counters
+@param reset        Set to true to clear the counters once copied
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_get_rx_stats(struct lgw_rx_stats_s * stats, bool reset);
+
 /**
 @brief Configure the delay to be applied by the SX1302 for TX to start
 @param rf_chain      RF chain index to be configured
@@ -435,7 +543,39 @@ int sx1302_tx_configure(lgw_radio_type_t radio_type);
 @param TODO
 @return TODO
 */
-int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data);
+int sx1302_send(lgw_radio_type_t radio_type, const struct lgw_tx_gain_s * tx_gain, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data);
+
+/**
+@brief Upload the modulation settings and the payload of a packet to its TX chain, without triggering it
+@param radio_type the type of radio used by the TX chain
+@param tx_gain the TX gain LUT entry selected for the packet
+@param lwan_public the LoRaWAN syncword selection
+@param context_fsk the FSK configuration, used for FSK syncword
+@param pkt_data the packet to be uploaded, preamble may be adjusted to its allowed range
+@param tx_start_delay the TX start delay programmed, to be given to sx1302_send_commit
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_send_prepare(lgw_radio_type_t radio_type, const struct lgw_tx_gain_s * tx_gain, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data, uint16_t * tx_start_delay);
+
+/**
+@brief Upload and trigger several packets, on different TX chains, in a single bulk transfer
+@param batch the packets to be sent, with the settings of their TX chain, err is set for each one
+@param nb_pkt the number of packets in batch
+@param lwan_public the LoRaWAN syncword selection
+@param context_fsk the FSK configuration, used for FSK syncword
+@return LGW_REG_SUCCESS if the transfer has been done, LGW_REG_ERROR otherwise
+*/
+int sx1302_send_batch(struct sx1302_tx_batch_s * batch, uint8_t nb_pkt, bool lwan_public, struct lgw_conf_rxif_s * context_fsk);
+
+/**
+@brief Arm the trigger of a packet previously uploaded with sx1302_send_prepare
+@param rf_chain the TX chain on which the packet has been uploaded
+@param tx_mode IMMEDIATE, TIMESTAMPED or ON_GPS
+@param count_us the emission time of the packet, for TIMESTAMPED mode
+@param tx_start_delay the TX start delay returned by sx1302_send_prepare
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_send_commit(uint8_t rf_chain, uint8_t tx_mode, uint32_t count_us, uint16_t tx_start_delay);
 
 /**
 @brief TODO
@@ -444,6 +584,14 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
 */
 int sx1302_set_gpio(uint8_t gpio_reg_val);
 
+/**
+@brief Check that the SX1302 kept running with its configuration, after a COM link error
+@param max_age_us   maximum age of the last timestamp counter read, for the counter to be checked
+@param tolerance_us maximum difference of the counter with its expected value
+@return LGW_REG_SUCCESS if the configuration, AGC firmware and counter are as left, LGW_REG_ERROR otherwise
+*/
+int sx1302_check_running(uint32_t max_age_us, uint32_t tolerance_us);
+
 /**
 @brief TODO
 @param TODO
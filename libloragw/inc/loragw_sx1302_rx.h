@@ -26,9 +26,49 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
+/* RX buffer packet structure */
+#define SX1302_PKT_SYNCWORD_BYTE_0  0xA5
+#define SX1302_PKT_SYNCWORD_BYTE_1  0xC0
+#define SX1302_PKT_HEAD_METADATA    9
+#define SX1302_PKT_TAIL_METADATA    14
+
+/* modem IDs */
+#define SX1302_LORA_MODEM_ID_MAX    15
+#define SX1302_LORA_STD_MODEM_ID    16
+#define SX1302_FSK_MODEM_ID         17
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
+/* Fields of a packet in the RX buffer (TAKE_N_BITS_FROM from loragw_aux.h), tail fields are indexed from start_index + payload length */
+#define SX1302_PKT_PAYLOAD_LENGTH(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index +  2], 0, 8)
+#define SX1302_PKT_CHANNEL(buffer, start_index)                 TAKE_N_BITS_FROM(buffer[start_index +  3], 0, 8)
+#define SX1302_PKT_CRC_EN(buffer, start_index)                  TAKE_N_BITS_FROM(buffer[start_index +  4], 0, 1)
+#define SX1302_PKT_CODING_RATE(buffer, start_index)             TAKE_N_BITS_FROM(buffer[start_index +  4], 1, 3)
+#define SX1302_PKT_DATARATE(buffer, start_index)                TAKE_N_BITS_FROM(buffer[start_index +  4], 4, 4)
+#define SX1302_PKT_MODEM_ID(buffer, start_index)                TAKE_N_BITS_FROM(buffer[start_index +  5], 0, 8)
+#define SX1302_PKT_FREQ_OFFSET_7_0(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index +  6], 0, 8)
+#define SX1302_PKT_FREQ_OFFSET_15_8(buffer, start_index)        TAKE_N_BITS_FROM(buffer[start_index +  7], 0, 8)
+#define SX1302_PKT_FREQ_OFFSET_19_16(buffer, start_index)       TAKE_N_BITS_FROM(buffer[start_index +  8], 0, 4)
+#define SX1302_PKT_CRC_ERROR(buffer, start_index)               TAKE_N_BITS_FROM(buffer[start_index +  9], 0, 1)
+#define SX1302_PKT_SYNC_ERROR(buffer, start_index)              TAKE_N_BITS_FROM(buffer[start_index +  9], 2, 1)
+#define SX1302_PKT_HEADER_ERROR(buffer, start_index)            TAKE_N_BITS_FROM(buffer[start_index +  9], 3, 1)
+#define SX1302_PKT_TIMING_SET(buffer, start_index)              TAKE_N_BITS_FROM(buffer[start_index +  9], 4, 1)
+#define SX1302_PKT_SNR_AVG(buffer, start_index)                 TAKE_N_BITS_FROM(buffer[start_index + 10], 0, 8)
+#define SX1302_PKT_RSSI_CHAN(buffer, start_index)               TAKE_N_BITS_FROM(buffer[start_index + 11], 0, 8)
+#define SX1302_PKT_RSSI_SIG(buffer, start_index)                TAKE_N_BITS_FROM(buffer[start_index + 12], 0, 8)
+#define SX1302_PKT_RSSI_CHAN_MAX_NEG_DELTA(buffer, start_index) TAKE_N_BITS_FROM(buffer[start_index + 13], 0, 4)
+#define SX1302_PKT_RSSI_CHAN_MAX_POS_DELTA(buffer, start_index) TAKE_N_BITS_FROM(buffer[start_index + 13], 4, 4)
+#define SX1302_PKT_RSSI_SIG_MAX_NEG_DELTA(buffer, start_index)  TAKE_N_BITS_FROM(buffer[start_index + 14], 0, 4)
+#define SX1302_PKT_RSSI_SIG_MAX_POS_DELTA(buffer, start_index)  TAKE_N_BITS_FROM(buffer[start_index + 14], 4, 4)
+#define SX1302_PKT_TIMESTAMP_7_0(buffer, start_index)           TAKE_N_BITS_FROM(buffer[start_index + 15], 0, 8)
+#define SX1302_PKT_TIMESTAMP_15_8(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index + 16], 0, 8)
+#define SX1302_PKT_TIMESTAMP_23_16(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 17], 0, 8)
+#define SX1302_PKT_TIMESTAMP_31_24(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 18], 0, 8)
+#define SX1302_PKT_CRC_PAYLOAD_7_0(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 19], 0, 8)
+#define SX1302_PKT_CRC_PAYLOAD_15_8(buffer, start_index)        TAKE_N_BITS_FROM(buffer[start_index + 20], 0, 8)
+#define SX1302_PKT_NUM_TS_METRICS(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index + 21], 0, 8)
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC TYPES --------------------------------------------------------- */
 
@@ -44,7 +84,7 @@ typedef struct rx_packet_s {
     uint8_t     rx_rate_sf;                 /* LoRa only */
     uint8_t     modem_id;
     int32_t     frequency_offset_error;     /* LoRa only */
-    uint8_t     payload[255];
+    const uint8_t * payload;                /* view on the payload in rx_buffer, valid until next fetch */
     bool        payload_crc_error;
     bool        sync_error;                 /* LoRa only */
     bool        header_error;               /* LoRa only */
@@ -71,8 +111,12 @@ typedef struct rx_packet_s {
 typedef struct rx_buffer_s {
     uint8_t buffer[4096];   /*!> byte array to hald the data fetched from the RX buffer */
     uint16_t buffer_size;   /*!> The number of bytes currently stored in the buffer */
+    uint16_t fetch_size;    /*!> The number of bytes read by the last fetch, kept if they are discarded */
+    uint16_t chip_size;     /*!> The number of bytes waiting in the SX1302 at the last fetch, above fetch_size if it was split */
     int buffer_index;       /*!> Current parsing index in the buffer */
     uint8_t buffer_pkt_nb;
+    uint16_t tail_index;    /*!> Start of the incomplete packet left after the packets counted, when the fetch was split */
+    uint16_t tail_size;     /*!> Number of bytes of this incomplete packet, completed by the next fetch, 0 if none */
 } rx_buffer_t;
 
 /* -------------------------------------------------------------------------- */
@@ -92,8 +136,17 @@ int rx_buffer_new(rx_buffer_t * self);
 */
 int rx_buffer_del(rx_buffer_t * self);
 
+/**
+@brief Move the incomplete packet left by a split fetch at the start of a buffer, to be completed by its next fetch
+@param self     A pointer to a rx_buffer handler, initialized with rx_buffer_new()
+@param from     A pointer to the rx_buffer handler holding the incomplete packet, can be self
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int rx_buffer_carry(rx_buffer_t * self, rx_buffer_t * from);
+
 /**
 @brief Fetch packets from the SX1302 internal RX buffer, and count packets available.
+@brief The fetch is split if the buffer space is not enough, the packet left incomplete is then kept for the next fetch.
 @param self     A pointer to a rx_buffer handler
 @return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
 */
@@ -101,6 +154,7 @@ int rx_buffer_fetch(rx_buffer_t * self);
 
 /**
 @brief Parse the rx_buffer and return the first packet available in the given structure.
+@brief The payload is not copied, the packet points to it in the rx_buffer.
 @param self     A pointer to a rx_buffer handler
 @param pkt      A pointer to the structure to receive the packet parsed
 @return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
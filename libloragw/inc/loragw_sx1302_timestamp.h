@@ -48,10 +48,16 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 struct timestamp_info_s {
     uint32_t counter_us_27bits_ref;     /* reference value (last read) */
     uint8_t  counter_us_27bits_wrap;    /* rollover/wrap status */
+    uint32_t counter_us_27bits_wrap_nb; /* number of rollovers since the start, for the 64-bits counter */
 };
 typedef struct timestamp_counter_s {
     struct timestamp_info_s inst; /* holds current reference of the instantaneous counter */
     struct timestamp_info_s pps;  /* holds current reference of the pps-trigged counter */
+    /* last instantaneous counter read, published through a seqlock to readers not holding the concentrator lock */
+    uint32_t snap_seq;            /* odd while being updated, 0 if nothing published yet */
+    uint32_t snap_inst_us;        /* counter read, expanded to 64-bits: low 32-bits */
+    uint32_t snap_inst_us_hi;     /* counter read, expanded to 64-bits: high 32-bits */
+    uint32_t snap_host_us;        /* host monotonic time of the read (wraps on a uint32_t) */
 } timestamp_counter_t;
 
 /* -------------------------------------------------------------------------- */
@@ -97,6 +103,23 @@ uint32_t timestamp_counter_expand(timestamp_counter_t * self, bool pps, uint32_t
 */
 uint32_t timestamp_pkt_expand(timestamp_counter_t * self, uint32_t cnt_us);
 
+/**
+@brief Convert the 27-bits counter given by the SX1302 to a 64-bits counter, which does not wrap
+@param self     Pointer to the counter handler
+@param pps      Set to true to expand the counter based on the PPS trig wrapping status
+@param cnt_us   The 27-bits counter to be expanded
+@return the 64-bits counter, its 32 LSBs are the value given by timestamp_counter_expand()
+*/
+uint64_t timestamp_counter_expand64(timestamp_counter_t * self, bool pps, uint32_t cnt_us);
+
+/**
+@brief Convert the 27-bits packet timestamp to a 64-bits counter, which does not wrap
+@param self     Pointer to the counter handler
+@param cnt_us   The packet 27-bits counter to be expanded
+@return the 64-bits counter, its 32 LSBs are the value given by timestamp_pkt_expand()
+*/
+uint64_t timestamp_pkt_expand64(timestamp_counter_t * self, uint32_t cnt_us);
+
 /**
 @brief Reads the SX1302 internal counter register, and return the 32-bits 1 MHz counter
 @param self     Pointer to the counter handler
@@ -106,6 +129,34 @@ uint32_t timestamp_pkt_expand(timestamp_counter_t * self, uint32_t cnt_us);
 */
 int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t * pps);
 
+/**
+@brief Same as timestamp_counter_get, with the counters expanded to 64-bits
+@param self     Pointer to the counter handler
+@param inst     Current value of the freerun counter
+@param pps      Current value of the PPS counter
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int timestamp_counter_get64(timestamp_counter_t * self, uint64_t * inst, uint64_t * pps);
+
+/**
+@brief Estimate the current 32-bits 1 MHz instantaneous counter from the last read and the host monotonic clock
+@brief Lock-free, it can be called while another thread is accessing the concentrator
+@param self         Pointer to the counter handler
+@param max_age_us   Maximum time elapsed since the last read for the estimate to be given
+@param inst         Estimated value of the freerun counter
+@return 0 if the estimate is given, -1 if the counter has to be read again
+*/
+int timestamp_counter_estimate(timestamp_counter_t * self, uint32_t max_age_us, uint32_t * inst);
+
+/**
+@brief Same as timestamp_counter_estimate, with the counter expanded to 64-bits
+@param self         Pointer to the counter handler
+@param max_age_us   Maximum time elapsed since the last read for the estimate to be given
+@param inst         Estimated value of the freerun counter
+@return 0 if the estimate is given, -1 if the counter has to be read again
+*/
+int timestamp_counter_estimate64(timestamp_counter_t * self, uint32_t max_age_us, uint64_t * inst);
+
 /**
 @brief Get the correction to applied to the LoRa packet timestamp (count_us)
 @param context          gateway configuration context
@@ -119,6 +170,19 @@ int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t
 */
 int32_t timestamp_counter_correction(lgw_context_t * context, uint8_t bandwidth, uint8_t datarate, uint8_t coderate, bool crc_en, uint8_t payload_length, sx1302_rx_dft_peak_mode_t dft_peak_mode);
 
+/**
+@brief Precompute the timestamp corrections of all the LoRa packets which can be received with the given configuration
+@brief timestamp_counter_correction() then only looks them up
+@param context  gateway configuration context, channels and precision timestamp configured
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int timestamp_correction_table_init(lgw_context_t * context);
+
+/**
+@brief Release the precomputed timestamp corrections, they will be computed for each packet
+*/
+void timestamp_correction_table_free(void);
+
 /**
 @brief Configure the SX1302 to output legacy timestamp or precision timestamp
 @note  Legacy timestamp gives a timestamp latched at the end of the packet
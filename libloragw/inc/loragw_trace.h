@@ -0,0 +1,133 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Lightweight binary trace log for the HAL hot paths.
+    Events are stored as fixed-size records in a per-thread lock-free ring
+    buffer, and decoded to text later by a separate thread.
+    Tracing is enabled per module at compile time (TRACE_* in library.cfg),
+    disabled trace points are removed by the compiler.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_TRACE_H
+#define _LORAGW_TRACE_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* FILE */
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_TRACE_SUCCESS    0
+#define LGW_TRACE_ERROR     -1
+
+#define LGW_TRACE_ARG_NB        5   /* number of 32-bit arguments in a record */
+#define LGW_TRACE_RING_SIZE     512 /* number of records per thread ring buffer, must be a power of 2 */
+#define LGW_TRACE_THREAD_NB_MAX 8   /* maximum number of threads which can emit trace records */
+
+/* Trace levels, to be compared with the TRACE_* module options */
+#define LGW_TRACE_LVL_EVENT     1   /* unfrequent events (fetch, send, errors) */
+#define LGW_TRACE_LVL_PACKET    2   /* per-packet records */
+
+/* At least one library module has tracing compiled in */
+#define LGW_TRACE_ENABLED ((TRACE_HAL > 0) || (TRACE_SX1302 > 0))
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@enum lgw_trace_id_t
+@brief Identifier of a trace record, used to select the decoding format
+*/
+typedef enum {
+    LGW_TRACE_HAL_RX_FETCH,     /* nb_fetched, max_pkt */
+    LGW_TRACE_HAL_RX_PKT,       /* index, freq_hz, rssic*10, snr*10, size | (status << 16) */
+    LGW_TRACE_HAL_RX_PAYLOAD,   /* index, size, payload[0..3], payload[4..7], payload[8..11] */
+    LGW_TRACE_HAL_TX_PKT,       /* freq_hz, count_us, rf_power, (modulation << 16) | datarate, size */
+    LGW_TRACE_SX1302_RX_FETCH,  /* buffer size, nb_pkt */
+    LGW_TRACE_SX1302_RX_RESYNC, /* number of bytes skipped to find a syncword, buffer size */
+    LGW_TRACE_FWD_PUSH_DATA,    /* token, nb_pkt in datagram, datagram size */
+    LGW_TRACE_ID_NB
+} lgw_trace_id_t;
+
+/**
+@struct lgw_trace_rec_s
+@brief Fixed-size binary trace record
+*/
+struct lgw_trace_rec_s {
+    uint64_t    ts_ns;                      /*!> monotonic time at which the record was emitted, in ns */
+    uint16_t    id;                         /*!> record identifier (lgw_trace_id_t) */
+    uint16_t    thread;                     /*!> index of the emitting thread ring */
+    uint32_t    args[LGW_TRACE_ARG_NB];     /*!> record arguments, meaning depends on id */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC MACROS -------------------------------------------------------- */
+
+/**
+@brief Emit a trace record if LEVEL is enabled, compiled out otherwise
+@param ENABLED compile-time condition, eg. (TRACE_HAL >= LGW_TRACE_LVL_PACKET)
+@param ID record identifier
+@param A0..A4 record arguments, cast to uint32_t
+*/
+#define LGW_TRACE(ENABLED, ID, A0, A1, A2, A3, A4)                                                  \
+    do {                                                                                            \
+        if (ENABLED) {                                                                              \
+            lgw_trace_put((ID), (uint32_t)(A0), (uint32_t)(A1), (uint32_t)(A2), (uint32_t)(A3), (uint32_t)(A4)); \
+        }                                                                                           \
+    } while (0)
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Store a trace record in the ring buffer of the calling thread.
+@brief Never blocks nor does any system call, the record is dropped if the ring is full.
+@param id record identifier
+@param a0..a4 record arguments
+*/
+void lgw_trace_put(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4);
+
+/**
+@brief Decode pending records of all threads to the given file
+@param file output file for decoded records
+@return the number of records decoded
+*/
+int lgw_trace_flush(FILE * file);
+
+/**
+@brief Start the thread decoding trace records in background
+@param file output file for decoded records
+@param period_ms time between two flushes of the rings, in milliseconds
+@return LGW_TRACE_SUCCESS if no error, LGW_TRACE_ERROR otherwise
+*/
+int lgw_trace_start(FILE * file, uint32_t period_ms);
+
+/**
+@brief Stop the trace decoding thread, after a last flush
+@return LGW_TRACE_SUCCESS if no error, LGW_TRACE_ERROR otherwise
+*/
+int lgw_trace_stop(void);
+
+/**
+@brief Get the number of records dropped because a ring buffer was full
+@return the total number of records dropped since start
+*/
+uint32_t lgw_trace_dropped(void);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -33,6 +33,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define LGW_USB_SUCCESS     0
 #define LGW_USB_ERROR       -1
 
+#define LGW_USB_PIPELINE_DEPTH  4   /* max number of requests sent to the MCU before reading their ACK, 1 for synchronous mode */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
@@ -48,6 +50,14 @@ int lgw_usb_open(const char * com_path, void **com_target_ptr);
 
 int lgw_usb_close(void *com_target);
 
+/**
+@brief Close and open again the tty of the MCU after a link error, without resetting the SX1302
+@param com_path     path of the tty
+@param com_target   generic pointer to the USB device, updated with the new file descriptor
+@return LGW_USB_SUCCESS if the MCU answers again, LGW_USB_ERROR otherwise
+*/
+int lgw_usb_reopen(const char * com_path, void *com_target);
+
 /**
  *
 */
@@ -68,6 +78,15 @@ int lgw_usb_wb(void *com_target, uint8_t spi_mux_target, uint16_t address, const
 */
 int lgw_usb_rb(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t size);
 
+/**
+@brief Do several burst reads with a single REQ_MULTIPLE_SPI command (one USB round-trip)
+@param com_target USB device file descriptor
+@param req array of read requests
+@param nb_req number of requests in the array
+@return LGW_USB_SUCCESS if no error, LGW_USB_ERROR otherwise
+*/
+int lgw_usb_rb_multi(void *com_target, struct lgw_com_rb_s * req, uint8_t nb_req);
+
 /**
  *
 */
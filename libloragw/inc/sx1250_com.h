@@ -41,6 +41,25 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 int sx1250_com_w(lgw_com_type_t com_type, void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_code, uint8_t *data, uint16_t size);
 int sx1250_com_r(lgw_com_type_t com_type, void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_code, uint8_t *data, uint16_t size);
 
+/**
+@brief Select if the radio commands are written one by one, or grouped until sx1250_com_flush
+@param com_type communication link of the concentrator
+@param write_mode LGW_COM_WRITE_MODE_BULK to group the writes, reads are then refused on USB
+@return LGW_COM_SUCCESS, or LGW_COM_ERROR
+
+Only the USB link groups the commands, in a single MCU request, they are written
+straight away on the other links.
+*/
+int sx1250_com_set_write_mode(lgw_com_type_t com_type, lgw_com_write_mode_t write_mode);
+
+/**
+@brief Write the radio commands grouped in bulk mode, and restore the single mode
+@param com_type communication link of the concentrator
+@param com_target target of the communication link
+@return LGW_COM_SUCCESS, or LGW_COM_ERROR
+*/
+int sx1250_com_flush(lgw_com_type_t com_type, void *com_target);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
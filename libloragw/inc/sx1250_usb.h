@@ -21,6 +21,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include <stdint.h>     /* C99 types*/
 
+#include "loragw_com.h"
 #include "sx1250_defs.h"
 
 #include "config.h"     /* library configuration options (dynamically generated) */
@@ -40,6 +41,20 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 int sx1250_usb_w(void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_code, uint8_t *data, uint16_t size);
 int sx1250_usb_r(void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_code, uint8_t *data, uint16_t size);
 
+/**
+@brief Select if the radio commands are written one by one, or stored in the MCU bulk request
+@param write_mode LGW_COM_WRITE_MODE_BULK to store them until sx1250_usb_flush, reads are then refused
+@return 0 for SUCCESS, -1 for failure
+*/
+int sx1250_usb_set_write_mode(lgw_com_write_mode_t write_mode);
+
+/**
+@brief Send the radio commands stored in bulk mode in a single MCU request, and restore the single mode
+@param com_target pointer to the USB device file descriptor
+@return 0 for SUCCESS, -1 for failure
+*/
+int sx1250_usb_flush(void *com_target);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
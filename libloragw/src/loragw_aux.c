@@ -25,10 +25,10 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include <stdio.h>  /* printf fprintf */
 #include <time.h>   /* clock_nanosleep */
-#include <math.h>   /* pow, ceil */
 
 #include "loragw_aux.h"
 #include "loragw_hal.h"
+#include "loragw_perf.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -41,6 +41,11 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
     #define DEBUG_PRINTF(fmt, args...)
 #endif
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+__thread uint8_t lgw_board_cur = 0;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -94,7 +99,7 @@ uint32_t lora_packet_time_on_air(const uint8_t bw, const uint8_t sf, const uint8
     uint8_t H, DE, n_bit_crc;
     uint8_t bw_pow;
     uint16_t t_symbol_us;
-    double n_symbol;
+    int32_t n_bit_payload, n_bit_symbol;
     uint32_t toa_us, n_symbol_payload;
 
     /* Check input parameters */
@@ -128,29 +133,26 @@ uint32_t lora_packet_time_on_air(const uint8_t bw, const uint8_t sf, const uint8
     }
 
     /* Duration of 1 symbol */
-    t_symbol_us = (1 << sf) * 8 / bw_pow; /* 2^SF / BW , in microseconds */
+    t_symbol_us = (1 << sf) * 8 / bw_pow; /* 2^SF / BW , in microseconds, multiple of 4 */
 
     /* Packet parameters */
     H = (no_header == false) ? 1 : 0; /* header is always enabled, except for beacons */
     DE = (sf >= 11) ? 1 : 0; /* Low datarate optimization enabled for SF11 and SF12 */
     n_bit_crc = (no_crc == false) ? 16 : 0;
 
-    /* Number of symbols in the payload */
-    n_symbol_payload = ceil( MAX( (double)( 8 * size + n_bit_crc - 4*sf + ((sf >= 7) ? 8 : 0) + 20*H ), 0.0) /
-                                  (double)( 4 * (sf - 2*DE)) )
-                       * ( cr + 4 ); /* Explicitely cast to double to keep precision of the division */
+    /* Number of symbols in the payload, integer ceiling of the number of coded blocks */
+    n_bit_payload = MAX(8 * size + n_bit_crc - 4 * sf + ((sf >= 7) ? 8 : 0) + 20 * H, 0);
+    n_bit_symbol = 4 * (sf - 2 * DE);
+    n_symbol_payload = ((n_bit_payload + n_bit_symbol - 1) / n_bit_symbol) * (cr + 4);
 
-    /* number of symbols in packet */
-    n_symbol = (double)n_symbol_preamble + ((sf >= 7) ? 4.25 : 6.25) + 8.0 + (double)n_symbol_payload;
+    /* Duration of packet in microseconds: preamble + 4.25 (or 6.25 for SF5/SF6) + 8 + payload symbols */
+    toa_us = ((uint32_t)n_symbol_preamble + 8 + n_symbol_payload) * t_symbol_us + ((sf >= 7) ? 17 : 25) * (t_symbol_us / 4);
 
-    /* Duration of packet in microseconds */
-    toa_us = (uint32_t)( (double)n_symbol * (double)t_symbol_us );
-
-    DEBUG_PRINTF("INFO: LoRa packet ToA: %u us (n_symbol:%f, t_symbol_us:%u)\n", toa_us, n_symbol, t_symbol_us);
+    DEBUG_PRINTF("INFO: LoRa packet ToA: %u us (n_symbol_payload:%u, t_symbol_us:%u)\n", toa_us, n_symbol_payload, t_symbol_us);
 
     /* Return details if required */
     if (out_nb_symbols != NULL) {
-        *out_nb_symbols = n_symbol;
+        *out_nb_symbols = (double)n_symbol_preamble + ((sf >= 7) ? 4.25 : 6.25) + 8.0 + (double)n_symbol_payload;
     }
     if (out_nb_symbols_payload != NULL) {
         *out_nb_symbols_payload = n_symbol_payload;
@@ -164,27 +166,46 @@ uint32_t lora_packet_time_on_air(const uint8_t bw, const uint8_t sf, const uint8
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int64_t time_monotonic_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
-void _meas_time_start(struct timeval *tm)
+void _meas_time_start(int64_t *tm)
 {
-#if (DEBUG_PERF > 0) && (DEBUG_PERF <= 5)
-    gettimeofday(tm, NULL);
-#endif
+    if ((DEBUG_PERF > 0) || lgw_perf_is_enabled()) {
+        *tm = time_monotonic_ns();
+    } else {
+        *tm = -1; /* not measured */
+    }
 }
 
-void _meas_time_stop(int debug_level, struct timeval start_time, const char *str)
+void _meas_time_stop(int debug_level, int64_t start_time, const char *str)
 {
+    int64_t time_ns;
 #if (DEBUG_PERF > 0) && (DEBUG_PERF <= 5)
-    struct timeval tm;
-    double time_ms;
     char *indent[] = { "", " ..", " ....", " ......", " ........" };
+#endif
 
-    gettimeofday(&tm, NULL);
+    if (start_time < 0) {
+        return;
+    }
+    time_ns = time_monotonic_ns() - start_time;
 
-    time_ms = (tm.tv_sec - start_time.tv_sec) * 1000.0 + (tm.tv_usec - start_time.tv_usec) / 1000.0;
+    if (lgw_perf_is_enabled()) {
+        lgw_perf_record(str, (uint64_t)time_ns);
+    }
+
+#if (DEBUG_PERF > 0) && (DEBUG_PERF <= 5)
     if ((debug_level > 0) && (debug_level <= DEBUG_PERF)) {
-        printf("PERF:%s %s %f ms\n", indent[debug_level - 1], str, time_ms);
+        printf("PERF:%s %s %f ms\n", indent[debug_level - 1], str, time_ns / 1000000.0);
     }
 #endif
 }
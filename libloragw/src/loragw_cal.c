@@ -17,8 +17,10 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include <stdint.h>     /* C99 types */
-#include <stdio.h>      /* printf fprintf */
-#include <math.h>       /* log10 */
+#include <stdio.h>      /* printf fprintf fopen rename */
+#include <string.h>     /* memset memcpy strlen */
+#include <time.h>       /* time */
+#include <math.h>       /* log10 floor */
 
 #include "loragw_reg.h"
 #include "loragw_aux.h"
@@ -51,14 +53,61 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define CAL_TX_TONE_FREQ_HZ     250000
 #define CAL_ITER                3 /* Number of calibration iterations */
+#define CAL_ITER_FAST           2 /* Minimum number of calibration iterations in fast mode */
 #define CAL_TX_CORR_DURATION    0 /* 0:1ms, 1:2ms, 2:4ms, 3:8ms */
 
+#define CAL_CACHE_MAGIC         "LGWC"
+#define CAL_CACHE_VERSION       1
+#define CAL_CACHE_ENTRY_NB      8 /* Number of calibration conditions kept in the cache file */
+#define CAL_CACHE_PATH_MAX      256
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES -------------------------------------------- */
 
 /* Record Rx IQ mismatch corrections from calibration */
-static int8_t rf_rx_image_amp[LGW_RF_CHAIN_NB] = {0, 0};
-static int8_t rf_rx_image_phi[LGW_RF_CHAIN_NB] = {0, 0};
+static int8_t rf_rx_image_amp_board[LGW_BOARD_NB_MAX][LGW_RF_CHAIN_NB] = {{0, 0}};
+static int8_t rf_rx_image_phi_board[LGW_BOARD_NB_MAX][LGW_RF_CHAIN_NB] = {{0, 0}};
+#define rf_rx_image_amp rf_rx_image_amp_board[lgw_board_cur]
+#define rf_rx_image_phi rf_rx_image_phi_board[lgw_board_cur]
+
+/* Results of the last successful calibration, to be saved in the cache */
+struct cal_result_s {
+    bool valid;
+    int8_t rx_amp[LGW_RF_CHAIN_NB];
+    int8_t rx_phi[LGW_RF_CHAIN_NB];
+    uint8_t nb_tx[LGW_RF_CHAIN_NB];
+    struct lgw_sx125x_cal_tx_result_s tx[LGW_RF_CHAIN_NB][TX_GAIN_LUT_SIZE_MAX];
+};
+static struct cal_result_s cal_last_board[LGW_BOARD_NB_MAX];
+#define cal_last cal_last_board[lgw_board_cur]
+
+/* Fast mode: stop iterating as soon as the results are consistent and good enough */
+static bool cal_fast_mode = false;
+
+/* Calibration cache file, common to all boards (entries are keyed by chip EUI) */
+static char cal_cache_file[CAL_CACHE_PATH_MAX] = "";
+
+struct cal_cache_key_s {
+    uint64_t eui;
+    uint32_t freq_hz[LGW_RF_CHAIN_NB];
+    uint8_t type[LGW_RF_CHAIN_NB];
+    uint8_t enable[LGW_RF_CHAIN_NB];
+    uint8_t tx_enable[LGW_RF_CHAIN_NB];
+    int8_t temp_band; /* INT8_MIN if the temperature was unknown */
+};
+
+struct cal_cache_entry_s {
+    struct cal_cache_key_s key;
+    int64_t time; /* wall-clock time of the calibration, 0 for an unused entry */
+    struct cal_result_s res;
+};
+
+struct cal_cache_header_s {
+    char magic[4];
+    uint16_t version;
+    uint16_t nb_entry;
+    uint32_t entry_size;
+};
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
@@ -73,6 +122,9 @@ void cal_tx_result_sort(struct lgw_sx125x_cal_tx_result_s *res_tx, struct lgw_sx
 bool cal_tx_result_assert(struct lgw_sx125x_cal_tx_result_s *res_tx_min, struct lgw_sx125x_cal_tx_result_s *res_tx_max);
 int sx125x_cal_tx_dc_offset(uint8_t rf_chain, uint32_t freq_hz, uint8_t dac_gain, uint8_t mix_gain, uint8_t radio_type, struct lgw_sx125x_cal_tx_result_s * res);
 
+static void cal_cache_key(struct cal_cache_key_s * key, uint64_t eui, const float * temperature, struct lgw_conf_rxrf_s * rf_chain_cfg);
+static int cal_cache_read(struct cal_cache_entry_s * entries);
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -82,6 +134,7 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
     bool cal_status = false;
     uint8_t x_max;
     int x_max_idx;
+    int nb_iter = 0;
     uint8_t dac_gain[LGW_RF_CHAIN_NB][TX_GAIN_LUT_SIZE_MAX];
     uint8_t mix_gain[LGW_RF_CHAIN_NB][TX_GAIN_LUT_SIZE_MAX];
     int8_t offset_i[LGW_RF_CHAIN_NB][TX_GAIN_LUT_SIZE_MAX];
@@ -115,9 +168,13 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
             /* Calibration using the other radio for Tx */
             if (rf_chain_cfg[0].type == rf_chain_cfg[1].type) {
                 cal_rx_result_init(&cal_rx_min, &cal_rx_max);
-                for (j = 0; j < CAL_ITER; j++) {
-                    sx125x_cal_rx_image(i, rf_chain_cfg[i].freq_hz, false, rf_chain_cfg[i].type, &cal_rx[j]);
-                    cal_rx_result_sort(&cal_rx[j], &cal_rx_min, &cal_rx_max);
+                for (nb_iter = 0; nb_iter < CAL_ITER; ) {
+                    sx125x_cal_rx_image(i, rf_chain_cfg[i].freq_hz, false, rf_chain_cfg[i].type, &cal_rx[nb_iter]);
+                    cal_rx_result_sort(&cal_rx[nb_iter], &cal_rx_min, &cal_rx_max);
+                    nb_iter += 1;
+                    if (cal_fast_mode && (nb_iter >= CAL_ITER_FAST) && cal_rx_result_assert(&cal_rx_min, &cal_rx_max)) {
+                        break;
+                    }
                 }
                 cal_status = cal_rx_result_assert(&cal_rx_min, &cal_rx_max);
             }
@@ -125,9 +182,13 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
             /* If failed or different radios, run calibration using RF loopback (assuming that it is better than no calibration) */
             if ((cal_status == false) || (rf_chain_cfg[0].type != rf_chain_cfg[1].type)) {
                 cal_rx_result_init(&cal_rx_min, &cal_rx_max);
-                for (j = 0; j < CAL_ITER; j++) {
-                    sx125x_cal_rx_image(i, rf_chain_cfg[i].freq_hz, true, rf_chain_cfg[i].type, &cal_rx[j]);
-                    cal_rx_result_sort(&cal_rx[j], &cal_rx_min, &cal_rx_max);
+                for (nb_iter = 0; nb_iter < CAL_ITER; ) {
+                    sx125x_cal_rx_image(i, rf_chain_cfg[i].freq_hz, true, rf_chain_cfg[i].type, &cal_rx[nb_iter]);
+                    cal_rx_result_sort(&cal_rx[nb_iter], &cal_rx_min, &cal_rx_max);
+                    nb_iter += 1;
+                    if (cal_fast_mode && (nb_iter >= CAL_ITER_FAST) && cal_rx_result_assert(&cal_rx_min, &cal_rx_max)) {
+                        break;
+                    }
                 }
                 cal_status = cal_rx_result_assert(&cal_rx_min, &cal_rx_max);
             }
@@ -142,7 +203,7 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
             /* Use the results of the best iteration */
             x_max = 0;
             x_max_idx = 0;
-            for (j=0; j<CAL_ITER; j++) {
+            for (j = 0; j < nb_iter; j++) {
                 if (cal_rx[j].rej > x_max) {
                     x_max = cal_rx[j].rej;
                     x_max_idx = j;
@@ -187,9 +248,13 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
         if (rf_chain_cfg[i].tx_enable) {
             for (j = 0; j < nb_gains[i]; j++) {
                 cal_tx_result_init(&cal_tx_min, &cal_tx_max);
-                for (k = 0; k < CAL_ITER; k++){
-                    sx125x_cal_tx_dc_offset(i, rf_chain_cfg[i].freq_hz, dac_gain[i][j], mix_gain[i][j], rf_chain_cfg[i].type, &cal_tx[k]);
-                    cal_tx_result_sort(&cal_tx[k], &cal_tx_min, &cal_tx_max);
+                for (nb_iter = 0; nb_iter < CAL_ITER; ) {
+                    sx125x_cal_tx_dc_offset(i, rf_chain_cfg[i].freq_hz, dac_gain[i][j], mix_gain[i][j], rf_chain_cfg[i].type, &cal_tx[nb_iter]);
+                    cal_tx_result_sort(&cal_tx[nb_iter], &cal_tx_min, &cal_tx_max);
+                    nb_iter += 1;
+                    if (cal_fast_mode && (nb_iter >= CAL_ITER_FAST) && cal_tx_result_assert(&cal_tx_min, &cal_tx_max)) {
+                        break;
+                    }
                 }
                 cal_status = cal_tx_result_assert(&cal_tx_min, &cal_tx_max);
 
@@ -203,7 +268,7 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
                 /* Use the results of the best iteration */
                 x_max = 0;
                 x_max_idx = 0;
-                for (k = 0; k < CAL_ITER; k++) {
+                for (k = 0; k < nb_iter; k++) {
                     if (cal_tx[k].rej > x_max) {
                         x_max = cal_tx[k].rej;
                         x_max_idx = k;
@@ -230,6 +295,23 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
         }
     }
 
+    /* Keep the results for the calibration cache */
+    memset(&cal_last, 0, sizeof cal_last);
+    for (k = 0; k < LGW_RF_CHAIN_NB; k++) {
+        cal_last.rx_amp[k] = rf_rx_image_amp[k];
+        cal_last.rx_phi[k] = rf_rx_image_phi[k];
+        if (rf_chain_cfg[k].tx_enable) {
+            cal_last.nb_tx[k] = nb_gains[k];
+            for (j = 0; j < nb_gains[k]; j++) {
+                cal_last.tx[k][j].dac_gain = dac_gain[k][j];
+                cal_last.tx[k][j].mix_gain = mix_gain[k][j];
+                cal_last.tx[k][j].offset_i = offset_i[k][j];
+                cal_last.tx[k][j].offset_q = offset_q[k][j];
+            }
+        }
+    }
+    cal_last.valid = true;
+
     printf("-------------------------------------------------------------------\n");
     printf("Radio calibration completed:\n");
     printf("  RadioA: amp:%d phi:%d\n", rf_rx_image_amp[0], rf_rx_image_phi[0]);
@@ -247,6 +329,222 @@ int sx1302_cal_start(uint8_t version, struct lgw_conf_rxrf_s * rf_chain_cfg, str
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+void sx1302_cal_set_fast_mode(bool enable) {
+    cal_fast_mode = enable;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_cal_cache_set_path(const char * path) {
+    if ((path == NULL) || (path[0] == '\0')) {
+        cal_cache_file[0] = '\0';
+        return LGW_HAL_SUCCESS;
+    }
+    if (strlen(path) >= sizeof cal_cache_file) {
+        printf("ERROR: calibration cache path too long\n");
+        return LGW_HAL_ERROR;
+    }
+    strcpy(cal_cache_file, path);
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+const char * sx1302_cal_cache_path(void) {
+    return (cal_cache_file[0] != '\0') ? cal_cache_file : NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_cal_cache_load(uint64_t eui, const float * temperature, struct lgw_conf_rxrf_s * rf_chain_cfg, struct lgw_tx_gain_lut_s * txgain_lut) {
+    struct cal_cache_entry_s entries[CAL_CACHE_ENTRY_NB];
+    struct cal_cache_key_s key;
+    const struct cal_result_s * res = NULL;
+    int64_t now;
+    int i, j, k, n;
+
+    if ((rf_chain_cfg == NULL) || (txgain_lut == NULL) || (cal_cache_file[0] == '\0')) {
+        return LGW_HAL_ERROR;
+    }
+
+    n = cal_cache_read(entries);
+    cal_cache_key(&key, eui, temperature, rf_chain_cfg);
+    now = (int64_t)time(NULL);
+    for (i = 0; i < n; i++) {
+        if ((entries[i].time != 0) && (memcmp(&entries[i].key, &key, sizeof key) == 0)) {
+            if ((entries[i].time > now) || ((now - entries[i].time) > CAL_CACHE_MAX_AGE_S)) {
+                DEBUG_MSG("INFO: cached calibration is outdated\n");
+                return LGW_HAL_ERROR;
+            }
+            res = &entries[i].res;
+            break;
+        }
+    }
+    if (res == NULL) {
+        DEBUG_MSG("INFO: no cached calibration for these conditions\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Check that all gains of the Tx LUTs have been calibrated before applying anything */
+    for (k = 0; k < LGW_RF_CHAIN_NB; k++) {
+        if (rf_chain_cfg[k].tx_enable == false) {
+            continue;
+        }
+        if (res->nb_tx[k] > TX_GAIN_LUT_SIZE_MAX) {
+            return LGW_HAL_ERROR;
+        }
+        for (i = 0; i < txgain_lut[k].size; i++) {
+            for (j = 0; j < res->nb_tx[k]; j++) {
+                if ((txgain_lut[k].lut[i].dac_gain == res->tx[k][j].dac_gain) && (txgain_lut[k].lut[i].mix_gain == res->tx[k][j].mix_gain)) {
+                    break;
+                }
+            }
+            if (j == res->nb_tx[k]) {
+                DEBUG_PRINTF("INFO: gain dac:%u mix:%u of radio %d not in cached calibration\n", txgain_lut[k].lut[i].dac_gain, txgain_lut[k].lut[i].mix_gain, k);
+                return LGW_HAL_ERROR;
+            }
+        }
+    }
+
+    /* Apply cached IQ mismatch compensation */
+    for (k = 0; k < LGW_RF_CHAIN_NB; k++) {
+        rf_rx_image_amp[k] = res->rx_amp[k];
+        rf_rx_image_phi[k] = res->rx_phi[k];
+    }
+    lgw_reg_w(SX1302_REG_RADIO_FE_IQ_COMP_AMP_COEFF_RADIO_A_AMP_COEFF, (int32_t)rf_rx_image_amp[0]);
+    lgw_reg_w(SX1302_REG_RADIO_FE_IQ_COMP_PHI_COEFF_RADIO_A_PHI_COEFF, (int32_t)rf_rx_image_phi[0]);
+    lgw_reg_w(SX1302_REG_RADIO_FE_IQ_COMP_AMP_COEFF_RADIO_B_AMP_COEFF, (int32_t)rf_rx_image_amp[1]);
+    lgw_reg_w(SX1302_REG_RADIO_FE_IQ_COMP_PHI_COEFF_RADIO_B_PHI_COEFF, (int32_t)rf_rx_image_phi[1]);
+
+    /* Fill cached DC offsets in Tx LUT */
+    for (k = 0; k < LGW_RF_CHAIN_NB; k++) {
+        if (rf_chain_cfg[k].tx_enable == false) {
+            continue;
+        }
+        for (i = 0; i < txgain_lut[k].size; i++) {
+            for (j = 0; j < res->nb_tx[k]; j++) {
+                if ((txgain_lut[k].lut[i].dac_gain == res->tx[k][j].dac_gain) && (txgain_lut[k].lut[i].mix_gain == res->tx[k][j].mix_gain)) {
+                    break;
+                }
+            }
+            txgain_lut[k].lut[i].offset_i = res->tx[k][j].offset_i;
+            txgain_lut[k].lut[i].offset_q = res->tx[k][j].offset_q;
+        }
+    }
+    cal_last = *res;
+
+    printf("INFO: radio calibration restored from %s (%lld s old)\n", cal_cache_file, (long long)(now - entries[i].time));
+    printf("  RadioA: amp:%d phi:%d\n", rf_rx_image_amp[0], rf_rx_image_phi[0]);
+    printf("  RadioB: amp:%d phi:%d\n", rf_rx_image_amp[1], rf_rx_image_phi[1]);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_cal_cache_store(uint64_t eui, const float * temperature, struct lgw_conf_rxrf_s * rf_chain_cfg) {
+    struct cal_cache_entry_s entries[CAL_CACHE_ENTRY_NB];
+    struct cal_cache_header_s header;
+    struct cal_cache_key_s key;
+    char tmp_path[CAL_CACHE_PATH_MAX + 4];
+    FILE * f;
+    int i, idx, n;
+
+    if ((rf_chain_cfg == NULL) || (cal_cache_file[0] == '\0') || (cal_last.valid == false)) {
+        return LGW_HAL_ERROR;
+    }
+
+    n = cal_cache_read(entries);
+    for (i = n; i < CAL_CACHE_ENTRY_NB; i++) {
+        memset(&entries[i], 0, sizeof entries[i]);
+    }
+
+    /* Replace the entry of the same conditions, or the oldest one */
+    cal_cache_key(&key, eui, temperature, rf_chain_cfg);
+    idx = 0;
+    for (i = 0; i < CAL_CACHE_ENTRY_NB; i++) {
+        if ((entries[i].time != 0) && (memcmp(&entries[i].key, &key, sizeof key) == 0)) {
+            idx = i;
+            break;
+        }
+        if (entries[i].time < entries[idx].time) {
+            idx = i;
+        }
+    }
+    memset(&entries[idx], 0, sizeof entries[idx]);
+    entries[idx].key = key;
+    entries[idx].time = (int64_t)time(NULL);
+    entries[idx].res = cal_last;
+
+    /* Write a new file and rename it, so that an interrupted write does not corrupt the cache */
+    memcpy(header.magic, CAL_CACHE_MAGIC, sizeof header.magic);
+    header.version = CAL_CACHE_VERSION;
+    header.nb_entry = CAL_CACHE_ENTRY_NB;
+    header.entry_size = sizeof(struct cal_cache_entry_s);
+    snprintf(tmp_path, sizeof tmp_path, "%s.tmp", cal_cache_file);
+    f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        printf("ERROR: failed to create calibration cache %s\n", tmp_path);
+        return LGW_HAL_ERROR;
+    }
+    if ((fwrite(&header, sizeof header, 1, f) != 1) || (fwrite(entries, sizeof entries, 1, f) != 1)) {
+        printf("ERROR: failed to write calibration cache %s\n", tmp_path);
+        fclose(f);
+        remove(tmp_path);
+        return LGW_HAL_ERROR;
+    }
+    if ((fclose(f) != 0) || (rename(tmp_path, cal_cache_file) != 0)) {
+        printf("ERROR: failed to update calibration cache %s\n", cal_cache_file);
+        remove(tmp_path);
+        return LGW_HAL_ERROR;
+    }
+    DEBUG_PRINTF("INFO: calibration saved to %s (entry %d)\n", cal_cache_file, idx);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void cal_cache_key(struct cal_cache_key_s * key, uint64_t eui, const float * temperature, struct lgw_conf_rxrf_s * rf_chain_cfg) {
+    int i;
+
+    memset(key, 0, sizeof *key); /* clear padding, keys are compared with memcmp */
+    key->eui = eui;
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        key->freq_hz[i] = rf_chain_cfg[i].freq_hz;
+        key->type[i] = (uint8_t)rf_chain_cfg[i].type;
+        key->enable[i] = rf_chain_cfg[i].enable ? 1 : 0;
+        key->tx_enable[i] = rf_chain_cfg[i].tx_enable ? 1 : 0;
+    }
+    key->temp_band = (temperature != NULL) ? (int8_t)floor(*temperature / CAL_CACHE_TEMP_BAND) : INT8_MIN;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int cal_cache_read(struct cal_cache_entry_s * entries) {
+    struct cal_cache_header_s header;
+    FILE * f;
+    int n = 0;
+
+    f = fopen(cal_cache_file, "rb");
+    if (f == NULL) {
+        return 0;
+    }
+    if ((fread(&header, sizeof header, 1, f) == 1) &&
+        (memcmp(header.magic, CAL_CACHE_MAGIC, sizeof header.magic) == 0) &&
+        (header.version == CAL_CACHE_VERSION) &&
+        (header.entry_size == sizeof(struct cal_cache_entry_s))) {
+        n = (int)fread(entries, sizeof(struct cal_cache_entry_s), (header.nb_entry < CAL_CACHE_ENTRY_NB) ? header.nb_entry : CAL_CACHE_ENTRY_NB, f);
+    } else {
+        printf("WARNING: ignoring invalid calibration cache %s\n", cal_cache_file);
+    }
+    fclose(f);
+
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx125x_cal_rx_image(uint8_t rf_chain, uint32_t freq_hz, bool use_loopback, uint8_t radio_type, struct lgw_sx125x_cal_rx_result_s * res) {
     uint8_t rx, tx;
     uint32_t rx_freq_hz, tx_freq_hz;
@@ -18,12 +18,23 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdint.h>     /* C99 types */
 #include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memset */
+#include <time.h>       /* clock_gettime */
 
 #include "loragw_com.h"
 #include "loragw_usb.h"
 #include "loragw_spi.h"
+#include "loragw_replay.h"
+#include "loragw_sim.h"
 #include "loragw_aux.h"
 
 /* -------------------------------------------------------------------------- */
@@ -47,14 +58,36 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
 /**
-@brief The current communication type in use (SPI, USB)
+@brief The current communication type in use (SPI, USB, REPLAY, SIM)
 */
-static lgw_com_type_t _lgw_com_type = LGW_COM_UNKNOWN;
+static lgw_com_type_t _lgw_com_type_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = LGW_COM_UNKNOWN };
+#define _lgw_com_type _lgw_com_type_board[lgw_board_cur]
 
 /**
 @brief A generic pointer to the COM device (file descriptor)
 */
-static void* _lgw_com_target = NULL;
+static void* _lgw_com_target_board[LGW_BOARD_NB_MAX] = { NULL };
+#define _lgw_com_target _lgw_com_target_board[lgw_board_cur]
+
+/**
+@brief Counters of the accesses done with the interface
+*/
+static struct lgw_com_stats_s _lgw_com_stats_board[LGW_BOARD_NB_MAX];
+#define _lgw_com_stats _lgw_com_stats_board[lgw_board_cur]
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static lgw_com_stats_target_t stats_target(uint8_t spi_mux_target) {
+    switch (spi_mux_target) {
+        case LGW_SPI_MUX_TARGET_RADIOA:
+            return LGW_COM_STATS_RADIOA;
+        case LGW_SPI_MUX_TARGET_RADIOB:
+            return LGW_COM_STATS_RADIOB;
+        default:
+            return LGW_COM_STATS_SX1302;
+    }
+}
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
@@ -64,7 +97,7 @@ int lgw_com_open(lgw_com_type_t com_type, const char * com_path) {
 
     /* Check input parameters */
     CHECK_NULL(com_path);
-    if ((com_type != LGW_COM_SPI) && (com_type != LGW_COM_USB)) {
+    if ((com_type != LGW_COM_SPI) && (com_type != LGW_COM_USB) && (com_type != LGW_COM_REPLAY) && (com_type != LGW_COM_SIM)) {
         DEBUG_MSG("ERROR: COMMUNICATION INTERFACE TYPE IS NOT SUPPORTED\n");
         return LGW_COM_ERROR;
     }
@@ -86,6 +119,14 @@ int lgw_com_open(lgw_com_type_t com_type, const char * com_path) {
             printf("Opening USB communication interface\n");
             com_stat = lgw_usb_open(com_path, &_lgw_com_target);
             break;
+        case LGW_COM_REPLAY:
+            printf("Opening replay communication interface\n");
+            com_stat = lgw_replay_open(com_path, &_lgw_com_target);
+            break;
+        case LGW_COM_SIM:
+            printf("Opening simulated concentrator\n");
+            com_stat = lgw_sim_open(com_path, &_lgw_com_target);
+            break;
         default:
             com_stat = LGW_COM_ERROR;
             break;
@@ -114,6 +155,14 @@ int lgw_com_close(void) {
             printf("Closing USB communication interface\n");
             com_stat = lgw_usb_close(_lgw_com_target);
             break;
+        case LGW_COM_REPLAY:
+            printf("Closing replay communication interface\n");
+            com_stat = lgw_replay_close(_lgw_com_target);
+            break;
+        case LGW_COM_SIM:
+            printf("Closing simulated concentrator\n");
+            com_stat = lgw_sim_close(_lgw_com_target);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
@@ -127,14 +176,46 @@ int lgw_com_close(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_com_reopen(const char * com_path) {
+    int com_stat;
+
+    /* Check input parameters */
+    CHECK_NULL(com_path);
+    if (_lgw_com_target == NULL) {
+        printf("ERROR: concentrator is not connected\n");
+        return LGW_COM_ERROR;
+    }
+
+    switch (_lgw_com_type) {
+        case LGW_COM_USB:
+            printf("Reopening USB communication interface\n");
+            com_stat = lgw_usb_reopen(com_path, _lgw_com_target);
+            break;
+        case LGW_COM_SIM:
+            printf("Reopening simulated concentrator\n");
+            com_stat = lgw_sim_reopen(_lgw_com_target);
+            break;
+        default:
+            printf("ERROR: the communication interface can not be reopened\n");
+            com_stat = LGW_COM_ERROR;
+            break;
+    }
+
+    return com_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* Simple write */
 int lgw_com_w(uint8_t spi_mux_target, uint16_t address, uint8_t data) {
     int com_stat;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
+    uint64_t ts;
 
     /* Record function start time */
     _meas_time_start(&tm);
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_lgw_com_target);
@@ -146,6 +227,12 @@ int lgw_com_w(uint8_t spi_mux_target, uint16_t address, uint8_t data) {
         case LGW_COM_USB:
             com_stat = lgw_usb_w(_lgw_com_target, spi_mux_target, address, data);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_W, spi_mux_target, address, &data, 1);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_wb(_lgw_com_target, spi_mux_target, address, &data, 1);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
@@ -154,6 +241,8 @@ int lgw_com_w(uint8_t spi_mux_target, uint16_t address, uint8_t data) {
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, __FUNCTION__);
+    lgw_com_stats_update(_lgw_com_type, stats_target(spi_mux_target), LGW_COM_STATS_W, 1, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_W, spi_mux_target, address, &data, 1, com_stat);
 
     return com_stat;
 }
@@ -164,10 +253,12 @@ int lgw_com_w(uint8_t spi_mux_target, uint16_t address, uint8_t data) {
 int lgw_com_r(uint8_t spi_mux_target, uint16_t address, uint8_t *data) {
     int com_stat;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
+    uint64_t ts;
 
     /* Record function start time */
     _meas_time_start(&tm);
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_lgw_com_target);
@@ -180,6 +271,12 @@ int lgw_com_r(uint8_t spi_mux_target, uint16_t address, uint8_t *data) {
         case LGW_COM_USB:
             com_stat = lgw_usb_r(_lgw_com_target, spi_mux_target, address, data);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_R, spi_mux_target, address, data, 1);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_rb(_lgw_com_target, spi_mux_target, address, data, 1);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
@@ -188,6 +285,8 @@ int lgw_com_r(uint8_t spi_mux_target, uint16_t address, uint8_t *data) {
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, __FUNCTION__);
+    lgw_com_stats_update(_lgw_com_type, stats_target(spi_mux_target), LGW_COM_STATS_R, 1, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_R, spi_mux_target, address, data, 1, com_stat);
 
     return com_stat;
 }
@@ -196,11 +295,14 @@ int lgw_com_r(uint8_t spi_mux_target, uint16_t address, uint8_t *data) {
 
 int lgw_com_rmw(uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t leng, uint8_t data) {
     int com_stat;
+    uint8_t rmw[3] = { offs, leng, data };
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
+    uint64_t ts;
 
     /* Record function start time */
     _meas_time_start(&tm);
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_lgw_com_target);
@@ -212,6 +314,12 @@ int lgw_com_rmw(uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t
         case LGW_COM_USB:
             com_stat = lgw_usb_rmw(_lgw_com_target, address, offs, leng, data);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_RMW, spi_mux_target, address, rmw, sizeof rmw);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_rmw(_lgw_com_target, spi_mux_target, address, offs, leng, data);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
@@ -220,6 +328,8 @@ int lgw_com_rmw(uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, __FUNCTION__);
+    lgw_com_stats_update(_lgw_com_type, stats_target(spi_mux_target), LGW_COM_STATS_RMW, 1, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_RMW, spi_mux_target, address, rmw, sizeof rmw, com_stat);
 
     return com_stat;
 }
@@ -230,10 +340,12 @@ int lgw_com_rmw(uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t
 int lgw_com_wb(uint8_t spi_mux_target, uint16_t address, const uint8_t *data, uint16_t size) {
     int com_stat;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
+    uint64_t ts;
 
     /* Record function start time */
     _meas_time_start(&tm);
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_lgw_com_target);
@@ -246,6 +358,12 @@ int lgw_com_wb(uint8_t spi_mux_target, uint16_t address, const uint8_t *data, ui
         case LGW_COM_USB:
             com_stat = lgw_usb_wb(_lgw_com_target, spi_mux_target, address, data, size);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_WB, spi_mux_target, address, (uint8_t *)data, size);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_wb(_lgw_com_target, spi_mux_target, address, data, size);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
@@ -254,6 +372,8 @@ int lgw_com_wb(uint8_t spi_mux_target, uint16_t address, const uint8_t *data, ui
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, __FUNCTION__);
+    lgw_com_stats_update(_lgw_com_type, stats_target(spi_mux_target), LGW_COM_STATS_WB, size, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_WB, spi_mux_target, address, data, size, com_stat);
 
     return com_stat;
 }
@@ -264,10 +384,12 @@ int lgw_com_wb(uint8_t spi_mux_target, uint16_t address, const uint8_t *data, ui
 int lgw_com_rb(uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t size) {
     int com_stat;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
+    uint64_t ts;
 
     /* Record function start time */
     _meas_time_start(&tm);
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_lgw_com_target);
@@ -280,6 +402,70 @@ int lgw_com_rb(uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t
         case LGW_COM_USB:
             com_stat = lgw_usb_rb(_lgw_com_target, spi_mux_target, address, data, size);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_RB, spi_mux_target, address, data, size);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_rb(_lgw_com_target, spi_mux_target, address, data, size);
+            break;
+        default:
+            printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
+            com_stat = LGW_COM_ERROR;
+            break;
+    }
+
+    /* Compute time spent in this function */
+    _meas_time_stop(5, tm, __FUNCTION__);
+    lgw_com_stats_update(_lgw_com_type, stats_target(spi_mux_target), LGW_COM_STATS_RB, size, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_RB, spi_mux_target, address, data, size, com_stat);
+
+    return com_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_com_rb_multi(struct lgw_com_rb_s * req, uint8_t nb_req) {
+    int com_stat = LGW_COM_SUCCESS;
+    uint32_t size = 0;
+    int i;
+    /* performances variables */
+    int64_t tm;
+    uint64_t ts;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+    ts = lgw_com_stats_start();
+
+    /* Check input parameters */
+    CHECK_NULL(_lgw_com_target);
+    CHECK_NULL(req);
+    if (nb_req == 0) {
+        return LGW_COM_SUCCESS;
+    }
+    for (i = 0; i < nb_req; i++) {
+        size += req[i].size;
+    }
+
+    switch (_lgw_com_type) {
+        case LGW_COM_SPI:
+            /* No gain to expect from grouping on SPI, do the reads one by one */
+            for (i = 0; (i < nb_req) && (com_stat == LGW_COM_SUCCESS); i++) {
+                com_stat = lgw_spi_rb(_lgw_com_target, req[i].spi_mux_target, req[i].address, req[i].data, req[i].size);
+            }
+            break;
+        case LGW_COM_USB:
+            com_stat = lgw_usb_rb_multi(_lgw_com_target, req, nb_req);
+            break;
+        case LGW_COM_REPLAY:
+            for (i = 0; (i < nb_req) && (com_stat == LGW_COM_SUCCESS); i++) {
+                com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_RB_MULTI, req[i].spi_mux_target, req[i].address, req[i].data, req[i].size);
+            }
+            break;
+        case LGW_COM_SIM:
+            for (i = 0; (i < nb_req) && (com_stat == LGW_COM_SUCCESS); i++) {
+                com_stat = lgw_sim_rb(_lgw_com_target, req[i].spi_mux_target, req[i].address, req[i].data, req[i].size);
+            }
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
@@ -288,6 +474,11 @@ int lgw_com_rb(uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, __FUNCTION__);
+    lgw_com_stats_update(_lgw_com_type, stats_target(req[0].spi_mux_target), LGW_COM_STATS_RB, size, ts, com_stat);
+    for (i = 0; i < nb_req; i++) {
+        /* a failed multiple read is recorded as failed on all its reads */
+        lgw_replay_log(LGW_REPLAY_RB_MULTI, req[i].spi_mux_target, req[i].address, req[i].data, req[i].size, com_stat);
+    }
 
     return com_stat;
 }
@@ -299,17 +490,25 @@ int lgw_com_set_write_mode(lgw_com_write_mode_t write_mode) {
 
     switch (_lgw_com_type) {
         case LGW_COM_SPI:
-            /* Do nothing: only single mode is supported on SPI */
+            com_stat = lgw_spi_set_write_mode(write_mode);
             break;
         case LGW_COM_USB:
             com_stat = lgw_usb_set_write_mode(write_mode);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_WRITE_MODE, 0, (uint16_t)write_mode, NULL, 0);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_set_write_mode(_lgw_com_target, write_mode);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
             break;
     }
 
+    lgw_replay_log(LGW_REPLAY_WRITE_MODE, 0, (uint16_t)write_mode, NULL, 0, com_stat);
+
     return com_stat;
 }
 
@@ -317,20 +516,33 @@ int lgw_com_set_write_mode(lgw_com_write_mode_t write_mode) {
 
 int lgw_com_flush(void) {
     int com_stat = LGW_COM_SUCCESS;
+    uint64_t ts;
+
+    ts = lgw_com_stats_start();
 
     switch (_lgw_com_type) {
         case LGW_COM_SPI:
-            /* Do nothing: only single mode is supported on SPI */
+            com_stat = lgw_spi_flush(_lgw_com_target);
             break;
         case LGW_COM_USB:
             com_stat = lgw_usb_flush(_lgw_com_target);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_lgw_com_target, LGW_REPLAY_FLUSH, 0, 0, NULL, 0);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_flush(_lgw_com_target);
+            break;
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             com_stat = LGW_COM_ERROR;
             break;
     }
 
+    /* bulk writes only address the SX1302, their bytes are accounted when queued */
+    lgw_com_stats_update(_lgw_com_type, LGW_COM_STATS_SX1302, LGW_COM_STATS_FLUSH, 0, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_FLUSH, 0, 0, NULL, 0, com_stat);
+
     return com_stat;
 }
 
@@ -342,7 +554,10 @@ uint16_t lgw_com_chunk_size(void) {
             return lgw_spi_chunk_size();
         case LGW_COM_USB:
             return lgw_usb_chunk_size();
-            break;
+        case LGW_COM_REPLAY:
+            return lgw_replay_chunk_size(_lgw_com_target);
+        case LGW_COM_SIM:
+            return lgw_sim_chunk_size();
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             return 0;
@@ -362,6 +577,10 @@ int lgw_com_get_temperature(float * temperature) {
             return -1;
         case LGW_COM_USB:
             return lgw_usb_get_temperature(_lgw_com_target, temperature);
+        case LGW_COM_REPLAY:
+            return lgw_replay_get_temperature(_lgw_com_target, temperature);
+        case LGW_COM_SIM:
+            return lgw_sim_get_temperature(_lgw_com_target, temperature);
         default:
             printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
             return LGW_COM_ERROR;
@@ -380,4 +599,57 @@ lgw_com_type_t lgw_com_type(void) {
     return _lgw_com_type;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_com_get_stats(struct lgw_com_stats_s * stats, bool reset) {
+    /* Check input parameters */
+    CHECK_NULL(stats);
+
+    *stats = _lgw_com_stats;
+    if (reset == true) {
+        memset(&_lgw_com_stats, 0, sizeof _lgw_com_stats);
+    }
+
+    return LGW_COM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t lgw_com_stats_start(void) {
+    struct timespec now;
+
+    /* CLOCK_MONOTONIC is served by the vDSO, no system call */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_com_stats_update(lgw_com_type_t com_type, lgw_com_stats_target_t target, lgw_com_stats_op_t op, uint32_t size, uint64_t start_ns, int status) {
+    struct lgw_com_stats_op_s * stats;
+    uint64_t time_us;
+    int bin = 0;
+
+    if ((com_type >= LGW_COM_UNKNOWN) || (target >= LGW_COM_STATS_TARGET_NB) || (op >= LGW_COM_STATS_OP_NB)) {
+        return;
+    }
+
+    time_us = (lgw_com_stats_start() - start_ns) / 1000;
+
+    /* log2 bins */
+    while ((bin < (LGW_COM_STATS_LAT_NB - 1)) && ((time_us >> bin) > 0)) {
+        bin += 1;
+    }
+
+    stats = &_lgw_com_stats.op[com_type][target][op];
+    stats->nb_call += 1;
+    if (status != LGW_COM_SUCCESS) {
+        stats->nb_error += 1;
+    }
+    stats->nb_byte += size;
+    stats->time_us += time_us;
+    stats->lat_hist[bin] += 1;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -21,6 +21,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <stdio.h>      /* printf fprintf */
 #include <string.h>     /* memcmp */
 #include <time.h>
+#include <pthread.h>
 
 #include "loragw_aux.h"
 #include "loragw_reg.h"
@@ -38,17 +39,139 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
 
+#define REF_PAYLOAD_NB  16  /* size of lgw_conf_debug_s.ref_payload */
+
+/* payload expected from a reference device */
+struct per_expected_s {
+    bool seen;                  /* a packet was received from the device */
+    uint32_t prev_cnt;          /* counter of its last packet */
+    uint32_t cnt;               /* counter of the expected payload */
+    uint8_t payload[256];       /* payload generated for cnt, for the longest size */
+};
+
+/* payload mismatch, waiting to be logged */
+struct per_log_rec_s {
+    time_t time;
+    uint32_t id;
+    uint32_t cnt;
+    uint8_t sf;
+    uint8_t size;
+    uint8_t received[255];
+    uint8_t expected[255];
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
 static tinymt32_t tinymt;
 
+/* fast packet error rate check, protected by mx_per */
+static pthread_mutex_t mx_per = PTHREAD_MUTEX_INITIALIZER;
+static struct per_expected_s per_expected[REF_PAYLOAD_NB];
+static struct lgw_per_stats_s per_stats;
+static struct per_log_rec_s per_log[DBG_PER_LOG_NB];
+static uint32_t per_log_head = 0; /* next record to be written */
+static uint32_t per_log_tail = 0; /* next record to be logged */
+
+static pthread_t thrid_per;
+static bool per_run = false;
+static FILE * per_file = NULL;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
+static void * thread_per(void * arg);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+/* same payload as dbg_generate_random_payload, for the longest size, with a private generator */
+static void per_generate(uint32_t id, uint32_t pkt_cnt, uint8_t * buffer) {
+    tinymt32_t mt;
+    int k;
+
+    mt.mat1 = 0x8f7011ee;
+    mt.mat2 = 0xfc78ff1f;
+    mt.tmat = 0x3793fdff;
+    tinymt32_init(&mt, (int)pkt_cnt);
+    buffer[0] = (uint8_t)(id >> 24);
+    buffer[1] = (uint8_t)(id >> 16);
+    buffer[2] = (uint8_t)(id >> 8);
+    buffer[3] = (uint8_t)(id >> 0);
+    buffer[4] = (uint8_t)(pkt_cnt >> 24);
+    buffer[5] = (uint8_t)(pkt_cnt >> 16);
+    buffer[6] = (uint8_t)(pkt_cnt >> 8);
+    buffer[7] = (uint8_t)(pkt_cnt >> 0);
+    tinymt32_generate_uint32(&mt); /* dummy: for sync with random size generation */
+    for (k = 8; k < 255; k++) {
+        buffer[k] = (uint8_t)tinymt32_generate_uint32(&mt);
+    }
+}
+
+/* number of bits differing between two buffers, compared by 64-bit words */
+static uint32_t payload_bit_diff(const uint8_t * a, const uint8_t * b, uint8_t size) {
+    uint64_t wa, wb;
+    uint32_t nb_bits = 0;
+    int i;
+
+    for (i = 0; (i + 8) <= (int)size; i += 8) {
+        memcpy(&wa, &a[i], sizeof wa);
+        memcpy(&wb, &b[i], sizeof wb);
+        if (wa != wb) {
+            nb_bits += (uint32_t)__builtin_popcountll(wa ^ wb);
+        }
+    }
+    for (; i < (int)size; i++) {
+        nb_bits += (uint32_t)__builtin_popcount(a[i] ^ b[i]);
+    }
+
+    return nb_bits;
+}
+
+/* write the buffered mismatches to the log file */
+static void per_log_flush(void) {
+    static struct per_log_rec_s rec; /* only used by the writer */
+    char stat_timestamp[24];
+    int k;
+
+    while (1) {
+        pthread_mutex_lock(&mx_per);
+        if (per_log_tail == per_log_head) {
+            pthread_mutex_unlock(&mx_per);
+            break;
+        }
+        rec = per_log[per_log_tail % DBG_PER_LOG_NB];
+        per_log_tail += 1;
+        pthread_mutex_unlock(&mx_per);
+
+        strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&rec.time));
+        fprintf(per_file, "ERROR: 0x%08X payload error, pkt %u (SF%u, size:%u, %s)\n", rec.id, rec.cnt, rec.sf, rec.size, stat_timestamp);
+        fprintf(per_file, "RECEIVED:");
+        for (k = 0; k < (int)rec.size; k++) {
+            fprintf(per_file, "%02X ", rec.received[k]);
+        }
+        fprintf(per_file, "\n");
+        fprintf(per_file, "EXPECTED:");
+        for (k = 0; k < (int)rec.size; k++) {
+            fprintf(per_file, "%02X ", rec.expected[k]);
+        }
+        fprintf(per_file, "\n");
+        dbg_log_payload_diff_to_file(per_file, rec.received, rec.expected, rec.size);
+    }
+}
+
+static void * thread_per(void * arg) {
+    (void)arg;
+
+    while (__atomic_load_n(&per_run, __ATOMIC_ACQUIRE) == true) {
+        per_log_flush();
+        wait_ms(DBG_PER_PERIOD_MS);
+    }
+    per_log_flush();
+
+    return NULL;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -181,3 +304,128 @@ int dbg_check_payload(struct lgw_conf_debug_s * context, FILE * file, uint8_t *
 
     return 0; /* ignored */
 }
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void dbg_per_reset(void) {
+    pthread_mutex_lock(&mx_per);
+    memset(per_expected, 0, sizeof per_expected);
+    memset(&per_stats, 0, sizeof per_stats);
+    per_log_head = 0;
+    per_log_tail = 0;
+    pthread_mutex_unlock(&mx_per);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int dbg_per_start(FILE * file) {
+    if (per_run == true) {
+        return -1;
+    }
+
+    per_file = file;
+    if (file == NULL) {
+        return 0;
+    }
+
+    __atomic_store_n(&per_run, true, __ATOMIC_RELEASE);
+    if (pthread_create(&thrid_per, NULL, thread_per, NULL) != 0) {
+        __atomic_store_n(&per_run, false, __ATOMIC_RELEASE);
+        per_file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void dbg_per_stop(void) {
+    if (per_run == true) {
+        __atomic_store_n(&per_run, false, __ATOMIC_RELEASE);
+        pthread_join(thrid_per, NULL);
+    }
+    per_file = NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int dbg_per_check(struct lgw_conf_debug_s * context, const uint8_t * payload, uint8_t size, uint8_t sf) {
+    struct per_expected_s * exp;
+    struct per_log_rec_s * rec;
+    uint32_t cnt, nb_bits;
+    bool ready;
+    int i, k;
+
+    if (size < 8) {
+        return 0;
+    }
+    k = ((sf >= 5) && (sf <= 12)) ? (sf - 5) : 0;
+
+    for (i = 0; (i < context->nb_ref_payload) && (i < REF_PAYLOAD_NB); i++) {
+        if (memcmp(payload, context->ref_payload[i].payload, 4) != 0) {
+            continue;
+        }
+        cnt = ((uint32_t)payload[4] << 24) | ((uint32_t)payload[5] << 16) | ((uint32_t)payload[6] << 8) | ((uint32_t)payload[7] << 0);
+
+        pthread_mutex_lock(&mx_per);
+        exp = &per_expected[i];
+        ready = (exp->seen == true) && (exp->cnt == cnt);
+
+        /* count the packets missed since the previous one */
+        if ((exp->seen == true) && (cnt > (exp->prev_cnt + 1))) {
+            per_stats.nb_missed[k] += cnt - exp->prev_cnt - 1;
+        }
+        exp->seen = true;
+        exp->prev_cnt = cnt;
+        context->ref_payload[i].prev_cnt = cnt;
+
+        /* the payload is generated ahead for packets received in sequence */
+        if (ready == false) {
+            per_generate(context->ref_payload[i].id, cnt, exp->payload);
+            exp->cnt = cnt;
+        }
+        nb_bits = payload_bit_diff(payload, exp->payload, size);
+        if (nb_bits == 0) {
+            per_stats.nb_ok[k] += 1;
+        } else {
+            per_stats.nb_err[k] += 1;
+            per_stats.nb_bit_err[k] += nb_bits;
+            if (per_file != NULL) {
+                if ((per_log_head - per_log_tail) < DBG_PER_LOG_NB) {
+                    rec = &per_log[per_log_head % DBG_PER_LOG_NB];
+                    rec->time = time(NULL);
+                    rec->id = context->ref_payload[i].id;
+                    rec->cnt = cnt;
+                    rec->sf = sf;
+                    rec->size = size;
+                    memcpy(rec->received, payload, size);
+                    memcpy(rec->expected, exp->payload, size);
+                    per_log_head += 1;
+                } else {
+                    per_stats.nb_log_dropped += 1;
+                }
+            }
+        }
+
+        /* prepare the payload expected next from this device */
+        per_generate(context->ref_payload[i].id, cnt + 1, exp->payload);
+        exp->cnt = cnt + 1;
+        pthread_mutex_unlock(&mx_per);
+
+        return (nb_bits == 0) ? 1 : -1;
+    }
+
+    return 0; /* ignored */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void dbg_per_get_stats(struct lgw_per_stats_s * stats, bool reset) {
+    pthread_mutex_lock(&mx_per);
+    *stats = per_stats;
+    if (reset == true) {
+        memset(&per_stats, 0, sizeof per_stats);
+    }
+    pthread_mutex_unlock(&mx_per);
+}
@@ -58,6 +58,33 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define DEFAULT_BAUDRATE    B9600
 
 #define UBX_MSG_NAVTIMEGPS_LEN  16
+#define UBX_NAVTIMEGPS_PAYLOAD  16 /* payload length of UBX NAV-TIMEGPS */
+#define UBX_PAYLOAD_MAX         1024 /* longer payloads are considered as a false sync */
+#define NMEA_MSG_MIN_LEN        8
+
+/* clock estimator tuning, offset in us and drift in ppm */
+#define CLOCK_MEAS_VAR          0.25    /* us^2, PPS jitter and counter resolution */
+#define CLOCK_PHASE_NOISE       0.01    /* us^2/s, white frequency noise of the oscillator */
+#define CLOCK_DRIFT_NOISE       1E-6    /* ppm^2/s, random walk of the oscillator frequency */
+#define CLOCK_DRIFT_INIT_VAR    100.0   /* ppm^2, unknown frequency error of up to 10ppm */
+#define CLOCK_GATE_SIGMA        5.0     /* points further than this from the prediction are rejected */
+#define CLOCK_GATE_MIN_US       10.0    /* but points closer than this are always accepted */
+#define CLOCK_REJECT_MAX        3       /* consecutive rejected points before a reset */
+
+#define UNIX_GPS_EPOCH_OFFSET   315964800 /* Number of seconds ellapsed between 01.Jan.1970 00:00:00 and 06.Jan.1980 00:00:00 */
+
+/* states of the stream parser */
+enum stream_state_e {
+    STREAM_IDLE,        /* waiting for a sync char */
+    STREAM_UBX_SYNC,    /* second UBX sync char */
+    STREAM_UBX_HEADER,  /* class, ID and length */
+    STREAM_UBX_PAYLOAD,
+    STREAM_UBX_CK_A,
+    STREAM_UBX_CK_B,
+    STREAM_NMEA_BODY,   /* up to '*' */
+    STREAM_NMEA_CK,     /* 2 hexadecimal chars */
+    STREAM_NMEA_END     /* up to LF */
+};
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
@@ -75,6 +102,9 @@ static bool gps_time_ok = false;
 static int16_t gps_week = 0; /* GPS week number of the navigation epoch */
 static uint32_t gps_iTOW = 0; /* GPS time of week in milliseconds */
 static int32_t gps_fTOW = 0; /* Fractional part of iTOW (+/-500000) in nanosec */
+static int8_t gps_leap = 0; /* GPS leap seconds (GPS-UTC) */
+static bool gps_leap_ok = false;
+static bool gps_utc_ubx = false; /* UTC derived from UBX GPS time, NMEA not decoded */
 
 static short gps_dla = 0; /* degrees of latitude */
 static double gps_mla = 0.0; /* minutes of latitude */
@@ -103,6 +133,16 @@ static bool match_label(const char *s, char *label, int size, char wildcard);
 
 static int str_chop(char *s, int buff_size, char separator, int *idx_ary, int max_idx);
 
+static void ubx_decode_timegps(const char *frame);
+
+static enum gps_msg stream_ubx_end(struct lgw_gps_stream_s *stream);
+
+static enum gps_msg stream_nmea_end(struct lgw_gps_stream_s *stream);
+
+static void clock_reset(struct lgw_clock_s *clk, uint32_t count_us, struct timespec utc, struct timespec gps_time);
+
+static void timespec_add_us(struct timespec *t, double us);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -248,6 +288,118 @@ int str_chop(char *s, int buff_size, char separator, int *idx_ary, int max_idx)
     return j;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Extract GPS time from a NAV-TIMEGPS frame whose checksum is verified
+*/
+static void ubx_decode_timegps(const char *frame) {
+    /* Check validity of information */
+    if ((frame[17] & 0x3) != 0) { /* towValid, weekValid */
+        /* Parse buffer to extract GPS time */
+        /* Warning: payload byte ordering is Little Endian */
+        gps_iTOW =  (uint8_t)frame[6];
+        gps_iTOW |= (uint8_t)frame[7] << 8;
+        gps_iTOW |= (uint8_t)frame[8] << 16;
+        gps_iTOW |= (uint8_t)frame[9] << 24; /* GPS time of week, in ms */
+
+        gps_fTOW =  (uint8_t)frame[10];
+        gps_fTOW |= (uint8_t)frame[11] << 8;
+        gps_fTOW |= (uint8_t)frame[12] << 16;
+        gps_fTOW |= (uint8_t)frame[13] << 24; /* Fractional part of iTOW, in ns */
+
+        gps_week =  (uint8_t)frame[14];
+        gps_week |= (uint8_t)frame[15] << 8; /* GPS week number */
+
+        gps_leap = (int8_t)frame[16]; /* GPS-UTC, in seconds */
+        gps_leap_ok = ((frame[17] & 0x4) != 0); /* leapSValid */
+
+        gps_time_ok = true;
+    } else {
+        gps_time_ok = false;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Complete a UBX frame, its checksum bytes being received
+*/
+static enum gps_msg stream_ubx_end(struct lgw_gps_stream_s *stream) {
+    if ((stream->ck_a != 0) || (stream->ck_b != 0)) {
+        DEBUG_MSG("ERROR: UBX message is corrupted, checksum failed\n");
+        return INVALID;
+    }
+    if (stream->keep == false) {
+        DEBUG_MSG("Note: UBX message ignored (%02x %02x)\n", (uint8_t)stream->buff[2], (uint8_t)stream->buff[3]);
+        return IGNORED;
+    }
+    ubx_decode_timegps(stream->buff);
+    return UBX_NAV_TIMEGPS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Complete a NMEA sentence, its LF being received
+*/
+static enum gps_msg stream_nmea_end(struct lgw_gps_stream_s *stream) {
+    char checksum[2];
+
+    checksum[0] = nibble_to_hexchar(stream->ck_a / 16);
+    checksum[1] = nibble_to_hexchar(stream->ck_a % 16);
+    if ((stream->buff[stream->idx - 2] != checksum[0]) || (stream->buff[stream->idx - 1] != checksum[1])) {
+        DEBUG_MSG("Warning: invalid NMEA sentence (bad checksum)\n");
+        return INVALID;
+    }
+    /* CR LF were not stored, only sentences with a decoder are passed to it */
+    if ((stream->idx >= NMEA_MSG_MIN_LEN) && (match_label(stream->buff, "$G?RMC", 6, '?') || match_label(stream->buff, "$G?GGA", 6, '?'))) {
+        stream->buff[stream->idx] = '\n';
+        return lgw_parse_nmea(stream->buff, stream->idx + 1);
+    }
+    return IGNORED;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Restart the clock estimation from a synchronization point, the drift estimate is kept
+*/
+static void clock_reset(struct lgw_clock_s *clk, uint32_t count_us, struct timespec utc, struct timespec gps_time) {
+    clk->count_us = count_us;
+    clk->utc = utc;
+    clk->gps = gps_time;
+    clk->systime = time(NULL);
+    clk->offset = 0.0;
+    clk->p[0][0] = CLOCK_MEAS_VAR;
+    clk->p[0][1] = 0.0;
+    clk->p[1][0] = 0.0;
+    if (clk->init == false) {
+        clk->drift = 0.0;
+        clk->p[1][1] = CLOCK_DRIFT_INIT_VAR;
+    }
+    clk->nb_sync = 1;
+    clk->nb_reject = 0;
+    clk->init = true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void timespec_add_us(struct timespec *t, double us) {
+    double intpart, fractpart;
+
+    fractpart = modf(us / 1E6, &intpart);
+    t->tv_sec += (time_t)intpart;
+    t->tv_nsec += (long)(fractpart * 1E9);
+    if (t->tv_nsec >= (long)1E9) {
+        t->tv_sec += 1;
+        t->tv_nsec -= (long)1E9;
+    } else if (t->tv_nsec < 0) {
+        t->tv_sec -= 1;
+        t->tv_nsec += (long)1E9;
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -391,7 +543,6 @@ int lgw_gps_disable(int fd) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 enum gps_msg lgw_parse_ubx(const char *serial_buff, size_t buff_size, size_t *msg_size) {
-    bool valid = 0;    /* iTOW, fTOW and week validity */
     unsigned int payload_length;
     uint8_t ck_a, ck_b;
     uint8_t ck_a_rcv, ck_b_rcv;
@@ -439,43 +590,7 @@ enum gps_msg lgw_parse_ubx(const char *serial_buff, size_t buff_size, size_t *ms
             if ((ck_a == ck_a_rcv) && (ck_b == ck_b_rcv)) {
                 /* Check for Class 0x01 (NAV) and ID 0x20 (NAV-TIMEGPS) */
                 if ((serial_buff[2] == 0x01) && (serial_buff[3] == 0x20)) {
-                    /* Check validity of information */
-                    valid = serial_buff[17] & 0x3; /* towValid, weekValid */
-                    if (valid) {
-                        /* Parse buffer to extract GPS time */
-                        /* Warning: payload byte ordering is Little Endian */
-                        gps_iTOW =  (uint8_t)serial_buff[6];
-                        gps_iTOW |= (uint8_t)serial_buff[7] << 8;
-                        gps_iTOW |= (uint8_t)serial_buff[8] << 16;
-                        gps_iTOW |= (uint8_t)serial_buff[9] << 24; /* GPS time of week, in ms */
-
-                        gps_fTOW =  (uint8_t)serial_buff[10];
-                        gps_fTOW |= (uint8_t)serial_buff[11] << 8;
-                        gps_fTOW |= (uint8_t)serial_buff[12] << 16;
-                        gps_fTOW |= (uint8_t)serial_buff[13] << 24; /* Fractional part of iTOW, in ns */
-
-                        gps_week =  (uint8_t)serial_buff[14];
-                        gps_week |= (uint8_t)serial_buff[15] << 8; /* GPS week number */
-
-                        gps_time_ok = true;
-#if 0
-                        /* For debug */
-                        {
-                            short ubx_gps_hou = 0; /* hours (0-23) */
-                            short ubx_gps_min = 0; /* minutes (0-59) */
-                            short ubx_gps_sec = 0; /* seconds (0-59) */
-
-                            /* Format GPS time in hh:mm:ss based on iTOW */
-                            ubx_gps_sec = (gps_iTOW / 1000) % 60;
-                            ubx_gps_min = (gps_iTOW / 1000 / 60) % 60;
-                            ubx_gps_hou = (gps_iTOW / 1000 / 60 / 60) % 24;
-                            printf("  GPS time = %02d:%02d:%02d\n", ubx_gps_hou, ubx_gps_min, ubx_gps_sec);
-                        }
-#endif
-                    } else { /* valid */
-                        gps_time_ok = false;
-                    }
-
+                    ubx_decode_timegps(serial_buff);
                     return UBX_NAV_TIMEGPS;
                 } else if ((serial_buff[2] == 0x05) && (serial_buff[3] == 0x00)) {
                     DEBUG_MSG("NOTE: UBX ACK-NAK received\n");
@@ -605,12 +720,145 @@ enum gps_msg lgw_parse_nmea(const char *serial_buff, int buff_size) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+void lgw_gps_stream_init(struct lgw_gps_stream_s *stream, bool nmea) {
+    memset(stream, 0, sizeof *stream);
+    stream->state = STREAM_IDLE;
+    stream->nmea = nmea;
+    gps_utc_ubx = !nmea;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+size_t lgw_gps_stream_parse(struct lgw_gps_stream_s *stream, const uint8_t *data, size_t size, enum gps_msg *msg) {
+    size_t i;
+    uint8_t c;
+
+    *msg = UNKNOWN;
+
+    for (i = 0; (i < size) && (*msg == UNKNOWN); i++) {
+        c = data[i];
+        switch (stream->state) {
+            case STREAM_UBX_SYNC:
+                if (c == 0x62) {
+                    stream->idx = 2;
+                    stream->ck_a = 0;
+                    stream->ck_b = 0;
+                    stream->state = STREAM_UBX_HEADER;
+                    break;
+                }
+                stream->state = STREAM_IDLE;
+                /* not a UBX frame, the byte may be a sync char */
+                /* FALLTHRU */
+            case STREAM_IDLE:
+                if (c == LGW_GPS_UBX_SYNC_CHAR) {
+                    stream->buff[0] = (char)c;
+                    stream->state = STREAM_UBX_SYNC;
+                } else if ((c == LGW_GPS_NMEA_SYNC_CHAR) && stream->nmea) {
+                    stream->buff[0] = (char)c;
+                    stream->idx = 1;
+                    stream->ck_a = 0;
+                    stream->state = STREAM_NMEA_BODY;
+                }
+                break;
+            case STREAM_UBX_HEADER:
+                stream->buff[stream->idx++] = (char)c;
+                stream->ck_a += c;
+                stream->ck_b += stream->ck_a;
+                if (stream->idx == 6) {
+                    stream->len = (uint8_t)stream->buff[4] | ((uint16_t)(uint8_t)stream->buff[5] << 8);
+                    /* only NAV-TIMEGPS is stored, the payload of other messages is only checksummed */
+                    stream->keep = (stream->buff[2] == 0x01) && (stream->buff[3] == 0x20) && (stream->len == UBX_NAVTIMEGPS_PAYLOAD);
+                    if (stream->len > UBX_PAYLOAD_MAX) {
+                        /* most likely a false sync, look for the next one */
+                        stream->state = STREAM_IDLE;
+                        *msg = INVALID;
+                    } else {
+                        stream->state = (stream->len > 0) ? STREAM_UBX_PAYLOAD : STREAM_UBX_CK_A;
+                    }
+                }
+                break;
+            case STREAM_UBX_PAYLOAD:
+                if (stream->keep) {
+                    stream->buff[stream->idx] = (char)c;
+                }
+                stream->idx += 1;
+                stream->ck_a += c;
+                stream->ck_b += stream->ck_a;
+                if (stream->idx == (6 + (uint32_t)stream->len)) {
+                    stream->state = STREAM_UBX_CK_A;
+                }
+                break;
+            case STREAM_UBX_CK_A:
+                stream->ck_a ^= c; /* 0 if the received checksum matches */
+                stream->state = STREAM_UBX_CK_B;
+                break;
+            case STREAM_UBX_CK_B:
+                stream->ck_b ^= c;
+                stream->state = STREAM_IDLE;
+                *msg = stream_ubx_end(stream);
+                break;
+            case STREAM_NMEA_BODY:
+                if ((c < 0x20) || (c > 0x7E) || (stream->idx >= (LGW_GPS_FRAME_MAX - 4))) {
+                    /* control char or too long, the sentence is dropped */
+                    stream->state = STREAM_IDLE;
+                    if (c == LGW_GPS_UBX_SYNC_CHAR) {
+                        stream->buff[0] = (char)c;
+                        stream->state = STREAM_UBX_SYNC;
+                    }
+                    *msg = INVALID;
+                    break;
+                }
+                if (c == LGW_GPS_NMEA_SYNC_CHAR) { /* truncated sentence, a new one starts */
+                    stream->idx = 1;
+                    stream->ck_a = 0;
+                    break;
+                }
+                stream->buff[stream->idx++] = (char)c;
+                if (c == '*') {
+                    stream->state = STREAM_NMEA_CK;
+                } else {
+                    stream->ck_a ^= c;
+                }
+                break;
+            case STREAM_NMEA_CK:
+                stream->buff[stream->idx++] = (char)c;
+                if (stream->buff[stream->idx - 2] != '*') {
+                    stream->state = STREAM_NMEA_END;
+                }
+                break;
+            case STREAM_NMEA_END:
+                if (c == '\r') {
+                    break;
+                }
+                stream->state = STREAM_IDLE;
+                *msg = (c == '\n') ? stream_nmea_end(stream) : INVALID;
+                break;
+            default:
+                stream->state = STREAM_IDLE;
+                break;
+        }
+    }
+
+    return i;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_gps_get(struct timespec *utc, struct timespec *gps_time, struct coord_s *loc, struct coord_s *err) {
     struct tm x;
     time_t y;
     double intpart, fractpart;
 
-    if (utc != NULL) {
+    if ((utc != NULL) && gps_utc_ubx) {
+        if (!gps_time_ok || !gps_leap_ok) {
+            DEBUG_MSG("ERROR: NO VALID TIME TO RETURN\n");
+            return LGW_GPS_ERROR;
+        }
+        /* same time of week as GPS time, shifted to UNIX epoch and by the leap seconds */
+        fractpart = modf(((double)gps_iTOW / 1E3) + ((double)gps_fTOW / 1E9), &intpart);
+        utc->tv_sec = (time_t)intpart + (time_t)gps_week * 604800 + UNIX_GPS_EPOCH_OFFSET - gps_leap;
+        utc->tv_nsec = (long)(fractpart * 1E9);
+    } else if (utc != NULL) {
         if (!gps_time_ok) {
             DEBUG_MSG("ERROR: NO VALID TIME TO RETURN\n");
             return LGW_GPS_ERROR;
@@ -820,6 +1068,168 @@ int lgw_cnt2gps(struct tref ref, uint32_t count_us, struct timespec *gps_time) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_cnt2time_array(struct tref ref, const uint32_t *count_us, int nb, struct timespec *utc, struct timespec *gps_time) {
+    double sec_per_cnt;
+    double delta_sec;
+    double intpart, fractpart;
+    long ns;
+    int i;
+
+    CHECK_NULL(count_us);
+    if ((ref.systime == 0) || (ref.xtal_err > PLUS_10PPM) || (ref.xtal_err < MINUS_10PPM)) {
+        DEBUG_MSG("ERROR: INVALID REFERENCE FOR CNT -> UTC/GPS CONVERSION\n");
+        return LGW_GPS_ERROR;
+    }
+
+    /* the division of lgw_cnt2utc/lgw_cnt2gps is kept, to give exactly the same results */
+    sec_per_cnt = TS_CPS * ref.xtal_err;
+
+    for (i = 0; i < nb; i++) {
+        /* delta in seconds between reference count_us and target count_us, split once for both times */
+        delta_sec = (double)(count_us[i] - ref.count_us) / sec_per_cnt;
+        fractpart = modf(delta_sec, &intpart);
+        ns = (long)(fractpart * 1E9);
+
+        if (utc != NULL) {
+            utc[i].tv_sec = ref.utc.tv_sec + (time_t)intpart;
+            utc[i].tv_nsec = ref.utc.tv_nsec + ns;
+            if (utc[i].tv_nsec >= (long)1E9) { /* must carry one second */
+                utc[i].tv_sec += 1;
+                utc[i].tv_nsec -= (long)1E9;
+            }
+        }
+        if (gps_time != NULL) {
+            gps_time[i].tv_sec = ref.gps.tv_sec + (time_t)intpart;
+            gps_time[i].tv_nsec = ref.gps.tv_nsec + ns;
+            if (gps_time[i].tv_nsec >= (long)1E9) { /* must carry one second */
+                gps_time[i].tv_sec += 1;
+                gps_time[i].tv_nsec -= (long)1E9;
+            }
+        }
+    }
+
+    return LGW_GPS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_clock_init(struct lgw_clock_s *clk) {
+    memset(clk, 0, sizeof *clk);
+    clk->init = false;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_clock_update(struct lgw_clock_s *clk, uint32_t count_us, struct timespec utc, struct timespec gps_time) {
+    double dt; /* time since the last synchronization, in seconds */
+    double pred; /* predicted counter increment, in us */
+    double pred_int;
+    double y; /* innovation, in us */
+    double p00, p01, p11, s, k0, k1;
+
+    CHECK_NULL(clk);
+
+    if (clk->init == false) {
+        clock_reset(clk, count_us, utc, gps_time);
+        return LGW_GPS_SUCCESS;
+    }
+
+    dt = (double)(gps_time.tv_sec - clk->gps.tv_sec) + 1E-9 * (double)(gps_time.tv_nsec - clk->gps.tv_nsec);
+    if (dt <= 0.0) {
+        DEBUG_MSG("Warning: GPS time is not increasing, synchronization ignored\n");
+        return LGW_GPS_ERROR;
+    }
+
+    /* prediction, constant drift model: F = [1 dt; 0 1] */
+    pred = clk->offset + dt * (1E6 + clk->drift);
+    p00 = clk->p[0][0] + dt * (clk->p[0][1] + clk->p[1][0]) + dt * dt * clk->p[1][1];
+    p01 = clk->p[0][1] + dt * clk->p[1][1];
+    p11 = clk->p[1][1];
+    p00 += (CLOCK_PHASE_NOISE * dt) + (CLOCK_DRIFT_NOISE * dt * dt * dt / 3.0);
+    p01 += CLOCK_DRIFT_NOISE * dt * dt / 2.0;
+    p11 += CLOCK_DRIFT_NOISE * dt;
+
+    /* difference between the counter and the prediction, the counter wrapping every 2^32 us */
+    pred_int = floor(pred);
+    y = (double)(int32_t)((count_us - clk->count_us) - (uint32_t)(int64_t)pred_int) - (pred - pred_int);
+    s = p00 + CLOCK_MEAS_VAR;
+
+    /* reject aberrant points, as lgw_gps_sync does */
+    if ((fabs(y) > CLOCK_GATE_MIN_US) && (fabs(y) > (CLOCK_GATE_SIGMA * sqrt(s)))) {
+        clk->nb_reject += 1;
+        DEBUG_MSG("Warning: synchronization point %.1f us away from prediction (%u)\n", y, clk->nb_reject);
+        if (clk->nb_reject >= CLOCK_REJECT_MAX) {
+            clock_reset(clk, count_us, utc, gps_time);
+            return LGW_GPS_SUCCESS;
+        }
+        return LGW_GPS_ERROR;
+    }
+
+    /* correction, the estimate is then expressed relative to the new point */
+    k0 = p00 / s;
+    k1 = p01 / s;
+    clk->offset = -y + k0 * y;
+    clk->drift += k1 * y;
+    clk->p[0][0] = (1.0 - k0) * p00;
+    clk->p[0][1] = (1.0 - k0) * p01;
+    clk->p[1][0] = clk->p[0][1];
+    clk->p[1][1] = p11 - k1 * p01;
+
+    clk->count_us = count_us;
+    clk->utc = utc;
+    clk->gps = gps_time;
+    clk->systime = time(NULL);
+    clk->nb_sync += 1;
+    clk->nb_reject = 0;
+
+    return LGW_GPS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_clock_tref(const struct lgw_clock_s *clk, struct tref *ref) {
+    double off_int;
+    double shift_us;
+
+    CHECK_NULL(clk);
+    CHECK_NULL(ref);
+    if (clk->init == false) {
+        return LGW_GPS_ERROR;
+    }
+
+    /* the integer part of the offset goes in the counter, the fractional part shifts the times backwards */
+    off_int = floor(clk->offset);
+    shift_us = (clk->offset - off_int) / (1.0 + (clk->drift / 1E6));
+
+    ref->systime = clk->systime;
+    ref->count_us = clk->count_us + (uint32_t)(int32_t)off_int;
+    ref->utc = clk->utc;
+    ref->gps = clk->gps;
+    timespec_add_us(&ref->utc, -shift_us);
+    timespec_add_us(&ref->gps, -shift_us);
+    ref->xtal_err = 1.0 + (clk->drift / 1E6);
+
+    return LGW_GPS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+double lgw_clock_error_us(const struct lgw_clock_s *clk, double holdover) {
+    double var;
+
+    if ((clk == NULL) || (clk->init == false)) {
+        return -1.0;
+    }
+
+    /* offset variance predicted over the holdover */
+    var = clk->p[0][0] + holdover * (clk->p[0][1] + clk->p[1][0]) + holdover * holdover * clk->p[1][1];
+    var += (CLOCK_PHASE_NOISE * holdover) + (CLOCK_DRIFT_NOISE * holdover * holdover * holdover / 3.0);
+
+    return sqrt(var);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_gps2cnt(struct tref ref, struct timespec gps_time, uint32_t *count_us) {
     double delta_sec;
 
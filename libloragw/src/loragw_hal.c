@@ -30,8 +30,10 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
 #include <string.h>     /* memcpy */
+#include <math.h>       /* lroundf */
 #include <unistd.h>     /* symlink, unlink */
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "loragw_reg.h"
 #include "loragw_hal.h"
@@ -44,9 +46,12 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_sx1261.h"
 #include "loragw_sx1302.h"
 #include "loragw_sx1302_timestamp.h"
+#include "loragw_cal.h"
 #include "loragw_stts751.h"
 #include "loragw_ad5338r.h"
 #include "loragw_debug.h"
+#include "loragw_trace.h"
+#include "loragw_replay.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- DEBUG CONSTANTS ------------------------------------------------------ */
@@ -82,9 +87,14 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define CONTEXT_LORA_SERVICE    lgw_context.lora_service_cfg
 #define CONTEXT_FSK             lgw_context.fsk_cfg
 #define CONTEXT_TX_GAIN_LUT     lgw_context.tx_gain_lut
+#define CONTEXT_TX_GAIN_MAP     lgw_context.tx_gain_map
+#define CONTEXT_TX_GAIN_OFFSET  lgw_context.tx_gain_temp_offset
 #define CONTEXT_FINE_TIMESTAMP  lgw_context.ftime_cfg
 #define CONTEXT_SX1261          lgw_context.sx1261_cfg
 #define CONTEXT_DEBUG           lgw_context.debug_cfg
+#define CONTEXT_START_TIMING    lgw_context.start_timing
+#define CONTEXT_TX_PREPARED     lgw_context.tx_prepared
+#define CONTEXT_CHAN_STATS      lgw_context.chan_stats
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
@@ -103,6 +113,26 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define LGW_RF_RX_FREQ_MIN          100E6
 #define LGW_RF_RX_FREQ_MAX          1E9
 
+#define RX_WAIT_POLL_MS_SPI         1   /* RX buffer polling interval of lgw_receive_wait, on SPI */
+#define RX_WAIT_POLL_MS_USB         3   /* RX buffer polling interval of lgw_receive_wait, on USB (slower round-trip) */
+#define RX_WAIT_POLL_MS_MAX         100 /* longest RX buffer polling interval, reached while the buffer stays empty */
+
+#define RX_CURSOR_PKT_NB            255 /* packets held by the lgw_receive_begin cursor, above what a fetch can return */
+
+#define TEMP_SAMPLING_PERIOD_MS     10000 /* default refresh period of the cached temperature */
+
+#define INSTCNT_ESTIMATE_MAX_AGE_US 20000 /* counter reads more recent than this are extrapolated by lgw_get_instcnt (a few ppm drift) */
+#define INSTCNT_SNAPSHOT_MAX_AGE_US 1000000 /* oldest counter read usable by lgw_get_instcnt_estimate */
+#define RECOVER_COUNTER_MAX_AGE_US 60000000 /* counter reads more recent than this are used to check the counter after a reconnection */
+#define RECOVER_COUNTER_TOLERANCE_US 20000 /* host clock drift and link latency accepted on that check */
+
+#define MERGE_TABLE_SIZE            512 /* de-duplication hash table slots, power of 2 at least twice the max number of packets fetched */
+#define MERGE_SLOT_EMPTY            0xFFFF
+
+#define RSSI_TCOMP_TEMP_MIN         (-40) /* temperature range of the RSSI compensation table, in C */
+#define RSSI_TCOMP_TEMP_MAX         125
+#define RSSI_TCOMP_LUT_SIZE         ((RSSI_TCOMP_TEMP_MAX - RSSI_TCOMP_TEMP_MIN) * 2 + 1) /* 0.5 C steps */
+
 /* Version string, used to identify the library version/options once compiled */
 const char lgw_version_string[] = "Version: " LIBLORAGW_VERSION ";";
 
@@ -114,13 +144,15 @@ const char lgw_version_string[] = "Version: " LIBLORAGW_VERSION ";";
 #include "agc_fw_sx1257.var"    /* text_agc_sx1257_19_Nov_1 */
 
 /*
-The following static variable holds the gateway configuration provided by the
-user that need to be propagated in the drivers.
+The following static variables hold the gateway configuration provided by the
+user that need to be propagated in the drivers, one per concentrator board.
+lgw_context is the one of the board selected by the calling thread, set to the
+default values on first use.
 
 Parameters validity and coherency is verified by the _setconf functions and
 the _start and _send functions assume they are valid.
 */
-static lgw_context_t lgw_context = {
+static const lgw_context_t lgw_context_default = {
     .is_started = false,
     .board_cfg.com_type = LGW_COM_SPI,
     .board_cfg.com_path = "/dev/spidev0.0",
@@ -199,12 +231,66 @@ static lgw_context_t lgw_context = {
     }
 };
 
+static lgw_context_t lgw_context_board[LGW_BOARD_NB_MAX];
+static bool lgw_context_valid[LGW_BOARD_NB_MAX] = { false };
+#define lgw_context (*lgw_context_get())
+
+/* Board handles given by lgw_open */
+static lgw_handle_t lgw_handle_board[LGW_BOARD_NB_MAX];
+static bool lgw_handle_used[LGW_BOARD_NB_MAX] = { false };
+static pthread_mutex_t mx_handle = PTHREAD_MUTEX_INITIALIZER;
+
 /* File handle to write debug logs */
 FILE * log_file = NULL;
 
 /* I2C temperature sensor handles */
-static int     ts_fd = -1;
-static uint8_t ts_addr = 0xFF;
+static int     ts_fd_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = -1 };
+static uint8_t ts_addr_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = 0xFF };
+#define ts_fd   ts_fd_board[lgw_board_cur]
+#define ts_addr ts_addr_board[lgw_board_cur]
+
+/* Cached temperature, refreshed by a background thread of each board (I2C sensor only) */
+static pthread_t thrid_temp_board[LGW_BOARD_NB_MAX];
+static pthread_mutex_t mx_temp_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = PTHREAD_MUTEX_INITIALIZER };
+static volatile bool temp_run_board[LGW_BOARD_NB_MAX] = { false };
+static float temp_cached_board[LGW_BOARD_NB_MAX] = { 0.0 };
+static uint32_t temp_period_ms_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = TEMP_SAMPLING_PERIOD_MS };
+#define thrid_temp      thrid_temp_board[lgw_board_cur]
+#define mx_temp         mx_temp_board[lgw_board_cur]
+#define temp_run        temp_run_board[lgw_board_cur]
+#define temp_cached     temp_cached_board[lgw_board_cur]
+#define temp_period_ms  temp_period_ms_board[lgw_board_cur]
+
+/* TX gain LUT selection according to temperature */
+static lgw_txgain_temp_hook_t txgain_temp_hook = NULL;
+
+/* Running configuration being changed by lgw_reconfigure */
+static bool reconf_board[LGW_BOARD_NB_MAX] = { false };
+#define reconf_in_progress reconf_board[lgw_board_cur]
+
+/* Pacing of the RX buffer checks, kept between the calls of lgw_receive_wait */
+static uint32_t rx_wait_poll_board[LGW_BOARD_NB_MAX] = { 0 };   /* interval after the next empty check, in ms */
+static int64_t rx_wait_due_board[LGW_BOARD_NB_MAX] = { 0 };     /* time of the next check after an empty one, in ns */
+#define rx_wait_poll    rx_wait_poll_board[lgw_board_cur]
+#define rx_wait_due     rx_wait_due_board[lgw_board_cur]
+
+/* Packets handed out by the lgw_receive_begin/next/end cursor, owned by the HAL */
+static struct lgw_pkt_rx_s rx_cursor_pkt_board[LGW_BOARD_NB_MAX][RX_CURSOR_PKT_NB];
+static struct lgw_pkt_rx_s * rx_cursor_ref_board[LGW_BOARD_NB_MAX][RX_CURSOR_PKT_NB];
+static int rx_cursor_nb_board[LGW_BOARD_NB_MAX] = { 0 };    /* packets of the current cursor */
+static int rx_cursor_next_board[LGW_BOARD_NB_MAX] = { 0 };  /* next packet given by lgw_receive_next */
+static bool rx_cursor_open_board[LGW_BOARD_NB_MAX] = { false };
+#define rx_cursor_pkt   rx_cursor_pkt_board[lgw_board_cur]
+#define rx_cursor_ref   rx_cursor_ref_board[lgw_board_cur]
+#define rx_cursor_nb    rx_cursor_nb_board[lgw_board_cur]
+#define rx_cursor_next  rx_cursor_next_board[lgw_board_cur]
+#define rx_cursor_open  rx_cursor_open_board[lgw_board_cur]
+
+#if RX_FIXED_POINT
+/* RSSI offset of each RF chain, board calibration and temperature compensation, in 0.01 dB */
+static int16_t rssi_tcomp_lut_board[LGW_BOARD_NB_MAX][LGW_RF_CHAIN_NB][RSSI_TCOMP_LUT_SIZE];
+#define rssi_tcomp_lut rssi_tcomp_lut_board[lgw_board_cur]
+#endif
 
 /* I2C AD5338 handles */
 static int     ad_fd = -1;
@@ -219,8 +305,38 @@ int32_t lgw_sf_getval(int x);
 int32_t lgw_bw_getval(int x);
 
 static bool is_same_pkt(struct lgw_pkt_rx_s *p1, struct lgw_pkt_rx_s *p2);
-static int remove_pkt(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt, uint8_t pkt_index);
-static int merge_packets(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt);
+static bool is_same_tx_pkt(const struct lgw_pkt_tx_s *p1, const struct lgw_pkt_tx_s *p2);
+static inline uint32_t merge_pkt_hash(const struct lgw_pkt_rx_s * p);
+static bool merge_pkt_replace(const struct lgw_pkt_rx_s * kept, const struct lgw_pkt_rx_s * dup);
+static int merge_packets(struct lgw_pkt_rx_s ** p, uint8_t * nb_pkt);
+static int receive(uint8_t max_pkt, struct lgw_pkt_rx_s ** pkt_ref);
+static void pkt_array_reorder(struct lgw_pkt_rx_s * pkt_data, struct lgw_pkt_rx_s ** pkt_ref, uint8_t nb_pkt, uint8_t max_pkt);
+static inline uint32_t trace_payload_word(const struct lgw_pkt_rx_s * p, uint16_t offset);
+static inline lgw_context_t * lgw_context_get(void);
+
+static uint32_t start_phase_ms(struct timeval * phase_start);
+static bool rxif_modem_changed(const struct lgw_conf_rxif_s * a, const struct lgw_conf_rxif_s * b);
+
+static int lgw_send_check(struct lgw_pkt_tx_s * pkt_data);
+static inline void tx_count_sync(struct lgw_pkt_tx_s * pkt_data);
+static int lgw_send_run(struct lgw_pkt_tx_s * pkt_data, bool prepared);
+static int lgw_send_pa_set(void);
+static void txgain_map_build(uint8_t rf_chain);
+#if RX_FIXED_POINT
+static void rssi_tcomp_lut_build(void);
+static int16_t rssi_tcomp_lut_get(uint8_t rf_chain, float temperature);
+#endif
+static const struct lgw_tx_gain_s * txgain_select(const struct lgw_pkt_tx_s * pkt_data);
+static void txgain_temp_update(float temperature);
+static bool lbt_armed_any(void);
+static void lbt_disarm_prepared(void);
+static void rx_moments_add(struct lgw_rx_moments_s * m, int16_t val_x10);
+static void rx_moments_merge(struct lgw_rx_moments_s * dst, const struct lgw_rx_moments_s * src);
+static void chan_stats_update(struct lgw_pkt_rx_s * const * pkt_ref, uint8_t nb_pkt);
+
+static void * thread_temperature(void * arg);
+static int temperature_sampler_start(void);
+static void temperature_sampler_stop(void);
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
@@ -252,6 +368,20 @@ int32_t lgw_sf_getval(int x) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Pack 4 payload bytes, from offset, in a trace record argument (zero padded) */
+static inline uint32_t trace_payload_word(const struct lgw_pkt_rx_s * p, uint16_t offset) {
+    uint32_t w = 0;
+    uint16_t i;
+
+    for (i = offset; (i < (offset + 4)) && (i < p->size); i++) {
+        w |= (uint32_t)p->payload[i] << (8 * (3 - (i - offset)));
+    }
+
+    return w;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static bool is_same_pkt(struct lgw_pkt_rx_s *p1, struct lgw_pkt_rx_s *p2) {
     if ((p1 != NULL) && (p2 != NULL)) {
         /* Criterias to determine if packets are identical:
@@ -275,55 +405,93 @@ static bool is_same_pkt(struct lgw_pkt_rx_s *p1, struct lgw_pkt_rx_s *p2) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-static int remove_pkt(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt, uint8_t pkt_index) {
-    /* Check input parameters */
-    CHECK_NULL(p);
-    CHECK_NULL(nb_pkt);
-    if (pkt_index > ((*nb_pkt) - 1)) {
-        printf("ERROR: failed to remove packet index %u\n", pkt_index);
-        return -1;
+static bool is_same_tx_pkt(const struct lgw_pkt_tx_s *p1, const struct lgw_pkt_tx_s *p2) {
+    /* Everything uploaded to the TX chain must be identical, emission mode and time are only used by the trigger */
+    return ((p1->rf_chain == p2->rf_chain) &&
+            (p1->freq_hz == p2->freq_hz) &&
+            (p1->rf_power == p2->rf_power) &&
+            (p1->modulation == p2->modulation) &&
+            (p1->freq_offset == p2->freq_offset) &&
+            (p1->bandwidth == p2->bandwidth) &&
+            (p1->datarate == p2->datarate) &&
+            (p1->coderate == p2->coderate) &&
+            (p1->invert_pol == p2->invert_pol) &&
+            (p1->f_dev == p2->f_dev) &&
+            (p1->preamble == p2->preamble) &&
+            (p1->no_crc == p2->no_crc) &&
+            (p1->no_header == p2->no_header) &&
+            (p1->size == p2->size) &&
+            (memcmp(p1->payload, p2->payload, p1->size) == 0));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Hash of the packet fields which must match between duplicates (FNV-1a), count_us is compared on lookup */
+static inline uint32_t merge_pkt_hash(const struct lgw_pkt_rx_s * p) {
+    uint32_t h = 2166136261u;
+    uint16_t i;
+
+    h = (h ^ p->if_chain) * 16777619u;
+    h = (h ^ p->datarate) * 16777619u;
+    h = (h ^ (p->size & 0xFF)) * 16777619u;
+    h = (h ^ (p->size >> 8)) * 16777619u;
+    for (i = 0; i < p->size; i++) {
+        h = (h ^ p->payload[i]) * 16777619u;
     }
 
-    /* Remove pkt from array, by replacing it with last packet of array */
-    if (pkt_index == ((*nb_pkt) - 1)) {
-        /* If we remove last element, just decrement nb packet counter */
-        /* Do nothing */
-    } else {
-        /* Copy last packet onto the packet to be removed */
-        memcpy(p + pkt_index, p + (*nb_pkt) - 1, sizeof(struct lgw_pkt_rx_s));
+    return h;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Tell if the duplicate dup has to replace the packet kept so far */
+static bool merge_pkt_replace(const struct lgw_pkt_rx_s * kept, const struct lgw_pkt_rx_s * dup) {
+    /* We keep the packet which has CRC checked */
+    if ((kept->status == STAT_CRC_OK) && (dup->status == STAT_CRC_BAD)) {
+        return false;
+    } else if ((kept->status == STAT_CRC_BAD) && (dup->status == STAT_CRC_OK)) {
+        return true;
     }
 
-    *nb_pkt -= 1;
+    /* sanity check */
+    if (kept->ftime_received == dup->ftime_received) {
+        DEBUG_MSG("WARNING: both duplicates have fine timestamps, or none has ? TBC\n");
+    }
 
-    return 0;
+    /* we keep the packet which has a fine timestamp */
+    return (kept->ftime_received == false);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int compare_pkt_tmst(const void *a, const void *b)
 {
-    int p_count, q_count;
+    uint64_t p_count, q_count;
 
-    p_count = ((struct lgw_pkt_rx_s *)a)->count_us;
-    q_count = ((struct lgw_pkt_rx_s *)b)->count_us;
+    /* the 64-bits counter orders the packets across the 32-bits counter wrap */
+    p_count = (*(struct lgw_pkt_rx_s * const *)a)->count_us64;
+    q_count = (*(struct lgw_pkt_rx_s * const *)b)->count_us64;
 
-    return (p_count - q_count);
+    return (p_count > q_count) - (p_count < q_count);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-static int merge_packets(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt) {
-    uint8_t cpt;
-    int j, k, pkt_dup_idx, x;
-#if DEBUG_HAL == 1
-    int pkt_idx;
-#endif
-    bool dup_restart = false;
+static int merge_packets(struct lgw_pkt_rx_s ** p, uint8_t * nb_pkt) {
+    uint8_t cpt, nb_kept;
+    int j, k;
+    uint16_t slot;
+    uint16_t table[MERGE_TABLE_SIZE];
+    struct lgw_pkt_rx_s * tmp;
+    int64_t tm;
 
     /* Check input parameters */
     CHECK_NULL(p);
     CHECK_NULL(nb_pkt);
 
+    /* Record function start time */
+    _meas_time_start(&tm);
+
     /* Init number of packets in array before merge */
     cpt = *nb_pkt;
 
@@ -333,9 +501,9 @@ static int merge_packets(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt) {
         DEBUG_MSG("<----- Searching for DUPLICATEs ------\n");
     }
     for (j = 0; j < cpt; j++) {
-        DEBUG_PRINTF("  %d: tmst=%u SF=%u CRC_status=%d freq=%u chan=%u", j, p[j].count_us, p[j].datarate, p[j].status, p[j].freq_hz, p[j].if_chain);
-        if (p[j].ftime_received == true) {
-            DEBUG_PRINTF(" ftime=%u\n", p[j].ftime);
+        DEBUG_PRINTF("  %d: tmst=%u SF=%u CRC_status=%d freq=%u chan=%u", j, p[j]->count_us, p[j]->datarate, p[j]->status, p[j]->freq_hz, p[j]->if_chain);
+        if (p[j]->ftime_received == true) {
+            DEBUG_PRINTF(" ftime=%u\n", p[j]->ftime);
         } else {
             DEBUG_MSG   (" ftime=NONE\n");
         }
@@ -343,73 +511,53 @@ static int merge_packets(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt) {
     /* ---------- For Debug only - END ------------- */
     /* --------------------------------------------- */
 
-    /* Remove duplicates */
-    j = 0;
-    while (j < cpt) {
-        for (k = (j+1); k < cpt; k++) {
+    /* Remove duplicates in a single pass:
+        -- each packet is looked up in a hash table of the packets kept so far
+        -- a duplicate either replaces the kept packet in place, or is dropped
+        -- kept packets are compacted at the beginning of the array
+        -- the packets are only swapped, the dropped ones end up after the kept ones
+    */
+    for (j = 0; j < MERGE_TABLE_SIZE; j++) {
+        table[j] = MERGE_SLOT_EMPTY;
+    }
+    nb_kept = 0;
+    for (j = 0; j < cpt; j++) {
+        slot = merge_pkt_hash(p[j]) & (MERGE_TABLE_SIZE - 1);
+        while (table[slot] != MERGE_SLOT_EMPTY) {
             /* Searching for duplicated packets:
                 -- count_us should be equal or can have up to 24µs of difference (3 samples)
                 -- channel should be same
                 -- datarate should be same
                 -- payload should be same
             */
-            if (is_same_pkt( &p[j], &p[k])) {
-                /* We keep the packet which has CRC checked */
-                if ((p[j].status == STAT_CRC_OK) && (p[k].status == STAT_CRC_BAD)) {
-                    pkt_dup_idx = k;
-#if DEBUG_HAL == 1
-                    pkt_idx = j;
-#endif
-                } else if ((p[j].status == STAT_CRC_BAD) && (p[k].status == STAT_CRC_OK)) {
-                    pkt_dup_idx = j;
-#if DEBUG_HAL == 1
-                    pkt_idx = k;
-#endif
-                } else {
-                    /* we keep the packet which has a fine timestamp */
-                    if (p[j].ftime_received == true) {
-                        pkt_dup_idx = k;
-#if DEBUG_HAL == 1
-                        pkt_idx = j;
-#endif
-                    } else {
-                        pkt_dup_idx = j;
-#if DEBUG_HAL == 1
-                        pkt_idx = k;
-#endif
-                    }
-                    /* sanity check */
-                    if (((p[j].ftime_received == true) && (p[k].ftime_received == true)) ||
-                        ((p[j].ftime_received == false) && (p[k].ftime_received == false))) {
-                        DEBUG_MSG("WARNING: both duplicates have fine timestamps, or none has ? TBC\n");
-                    }
-                }
-                /* pkt_dup_idx contains the index to be deleted */
-                DEBUG_PRINTF("duplicate found %d:%d, deleting %d\n", pkt_idx, pkt_dup_idx, pkt_dup_idx);
-                /* Remove duplicated packet from packet array */
-                x = remove_pkt(p, &cpt, pkt_dup_idx);
-                if (x != 0) {
-                    printf("ERROR: failed to remove packet from array (%d)\n", x);
-                }
-                dup_restart = true;
+            if (is_same_pkt(p[table[slot]], p[j])) {
                 break;
             }
+            slot = (slot + 1) & (MERGE_TABLE_SIZE - 1);
         }
-        if (dup_restart == true) {
-            /* Duplicate found, restart searching for duplicate from first element */
-            j = 0;
-            dup_restart = false;
-#if 0
-            printf( "restarting search for duplicate\n" ); /* Too verbose */
-#endif
+
+        if (table[slot] == MERGE_SLOT_EMPTY) {
+            /* No duplicate found, keep the packet */
+            if (nb_kept != j) {
+                tmp = p[nb_kept];
+                p[nb_kept] = p[j];
+                p[j] = tmp;
+            }
+            table[slot] = nb_kept;
+            nb_kept += 1;
         } else {
-            /* No duplicate found, continue... */
-            j += 1;
-#if 0
-            printf( "no duplicate found\n" ); /* Too verbose */
-#endif
+            k = table[slot];
+            if (merge_pkt_replace(p[k], p[j]) == true) {
+                DEBUG_PRINTF("duplicate found %d:%d, deleting %d\n", j, k, k);
+                tmp = p[k];
+                p[k] = p[j];
+                p[j] = tmp;
+            } else {
+                DEBUG_PRINTF("duplicate found %d:%d, deleting %d\n", k, j, j);
+            }
         }
     }
+    cpt = nb_kept;
 
     /* Sort the packet array by ascending counter_us value */
     qsort(p, cpt, sizeof(p[0]), compare_pkt_tmst);
@@ -421,9 +569,9 @@ static int merge_packets(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt) {
         DEBUG_MSG("--\n");
     }
     for (j = 0; j < cpt; j++) {
-        DEBUG_PRINTF("  %d: tmst=%u SF=%d CRC_status=%d freq=%u chan=%u", j, p[j].count_us, p[j].datarate, p[j].status, p[j].freq_hz, p[j].if_chain);
-        if (p[j].ftime_received == true) {
-            DEBUG_PRINTF(" ftime=%u\n", p[j].ftime);
+        DEBUG_PRINTF("  %d: tmst=%u SF=%d CRC_status=%d freq=%u chan=%u", j, p[j]->count_us, p[j]->datarate, p[j]->status, p[j]->freq_hz, p[j]->if_chain);
+        if (p[j]->ftime_received == true) {
+            DEBUG_PRINTF(" ftime=%u\n", p[j]->ftime);
         } else {
             DEBUG_MSG   (" ftime=NONE\n");
         }
@@ -437,172 +585,733 @@ static int merge_packets(struct lgw_pkt_rx_s * p, uint8_t * nb_pkt) {
     /* Update number of packets contained in packet array */
     *nb_pkt = cpt;
 
+    _meas_time_stop(2, tm, __FUNCTION__);
+
     return 0;
 }
 
-/* -------------------------------------------------------------------------- */
-/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_i2c_set_path(const char *path) {
-    if (path) {
-        strcpy(i2c_device, path);
-        DEBUG_PRINTF("Setting I2C device: %s\n", i2c_device);
-        return LGW_I2C_SUCCESS;
-    }
-    else {
-        return LGW_I2C_ERROR;
+/* Move the packets referenced by pkt_ref, all in pkt_data, at the beginning of pkt_data, in order */
+static void pkt_array_reorder(struct lgw_pkt_rx_s * pkt_data, struct lgw_pkt_rx_s ** pkt_ref, uint8_t nb_pkt, uint8_t max_pkt) {
+    uint8_t pos[256]; /* current position of each packet, by initial position */
+    uint8_t at[256]; /* initial position of the packet at each position */
+    struct lgw_pkt_rx_s tmp;
+    int i, j, k;
+
+    for (i = 0; i < max_pkt; i++) {
+        pos[i] = (uint8_t)i;
+        at[i] = (uint8_t)i;
+    }
+    for (i = 0; i < nb_pkt; i++) {
+        j = pos[pkt_ref[i] - pkt_data];
+        if (j == i) {
+            continue;
+        }
+        tmp = pkt_data[i];
+        pkt_data[i] = pkt_data[j];
+        pkt_data[j] = tmp;
+        k = at[i];
+        at[i] = at[j];
+        at[j] = (uint8_t)k;
+        pos[at[i]] = (uint8_t)i;
+        pos[at[j]] = (uint8_t)j;
     }
 }
 
-int lgw_i2c_set_temp_sensor_addr(uint8_t addr) {
-    ts_addr = addr;
-    return LGW_I2C_SUCCESS;
-}
-
-int lgw_board_setconf(struct lgw_conf_board_s * conf) {
-    CHECK_NULL(conf);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* check if the concentrator is running */
-    if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
-        return LGW_HAL_ERROR;
+static inline lgw_context_t * lgw_context_get(void) {
+    if (lgw_context_valid[lgw_board_cur] == false) {
+        lgw_context_board[lgw_board_cur] = lgw_context_default;
+        lgw_context_valid[lgw_board_cur] = true;
     }
 
-    /* Check input parameters */
-    if ((conf->com_type != LGW_COM_SPI) && (conf->com_type != LGW_COM_USB)) {
-        DEBUG_MSG("ERROR: WRONG COM TYPE\n");
-        return LGW_HAL_ERROR;
-    }
+    return &lgw_context_board[lgw_board_cur];
+}
 
-    /* set internal config according to parameters */
-    CONTEXT_LWAN_PUBLIC = conf->lorawan_public;
-    CONTEXT_BOARD.clksrc = conf->clksrc;
-    CONTEXT_BOARD.full_duplex = conf->full_duplex;
-    CONTEXT_COM_TYPE = conf->com_type;
-    strncpy(CONTEXT_COM_PATH, conf->com_path, sizeof CONTEXT_COM_PATH);
-    CONTEXT_COM_PATH[sizeof CONTEXT_COM_PATH - 1] = '\0'; /* ensure string termination */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    DEBUG_PRINTF("Note: board configuration: com_type: %s, com_path: %s, lorawan_public:%d, clksrc:%d, full_duplex:%d\n",   (CONTEXT_COM_TYPE == LGW_COM_SPI) ? "SPI" : "USB",
-                                                                                                                            CONTEXT_COM_PATH,
-                                                                                                                            CONTEXT_LWAN_PUBLIC,
-                                                                                                                            CONTEXT_BOARD.clksrc,
-                                                                                                                            CONTEXT_BOARD.full_duplex);
+static uint32_t start_phase_ms(struct timeval * phase_start) {
+    struct timeval tm;
+    uint32_t elapsed_ms;
 
-    return LGW_HAL_SUCCESS;
+    gettimeofday(&tm, NULL);
+    elapsed_ms = (uint32_t)((tm.tv_sec - phase_start->tv_sec) * 1000 + (tm.tv_usec - phase_start->tv_usec) / 1000);
+    *phase_start = tm;
+
+    return elapsed_ms;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s * conf) {
-    CHECK_NULL(conf);
+static bool rxif_modem_changed(const struct lgw_conf_rxif_s * a, const struct lgw_conf_rxif_s * b) {
+    return (a->bandwidth != b->bandwidth) || (a->datarate != b->datarate) ||
+           (a->sync_word_size != b->sync_word_size) || (a->sync_word != b->sync_word) ||
+           (a->implicit_hdr != b->implicit_hdr) || (a->implicit_payload_length != b->implicit_payload_length) ||
+           (a->implicit_crc_en != b->implicit_crc_en) || (a->implicit_coderate != b->implicit_coderate);
+}
 
-    /* check if the concentrator is running */
-    if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
-        return LGW_HAL_ERROR;
-    }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    if (conf->enable == false) {
-        /* nothing to do */
-        DEBUG_PRINTF("Note: rf_chain %d disabled\n", rf_chain);
-        return LGW_HAL_SUCCESS;
+static inline void tx_count_sync(struct lgw_pkt_tx_s * pkt_data) {
+    /* the TX trigger compares the 32 LSBs of the counter */
+    if ((pkt_data->tx_mode == TIMESTAMPED) && (pkt_data->count_us64 != 0)) {
+        pkt_data->count_us = (uint32_t)pkt_data->count_us64;
     }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+static int lgw_send_check(struct lgw_pkt_tx_s * pkt_data) {
     /* check input range (segfault prevention) */
-    if (rf_chain >= LGW_RF_CHAIN_NB) {
-        DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
+    if (pkt_data->rf_chain >= LGW_RF_CHAIN_NB) {
+        printf("ERROR: INVALID RF_CHAIN TO SEND PACKETS\n");
         return LGW_HAL_ERROR;
     }
 
-    /* check if radio type is supported */
-    if ((conf->type != LGW_RADIO_TYPE_SX1255) && (conf->type != LGW_RADIO_TYPE_SX1257) && (conf->type != LGW_RADIO_TYPE_SX1250)) {
-        DEBUG_PRINTF("ERROR: NOT A VALID RADIO TYPE (%d)\n", conf->type);
+    /* check input variables */
+    if (CONTEXT_RF_CHAIN[pkt_data->rf_chain].tx_enable == false) {
+        printf("ERROR: SELECTED RF_CHAIN IS DISABLED FOR TX ON SELECTED BOARD\n");
         return LGW_HAL_ERROR;
     }
-
-    /* check if the radio central frequency is valid */
-    if ((conf->freq_hz < LGW_RF_RX_FREQ_MIN) || (conf->freq_hz > LGW_RF_RX_FREQ_MAX)) {
-        DEBUG_PRINTF("ERROR: NOT A VALID RADIO CENTER FREQUENCY, PLEASE CHECK IF IT HAS BEEN GIVEN IN HZ (%u)\n", conf->freq_hz);
+    if (CONTEXT_RF_CHAIN[pkt_data->rf_chain].enable == false) {
+        printf("ERROR: SELECTED RF_CHAIN IS DISABLED\n");
+        return LGW_HAL_ERROR;
+    }
+    if (!IS_TX_MODE(pkt_data->tx_mode)) {
+        printf("ERROR: TX_MODE NOT SUPPORTED\n");
+        return LGW_HAL_ERROR;
+    }
+    if (pkt_data->modulation == MOD_LORA) {
+        if (!IS_LORA_BW(pkt_data->bandwidth)) {
+            printf("ERROR: BANDWIDTH NOT SUPPORTED BY LORA TX\n");
+            return LGW_HAL_ERROR;
+        }
+        if (!IS_LORA_DR(pkt_data->datarate)) {
+            printf("ERROR: DATARATE NOT SUPPORTED BY LORA TX\n");
+            return LGW_HAL_ERROR;
+        }
+        if (!IS_LORA_CR(pkt_data->coderate)) {
+            printf("ERROR: CODERATE NOT SUPPORTED BY LORA TX\n");
+            return LGW_HAL_ERROR;
+        }
+        if (pkt_data->size > 255) {
+            printf("ERROR: PAYLOAD LENGTH TOO BIG FOR LORA TX\n");
+            return LGW_HAL_ERROR;
+        }
+    } else if (pkt_data->modulation == MOD_FSK) {
+        if((pkt_data->f_dev < 1) || (pkt_data->f_dev > 200)) {
+            printf("ERROR: TX FREQUENCY DEVIATION OUT OF ACCEPTABLE RANGE\n");
+            return LGW_HAL_ERROR;
+        }
+        if(!IS_FSK_DR(pkt_data->datarate)) {
+            printf("ERROR: DATARATE NOT SUPPORTED BY FSK IF CHAIN\n");
+            return LGW_HAL_ERROR;
+        }
+        if (pkt_data->size > 255) {
+            printf("ERROR: PAYLOAD LENGTH TOO BIG FOR FSK TX\n");
+            return LGW_HAL_ERROR;
+        }
+    } else if (pkt_data->modulation == MOD_CW) {
+        /* do nothing */
+    } else {
+        printf("ERROR: INVALID TX MODULATION\n");
         return LGW_HAL_ERROR;
     }
-
-    /* set internal config according to parameters */
-    CONTEXT_RF_CHAIN[rf_chain].enable = conf->enable;
-    CONTEXT_RF_CHAIN[rf_chain].freq_hz = conf->freq_hz;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_offset = conf->rssi_offset;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_a = conf->rssi_tcomp.coeff_a;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_b = conf->rssi_tcomp.coeff_b;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_c = conf->rssi_tcomp.coeff_c;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_d = conf->rssi_tcomp.coeff_d;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_e = conf->rssi_tcomp.coeff_e;
-    CONTEXT_RF_CHAIN[rf_chain].type = conf->type;
-    CONTEXT_RF_CHAIN[rf_chain].tx_enable = conf->tx_enable;
-    CONTEXT_RF_CHAIN[rf_chain].single_input_mode = conf->single_input_mode;
-
-    DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f radio_type:%d tx_enable:%d single_input_mode:%d\n",  rf_chain,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].enable,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].freq_hz,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].rssi_offset,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].type,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].tx_enable,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].single_input_mode);
 
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s * conf) {
-    int32_t bw_hz;
-    uint32_t rf_rx_bandwidth;
+static int lgw_send_run(struct lgw_pkt_tx_s * pkt_data, bool prepared) {
+    int err;
+    bool lbt_tx_allowed;
+    /* performances variables */
+    int64_t tm;
 
-    CHECK_NULL(conf);
+    /* Record function start time */
+    _meas_time_start(&tm);
 
-    /* check if the concentrator is running */
-    if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
-        return LGW_HAL_ERROR;
+    err = lgw_send_pa_set();
+    if (err != LGW_HAL_SUCCESS) {
+        return err;
     }
 
-    /* check input range (segfault prevention) */
-    if (if_chain >= LGW_IF_CHAIN_NB) {
-        DEBUG_PRINTF("ERROR: %d NOT A VALID IF_CHAIN NUMBER\n", if_chain);
-        return LGW_HAL_ERROR;
+    /* Start Listen-Before-Talk, or only complete the scan time if it was armed at preparation */
+    if (CONTEXT_SX1261.lbt_conf.enable == true) {
+        if ((prepared == true) && (CONTEXT_TX_PREPARED[pkt_data->rf_chain].lbt_armed == true)) {
+            err = lgw_lbt_wait_scan();
+        } else {
+            err = lgw_lbt_start(&CONTEXT_SX1261, pkt_data);
+        }
+        lbt_disarm_prepared(); /* the SX1261 scans for this packet only, until LBT is stopped */
+        if (err != 0) {
+            printf("ERROR: failed to start LBT\n");
+            return LGW_HAL_ERROR;
+        }
     }
 
-    /* if chain is disabled, don't care about most parameters */
-    if (conf->enable == false) {
-        CONTEXT_IF_CHAIN[if_chain].enable = false;
-        CONTEXT_IF_CHAIN[if_chain].freq_hz = 0;
-        DEBUG_PRINTF("Note: if_chain %d disabled\n", if_chain);
-        return LGW_HAL_SUCCESS;
+    /* Send the TX request to the concentrator, only the trigger if the packet is already uploaded */
+    if (prepared == true) {
+        err = sx1302_send_commit(pkt_data->rf_chain, pkt_data->tx_mode, pkt_data->count_us, CONTEXT_TX_PREPARED[pkt_data->rf_chain].start_delay);
+    } else {
+        err = sx1302_send(CONTEXT_RF_CHAIN[pkt_data->rf_chain].type, txgain_select(pkt_data), CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK, pkt_data);
     }
+    /* the TX chain registers are now used by this packet */
+    CONTEXT_TX_PREPARED[pkt_data->rf_chain].valid = false;
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: %s: Failed to send packet\n", __FUNCTION__);
+
+        if (CONTEXT_SX1261.lbt_conf.enable == true) {
+            err = lgw_lbt_stop();
+            if (err != 0) {
+                printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
+            }
+        }
 
-    /* check 'general' parameters */
-    if (sx1302_get_ifmod_config(if_chain) == IF_UNDEFINED) {
-        DEBUG_PRINTF("ERROR: IF CHAIN %d NOT CONFIGURABLE\n", if_chain);
-    }
-    if (conf->rf_chain >= LGW_RF_CHAIN_NB) {
-        DEBUG_MSG("ERROR: INVALID RF_CHAIN TO ASSOCIATE WITH A LORA_STD IF CHAIN\n");
         return LGW_HAL_ERROR;
     }
-    /* check if IF frequency is optimal based on channel and radio bandwidths */
-    switch (conf->bandwidth) {
-        case BW_250KHZ:
-            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_250KHZ; /* radio bandwidth */
-            break;
-        case BW_500KHZ:
-            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_500KHZ; /* radio bandwidth */
-            break;
-        default:
-            /* For 125KHz and below */
-            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_125KHZ; /* radio bandwidth */
-            break;
-    }
-    bw_hz = lgw_bw_getval(conf->bandwidth); /* channel bandwidth */
-    if ((conf->freq_hz + ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) > ((int32_t)rf_rx_bandwidth/2)) {
-        DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO HIGH\n", conf->freq_hz);
-        return LGW_HAL_ERROR;
+
+    _meas_time_stop(1, tm, __FUNCTION__);
+
+    /* Stop Listen-Before-Talk */
+    if (CONTEXT_SX1261.lbt_conf.enable == true) {
+        err = lgw_lbt_tx_status(pkt_data->rf_chain, &lbt_tx_allowed);
+        if (err != 0) {
+            printf("ERROR: %s: Failed to get LBT TX status, TX aborted\n", __FUNCTION__);
+            err = sx1302_tx_abort(pkt_data->rf_chain);
+            if (err != 0) {
+                printf("ERROR: %s: Failed to abort TX\n", __FUNCTION__);
+            }
+            err = lgw_lbt_stop();
+            if (err != 0) {
+                printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
+            }
+            return LGW_HAL_ERROR;
+        }
+        if (lbt_tx_allowed == true) {
+            printf("LBT: packet is allowed to be transmitted\n");
+        } else {
+            printf("LBT: (ERROR) packet is NOT allowed to be transmitted\n");
+        }
+
+        err = lgw_lbt_stop();
+        if (err != 0) {
+            printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    if (CONTEXT_SX1261.lbt_conf.enable == true && lbt_tx_allowed == false) {
+        return LGW_LBT_NOT_ALLOWED;
+    } else {
+        return LGW_HAL_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int lgw_send_pa_set(void) {
+    int err;
+
+    /* Set PA gain with AD5338R when using full duplex CN490 ref design */
+    if (CONTEXT_BOARD.full_duplex == true) {
+        uint8_t volt_val[AD5338R_CMD_SIZE] = {0x39, VOLTAGE2HEX_H(2.51), VOLTAGE2HEX_L(2.51)}; /* set to 2.51V */
+        err = ad5338r_write(ad_fd, I2C_PORT_DAC_AD5338R, volt_val);
+        if (err != LGW_I2C_SUCCESS) {
+            printf("ERROR: failed to set voltage by ad5338r\n");
+            return LGW_HAL_ERROR;
+        }
+        printf("INFO: AD5338R: Set DAC output to 0x%02X 0x%02X\n", (uint8_t)VOLTAGE2HEX_H(2.51), (uint8_t)VOLTAGE2HEX_L(2.51));
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#if RX_FIXED_POINT
+static void rssi_tcomp_lut_build(void) {
+    int i, j;
+    float offset;
+
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        for (j = 0; j < RSSI_TCOMP_LUT_SIZE; j++) {
+            offset = CONTEXT_RF_CHAIN[i].rssi_offset + sx1302_rssi_get_temperature_offset(&CONTEXT_RF_CHAIN[i].rssi_tcomp, RSSI_TCOMP_TEMP_MIN + (float)j / 2);
+            rssi_tcomp_lut[i][j] = (int16_t)lroundf(offset * 100);
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* RSSI offset in 0.1 dB, rounded half away from zero, the temperature being clamped to the table range */
+static int16_t rssi_tcomp_lut_get(uint8_t rf_chain, float temperature) {
+    int i;
+    int16_t offset;
+
+    i = (int)lroundf((temperature - RSSI_TCOMP_TEMP_MIN) * 2);
+    if (i < 0) {
+        i = 0;
+    } else if (i >= RSSI_TCOMP_LUT_SIZE) {
+        i = RSSI_TCOMP_LUT_SIZE - 1;
+    }
+    offset = rssi_tcomp_lut[rf_chain][i];
+
+    return (offset < 0) ? ((offset - 5) / 10) : ((offset + 5) / 10);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+#endif
+
+/* for each requested power, the entry with the highest power not above it, or the lowest entry */
+static void txgain_map_build(uint8_t rf_chain) {
+    int p, i;
+    int best, lowest = 0;
+    const struct lgw_tx_gain_lut_s * lut = &CONTEXT_TX_GAIN_LUT[rf_chain];
+
+    for (i = 1; i < lut->size; i++) {
+        if (lut->lut[i].rf_power < lut->lut[lowest].rf_power) {
+            lowest = i;
+        }
+    }
+
+    for (p = 0; p < TX_GAIN_MAP_SIZE; p++) {
+        best = -1;
+        for (i = 0; i < lut->size; i++) {
+            if ((lut->lut[i].rf_power <= (p + INT8_MIN)) && ((best == -1) || (lut->lut[i].rf_power > lut->lut[best].rf_power))) {
+                best = i;
+            }
+        }
+        CONTEXT_TX_GAIN_MAP[rf_chain][p] = (uint8_t)((best == -1) ? lowest : best);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static const struct lgw_tx_gain_s * txgain_select(const struct lgw_pkt_tx_s * pkt_data) {
+    int p = pkt_data->rf_power + CONTEXT_TX_GAIN_OFFSET[pkt_data->rf_chain];
+
+    if (p < INT8_MIN) {
+        p = INT8_MIN;
+    } else if (p > INT8_MAX) {
+        p = INT8_MAX;
+    }
+
+    return &CONTEXT_TX_GAIN_LUT[pkt_data->rf_chain].lut[CONTEXT_TX_GAIN_MAP[pkt_data->rf_chain][p - INT8_MIN]];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void txgain_temp_update(float temperature) {
+    int i;
+
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        CONTEXT_TX_GAIN_OFFSET[i] = (txgain_temp_hook != NULL) ? txgain_temp_hook(i, temperature) : 0;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool lbt_armed_any(void) {
+    int i;
+
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if ((CONTEXT_TX_PREPARED[i].valid == true) && (CONTEXT_TX_PREPARED[i].lbt_armed == true)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void lbt_disarm_prepared(void) {
+    int i;
+
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        CONTEXT_TX_PREPARED[i].lbt_armed = false;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rx_moments_add(struct lgw_rx_moments_s * m, int16_t val_x10) {
+    if ((m->nb == 0) || (val_x10 < m->min_x10)) {
+        m->min_x10 = val_x10;
+    }
+    if ((m->nb == 0) || (val_x10 > m->max_x10)) {
+        m->max_x10 = val_x10;
+    }
+    m->nb += 1;
+    m->sum_x10 += val_x10;
+    m->sumsq_x100 += (uint64_t)((int32_t)val_x10 * val_x10);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rx_moments_merge(struct lgw_rx_moments_s * dst, const struct lgw_rx_moments_s * src) {
+    if (src->nb == 0) {
+        return;
+    }
+    if ((dst->nb == 0) || (src->min_x10 < dst->min_x10)) {
+        dst->min_x10 = src->min_x10;
+    }
+    if ((dst->nb == 0) || (src->max_x10 > dst->max_x10)) {
+        dst->max_x10 = src->max_x10;
+    }
+    dst->nb += src->nb;
+    dst->sum_x10 += src->sum_x10;
+    dst->sumsq_x100 += src->sumsq_x100;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void chan_stats_update(struct lgw_pkt_rx_s * const * pkt_ref, uint8_t nb_pkt) {
+    const struct lgw_pkt_rx_s * p;
+    struct lgw_chan_stat_s * c;
+    int sf, i;
+
+    for (i = 0; i < nb_pkt; i++) {
+        p = pkt_ref[i];
+        if (p->if_chain >= LGW_IF_CHAIN_NB) {
+            continue;
+        }
+        sf = (p->modulation == MOD_LORA) ? (lgw_sf_getval(p->datarate) - 5) : 0;
+        c = &CONTEXT_CHAN_STATS.chan[p->if_chain][(sf < 0) ? 0 : sf];
+
+        c->nb_pkt += 1;
+        if (p->status == STAT_CRC_BAD) {
+            c->nb_crc_bad += 1;
+        } else if (p->status == STAT_NO_CRC) {
+            c->nb_no_crc += 1;
+        }
+        rx_moments_add(&c->rssi, p->rssic_x10);
+        if (p->modulation == MOD_LORA) {
+            rx_moments_add(&c->snr, p->snr_x10);
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void * thread_temperature(void * arg) {
+    int err;
+    uint32_t waited_ms;
+    float temperature;
+
+    lgw_board_cur = (uint8_t)(uintptr_t)arg; /* the sensor state of the board which started the thread */
+
+    while (temp_run == true) {
+        /* sleep by small steps to be able to exit quickly */
+        for (waited_ms = 0; (waited_ms < temp_period_ms) && (temp_run == true); waited_ms += 100) {
+            wait_ms(100);
+        }
+        if (temp_run == false) {
+            break;
+        }
+
+        err = stts751_get_temperature(ts_fd, ts_addr, &temperature);
+        if (err != LGW_I2C_SUCCESS) {
+            printf("WARNING: failed to refresh temperature, keeping previous value\n");
+            continue;
+        }
+
+        pthread_mutex_lock(&mx_temp);
+        temp_cached = temperature;
+        pthread_mutex_unlock(&mx_temp);
+    }
+
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int temperature_sampler_start(void) {
+    int err;
+    float temperature;
+
+    /* initial value, so that the cache is valid before the first refresh */
+    err = stts751_get_temperature(ts_fd, ts_addr, &temperature);
+    if (err != LGW_I2C_SUCCESS) {
+        printf("ERROR: failed to get initial temperature\n");
+        return LGW_HAL_ERROR;
+    }
+    temp_cached = temperature;
+
+    /* a null period disables the cache, temperature is read on each lgw_receive */
+    if (temp_period_ms == 0) {
+        return LGW_HAL_SUCCESS;
+    }
+
+    temp_run = true;
+    if (pthread_create(&thrid_temp, NULL, thread_temperature, (void *)(uintptr_t)lgw_board_cur) != 0) {
+        printf("ERROR: failed to create temperature sampling thread\n");
+        temp_run = false;
+        return LGW_HAL_ERROR;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void temperature_sampler_stop(void) {
+    if (temp_run == true) {
+        temp_run = false;
+        pthread_join(thrid_temp, NULL);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+lgw_handle_t * lgw_open(void) {
+    int i;
+    lgw_handle_t * handle = NULL;
+
+    pthread_mutex_lock(&mx_handle);
+    for (i = 0; i < LGW_BOARD_NB_MAX; i++) {
+        if (lgw_handle_used[i] == false) {
+            lgw_handle_used[i] = true;
+            lgw_handle_board[i].board = (uint8_t)i;
+            /* start from the default configuration */
+            lgw_context_board[i] = lgw_context_default;
+            lgw_context_valid[i] = true;
+            handle = &lgw_handle_board[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mx_handle);
+
+    if (handle == NULL) {
+        printf("ERROR: no more concentrator board available (max %d)\n", LGW_BOARD_NB_MAX);
+    }
+
+    return handle;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_close(lgw_handle_t * handle) {
+    CHECK_NULL(handle);
+
+    if ((handle->board >= LGW_BOARD_NB_MAX) || (handle != &lgw_handle_board[handle->board])) {
+        printf("ERROR: invalid concentrator handle\n");
+        return LGW_HAL_ERROR;
+    }
+    if (lgw_context_board[handle->board].is_started == true) {
+        printf("ERROR: concentrator %u is running, stop it before closing\n", handle->board);
+        return LGW_HAL_ERROR;
+    }
+
+    pthread_mutex_lock(&mx_handle);
+    lgw_handle_used[handle->board] = false;
+    lgw_context_valid[handle->board] = false;
+    pthread_mutex_unlock(&mx_handle);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_select(lgw_handle_t * handle) {
+    CHECK_NULL(handle);
+
+    if ((handle->board >= LGW_BOARD_NB_MAX) || (lgw_handle_used[handle->board] == false)) {
+        printf("ERROR: invalid concentrator handle\n");
+        return LGW_HAL_ERROR;
+    }
+
+    lgw_board_cur = handle->board;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_i2c_set_path(const char *path) {
+    if (path) {
+        strcpy(i2c_device, path);
+        DEBUG_PRINTF("Setting I2C device: %s\n", i2c_device);
+        return LGW_I2C_SUCCESS;
+    }
+    else {
+        return LGW_I2C_ERROR;
+    }
+}
+
+int lgw_i2c_set_temp_sensor_addr(uint8_t addr) {
+    ts_addr = addr;
+    return LGW_I2C_SUCCESS;
+}
+
+int lgw_i2c_set_temp_sensor_period(uint32_t period_ms) {
+    temp_period_ms = period_ms;
+    return LGW_I2C_SUCCESS;
+}
+
+int lgw_cal_cache_set_path(const char * path) {
+    return sx1302_cal_cache_set_path(path);
+}
+
+int lgw_cal_set_fast_mode(bool enable) {
+    sx1302_cal_set_fast_mode(enable);
+    return LGW_HAL_SUCCESS;
+}
+
+int lgw_fw_set_fast_check(bool enable) {
+    sx1302_fw_set_fast_check(enable);
+    return LGW_HAL_SUCCESS;
+}
+
+int lgw_board_setconf(struct lgw_conf_board_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == true) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Check input parameters */
+    if ((conf->com_type != LGW_COM_SPI) && (conf->com_type != LGW_COM_USB) && (conf->com_type != LGW_COM_REPLAY) && (conf->com_type != LGW_COM_SIM)) {
+        DEBUG_MSG("ERROR: WRONG COM TYPE\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* set internal config according to parameters */
+    CONTEXT_LWAN_PUBLIC = conf->lorawan_public;
+    CONTEXT_BOARD.clksrc = conf->clksrc;
+    CONTEXT_BOARD.full_duplex = conf->full_duplex;
+    CONTEXT_COM_TYPE = conf->com_type;
+    strncpy(CONTEXT_COM_PATH, conf->com_path, sizeof CONTEXT_COM_PATH);
+    CONTEXT_COM_PATH[sizeof CONTEXT_COM_PATH - 1] = '\0'; /* ensure string termination */
+
+    DEBUG_PRINTF("Note: board configuration: com_type: %s, com_path: %s, lorawan_public:%d, clksrc:%d, full_duplex:%d\n",   (CONTEXT_COM_TYPE == LGW_COM_SPI) ? "SPI" : "USB",
+                                                                                                                            CONTEXT_COM_PATH,
+                                                                                                                            CONTEXT_LWAN_PUBLIC,
+                                                                                                                            CONTEXT_BOARD.clksrc,
+                                                                                                                            CONTEXT_BOARD.full_duplex);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running, lgw_reconfigure applies the changes then */
+    if ((CONTEXT_STARTED == true) && (reconf_in_progress == false)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    if (conf->enable == false) {
+        /* nothing to do */
+        DEBUG_PRINTF("Note: rf_chain %d disabled\n", rf_chain);
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* check input range (segfault prevention) */
+    if (rf_chain >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* check if radio type is supported */
+    if ((conf->type != LGW_RADIO_TYPE_SX1255) && (conf->type != LGW_RADIO_TYPE_SX1257) && (conf->type != LGW_RADIO_TYPE_SX1250)) {
+        DEBUG_PRINTF("ERROR: NOT A VALID RADIO TYPE (%d)\n", conf->type);
+        return LGW_HAL_ERROR;
+    }
+
+    /* check if the radio central frequency is valid */
+    if ((conf->freq_hz < LGW_RF_RX_FREQ_MIN) || (conf->freq_hz > LGW_RF_RX_FREQ_MAX)) {
+        DEBUG_PRINTF("ERROR: NOT A VALID RADIO CENTER FREQUENCY, PLEASE CHECK IF IT HAS BEEN GIVEN IN HZ (%u)\n", conf->freq_hz);
+        return LGW_HAL_ERROR;
+    }
+
+    /* set internal config according to parameters */
+    CONTEXT_RF_CHAIN[rf_chain].enable = conf->enable;
+    CONTEXT_RF_CHAIN[rf_chain].freq_hz = conf->freq_hz;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_offset = conf->rssi_offset;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_a = conf->rssi_tcomp.coeff_a;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_b = conf->rssi_tcomp.coeff_b;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_c = conf->rssi_tcomp.coeff_c;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_d = conf->rssi_tcomp.coeff_d;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_e = conf->rssi_tcomp.coeff_e;
+    CONTEXT_RF_CHAIN[rf_chain].type = conf->type;
+    CONTEXT_RF_CHAIN[rf_chain].tx_enable = conf->tx_enable;
+    CONTEXT_RF_CHAIN[rf_chain].single_input_mode = conf->single_input_mode;
+
+    DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f radio_type:%d tx_enable:%d single_input_mode:%d\n",  rf_chain,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].enable,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].freq_hz,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].rssi_offset,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].type,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].tx_enable,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].single_input_mode);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s * conf) {
+    int32_t bw_hz;
+    uint32_t rf_rx_bandwidth;
+
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running, lgw_reconfigure applies the changes then */
+    if ((CONTEXT_STARTED == true) && (reconf_in_progress == false)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* check input range (segfault prevention) */
+    if (if_chain >= LGW_IF_CHAIN_NB) {
+        DEBUG_PRINTF("ERROR: %d NOT A VALID IF_CHAIN NUMBER\n", if_chain);
+        return LGW_HAL_ERROR;
+    }
+
+    /* if chain is disabled, don't care about most parameters */
+    if (conf->enable == false) {
+        CONTEXT_IF_CHAIN[if_chain].enable = false;
+        CONTEXT_IF_CHAIN[if_chain].freq_hz = 0;
+        DEBUG_PRINTF("Note: if_chain %d disabled\n", if_chain);
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* check 'general' parameters */
+    if (sx1302_get_ifmod_config(if_chain) == IF_UNDEFINED) {
+        DEBUG_PRINTF("ERROR: IF CHAIN %d NOT CONFIGURABLE\n", if_chain);
+    }
+    if (conf->rf_chain >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN TO ASSOCIATE WITH A LORA_STD IF CHAIN\n");
+        return LGW_HAL_ERROR;
+    }
+    /* check if IF frequency is optimal based on channel and radio bandwidths */
+    switch (conf->bandwidth) {
+        case BW_250KHZ:
+            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_250KHZ; /* radio bandwidth */
+            break;
+        case BW_500KHZ:
+            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_500KHZ; /* radio bandwidth */
+            break;
+        default:
+            /* For 125KHz and below */
+            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_125KHZ; /* radio bandwidth */
+            break;
+    }
+    bw_hz = lgw_bw_getval(conf->bandwidth); /* channel bandwidth */
+    if ((conf->freq_hz + ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) > ((int32_t)rf_rx_bandwidth/2)) {
+        DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO HIGH\n", conf->freq_hz);
+        return LGW_HAL_ERROR;
     } else if ((conf->freq_hz - ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) < -((int32_t)rf_rx_bandwidth/2)) {
         DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO LOW\n", conf->freq_hz);
         return LGW_HAL_ERROR;
@@ -776,8 +1485,46 @@ int lgw_txgain_setconf(uint8_t rf_chain, struct lgw_tx_gain_lut_s * conf) {
         CONTEXT_TX_GAIN_LUT[rf_chain].lut[i].offset_i = 0; /* To be calibrated */
         CONTEXT_TX_GAIN_LUT[rf_chain].lut[i].offset_q = 0; /* To be calibrated */
 
-        /* sx1250 */
-        CONTEXT_TX_GAIN_LUT[rf_chain].lut[i].pwr_idx = conf->lut[i].pwr_idx;
+        /* sx1250 */
+        CONTEXT_TX_GAIN_LUT[rf_chain].lut[i].pwr_idx = conf->lut[i].pwr_idx;
+    }
+
+    /* power selection done once here, a lookup on the TX path */
+    txgain_map_build(rf_chain);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_txgain_lookup(uint8_t rf_chain, int8_t rf_power, uint8_t * lut_index, int8_t * rf_power_used) {
+    uint8_t idx;
+
+    if ((rf_chain >= LGW_RF_CHAIN_NB) || (CONTEXT_TX_GAIN_LUT[rf_chain].size == 0)) {
+        return LGW_HAL_ERROR;
+    }
+
+    idx = CONTEXT_TX_GAIN_MAP[rf_chain][rf_power - INT8_MIN];
+    if (lut_index != NULL) {
+        *lut_index = idx;
+    }
+    if (rf_power_used != NULL) {
+        *rf_power_used = CONTEXT_TX_GAIN_LUT[rf_chain].lut[idx].rf_power;
+    }
+
+    return (CONTEXT_TX_GAIN_LUT[rf_chain].lut[idx].rf_power == rf_power) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_txgain_set_temp_hook(lgw_txgain_temp_hook_t hook) {
+    int i;
+
+    txgain_temp_hook = hook;
+    if (hook == NULL) {
+        for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+            CONTEXT_TX_GAIN_OFFSET[i] = 0;
+        }
     }
 
     return LGW_HAL_SUCCESS;
@@ -859,9 +1606,17 @@ int lgw_debug_setconf(struct lgw_conf_debug_s * conf) {
 int lgw_start(void) {
     int i, err;
     uint8_t fw_version_agc;
+    float cal_temperature;
+    float * cal_temperature_ptr = NULL;
+    struct timeval tm_start, tm_phase;
 
     DEBUG_PRINTF(" --- %s\n", "IN");
 
+    timeout_start(&tm_start);
+    tm_phase = tm_start;
+    memset(&CONTEXT_START_TIMING, 0, sizeof CONTEXT_START_TIMING);
+    memset(&CONTEXT_CHAN_STATS, 0, sizeof CONTEXT_CHAN_STATS);
+
     if (CONTEXT_STARTED == true) {
         DEBUG_MSG("Note: LoRa concentrator already started, restarting it now\n");
     }
@@ -878,24 +1633,50 @@ int lgw_start(void) {
         printf("ERROR: failed to set all GPIOs to 0\n");
         return LGW_HAL_ERROR;
     }
+    CONTEXT_START_TIMING.connect_ms = start_phase_ms(&tm_phase);
+
+    /* Start the temperature sensor, its measure selects the cached calibration results */
+    if ((CONTEXT_COM_TYPE == LGW_COM_SPI) && (ts_addr != 0xFF)) {
+        err = i2c_linuxdev_open(i2c_device, ts_addr, &ts_fd);
+        if (err != LGW_I2C_SUCCESS) {
+            printf("ERROR: failed to open I2C for temperature sensor on port 0x%02X\n", ts_addr);
+            return LGW_HAL_ERROR;
+        }
+
+        err = stts751_configure(ts_fd, ts_addr);
+        if (err != LGW_I2C_SUCCESS) {
+            printf("INFO: no temperature sensor found on port 0x%02X\n", ts_addr);
+            i2c_linuxdev_close(ts_fd);
+            ts_fd = -1;
+        } else {
+            err = temperature_sampler_start();
+            if (err != LGW_HAL_SUCCESS) {
+                return LGW_HAL_ERROR;
+            }
+        }
+    }
 
     /* Calibrate radios */
-    err = sx1302_radio_calibrate(&CONTEXT_RF_CHAIN[0], CONTEXT_BOARD.clksrc, &CONTEXT_TX_GAIN_LUT[0]);
+    if ((sx1302_cal_cache_path() != NULL) && (lgw_get_temperature(&cal_temperature) == LGW_HAL_SUCCESS)) {
+        cal_temperature_ptr = &cal_temperature;
+    }
+    err = sx1302_radio_calibrate(&CONTEXT_RF_CHAIN[0], CONTEXT_BOARD.clksrc, &CONTEXT_TX_GAIN_LUT[0], cal_temperature_ptr);
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: radio calibration failed\n");
         return LGW_HAL_ERROR;
     }
+    CONTEXT_START_TIMING.calibration_ms = start_phase_ms(&tm_phase);
+
+    /* Reset radios, both at once to share the reset delay */
+    err = sx1302_radio_reset_all(&CONTEXT_RF_CHAIN[0]);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to reset radios\n");
+        return LGW_HAL_ERROR;
+    }
 
     /* Setup radios for RX */
     for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
         if (CONTEXT_RF_CHAIN[i].enable == true) {
-            /* Reset the radio */
-            err = sx1302_radio_reset(i, CONTEXT_RF_CHAIN[i].type);
-            if (err != LGW_REG_SUCCESS) {
-                printf("ERROR: failed to reset radio %d\n", i);
-                return LGW_HAL_ERROR;
-            }
-
             /* Setup the radio */
             switch (CONTEXT_RF_CHAIN[i].type) {
                 case LGW_RADIO_TYPE_SX1250:
@@ -936,6 +1717,14 @@ int lgw_start(void) {
         printf("ERROR: failed to release control over radios\n");
         return LGW_HAL_ERROR;
     }
+    CONTEXT_START_TIMING.radio_setup_ms = start_phase_ms(&tm_phase);
+
+    /* Shadow the configuration registers while no firmware is running, to save read-modify-write accesses */
+    err = lgw_reg_shadow_enable(true);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to load registers shadow copy\n");
+        return LGW_HAL_ERROR;
+    }
 
     /* Basic initialization of the sx1302 */
     err = sx1302_init(&CONTEXT_FINE_TIMESTAMP);
@@ -944,6 +1733,13 @@ int lgw_start(void) {
         return LGW_HAL_ERROR;
     }
 
+    /* Group the write-only configuration sequence in as few transfers as possible (USB only) */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to set bulk write mode\n");
+        return LGW_HAL_ERROR;
+    }
+
     /* Configure PA/LNA LUTs */
     err = sx1302_pa_lna_lut_configure(&CONTEXT_BOARD);
     if (err != LGW_REG_SUCCESS) {
@@ -1000,6 +1796,16 @@ int lgw_start(void) {
         }
     }
 
+    /* derive the demodulation parameters of the IF chains for the packets parsing */
+    err = sx1302_parse_configure(&lgw_context);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 packets parsing\n");
+        return LGW_HAL_ERROR;
+    }
+#if RX_FIXED_POINT
+    rssi_tcomp_lut_build();
+#endif
+
     /* configure syncword */
     err = sx1302_lora_syncword(CONTEXT_LWAN_PUBLIC, CONTEXT_LORA_SERVICE.datarate);
     if (err != LGW_REG_SUCCESS) {
@@ -1014,6 +1820,23 @@ int lgw_start(void) {
         return LGW_HAL_ERROR;
     }
 
+    /* Send the configuration, the AGC/ARB start sequences need register reads */
+    err = lgw_com_flush();
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to flush SX1302 configuration\n");
+        return LGW_HAL_ERROR;
+    }
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to set single write mode\n");
+        return LGW_HAL_ERROR;
+    }
+
+    CONTEXT_START_TIMING.config_ms = start_phase_ms(&tm_phase);
+
+    /* AGC and ARB firmwares may update configuration registers from now on */
+    lgw_reg_shadow_enable(false);
+
     /* Load AGC firmware */
     switch (CONTEXT_RF_CHAIN[CONTEXT_BOARD.clksrc].type) {
         case LGW_RADIO_TYPE_SX1250:
@@ -1057,8 +1880,14 @@ int lgw_start(void) {
         printf("ERROR: failed to start ARB firmware\n");
         return LGW_HAL_ERROR;
     }
+    CONTEXT_START_TIMING.firmware_ms = start_phase_ms(&tm_phase);
 
-    /* static TX configuration */
+    /* static TX configuration and GPS, write-only as well */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to set bulk write mode\n");
+        return LGW_HAL_ERROR;
+    }
     err = sx1302_tx_configure(CONTEXT_RF_CHAIN[CONTEXT_BOARD.clksrc].type);
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: failed to configure SX1302 TX path\n");
@@ -1071,6 +1900,16 @@ int lgw_start(void) {
         printf("ERROR: failed to enable GPS on sx1302\n");
         return LGW_HAL_ERROR;
     }
+    err = lgw_com_flush();
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to flush SX1302 TX configuration\n");
+        return LGW_HAL_ERROR;
+    }
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to set single write mode\n");
+        return LGW_HAL_ERROR;
+    }
 
     /* For debug logging */
 #if HAL_DEBUG_FILE_LOG
@@ -1103,22 +1942,15 @@ int lgw_start(void) {
     /* Configure the pseudo-random generator (For Debug) */
     dbg_init_random();
 
-    if (CONTEXT_COM_TYPE == LGW_COM_SPI) {
-        if (ts_addr != 0xFF) {
-            err = i2c_linuxdev_open(i2c_device, ts_addr, &ts_fd);
-            if (err != LGW_I2C_SUCCESS) {
-                printf("ERROR: failed to open I2C for temperature sensor on port 0x%02X\n", ts_addr);
-                return LGW_HAL_ERROR;
-            }
-
-            err = stts751_configure(ts_fd, ts_addr);
-            if (err != LGW_I2C_SUCCESS) {
-                printf("INFO: no temperature sensor found on port 0x%02X\n", ts_addr);
-                i2c_linuxdev_close(ts_fd);
-                ts_fd = -1;
-            }
+    /* Check the reference payloads received, the mismatches are logged in background */
+    dbg_per_reset();
+    if (CONTEXT_DEBUG.nb_ref_payload > 0) {
+        if (dbg_per_start(log_file) != 0) {
+            printf("WARNING: failed to start the log of the reference payload errors\n");
         }
+    }
 
+    if (CONTEXT_COM_TYPE == LGW_COM_SPI) {
         /* Configure ADC AD338R for full duplex (CN490 reference design) */
         if (CONTEXT_BOARD.full_duplex == true) {
             err = i2c_linuxdev_open(i2c_device, I2C_PORT_DAC_AD5338R, &ad_fd);
@@ -1173,6 +2005,13 @@ int lgw_start(void) {
         }
     }
 
+    /* Precompute the timestamp corrections of the configured channels */
+    err = timestamp_correction_table_init(&lgw_context);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to precompute timestamp corrections\n");
+        return LGW_HAL_ERROR;
+    }
+
     /* Set CONFIG_DONE GPIO to 1 (turn on the corresponding LED) */
     err = sx1302_set_gpio(0x01);
     if (err != LGW_REG_SUCCESS) {
@@ -1180,8 +2019,16 @@ int lgw_start(void) {
         return LGW_HAL_ERROR;
     }
 
+    CONTEXT_START_TIMING.other_ms = start_phase_ms(&tm_phase);
+    CONTEXT_START_TIMING.total_ms = start_phase_ms(&tm_start);
+    printf("INFO: concentrator started in %u ms (connect:%u calibration:%u radios:%u config:%u firmwares:%u other:%u)\n",
+            CONTEXT_START_TIMING.total_ms, CONTEXT_START_TIMING.connect_ms, CONTEXT_START_TIMING.calibration_ms,
+            CONTEXT_START_TIMING.radio_setup_ms, CONTEXT_START_TIMING.config_ms, CONTEXT_START_TIMING.firmware_ms,
+            CONTEXT_START_TIMING.other_ms);
+
     /* set hal state */
     CONTEXT_STARTED = true;
+    memset(CONTEXT_TX_PREPARED, 0, sizeof CONTEXT_TX_PREPARED); /* nothing uploaded to the TX chains */
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
 
@@ -1211,6 +2058,7 @@ int lgw_stop(void) {
     }
 
     /* Close log file */
+    dbg_per_stop();
     if (log_file != NULL) {
         fclose(log_file);
         log_file = NULL;
@@ -1225,6 +2073,7 @@ int lgw_stop(void) {
 
     if (CONTEXT_COM_TYPE == LGW_COM_SPI) {
         if (ts_fd != -1) {
+            temperature_sampler_stop();
             DEBUG_MSG("INFO: Closing I2C for temperature sensor\n");
             x = i2c_linuxdev_close(ts_fd);
             if (x != 0) {
@@ -1243,7 +2092,14 @@ int lgw_stop(void) {
         }
     }
 
+    timestamp_correction_table_free();
+
+    /* The packets of a cursor left open are released */
+    rx_cursor_nb = 0;
+    rx_cursor_open = false;
+
     CONTEXT_STARTED = false;
+    memset(CONTEXT_TX_PREPARED, 0, sizeof CONTEXT_TX_PREPARED); /* nothing uploaded to the TX chains */
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
 
@@ -1252,14 +2108,190 @@ int lgw_stop(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
+int lgw_reconfigure(struct lgw_conf_rxrf_s * rf_conf, struct lgw_conf_rxif_s * if_conf) {
+    int i, err = LGW_HAL_SUCCESS;
+    uint16_t if_mask = 0;
+    bool corr_changed, service_changed, fsk_changed;
+    struct lgw_conf_rxrf_s rf_prev[LGW_RF_CHAIN_NB];
+    struct lgw_conf_rxif_s if_prev[LGW_IF_CHAIN_NB];
+    struct lgw_conf_rxif_s lora_service_prev, fsk_prev;
+    struct lgw_conf_demod_s demod_prev;
+    int64_t tm_start;
+
+    CHECK_NULL(if_conf);
+
+    if (CONTEXT_STARTED == false) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, USE LGW_START\n");
+        return LGW_HAL_ERROR;
+    }
+    tm_start = time_monotonic_ns();
+
+    /* A radio is only retuned by a calibration, lgw_start is needed to change it */
+    for (i = 0; (rf_conf != NULL) && (i < LGW_RF_CHAIN_NB); i++) {
+        if ((rf_conf[i].enable != CONTEXT_RF_CHAIN[i].enable) ||
+            ((rf_conf[i].enable == true) && ((rf_conf[i].freq_hz != CONTEXT_RF_CHAIN[i].freq_hz) ||
+                                             (rf_conf[i].type != CONTEXT_RF_CHAIN[i].type) ||
+                                             (rf_conf[i].tx_enable != CONTEXT_RF_CHAIN[i].tx_enable) ||
+                                             (rf_conf[i].single_input_mode != CONTEXT_RF_CHAIN[i].single_input_mode)))) {
+            printf("ERROR: radio %d configuration changed, the concentrator must be restarted\n", i);
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    /* Check and apply the new configuration, the previous one is restored on error */
+    memcpy(rf_prev, CONTEXT_RF_CHAIN, sizeof rf_prev);
+    memcpy(if_prev, CONTEXT_IF_CHAIN, sizeof if_prev);
+    lora_service_prev = CONTEXT_LORA_SERVICE;
+    fsk_prev = CONTEXT_FSK;
+    demod_prev = CONTEXT_DEMOD;
+    reconf_in_progress = true;
+    for (i = 0; (rf_conf != NULL) && (i < LGW_RF_CHAIN_NB) && (err == LGW_HAL_SUCCESS); i++) {
+        err = lgw_rxrf_setconf(i, &rf_conf[i]);
+        if (err != LGW_HAL_SUCCESS) {
+            printf("ERROR: invalid configuration for radio %d, running configuration kept\n", i);
+        }
+    }
+    for (i = 0; (i < LGW_IF_CHAIN_NB) && (err == LGW_HAL_SUCCESS); i++) {
+        err = lgw_rxif_setconf(i, &if_conf[i]);
+        if (err != LGW_HAL_SUCCESS) {
+            printf("ERROR: invalid configuration for IF chain %d, running configuration kept\n", i);
+        }
+    }
+    reconf_in_progress = false;
+    if (err != LGW_HAL_SUCCESS) {
+        memcpy(CONTEXT_RF_CHAIN, rf_prev, sizeof rf_prev);
+        memcpy(CONTEXT_IF_CHAIN, if_prev, sizeof if_prev);
+        CONTEXT_LORA_SERVICE = lora_service_prev;
+        CONTEXT_FSK = fsk_prev;
+        return LGW_HAL_ERROR;
+    }
+
+    /* Registers to update */
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        if ((CONTEXT_IF_CHAIN[i].freq_hz != if_prev[i].freq_hz) || (CONTEXT_IF_CHAIN[i].rf_chain != if_prev[i].rf_chain)) {
+            if_mask |= (1 << i);
+        }
+    }
+    corr_changed = (CONTEXT_DEMOD.multisf_datarate != demod_prev.multisf_datarate);
+    for (i = 0; i < LGW_MULTI_NB; i++) {
+        corr_changed |= (CONTEXT_IF_CHAIN[i].enable != if_prev[i].enable);
+    }
+    service_changed = (CONTEXT_IF_CHAIN[8].enable != if_prev[8].enable) || rxif_modem_changed(&CONTEXT_LORA_SERVICE, &lora_service_prev);
+    fsk_changed = (CONTEXT_IF_CHAIN[9].enable != if_prev[9].enable) || rxif_modem_changed(&CONTEXT_FSK, &fsk_prev);
+    DEBUG_PRINTF("Note: reconfiguration, IF frequencies:0x%03X correlators:%d service:%d fsk:%d\n", if_mask, corr_changed, service_changed, fsk_changed);
+
+    /* Write the changes in a single transfer (USB only), the parameters of the disabled channels are left as they are */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    if (err != LGW_COM_SUCCESS) {
+        printf("ERROR: failed to set bulk write mode\n");
+        return LGW_HAL_ERROR;
+    }
+    if (if_mask != 0) {
+        err |= sx1302_channelizer_update(CONTEXT_IF_CHAIN, if_mask);
+    }
+    if (corr_changed == true) {
+        err |= sx1302_lora_correlator_enable(CONTEXT_IF_CHAIN, &(CONTEXT_DEMOD));
+    }
+    if ((service_changed == true) && (CONTEXT_IF_CHAIN[8].enable == true)) {
+        err |= sx1302_lora_service_correlator_configure(&(CONTEXT_LORA_SERVICE));
+        err |= sx1302_lora_service_modem_configure(&(CONTEXT_LORA_SERVICE), CONTEXT_RF_CHAIN[0].freq_hz);
+        err |= sx1302_lora_syncword(CONTEXT_LWAN_PUBLIC, CONTEXT_LORA_SERVICE.datarate);
+    }
+    if ((fsk_changed == true) && (CONTEXT_IF_CHAIN[9].enable == true)) {
+        err |= sx1302_fsk_configure(&(CONTEXT_FSK));
+    }
+    if ((service_changed == true) || (fsk_changed == true)) {
+        err |= sx1302_modem_select(CONTEXT_IF_CHAIN[8].enable, CONTEXT_IF_CHAIN[9].enable);
+    }
+    err |= lgw_com_flush();
+    err |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to update SX1302 configuration, the concentrator must be restarted\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Host side derived tables */
+    err = sx1302_parse_configure(&lgw_context);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 packets parsing\n");
+        return LGW_HAL_ERROR;
+    }
+#if RX_FIXED_POINT
+    rssi_tcomp_lut_build();
+#endif
+    err = timestamp_correction_table_init(&lgw_context);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to precompute timestamp corrections\n");
+        return LGW_HAL_ERROR;
+    }
+
+    printf("INFO: concentrator reconfigured in %.3f ms\n", (double)(time_monotonic_ns() - tm_start) / 1E6);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_recover(bool * restarted) {
+    int err;
+
+    DEBUG_PRINTF(" --- %s\n", "IN");
+
+    CHECK_NULL(restarted);
+    *restarted = false;
+
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, NOTHING TO RECOVER\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Open the COM link again, without resetting the concentrator */
+    err = lgw_reconnect(CONTEXT_COM_PATH);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to reconnect to the concentrator\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Keep the running configuration if the concentrator was not reset meanwhile */
+    if (sx1302_check_running(RECOVER_COUNTER_MAX_AGE_US, RECOVER_COUNTER_TOLERANCE_US) == LGW_REG_SUCCESS) {
+        printf("INFO: concentrator reconnected, configuration kept\n");
+        DEBUG_PRINTF(" --- %s\n", "OUT");
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* Full restart otherwise */
+    printf("INFO: concentrator state lost, restarting it\n");
+    lgw_stop();
+    err = lgw_start();
+    if (err != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to restart the concentrator\n");
+        return LGW_HAL_ERROR;
+    }
+    *restarted = true;
+
+    DEBUG_PRINTF(" --- %s\n", "OUT");
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int receive(uint8_t max_pkt, struct lgw_pkt_rx_s ** pkt_ref) {
     int res;
     uint8_t nb_pkt_fetched = 0;
     uint8_t nb_pkt_found = 0;
     uint8_t nb_pkt_left = 0;
-    float current_temperature = 0.0, rssi_temperature_offset = 0.0;
+    float current_temperature = 0.0;
+#if RX_FIXED_POINT
+    int i;
+    int16_t rssi_offset_x10[LGW_RF_CHAIN_NB];
+#else
+    float rssi_temperature_offset = 0.0;
+#endif
+    struct lgw_pkt_rx_s * p;
+    int64_t fetch_ns;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     DEBUG_PRINTF(" --- %s\n", "IN");
 
@@ -1272,6 +2304,7 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
         printf("ERROR: failed to fetch packets from SX1302\n");
         return LGW_HAL_ERROR;
     }
+    fetch_ns = time_monotonic_ns();
 
     /* Update internal counter */
     /* WARNING: this needs to be called regularly by the upper layer */
@@ -1280,11 +2313,24 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
         return LGW_HAL_ERROR;
     }
 
-    /* Exit now if no packet fetched */
+    /* Sample the ARB counters before they wrap */
+    res = sx1302_arb_stats_update(fetch_ns, LGW_ARB_STATS_PERIOD_MS);
+    if (res != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* Exit now if no packet fetched, the RX buffer was just found empty by this fetch */
     if (nb_pkt_fetched == 0) {
+        if (rx_wait_poll == 0) {
+            rx_wait_poll = (CONTEXT_COM_TYPE == LGW_COM_USB) ? RX_WAIT_POLL_MS_USB : RX_WAIT_POLL_MS_SPI;
+        }
+        rx_wait_due = fetch_ns + ((int64_t)rx_wait_poll * 1000000);
         _meas_time_stop(1, tm, __FUNCTION__);
         return 0;
     }
+    rx_wait_poll = 0;
+    rx_wait_due = 0;
+    LGW_TRACE(TRACE_HAL >= LGW_TRACE_LVL_EVENT, LGW_TRACE_HAL_RX_FETCH, nb_pkt_fetched, max_pkt, 0, 0, 0);
     if (nb_pkt_fetched > max_pkt) {
         nb_pkt_left = nb_pkt_fetched - max_pkt;
         printf("WARNING: not enough space allocated, fetched %d packet(s), %d will be left in RX buffer\n", nb_pkt_fetched, nb_pkt_left);
@@ -1292,6 +2338,7 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
 
     /* Apply RSSI temperature compensation */
     if (ts_fd != -1) {
+        /* cached value when sampled in background, no I2C access on the RX path */
         res = lgw_get_temperature(&current_temperature);
         if (res != LGW_I2C_SUCCESS) {
             printf("ERROR: failed to get current temperature\n");
@@ -1299,10 +2346,18 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
         }
     }
 
+#if RX_FIXED_POINT
+    /* the temperature is the same for all the packets fetched */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        rssi_offset_x10[i] = rssi_tcomp_lut_get(i, current_temperature);
+    }
+#endif
+
     /* Iterate on the RX buffer to get parsed packets */
     for (nb_pkt_found = 0; nb_pkt_found < ((nb_pkt_fetched <= max_pkt) ? nb_pkt_fetched : max_pkt); nb_pkt_found++) {
         /* Get packet and move to next one */
-        res = sx1302_parse(&lgw_context, &pkt_data[nb_pkt_found]);
+        p = pkt_ref[nb_pkt_found];
+        res = sx1302_parse(&lgw_context, p);
         if (res == LGW_REG_WARNING) {
             printf("WARNING: parsing error on packet %d, discarding fetched packets\n", nb_pkt_found);
             return LGW_HAL_SUCCESS;
@@ -1310,33 +2365,53 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
             printf("ERROR: fatal parsing error on packet %d, aborting...\n", nb_pkt_found);
             return LGW_HAL_ERROR;
         }
-
+        p->host_fetch_ns = fetch_ns;
+        p->host_parse_ns = time_monotonic_ns();
+
+#if RX_FIXED_POINT
+        /* Apply RSSI offset calibrated for the board and temperature compensation */
+        p->rssic_x10 += rssi_offset_x10[p->rf_chain];
+        p->rssis_x10 += rssi_offset_x10[p->rf_chain];
+        DEBUG_PRINTF("INFO: RSSI offset applied: %d x0.1 dB (current temperature %.1f C)\n", rssi_offset_x10[p->rf_chain], current_temperature);
+
+        /* float values for the API only */
+        p->rssic = (float)p->rssic_x10 / 10;
+        p->rssis = (float)p->rssis_x10 / 10;
+        p->snr = (float)p->snr_x10 / 10;
+#else
         /* Appli RSSI offset calibrated for the board */
-        pkt_data[nb_pkt_found].rssic += CONTEXT_RF_CHAIN[pkt_data[nb_pkt_found].rf_chain].rssi_offset;
-        pkt_data[nb_pkt_found].rssis += CONTEXT_RF_CHAIN[pkt_data[nb_pkt_found].rf_chain].rssi_offset;
+        p->rssic += CONTEXT_RF_CHAIN[p->rf_chain].rssi_offset;
+        p->rssis += CONTEXT_RF_CHAIN[p->rf_chain].rssi_offset;
 
-        rssi_temperature_offset = sx1302_rssi_get_temperature_offset(&CONTEXT_RF_CHAIN[pkt_data[nb_pkt_found].rf_chain].rssi_tcomp, current_temperature);
-        pkt_data[nb_pkt_found].rssic += rssi_temperature_offset;
-        pkt_data[nb_pkt_found].rssis += rssi_temperature_offset;
+        rssi_temperature_offset = sx1302_rssi_get_temperature_offset(&CONTEXT_RF_CHAIN[p->rf_chain].rssi_tcomp, current_temperature);
+        p->rssic += rssi_temperature_offset;
+        p->rssis += rssi_temperature_offset;
         DEBUG_PRINTF("INFO: RSSI temperature offset applied: %.3f dB (current temperature %.1f C)\n", rssi_temperature_offset, current_temperature);
-            /* Print parsed packet data */
-        printf("ERROR: Packet:- %d\n", nb_pkt_found);
-        printf("ERROR: Frequency:- %u Hz\n", pkt_data[nb_pkt_found].freq_hz);
-        printf("ERROR: RSSI:- %f (channel) %f (signal)\n", pkt_data[nb_pkt_found].rssic, pkt_data[nb_pkt_found].rssis);
-        printf("ERROR: SNR:- %f\n", pkt_data[nb_pkt_found].snr);
-        printf("ERROR:  Size:- %d bytes\n", pkt_data[nb_pkt_found].size);
-        printf("ERROR: Payload:- ");
-        for (int i = 0; i < pkt_data[nb_pkt_found].size; i++) {
-            printf("ERROR: %02X ", pkt_data[nb_pkt_found].payload[i]);
-        }
-        printf(" ERROR :\n");
+
+        p->rssic_x10 = (int16_t)lroundf(p->rssic * 10);
+        p->rssis_x10 = (int16_t)lroundf(p->rssis * 10);
+        p->snr_x10 = (int16_t)lroundf(p->snr * 10);
+#endif
+
+        LGW_TRACE(TRACE_HAL >= LGW_TRACE_LVL_PACKET, LGW_TRACE_HAL_RX_PKT,
+                    nb_pkt_found,
+                    p->freq_hz,
+                    p->rssic_x10,
+                    p->snr_x10,
+                    p->size | (p->status << 16));
+        LGW_TRACE(TRACE_HAL >= LGW_TRACE_LVL_PACKET, LGW_TRACE_HAL_RX_PAYLOAD,
+                    nb_pkt_found,
+                    p->size,
+                    trace_payload_word(p, 0),
+                    trace_payload_word(p, 4),
+                    trace_payload_word(p, 8));
     }
 
     DEBUG_PRINTF("INFO: nb pkt found:%u left:%u\n", nb_pkt_found, nb_pkt_left);
 
     /* Remove duplicated packets generated by double demod when precision timestamp is enabled */
     if ((nb_pkt_found > 0) && (CONTEXT_FINE_TIMESTAMP.enable == true)) {
-        res = merge_packets(pkt_data, &nb_pkt_found);
+        res = merge_packets(pkt_ref, &nb_pkt_found);
         if (res != 0) {
             printf("WARNING: failed to remove duplicated packets\n");
         }
@@ -1344,6 +2419,9 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
         DEBUG_PRINTF("INFO: nb pkt found:%u (after de-duplicating)\n", nb_pkt_found);
     }
 
+    /* fixed size accumulators, no history of the packets is kept */
+    chan_stats_update(pkt_ref, nb_pkt_found);
+
     _meas_time_stop(1, tm, __FUNCTION__);
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
@@ -1353,17 +2431,200 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
+int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
+    struct lgw_pkt_rx_s * pkt_ref[256];
+    int i, nb_pkt;
+
+    CHECK_NULL(pkt_data);
+
+    for (i = 0; i < max_pkt; i++) {
+        pkt_ref[i] = &pkt_data[i];
+    }
+    nb_pkt = receive(max_pkt, pkt_ref);
+
+    /* de-duplication and sorting only moved the references */
+    if (nb_pkt > 0) {
+        pkt_array_reorder(pkt_data, pkt_ref, (uint8_t)nb_pkt, max_pkt);
+    }
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_ref(uint8_t max_pkt, struct lgw_pkt_rx_s ** pkt_ref) {
+    int i;
+
+    CHECK_NULL(pkt_ref);
+    for (i = 0; i < max_pkt; i++) {
+        CHECK_NULL(pkt_ref[i]);
+    }
+
+    return receive(max_pkt, pkt_ref);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_begin(void) {
+    int i, nb_pkt;
+
+    if (rx_cursor_open == true) {
+        printf("ERROR: lgw_receive_end() not called for the previous packets\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* the storage can hold all the packets of a fetch, none is left in the RX buffer */
+    for (i = 0; i < RX_CURSOR_PKT_NB; i++) {
+        rx_cursor_ref[i] = &rx_cursor_pkt[i];
+    }
+    nb_pkt = receive(RX_CURSOR_PKT_NB, rx_cursor_ref);
+    if (nb_pkt < 0) {
+        return LGW_HAL_ERROR;
+    }
+
+    rx_cursor_nb = nb_pkt;
+    rx_cursor_next = 0;
+    rx_cursor_open = true;
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_next(struct lgw_pkt_rx_s ** pkt) {
+    CHECK_NULL(pkt);
+
+    if (rx_cursor_open == false) {
+        printf("ERROR: lgw_receive_begin() not called\n");
+        *pkt = NULL;
+        return LGW_HAL_ERROR;
+    }
+
+    if (rx_cursor_next >= rx_cursor_nb) {
+        *pkt = NULL;
+        return 0;
+    }
+    *pkt = rx_cursor_ref[rx_cursor_next++];
+
+    return 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_end(void) {
+    if (rx_cursor_open == false) {
+        printf("ERROR: lgw_receive_begin() not called\n");
+        return LGW_HAL_ERROR;
+    }
+
+    rx_cursor_nb = 0;
+    rx_cursor_next = 0;
+    rx_cursor_open = false;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_wait(uint32_t timeout_ms) {
+    int err;
+    bool pending = false;
+    int64_t now_ns, end_ns;
+    const uint32_t poll_min_ms = (CONTEXT_COM_TYPE == LGW_COM_USB) ? RX_WAIT_POLL_MS_USB : RX_WAIT_POLL_MS_SPI;
+    const uint32_t poll_max_ms = MAX(poll_min_ms, MIN(timeout_ms, RX_WAIT_POLL_MS_MAX));
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Neither the SX1302 nor the MCU firmware signal RX events to the host, so
+       only the RX buffer fill level is polled, which is much cheaper than a full
+       lgw_receive() (no timestamp counter or temperature access).
+       While the buffer stays empty, the interval between checks doubles from
+       the transport one up to the timeout, across the calls: a wait following
+       an empty check, or an empty lgw_receive(), first sleeps until the next
+       check is due. */
+    if (rx_wait_poll < poll_min_ms) {
+        rx_wait_poll = poll_min_ms;
+    }
+    now_ns = time_monotonic_ns();
+    end_ns = now_ns + ((int64_t)timeout_ms * 1000000);
+    if ((timeout_ms > 0) && (now_ns < rx_wait_due)) {
+        wait_us((unsigned long)((MIN(rx_wait_due, end_ns) - now_ns) / 1000));
+        if (rx_wait_due > end_ns) {
+            return 0;
+        }
+    }
+
+    while (1) {
+        err = sx1302_rx_pending(&pending);
+        if (err != LGW_REG_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+        now_ns = time_monotonic_ns();
+        if (pending == true) {
+            rx_wait_poll = poll_min_ms;
+            rx_wait_due = 0;
+            return 1;
+        }
+        rx_wait_due = now_ns + ((int64_t)rx_wait_poll * 1000000);
+        rx_wait_poll = MIN(2 * rx_wait_poll, poll_max_ms);
+        if (now_ns >= end_ns) {
+            return 0;
+        }
+        wait_us((unsigned long)((MIN(rx_wait_due, end_ns) - now_ns) / 1000));
+        if (rx_wait_due > end_ns) {
+            return 0;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
+    int err;
+
+    DEBUG_PRINTF(" --- %s\n", "IN");
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\n");
+        return LGW_HAL_ERROR;
+    }
+
+    CHECK_NULL(pkt_data);
+    tx_count_sync(pkt_data);
+
+    LGW_TRACE(TRACE_HAL >= LGW_TRACE_LVL_PACKET, LGW_TRACE_HAL_TX_PKT,
+                pkt_data->freq_hz,
+                pkt_data->count_us,
+                pkt_data->rf_power,
+                (pkt_data->modulation << 16) | (pkt_data->datarate & 0xFFFF),
+                pkt_data->size);
+
+    err = lgw_send_check(pkt_data);
+    if (err != LGW_HAL_SUCCESS) {
+        return err;
+    }
+
+    err = lgw_send_run(pkt_data, false);
+
+    DEBUG_PRINTF(" --- %s\n", "OUT");
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_send_prepare(struct lgw_pkt_tx_s * pkt_data) {
     int err;
-    bool lbt_tx_allowed;
-    /* performances variables */
-    struct timeval tm;
+    struct lgw_tx_prepared_s * prepared;
+    struct lgw_pkt_tx_s pkt;
 
     DEBUG_PRINTF(" --- %s\n", "IN");
 
-    /* Record function start time */
-    _meas_time_start(&tm);
-
     /* check if the concentrator is running */
     if (CONTEXT_STARTED == false) {
         printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\n");
@@ -1372,159 +2633,174 @@ int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
 
     CHECK_NULL(pkt_data);
 
-        //mohan added prints
-        /* Print packet data */
-    printf(" ERROR: Packet details:\n");
-    printf(" ERROR: Frequency (Hz): %u\n", pkt_data->freq_hz);
-    printf(" ERROR: TX Mode: %u\n", pkt_data->tx_mode);
-    printf(" ERROR: Count (us): %u\n", pkt_data->count_us);
-    printf(" ERROR: RF Chain: %u\n", pkt_data->rf_chain);
-    printf(" ERROR: RF Power (dBm): %d\n", pkt_data->rf_power);
-    printf(" ERROR: Modulation: %u\n", pkt_data->modulation);
-    printf(" ERROR: Frequency Offset: %d\n", pkt_data->freq_offset);
-    printf(" ERROR: Bandwidth: %u\n", pkt_data->bandwidth);
-    printf(" ERROR: Data Rate: %u\n", pkt_data->datarate);
-    printf(" ERROR: Code Rate: %u\n", pkt_data->coderate);
-    printf(" ERROR: Invert Polarity: %d\n", pkt_data->invert_pol);
-    printf(" ERROR: Frequency Deviation (kHz): %u\n", pkt_data->f_dev);
-    printf(" ERROR: Preamble Length: %u\n", pkt_data->preamble);
-    printf(" ERROR: No CRC: %d\n", pkt_data->no_crc);
-    printf(" ERROR: No Header: %d\n", pkt_data->no_header);
-    printf(" ERROR: Payload Size: %u\n", pkt_data->size);
-    printf(" ERROR: LoRa Payload Data: ");
-        for (uint16_t i = 0; i < pkt_data->size; i++) {
-            printf(" ERROR: %02X ", pkt_data->payload[i]);
-        }
-    printf("ERROR: \n");
-
-    /* check input range (segfault prevention) */
-    if (pkt_data->rf_chain >= LGW_RF_CHAIN_NB) {
-        printf("ERROR: INVALID RF_CHAIN TO SEND PACKETS\n");
-        return LGW_HAL_ERROR;
+    err = lgw_send_check(pkt_data);
+    if (err != LGW_HAL_SUCCESS) {
+        return err;
     }
 
-    /* check input variables */
-    if (CONTEXT_RF_CHAIN[pkt_data->rf_chain].tx_enable == false) {
-        printf("ERROR: SELECTED RF_CHAIN IS DISABLED FOR TX ON SELECTED BOARD\n");
-        return LGW_HAL_ERROR;
+    /* nothing to do if the packet is already uploaded */
+    prepared = &CONTEXT_TX_PREPARED[pkt_data->rf_chain];
+    if ((prepared->valid == true) && is_same_tx_pkt(&(prepared->pkt), pkt_data)) {
+        return LGW_HAL_SUCCESS;
     }
-    if (CONTEXT_RF_CHAIN[pkt_data->rf_chain].enable == false) {
-        printf("ERROR: SELECTED RF_CHAIN IS DISABLED\n");
+
+    /* do not overwrite the registers of a packet about to be emitted */
+    if (sx1302_tx_status(pkt_data->rf_chain) != TX_FREE) {
+        DEBUG_PRINTF("INFO: TX chain %u is busy, packet not prepared\n", pkt_data->rf_chain);
         return LGW_HAL_ERROR;
     }
-    if (!IS_TX_MODE(pkt_data->tx_mode)) {
-        printf("ERROR: TX_MODE NOT SUPPORTED\n");
+
+    /* the packet given is kept untouched, so that it can be compared at commit */
+    prepared->valid = false;
+    memcpy(&pkt, pkt_data, sizeof pkt);
+    err = sx1302_send_prepare(CONTEXT_RF_CHAIN[pkt.rf_chain].type, txgain_select(&pkt), CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK, &pkt, &(prepared->start_delay));
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: %s: Failed to prepare packet\n", __FUNCTION__);
         return LGW_HAL_ERROR;
     }
-    if (pkt_data->modulation == MOD_LORA) {
-        if (!IS_LORA_BW(pkt_data->bandwidth)) {
-            printf("ERROR: BANDWIDTH NOT SUPPORTED BY LORA TX\n");
-            return LGW_HAL_ERROR;
-        }
-        if (!IS_LORA_DR(pkt_data->datarate)) {
-            printf("ERROR: DATARATE NOT SUPPORTED BY LORA TX\n");
-            return LGW_HAL_ERROR;
-        }
-        if (!IS_LORA_CR(pkt_data->coderate)) {
-            printf("ERROR: CODERATE NOT SUPPORTED BY LORA TX\n");
-            return LGW_HAL_ERROR;
-        }
-        if (pkt_data->size > 255) {
-            printf("ERROR: PAYLOAD LENGTH TOO BIG FOR LORA TX\n");
-            return LGW_HAL_ERROR;
-        }
-    } else if (pkt_data->modulation == MOD_FSK) {
-        if((pkt_data->f_dev < 1) || (pkt_data->f_dev > 200)) {
-            printf("ERROR: TX FREQUENCY DEVIATION OUT OF ACCEPTABLE RANGE\n");
-            return LGW_HAL_ERROR;
-        }
-        if(!IS_FSK_DR(pkt_data->datarate)) {
-            printf("ERROR: DATARATE NOT SUPPORTED BY FSK IF CHAIN\n");
-            return LGW_HAL_ERROR;
-        }
-        if (pkt_data->size > 255) {
-            printf("ERROR: PAYLOAD LENGTH TOO BIG FOR FSK TX\n");
-            return LGW_HAL_ERROR;
+    memcpy(&(prepared->pkt), pkt_data, sizeof prepared->pkt);
+    prepared->valid = true;
+    prepared->lbt_armed = false;
+
+    /* Start Listen-Before-Talk ahead, unless the SX1261 scans for another prepared packet */
+    /* On failure, LBT is started again when the packet is committed, and the error reported then */
+    if ((CONTEXT_SX1261.lbt_conf.enable == true) && (lbt_armed_any() == false)) {
+        if (lgw_lbt_arm(&CONTEXT_SX1261, pkt_data) == 0) {
+            prepared->lbt_armed = true;
         }
-    } else if (pkt_data->modulation == MOD_CW) {
-        /* do nothing */
-    } else {
-        printf("ERROR: INVALID TX MODULATION\n");
-        return LGW_HAL_ERROR;
     }
 
-    /* Set PA gain with AD5338R when using full duplex CN490 ref design */
-    if (CONTEXT_BOARD.full_duplex == true) {
-        uint8_t volt_val[AD5338R_CMD_SIZE] = {0x39, VOLTAGE2HEX_H(2.51), VOLTAGE2HEX_L(2.51)}; /* set to 2.51V */
-        err = ad5338r_write(ad_fd, I2C_PORT_DAC_AD5338R, volt_val);
-        if (err != LGW_I2C_SUCCESS) {
-            printf("ERROR: failed to set voltage by ad5338r\n");
-            return LGW_HAL_ERROR;
-        }
-        printf("INFO: AD5338R: Set DAC output to 0x%02X 0x%02X\n", (uint8_t)VOLTAGE2HEX_H(2.51), (uint8_t)VOLTAGE2HEX_L(2.51));
+    DEBUG_PRINTF(" --- %s\n", "OUT");
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_send_commit(struct lgw_pkt_tx_s * pkt_data) {
+    int err;
+    struct lgw_tx_prepared_s * prepared;
+
+    DEBUG_PRINTF(" --- %s\n", "IN");
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\n");
+        return LGW_HAL_ERROR;
     }
 
-    /* Start Listen-Before-Talk */
-    if (CONTEXT_SX1261.lbt_conf.enable == true) {
-        err = lgw_lbt_start(&CONTEXT_SX1261, pkt_data);
-        if (err != 0) {
-            printf("ERROR: failed to start LBT\n");
-            return LGW_HAL_ERROR;
-        }
+    CHECK_NULL(pkt_data);
+    tx_count_sync(pkt_data);
+
+    /* the packet has to be fully sent if it is not the one uploaded */
+    if ((pkt_data->rf_chain >= LGW_RF_CHAIN_NB) || !IS_TX_MODE(pkt_data->tx_mode)) {
+        return lgw_send(pkt_data);
+    }
+    prepared = &CONTEXT_TX_PREPARED[pkt_data->rf_chain];
+    if ((prepared->valid == false) || !is_same_tx_pkt(&(prepared->pkt), pkt_data)) {
+        return lgw_send(pkt_data);
     }
 
-    /* Send the TX request to the concentrator */
-    err = sx1302_send(CONTEXT_RF_CHAIN[pkt_data->rf_chain].type, &CONTEXT_TX_GAIN_LUT[pkt_data->rf_chain], CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK, pkt_data);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: %s: Failed to send packet\n", __FUNCTION__);
+    LGW_TRACE(TRACE_HAL >= LGW_TRACE_LVL_PACKET, LGW_TRACE_HAL_TX_PKT,
+                pkt_data->freq_hz,
+                pkt_data->count_us,
+                pkt_data->rf_power,
+                (pkt_data->modulation << 16) | (pkt_data->datarate & 0xFFFF),
+                pkt_data->size);
 
-        if (CONTEXT_SX1261.lbt_conf.enable == true) {
-            err = lgw_lbt_stop();
-            if (err != 0) {
-                printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
-            }
-        }
+    err = lgw_send_run(pkt_data, true);
+
+    DEBUG_PRINTF(" --- %s\n", "OUT");
+
+    return err;
+}
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_send_batch(struct lgw_pkt_tx_s * pkt_data, uint8_t nb_pkt, int * status) {
+    int err;
+    int i, j;
+    int nb_batch = 0;
+    int nb_fail = 0;
+    struct sx1302_tx_batch_s batch[LGW_RF_CHAIN_NB];
+    int batch_idx[LGW_RF_CHAIN_NB];
+    struct lgw_tx_prepared_s * prepared;
+
+    DEBUG_PRINTF(" --- %s\n", "IN");
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\n");
         return LGW_HAL_ERROR;
     }
 
-    _meas_time_stop(1, tm, __FUNCTION__);
+    CHECK_NULL(pkt_data);
+    CHECK_NULL(status);
 
-    /* Stop Listen-Before-Talk */
+    /* the SX1261 can only scan the channel of one packet at a time */
     if (CONTEXT_SX1261.lbt_conf.enable == true) {
-        err = lgw_lbt_tx_status(pkt_data->rf_chain, &lbt_tx_allowed);
-        if (err != 0) {
-            printf("ERROR: %s: Failed to get LBT TX status, TX aborted\n", __FUNCTION__);
-            err = sx1302_tx_abort(pkt_data->rf_chain);
-            if (err != 0) {
-                printf("ERROR: %s: Failed to abort TX\n", __FUNCTION__);
+        for (i = 0; i < nb_pkt; i++) {
+            status[i] = lgw_send_commit(&pkt_data[i]);
+            if (status[i] != LGW_HAL_SUCCESS) {
+                nb_fail += 1;
             }
-            err = lgw_lbt_stop();
-            if (err != 0) {
-                printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
+        }
+        return (nb_fail == 0) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+    }
+
+    /* validate the packets, only one per TX chain */
+    for (i = 0; i < nb_pkt; i++) {
+        tx_count_sync(&pkt_data[i]);
+        status[i] = lgw_send_check(&pkt_data[i]);
+        for (j = 0; (status[i] == LGW_HAL_SUCCESS) && (j < nb_batch); j++) {
+            if (batch[j].pkt->rf_chain == pkt_data[i].rf_chain) {
+                printf("ERROR: %s: several packets for TX chain %u\n", __FUNCTION__, pkt_data[i].rf_chain);
+                status[i] = LGW_HAL_ERROR;
             }
-            return LGW_HAL_ERROR;
         }
-        if (lbt_tx_allowed == true) {
-            printf("LBT: packet is allowed to be transmitted\n");
-        } else {
-            printf("LBT: (ERROR) packet is NOT allowed to be transmitted\n");
+        if (status[i] != LGW_HAL_SUCCESS) {
+            nb_fail += 1;
+            continue;
         }
 
-        err = lgw_lbt_stop();
-        if (err != 0) {
-            printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
-            return LGW_HAL_ERROR;
+        LGW_TRACE(TRACE_HAL >= LGW_TRACE_LVL_PACKET, LGW_TRACE_HAL_TX_PKT,
+                    pkt_data[i].freq_hz,
+                    pkt_data[i].count_us,
+                    pkt_data[i].rf_power,
+                    (pkt_data[i].modulation << 16) | (pkt_data[i].datarate & 0xFFFF),
+                    pkt_data[i].size);
+
+        /* only the trigger is armed for a packet given to lgw_send_prepare() */
+        prepared = &CONTEXT_TX_PREPARED[pkt_data[i].rf_chain];
+        batch[nb_batch].pkt = &pkt_data[i];
+        batch[nb_batch].radio_type = CONTEXT_RF_CHAIN[pkt_data[i].rf_chain].type;
+        batch[nb_batch].tx_gain = txgain_select(&pkt_data[i]);
+        batch[nb_batch].loaded = (prepared->valid == true) && is_same_tx_pkt(&(prepared->pkt), &pkt_data[i]);
+        batch[nb_batch].start_delay = prepared->start_delay;
+        batch_idx[nb_batch] = i;
+        nb_batch += 1;
+    }
+    if (nb_batch == 0) {
+        return LGW_HAL_ERROR;
+    }
+
+    err = lgw_send_pa_set();
+    if (err == LGW_HAL_SUCCESS) {
+        err = sx1302_send_batch(batch, nb_batch, CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK);
+    }
+    for (j = 0; j < nb_batch; j++) {
+        /* the TX chain registers are now used by this packet */
+        CONTEXT_TX_PREPARED[batch[j].pkt->rf_chain].valid = false;
+        if ((err != LGW_REG_SUCCESS) || (batch[j].err != LGW_REG_SUCCESS)) {
+            printf("ERROR: %s: Failed to send packet on TX chain %u\n", __FUNCTION__, batch[j].pkt->rf_chain);
+            status[batch_idx[j]] = LGW_HAL_ERROR;
+            nb_fail += 1;
         }
     }
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
 
-    if (CONTEXT_SX1261.lbt_conf.enable == true && lbt_tx_allowed == false) {
-        return LGW_LBT_NOT_ALLOWED;
-    } else {
-        return LGW_HAL_SUCCESS;
-    }
+    return (nb_fail == 0) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -1591,7 +2867,7 @@ int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
 
     CHECK_NULL(trig_cnt_us);
 
-    *trig_cnt_us = sx1302_timestamp_counter(true);
+    *trig_cnt_us = (uint32_t)sx1302_timestamp_counter(true);
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
 
@@ -1601,11 +2877,26 @@ int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int lgw_get_instcnt(uint32_t* inst_cnt_us) {
+    uint64_t cnt;
+
+    CHECK_NULL(inst_cnt_us);
+
+    if (lgw_get_instcnt64(&cnt) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    *inst_cnt_us = (uint32_t)cnt;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt64(uint64_t* inst_cnt_us) {
     DEBUG_PRINTF(" --- %s\n", "IN");
 
     CHECK_NULL(inst_cnt_us);
 
-    *inst_cnt_us = sx1302_timestamp_counter(false);
+    *inst_cnt_us = sx1302_timestamp_counter_estimate(INSTCNT_ESTIMATE_MAX_AGE_US);
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
 
@@ -1614,6 +2905,34 @@ int lgw_get_instcnt(uint32_t* inst_cnt_us) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_get_instcnt_estimate(uint32_t* inst_cnt_us) {
+    uint64_t cnt;
+
+    CHECK_NULL(inst_cnt_us);
+
+    if (lgw_get_instcnt_estimate64(&cnt) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    *inst_cnt_us = (uint32_t)cnt;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt_estimate64(uint64_t* inst_cnt_us) {
+    CHECK_NULL(inst_cnt_us);
+
+    /* no access to the context here, other threads may be using the HAL */
+    if (sx1302_timestamp_counter_snapshot(INSTCNT_SNAPSHOT_MAX_AGE_US, inst_cnt_us) != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_get_eui(uint64_t* eui) {
     DEBUG_PRINTF(" --- %s\n", "IN");
 
@@ -1630,6 +2949,128 @@ int lgw_get_eui(uint64_t* eui) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_get_start_timing(struct lgw_start_timing_s * timing) {
+    CHECK_NULL(timing);
+
+    *timing = CONTEXT_START_TIMING;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_rx_stats(struct lgw_rx_stats_s * stats, bool reset) {
+    CHECK_NULL(stats);
+
+    if (sx1302_get_rx_stats(stats, reset) != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_per_stats(struct lgw_per_stats_s * stats, bool reset) {
+    CHECK_NULL(stats);
+
+    dbg_per_get_stats(stats, reset);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t lgw_rx_fill_percentile(const struct lgw_rx_stats_s * stats, uint32_t per_mille) {
+    int k;
+    uint64_t total = 0;
+    uint64_t acc = 0;
+
+    if (stats == NULL) {
+        return 0;
+    }
+
+    for (k = 0; k < LGW_RX_FILL_HIST_NB; k++) {
+        total += stats->fill_hist[k];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    for (k = 0; k < (LGW_RX_FILL_HIST_NB - 1); k++) {
+        acc += stats->fill_hist[k];
+        if ((acc * 1000) >= (total * per_mille)) {
+            break;
+        }
+    }
+
+    return (uint16_t)MIN((k + 1) * LGW_RX_FILL_STEP, stats->fill_max);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_arb_stats(struct lgw_arb_stats_s * stats, bool reset) {
+    CHECK_NULL(stats);
+
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING\n");
+        return LGW_HAL_ERROR;
+    }
+    if (sx1302_arb_get_stats(stats, reset) != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_chan_stats(struct lgw_chan_stats_s * stats, bool reset) {
+    CHECK_NULL(stats);
+
+    *stats = CONTEXT_CHAN_STATS;
+    if (reset == true) {
+        memset(&CONTEXT_CHAN_STATS, 0, sizeof CONTEXT_CHAN_STATS);
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_chan_stat_merge(struct lgw_chan_stat_s * dst, const struct lgw_chan_stat_s * src) {
+    if ((dst == NULL) || (src == NULL)) {
+        return;
+    }
+
+    dst->nb_pkt += src->nb_pkt;
+    dst->nb_crc_bad += src->nb_crc_bad;
+    dst->nb_no_crc += src->nb_no_crc;
+    rx_moments_merge(&dst->rssi, &src->rssi);
+    rx_moments_merge(&dst->snr, &src->snr);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t lgw_rx_moments_get(const struct lgw_rx_moments_s * m, int16_t * mean_x10, uint16_t * stddev_x10) {
+    double mean, var;
+
+    if ((m == NULL) || (mean_x10 == NULL) || (m->nb == 0)) {
+        return 0;
+    }
+
+    /* the sums are exact, the variance has no drift whatever the number of values */
+    mean = (double)m->sum_x10 / m->nb;
+    var = ((double)m->sumsq_x100 / m->nb) - (mean * mean);
+    *mean_x10 = (int16_t)lround(mean);
+    if (stddev_x10 != NULL) {
+        *stddev_x10 = (uint16_t)lround(sqrt((var > 0) ? var : 0));
+    }
+
+    return m->nb;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_get_temperature(float* temperature) {
     int err = LGW_HAL_ERROR;
 
@@ -1639,9 +3080,19 @@ int lgw_get_temperature(float* temperature) {
 
     switch (CONTEXT_COM_TYPE) {
         case LGW_COM_SPI:
-            err = stts751_get_temperature(ts_fd, ts_addr, temperature);
+            if (temp_run == true) {
+                /* the sensor is owned by the sampling thread, return its last value */
+                pthread_mutex_lock(&mx_temp);
+                *temperature = temp_cached;
+                pthread_mutex_unlock(&mx_temp);
+                err = LGW_HAL_SUCCESS;
+            } else {
+                err = stts751_get_temperature(ts_fd, ts_addr, temperature);
+            }
             break;
         case LGW_COM_USB:
+        case LGW_COM_REPLAY:
+        case LGW_COM_SIM:
             err = lgw_com_get_temperature(temperature);
             break;
         default:
@@ -1649,6 +3100,11 @@ int lgw_get_temperature(float* temperature) {
             break;
     }
 
+    if (err == LGW_HAL_SUCCESS) {
+        txgain_temp_update(*temperature);
+        lgw_replay_log_temperature(*temperature);
+    }
+
     DEBUG_PRINTF(" --- %s\n", "OUT");
 
     return err;
@@ -1663,7 +3119,6 @@ const char* lgw_version_info() {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s *packet) {
-    double t_fsk;
     uint32_t toa_ms, toa_us;
 
     DEBUG_PRINTF(" --- %s\n", "IN");
@@ -1675,7 +3130,7 @@ uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s *packet) {
 
     if (packet->modulation == MOD_LORA) {
         toa_us = lora_packet_time_on_air(packet->bandwidth, packet->datarate, packet->coderate, packet->preamble, packet->no_header, packet->no_crc, packet->size, NULL, NULL, NULL);
-        toa_ms = (uint32_t)( (double)toa_us / 1000.0 + 0.5 );
+        toa_ms = (toa_us + 500) / 1000; /* rounded to the nearest ms */
         DEBUG_PRINTF("INFO: LoRa packet ToA: %u ms\n", toa_ms);
     } else if (packet->modulation == MOD_FSK) {
         /* PREAMBLE + SYNC_WORD + PKT_LEN + PKT_PAYLOAD + CRC
@@ -1685,10 +3140,14 @@ uint32_t lgw_time_on_air(const struct lgw_pkt_tx_s *packet) {
                 PKT_PAYLOAD: x bytes
                 CRC: 0 or 2 bytes
         */
-        t_fsk = (8 * (double)(packet->preamble + CONTEXT_FSK.sync_word_size + 1 + packet->size + ((packet->no_crc == true) ? 0 : 2)) / (double)packet->datarate) * 1E3;
+        if (packet->datarate == 0) {
+            printf("ERROR: Cannot compute time on air for this packet, null FSK datarate\n");
+            return 0;
+        }
 
         /* Duration of packet */
-        toa_ms = (uint32_t)t_fsk + 1; /* add margin for rounding */
+        toa_ms = (8000 * (uint32_t)(packet->preamble + CONTEXT_FSK.sync_word_size + 1 + packet->size + ((packet->no_crc == true) ? 0 : 2))) / packet->datarate;
+        toa_ms += 1; /* add margin for rounding */
     } else {
         toa_ms = 0;
         printf("ERROR: Cannot compute time on air for this packet, unsupported modulation (0x%02X)\n", packet->modulation);
@@ -1709,6 +3168,7 @@ int lgw_spectral_scan_start(uint32_t freq_hz, uint16_t nb_scan) {
         return LGW_HAL_ERROR;
     }
 
+    lbt_disarm_prepared(); /* the SX1261 no longer scans for a TX channel, it will be armed again at commit */
     err = sx1261_set_rx_params(freq_hz, BW_125KHZ);
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: Failed to set RX params for Spectral Scan\n");
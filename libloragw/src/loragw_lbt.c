@@ -25,6 +25,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include <stdio.h>      /* printf */
 #include <stdlib.h>     /* llabs */
+#include <sys/time.h>   /* gettimeofday */
 
 #include "loragw_aux.h"
 #include "loragw_lbt.h"
@@ -43,6 +44,14 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
     #define DEBUG_PRINTF(fmt, args...)
 #endif
 
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct timeval lbt_arm_time_board[LGW_BOARD_NB_MAX]; /* when the SX1261 started to scan the TX channel */
+static uint32_t lbt_scan_time_us_board[LGW_BOARD_NB_MAX] = { 0 }; /* scan time of the TX channel, 0 if LBT is not armed */
+#define lbt_arm_time        lbt_arm_time_board[lgw_board_cur]
+#define lbt_scan_time_us    lbt_scan_time_us_board[lgw_board_cur]
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -82,12 +91,12 @@ static int is_lbt_channel(const struct lgw_conf_lbt_s * lbt_context, uint32_t fr
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
-int lgw_lbt_start(const struct lgw_conf_sx1261_s * sx1261_context, const struct lgw_pkt_tx_s * pkt) {
+int lgw_lbt_arm(const struct lgw_conf_sx1261_s * sx1261_context, const struct lgw_pkt_tx_s * pkt) {
     int err;
     int lbt_channel_selected;
     uint32_t toa_ms;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -118,12 +127,15 @@ int lgw_lbt_start(const struct lgw_conf_sx1261_s * sx1261_context, const struct
         return -1;
     }
 
-    /* Start LBT */
+    /* Start LBT, the channel is considered free once scanned for the whole scan time */
+    lbt_scan_time_us = 0;
     err = sx1261_lbt_start(sx1261_context->lbt_conf.channels[lbt_channel_selected].scan_time_us, sx1261_context->lbt_conf.rssi_target + sx1261_context->rssi_offset);
     if (err != 0) {
         printf("ERROR: Cannot start LBT - sx1261 LBT start\n");
         return -1;
     }
+    gettimeofday(&lbt_arm_time, NULL);
+    lbt_scan_time_us = (uint32_t)sx1261_context->lbt_conf.channels[lbt_channel_selected].scan_time_us;
 
     _meas_time_stop(3, tm, __FUNCTION__);
 
@@ -132,13 +144,47 @@ int lgw_lbt_start(const struct lgw_conf_sx1261_s * sx1261_context, const struct
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_lbt_wait_scan(void) {
+    struct timeval now;
+    int64_t elapsed_us;
+
+    if (lbt_scan_time_us == 0) {
+        printf("ERROR: LBT is not armed\n");
+        return -1;
+    }
+
+    /* Wait for the rest of Scan Time before TX trigger request, nothing if armed long enough ago */
+    gettimeofday(&now, NULL);
+    elapsed_us = ((int64_t)(now.tv_sec - lbt_arm_time.tv_sec) * 1000000) + (int64_t)(now.tv_usec - lbt_arm_time.tv_usec);
+    if ((elapsed_us >= 0) && (elapsed_us < (int64_t)lbt_scan_time_us)) {
+        wait_us((unsigned long)((int64_t)lbt_scan_time_us - elapsed_us));
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_lbt_start(const struct lgw_conf_sx1261_s * sx1261_context, const struct lgw_pkt_tx_s * pkt) {
+    int err;
+
+    err = lgw_lbt_arm(sx1261_context, pkt);
+    if (err != 0) {
+        return -1;
+    }
+
+    return lgw_lbt_wait_scan();
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_lbt_tx_status(uint8_t rf_chain, bool * tx_ok) {
     int err;
     uint8_t status;
     bool tx_timeout = false;
     struct timeval tm_start;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -216,11 +262,12 @@ int lgw_lbt_stop(void) {
     int err;
 
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
 
+    lbt_scan_time_us = 0;
     err = sx1261_lbt_stop();
     if (err != 0) {
         printf("ERROR: Cannot stop LBT - failed\n");
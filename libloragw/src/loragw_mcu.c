@@ -21,11 +21,11 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
-#include <stdlib.h>     /* rand */
 #include <unistd.h>     /* lseek, close */
 #include <string.h>     /* memset */
 #include <errno.h>      /* Error number definitions */
 #include <termios.h>    /* POSIX terminal control definitions */
+#include <sys/uio.h>    /* writev readv */
 
 #include "loragw_mcu.h"
 #include "loragw_aux.h"
@@ -53,6 +53,12 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define HEADER_CMD_SIZE 4
 
+#define MCU_PIPELINE_DEPTH_MAX 8 /* maximum number of requests in flight */
+
+#define MCU_REQ_IOV_NB_MAX 2 /* maximum number of buffers composing a request payload */
+
+#define MCU_RX_RING_SIZE 8192 /* must be a power of 2, and hold at least one full ACK */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE TYPES -------------------------------------------------------- */
 
@@ -62,40 +68,89 @@ typedef struct spi_req_bulk_s {
     uint8_t buffer[LGW_USB_BURST_CHUNK];
 } spi_req_bulk_t;
 
+/* A request sent to the MCU, whose ACK has not been read yet */
+typedef struct mcu_req_pending_s {
+    uint8_t id;                 /* request ID, echoed in the ACK header */
+    uint8_t * buf;              /* buffer receiving the ACK payload, NULL if the ACK is only checked */
+    size_t size;                /* size of the buffer */
+    uint8_t * data;             /* buffer receiving the ACK payload after the first size bytes, NULL if contiguous */
+    size_t data_size;           /* size of the data buffer */
+} mcu_req_pending_t;
+
+typedef struct mcu_pipeline_s {
+    uint8_t depth;              /* maximum number of requests in flight (1: synchronous) */
+    uint8_t nb_req;             /* number of requests in flight */
+    uint8_t next_id;            /* ID of the next request */
+    bool error;                 /* a posted request failed, not reported yet */
+    mcu_req_pending_t req[MCU_PIPELINE_DEPTH_MAX]; /* requests in flight, oldest first */
+    uint8_t ack_buf[MAX_SIZE_COMMAND]; /* receives the ACK of posted requests */
+} mcu_pipeline_t;
+
+/* Bytes received from the MCU and not parsed yet */
+typedef struct mcu_rx_ring_s {
+    uint32_t head;              /* next byte to be written, free-running */
+    uint32_t tail;              /* next byte to be parsed, free-running */
+    uint8_t buf[MCU_RX_RING_SIZE];
+} mcu_rx_ring_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES  --------------------------------------------------- */
 
-static uint8_t buf_hdr[HEADER_CMD_SIZE];
+static uint8_t buf_hdr_board[LGW_BOARD_NB_MAX][HEADER_CMD_SIZE];
+#define buf_hdr buf_hdr_board[lgw_board_cur]
 
-static spi_req_bulk_t spi_bulk_buffer = {
-    .size = 0,
-    .nb_req = 0,
-    .buffer = { 0 }
+static spi_req_bulk_t spi_bulk_buffer_board[LGW_BOARD_NB_MAX] = {
+    [0 ... LGW_BOARD_NB_MAX - 1] = {
+        .size = 0,
+        .nb_req = 0,
+        .buffer = { 0 }
+    }
+};
+#define spi_bulk_buffer spi_bulk_buffer_board[lgw_board_cur]
+
+static mcu_pipeline_t mcu_pipeline_board[LGW_BOARD_NB_MAX] = {
+    [0 ... LGW_BOARD_NB_MAX - 1] = {
+        .depth = 1,
+        .nb_req = 0,
+        .next_id = 0,
+        .error = false
+    }
 };
+#define mcu_pipeline mcu_pipeline_board[lgw_board_cur]
+
+static mcu_rx_ring_t mcu_rx_board[LGW_BOARD_NB_MAX];
+#define mcu_rx mcu_rx_board[lgw_board_cur]
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
-int spi_req_bulk_insert(spi_req_bulk_t * bulk_buffer, uint8_t * req, uint16_t req_size) {
+int spi_req_bulk_insert(spi_req_bulk_t * bulk_buffer, const uint8_t * req, uint16_t req_size, const uint8_t * data, uint16_t data_size) {
     /* Check input parameters */
     CHECK_NULL(bulk_buffer);
     CHECK_NULL(req);
+    if ((data == NULL) && (data_size > 0)) {
+        printf("ERROR: invalid SPI request data\n");
+        return -1;
+    }
 
     if (bulk_buffer->nb_req == 255) {
         printf("ERROR: cannot insert a new SPI request in bulk buffer - too many requests\n");
         return -1;
     }
 
-    if ((bulk_buffer->size + req_size) > LGW_USB_BURST_CHUNK) {
+    if ((bulk_buffer->size + req_size + data_size) > LGW_USB_BURST_CHUNK) {
         printf("ERROR: cannot insert a new SPI request in bulk buffer - buffer full\n");
         return -1;
     }
 
     /* Add a new request entry in storage buffer */
     memcpy(bulk_buffer->buffer + bulk_buffer->size, req, req_size);
+    if (data_size > 0) {
+        memcpy(bulk_buffer->buffer + bulk_buffer->size + req_size, data, data_size);
+    }
 
     bulk_buffer->nb_req += 1;
-    bulk_buffer->size += req_size;
+    bulk_buffer->size += req_size + data_size;
 
     return 0;
 }
@@ -190,11 +245,79 @@ const char * spi_status_get_str(const uint8_t status) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int write_req(int fd, order_id_t cmd, const uint8_t * payload, uint16_t payload_size ) {
+/* Read from the MCU until at least size bytes are buffered, taking everything available at each read */
+int rx_ring_fill(int fd, size_t size) {
+    struct iovec iov[2];
+    uint32_t head, room;
+    int iovcnt;
+    ssize_t n;
+
+    if (size > MCU_RX_RING_SIZE) {
+        printf("ERROR: ACK too large to be buffered (%zu)\n", size);
+        return -1;
+    }
+
+    while ((mcu_rx.head - mcu_rx.tail) < size) {
+        /* free space of the ring, in two parts if it wraps */
+        head = mcu_rx.head & (MCU_RX_RING_SIZE - 1);
+        room = MCU_RX_RING_SIZE - (mcu_rx.head - mcu_rx.tail);
+        iov[0].iov_base = &mcu_rx.buf[head];
+        if ((head + room) > MCU_RX_RING_SIZE) {
+            iov[0].iov_len = MCU_RX_RING_SIZE - head;
+            iov[1].iov_base = &mcu_rx.buf[0];
+            iov[1].iov_len = room - iov[0].iov_len;
+            iovcnt = 2;
+        } else {
+            iov[0].iov_len = room;
+            iovcnt = 1;
+        }
+
+        /* handle EINTR as it is a blocking call */
+        do {
+            n = readv(fd, iov, iovcnt);
+        } while (n == -1 && errno == EINTR);
+
+        if (n == -1) {
+            perror("ERROR: Unable to read /dev/ttyACMx - ");
+            return -1;
+        } else if (n == 0) {
+            /* blocking read (VMIN=1) only returns nothing on hang-up */
+            printf("ERROR: MCU link closed\n");
+            return -1;
+        }
+        DEBUG_PRINTF("INFO: read %zd bytes from gateway\n", n);
+        mcu_rx.head += (uint32_t)n;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Move size buffered bytes to dst (must have been filled beforehand) */
+void rx_ring_get(uint8_t * dst, size_t size) {
+    uint32_t tail = mcu_rx.tail & (MCU_RX_RING_SIZE - 1);
+    size_t len = size;
+
+    if ((tail + len) > MCU_RX_RING_SIZE) {
+        len = MCU_RX_RING_SIZE - tail;
+        memcpy(dst + len, &mcu_rx.buf[0], size - len);
+    }
+    memcpy(dst, &mcu_rx.buf[tail], len);
+    mcu_rx.tail += (uint32_t)size;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Send a command whose payload is scattered in several buffers, with a single system call */
+int write_req_v(int fd, order_id_t cmd, uint8_t id, const struct iovec * payload, int iovcnt) {
     uint8_t buf_w[HEADER_CMD_SIZE];
-    int n;
+    struct iovec iov[1 + MCU_REQ_IOV_NB_MAX];
+    size_t payload_size = 0;
+    ssize_t n;
+    int i;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
     /* debug variables */
 #if DEBUG_MCU == 1
     struct timeval write_tv;
@@ -204,47 +327,51 @@ int write_req(int fd, order_id_t cmd, const uint8_t * payload, uint16_t payload_
     _meas_time_start(&tm);
 
     /* Check input params */
+    if ((iovcnt < 0) || (iovcnt > MCU_REQ_IOV_NB_MAX)) {
+        printf("ERROR: invalid payload\n");
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if ((payload[i].iov_base == NULL) && (payload[i].iov_len > 0)) {
+            printf("ERROR: invalid payload\n");
+            return -1;
+        }
+        payload_size += payload[i].iov_len;
+    }
     if (payload_size > MAX_SIZE_COMMAND) {
-        printf("ERROR: payload size exceeds maximum transfer size (req:%u, max:%d)\n", payload_size, MAX_SIZE_COMMAND);
+        printf("ERROR: payload size exceeds maximum transfer size (req:%zu, max:%d)\n", payload_size, MAX_SIZE_COMMAND);
         return -1;
     }
 
-    /* Write command header */
-    buf_w[0] = rand() % 255;
+    /* Command header, followed by the payload buffers */
+    buf_w[0] = id;
     buf_w[1] = (uint8_t)(payload_size >> 8); /* MSB */
     buf_w[2] = (uint8_t)(payload_size >> 0); /* LSB */
     buf_w[3] = cmd;
-    n = write(fd, buf_w, HEADER_CMD_SIZE);
-    if (n < 0) {
-        printf("ERROR: failed to write command header to com port\n");
-        return -1;
+    iov[0].iov_base = buf_w;
+    iov[0].iov_len = HEADER_CMD_SIZE;
+    for (i = 0; i < iovcnt; i++) {
+        iov[1 + i] = payload[i];
     }
 
-    /* Write command payload */
-    if (payload_size > 0) {
-        if (payload == NULL) {
-            printf("ERROR: invalid payload\n");
-            return -1;
-        }
-        n = write(fd, payload, payload_size);
-        if (n < 0) {
-            printf("ERROR: failed to write command payload to com port\n");
-            return -1;
-        }
+    /* Write command header and payload */
+    n = writev(fd, iov, 1 + iovcnt);
+    if (n != (ssize_t)(HEADER_CMD_SIZE + payload_size)) {
+        printf("ERROR: failed to write command to com port\n");
+        return -1;
     }
 
 #if DEBUG_MCU == 1
     gettimeofday(&write_tv, NULL);
 #endif
-    DEBUG_PRINTF("\nINFO: %ld.%ld: write_req 0x%02X (%s) done, id:0x%02X, size:%u\n", write_tv.tv_sec, write_tv.tv_usec, cmd, cmd_get_str(cmd), buf_w[0], payload_size);
+    DEBUG_PRINTF("\nINFO: %ld.%ld: write_req 0x%02X (%s) done, id:0x%02X, size:%zu\n", write_tv.tv_sec, write_tv.tv_usec, cmd, cmd_get_str(cmd), buf_w[0], payload_size);
 
 #if DEBUG_VERBOSE
-    int i;
-    for (i = 0; i < 4; i++) {
-        printf("%02X ", buf_w[i]);
-    }
-    for (i = 0; i < payload_size; i++) {
-        printf("%02X ", payload[i]);
+    size_t j;
+    for (i = 0; i < (1 + iovcnt); i++) {
+        for (j = 0; j < iov[i].iov_len; j++) {
+            printf("%02X ", ((const uint8_t *)iov[i].iov_base)[j]);
+        }
     }
     printf("\n");
 #endif
@@ -257,15 +384,28 @@ int write_req(int fd, order_id_t cmd, const uint8_t * payload, uint16_t payload_
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int read_ack(int fd, uint8_t * hdr, uint8_t * buf, size_t buf_size) {
+int write_req(int fd, order_id_t cmd, uint8_t id, const uint8_t * payload, uint16_t payload_size ) {
+    struct iovec iov;
+
+    if ((payload == NULL) && (payload_size > 0)) {
+        printf("ERROR: invalid payload\n");
+        return -1;
+    }
+
+    iov.iov_base = (void *)payload; /* not modified by writev */
+    iov.iov_len = payload_size;
+
+    return write_req_v(fd, cmd, id, &iov, (payload_size > 0) ? 1 : 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int read_ack_hdr(int fd, uint8_t * hdr) {
 #if DEBUG_VERBOSE
     int i;
 #endif
-    int n;
-    size_t size;
-    int nb_read = 0;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
     /* debug variables */
 #if DEBUG_MCU == 1
     struct timeval read_tv;
@@ -274,20 +414,15 @@ int read_ack(int fd, uint8_t * hdr, uint8_t * buf, size_t buf_size) {
     /* Record function start time */
     _meas_time_start(&tm);
 
-    /* Read message header first, handle EINTR as it is a blocking call */
-    do {
-        n = read(fd, &hdr[0], (size_t)HEADER_CMD_SIZE);
-    } while (n == -1 && errno == EINTR);
-
-    if (n == -1) {
-        perror("ERROR: Unable to read /dev/ttyACMx - ");
+    /* Read message header first, the payload is usually buffered with it */
+    if (rx_ring_fill(fd, HEADER_CMD_SIZE) != 0) {
         return -1;
-    } else {
+    }
+    rx_ring_get(hdr, HEADER_CMD_SIZE);
 #if DEBUG_MCU == 1
-        gettimeofday(&read_tv, NULL);
+    gettimeofday(&read_tv, NULL);
 #endif
-        DEBUG_PRINTF("INFO: %ld.%ld: read %d bytes for header from gateway\n", read_tv.tv_sec, read_tv.tv_usec, n);
-    }
+    DEBUG_PRINTF("INFO: %ld.%ld: read header from gateway\n", read_tv.tv_sec, read_tv.tv_usec);
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, "read_ack(hdr)");
@@ -301,15 +436,36 @@ int read_ack(int fd, uint8_t * hdr, uint8_t * buf, size_t buf_size) {
     printf("\n");
 #endif
 
-    /* Record function start time */
-    _meas_time_start(&tm);
-
     /* Check if the command id is valid */
     if ((cmd_get_type(hdr) < 0x40) || (cmd_get_type(hdr) > 0x46)) {
         printf("ERROR: received wrong ACK type (0x%02X)\n", cmd_get_type(hdr));
         return -1;
     }
 
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Read the payload of an ACK, scattered in several buffers */
+int read_ack_payload_v(int fd, const uint8_t * hdr, const struct iovec * iov, int iovcnt) {
+    int i;
+    size_t size, len;
+    size_t buf_size = 0;
+    /* performances variables */
+    int64_t tm;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    if ((iovcnt <= 0) || (iovcnt > MCU_REQ_IOV_NB_MAX)) {
+        printf("ERROR: invalid ACK buffer\n");
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        buf_size += iov[i].iov_len;
+    }
+
     /* Get remaining payload size (metadata + pkt payload) */
     size = (size_t)cmd_get_size(hdr);
     if (size > buf_size) {
@@ -317,40 +473,55 @@ int read_ack(int fd, uint8_t * hdr, uint8_t * buf, size_t buf_size) {
         return -1;
     }
 
-    /* Read payload if any */
-    if (size > 0) {
-        do {
-            /* handle EINTR as it is a blocking call */
-            do {
-                n = read(fd, &buf[nb_read], size - nb_read);
-            } while (n == -1 && errno == EINTR);
-
-            if (n == -1) {
-                perror("ERROR: Unable to read /dev/ttyACMx - ");
-                return -1;
-            } else {
-#if DEBUG_MCU == 1
-                gettimeofday(&read_tv, NULL);
-#endif
-                DEBUG_PRINTF("INFO: %ld.%ld: read %d bytes from gateway\n", read_tv.tv_sec, read_tv.tv_usec, n);
-                nb_read += n;
-            }
-        } while (nb_read < (int)size); /* we want to read only the expected payload, not more */
+    /* Read payload if any, we want to consume only the expected payload, not more */
+    if (rx_ring_fill(fd, size) != 0) {
+        return -1;
+    }
+    for (i = 0; (i < iovcnt) && (size > 0); i++) {
+        len = (iov[i].iov_len < size) ? iov[i].iov_len : size;
+        rx_ring_get(iov[i].iov_base, len);
+        size -= len;
+    }
 
 #if DEBUG_VERBOSE
-        /* debug print */
-        printf("read_ack(pld):");
-        for (i = 0; i < (int)size; i++) {
-            printf("%02X ", buf[i]);
+    size_t j;
+    /* debug print */
+    printf("read_ack(pld):");
+    for (i = 0, size = cmd_get_size(hdr); (i < iovcnt) && (size > 0); i++) {
+        for (j = 0; (j < iov[i].iov_len) && (size > 0); j++, size--) {
+            printf("%02X ", ((const uint8_t *)iov[i].iov_base)[j]);
         }
-        printf("\n");
-#endif
     }
+    printf("\n");
+#endif
 
     /* Compute time spent in this function */
     _meas_time_stop(5, tm, "read_ack(payload)");
 
-    return nb_read;
+    return (int)cmd_get_size(hdr);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int read_ack_payload(int fd, const uint8_t * hdr, uint8_t * buf, size_t buf_size) {
+    struct iovec iov;
+
+    CHECK_NULL(buf);
+
+    iov.iov_base = buf;
+    iov.iov_len = buf_size;
+
+    return read_ack_payload_v(fd, hdr, &iov, 1);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int read_ack(int fd, uint8_t * hdr, uint8_t * buf, size_t buf_size) {
+    if (read_ack_hdr(fd, hdr) != 0) {
+        return -1;
+    }
+
+    return read_ack_payload(fd, hdr, buf, buf_size);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -538,6 +709,189 @@ int decode_ack_spi_bulk(const uint8_t * hdr, const uint8_t * payload) {
     return 0;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Check the ACK of a single read/write SPI request, from its metadata only */
+int decode_ack_spi_single(const uint8_t * hdr, const uint8_t * meta) {
+    uint16_t frame_size;
+
+    /* sanity checks */
+    if ((hdr == NULL) || (meta == NULL)) {
+        printf("ERROR: invalid parameter\n");
+        return -1;
+    }
+
+    if (cmd_get_type(hdr) != ORDER_ID__ACK_MULTIPLE_SPI) {
+        printf("ERROR: wrong ACK type for ACK_MULTIPLE_SPI (expected:0x%02X, got 0x%02X)\n", ORDER_ID__ACK_MULTIPLE_SPI, cmd_get_type(hdr));
+        return -1;
+    }
+
+    if (meta[1] != MCU_SPI_REQ_TYPE_READ_WRITE) {
+        printf("ERROR: %s: wrong type for SPI request %u (0x%02X)\n", __FUNCTION__, meta[0], meta[1]);
+        return -1;
+    }
+    if (meta[2] != 0) {
+        printf("ERROR: %s: SPI request %u failed with %u - %s\n", __FUNCTION__, meta[0], meta[2], spi_status_get_str(meta[2]));
+        return -1;
+    }
+    frame_size = (uint16_t)(meta[3] << 8) | (uint16_t)(meta[4]);
+    if ((5 + frame_size) != cmd_get_size(hdr)) {
+        printf("ERROR: %s: wrong ACK size for SPI request %u (frame:%u, ack:%u)\n", __FUNCTION__, meta[0], frame_size, cmd_get_size(hdr));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Read the next ACK from the MCU and complete the matching request in flight */
+int pipeline_complete_one(int fd) {
+    mcu_req_pending_t req;
+    struct iovec iov[2];
+    int iovcnt;
+    int i, err = 0;
+
+    if (read_ack_hdr(fd, buf_hdr) != 0) {
+        printf("ERROR: failed to read REQ_MULTIPLE_SPI ack\n");
+        mcu_pipeline.nb_req = 0; /* link is out of sync, drop all requests in flight */
+        return -1;
+    }
+
+    /* find the request by its ID, the oldest one is expected */
+    for (i = 0; i < mcu_pipeline.nb_req; i++) {
+        if (mcu_pipeline.req[i].id == cmd_get_id(buf_hdr)) {
+            break;
+        }
+    }
+    if (i == mcu_pipeline.nb_req) {
+        printf("ERROR: received ACK for an unknown request (id:0x%02X)\n", cmd_get_id(buf_hdr));
+        mcu_pipeline.nb_req = 0;
+        return -1;
+    }
+    req = mcu_pipeline.req[i];
+    mcu_pipeline.nb_req -= 1;
+    memmove(&mcu_pipeline.req[i], &mcu_pipeline.req[i + 1], (mcu_pipeline.nb_req - i) * sizeof(mcu_req_pending_t));
+
+    /* the ACK of a scattered request lands directly in its buffers */
+    if (req.buf == NULL) {
+        iov[0].iov_base = mcu_pipeline.ack_buf;
+        iov[0].iov_len = sizeof mcu_pipeline.ack_buf;
+        iovcnt = 1;
+    } else {
+        iov[0].iov_base = req.buf;
+        iov[0].iov_len = req.size;
+        iov[1].iov_base = req.data;
+        iov[1].iov_len = req.data_size;
+        iovcnt = (req.data != NULL) ? 2 : 1;
+    }
+    if (read_ack_payload_v(fd, buf_hdr, iov, iovcnt) < 0) {
+        printf("ERROR: failed to read REQ_MULTIPLE_SPI ack\n");
+        err = -1;
+    } else if (iovcnt == 2) {
+        /* the SPI frame is split, only a single request can be checked */
+        if (decode_ack_spi_single(buf_hdr, req.buf) != 0) {
+            printf("ERROR: invalid REQ_MULTIPLE_SPI ack\n");
+            err = -1;
+        }
+    } else if (decode_ack_spi_bulk(buf_hdr, iov[0].iov_base) != 0) {
+        printf("ERROR: invalid REQ_MULTIPLE_SPI ack\n");
+        err = -1;
+    }
+
+    /* the failure of a posted request is reported by the next request waited for */
+    if ((err != 0) && (req.buf == NULL)) {
+        mcu_pipeline.error = true;
+    }
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Send a SPI request and record it as in flight, waiting for the oldest one if the pipeline is full */
+int pipeline_send(int fd, uint8_t * in_out_buf, size_t buf_size, uint8_t * data, size_t data_size, uint8_t * id) {
+    mcu_req_pending_t * req;
+    struct iovec iov[2];
+
+    /* errors of posted requests are recorded, and reported by the next wait */
+    while (mcu_pipeline.nb_req >= mcu_pipeline.depth) {
+        pipeline_complete_one(fd);
+    }
+
+    *id = mcu_pipeline.next_id;
+    mcu_pipeline.next_id += 1;
+    iov[0].iov_base = in_out_buf;
+    iov[0].iov_len = buf_size;
+    iov[1].iov_base = data;
+    iov[1].iov_len = data_size;
+    if (write_req_v(fd, ORDER_ID__REQ_MULTIPLE_SPI, *id, iov, (data != NULL) ? 2 : 1) != 0) {
+        printf("ERROR: failed to write REQ_MULTIPLE_SPI request\n");
+        return -1;
+    }
+
+    req = &mcu_pipeline.req[mcu_pipeline.nb_req];
+    req->id = *id;
+    req->buf = in_out_buf;
+    req->size = buf_size;
+    req->data = data;
+    req->data_size = data_size;
+    mcu_pipeline.nb_req += 1;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Complete requests in flight until the given one is done */
+int pipeline_wait(int fd, uint8_t id) {
+    int i, err = 0;
+
+    while (true) {
+        for (i = 0; i < mcu_pipeline.nb_req; i++) {
+            if (mcu_pipeline.req[i].id == id) {
+                break;
+            }
+        }
+        if (i == mcu_pipeline.nb_req) {
+            break;
+        }
+        /* only the error of the awaited request is reported here */
+        if (pipeline_complete_one(fd) != 0) {
+            if ((mcu_pipeline.nb_req == 0) || (cmd_get_id(buf_hdr) == id)) {
+                err = -1;
+            }
+        }
+    }
+
+    if (mcu_pipeline.error == true) {
+        mcu_pipeline.error = false;
+        err = -1;
+    }
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Complete all requests in flight, before a synchronous command */
+int pipeline_drain(int fd) {
+    int err = 0;
+
+    while (mcu_pipeline.nb_req > 0) {
+        if (pipeline_complete_one(fd) != 0) {
+            err = -1;
+        }
+    }
+
+    if (mcu_pipeline.error == true) {
+        mcu_pipeline.error = false;
+        err = -1;
+    }
+
+    return err;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -546,7 +900,11 @@ int mcu_ping(int fd, s_ping_info * info) {
 
     CHECK_NULL(info);
 
-    if (write_req(fd, ORDER_ID__REQ_PING, NULL, 0) != 0) {
+    if (pipeline_drain(fd) != 0) {
+        printf("WARNING: a previous request to the MCU failed\n");
+    }
+
+    if (write_req(fd, ORDER_ID__REQ_PING, mcu_pipeline.next_id++, NULL, 0) != 0) {
         printf("ERROR: failed to write PING request\n");
         return -1;
     }
@@ -567,7 +925,11 @@ int mcu_ping(int fd, s_ping_info * info) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int mcu_boot(int fd) {
-    if (write_req(fd, ORDER_ID__REQ_BOOTLOADER_MODE, NULL, 0) != 0) {
+    if (pipeline_drain(fd) != 0) {
+        printf("WARNING: a previous request to the MCU failed\n");
+    }
+
+    if (write_req(fd, ORDER_ID__REQ_BOOTLOADER_MODE, mcu_pipeline.next_id++, NULL, 0) != 0) {
         printf("ERROR: failed to write BOOTLOADER_MODE request\n");
         return -1;
     }
@@ -592,7 +954,11 @@ int mcu_get_status(int fd, s_status * status) {
 
     CHECK_NULL(status);
 
-    if (write_req(fd, ORDER_ID__REQ_GET_STATUS, NULL, 0) != 0) {
+    if (pipeline_drain(fd) != 0) {
+        printf("WARNING: a previous request to the MCU failed\n");
+    }
+
+    if (write_req(fd, ORDER_ID__REQ_GET_STATUS, mcu_pipeline.next_id++, NULL, 0) != 0) {
         printf("ERROR: failed to write GET_STATUS request\n");
         return -1;
     }
@@ -620,7 +986,12 @@ int mcu_gpio_write(int fd, uint8_t gpio_port, uint8_t gpio_id, uint8_t gpio_valu
     buf_req[REQ_WRITE_GPIO__PORT]   = gpio_port;
     buf_req[REQ_WRITE_GPIO__PIN]    = gpio_id;
     buf_req[REQ_WRITE_GPIO__STATE]  = gpio_value;
-    if (write_req(fd, ORDER_ID__REQ_WRITE_GPIO, buf_req, REQ_WRITE_GPIO_SIZE) != 0) {
+
+    if (pipeline_drain(fd) != 0) {
+        printf("WARNING: a previous request to the MCU failed\n");
+    }
+
+    if (write_req(fd, ORDER_ID__REQ_WRITE_GPIO, mcu_pipeline.next_id++, buf_req, REQ_WRITE_GPIO_SIZE) != 0) {
         printf("ERROR: failed to write REQ_WRITE_GPIO request\n");
         return -1;
     }
@@ -646,40 +1017,121 @@ int mcu_gpio_write(int fd, uint8_t gpio_port, uint8_t gpio_id, uint8_t gpio_valu
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int mcu_spi_write(int fd, uint8_t * in_out_buf, size_t buf_size) {
+    return mcu_spi_write_sg(fd, in_out_buf, buf_size, NULL, 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_spi_write_sg(int fd, uint8_t * in_out_buf, size_t buf_size, uint8_t * data, size_t data_size) {
+    uint8_t id;
+
     /* Check input parameters */
     CHECK_NULL(in_out_buf);
 
-    if (write_req(fd, ORDER_ID__REQ_MULTIPLE_SPI, in_out_buf, buf_size) != 0) {
-        printf("ERROR: failed to write REQ_MULTIPLE_SPI request\n");
+    if (pipeline_send(fd, in_out_buf, buf_size, data, data_size, &id) != 0) {
         return -1;
     }
 
-    if (read_ack(fd, buf_hdr, in_out_buf, buf_size) < 0) {
-        printf("ERROR: failed to read REQ_MULTIPLE_SPI ack\n");
+    return pipeline_wait(fd, id);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_spi_post(int fd, uint8_t * in_out_buf, size_t buf_size) {
+    return mcu_spi_post_sg(fd, in_out_buf, buf_size, NULL, 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_spi_post_sg(int fd, const uint8_t * in_buf, size_t buf_size, const uint8_t * data, size_t data_size) {
+    uint8_t id;
+
+    /* Check input parameters */
+    CHECK_NULL(in_buf);
+
+    /* buffers are only read by writev */
+    if (pipeline_send(fd, (uint8_t *)in_buf, buf_size, (uint8_t *)data, data_size, &id) != 0) {
         return -1;
     }
 
-    if (decode_ack_spi_bulk(buf_hdr, in_out_buf) != 0) {
-        printf("ERROR: invalid REQ_MULTIPLE_SPI ack\n");
+    /* the caller buffers may be released, the ACK is only checked */
+    mcu_pipeline.req[mcu_pipeline.nb_req - 1].buf = NULL;
+    mcu_pipeline.req[mcu_pipeline.nb_req - 1].data = NULL;
+
+    if (mcu_pipeline.depth == 1) {
+        return pipeline_wait(fd, id);
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_set_pipeline_depth(int fd, uint8_t depth) {
+    if ((depth == 0) || (depth > MCU_PIPELINE_DEPTH_MAX)) {
+        printf("ERROR: wrong MCU pipeline depth %u (max:%d)\n", depth, MCU_PIPELINE_DEPTH_MAX);
         return -1;
     }
 
+    mcu_pipeline.depth = depth;
+
+    /* going back to synchronous mode, complete all requests in flight */
+    if (depth == 1) {
+        return pipeline_drain(fd);
+    }
+
     return 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int mcu_sync(int fd) {
+    return pipeline_drain(fd);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void mcu_rx_reset(void) {
+    mcu_rx.head = 0;
+    mcu_rx.tail = 0;
+
+    /* the ACKs of the requests sent on a previous link will never come */
+    mcu_pipeline.nb_req = 0;
+    mcu_pipeline.error = false;
+    spi_bulk_buffer.nb_req = 0;
+    spi_bulk_buffer.size = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int mcu_spi_store(uint8_t * in_out_buf, size_t buf_size) {
-    CHECK_NULL(in_out_buf);
+    return mcu_spi_store_sg(in_out_buf, buf_size, NULL, 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int mcu_spi_store_sg(const uint8_t * in_buf, size_t buf_size, const uint8_t * data, size_t data_size) {
+    CHECK_NULL(in_buf);
+
+    return spi_req_bulk_insert(&spi_bulk_buffer, in_buf, buf_size, data, data_size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t mcu_spi_bulk_room(void) {
+    /* no more request can be stored */
+    if (spi_bulk_buffer.nb_req == 255) {
+        return 0;
+    }
 
-    return spi_req_bulk_insert(&spi_bulk_buffer, in_out_buf, buf_size);
+    return LGW_USB_BURST_CHUNK - spi_bulk_buffer.size;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int mcu_spi_flush(int fd) {
-    /* Write pending SPI requests to MCU */
-    if (mcu_spi_write(fd, spi_bulk_buffer.buffer, spi_bulk_buffer.size) != 0) {
+    /* Write pending SPI requests to MCU, the buffer can be reused as soon as it is written */
+    if (mcu_spi_post(fd, spi_bulk_buffer.buffer, spi_bulk_buffer.size) != 0) {
         printf("ERROR: %s: failed to write SPI requests to MCU\n", __FUNCTION__);
         return -1;
     }
@@ -0,0 +1,191 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Runtime latency profiling of the library
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <pthread.h>
+
+#include "loragw_perf.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define PERF_SLOT_MASK  (LGW_PERF_PROBE_NB_MAX - 1)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static bool perf_enabled = false;
+
+/* probes hashed on the address of their name, a slot is never released */
+static struct lgw_perf_probe_s perf_slot[LGW_PERF_PROBE_NB_MAX];
+
+/* creation of the probes, and order of their first measure */
+static pthread_mutex_t mx_perf = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t perf_order[LGW_PERF_PROBE_NB_MAX];
+static int perf_nb = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static struct lgw_perf_probe_s * perf_probe_get(const char * name) {
+    unsigned i, n;
+    const char * s;
+
+    i = (unsigned)(((uintptr_t)name >> 3) & PERF_SLOT_MASK);
+    for (n = 0; n < LGW_PERF_PROBE_NB_MAX; n++, i = (i + 1) & PERF_SLOT_MASK) {
+        s = __atomic_load_n(&perf_slot[i].name, __ATOMIC_ACQUIRE);
+        if (s == NULL) {
+            /* first measure of this probe, unless another thread took the slot meanwhile */
+            pthread_mutex_lock(&mx_perf);
+            s = perf_slot[i].name;
+            if (s == NULL) {
+                perf_order[perf_nb++] = (uint8_t)i;
+                __atomic_store_n(&perf_slot[i].name, name, __ATOMIC_RELEASE);
+                s = name;
+            }
+            pthread_mutex_unlock(&mx_perf);
+        }
+        if (s == name) {
+            return &perf_slot[i];
+        }
+    }
+
+    /* no more slots, the measure is dropped */
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void lgw_perf_enable(bool enable) {
+    __atomic_store_n(&perf_enabled, enable, __ATOMIC_RELAXED);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool lgw_perf_is_enabled(void) {
+    return __atomic_load_n(&perf_enabled, __ATOMIC_RELAXED);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_perf_record(const char * name, uint64_t duration_ns) {
+    struct lgw_perf_probe_s * p;
+    uint64_t max;
+    int k;
+
+    if (name == NULL) {
+        return;
+    }
+    p = perf_probe_get(name);
+    if (p == NULL) {
+        return;
+    }
+
+    /* log2 bucket: number of significant bits of the duration */
+    k = (duration_ns == 0) ? 0 : (64 - __builtin_clzll(duration_ns));
+    if (k >= LGW_PERF_BUCKET_NB) {
+        k = LGW_PERF_BUCKET_NB - 1;
+    }
+
+    __atomic_fetch_add(&p->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->sum_ns, duration_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->hist[k], 1, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&p->max_ns, __ATOMIC_RELAXED);
+    while ((duration_ns > max) && !__atomic_compare_exchange_n(&p->max_ns, &max, duration_ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_perf_get(struct lgw_perf_probe_s * probes, int nb_max) {
+    int i, k;
+    struct lgw_perf_probe_s * p;
+
+    if (probes == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&mx_perf);
+    for (i = 0; (i < perf_nb) && (i < nb_max); i++) {
+        p = &perf_slot[perf_order[i]];
+        probes[i].name = p->name;
+        probes[i].count = __atomic_load_n(&p->count, __ATOMIC_RELAXED);
+        probes[i].sum_ns = __atomic_load_n(&p->sum_ns, __ATOMIC_RELAXED);
+        probes[i].max_ns = __atomic_load_n(&p->max_ns, __ATOMIC_RELAXED);
+        for (k = 0; k < LGW_PERF_BUCKET_NB; k++) {
+            probes[i].hist[k] = __atomic_load_n(&p->hist[k], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&mx_perf);
+
+    return i;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_perf_reset(void) {
+    int i, k;
+    struct lgw_perf_probe_s * p;
+
+    pthread_mutex_lock(&mx_perf);
+    for (i = 0; i < perf_nb; i++) {
+        p = &perf_slot[perf_order[i]];
+        __atomic_store_n(&p->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&p->sum_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&p->max_ns, 0, __ATOMIC_RELAXED);
+        for (k = 0; k < LGW_PERF_BUCKET_NB; k++) {
+            __atomic_store_n(&p->hist[k], 0, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&mx_perf);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t lgw_perf_percentile(const struct lgw_perf_probe_s * probe, uint32_t per_mille) {
+    int k;
+    uint64_t total = 0;
+    uint64_t acc = 0;
+
+    if (probe == NULL) {
+        return 0;
+    }
+
+    for (k = 0; k < LGW_PERF_BUCKET_NB; k++) {
+        total += probe->hist[k];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    for (k = 0; k < (LGW_PERF_BUCKET_NB - 1); k++) {
+        acc += probe->hist[k];
+        if ((acc * 1000) >= (total * per_mille)) {
+            break;
+        }
+    }
+
+    /* the last bucket is not bounded */
+    if (k == (LGW_PERF_BUCKET_NB - 1)) {
+        return probe->max_ns;
+    }
+    return (k == 0) ? 0 : MIN((uint64_t)1 << k, probe->max_ns);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
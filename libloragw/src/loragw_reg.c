@@ -24,6 +24,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <stdio.h>      /* printf fprintf */
 
 #include "loragw_reg.h"
+#include "loragw_aux.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -42,22 +43,9 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
-#define SX1302_REG_EXT_MEM_PAGED_BASE_ADDR 0x0
-#define SX1302_REG_RX_BUFFER_BASE_ADDR 0x4000
-#define SX1302_REG_TX_TOP_A_BASE_ADDR 0x5200
-#define SX1302_REG_TX_TOP_B_BASE_ADDR 0x5400
-#define SX1302_REG_COMMON_BASE_ADDR 0x5600
-#define SX1302_REG_GPIO_BASE_ADDR 0x5640
-#define SX1302_REG_MBIST_BASE_ADDR 0x56c0
-#define SX1302_REG_RADIO_FE_BASE_ADDR 0x5700
-#define SX1302_REG_AGC_MCU_BASE_ADDR 0x5780
-#define SX1302_REG_CLK_CTRL_BASE_ADDR 0x57c0
-#define SX1302_REG_RX_TOP_BASE_ADDR 0x5800
-#define SX1302_REG_RX_TOP_LORA_SERVICE_FSK_BASE_ADDR 0x5b00
-#define SX1302_REG_CAPTURE_RAM_BASE_ADDR 0x6000
-#define SX1302_REG_ARB_MCU_BASE_ADDR 0x6080
-#define SX1302_REG_TIMESTAMP_BASE_ADDR 0x6100
-#define SX1302_REG_OTP_BASE_ADDR 0x6180
+/* Address range covered by the register shadow copy, from COMMON to RX_TOP_LORA_SERVICE_FSK */
+#define REG_SHADOW_ADDR_MIN SX1302_REG_COMMON_BASE_ADDR
+#define REG_SHADOW_SIZE (SX1302_REG_CAPTURE_RAM_BASE_ADDR - SX1302_REG_COMMON_BASE_ADDR)
 
 const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,SX1302_REG_COMMON_BASE_ADDR+0,0,0,2,0,1,0}, // COMMON_PAGE_PAGE
@@ -140,7 +128,7 @@ const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,SX1302_REG_TX_TOP_A_BASE_ADDR+14,0,0,8,0,1,0}, // TX_TOP_A_TIMEOUT_CNT_BYTE_2_TIMEOUT_CNT
     {0,SX1302_REG_TX_TOP_A_BASE_ADDR+15,0,0,8,0,1,0}, // TX_TOP_A_TIMEOUT_CNT_BYTE_1_TIMEOUT_CNT
     {0,SX1302_REG_TX_TOP_A_BASE_ADDR+16,0,0,8,0,1,0}, // TX_TOP_A_TIMEOUT_CNT_BYTE_0_TIMEOUT_CNT
-    {0,SX1302_REG_TX_TOP_A_BASE_ADDR+17,0,0,8,1,1,0}, // TX_TOP_A_TX_FSM_STATUS_TX_STATUS
+    SX1302_REG_TX_TOP_A_TX_FSM_STATUS_TX_STATUS_DESC, // TX_TOP_A_TX_FSM_STATUS_TX_STATUS
     {0,SX1302_REG_TX_TOP_A_BASE_ADDR+18,3,0,1,1,1,0}, // TX_TOP_A_DUMMY_CONTROL_DUMMY
     {0,SX1302_REG_TX_TOP_A_BASE_ADDR+32,5,0,3,0,1,0}, // TX_TOP_A_TX_RFFE_IF_CTRL_PLL_DIV_CTRL
     {0,SX1302_REG_TX_TOP_A_BASE_ADDR+32,4,0,1,0,1,1}, // TX_TOP_A_TX_RFFE_IF_CTRL_TX_CLK_EDGE
@@ -248,7 +236,7 @@ const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,SX1302_REG_TX_TOP_B_BASE_ADDR+14,0,0,8,0,1,0}, // TX_TOP_B_TIMEOUT_CNT_BYTE_2_TIMEOUT_CNT
     {0,SX1302_REG_TX_TOP_B_BASE_ADDR+15,0,0,8,0,1,0}, // TX_TOP_B_TIMEOUT_CNT_BYTE_1_TIMEOUT_CNT
     {0,SX1302_REG_TX_TOP_B_BASE_ADDR+16,0,0,8,0,1,0}, // TX_TOP_B_TIMEOUT_CNT_BYTE_0_TIMEOUT_CNT
-    {0,SX1302_REG_TX_TOP_B_BASE_ADDR+17,0,0,8,1,1,0}, // TX_TOP_B_TX_FSM_STATUS_TX_STATUS
+    SX1302_REG_TX_TOP_B_TX_FSM_STATUS_TX_STATUS_DESC, // TX_TOP_B_TX_FSM_STATUS_TX_STATUS
     {0,SX1302_REG_TX_TOP_B_BASE_ADDR+18,3,0,1,1,1,0}, // TX_TOP_B_DUMMY_CONTROL_DUMMY
     {0,SX1302_REG_TX_TOP_B_BASE_ADDR+32,5,0,3,0,1,0}, // TX_TOP_B_TX_RFFE_IF_CTRL_PLL_DIV_CTRL
     {0,SX1302_REG_TX_TOP_B_BASE_ADDR+32,4,0,1,0,1,1}, // TX_TOP_B_TX_RFFE_IF_CTRL_TX_CLK_EDGE
@@ -367,7 +355,7 @@ const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,SX1302_REG_GPIO_BASE_ADDR+19,0,0,1,1,1,0}, // GPIO_DUMMY_DUMMY
     {0,SX1302_REG_TIMESTAMP_BASE_ADDR+0,1,0,1,0,1,0}, // TIMESTAMP_GPS_CTRL_GPS_POL
     {0,SX1302_REG_TIMESTAMP_BASE_ADDR+0,0,0,1,0,1,0}, // TIMESTAMP_GPS_CTRL_GPS_EN
-    {0,SX1302_REG_TIMESTAMP_BASE_ADDR+1,0,0,8,1,1,0}, // TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS
+    SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS_DESC, // TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS
     {0,SX1302_REG_TIMESTAMP_BASE_ADDR+2,0,0,8,1,1,0}, // TIMESTAMP_TIMESTAMP_PPS_MSB1_TIMESTAMP_PPS
     {0,SX1302_REG_TIMESTAMP_BASE_ADDR+3,0,0,8,1,1,0}, // TIMESTAMP_TIMESTAMP_PPS_LSB2_TIMESTAMP_PPS
     {0,SX1302_REG_TIMESTAMP_BASE_ADDR+4,0,0,8,1,1,0}, // TIMESTAMP_TIMESTAMP_PPS_LSB1_TIMESTAMP_PPS
@@ -780,7 +768,7 @@ const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,SX1302_REG_RX_TOP_BASE_ADDR+197,0,0,8,1,1,0}, // RX_TOP_RX_BUFFER_LAST_ADDR_READ_LSB_LAST_ADDR_READ
     {0,SX1302_REG_RX_TOP_BASE_ADDR+198,0,0,4,1,1,0}, // RX_TOP_RX_BUFFER_LAST_ADDR_WRITE_MSB_LAST_ADDR_WRITE
     {0,SX1302_REG_RX_TOP_BASE_ADDR+199,0,0,8,1,1,0}, // RX_TOP_RX_BUFFER_LAST_ADDR_WRITE_LSB_LAST_ADDR_WRITE
-    {0,SX1302_REG_RX_TOP_BASE_ADDR+200,0,0,5,1,1,0}, // RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES
+    SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES_DESC, // RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES
     {0,SX1302_REG_RX_TOP_BASE_ADDR+201,0,0,8,1,1,0}, // RX_TOP_RX_BUFFER_NB_BYTES_LSB_RX_BUFFER_NB_BYTES
     {0,SX1302_REG_RX_TOP_BASE_ADDR+202,0,0,8,1,1,0}, // RX_TOP_MULTI_SF_SYNC_ERR_PKT_CNT_MULTI_SF_SYNC_ERR_PKTS
     {0,SX1302_REG_RX_TOP_BASE_ADDR+203,0,0,8,1,1,0}, // RX_TOP_MULTI_SF_PLD_ERR_PKT_CNT_MULTI_SF_PLD_ERR_PKTS
@@ -1107,23 +1095,162 @@ const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,0,0,0,0,0,0,0}
 };
 
+/* Register blocks holding configuration only, which can be shadowed.
+   TX, GPIO, MCUs, timestamp, capture and OTP blocks are updated by the hardware or firmwares */
+static const uint16_t reg_shadow_blocks[][2] = {
+    /* base address, address space size (up to the next block) */
+    {SX1302_REG_COMMON_BASE_ADDR, SX1302_REG_GPIO_BASE_ADDR - SX1302_REG_COMMON_BASE_ADDR},
+    {SX1302_REG_RADIO_FE_BASE_ADDR, SX1302_REG_AGC_MCU_BASE_ADDR - SX1302_REG_RADIO_FE_BASE_ADDR},
+    {SX1302_REG_CLK_CTRL_BASE_ADDR, SX1302_REG_RX_TOP_BASE_ADDR - SX1302_REG_CLK_CTRL_BASE_ADDR},
+    {SX1302_REG_RX_TOP_BASE_ADDR, SX1302_REG_RX_TOP_LORA_SERVICE_FSK_BASE_ADDR - SX1302_REG_RX_TOP_BASE_ADDR},
+    {SX1302_REG_RX_TOP_LORA_SERVICE_FSK_BASE_ADDR, SX1302_REG_CAPTURE_RAM_BASE_ADDR - SX1302_REG_RX_TOP_LORA_SERVICE_FSK_BASE_ADDR}
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+typedef struct {
+    bool enabled;                       /* shadow copy is in use (and holds the register values) */
+    uint8_t value[REG_SHADOW_SIZE];     /* last known value of each register byte */
+} reg_shadow_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
+/* Register bytes which can be shadowed: only holding writable fields with no side effect */
+static bool reg_shadow_cacheable[REG_SHADOW_SIZE];
+static uint16_t reg_shadow_blocks_size[ARRAY_SIZE(reg_shadow_blocks)];
+static bool reg_shadow_init_done = false;
+
+static reg_shadow_t reg_shadow_board[LGW_BOARD_NB_MAX];
+#define reg_shadow reg_shadow_board[lgw_board_cur]
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
 
+static void reg_shadow_init(void) {
+    struct lgw_reg_s r;
+    bool in_block;
+    int i, j, k, nb_bytes;
+
+    if (reg_shadow_init_done == true) {
+        return;
+    }
+
+    for (i = 0; i < REG_SHADOW_SIZE; i++) {
+        reg_shadow_cacheable[i] = true;
+    }
+    for (i = 0; i < LGW_TOTALREGS; i++) {
+        r = loregs[i];
+        in_block = false;
+        for (j = 0; j < (int)ARRAY_SIZE(reg_shadow_blocks); j++) {
+            if ((r.addr >= reg_shadow_blocks[j][0]) && (r.addr < (reg_shadow_blocks[j][0] + reg_shadow_blocks[j][1]))) {
+                in_block = true;
+                /* only load the part of the block holding registers */
+                if ((r.addr - reg_shadow_blocks[j][0]) >= reg_shadow_blocks_size[j]) {
+                    reg_shadow_blocks_size[j] = r.addr - reg_shadow_blocks[j][0] + 1;
+                }
+                break;
+            }
+        }
+        if ((in_block == false) || (r.addr < REG_SHADOW_ADDR_MIN) || (r.addr >= (REG_SHADOW_ADDR_MIN + REG_SHADOW_SIZE))) {
+            continue;
+        }
+        /* a single volatile field (status, pulse, clear on write) makes the whole byte volatile */
+        if ((r.rdon == 1) || (r.chck == 0)) {
+            nb_bytes = (r.offs + r.leng + 7) / 8;
+            for (k = 0; (k < nb_bytes) && ((r.addr - REG_SHADOW_ADDR_MIN + k) < REG_SHADOW_SIZE); k++) {
+                reg_shadow_cacheable[r.addr - REG_SHADOW_ADDR_MIN + k] = false;
+            }
+        }
+    }
+    /* bytes of the range not belonging to a shadowed block are never cached */
+    for (i = 0; i < REG_SHADOW_SIZE; i++) {
+        in_block = false;
+        for (j = 0; j < (int)ARRAY_SIZE(reg_shadow_blocks); j++) {
+            if (((REG_SHADOW_ADDR_MIN + i) >= reg_shadow_blocks[j][0]) && ((REG_SHADOW_ADDR_MIN + i) < (reg_shadow_blocks[j][0] + reg_shadow_blocks_size[j]))) {
+                in_block = true;
+                break;
+            }
+        }
+        if (in_block == false) {
+            reg_shadow_cacheable[i] = false;
+        }
+    }
+
+    reg_shadow_init_done = true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool reg_shadow_get(uint8_t spi_mux_target, uint16_t addr, uint8_t * value) {
+    if ((reg_shadow.enabled == false) || (spi_mux_target != LGW_SPI_MUX_TARGET_SX1302)) {
+        return false;
+    }
+    if ((addr < REG_SHADOW_ADDR_MIN) || (addr >= (REG_SHADOW_ADDR_MIN + REG_SHADOW_SIZE))) {
+        return false;
+    }
+    if (reg_shadow_cacheable[addr - REG_SHADOW_ADDR_MIN] == false) {
+        return false;
+    }
+
+    *value = reg_shadow.value[addr - REG_SHADOW_ADDR_MIN];
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void reg_shadow_set(uint8_t spi_mux_target, uint16_t addr, const uint8_t * data, uint16_t size) {
+    int i;
+
+    if ((reg_shadow.enabled == false) || (spi_mux_target != LGW_SPI_MUX_TARGET_SX1302)) {
+        return;
+    }
+
+    for (i = 0; i < size; i++) {
+        if (((addr + i) >= REG_SHADOW_ADDR_MIN) && ((addr + i) < (REG_SHADOW_ADDR_MIN + REG_SHADOW_SIZE))) {
+            reg_shadow.value[addr + i - REG_SHADOW_ADDR_MIN] = data[i];
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int reg_w(uint8_t spi_mux_target, struct lgw_reg_s r, int32_t reg_value) {
     int com_stat = LGW_REG_SUCCESS;
+    uint8_t mask, u, v;
 
     if ((r.leng == 8) && (r.offs == 0)) {
-        /* direct write */
-        com_stat = lgw_com_w(spi_mux_target, r.addr, (uint8_t)reg_value);
+        /* direct write, skipped if the register already holds the value */
+        v = (uint8_t)reg_value;
+        if ((reg_shadow_get(spi_mux_target, r.addr, &u) == true) && (u == v)) {
+            DEBUG_PRINTF("==> SHADOW UNCHANGED @ 0x%04X\n", r.addr);
+            return LGW_REG_SUCCESS;
+        }
+        com_stat = lgw_com_w(spi_mux_target, r.addr, v);
+        if (com_stat == LGW_COM_SUCCESS) {
+            reg_shadow_set(spi_mux_target, r.addr, &v, 1);
+        }
         DEBUG_PRINTF("==> DIRECT WRITE @ 0x%04X\n", r.addr);
     } else if ((r.offs + r.leng) <= 8) {
-        /* read-modify-write */
-        com_stat = lgw_com_rmw(spi_mux_target, r.addr, r.offs, r.leng, (uint8_t)reg_value);
-        DEBUG_PRINTF("==> READ MODIFY WRITE @ 0x%04X (offs:%u leng:%u)\n", r.addr, r.offs, r.leng);
+        if (reg_shadow_get(spi_mux_target, r.addr, &u) == true) {
+            /* modify the shadow copy, and write it if changed */
+            mask = (uint8_t)(((1 << r.leng) - 1) << r.offs);
+            v = (u & ~mask) | (((uint8_t)reg_value << r.offs) & mask);
+            if (v == u) {
+                DEBUG_PRINTF("==> SHADOW UNCHANGED @ 0x%04X (offs:%u leng:%u)\n", r.addr, r.offs, r.leng);
+                return LGW_REG_SUCCESS;
+            }
+            com_stat = lgw_com_w(spi_mux_target, r.addr, v);
+            if (com_stat == LGW_COM_SUCCESS) {
+                reg_shadow_set(spi_mux_target, r.addr, &v, 1);
+            }
+            DEBUG_PRINTF("==> SHADOW MODIFY WRITE @ 0x%04X (offs:%u leng:%u)\n", r.addr, r.offs, r.leng);
+        } else {
+            /* read-modify-write */
+            com_stat = lgw_com_rmw(spi_mux_target, r.addr, r.offs, r.leng, (uint8_t)reg_value);
+            DEBUG_PRINTF("==> READ MODIFY WRITE @ 0x%04X (offs:%u leng:%u)\n", r.addr, r.offs, r.leng);
+        }
     } else {
         /* register spanning multiple memory bytes but with an offset */
         DEBUG_MSG("ERROR: REGISTER SIZE AND OFFSET ARE NOT SUPPORTED\n");
@@ -1142,7 +1269,9 @@ int reg_r(uint8_t spi_mux_target, struct lgw_reg_s r, int32_t *reg_value) {
 
     if ((r.offs + r.leng) <= 8) {
         /* read one byte, then shift and mask bits to get reg value with sign extension if needed */
-        com_stat = lgw_com_r(spi_mux_target, r.addr, &bufu[0]);
+        if (reg_shadow_get(spi_mux_target, r.addr, &bufu[0]) == false) {
+            com_stat = lgw_com_r(spi_mux_target, r.addr, &bufu[0]);
+        }
         bufu[1] = bufu[0] << (8 - r.leng - r.offs); /* left-align the data */
         if (r.sign == true) {
             bufs[2] = bufs[1] >> (8 - r.leng); /* right align the data with sign extension (ARITHMETIC right shift) */
@@ -1174,6 +1303,9 @@ int lgw_connect(const lgw_com_type_t com_type, const char * com_path) {
         return LGW_REG_ERROR;
     }
 
+    /* the registers of a newly connected concentrator are unknown */
+    reg_shadow.enabled = false;
+
     /* open the COM link */
     com_stat = lgw_com_open(com_type, com_path);
     if (com_stat != LGW_COM_SUCCESS) {
@@ -1199,6 +1331,8 @@ int lgw_connect(const lgw_com_type_t com_type, const char * com_path) {
 int lgw_disconnect(void) {
     int com_stat;
 
+    reg_shadow.enabled = false;
+
     com_stat = lgw_com_close();
     if (com_stat == LGW_COM_SUCCESS) {
         DEBUG_MSG("Note: success disconnecting the concentrator\n");
@@ -1211,6 +1345,33 @@ int lgw_disconnect(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Concentrator reconnect */
+int lgw_reconnect(const char * com_path) {
+    int com_stat;
+    uint8_t u = 0;
+
+    /* the registers may have been changed meanwhile */
+    reg_shadow.enabled = false;
+
+    com_stat = lgw_com_reopen(com_path);
+    if (com_stat != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR RECONNECTING CONCENTRATOR\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* check the SX1302 answers */
+    com_stat = lgw_com_r(LGW_SPI_MUX_TARGET_SX1302, loregs[SX1302_REG_COMMON_VERSION_VERSION].addr, &u);
+    if (com_stat != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR READING CHIP VERSION REGISTER\n");
+        return LGW_REG_ERROR;
+    }
+
+    DEBUG_MSG("Note: success reconnecting the concentrator\n");
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* Write to a register addressed by name */
 int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
     int com_stat = LGW_COM_SUCCESS;
@@ -1297,6 +1458,9 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
 
     /* do the burst write */
     com_stat = lgw_com_wb(LGW_SPI_MUX_TARGET_SX1302, r.addr, data, size);
+    if (com_stat == LGW_COM_SUCCESS) {
+        reg_shadow_set(LGW_SPI_MUX_TARGET_SX1302, r.addr, data, size);
+    }
 
     if (com_stat != LGW_COM_SUCCESS) {
         DEBUG_MSG("ERROR: COM ERROR DURING REGISTER BURST WRITE\n");
@@ -1340,6 +1504,49 @@ int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Point to several registers by name and do burst reads in a row */
+int lgw_reg_rb_multi(const uint16_t * register_id, uint8_t * const * data, const uint16_t * size, uint8_t nb_reg) {
+    int com_stat = LGW_COM_SUCCESS;
+    struct lgw_com_rb_s req[nb_reg > 0 ? nb_reg : 1];
+    int i;
+
+    /* check input parameters */
+    CHECK_NULL(register_id);
+    CHECK_NULL(data);
+    CHECK_NULL(size);
+    if (nb_reg == 0) {
+        DEBUG_MSG("ERROR: NO REGISTER TO READ\n");
+        return LGW_REG_ERROR;
+    }
+    for (i = 0; i < nb_reg; i++) {
+        CHECK_NULL(data[i]);
+        if (size[i] == 0) {
+            DEBUG_MSG("ERROR: BURST OF NULL LENGTH\n");
+            return LGW_REG_ERROR;
+        }
+        if (register_id[i] >= LGW_TOTALREGS) {
+            DEBUG_MSG("ERROR: REGISTER NUMBER OUT OF DEFINED RANGE\n");
+            return LGW_REG_ERROR;
+        }
+        req[i].spi_mux_target = LGW_SPI_MUX_TARGET_SX1302;
+        req[i].address = loregs[register_id[i]].addr;
+        req[i].data = data[i];
+        req[i].size = size[i];
+    }
+
+    /* do the burst reads */
+    com_stat = lgw_com_rb_multi(req, nb_reg);
+
+    if (com_stat != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR: COM ERROR DURING REGISTER BURST READ\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_mem_wb(uint16_t mem_addr, const uint8_t *data, uint16_t size) {
     int com_stat = LGW_COM_SUCCESS;
     int chunk_cnt = 0;
@@ -1362,6 +1569,9 @@ int lgw_mem_wb(uint16_t mem_addr, const uint8_t *data, uint16_t size) {
 
         /* do the burst write */
         com_stat = lgw_com_wb(LGW_SPI_MUX_TARGET_SX1302, addr, &data[chunk_cnt * CHUNK_SIZE_MAX], chunk_size);
+        if (com_stat == LGW_COM_SUCCESS) {
+            reg_shadow_set(LGW_SPI_MUX_TARGET_SX1302, addr, &data[chunk_cnt * CHUNK_SIZE_MAX], chunk_size);
+        }
 
         /* prepare for next write */
         addr += chunk_size;
@@ -1420,4 +1630,38 @@ int lgw_mem_rb(uint16_t mem_addr, uint8_t *data, uint16_t size, bool fifo_mode)
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_shadow_enable(bool enable) {
+    int com_stat = LGW_COM_SUCCESS;
+    struct lgw_com_rb_s req[ARRAY_SIZE(reg_shadow_blocks)];
+    int i;
+
+    reg_shadow.enabled = false;
+    if (enable == false) {
+        DEBUG_MSG("Note: register shadow copy disabled\n");
+        return LGW_REG_SUCCESS;
+    }
+
+    reg_shadow_init();
+
+    /* load the current value of all shadowed blocks at once */
+    for (i = 0; i < (int)ARRAY_SIZE(reg_shadow_blocks); i++) {
+        req[i].spi_mux_target = LGW_SPI_MUX_TARGET_SX1302;
+        req[i].address = reg_shadow_blocks[i][0];
+        req[i].data = &reg_shadow.value[reg_shadow_blocks[i][0] - REG_SHADOW_ADDR_MIN];
+        req[i].size = reg_shadow_blocks_size[i];
+    }
+    com_stat = lgw_com_rb_multi(req, ARRAY_SIZE(reg_shadow_blocks));
+    if (com_stat != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR: COM ERROR DURING REGISTER SHADOW LOAD\n");
+        return LGW_REG_ERROR;
+    }
+
+    reg_shadow.enabled = true;
+    DEBUG_MSG("Note: register shadow copy enabled\n");
+
+    return LGW_REG_SUCCESS;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
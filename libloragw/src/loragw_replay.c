@@ -0,0 +1,419 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Record and replay of the traffic exchanged with the concentrator.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf fopen fwrite flockfile */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memcpy memcmp */
+
+#include "loragw_replay.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#if DEBUG_COM == 1
+    #define DEBUG_MSG(str)                fprintf(stdout, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stdout,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+    #define CHECK_NULL(a)                if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return LGW_REPLAY_ERROR;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                if(a==NULL){return LGW_REPLAY_ERROR;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+/*
+Trace file layout (multi-byte fields are little endian):
+    file header:    magic "LGWR" | version (1) | com type (1) | chunk size (2)
+    each record:    op (1) | mux target (1) | address (2) | size (2) | status (1) | reserved (1) | data (size)
+*/
+#define REPLAY_VERSION          1
+#define REPLAY_FILE_HDR_SIZE    8
+#define REPLAY_REC_HDR_SIZE     8
+
+#define REPLAY_MISMATCH_LOG_MAX 10 /* number of write mismatches printed */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Trace being replayed, fully loaded in memory */
+typedef struct {
+    uint8_t * buf;
+    size_t size;
+    size_t pos;                 /* offset of the next record */
+    lgw_com_type_t com_type;    /* communication type used for recording */
+    uint16_t chunk_size;        /* chunk size of the recorded communication type */
+    float temperature;          /* last temperature record passed */
+    uint32_t nb_rec;            /* number of records replayed */
+    uint32_t nb_mismatch;       /* number of writes which differed from the trace */
+} replay_ctx_t;
+
+/* Recorded access */
+typedef struct {
+    uint8_t op;
+    uint8_t spi_mux_target;
+    uint16_t address;
+    uint16_t size;
+    int8_t status;
+    const uint8_t * data;
+} replay_rec_t;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static FILE * replay_rec_file_board[LGW_BOARD_NB_MAX] = { NULL };
+#define replay_rec_file replay_rec_file_board[lgw_board_cur]
+
+static bool replay_rec_hdr_done_board[LGW_BOARD_NB_MAX] = { false };
+#define replay_rec_hdr_done replay_rec_hdr_done_board[lgw_board_cur]
+
+static const char replay_magic[4] = { 'L', 'G', 'W', 'R' };
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static bool op_is_read(uint8_t op) {
+    switch (op) {
+        case LGW_REPLAY_R:
+        case LGW_REPLAY_RB:
+        case LGW_REPLAY_RB_MULTI:
+        case LGW_REPLAY_SX1250_R:
+        case LGW_REPLAY_SX125X_R:
+        case LGW_REPLAY_SX1261_R:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Parse the record at the current position, without consuming it */
+static int rec_peek(const replay_ctx_t * ctx, replay_rec_t * rec) {
+    const uint8_t * p = ctx->buf + ctx->pos;
+
+    if ((ctx->pos + REPLAY_REC_HDR_SIZE) > ctx->size) {
+        return LGW_REPLAY_ERROR;
+    }
+
+    rec->op = p[0];
+    rec->spi_mux_target = p[1];
+    rec->address = (uint16_t)(p[2] | (p[3] << 8));
+    rec->size = (uint16_t)(p[4] | (p[5] << 8));
+    rec->status = (int8_t)p[6];
+    rec->data = p + REPLAY_REC_HDR_SIZE;
+
+    if ((ctx->pos + REPLAY_REC_HDR_SIZE + rec->size) > ctx->size) {
+        printf("ERROR: replay trace is truncated (record %u)\n", ctx->nb_rec);
+        return LGW_REPLAY_ERROR;
+    }
+
+    return LGW_REPLAY_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Temperature records are not ordered with the accesses, they only update the replayed temperature */
+static void rec_skip_temperature(replay_ctx_t * ctx) {
+    replay_rec_t rec;
+    uint32_t u;
+
+    while ((rec_peek(ctx, &rec) == LGW_REPLAY_SUCCESS) && (rec.op == LGW_REPLAY_TEMPERATURE)) {
+        if (rec.size == sizeof u) {
+            u = (uint32_t)rec.data[0] | ((uint32_t)rec.data[1] << 8) | ((uint32_t)rec.data[2] << 16) | ((uint32_t)rec.data[3] << 24);
+            memcpy(&ctx->temperature, &u, sizeof ctx->temperature);
+        }
+        ctx->pos += REPLAY_REC_HDR_SIZE + rec.size;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static size_t rec_write_file_hdr(FILE * file) {
+    uint8_t hdr[REPLAY_FILE_HDR_SIZE];
+    uint16_t chunk_size;
+
+    /* the chunk size drives how the HAL splits its bursts, it must be the same when replaying */
+    chunk_size = lgw_com_chunk_size();
+
+    memcpy(hdr, replay_magic, sizeof replay_magic);
+    hdr[4] = REPLAY_VERSION;
+    hdr[5] = (uint8_t)lgw_com_type();
+    hdr[6] = (uint8_t)(chunk_size >> 0);
+    hdr[7] = (uint8_t)(chunk_size >> 8);
+
+    return fwrite(hdr, sizeof hdr, 1, file);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_replay_record_start(const char * path) {
+    CHECK_NULL(path);
+
+    if (replay_rec_file != NULL) {
+        printf("ERROR: COM traffic is already being recorded\n");
+        return LGW_REPLAY_ERROR;
+    }
+
+    replay_rec_file = fopen(path, "wb");
+    if (replay_rec_file == NULL) {
+        printf("ERROR: failed to open replay trace %s for recording\n", path);
+        return LGW_REPLAY_ERROR;
+    }
+    /* the communication interface may not be opened yet, the file header is written with the first record */
+    replay_rec_hdr_done = false;
+
+    printf("INFO: recording COM traffic to %s\n", path);
+
+    return LGW_REPLAY_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_record_stop(void) {
+    int err = LGW_REPLAY_SUCCESS;
+
+    if (replay_rec_file == NULL) {
+        printf("ERROR: COM traffic is not being recorded\n");
+        return LGW_REPLAY_ERROR;
+    }
+
+    if (fclose(replay_rec_file) != 0) {
+        printf("ERROR: failed to close replay trace\n");
+        err = LGW_REPLAY_ERROR;
+    }
+    replay_rec_file = NULL;
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_replay_log(lgw_replay_op_t op, uint8_t spi_mux_target, uint16_t address, const uint8_t * data, uint16_t size, int status) {
+    uint8_t hdr[REPLAY_REC_HDR_SIZE];
+    FILE * file = replay_rec_file;
+    size_t n;
+
+    if (file == NULL) {
+        return;
+    }
+    if (data == NULL) {
+        size = 0;
+    }
+
+    hdr[0] = (uint8_t)op;
+    hdr[1] = spi_mux_target;
+    hdr[2] = (uint8_t)(address >> 0);
+    hdr[3] = (uint8_t)(address >> 8);
+    hdr[4] = (uint8_t)(size >> 0);
+    hdr[5] = (uint8_t)(size >> 8);
+    hdr[6] = (uint8_t)(int8_t)status;
+    hdr[7] = 0;
+
+    /* keep a record in one piece if several threads access the board */
+    flockfile(file);
+    n = 1;
+    if (replay_rec_hdr_done == false) {
+        n = rec_write_file_hdr(file);
+        replay_rec_hdr_done = true;
+    }
+    if (n == 1) {
+        n = fwrite(hdr, sizeof hdr, 1, file);
+    }
+    if ((n == 1) && (size > 0)) {
+        n = fwrite(data, size, 1, file);
+    }
+    funlockfile(file);
+
+    if (n != 1) {
+        printf("ERROR: failed to write replay trace, recording stopped\n");
+        lgw_replay_record_stop();
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_replay_log_temperature(float temperature) {
+    uint8_t data[4];
+    uint32_t u;
+
+    memcpy(&u, &temperature, sizeof u);
+    data[0] = (uint8_t)(u >> 0);
+    data[1] = (uint8_t)(u >> 8);
+    data[2] = (uint8_t)(u >> 16);
+    data[3] = (uint8_t)(u >> 24);
+
+    lgw_replay_log(LGW_REPLAY_TEMPERATURE, 0, 0, data, sizeof data, LGW_REPLAY_SUCCESS);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_open(const char * com_path, void ** com_target_ptr) {
+    replay_ctx_t * ctx;
+    FILE * file;
+    long size;
+
+    CHECK_NULL(com_path);
+    CHECK_NULL(com_target_ptr);
+
+    file = fopen(com_path, "rb");
+    if (file == NULL) {
+        printf("ERROR: failed to open replay trace %s\n", com_path);
+        return LGW_REPLAY_ERROR;
+    }
+    if ((fseek(file, 0, SEEK_END) != 0) || ((size = ftell(file)) < REPLAY_FILE_HDR_SIZE) || (fseek(file, 0, SEEK_SET) != 0)) {
+        printf("ERROR: invalid replay trace %s\n", com_path);
+        fclose(file);
+        return LGW_REPLAY_ERROR;
+    }
+
+    ctx = malloc(sizeof *ctx);
+    if (ctx == NULL) {
+        DEBUG_MSG("ERROR: MALLOC FAIL\n");
+        fclose(file);
+        return LGW_REPLAY_ERROR;
+    }
+    memset(ctx, 0, sizeof *ctx);
+
+    /* the whole trace is loaded, so that replaying does no I/O */
+    ctx->size = (size_t)size;
+    ctx->buf = malloc(ctx->size);
+    if ((ctx->buf == NULL) || (fread(ctx->buf, ctx->size, 1, file) != 1)) {
+        printf("ERROR: failed to load replay trace %s\n", com_path);
+        free(ctx->buf);
+        free(ctx);
+        fclose(file);
+        return LGW_REPLAY_ERROR;
+    }
+    fclose(file);
+
+    if ((memcmp(ctx->buf, replay_magic, sizeof replay_magic) != 0) || (ctx->buf[4] != REPLAY_VERSION) ||
+        ((ctx->buf[5] != LGW_COM_SPI) && (ctx->buf[5] != LGW_COM_USB) && (ctx->buf[5] != LGW_COM_SIM))) { /* not recorded while replaying */
+        printf("ERROR: %s is not a supported replay trace\n", com_path);
+        free(ctx->buf);
+        free(ctx);
+        return LGW_REPLAY_ERROR;
+    }
+    ctx->com_type = (lgw_com_type_t)ctx->buf[5];
+    ctx->chunk_size = (uint16_t)(ctx->buf[6] | (ctx->buf[7] << 8));
+    ctx->pos = REPLAY_FILE_HDR_SIZE;
+    ctx->temperature = 25.0; /* until a temperature record is found */
+
+    printf("INFO: replaying %s COM traffic from %s (%zu bytes)\n", (ctx->com_type == LGW_COM_SPI) ? "SPI" : ((ctx->com_type == LGW_COM_USB) ? "USB" : "SIM"), com_path, ctx->size);
+
+    *com_target_ptr = (void *)ctx;
+
+    return LGW_REPLAY_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_close(void * com_target) {
+    replay_ctx_t * ctx = (replay_ctx_t *)com_target;
+
+    CHECK_NULL(com_target);
+
+    rec_skip_temperature(ctx);
+    printf("INFO: replay done: %u records replayed, %zu bytes left, %u writes differed from the trace\n", ctx->nb_rec, ctx->size - ctx->pos, ctx->nb_mismatch);
+
+    free(ctx->buf);
+    free(ctx);
+
+    return LGW_REPLAY_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_xfer(void * com_target, lgw_replay_op_t op, uint8_t spi_mux_target, uint16_t address, uint8_t * data, uint16_t size) {
+    replay_ctx_t * ctx = (replay_ctx_t *)com_target;
+    replay_rec_t rec;
+
+    CHECK_NULL(com_target);
+    if ((data == NULL) && (size > 0)) {
+        return LGW_REPLAY_ERROR;
+    }
+
+    rec_skip_temperature(ctx);
+
+    if (rec_peek(ctx, &rec) != LGW_REPLAY_SUCCESS) {
+        printf("ERROR: end of replay trace reached after %u records\n", ctx->nb_rec);
+        return LGW_REPLAY_ERROR;
+    }
+
+    /* the record is left in place if the access does not match, so that an other path can consume it */
+    if ((rec.op != op) || (rec.spi_mux_target != spi_mux_target) || (rec.address != address) || (rec.size != size)) {
+        printf("ERROR: replay trace mismatch at record %u: expected op:%u mux:%u addr:0x%04X size:%u, got op:%u mux:%u addr:0x%04X size:%u\n",
+                ctx->nb_rec, rec.op, rec.spi_mux_target, rec.address, rec.size, op, spi_mux_target, address, size);
+        return LGW_REPLAY_ERROR;
+    }
+
+    if (op_is_read(op) == true) {
+        if (size > 0) {
+            memcpy(data, rec.data, size);
+        }
+    } else if ((size > 0) && (memcmp(data, rec.data, size) != 0)) {
+        ctx->nb_mismatch += 1;
+        if (ctx->nb_mismatch <= REPLAY_MISMATCH_LOG_MAX) {
+            printf("WARNING: replay record %u: data written differs from the trace (op:%u mux:%u addr:0x%04X)\n", ctx->nb_rec, op, spi_mux_target, address);
+        }
+    }
+
+    ctx->pos += REPLAY_REC_HDR_SIZE + rec.size;
+    ctx->nb_rec += 1;
+
+    return rec.status;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t lgw_replay_chunk_size(void * com_target) {
+    if (com_target == NULL) {
+        return 0;
+    }
+
+    return ((replay_ctx_t *)com_target)->chunk_size;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_get_temperature(void * com_target, float * temperature) {
+    replay_ctx_t * ctx = (replay_ctx_t *)com_target;
+
+    CHECK_NULL(com_target);
+    CHECK_NULL(temperature);
+
+    rec_skip_temperature(ctx);
+    *temperature = ctx->temperature;
+
+    return LGW_REPLAY_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
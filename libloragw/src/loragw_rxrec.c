@@ -0,0 +1,272 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Recorder of the raw blocks fetched from the SX1302 RX buffer.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fopen fwrite rename */
+#include <string.h>     /* memcpy */
+#include <time.h>       /* clock_gettime */
+#include <pthread.h>
+
+#include "loragw_rxrec.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_SX1302 == 1
+    #define DEBUG_MSG(str)                fprintf(stdout, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stdout,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RXREC_PATH_SIZE 256
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* Multiple producers (fetching threads, serialized by mx_rxrec_put), single consumer (writer) ring buffer */
+static uint8_t rxrec_ring[LGW_RXREC_RING_SIZE];
+static uint32_t rxrec_head = 0; /* next byte to be written, only modified with mx_rxrec_put locked */
+static uint32_t rxrec_tail = 0; /* next byte to be read, only modified by the writer */
+static uint32_t rxrec_dropped = 0;
+static pthread_mutex_t mx_rxrec_put = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t thrid_rxrec;
+static bool rxrec_run = false;
+static FILE * rxrec_file = NULL;
+static char rxrec_path[RXREC_PATH_SIZE];
+static uint32_t rxrec_file_size = 0; /* bytes written to the current file */
+static uint32_t rxrec_file_size_max = 0;
+static uint8_t rxrec_file_nb = 1;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static void * thread_rxrec(void * arg);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void ring_copy_in(uint32_t pos, const void * data, uint32_t size) {
+    uint32_t idx = pos & (LGW_RXREC_RING_SIZE - 1);
+    uint32_t first = (size < (LGW_RXREC_RING_SIZE - idx)) ? size : (LGW_RXREC_RING_SIZE - idx);
+
+    memcpy(&rxrec_ring[idx], data, first);
+    memcpy(&rxrec_ring[0], (const uint8_t *)data + first, size - first);
+}
+
+static void ring_copy_out(uint32_t pos, void * data, uint32_t size) {
+    uint32_t idx = pos & (LGW_RXREC_RING_SIZE - 1);
+    uint32_t first = (size < (LGW_RXREC_RING_SIZE - idx)) ? size : (LGW_RXREC_RING_SIZE - idx);
+
+    memcpy(data, &rxrec_ring[idx], first);
+    memcpy((uint8_t *)data + first, &rxrec_ring[0], size - first);
+}
+
+static void ring_write(FILE * file, uint32_t pos, uint32_t size) {
+    uint32_t idx = pos & (LGW_RXREC_RING_SIZE - 1);
+    uint32_t first = (size < (LGW_RXREC_RING_SIZE - idx)) ? size : (LGW_RXREC_RING_SIZE - idx);
+
+    fwrite(&rxrec_ring[idx], 1, first, file);
+    if (size > first) {
+        fwrite(&rxrec_ring[0], 1, size - first, file);
+    }
+}
+
+static int file_open(void) {
+    struct lgw_rxrec_file_hdr_s hdr;
+
+    rxrec_file = fopen(rxrec_path, "wb");
+    if (rxrec_file == NULL) {
+        printf("ERROR: failed to open RX capture file %s\n", rxrec_path);
+        return LGW_RXREC_ERROR;
+    }
+
+    memset(&hdr, 0, sizeof hdr);
+    memcpy(hdr.magic, LGW_RXREC_MAGIC, sizeof hdr.magic);
+    hdr.version = LGW_RXREC_VERSION;
+    hdr.endian = LGW_RXREC_ENDIAN;
+    fwrite(&hdr, sizeof hdr, 1, rxrec_file);
+    rxrec_file_size = sizeof hdr;
+
+    return LGW_RXREC_SUCCESS;
+}
+
+/* shift the files kept, path -> path.1 -> path.2..., and start a new one */
+static void file_rotate(void) {
+    char from[RXREC_PATH_SIZE + 4];
+    char to[RXREC_PATH_SIZE + 4];
+    int i;
+
+    fclose(rxrec_file);
+    for (i = rxrec_file_nb - 1; i > 0; i--) {
+        if (i == 1) {
+            snprintf(from, sizeof from, "%s", rxrec_path);
+        } else {
+            snprintf(from, sizeof from, "%s.%d", rxrec_path, i - 1);
+        }
+        snprintf(to, sizeof to, "%s.%d", rxrec_path, i);
+        rename(from, to); /* fails harmlessly for the files not created yet */
+    }
+    DEBUG_PRINTF("INFO: RX capture file rotated, %u bytes\n", rxrec_file_size);
+    file_open();
+}
+
+/* write the complete records of the ring to the file, and release them */
+static void ring_drain(void) {
+    struct lgw_rxrec_hdr_s hdr;
+    uint32_t head, tail, len;
+
+    head = __atomic_load_n(&rxrec_head, __ATOMIC_ACQUIRE);
+    for (tail = rxrec_tail; tail != head; tail += len) {
+        ring_copy_out(tail, &hdr, sizeof hdr);
+        len = sizeof hdr + hdr.size;
+        if ((rxrec_file != NULL) && (rxrec_file_size_max > 0) && (rxrec_file_size > sizeof(struct lgw_rxrec_file_hdr_s)) && ((rxrec_file_size + len) > rxrec_file_size_max)) {
+            file_rotate();
+        }
+        if (rxrec_file != NULL) {
+            ring_write(rxrec_file, tail, len);
+            rxrec_file_size += len;
+        } else {
+            __atomic_fetch_add(&rxrec_dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&rxrec_tail, tail, __ATOMIC_RELEASE);
+
+    if (rxrec_file != NULL) {
+        fflush(rxrec_file);
+    }
+}
+
+static void * thread_rxrec(void * arg) {
+    (void)arg;
+
+    while (__atomic_load_n(&rxrec_run, __ATOMIC_ACQUIRE) == true) {
+        ring_drain();
+        wait_ms(LGW_RXREC_PERIOD_MS);
+    }
+    ring_drain();
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_rxrec_start(const char * path, uint32_t file_size_max, uint8_t file_nb) {
+    if ((path == NULL) || (strlen(path) >= sizeof rxrec_path) || (file_nb < 1) || (file_nb > LGW_RXREC_FILE_NB_MAX)) {
+        return LGW_RXREC_ERROR;
+    }
+    if (rxrec_run == true) {
+        return LGW_RXREC_ERROR;
+    }
+
+    snprintf(rxrec_path, sizeof rxrec_path, "%s", path);
+    rxrec_file_size_max = file_size_max;
+    rxrec_file_nb = file_nb;
+    if (file_open() != LGW_RXREC_SUCCESS) {
+        return LGW_RXREC_ERROR;
+    }
+
+    pthread_mutex_lock(&mx_rxrec_put);
+    rxrec_head = 0;
+    rxrec_tail = 0;
+    rxrec_dropped = 0;
+    pthread_mutex_unlock(&mx_rxrec_put);
+
+    __atomic_store_n(&rxrec_run, true, __ATOMIC_RELEASE);
+    if (pthread_create(&thrid_rxrec, NULL, thread_rxrec, NULL) != 0) {
+        __atomic_store_n(&rxrec_run, false, __ATOMIC_RELEASE);
+        fclose(rxrec_file);
+        rxrec_file = NULL;
+        return LGW_RXREC_ERROR;
+    }
+
+    return LGW_RXREC_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxrec_stop(void) {
+    if (rxrec_run == false) {
+        return LGW_RXREC_ERROR;
+    }
+
+    __atomic_store_n(&rxrec_run, false, __ATOMIC_RELEASE);
+    pthread_join(thrid_rxrec, NULL);
+
+    if (rxrec_file != NULL) {
+        fclose(rxrec_file);
+        rxrec_file = NULL;
+    }
+
+    return LGW_RXREC_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_rxrec_put(uint8_t board, const uint8_t * data, uint16_t size, uint16_t chip_size) {
+    struct lgw_rxrec_hdr_s hdr;
+    struct timespec now;
+    uint32_t head;
+    uint32_t len = sizeof hdr + size;
+
+    if (__atomic_load_n(&rxrec_run, __ATOMIC_ACQUIRE) == false) {
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    hdr.host_time_ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+    hdr.size = size;
+    hdr.chip_size = chip_size;
+    hdr.board = board;
+    memset(hdr.reserved, 0, sizeof hdr.reserved);
+
+    pthread_mutex_lock(&mx_rxrec_put);
+    head = rxrec_head;
+    if ((LGW_RXREC_RING_SIZE - (head - __atomic_load_n(&rxrec_tail, __ATOMIC_ACQUIRE))) < len) {
+        pthread_mutex_unlock(&mx_rxrec_put);
+        __atomic_fetch_add(&rxrec_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    ring_copy_in(head, &hdr, sizeof hdr);
+    ring_copy_in(head + sizeof hdr, data, size);
+    __atomic_store_n(&rxrec_head, head + len, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mx_rxrec_put);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t lgw_rxrec_dropped(void) {
+    return __atomic_load_n(&rxrec_dropped, __ATOMIC_RELAXED);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,892 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Software model of a SX1302 concentrator with SX1250 radios.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* malloc free strtoul strtod */
+#include <string.h>     /* memset memcpy memmove strtok_r */
+#include <time.h>       /* clock_gettime */
+#include <math.h>       /* log */
+
+#include "loragw_sim.h"
+#include "loragw_com.h"
+#include "loragw_reg.h"
+#include "loragw_hal.h"
+#include "loragw_sx1302.h"
+#include "loragw_sx1302_rx.h"
+#include "sx1250_defs.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#if DEBUG_COM == 1
+    #define DEBUG_MSG(str)                fprintf(stdout, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stdout,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+    #define CHECK_NULL(a)                if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return LGW_SIM_ERROR;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                if(a==NULL){return LGW_SIM_ERROR;}
+#endif
+
+#define REG_ADDR(id)    (loregs[(id)].addr)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SIM_MEM_SIZE            0x8000  /* SX1302 address space (15 bits) */
+#define SIM_RX_BUFFER_ADDR      0x4000  /* RX buffer FIFO read address */
+#define SIM_FIFO_SIZE           4096    /* default RX buffer size, as fetched by the host in one read */
+#define SIM_FIFO_SIZE_MAX       8191    /* largest RX buffer size, limited by the 13-bit fill level register */
+#define SIM_FIFO_PKT_NB_MAX     255     /* packets held by the RX buffer, as counted by the host */
+#define SIM_CHUNK_SIZE          4096
+
+#define SIM_FW_VERSION_AGC      10      /* version reported by the SX1250 AGC firmware */
+#define SIM_FW_VERSION_ARB      2       /* version reported by the arbiter firmware */
+#define SIM_MODEL_ID            0x02    /* SX1302, default chip model */
+#define SIM_EUI                 0x0016C001FF1E0000ULL
+#define SIM_TEMPERATURE         25.0
+
+#define SIM_DIST_ITEM_NB_MAX    16
+
+/* SX1250 chip modes, as reported by GET_STATUS */
+#define SIM_RADIO_MODE_STBY_RC      0x02
+#define SIM_RADIO_MODE_STBY_XOSC    0x03
+#define SIM_RADIO_MODE_FS           0x04
+#define SIM_RADIO_MODE_RX           0x05
+#define SIM_RADIO_MODE_TX           0x06
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Weighted distribution of a packet parameter, eg. "7:6/8:3/9-12:1" */
+typedef struct {
+    uint8_t nb;
+    uint32_t total;                             /* sum of all weights, 0 if no item */
+    struct {
+        uint8_t min;
+        uint8_t max;
+        uint32_t weight;                        /* weight of each value of the range */
+    } item[SIM_DIST_ITEM_NB_MAX];
+} sim_dist_t;
+
+/* Simulated concentrator */
+typedef struct {
+    uint8_t mem[SIM_MEM_SIZE];                  /* SX1302 registers and MCU memories */
+    uint8_t radio_mode[LGW_RF_CHAIN_NB];
+    uint64_t t0_ns;                             /* time at which the timestamp counter was 0 */
+    uint32_t prng;
+
+    /* traffic profile */
+    double rate;                                /* packets per second */
+    sim_dist_t sf;
+    sim_dist_t chan;
+    uint8_t size_min;
+    uint8_t size_max;
+    double crc_bad;                             /* ratio of packets with a bad CRC */
+    uint8_t model_id;                           /* chip model read from the OTP */
+
+    /* RX buffer */
+    bool rx_on;                                 /* ARB firmware running, packets are generated */
+    uint64_t next_pkt_ns;                       /* time of arrival of the next packet */
+    uint8_t fifo[SIM_FIFO_SIZE_MAX];
+    uint16_t fifo_max;                          /* size of the FIFO */
+    uint16_t fifo_size;                         /* number of bytes written to the FIFO */
+    uint16_t fifo_pos;                          /* number of bytes already read by the host */
+    uint16_t fifo_pkt_nb;                       /* number of packets in the FIFO */
+
+    /* link failures */
+    uint64_t link_drop_ns;                      /* interval between link drops, 0 if none */
+    bool link_reset;                            /* the concentrator is reset during a link drop */
+    uint64_t next_drop_ns;                      /* time of the next link drop */
+    bool link_down;                             /* accesses fail until lgw_sim_reopen() */
+
+    /* write mode, writes are applied at once but a flush must follow a switch to bulk mode */
+    lgw_com_write_mode_t write_mode;
+
+    /* counters */
+    uint32_t nb_pkt_gen;
+    uint32_t nb_pkt_drop;                       /* packets lost because the RX buffer was full */
+    uint32_t nb_tx;
+} sim_ctx_t;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+extern const struct lgw_reg_s loregs[];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static uint64_t sim_now_ns(void);
+static uint32_t sim_rand(sim_ctx_t * ctx);
+static uint32_t sim_rand_range(sim_ctx_t * ctx, uint32_t min, uint32_t max);
+static uint8_t sim_dist_pick(sim_ctx_t * ctx, const sim_dist_t * dist);
+static int sim_dist_parse(const char * str, uint8_t min, uint8_t max, sim_dist_t * dist);
+static void sim_reset(sim_ctx_t * ctx);
+static bool sim_link_failed(sim_ctx_t * ctx);
+static int sim_profile_parse(sim_ctx_t * ctx, const char * com_path);
+static uint32_t sim_counter(const sim_ctx_t * ctx, uint64_t t_ns);
+static uint8_t sim_reg_get(const sim_ctx_t * ctx, uint16_t reg_id);
+static void sim_rx_generate(sim_ctx_t * ctx);
+static void sim_fifo_read(sim_ctx_t * ctx, uint8_t * data, uint16_t size);
+static void sim_reg_before_read(sim_ctx_t * ctx, uint16_t address, uint16_t size);
+static void sim_reg_after_write(sim_ctx_t * ctx, uint16_t address, uint8_t prev, uint8_t value);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t sim_now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* xorshift32, good enough for traffic generation and reproducible with a seed */
+static uint32_t sim_rand(sim_ctx_t * ctx) {
+    uint32_t x = ctx->prng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ctx->prng = x;
+
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t sim_rand_range(sim_ctx_t * ctx, uint32_t min, uint32_t max) {
+    return min + (sim_rand(ctx) % (max - min + 1));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t sim_dist_pick(sim_ctx_t * ctx, const sim_dist_t * dist) {
+    uint32_t r;
+    uint32_t range_weight;
+    int i;
+
+    r = sim_rand(ctx) % dist->total;
+    for (i = 0; i < dist->nb; i++) {
+        range_weight = dist->item[i].weight * (dist->item[i].max - dist->item[i].min + 1);
+        if (r < range_weight) {
+            return dist->item[i].min + (r / dist->item[i].weight);
+        }
+        r -= range_weight;
+    }
+
+    return dist->item[0].min; /* not reached */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_dist_parse(const char * str, uint8_t min, uint8_t max, sim_dist_t * dist) {
+    unsigned long a, b, w;
+    char * end;
+
+    memset(dist, 0, sizeof *dist);
+
+    while (*str != '\0') {
+        if (dist->nb >= SIM_DIST_ITEM_NB_MAX) {
+            printf("ERROR: too many items in simulator distribution\n");
+            return LGW_SIM_ERROR;
+        }
+        a = strtoul(str, &end, 10);
+        if (end == str) {
+            return LGW_SIM_ERROR;
+        }
+        b = a;
+        w = 1;
+        if (*end == '-') {
+            str = end + 1;
+            b = strtoul(str, &end, 10);
+            if (end == str) {
+                return LGW_SIM_ERROR;
+            }
+        }
+        if (*end == ':') {
+            str = end + 1;
+            w = strtoul(str, &end, 10);
+            if ((end == str) || (w == 0) || (w > 1000)) {
+                return LGW_SIM_ERROR;
+            }
+        }
+        if ((a < min) || (b > max) || (a > b)) {
+            printf("ERROR: simulator distribution item %lu-%lu out of range [%u..%u]\n", a, b, min, max);
+            return LGW_SIM_ERROR;
+        }
+        dist->item[dist->nb].min = (uint8_t)a;
+        dist->item[dist->nb].max = (uint8_t)b;
+        dist->item[dist->nb].weight = (uint32_t)w;
+        dist->total += (uint32_t)(w * (b - a + 1));
+        dist->nb += 1;
+
+        if (*end == '/') {
+            end += 1;
+        } else if (*end != '\0') {
+            return LGW_SIM_ERROR;
+        }
+        str = end;
+    }
+
+    return (dist->nb > 0) ? LGW_SIM_SUCCESS : LGW_SIM_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_profile_parse(sim_ctx_t * ctx, const char * com_path) {
+    char buf[256];
+    char * opt;
+    char * val = NULL;
+    char * save = NULL;
+    char * end;
+    unsigned long a, b;
+
+    /* default profile */
+    ctx->rate = 10.0;
+    sim_dist_parse("7-12", 5, 12, &ctx->sf);
+    sim_dist_parse("0-7", 0, LGW_MULTI_NB - 1, &ctx->chan);
+    ctx->size_min = 16;
+    ctx->size_max = 51;
+    ctx->crc_bad = 0.0;
+    ctx->model_id = SIM_MODEL_ID;
+    ctx->fifo_max = SIM_FIFO_SIZE;
+    ctx->prng = 1;
+
+    strncpy(buf, com_path, sizeof buf);
+    buf[sizeof buf - 1] = '\0'; /* ensure string termination */
+
+    for (opt = strtok_r(buf, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        val = strchr(opt, '=');
+        if (val == NULL) {
+            printf("ERROR: simulator option \"%s\" has no value\n", opt);
+            return LGW_SIM_ERROR;
+        }
+        *val++ = '\0';
+
+        if (strcmp(opt, "rate") == 0) {
+            ctx->rate = strtod(val, &end);
+            if ((end == val) || (*end != '\0') || (ctx->rate < 0.0)) {
+                break;
+            }
+        } else if (strcmp(opt, "sf") == 0) {
+            if (sim_dist_parse(val, 5, 12, &ctx->sf) != LGW_SIM_SUCCESS) {
+                break;
+            }
+        } else if (strcmp(opt, "chan") == 0) {
+            if (sim_dist_parse(val, 0, LGW_MULTI_NB - 1, &ctx->chan) != LGW_SIM_SUCCESS) {
+                break;
+            }
+        } else if (strcmp(opt, "size") == 0) {
+            a = strtoul(val, &end, 10);
+            b = a;
+            if (*end == '-') {
+                b = strtoul(end + 1, &end, 10);
+            }
+            if ((*end != '\0') || (a < 4) || (a > b) || (b > 255)) {
+                printf("ERROR: simulator payload size must be in [4..255]\n");
+                break;
+            }
+            ctx->size_min = (uint8_t)a;
+            ctx->size_max = (uint8_t)b;
+        } else if (strcmp(opt, "crc_bad") == 0) {
+            ctx->crc_bad = strtod(val, &end) / 100.0;
+            if ((end == val) || (*end != '\0') || (ctx->crc_bad < 0.0) || (ctx->crc_bad > 1.0)) {
+                break;
+            }
+        } else if (strcmp(opt, "fifo") == 0) {
+            a = strtoul(val, &end, 10);
+            if ((end == val) || (*end != '\0') || (a < 512) || (a > SIM_FIFO_SIZE_MAX)) {
+                printf("ERROR: simulator RX buffer size must be in [512..%u]\n", SIM_FIFO_SIZE_MAX);
+                break;
+            }
+            ctx->fifo_max = (uint16_t)a;
+        } else if (strcmp(opt, "chip") == 0) {
+            if (strcmp(val, "sx1302") == 0) {
+                ctx->model_id = CHIP_MODEL_ID_SX1302;
+            } else if (strcmp(val, "sx1303") == 0) {
+                ctx->model_id = CHIP_MODEL_ID_SX1303;
+            } else {
+                break;
+            }
+        } else if (strcmp(opt, "link_drop") == 0) {
+            a = strtoul(val, &end, 10);
+            if ((end == val) || (*end != '\0') || (a == 0)) {
+                break;
+            }
+            ctx->link_drop_ns = (uint64_t)a * 1000000000ULL;
+        } else if (strcmp(opt, "link_reset") == 0) {
+            a = strtoul(val, &end, 10);
+            if ((end == val) || (*end != '\0') || (a > 1)) {
+                break;
+            }
+            ctx->link_reset = (a == 1);
+        } else if (strcmp(opt, "seed") == 0) {
+            ctx->prng = (uint32_t)strtoul(val, &end, 0);
+            if ((end == val) || (*end != '\0')) {
+                break;
+            }
+            if (ctx->prng == 0) {
+                ctx->prng = 1; /* xorshift state must not be 0 */
+            }
+        } else {
+            printf("ERROR: unknown simulator option \"%s\"\n", opt);
+            return LGW_SIM_ERROR;
+        }
+    }
+
+    if (opt != NULL) {
+        printf("ERROR: invalid value \"%s\" for simulator option \"%s\"\n", val, opt);
+        return LGW_SIM_ERROR;
+    }
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* 32MHz free running counter */
+static uint32_t sim_counter(const sim_ctx_t * ctx, uint64_t t_ns) {
+    return (uint32_t)(((t_ns - ctx->t0_ns) * 32) / 1000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Power-on state: registers at their reset values, empty RX buffer, counter restarted */
+static void sim_reset(sim_ctx_t * ctx) {
+    struct lgw_reg_s r;
+    int i;
+
+    memset(ctx->mem, 0, sizeof ctx->mem);
+    for (i = 0; i < LGW_TOTALREGS; i++) {
+        r = loregs[i];
+        ctx->mem[r.addr] &= (uint8_t)~(((1 << r.leng) - 1) << r.offs);
+        ctx->mem[r.addr] |= (uint8_t)((r.dflt & ((1 << r.leng) - 1)) << r.offs);
+    }
+    ctx->mem[REG_ADDR(SX1302_REG_TX_TOP_A_TX_FSM_STATUS_TX_STATUS)] = 0x80; /* TX_FREE */
+    ctx->mem[REG_ADDR(SX1302_REG_TX_TOP_B_TX_FSM_STATUS_TX_STATUS)] = 0x80;
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        ctx->radio_mode[i] = SIM_RADIO_MODE_STBY_RC;
+    }
+    ctx->rx_on = false;
+    ctx->fifo_size = 0;
+    ctx->fifo_pos = 0;
+    ctx->fifo_pkt_nb = 0;
+    ctx->t0_ns = sim_now_ns();
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* The link drops periodically, and stays down until reopened */
+static bool sim_link_failed(sim_ctx_t * ctx) {
+    if ((ctx->link_down == false) && (ctx->link_drop_ns > 0) && (sim_now_ns() >= ctx->next_drop_ns)) {
+        printf("INFO: simulated concentrator: link dropped\n");
+        ctx->link_down = true;
+    }
+
+    return ctx->link_down;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Value of a register field (up to 8 bits) */
+static uint8_t sim_reg_get(const sim_ctx_t * ctx, uint16_t reg_id) {
+    struct lgw_reg_s r = loregs[reg_id];
+
+    return (uint8_t)((ctx->mem[r.addr] >> r.offs) & ((1 << r.leng) - 1));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Append to the RX buffer the packets received since the last call */
+static void sim_rx_generate(sim_ctx_t * ctx) {
+    uint64_t now_ns;
+    uint8_t * pkt;
+    uint8_t * tail;
+    uint8_t size, sf, chan;
+    uint16_t pkt_size, crc;
+    uint32_t cnt;
+    uint8_t checksum;
+    int i;
+
+    if ((ctx->rx_on == false) || (ctx->rate <= 0.0)) {
+        return;
+    }
+
+    /* reclaim the bytes already read by the host */
+    if (ctx->fifo_pos > 0) {
+        memmove(ctx->fifo, &ctx->fifo[ctx->fifo_pos], ctx->fifo_size - ctx->fifo_pos);
+        ctx->fifo_size -= ctx->fifo_pos;
+        ctx->fifo_pos = 0;
+        if (ctx->fifo_size == 0) {
+            ctx->fifo_pkt_nb = 0;
+        }
+    }
+
+    now_ns = sim_now_ns();
+    while (ctx->next_pkt_ns <= now_ns) {
+        size = (uint8_t)sim_rand_range(ctx, ctx->size_min, ctx->size_max);
+        pkt_size = SX1302_PKT_HEAD_METADATA + size + SX1302_PKT_TAIL_METADATA;
+
+        if (((ctx->fifo_size + pkt_size) > ctx->fifo_max) || (ctx->fifo_pkt_nb >= SIM_FIFO_PKT_NB_MAX)) {
+            ctx->nb_pkt_drop += 1;
+        } else {
+            sf = sim_dist_pick(ctx, &ctx->sf);
+            chan = sim_dist_pick(ctx, &ctx->chan);
+            cnt = ctx->nb_pkt_gen;
+            pkt = &ctx->fifo[ctx->fifo_size];
+            memset(pkt, 0, pkt_size);
+
+            /* header */
+            pkt[0] = SX1302_PKT_SYNCWORD_BYTE_0;
+            pkt[1] = SX1302_PKT_SYNCWORD_BYTE_1;
+            pkt[2] = size;
+            pkt[3] = chan;
+            pkt[4] = (uint8_t)(0x01 | (CR_LORA_4_5 << 1) | (sf << 4)); /* CRC enabled */
+            pkt[5] = chan; /* one modem per multi-SF channel */
+
+            /* payload: packet counter followed by random bytes */
+            pkt[SX1302_PKT_HEAD_METADATA + 0] = (uint8_t)(cnt >> 24);
+            pkt[SX1302_PKT_HEAD_METADATA + 1] = (uint8_t)(cnt >> 16);
+            pkt[SX1302_PKT_HEAD_METADATA + 2] = (uint8_t)(cnt >> 8);
+            pkt[SX1302_PKT_HEAD_METADATA + 3] = (uint8_t)(cnt >> 0);
+            for (i = 4; i < size; i++) {
+                pkt[SX1302_PKT_HEAD_METADATA + i] = (uint8_t)sim_rand(ctx);
+            }
+            crc = sx1302_lora_payload_crc(&pkt[SX1302_PKT_HEAD_METADATA], size);
+
+            /* tail, see SX1302_PKT_* macros */
+            tail = &pkt[size];
+            if (((double)sim_rand(ctx) / 4294967296.0) < ctx->crc_bad) {
+                tail[9] = 0x01;
+            }
+            tail[10] = (uint8_t)(int8_t)(4 * (int8_t)sim_rand_range(ctx, 0, 20) - 40); /* -10dB..+10dB, 0.25dB step */
+            tail[11] = (uint8_t)sim_rand_range(ctx, 100, 150);
+            tail[12] = tail[11] - 1;
+            cnt = sim_counter(ctx, ctx->next_pkt_ns);
+            tail[15] = (uint8_t)(cnt >> 0);
+            tail[16] = (uint8_t)(cnt >> 8);
+            tail[17] = (uint8_t)(cnt >> 16);
+            tail[18] = (uint8_t)(cnt >> 24);
+            tail[19] = (uint8_t)(crc >> 0);
+            tail[20] = (uint8_t)(crc >> 8);
+            tail[21] = 0; /* no fine timestamp metrics */
+            checksum = 0;
+            for (i = 0; i < (pkt_size - 1); i++) {
+                checksum += pkt[i];
+            }
+            pkt[pkt_size - 1] = checksum;
+
+            ctx->fifo_size += pkt_size;
+            ctx->fifo_pkt_nb += 1;
+            ctx->nb_pkt_gen += 1;
+        }
+
+        /* Poisson arrivals */
+        ctx->next_pkt_ns += (uint64_t)(-log(((double)sim_rand(ctx) + 1.0) / 4294967297.0) * 1e9 / ctx->rate);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sim_fifo_read(sim_ctx_t * ctx, uint8_t * data, uint16_t size) {
+    uint16_t nb;
+
+    nb = ctx->fifo_size - ctx->fifo_pos;
+    if (nb > size) {
+        nb = size;
+    }
+    memcpy(data, &ctx->fifo[ctx->fifo_pos], nb);
+    memset(&data[nb], 0, size - nb);
+    ctx->fifo_pos += nb;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Update the status registers covered by a read */
+static void sim_reg_before_read(sim_ctx_t * ctx, uint16_t address, uint16_t size) {
+    uint16_t a;
+    uint16_t nb_bytes;
+    uint32_t cnt;
+    uint64_t now_ns;
+
+    a = REG_ADDR(SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES);
+    if ((a >= address) && (a < (address + size))) {
+        sim_rx_generate(ctx);
+        nb_bytes = ctx->fifo_size - ctx->fifo_pos;
+        ctx->mem[a] = (uint8_t)((nb_bytes >> 8) & 0x1F);
+        ctx->mem[REG_ADDR(SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_LSB_RX_BUFFER_NB_BYTES)] = (uint8_t)nb_bytes;
+    }
+
+    /* PPS counter (latched every second since start), followed by the free running counter */
+    a = REG_ADDR(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS);
+    if ((address < (a + 8)) && ((address + size) > a)) {
+        now_ns = sim_now_ns();
+        cnt = sim_counter(ctx, now_ns - ((now_ns - ctx->t0_ns) % 1000000000ULL));
+        ctx->mem[a + 0] = (uint8_t)(cnt >> 24);
+        ctx->mem[a + 1] = (uint8_t)(cnt >> 16);
+        ctx->mem[a + 2] = (uint8_t)(cnt >> 8);
+        ctx->mem[a + 3] = (uint8_t)(cnt >> 0);
+        cnt = sim_counter(ctx, now_ns);
+        ctx->mem[a + 4] = (uint8_t)(cnt >> 24);
+        ctx->mem[a + 5] = (uint8_t)(cnt >> 16);
+        ctx->mem[a + 6] = (uint8_t)(cnt >> 8);
+        ctx->mem[a + 7] = (uint8_t)(cnt >> 0);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Emulate the side effects of a register byte write: MCU firmwares handshakes, OTP, TX triggers */
+static void sim_reg_after_write(sim_ctx_t * ctx, uint16_t address, uint8_t prev, uint8_t value) {
+    struct lgw_reg_s r;
+    uint8_t mask;
+    int m, rf;
+    const uint16_t tx_trig[LGW_RF_CHAIN_NB] = {
+        SX1302_REG_TX_TOP_A_TX_TRIG_TX_TRIG_IMMEDIATE,
+        SX1302_REG_TX_TOP_B_TX_TRIG_TX_TRIG_IMMEDIATE
+    };
+
+    /* AGC firmware started: report its version */
+    r = loregs[SX1302_REG_AGC_MCU_CTRL_MCU_CLEAR];
+    mask = (uint8_t)(((1 << r.leng) - 1) << r.offs);
+    if ((address == r.addr) && ((prev & mask) != 0) && ((value & mask) == 0)) {
+        ctx->mem[REG_ADDR(SX1302_REG_AGC_MCU_MCU_MAIL_BOX_RD_DATA_BYTE0_MCU_MAIL_BOX_RD_DATA)] = SIM_FW_VERSION_AGC;
+        ctx->mem[REG_ADDR(SX1302_REG_AGC_MCU_MCU_AGC_STATUS_MCU_AGC_STATUS)] = 0x01;
+        return;
+    }
+
+    /* AGC configuration step: echo the parameters, and move to the next step */
+    if (address == REG_ADDR(SX1302_REG_AGC_MCU_MCU_MAIL_BOX_WR_DATA_BYTE0_MCU_MAIL_BOX_WR_DATA - 3)) {
+        for (m = 0; m < 3; m++) {
+            ctx->mem[REG_ADDR(SX1302_REG_AGC_MCU_MCU_MAIL_BOX_RD_DATA_BYTE0_MCU_MAIL_BOX_RD_DATA - m)] = ctx->mem[REG_ADDR(SX1302_REG_AGC_MCU_MCU_MAIL_BOX_WR_DATA_BYTE0_MCU_MAIL_BOX_WR_DATA - m)];
+        }
+        switch (value) {
+            case 0x80: /* AGC_RADIO_A_INIT_DONE */
+                value = 0x02;
+                break;
+            case 0x20: /* AGC_RADIO_B_INIT_DONE */
+                value = 0x03;
+                break;
+            case 0x0B: /* LBT configuration */
+                value = 0x0F;
+                break;
+            case 0x0F: /* configuration done */
+                break;
+            default:
+                value += 1;
+                break;
+        }
+        ctx->mem[REG_ADDR(SX1302_REG_AGC_MCU_MCU_AGC_STATUS_MCU_AGC_STATUS)] = value;
+        return;
+    }
+
+    /* ARB firmware started: report its version */
+    r = loregs[SX1302_REG_ARB_MCU_CTRL_MCU_CLEAR];
+    mask = (uint8_t)(((1 << r.leng) - 1) << r.offs);
+    if ((address == r.addr) && ((prev & mask) != 0) && ((value & mask) == 0)) {
+        ctx->mem[REG_ADDR(SX1302_REG_ARB_MCU_ARB_DEBUG_STS_0_ARB_DEBUG_STS_0)] = SIM_FW_VERSION_ARB;
+        ctx->mem[REG_ADDR(SX1302_REG_ARB_MCU_MCU_ARB_STATUS_MCU_ARB_STATUS)] = 0x01;
+        return;
+    }
+
+    /* ARB resumed: the concentrator is receiving */
+    if ((address == REG_ADDR(SX1302_REG_ARB_MCU_ARB_DEBUG_CFG_1_ARB_DEBUG_CFG_1)) && (value == 1)) {
+        ctx->mem[REG_ADDR(SX1302_REG_ARB_MCU_MCU_ARB_STATUS_MCU_ARB_STATUS)] = 0x00;
+        ctx->rx_on = true;
+        ctx->next_pkt_ns = sim_now_ns();
+        return;
+    }
+
+    /* OTP read */
+    if (address == REG_ADDR(SX1302_REG_OTP_BYTE_ADDR_ADDR)) {
+        if (value < 8) {
+            ctx->mem[REG_ADDR(SX1302_REG_OTP_RD_DATA_RD_DATA)] = (uint8_t)(SIM_EUI >> (56 - (8 * value)));
+        } else if (value == 0xD0) {
+            ctx->mem[REG_ADDR(SX1302_REG_OTP_RD_DATA_RD_DATA)] = ctx->model_id;
+        } else {
+            ctx->mem[REG_ADDR(SX1302_REG_OTP_RD_DATA_RD_DATA)] = 0x00;
+        }
+        return;
+    }
+
+    /* TX trigger (immediate, delayed or on GPS): the packet is sent at once */
+    for (rf = 0; rf < LGW_RF_CHAIN_NB; rf++) {
+        if ((address == REG_ADDR(tx_trig[rf])) && ((~prev & value & 0x07) != 0)) {
+            ctx->nb_tx += 1;
+            DEBUG_PRINTF("INFO: simulated TX %u on RF chain %d\n", ctx->nb_tx, rf);
+            return;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_sim_open(const char * com_path, void ** com_target_ptr) {
+    sim_ctx_t * ctx;
+
+    /* Check input parameters */
+    CHECK_NULL(com_path);
+    CHECK_NULL(com_target_ptr);
+
+    ctx = malloc(sizeof *ctx);
+    if (ctx == NULL) {
+        printf("ERROR: failed to allocate simulated concentrator\n");
+        return LGW_SIM_ERROR;
+    }
+    memset(ctx, 0, sizeof *ctx);
+
+    if (sim_profile_parse(ctx, com_path) != LGW_SIM_SUCCESS) {
+        free(ctx);
+        return LGW_SIM_ERROR;
+    }
+
+    sim_reset(ctx);
+    ctx->next_drop_ns = ctx->t0_ns + ctx->link_drop_ns;
+
+    printf("INFO: simulated concentrator: %.1f pkt/s, payload %u-%u bytes, %.1f%% bad CRC, RX buffer %u bytes\n", ctx->rate, ctx->size_min, ctx->size_max, 100.0 * ctx->crc_bad, ctx->fifo_max);
+
+    *com_target_ptr = (void *)ctx;
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_close(void * com_target) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+
+    printf("INFO: simulated concentrator: %u packets generated, %u dropped (RX buffer full), %u sent\n", ctx->nb_pkt_gen, ctx->nb_pkt_drop, ctx->nb_tx);
+
+    free(ctx);
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_reopen(void * com_target) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+
+    if ((ctx->link_down == true) && (ctx->link_reset == true)) {
+        printf("INFO: simulated concentrator: reset during the link drop\n");
+        sim_reset(ctx);
+    }
+    ctx->link_down = false;
+    ctx->next_drop_ns = sim_now_ns() + ctx->link_drop_ns;
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_wb(void * com_target, uint8_t spi_mux_target, uint16_t address, const uint8_t * data, uint16_t size) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+    uint8_t prev;
+    int i;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    CHECK_NULL(data);
+    if ((spi_mux_target != LGW_SPI_MUX_TARGET_SX1302) || (((uint32_t)address + size) > SIM_MEM_SIZE)) {
+        printf("ERROR: simulated write out of range (target:%u addr:0x%04X size:%u)\n", spi_mux_target, address, size);
+        return LGW_SIM_ERROR;
+    }
+    if (sim_link_failed(ctx) == true) {
+        return LGW_SIM_ERROR;
+    }
+
+    for (i = 0; i < size; i++) {
+        prev = ctx->mem[address + i];
+        ctx->mem[address + i] = data[i];
+        sim_reg_after_write(ctx, address + i, prev, data[i]);
+    }
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_rb(void * com_target, uint8_t spi_mux_target, uint16_t address, uint8_t * data, uint16_t size) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    CHECK_NULL(data);
+    if ((spi_mux_target != LGW_SPI_MUX_TARGET_SX1302) || (((uint32_t)address + size) > SIM_MEM_SIZE)) {
+        printf("ERROR: simulated read out of range (target:%u addr:0x%04X size:%u)\n", spi_mux_target, address, size);
+        return LGW_SIM_ERROR;
+    }
+    if (sim_link_failed(ctx) == true) {
+        return LGW_SIM_ERROR;
+    }
+
+    if ((address == SIM_RX_BUFFER_ADDR) && (sim_reg_get(ctx, SX1302_REG_RX_TOP_RX_BUFFER_DIRECT_RAM_IF) == 0)) {
+        sim_fifo_read(ctx, data, size);
+        return LGW_SIM_SUCCESS;
+    }
+
+    sim_reg_before_read(ctx, address, size);
+    memcpy(data, &ctx->mem[address], size);
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_rmw(void * com_target, uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t leng, uint8_t data) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+    uint8_t mask;
+    uint8_t value;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    if ((spi_mux_target != LGW_SPI_MUX_TARGET_SX1302) || (address >= SIM_MEM_SIZE)) {
+        printf("ERROR: simulated read-modify-write out of range (target:%u addr:0x%04X)\n", spi_mux_target, address);
+        return LGW_SIM_ERROR;
+    }
+
+    mask = (uint8_t)(((1 << leng) - 1) << offs);
+    value = (uint8_t)((ctx->mem[address] & ~mask) | ((data << offs) & mask));
+
+    return lgw_sim_wb(com_target, spi_mux_target, address, &value, 1);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_radio_cmd(void * com_target, uint8_t spi_mux_target, uint8_t op_code, uint8_t * data, uint16_t size, bool read) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+    uint8_t * mode;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    CHECK_NULL(data);
+    if ((spi_mux_target != LGW_SPI_MUX_TARGET_RADIOA) && (spi_mux_target != LGW_SPI_MUX_TARGET_RADIOB)) {
+        printf("ERROR: simulated radio command to wrong target %u\n", spi_mux_target);
+        return LGW_SIM_ERROR;
+    }
+    if (sim_link_failed(ctx) == true) {
+        return LGW_SIM_ERROR;
+    }
+    mode = &ctx->radio_mode[(spi_mux_target == LGW_SPI_MUX_TARGET_RADIOA) ? 0 : 1];
+
+    if (read == true) {
+        /* only the chip mode is modelled, the first byte returned is the status */
+        memset(data, 0, size);
+        if ((op_code == GET_STATUS) && (size > 0)) {
+            data[0] = (uint8_t)(*mode << 4);
+        }
+        return LGW_SIM_SUCCESS;
+    }
+
+    switch (op_code) {
+        case SET_STANDBY:
+            *mode = ((size > 0) && (data[0] == STDBY_XOSC)) ? SIM_RADIO_MODE_STBY_XOSC : SIM_RADIO_MODE_STBY_RC;
+            break;
+        case SET_FS:
+            *mode = SIM_RADIO_MODE_FS;
+            break;
+        case SET_RX:
+            *mode = SIM_RADIO_MODE_RX;
+            break;
+        case SET_TX:
+            *mode = SIM_RADIO_MODE_TX;
+            break;
+        default:
+            break;
+    }
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_set_write_mode(void * com_target, lgw_com_write_mode_t write_mode) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    if (write_mode >= LGW_COM_WRITE_MODE_UNKNOWN) {
+        printf("ERROR: wrong write_mode (%d)\n", write_mode);
+        return LGW_SIM_ERROR;
+    }
+
+    ctx->write_mode = write_mode;
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_flush(void * com_target) {
+    sim_ctx_t * ctx = (sim_ctx_t *)com_target;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    if (ctx->write_mode != LGW_COM_WRITE_MODE_BULK) {
+        printf("ERROR: %s: cannot flush in single write mode\n", __FUNCTION__);
+        return LGW_SIM_ERROR;
+    }
+
+    /* Restore single mode after flushing, as the SPI and USB links */
+    ctx->write_mode = LGW_COM_WRITE_MODE_SINGLE;
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t lgw_sim_chunk_size(void) {
+    return (uint16_t)SIM_CHUNK_SIZE;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_get_temperature(void * com_target, float * temperature) {
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    CHECK_NULL(temperature);
+
+    *temperature = SIM_TEMPERATURE;
+
+    return LGW_SIM_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,171 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Aggregation of the SX1261 spectral scan results over time
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memset */
+
+#include "loragw_spectral.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define CHECK_NULL(a)   if(a==NULL){return LGW_HAL_ERROR;}
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SCAN_BIN_NB     LGW_SPECTRAL_SCAN_RESULT_SIZE /* 4 dB bins of a scan, the last one below the lowest level */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static struct lgw_spectral_freq_s * spectral_freq_get(struct lgw_spectral_agg_s * agg, uint32_t freq_hz) {
+    int i;
+    struct lgw_spectral_freq_s * f;
+
+    for (i = 0; i < agg->nb_freq; i++) {
+        if (agg->freq[i].freq_hz == freq_hz) {
+            return &(agg->freq[i]);
+        }
+    }
+
+    /* first scan of this frequency */
+    if (agg->nb_freq >= LGW_SPECTRAL_FREQ_NB_MAX) {
+        return NULL;
+    }
+    f = &(agg->freq[agg->nb_freq++]);
+    memset(f, 0, sizeof *f);
+    f->freq_hz = freq_hz;
+
+    return f;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* lowest level such that at least the given share of the samples are at or below its bin */
+static int16_t spectral_percentile(const struct lgw_spectral_agg_s * agg, const struct lgw_spectral_freq_s * f, uint32_t per_mille) {
+    int k;
+    uint32_t sum = 0;
+    uint32_t acc = 0;
+
+    for (k = 0; k < LGW_SPECTRAL_BIN_NB; k++) {
+        sum += f->hist[k];
+    }
+    for (k = LGW_SPECTRAL_BIN_NB - 1; k > 0; k--) {
+        acc += f->hist[k];
+        if ((acc * 1000) >= (sum * per_mille)) {
+            break;
+        }
+    }
+
+    return agg->level[k];
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void lgw_spectral_agg_init(struct lgw_spectral_agg_s * agg, uint8_t decay_shift) {
+    memset(agg, 0, sizeof *agg);
+    agg->decay_shift = (decay_shift > 15) ? 15 : decay_shift;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spectral_agg_merge(struct lgw_spectral_agg_s * agg, uint32_t freq_hz, const int16_t levels_dbm[static LGW_SPECTRAL_SCAN_RESULT_SIZE], const uint16_t results[static LGW_SPECTRAL_SCAN_RESULT_SIZE]) {
+    int i, k;
+    uint32_t total = 0;
+    uint32_t count[LGW_SPECTRAL_BIN_NB];
+    int32_t share;
+    struct lgw_spectral_freq_s * f;
+
+    CHECK_NULL(agg);
+    CHECK_NULL(levels_dbm);
+    CHECK_NULL(results);
+
+    /* decimate the scan by pairs of 4 dB bins, keeping the bin below the lowest level apart */
+    memset(count, 0, sizeof count);
+    for (i = 0; i < SCAN_BIN_NB; i++) {
+        k = (i == (SCAN_BIN_NB - 1)) ? (LGW_SPECTRAL_BIN_NB - 1) : (i / 2);
+        count[k] += results[i];
+        total += results[i];
+    }
+    if (total == 0) {
+        return LGW_HAL_ERROR;
+    }
+
+    f = spectral_freq_get(agg, freq_hz);
+    if (f == NULL) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* the levels only depend on the RSSI offset, the lower level of each pair is kept */
+    for (k = 0; k < (LGW_SPECTRAL_BIN_NB - 1); k++) {
+        agg->level[k] = levels_dbm[(2 * k) + 1];
+    }
+    agg->level[LGW_SPECTRAL_BIN_NB - 1] = levels_dbm[SCAN_BIN_NB - 1];
+
+    /* merge the shares of the scan in the rolling histogram */
+    for (k = 0; k < LGW_SPECTRAL_BIN_NB; k++) {
+        share = (int32_t)(((uint64_t)count[k] * LGW_SPECTRAL_HIST_ONE) / total);
+        if (f->nb_scan_total == 0) {
+            f->hist[k] = (uint16_t)share;
+        } else {
+            f->hist[k] = (uint16_t)((int32_t)f->hist[k] + ((share - (int32_t)f->hist[k]) / (1 << agg->decay_shift)));
+        }
+    }
+
+    /* highest level seen in the period */
+    for (k = 0; (k < (LGW_SPECTRAL_BIN_NB - 1)) && (count[k] == 0); k++);
+    if ((f->nb_scan == 0) || (agg->level[k] > f->level_max)) {
+        f->level_max = agg->level[k];
+    }
+
+    f->nb_scan += 1;
+    f->nb_scan_total += 1;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spectral_agg_summary(struct lgw_spectral_agg_s * agg, struct lgw_spectral_summary_s * summary, int nb_max) {
+    int i;
+    struct lgw_spectral_freq_s * f;
+
+    if ((agg == NULL) || (summary == NULL)) {
+        return 0;
+    }
+
+    for (i = 0; (i < agg->nb_freq) && (i < nb_max); i++) {
+        f = &(agg->freq[i]);
+        summary[i].freq_hz = f->freq_hz;
+        summary[i].nb_scan = f->nb_scan;
+        summary[i].p50 = spectral_percentile(agg, f, 500);
+        summary[i].p90 = spectral_percentile(agg, f, 900);
+        summary[i].p99 = spectral_percentile(agg, f, 990);
+        summary[i].max = (f->nb_scan > 0) ? f->level_max : agg->level[LGW_SPECTRAL_BIN_NB - 1];
+
+        /* new period */
+        f->nb_scan = 0;
+    }
+
+    return i;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
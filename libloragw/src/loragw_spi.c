@@ -54,6 +54,102 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define LGW_BURST_CHUNK     1024
 
+#define LGW_SPI_BULK_SIZE       1024    /* bytes queued in bulk mode, must not exceed spidev "bufsiz" (4096 by default) */
+#define LGW_SPI_BULK_XFER_NB    64      /* SPI frames queued in bulk mode */
+#define LGW_SPI_WRITE_HDR_SIZE  3       /* mux target + address of a write frame */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Write frames queued in bulk mode, sent as one message with CS toggled between frames */
+typedef struct {
+    lgw_com_write_mode_t write_mode;
+    uint16_t size;      /* number of bytes queued in buffer */
+    uint8_t nb_xfer;    /* number of frames queued in xfer */
+    struct spi_ioc_transfer xfer[LGW_SPI_BULK_XFER_NB];
+    uint8_t buffer[LGW_SPI_BULK_SIZE];
+} spi_bulk_t;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES  --------------------------------------------------- */
+
+static spi_bulk_t spi_bulk_board[LGW_BOARD_NB_MAX] = {
+    [0 ... LGW_BOARD_NB_MAX - 1] = {
+        .write_mode = LGW_COM_WRITE_MODE_SINGLE,
+        .size = 0,
+        .nb_xfer = 0
+    }
+};
+#define spi_bulk spi_bulk_board[lgw_board_cur]
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Send all queued write frames in a single ioctl */
+static int spi_bulk_send(int spi_device) {
+    int a;
+    int i;
+
+    if (spi_bulk.nb_xfer == 0) {
+        return LGW_SPI_SUCCESS;
+    }
+
+    /* CS toggles between frames, but must be released after the last one */
+    for (i = 0; i < (spi_bulk.nb_xfer - 1); i++) {
+        spi_bulk.xfer[i].cs_change = 1;
+    }
+    spi_bulk.xfer[spi_bulk.nb_xfer - 1].cs_change = 0;
+
+    DEBUG_PRINTF("INFO: flushing %u SPI frames (%u bytes)\n", spi_bulk.nb_xfer, spi_bulk.size);
+    a = ioctl(spi_device, SPI_IOC_MESSAGE(spi_bulk.nb_xfer), spi_bulk.xfer);
+
+    /* determine return code */
+    if (a != (int)spi_bulk.size) {
+        DEBUG_MSG("ERROR: SPI BULK WRITE FAILURE\n");
+        a = LGW_SPI_ERROR;
+    } else {
+        a = LGW_SPI_SUCCESS;
+    }
+
+    spi_bulk.size = 0;
+    spi_bulk.nb_xfer = 0;
+
+    return a;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Queue a write frame, the queue is sent first if there is not enough room left */
+static int spi_bulk_store(int spi_device, uint8_t spi_mux_target, uint16_t address, const uint8_t *data, uint16_t size) {
+    struct spi_ioc_transfer *k;
+    uint8_t *frame;
+    uint16_t frame_size = LGW_SPI_WRITE_HDR_SIZE + size;
+
+    if ((spi_bulk.nb_xfer >= LGW_SPI_BULK_XFER_NB) || ((spi_bulk.size + frame_size) > LGW_SPI_BULK_SIZE)) {
+        if (spi_bulk_send(spi_device) != LGW_SPI_SUCCESS) {
+            return LGW_SPI_ERROR;
+        }
+    }
+
+    frame = &spi_bulk.buffer[spi_bulk.size];
+    frame[0] = spi_mux_target;
+    frame[1] = WRITE_ACCESS | ((address >> 8) & 0x7F);
+    frame[2] =                ((address >> 0) & 0xFF);
+    memcpy(frame + LGW_SPI_WRITE_HDR_SIZE, data, size);
+
+    k = &spi_bulk.xfer[spi_bulk.nb_xfer];
+    memset(k, 0, sizeof(*k));
+    k->tx_buf = (unsigned long)frame;
+    k->len = frame_size;
+    k->speed_hz = SPI_SPEED;
+    k->bits_per_word = 8;
+
+    spi_bulk.size += frame_size;
+    spi_bulk.nb_xfer += 1;
+
+    return LGW_SPI_SUCCESS;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -125,6 +221,11 @@ int lgw_spi_open(const char * com_path, void **com_target_ptr) {
         return LGW_SPI_ERROR;
     }
 
+    /* nothing queued yet */
+    spi_bulk.write_mode = LGW_COM_WRITE_MODE_SINGLE;
+    spi_bulk.size = 0;
+    spi_bulk.nb_xfer = 0;
+
     *spi_device = dev;
     *com_target_ptr = (void *)spi_device;
     DEBUG_MSG("Note: SPI port opened and configured ok\n");
@@ -171,6 +272,10 @@ int lgw_spi_w(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8_
 
     spi_device = *(int *)com_target; /* must check that spi_target is not null beforehand */
 
+    if (spi_bulk.write_mode == LGW_COM_WRITE_MODE_BULK) {
+        return spi_bulk_store(spi_device, spi_mux_target, address, &data, 1);
+    }
+
     /* prepare frame to be sent */
     out_buf[0] = spi_mux_target;
     out_buf[1] = WRITE_ACCESS | ((address >> 8) & 0x7F);
@@ -214,6 +319,12 @@ int lgw_spi_r(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8_
 
     spi_device = *(int *)com_target; /* must check that com_target is not null beforehand */
 
+    if (spi_bulk.write_mode == LGW_COM_WRITE_MODE_BULK) {
+        /* same behaviour as USB: makes no sense to read in bulk mode */
+        printf("ERROR: SPI READ FAILURE - bulk mode is enabled\n");
+        return LGW_SPI_ERROR;
+    }
+
     /* prepare frame to be sent */
     out_buf[0] = spi_mux_target;
     out_buf[1] = READ_ACCESS | ((address >> 8) & 0x7F);
@@ -247,9 +358,18 @@ int lgw_spi_r(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8_
 int lgw_spi_rmw(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8_t offs, uint8_t leng, uint8_t data) {
     int spi_stat = LGW_SPI_SUCCESS;
     uint8_t buf[4] = "\x00\x00\x00\x00";
+    lgw_com_write_mode_t write_mode = spi_bulk.write_mode;
+
+    /* check input variables */
+    CHECK_NULL(com_target);
 
-    /* Read */
+    /* Read, after the queued writes to get an up-to-date value in bulk mode */
+    if (write_mode == LGW_COM_WRITE_MODE_BULK) {
+        spi_stat += spi_bulk_send(*(int *)com_target);
+        spi_bulk.write_mode = LGW_COM_WRITE_MODE_SINGLE;
+    }
     spi_stat += lgw_spi_r(com_target, spi_mux_target, address, &buf[0]);
+    spi_bulk.write_mode = write_mode;
 
     /* Modify */
     buf[1] = ((1 << leng) - 1) << offs; /* bit mask */
@@ -284,6 +404,16 @@ int lgw_spi_wb(void *com_target, uint8_t spi_mux_target, uint16_t address, const
 
     spi_device = *(int *)com_target; /* must check that com_target is not null beforehand */
 
+    if (spi_bulk.write_mode == LGW_COM_WRITE_MODE_BULK) {
+        if ((LGW_SPI_WRITE_HDR_SIZE + size) <= LGW_SPI_BULK_SIZE) {
+            return spi_bulk_store(spi_device, spi_mux_target, address, data, size);
+        }
+        /* too large to be queued: send the pending frames first to keep ordering */
+        if (spi_bulk_send(spi_device) != LGW_SPI_SUCCESS) {
+            return LGW_SPI_ERROR;
+        }
+    }
+
     /* prepare command byte */
     command[0] = spi_mux_target;
     command[1] = WRITE_ACCESS | ((address >> 8) & 0x7F);
@@ -339,6 +469,11 @@ int lgw_spi_rb(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8
 
     spi_device = *(int *)com_target; /* must check that com_target is not null beforehand */
 
+    if (spi_bulk.write_mode == LGW_COM_WRITE_MODE_BULK) {
+        printf("ERROR: SPI READ BURST FAILURE - bulk mode is enabled\n");
+        return LGW_SPI_ERROR;
+    }
+
     /* prepare command byte */
     command[0] = spi_mux_target;
     command[1] = READ_ACCESS | ((address >> 8) & 0x7F);
@@ -379,4 +514,35 @@ uint16_t lgw_spi_chunk_size(void) {
     return (uint16_t)LGW_BURST_CHUNK;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_set_write_mode(lgw_com_write_mode_t write_mode) {
+    if (write_mode >= LGW_COM_WRITE_MODE_UNKNOWN) {
+        printf("ERROR: wrong write mode\n");
+        return LGW_SPI_ERROR;
+    }
+
+    DEBUG_PRINTF("INFO: setting SPI write mode to %s\n", (write_mode == LGW_COM_WRITE_MODE_SINGLE) ? "SINGLE" : "BULK");
+
+    spi_bulk.write_mode = write_mode;
+
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_flush(void *com_target) {
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    if (spi_bulk.write_mode != LGW_COM_WRITE_MODE_BULK) {
+        printf("ERROR: %s: cannot flush in single write mode\n", __FUNCTION__);
+        return LGW_SPI_ERROR;
+    }
+
+    /* Restore single mode after flushing */
+    spi_bulk.write_mode = LGW_COM_WRITE_MODE_SINGLE;
+
+    return spi_bulk_send(*(int *)com_target);
+}
+
 /* --- EOF ------------------------------------------------------------------ */
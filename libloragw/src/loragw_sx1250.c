@@ -174,6 +174,11 @@ int sx1250_setup(uint8_t rf_chain, uint32_t freq_hz, bool single_input_mode) {
         return LGW_REG_ERROR;
     }
 
+    /* Group the register writes, only written, in a single request on USB.
+       The host does not see BUSY and the MCU sends the bulk commands back to back,
+       so the group ends before SET_RX, which keeps BUSY high while the radio locks. */
+    err |= sx1250_com_set_write_mode(lgw_com_type(), LGW_COM_WRITE_MODE_BULK);
+
     /* Set Bitrate to maximum (to lower TX to FS switch time) */
     buff[0] = 0x06;
     buff[1] = 0xA1;
@@ -232,7 +237,9 @@ int sx1250_setup(uint8_t rf_chain, uint32_t freq_hz, bool single_input_mode) {
     buff[4] = 0x00;
     err |= sx1250_reg_w(WRITE_REGISTER, buff, 5, rf_chain);
 
-    /* Set Radio in Rx mode, necessary to give a clock to SX1302 */
+    err |= sx1250_com_flush(lgw_com_type(), lgw_com_target());
+
+    /* Set Radio in Rx mode, necessary to give a clock to SX1302, the following writes wait BUSY */
     buff[0] = 0xFF;
     buff[1] = 0xFF;
     buff[2] = 0xFF;
@@ -54,6 +54,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
 #define SX1261_PRAM_VERSION_FULL_SIZE 16 /* 15 bytes + terminating char */
+#define SX1261_PRAM_CHUNK_WORDS     32 /* PRAM words per register write, the address auto-increments */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
@@ -192,8 +193,8 @@ int sx1261_reg_r(sx1261_op_code_t op_code, uint8_t *data, uint16_t size) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int sx1261_load_pram(void) {
-    int i, err;
-    uint8_t buff[32];
+    int i, j, n, err;
+    uint8_t buff[2 + 4 * SX1261_PRAM_CHUNK_WORDS];
     char pram_version[SX1261_PRAM_VERSION_FULL_SIZE];
     uint32_t val, addr;
 
@@ -215,6 +216,10 @@ int sx1261_load_pram(void) {
     }
     printf("SX1261: PRAM version: %s\n", pram_version);
 
+    /* Set SPI write bulk mode to optimize speed on USB, the patch is only written */
+    err = sx1261_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
     /* Enable patch update */
     buff[0] = 0x06;
     buff[1] = 0x10;
@@ -222,18 +227,21 @@ int sx1261_load_pram(void) {
     err = sx1261_reg_w( SX1261_WRITE_REGISTER, buff, 3);
     CHECK_ERR(err);
 
-    /* Load patch */
-    for (i = 0; i < (int)PRAM_COUNT; i++) {
-        val = pram[i];
+    /* Load patch, by chunks of consecutive words */
+    for (i = 0; i < (int)PRAM_COUNT; i += n) {
+        n = ((int)PRAM_COUNT - i < SX1261_PRAM_CHUNK_WORDS) ? ((int)PRAM_COUNT - i) : SX1261_PRAM_CHUNK_WORDS;
         addr = 0x8000 + 4*i;
 
         buff[0] = (addr >> 8) & 0xFF;
         buff[1] = (addr >> 0) & 0xFF;
-        buff[2] = (val >> 24) & 0xFF;
-        buff[3] = (val >> 16) & 0xFF;
-        buff[4] = (val >> 8)  & 0xFF;
-        buff[5] = (val >> 0)  & 0xFF;
-        err = sx1261_reg_w(SX1261_WRITE_REGISTER, buff, 6);
+        for (j = 0; j < n; j++) {
+            val = pram[i + j];
+            buff[2 + 4*j] = (val >> 24) & 0xFF;
+            buff[3 + 4*j] = (val >> 16) & 0xFF;
+            buff[4 + 4*j] = (val >> 8)  & 0xFF;
+            buff[5 + 4*j] = (val >> 0)  & 0xFF;
+        }
+        err = sx1261_reg_w(SX1261_WRITE_REGISTER, buff, 2 + 4*n);
         CHECK_ERR(err);
     }
 
@@ -249,6 +257,10 @@ int sx1261_load_pram(void) {
     err = sx1261_reg_w(0xd9, buff, 0);
     CHECK_ERR(err);
 
+    /* Send the patch, and back to single write mode */
+    err = sx1261_com_flush();
+    CHECK_ERR(err);
+
     err = sx1261_pram_get_version(pram_version);
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: %s: SX1261 failed to get pram version\n", __FUNCTION__);
@@ -320,15 +332,15 @@ int sx1261_setup(void) {
     int err;
     uint8_t buff[32];
 
+    /* Set SPI write bulk mode to optimize speed on USB */
+    err = sx1261_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
     /* Set Radio in Standby mode */
     buff[0] = (uint8_t)SX1261_STDBY_RC;
     err = sx1261_reg_w(SX1261_SET_STANDBY, buff, 1);
     CHECK_ERR(err);
 
-    /* Check radio status */
-    err = sx1261_check_status(SX1261_STATUS_MODE_STBY_RC | SX1261_STATUS_READY);
-    CHECK_ERR(err);
-
     /* Set Buffer Base address */
     buff[0] = 0x80;
     buff[1] = 0x80;
@@ -342,6 +354,14 @@ int sx1261_setup(void) {
     err = sx1261_reg_w(SX1261_WRITE_REGISTER, buff, 3);
     CHECK_ERR(err);
 
+    /* Send all commands at once, and back to single write mode */
+    err = sx1261_com_flush();
+    CHECK_ERR(err);
+
+    /* Check radio status, the buffer and register settings keep it in standby */
+    err = sx1261_check_status(SX1261_STATUS_MODE_STBY_RC | SX1261_STATUS_READY);
+    CHECK_ERR(err);
+
     DEBUG_MSG("SX1261: setup for LBT / Spectral Scan done\n");
 
     return LGW_REG_SUCCESS;
@@ -355,7 +375,7 @@ int sx1261_set_rx_params(uint32_t freq_hz, uint8_t bandwidth) {
     int32_t freq_reg;
     uint8_t fsk_bw_reg;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -476,7 +496,7 @@ int sx1261_lbt_start(lgw_lbt_scan_time_t scan_time_us, int8_t threshold_dbm) {
     uint16_t nb_scan;
     uint8_t threshold_reg = -2 * threshold_dbm;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -508,8 +528,7 @@ int sx1261_lbt_start(lgw_lbt_scan_time_t scan_time_us, int8_t threshold_dbm) {
     err = sx1261_reg_w(0x9a, buff, 5);
     CHECK_ERR(err);
 
-    /* Wait for Scan Time before TX trigger request */
-    wait_us((uint16_t)scan_time_us);
+    /* the caller waits for Scan Time before TX trigger request */
 
     DEBUG_PRINTF("SX1261: LBT started: scan time = %uus, threshold = %ddBm\n", (uint16_t)scan_time_us, threshold_dbm);
 
@@ -525,7 +544,7 @@ int sx1261_lbt_stop(void) {
     int err;
     uint8_t buff[16];
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -554,7 +573,7 @@ int sx1261_spectral_scan_start(uint16_t nb_scan) {
     int err;
     uint8_t buff[4]; /* 66 bytes for spectral scan results + 2 bytes register address + 1 dummy byte for reading */
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -579,7 +598,7 @@ int sx1261_spectral_scan_get_results(int8_t rssi_offset, int16_t * levels_dbm, u
     int err, i;
     uint8_t buff[69]; /* 66 bytes for spectral scan results + 2 bytes register address + 1 dummy byte for reading */
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -619,7 +638,7 @@ int sx1261_spectral_scan_status(lgw_spectral_scan_status_t * status) {
     int err;
     uint8_t buff[16];
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     CHECK_NULL(status);
 
@@ -665,7 +684,7 @@ int sx1261_spectral_scan_abort(void) {
     int err;
     uint8_t buff[16];
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
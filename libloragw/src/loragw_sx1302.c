@@ -33,6 +33,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_agc_params.h"
 #include "loragw_cal.h"
 #include "loragw_debug.h"
+#include "crc16.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -69,9 +70,13 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define ARB_MEM_ADDR            0x2000
 
 #define MCU_FW_SIZE             8192 /* size of the firmware IN BYTES (= twice the number of 14b words) */
+#define MCU_FW_CHECK_WIN_NB     16   /* number of windows read back by the fast firmware check */
+#define MCU_FW_CHECK_WIN_SIZE   64   /* size of each window, the windows are read in a single transfer */
 
 #define FW_VERSION_CAL          1 /* Expected version of calibration firmware */
 
+#define ARB_STATS_REG_NB        16   /* ARB debug status registers holding the detects of the 8 channels, then their modem allocations */
+
 #define RSSI_FSK_POLY_0         90.636423 /* polynomiam coefficients to linearize FSK RSSI */
 #define RSSI_FSK_POLY_1         0.420835
 #define RSSI_FSK_POLY_2         0.007129
@@ -121,11 +126,55 @@ const uint8_t ifmod_config[LGW_IF_CHAIN_NB] = LGW_IFMODEM_CONFIG;
 /* Radio calibration firmware */
 #include "cal_fw.var" /* text_cal_sx1257_16_Nov_1 */
 
-/* Buffer to hold RX data */
-rx_buffer_t rx_buffer;
+/* Buffers to hold RX data: packets are parsed from one while the other is filled from the SX1302 */
+static rx_buffer_t rx_buffer_board[LGW_BOARD_NB_MAX][2];
+static uint8_t rx_buffer_cur_board[LGW_BOARD_NB_MAX];
+#define rx_buffer rx_buffer_board[lgw_board_cur][rx_buffer_cur_board[lgw_board_cur]]
+#define rx_buffer_next rx_buffer_board[lgw_board_cur][rx_buffer_cur_board[lgw_board_cur] ^ 1]
+
+static struct lgw_rx_stats_s rx_stats_board[LGW_BOARD_NB_MAX];
+#define rx_stats rx_stats_board[lgw_board_cur]
+
+/* ARB detect and modem allocation counters, accumulated from the 8-bit firmware counters */
+typedef struct arb_stats_s {
+    uint8_t     raw[ARB_STATS_REG_NB];  /*!> firmware counters at the last sample */
+    int64_t     sample_ns;              /*!> host monotonic time of the last sample */
+    struct lgw_arb_stats_s acc;         /*!> counters since the ARB start or the last reset */
+} arb_stats_t;
+
+static arb_stats_t arb_stats_board[LGW_BOARD_NB_MAX];
+#define arb_stats arb_stats_board[lgw_board_cur]
 
 /* Internal timestamp counter */
-timestamp_counter_t counter_us;
+static timestamp_counter_t counter_us_board[LGW_BOARD_NB_MAX];
+#define counter_us counter_us_board[lgw_board_cur]
+
+/* Demodulation parameters of each IF chain, derived once from the configuration for the parsing */
+typedef struct rx_chan_s {
+    uint8_t     ifmod;              /*!> type of modem of the IF chain */
+    uint8_t     rf_chain;           /*!> RF chain the IF chain is connected to */
+    uint32_t    freq_hz;            /*!> center frequency of the channel */
+    int32_t     if_freq_hz;         /*!> IF frequency of the channel, offset from the RF chain frequency */
+    int32_t     if_freq_error;      /*!> error of the IF frequency due to the register resolution */
+    uint8_t     bandwidth;          /*!> bandwidth of the channel */
+    float       freq_offset_lsb;    /*!> value of the frequency offset LSB, in Hz, 0 if the bandwidth is invalid */
+    bool        crc_forced;         /*!> CRC always enabled (LoRa service implicit header) */
+    uint8_t     coderate_forced;    /*!> coding rate of the implicit header, 0 to get it from the packet */
+    uint32_t    datarate;           /*!> FSK datarate */
+    int32_t     ts_correction;      /*!> FSK timestamp correction */
+} rx_chan_t;
+
+static rx_chan_t rx_chan_board[LGW_BOARD_NB_MAX][LGW_IF_CHAIN_NB];
+#define rx_chan rx_chan_board[lgw_board_cur]
+
+#if RX_FIXED_POINT
+/* FSK channel RSSI corrected by the polynomial, in 0.1 dB, indexed by the raw RSSI */
+static int16_t rssi_fsk_lut[256];
+#endif
+
+/* Firmware load check: full read back, or windows moving at each load along with the MCU parity check */
+static bool fw_fast_check = false;
+static uint8_t fw_check_shift = 0;
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
@@ -145,11 +194,36 @@ extern int32_t lgw_sf_getval(int x);
 extern int32_t lgw_bw_getval(int x);
 
 /**
-@brief TODO
-@param TODO
-@return TODO
+@brief Write the modulation settings and the payload of a packet to its TX chain, without triggering it
+@param radio_type the type of radio used by the TX chain
+@param tx_gain the TX gain LUT entry selected for the packet
+@param lwan_public the LoRaWAN syncword selection
+@param context_fsk the FSK configuration, used for FSK syncword
+@param pkt_data the packet to be loaded, preamble may be adjusted to its allowed range
+@param tx_start_delay the TX start delay programmed, in 32MHz clock cycles, needed to trigger the packet
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+@note BULK write mode has to be handled by the caller
+*/
+static int sx1302_tx_load(lgw_radio_type_t radio_type, const struct lgw_tx_gain_s * tx_gain, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data, uint16_t * tx_start_delay);
+
+/**
+@brief Arm the TX trigger of a TX chain on which a packet has been loaded
+@param rf_chain the TX chain to be triggered
+@param tx_mode IMMEDIATE, TIMESTAMPED or ON_GPS
+@param trig_count_us the emission time of the packet, for TIMESTAMPED mode
+@param tx_start_delay the TX start delay returned by sx1302_tx_load
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+@note BULK write mode has to be handled by the caller
+*/
+static int sx1302_tx_trigger(uint8_t rf_chain, uint8_t tx_mode, uint32_t trig_count_us, uint16_t tx_start_delay);
+
+/**
+@brief Read back a firmware written to an MCU memory, and compare it to the image
+@param mem_addr the address of the MCU memory
+@param firmware the image written
+@return LGW_REG_SUCCESS if the memory holds the image, LGW_REG_ERROR otherwise
 */
-void lora_crc16(const char data, int *crc);
+static int sx1302_fw_check(uint16_t mem_addr, const uint8_t * firmware);
 
 /* -------------------------------------------------------------------------- */
 /* --- INTERNAL SHARED VARIABLES -------------------------------------------- */
@@ -189,29 +263,6 @@ int calculate_freq_to_time_drift(uint32_t freq_hz, uint8_t bw, uint16_t * mant,
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-void lora_crc16(const char data, int *crc) {
-    int next = 0;
-    next  =  (((data>>0)&1) ^ ((*crc>>12)&1) ^ ((*crc>> 8)&1)                 )      ;
-    next += ((((data>>1)&1) ^ ((*crc>>13)&1) ^ ((*crc>> 9)&1)                 )<<1 ) ;
-    next += ((((data>>2)&1) ^ ((*crc>>14)&1) ^ ((*crc>>10)&1)                 )<<2 ) ;
-    next += ((((data>>3)&1) ^ ((*crc>>15)&1) ^ ((*crc>>11)&1)                 )<<3 ) ;
-    next += ((((data>>4)&1) ^ ((*crc>>12)&1)                                  )<<4 ) ;
-    next += ((((data>>5)&1) ^ ((*crc>>13)&1) ^ ((*crc>>12)&1) ^ ((*crc>> 8)&1))<<5 ) ;
-    next += ((((data>>6)&1) ^ ((*crc>>14)&1) ^ ((*crc>>13)&1) ^ ((*crc>> 9)&1))<<6 ) ;
-    next += ((((data>>7)&1) ^ ((*crc>>15)&1) ^ ((*crc>>14)&1) ^ ((*crc>>10)&1))<<7 ) ;
-    next += ((((*crc>>0)&1) ^ ((*crc>>15)&1) ^ ((*crc>>11)&1)                 )<<8 ) ;
-    next += ((((*crc>>1)&1) ^ ((*crc>>12)&1)                                  )<<9 ) ;
-    next += ((((*crc>>2)&1) ^ ((*crc>>13)&1)                                  )<<10) ;
-    next += ((((*crc>>3)&1) ^ ((*crc>>14)&1)                                  )<<11) ;
-    next += ((((*crc>>4)&1) ^ ((*crc>>15)&1) ^ ((*crc>>12)&1) ^ ((*crc>> 8)&1))<<12) ;
-    next += ((((*crc>>5)&1) ^ ((*crc>>13)&1) ^ ((*crc>> 9)&1)                 )<<13) ;
-    next += ((((*crc>>6)&1) ^ ((*crc>>14)&1) ^ ((*crc>>10)&1)                 )<<14) ;
-    next += ((((*crc>>7)&1) ^ ((*crc>>15)&1) ^ ((*crc>>11)&1)                 )<<15) ;
-    (*crc) = next;
-}
-
-/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
 int sx1302_config_gpio(void) {
     int err;
 
@@ -237,6 +288,50 @@ int sx1302_config_gpio(void) {
     return LGW_REG_SUCCESS;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sx1302_fw_check(uint16_t mem_addr, const uint8_t * firmware) {
+    uint8_t fw_check[MCU_FW_SIZE];
+    struct lgw_com_rb_s req[MCU_FW_CHECK_WIN_NB];
+    const uint16_t stride = MCU_FW_SIZE / MCU_FW_CHECK_WIN_NB;
+    uint16_t offset;
+    int i;
+
+    if (fw_fast_check == false) {
+        if (lgw_mem_rb(mem_addr, fw_check, MCU_FW_SIZE, false) != LGW_REG_SUCCESS) {
+            return LGW_REG_ERROR;
+        }
+        return (memcmp(firmware, fw_check, MCU_FW_SIZE) == 0) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+    }
+
+    /* one window per stride, the first and last bytes always checked, the others covered over successive loads */
+    for (i = 0; i < MCU_FW_CHECK_WIN_NB; i++) {
+        if (i == 0) {
+            offset = 0;
+        } else if (i == (MCU_FW_CHECK_WIN_NB - 1)) {
+            offset = MCU_FW_SIZE - MCU_FW_CHECK_WIN_SIZE;
+        } else {
+            offset = i * stride + ((fw_check_shift + i) % (stride / MCU_FW_CHECK_WIN_SIZE)) * MCU_FW_CHECK_WIN_SIZE;
+        }
+        req[i].spi_mux_target = LGW_SPI_MUX_TARGET_SX1302;
+        req[i].address = mem_addr + offset;
+        req[i].data = &fw_check[offset];
+        req[i].size = MCU_FW_CHECK_WIN_SIZE;
+    }
+    fw_check_shift += 1;
+    if (lgw_com_rb_multi(req, MCU_FW_CHECK_WIN_NB) != LGW_COM_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+    for (i = 0; i < MCU_FW_CHECK_WIN_NB; i++) {
+        offset = req[i].address - mem_addr;
+        if (memcmp(&firmware[offset], &fw_check[offset], MCU_FW_CHECK_WIN_SIZE) != 0) {
+            return LGW_REG_ERROR;
+        }
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -250,8 +345,11 @@ int sx1302_init(const struct lgw_conf_ftime_s * ftime_context) {
     /* Initialize internal counter */
     timestamp_counter_new(&counter_us);
 
-    /* Initialize RX buffer */
+    /* Initialize RX buffers */
+    rx_buffer_cur_board[lgw_board_cur] = 0;
     rx_buffer_new(&rx_buffer);
+    rx_buffer_new(&rx_buffer_next);
+    memset(&rx_stats, 0, sizeof rx_stats);
 
     /* Configure timestamping mode */
     if (ftime_context->enable == true) {
@@ -331,7 +429,7 @@ int sx1302_get_model_id(sx1302_model_id_t * model_id) {
 int sx1302_update(void) {
     uint32_t inst, pps;
     /* performances variables */
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -460,6 +558,80 @@ int sx1302_radio_reset(uint8_t rf_chain, lgw_radio_type_t type) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_radio_reset_all(struct lgw_conf_rxrf_s * context_rf_chain) {
+    uint16_t reg_radio_rst[LGW_RF_CHAIN_NB];
+    bool sx1250_found = false;
+    int i;
+    int err = LGW_REG_SUCCESS;
+
+    /* Check input parameters */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (context_rf_chain[i].enable == false) {
+            continue;
+        }
+        switch (context_rf_chain[i].type) {
+            case LGW_RADIO_TYPE_SX1250:
+                sx1250_found = true;
+                break;
+            case LGW_RADIO_TYPE_SX1255:
+            case LGW_RADIO_TYPE_SX1257:
+                break;
+            default:
+                DEBUG_MSG("ERROR: invalid radio type\n");
+                return LGW_REG_ERROR;
+        }
+        reg_radio_rst[i] = REG_SELECT(i, SX1302_REG_AGC_MCU_RF_EN_A_RADIO_RST, SX1302_REG_AGC_MCU_RF_EN_B_RADIO_RST);
+    }
+
+    /* Each step is sent in a single transfer for all radios, the delays are shared (USB only).
+       A flush restores the single write mode, the bulk mode is set again for each step. */
+    err |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+
+    /* Switch to SPI clock before reseting the radios, enable them and hold them in reset */
+    err |= lgw_reg_w(SX1302_REG_COMMON_CTRL0_CLK32_RIF_CTRL, 0x00);
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (context_rf_chain[i].enable == true) {
+            err |= lgw_reg_w(REG_SELECT(i, SX1302_REG_AGC_MCU_RF_EN_A_RADIO_EN, SX1302_REG_AGC_MCU_RF_EN_B_RADIO_EN), 0x01);
+            err |= lgw_reg_w(reg_radio_rst[i], 0x01);
+        }
+    }
+    err |= lgw_com_flush();
+    wait_ms(500);
+
+    /* Release the resets */
+    err |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (context_rf_chain[i].enable == true) {
+            err |= lgw_reg_w(reg_radio_rst[i], 0x00);
+        }
+    }
+    err |= lgw_com_flush();
+    wait_ms(10);
+
+    /* sx1250 radios are started by a last reset pulse */
+    if (sx1250_found == true) {
+        err |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+        for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+            if ((context_rf_chain[i].enable == true) && (context_rf_chain[i].type == LGW_RADIO_TYPE_SX1250)) {
+                err |= lgw_reg_w(reg_radio_rst[i], 0x01);
+            }
+        }
+        err |= lgw_com_flush();
+        wait_ms(10); /* wait for auto calibration to complete */
+    }
+
+    /* Check if something went wrong */
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to reset the radios\n");
+        return LGW_REG_ERROR;
+    }
+    DEBUG_MSG("INFO: reset of all radios done\n");
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_radio_set_mode(uint8_t rf_chain, lgw_radio_type_t type) {
     uint16_t reg;
     int err;
@@ -503,19 +675,20 @@ int sx1302_radio_host_ctrl(bool host_ctrl) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc, struct lgw_tx_gain_lut_s * txgain_lut) {
+int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc, struct lgw_tx_gain_lut_s * txgain_lut, const float * temperature) {
     int i;
     int err = LGW_REG_SUCCESS;
+    uint64_t eui = 0;
+    bool use_cache;
 
     /* -- Reset radios */
+    err = sx1302_radio_reset_all(context_rf_chain);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to reset radios\n");
+        return LGW_REG_ERROR;
+    }
     for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
         if (context_rf_chain[i].enable == true) {
-            err = sx1302_radio_reset(i, context_rf_chain[i].type);
-            if (err != LGW_REG_SUCCESS) {
-                printf("ERROR: failed to reset radio %d\n", i);
-                return LGW_REG_ERROR;
-            }
-
             err = sx1302_radio_set_mode(i, context_rf_chain[i].type);
             if (err != LGW_REG_SUCCESS) {
                 printf("ERROR: failed to set radio %d mode\n", i);
@@ -537,6 +710,13 @@ int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t cl
     /* -- Start calibration */
     if ((context_rf_chain[clksrc].type == LGW_RADIO_TYPE_SX1257) ||
         (context_rf_chain[clksrc].type == LGW_RADIO_TYPE_SX1255)) {
+        /* Skip the calibration if it has already been done in the same conditions */
+        use_cache = (sx1302_cal_cache_path() != NULL) && (sx1302_get_eui(&eui) == LGW_REG_SUCCESS);
+        if (use_cache && (sx1302_cal_cache_load(eui, temperature, context_rf_chain, txgain_lut) == LGW_HAL_SUCCESS)) {
+            err |= lgw_reg_w(SX1302_REG_AGC_MCU_CTRL_FORCE_HOST_FE_CTRL, 0);
+            return err;
+        }
+
         DEBUG_MSG("Loading CAL fw for sx125x\n");
         err = sx1302_agc_load_firmware(cal_firmware_sx125x);
         if (err != LGW_REG_SUCCESS) {
@@ -550,6 +730,9 @@ int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t cl
             sx1302_radio_reset(1, context_rf_chain[1].type);
             return LGW_REG_ERROR;
         }
+        if (use_cache && (sx1302_cal_cache_store(eui, temperature, context_rf_chain) != LGW_HAL_SUCCESS)) {
+            printf("WARNING: failed to save radio calibration to cache\n");
+        }
     } else {
         DEBUG_MSG("Calibrating sx1250 radios\n");
         for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
@@ -712,6 +895,56 @@ int sx1302_channelizer_configure(struct lgw_conf_rxif_s * if_cfg, bool fix_gain)
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_channelizer_update(struct lgw_conf_rxif_s * if_cfg, uint16_t if_mask) {
+    /* IF frequency registers of each IF chain: MSB, LSB */
+    static const uint16_t if_freq_reg[LGW_IF_CHAIN_NB][2] = {
+        { SX1302_REG_RX_TOP_FREQ_0_MSB_IF_FREQ_0, SX1302_REG_RX_TOP_FREQ_0_LSB_IF_FREQ_0 },
+        { SX1302_REG_RX_TOP_FREQ_1_MSB_IF_FREQ_1, SX1302_REG_RX_TOP_FREQ_1_LSB_IF_FREQ_1 },
+        { SX1302_REG_RX_TOP_FREQ_2_MSB_IF_FREQ_2, SX1302_REG_RX_TOP_FREQ_2_LSB_IF_FREQ_2 },
+        { SX1302_REG_RX_TOP_FREQ_3_MSB_IF_FREQ_3, SX1302_REG_RX_TOP_FREQ_3_LSB_IF_FREQ_3 },
+        { SX1302_REG_RX_TOP_FREQ_4_MSB_IF_FREQ_4, SX1302_REG_RX_TOP_FREQ_4_LSB_IF_FREQ_4 },
+        { SX1302_REG_RX_TOP_FREQ_5_MSB_IF_FREQ_5, SX1302_REG_RX_TOP_FREQ_5_LSB_IF_FREQ_5 },
+        { SX1302_REG_RX_TOP_FREQ_6_MSB_IF_FREQ_6, SX1302_REG_RX_TOP_FREQ_6_LSB_IF_FREQ_6 },
+        { SX1302_REG_RX_TOP_FREQ_7_MSB_IF_FREQ_7, SX1302_REG_RX_TOP_FREQ_7_LSB_IF_FREQ_7 },
+        { SX1302_REG_RX_TOP_LORA_SERVICE_FSK_LORA_SERVICE_FREQ_MSB_IF_FREQ_0, SX1302_REG_RX_TOP_LORA_SERVICE_FSK_LORA_SERVICE_FREQ_LSB_IF_FREQ_0 },
+        { SX1302_REG_RX_TOP_LORA_SERVICE_FSK_FSK_FREQ_MSB_IF_FREQ_0, SX1302_REG_RX_TOP_LORA_SERVICE_FSK_FSK_FREQ_LSB_IF_FREQ_0 }
+    };
+    int32_t if_freq;
+    uint8_t channels_mask = 0x00;
+    int i;
+    int err = LGW_REG_SUCCESS;
+
+    /* Check input parameters */
+    CHECK_NULL(if_cfg);
+
+    /* Radio selection, unchanged values are not written again */
+    for (i = 0; i < LGW_MULTI_NB; i++) {
+        channels_mask |= (if_cfg[i].rf_chain << i);
+    }
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_RADIO_SELECT_RADIO_SELECT, channels_mask);
+    if ((if_mask & (1 << 8)) != 0) {
+        err |= lgw_reg_w(SX1302_REG_RX_TOP_LORA_SERVICE_FSK_LORA_SERVICE_RADIO_SEL_RADIO_SELECT, if_cfg[8].rf_chain);
+    }
+    if ((if_mask & (1 << 9)) != 0) {
+        err |= lgw_reg_w(SX1302_REG_RX_TOP_LORA_SERVICE_FSK_FSK_CFG_3_RADIO_SELECT, if_cfg[9].rf_chain);
+    }
+
+    /* IF frequencies of the selected channels */
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        if ((if_mask & (1 << i)) == 0) {
+            continue;
+        }
+        DEBUG_PRINTF("IF chain %d: IF frequency %d Hz\n", i, if_cfg[i].freq_hz);
+        if_freq = IF_HZ_TO_REG(if_cfg[i].freq_hz);
+        err |= lgw_reg_w(if_freq_reg[i][0], (if_freq >> 8) & 0x0000001F);
+        err |= lgw_reg_w(if_freq_reg[i][1], (if_freq >> 0) & 0x000000FF);
+    }
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_fsk_configure(struct lgw_conf_rxif_s * cfg) {
     uint64_t fsk_sync_word_reg;
     uint32_t fsk_br_reg;
@@ -757,8 +990,7 @@ int sx1302_fsk_configure(struct lgw_conf_rxif_s * cfg) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int sx1302_lora_correlator_configure(struct lgw_conf_rxif_s * if_cfg, struct lgw_conf_demod_s * demod_cfg) {
-    int i, err = LGW_REG_SUCCESS;
-    uint8_t channels_mask = 0x00;
+    int err = LGW_REG_SUCCESS;
 
     /* Check input parameters */
     CHECK_NULL(if_cfg);
@@ -806,6 +1038,28 @@ int sx1302_lora_correlator_configure(struct lgw_conf_rxif_s * if_cfg, struct lgw
     err |= lgw_reg_w(SX1302_REG_RX_TOP_CORRELATOR_ENABLE_ONLY_FIRST_DET_EDGE_ENABLE_ONLY_FIRST_DET_EDGE, 0xFF);
     err |= lgw_reg_w(SX1302_REG_RX_TOP_CORRELATOR_ENABLE_ACC_CLEAR_ENABLE_CORR_ACC_CLEAR, 0xFF);
 
+    /* Enable the selected spreading factors and channels */
+    err |= sx1302_lora_correlator_enable(if_cfg, demod_cfg);
+
+    /* For debug: get packets with sync_error and header_error in FIFO */
+#if 0
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_RX_BUFFER_STORE_SYNC_FAIL_META, 0x01);
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_RX_BUFFER_STORE_HEADER_ERR_META, 0x01);
+#endif
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_lora_correlator_enable(struct lgw_conf_rxif_s * if_cfg, struct lgw_conf_demod_s * demod_cfg) {
+    int i, err = LGW_REG_SUCCESS;
+    uint8_t channels_mask = 0x00;
+
+    /* Check input parameters */
+    CHECK_NULL(if_cfg);
+    CHECK_NULL(demod_cfg);
+
     /* Enabled selected spreading factors */
     err |= lgw_reg_w(SX1302_REG_RX_TOP_CORRELATOR_SF_EN_CORR_SF_EN, demod_cfg->multisf_datarate);
     DEBUG_PRINTF("INFO: LoRa multi-SF correlator SF enable mask: 0x%02X\n", demod_cfg->multisf_datarate);
@@ -818,12 +1072,6 @@ int sx1302_lora_correlator_configure(struct lgw_conf_rxif_s * if_cfg, struct lgw
     err |= lgw_reg_w(SX1302_REG_RX_TOP_CORR_CLOCK_ENABLE_CLK_EN, channels_mask);
     err |= lgw_reg_w(SX1302_REG_RX_TOP_CORRELATOR_EN_CORR_EN, channels_mask);
 
-    /* For debug: get packets with sync_error and header_error in FIFO */
-#if 0
-    err |= lgw_reg_w(SX1302_REG_RX_TOP_RX_BUFFER_STORE_SYNC_FAIL_META, 0x01);
-    err |= lgw_reg_w(SX1302_REG_RX_TOP_RX_BUFFER_STORE_HEADER_ERR_META, 0x01);
-#endif
-
     return err;
 }
 
@@ -1108,6 +1356,17 @@ int sx1302_modem_enable(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_modem_select(bool lora_service, bool fsk) {
+    int err = LGW_REG_SUCCESS;
+
+    err |= lgw_reg_w(SX1302_REG_COMMON_GEN_MBWSSF_MODEM_ENABLE, (lora_service == true) ? 0x01 : 0x00);
+    err |= lgw_reg_w(SX1302_REG_COMMON_GEN_FSK_MODEM_ENABLE, (fsk == true) ? 0x01 : 0x00);
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_lora_syncword(bool public, uint8_t lora_service_sf) {
     int err = LGW_REG_SUCCESS;
 
@@ -1143,14 +1402,33 @@ int sx1302_lora_syncword(bool public, uint8_t lora_service_sf) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-uint32_t sx1302_timestamp_counter(bool pps) {
-    uint32_t inst_cnt, pps_cnt;
-    timestamp_counter_get(&counter_us, &inst_cnt, &pps_cnt);
+uint64_t sx1302_timestamp_counter(bool pps) {
+    uint64_t inst_cnt, pps_cnt;
+    timestamp_counter_get64(&counter_us, &inst_cnt, &pps_cnt);
     return ((pps == true) ? pps_cnt : inst_cnt);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+uint64_t sx1302_timestamp_counter_estimate(uint32_t max_age_us) {
+    uint64_t inst_cnt;
+
+    if (timestamp_counter_estimate64(&counter_us, max_age_us, &inst_cnt) != 0) {
+        inst_cnt = sx1302_timestamp_counter(false);
+    }
+    return inst_cnt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_timestamp_counter_snapshot(uint32_t max_age_us, uint64_t * inst) {
+    CHECK_NULL(inst);
+
+    return (timestamp_counter_estimate64(&counter_us, max_age_us, inst) == 0) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_gps_enable(bool enable) {
     int err = LGW_REG_SUCCESS;
 
@@ -1166,9 +1444,14 @@ int sx1302_gps_enable(bool enable) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+void sx1302_fw_set_fast_check(bool enable) {
+    fw_fast_check = enable;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_agc_load_firmware(const uint8_t *firmware) {
     int32_t val;
-    uint8_t fw_check[MCU_FW_SIZE];
     int err = LGW_REG_SUCCESS;
 
     /* Take control over AGC MCU */
@@ -1180,8 +1463,7 @@ int sx1302_agc_load_firmware(const uint8_t *firmware) {
     err |= lgw_mem_wb(AGC_MEM_ADDR, firmware, MCU_FW_SIZE);
 
     /* Read back and check */
-    err |= lgw_mem_rb(AGC_MEM_ADDR, fw_check, MCU_FW_SIZE, false);
-    if (memcmp(firmware, fw_check, sizeof fw_check) != 0) {
+    if (sx1302_fw_check(AGC_MEM_ADDR, firmware) != LGW_REG_SUCCESS) {
         printf("ERROR: AGC fw read/write check failed\n");
         return LGW_REG_ERROR;
     }
@@ -1629,7 +1911,6 @@ int sx1302_agc_start(uint8_t version, lgw_radio_type_t radio_type, uint8_t ana_g
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int sx1302_arb_load_firmware(const uint8_t *firmware) {
-    uint8_t fw_check[MCU_FW_SIZE];
     int32_t val;
     int err = LGW_REG_SUCCESS;
 
@@ -1642,8 +1923,7 @@ int sx1302_arb_load_firmware(const uint8_t *firmware) {
     err |= lgw_mem_wb(ARB_MEM_ADDR, &firmware[0], MCU_FW_SIZE);
 
     /* Read back and check */
-    err |= lgw_mem_rb(ARB_MEM_ADDR, fw_check, MCU_FW_SIZE, false);
-    if (memcmp(firmware, fw_check, sizeof fw_check) != 0) {
+    if (sx1302_fw_check(ARB_MEM_ADDR, firmware) != LGW_REG_SUCCESS) {
         printf("ERROR: ARB fw read/write check failed\n");
         return LGW_REG_ERROR;
     }
@@ -1780,34 +2060,68 @@ uint8_t sx1302_arb_get_debug_stats_alloc(uint8_t channel) {
 
 void sx1302_arb_print_debug_stats(void) {
     int i;
-    uint8_t nb_detect;
-    uint8_t nb_alloc;
-    int nb_detect_total = 0;
-    int nb_alloc_total = 0;
+    uint8_t buff[ARB_STATS_REG_NB];
 
-    /* Get number of detects for all channels */
-    nb_detect_total = 0;
+    /* Get number of detects and modem allocations for all channels, in one transfer */
+    if (lgw_reg_rb(SX1302_REG_ARB_MCU_ARB_DEBUG_STS_0_ARB_DEBUG_STS_0, buff, sizeof buff) != LGW_REG_SUCCESS) {
+        return;
+    }
     DEBUG_MSG("ARB: nb_detect: [");
-    for (i = 0; i < 8; i++) {
-        nb_detect = sx1302_arb_get_debug_stats_detect(i);
-        DEBUG_PRINTF("%u ", nb_detect);
-        nb_detect_total += nb_detect;
+    for (i = 0; i < LGW_MULTI_NB; i++) {
+        DEBUG_PRINTF("%u ", buff[i]);
     }
     DEBUG_MSG("]\n");
-
-    /* Get number of modem allocation for all channels */
-    nb_alloc_total = 0;
     DEBUG_MSG("ARB: nb_alloc:  [");
-    for (i = 0; i < 8; i++) {
-        nb_alloc = sx1302_arb_get_debug_stats_alloc(i);
-        DEBUG_PRINTF("%u ", nb_alloc);
-        nb_alloc_total += nb_alloc;
+    for (i = 0; i < LGW_MULTI_NB; i++) {
+        DEBUG_PRINTF("%u ", buff[LGW_MULTI_NB + i]);
     }
     DEBUG_MSG("]\n");
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_arb_stats_update(int64_t now_ns, uint32_t period_ms) {
+    uint8_t buff[ARB_STATS_REG_NB];
+    int i;
+
+    if ((period_ms > 0) && ((now_ns - arb_stats.sample_ns) < ((int64_t)period_ms * 1000000LL))) {
+        return LGW_REG_SUCCESS;
+    }
+
+    /* all the counters in one transfer, they wrap after 255 events */
+    if (lgw_reg_rb(SX1302_REG_ARB_MCU_ARB_DEBUG_STS_0_ARB_DEBUG_STS_0, buff, sizeof buff) != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to read ARB debug statistics\n");
+        return LGW_REG_ERROR;
+    }
+    for (i = 0; i < LGW_MULTI_NB; i++) {
+        arb_stats.acc.nb_detect[i] += (uint8_t)(buff[i] - arb_stats.raw[i]);
+        arb_stats.acc.nb_alloc[i] += (uint8_t)(buff[LGW_MULTI_NB + i] - arb_stats.raw[LGW_MULTI_NB + i]);
+    }
+    memcpy(arb_stats.raw, buff, sizeof buff);
+    arb_stats.sample_ns = now_ns;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_arb_get_stats(struct lgw_arb_stats_s * stats, bool reset) {
+    CHECK_NULL(stats);
+
+    if (sx1302_arb_stats_update(time_monotonic_ns(), 0) != LGW_REG_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+    *stats = arb_stats.acc;
+    if (reset == true) {
+        memset(&arb_stats.acc.nb_detect, 0, sizeof arb_stats.acc.nb_detect);
+        memset(&arb_stats.acc.nb_alloc, 0, sizeof arb_stats.acc.nb_alloc);
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_arb_start(uint8_t version, const struct lgw_conf_ftime_s * ftime_context) {
     uint8_t val;
 
@@ -1824,6 +2138,8 @@ int sx1302_arb_start(uint8_t version, const struct lgw_conf_ftime_s * ftime_cont
 
     /* Enable/disable ARB detect/modem alloc stats for the specified SF */
     sx1302_arb_set_debug_stats(true, DR_LORA_SF7);
+    memset(&arb_stats, 0, sizeof arb_stats);
+    arb_stats.acc.sf = DR_LORA_SF7;
 
     /* Enable/Disable double demod for different timing set (best timestamp / best demodulation) - 1 bit per SF (LSB=SF5, MSB=SF12) => 0:Disable 1:Enable */
     if (ftime_context->enable == false) {
@@ -1853,6 +2169,13 @@ int sx1302_arb_start(uint8_t version, const struct lgw_conf_ftime_s * ftime_cont
 
     DEBUG_MSG("ARB: started\n");
 
+    /* the counters are accumulated from their values once started */
+    if (sx1302_arb_stats_update(time_monotonic_ns(), 0) != LGW_REG_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+    memset(&arb_stats.acc.nb_detect, 0, sizeof arb_stats.acc.nb_detect);
+    memset(&arb_stats.acc.nb_alloc, 0, sizeof arb_stats.acc.nb_alloc);
+
     return LGW_REG_SUCCESS;
 }
 
@@ -1860,28 +2183,67 @@ int sx1302_arb_start(uint8_t version, const struct lgw_conf_ftime_s * ftime_cont
 
 int sx1302_fetch(uint8_t * nb_pkt) {
     int err;
-    struct timeval tm;
+    rx_buffer_t * target;
+    rx_buffer_t * tail;
+    uint16_t tail_index, tail_size;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
 
-    /* Fetch packets from sx1302 if no more left in RX buffer */
+    /* Parse the packets drained ahead once the current buffer is empty */
+    if ((rx_buffer.buffer_pkt_nb == 0) && (rx_buffer_next.buffer_pkt_nb > 0)) {
+        rx_buffer_cur_board[lgw_board_cur] ^= 1;
+    }
+
+    /* Fetch packets from sx1302 in the current buffer if empty, or ahead in the other one if free */
     if (rx_buffer.buffer_pkt_nb == 0) {
-        /* Initialize RX buffer */
-        err = rx_buffer_new(&rx_buffer);
+        target = &rx_buffer;
+    } else if (rx_buffer_next.buffer_pkt_nb == 0) {
+        target = &rx_buffer_next;
+    } else {
+        target = NULL;
+    }
+    if (target != NULL) {
+        /* Initialize RX buffer, with the packet left incomplete by the previous fetch */
+        tail = (rx_buffer.tail_size > 0) ? &rx_buffer : &rx_buffer_next;
+        tail_index = tail->tail_index; /* cleared by rx_buffer_new() when the target holds the tail */
+        tail_size = tail->tail_size;
+        err = rx_buffer_new(target);
+        if (err == LGW_REG_SUCCESS) {
+            tail->tail_index = tail_index;
+            tail->tail_size = tail_size;
+            err = rx_buffer_carry(target, tail);
+        }
         if (err != LGW_REG_SUCCESS) {
             printf("ERROR: Failed to initialize RX buffer\n");
             return LGW_REG_ERROR;
         }
 
         /* Fetch RX buffer if any data available */
-        err = rx_buffer_fetch(&rx_buffer);
+        err = rx_buffer_fetch(target);
         if (err != LGW_REG_SUCCESS) {
             printf("ERROR: Failed to fetch RX buffer\n");
             return LGW_REG_ERROR;
         }
+
+        /* data read but no packet: discarded by the sanity checks */
+        if (target->fetch_size > 0) {
+            rx_stats.nb_fetch += 1;
+            rx_stats.nb_byte += target->fetch_size;
+            if (target->chip_size > rx_stats.fill_max) {
+                rx_stats.fill_max = target->chip_size;
+            }
+            rx_stats.fill_hist[MIN(target->chip_size / LGW_RX_FILL_STEP, LGW_RX_FILL_HIST_NB - 1)] += 1;
+            if (target->chip_size > target->fetch_size) {
+                rx_stats.nb_split += 1;
+            }
+            if ((target->buffer_pkt_nb == 0) && (target->tail_size == 0)) {
+                rx_stats.nb_discard += 1;
+            }
+        }
     } else {
-        printf("Note: remaining %u packets in RX buffer, do not fetch sx1302 yet...\n", rx_buffer.buffer_pkt_nb);
+        printf("Note: remaining %u packets in RX buffers, do not fetch sx1302 yet...\n", rx_buffer.buffer_pkt_nb + rx_buffer_next.buffer_pkt_nb);
     }
 
     /* Return the number of packet fetched */
@@ -1894,17 +2256,110 @@ int sx1302_fetch(uint8_t * nb_pkt) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_rx_pending(bool * pending) {
+    int err;
+    uint8_t buff[2];
+
+    CHECK_NULL(pending);
+
+    /* Packets left from a previous fetch do not need any bus access */
+    if ((rx_buffer.buffer_pkt_nb > 0) || (rx_buffer_next.buffer_pkt_nb > 0)) {
+        *pending = true;
+        return LGW_REG_SUCCESS;
+    }
+
+    /* A single read is enough here: only a non-zero value matters, not the exact byte count */
+    err = lgw_reg_hot_rb(LGW_REG_HOT(SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES), buff, sizeof buff);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: Failed to read RX buffer fill level\n");
+        return LGW_REG_ERROR;
+    }
+    *pending = (((buff[0] << 8) | buff[1]) > 0);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_parse_configure(lgw_context_t * context) {
+    int i;
+    rx_chan_t * c;
+    struct lgw_conf_rxif_s * if_cfg;
+
+    CHECK_NULL(context);
+
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        c = &rx_chan[i];
+        if_cfg = &context->if_chain_cfg[i];
+        memset(c, 0, sizeof *c);
+
+        c->ifmod = ifmod_config[i];
+        c->rf_chain = (uint8_t)if_cfg->rf_chain;
+        if (c->rf_chain < LGW_RF_CHAIN_NB) {
+            c->freq_hz = (uint32_t)((int32_t)context->rf_chain_cfg[c->rf_chain].freq_hz + if_cfg->freq_hz);
+        }
+
+        /* The IF frequency set in the registers, is the offset from the zero IF.
+        When the channel IF frequency has been configured, a precision error may have been introduced
+        due to the register precision. The error corresponds to how many Hz are missing to get to actual 0 IF:
+            - For a channel set to IF 400000Hz
+            - The IF frequency register will actually be set to 399902Hz due to its resolution
+            - This means that the modem, to shift to 0 IF, will apply -399902, instead of -400000.
+            - This means that the modem will be centered +98hz above the real 0 IF
+            - As the freq_offset given is supposed to be relative to the 0 IF, this resolution error is added to it */
+        c->if_freq_hz = if_cfg->freq_hz;
+        c->if_freq_error = if_cfg->freq_hz - (IF_HZ_TO_REG(if_cfg->freq_hz) * 15625 / 32);
+
+        switch (c->ifmod) {
+            case IF_LORA_MULTI:
+                c->bandwidth = BW_125KHZ; /* fixed in hardware */
+                break;
+            case IF_LORA_STD:
+                c->bandwidth = context->lora_service_cfg.bandwidth;
+                c->crc_forced = context->lora_service_cfg.implicit_crc_en;
+                if (context->lora_service_cfg.implicit_hdr == true) {
+                    c->coderate_forced = context->lora_service_cfg.implicit_coderate;
+                }
+                break;
+            case IF_FSK_STD:
+                c->bandwidth = context->fsk_cfg.bandwidth;
+                c->datarate = context->fsk_cfg.datarate;
+                if (c->datarate != 0) {
+                    c->ts_correction = ((uint32_t)680000 / c->datarate) - 20;
+                }
+                break;
+            default:
+                break;
+        }
+
+        switch (c->bandwidth) {
+            case BW_125KHZ: c->freq_offset_lsb = FREQ_OFFSET_LSB_125KHZ; break;
+            case BW_250KHZ: c->freq_offset_lsb = FREQ_OFFSET_LSB_250KHZ; break;
+            case BW_500KHZ: c->freq_offset_lsb = FREQ_OFFSET_LSB_500KHZ; break;
+            default: c->freq_offset_lsb = 0; break;
+        }
+    }
+
+#if RX_FIXED_POINT
+    for (i = 0; i < 256; i++) {
+        rssi_fsk_lut[i] = (int16_t)lround((RSSI_FSK_POLY_0 + RSSI_FSK_POLY_1 * i + RSSI_FSK_POLY_2 * pow(i, 2) + RSSI_FSK_POLY_3 * pow(i, 3)) * 10);
+    }
+#endif
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
     int err;
-    int ifmod; /* type of if_chain/modem a packet was received by */
-    int32_t if_freq_hz;
-    int32_t if_freq_error;
+    const rx_chan_t * chan; /* IF chain/modem a packet was received by */
     double pkt_freq_error;
     uint16_t payload_crc16_calc;
     uint8_t cr;
     int32_t timestamp_correction;
     rx_packet_t pkt;
-    struct timeval tm;
+    int64_t tm;
 
     /* Record function start time */
     _meas_time_start(&tm);
@@ -1924,13 +2379,14 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
     err = rx_buffer_pop(&rx_buffer, &pkt);
     if (err == LGW_REG_WARNING) {
         rx_buffer_del(&rx_buffer); /* clear the buffer */
+        rx_stats.nb_discard += 1;
         return err;
     } else if (err == LGW_REG_ERROR) {
         return err;
     }
 
     /* copy payload to result struct */
-    memcpy((void *)p->payload, (void *)(&(pkt.payload)), pkt.rxbytenb_modem);
+    memcpy((void *)p->payload, (const void *)pkt.payload, pkt.rxbytenb_modem);
     p->size = pkt.rxbytenb_modem;
 
     /* process metadata */
@@ -1940,25 +2396,29 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         DEBUG_PRINTF("WARNING: %u NOT A VALID IF_CHAIN NUMBER, ABORTING\n", p->if_chain);
         return LGW_REG_ERROR;
     }
-    ifmod = ifmod_config[p->if_chain];
-    DEBUG_PRINTF("[%d 0x%02X]\n", p->if_chain, ifmod);
+    chan = &rx_chan[p->if_chain];
+    DEBUG_PRINTF("[%d 0x%02X]\n", p->if_chain, chan->ifmod);
 
-    p->rf_chain = (uint8_t)context->if_chain_cfg[p->if_chain].rf_chain;
+    p->rf_chain = chan->rf_chain;
 
     /* Get the frequency for the channel configuration */
-    p->freq_hz = (uint32_t)((int32_t)context->rf_chain_cfg[p->rf_chain].freq_hz + context->if_chain_cfg[p->if_chain].freq_hz);
+    p->freq_hz = chan->freq_hz;
 
     /* Get signal strength : offset and temperature compensation will be applied later */
+    p->rssic_x10 = pkt.rssi_chan_avg * 10;
+    p->rssis_x10 = pkt.rssi_signal_avg * 10;
+#if !RX_FIXED_POINT
     p->rssic = (float)(pkt.rssi_chan_avg);
     p->rssis = (float)(pkt.rssi_signal_avg);
+#endif
 
     /* Get modulation metadata */
-    if ((ifmod == IF_LORA_MULTI) || (ifmod == IF_LORA_STD)) {
+    if ((chan->ifmod == IF_LORA_MULTI) || (chan->ifmod == IF_LORA_STD)) {
         DEBUG_PRINTF("Note: LoRa packet (modem %u chan %u)\n", p->modem_id, p->if_chain);
         p->modulation = MOD_LORA;
 
         /* Get CRC status */
-        if (pkt.crc_en || ((ifmod == IF_LORA_STD) && (context->lora_service_cfg.implicit_crc_en == true))) {
+        if (pkt.crc_en || chan->crc_forced) {
             /* CRC enabled */
             if (pkt.payload_crc_error) {
                 p->status = STAT_CRC_BAD;
@@ -1985,44 +2445,26 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
             p->status = STAT_NO_CRC;
         }
 
-#if 0
-        int i;
-        /* FOR DEBUG: Check data integrity for known devices (debug context) */
-        if (p->status == STAT_CRC_OK || p->status == STAT_NO_CRC) {
-            /*  We compare the received payload with predefined ones to ensure that the payload content is what we expect.
-                4 bytes: ID to identify the payload
-                4 bytes: packet counter used to initialize the seed for pseudo-random generation
-                x bytes: pseudo-random payload
-            */
-            int res;
-            for (i = 0; i < context->debug_cfg.nb_ref_payload; i++) {
-                res = dbg_check_payload(&(context->debug_cfg), log_file, p->payload, p->size, i, pkt.rx_rate_sf);
-                if (res == -1) {
-                    printf("ERROR: 0x%08X payload error\n", context->debug_cfg.ref_payload[i].id);
-                    if (log_file != NULL) {
-                        fprintf(log_file, "ERROR: 0x%08X payload error\n", context->debug_cfg.ref_payload[i].id);
-                        dbg_log_buffer_to_file(log_file, rx_buffer.buffer, rx_buffer.buffer_size);
-                        dbg_log_payload_diff_to_file(log_file, p->payload, context->debug_cfg.ref_payload[i].payload, p->size);
-                    }
-                    return LGW_REG_ERROR;
-                } else if (res == 1) {
-                    DEBUG_PRINTF("0x%08X payload matches\n", context->debug_cfg.ref_payload[i].id);
-                } else {
-                    /* Do nothing */
-                }
+        /* FOR DEBUG: Check data integrity for known devices (debug context)
+            We compare the received payload with predefined ones to ensure that the payload content is what we expect.
+            4 bytes: ID to identify the payload
+            4 bytes: packet counter used to initialize the seed for pseudo-random generation
+            x bytes: pseudo-random payload
+        */
+        if ((context->debug_cfg.nb_ref_payload > 0) && ((p->status == STAT_CRC_OK) || (p->status == STAT_NO_CRC))) {
+            if (dbg_per_check(&(context->debug_cfg), p->payload, p->size, pkt.rx_rate_sf) < 0) {
+                DEBUG_PRINTF("payload error (SF%u, size:%u)\n", pkt.rx_rate_sf, p->size);
             }
         }
-#endif
 
-        /* Get SNR - converted from 0.25dB step to dB */
+        /* Get SNR - converted from 0.25dB step to dB, rounded half away from zero in 0.1 dB */
+        p->snr_x10 = (pkt.snr_average * 10 + ((pkt.snr_average < 0) ? -2 : 2)) / 4;
+#if !RX_FIXED_POINT
         p->snr = (float)(pkt.snr_average) / 4;
+#endif
 
         /* Get bandwidth */
-        if (ifmod == IF_LORA_MULTI) {
-            p->bandwidth = BW_125KHZ; /* fixed in hardware */
-        } else {
-            p->bandwidth = context->lora_service_cfg.bandwidth; /* get the parameter from the config variable */
-        }
+        p->bandwidth = chan->bandwidth;
 
         /* Get datarate */
         switch (pkt.rx_rate_sf) {
@@ -2038,11 +2480,7 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         }
 
         /* Get coding rate */
-        if ((ifmod == IF_LORA_MULTI) || (context->lora_service_cfg.implicit_hdr == false)) {
-            cr = pkt.coding_rate;
-        } else {
-            cr = context->lora_service_cfg.implicit_coderate;
-        }
+        cr = (chan->coderate_forced == 0) ? pkt.coding_rate : chan->coderate_forced;
         switch (cr) {
             case 1: p->coderate = CR_LORA_4_5; break;
             case 2: p->coderate = CR_LORA_4_6; break;
@@ -2051,36 +2489,14 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
             default: p->coderate = CR_UNDEFINED;
         }
 
-        /* Get frequency offset in Hz depending on bandwidth */
-        switch (p->bandwidth) {
-            case BW_125KHZ:
-                p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * FREQ_OFFSET_LSB_125KHZ);
-                break;
-            case BW_250KHZ:
-                p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * FREQ_OFFSET_LSB_250KHZ);
-                break;
-            case BW_500KHZ:
-                p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * FREQ_OFFSET_LSB_500KHZ);
-                break;
-            default:
-                p->freq_offset = 0;
-                printf("Invalid frequency offset\n");
-                break;
+        /* Get frequency offset in Hz depending on bandwidth, adjusted with the channel IF frequency error */
+        if (chan->freq_offset_lsb == 0) {
+            p->freq_offset = 0;
+            printf("Invalid frequency offset\n");
+        } else {
+            p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * chan->freq_offset_lsb);
         }
-
-        /* Adjust the frequency offset with channel IF frequency error:
-        When the channel IF frequency has been configured, a precision error may have been introduced
-        due to the register precision. We calculate this error here, and adjust the returned frequency error
-        accordingly. */
-        if_freq_hz = context->if_chain_cfg[p->if_chain].freq_hz; /* The IF frequency set in the registers, is the offset from the zero IF. */
-        if_freq_error = if_freq_hz - (IF_HZ_TO_REG(if_freq_hz) * 15625 / 32); /* The error corresponds to how many Hz are missing to get to actual 0 IF. */
-        /* Example to better understand what we get here:
-            - For a channel set to IF 400000Hz
-            - The IF frequency register will actually be set to 399902Hz due to its resolution
-            - This means that the modem, to shift to 0 IF, will apply -399902, instead of -400000.
-            - This means that the modem will be centered +98hz above the real 0 IF
-            - As the freq_offset given is supposed to be relative to the 0 IF, we add this resolution error to it */
-        p->freq_offset += if_freq_error;
+        p->freq_offset += chan->if_freq_error;
 
         /* Get timestamp correction to be applied to count_us */
         timestamp_correction = timestamp_counter_correction(context, p->bandwidth, p->datarate, p->coderate, pkt.crc_en, pkt.rxbytenb_modem, RX_DFT_PEAK_MODE_AUTO);
@@ -2093,12 +2509,12 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
             pkt_freq_error = ((double)(p->freq_hz + p->freq_offset) / (double)(p->freq_hz)) - 1.0;
 
             /* Compute the fine timestamp */
-            err = precise_timestamp_calculate(pkt.num_ts_metrics_stored, &pkt.timestamp_avg[0], pkt.timestamp_cnt, pkt.rx_rate_sf, context->if_chain_cfg[p->if_chain].freq_hz, pkt_freq_error, &(p->ftime));
+            err = precise_timestamp_calculate(pkt.num_ts_metrics_stored, &pkt.timestamp_avg[0], pkt.timestamp_cnt, pkt.rx_rate_sf, chan->if_freq_hz, pkt_freq_error, &(p->ftime));
             if (err == 0) {
                 p->ftime_received = true;
             }
         }
-    } else if (ifmod == IF_FSK_STD) {
+    } else if (chan->ifmod == IF_FSK_STD) {
         DEBUG_PRINTF("Note: FSK packet (modem %u chan %u)\n", pkt.modem_id, p->if_chain);
         p->modulation = MOD_FSK;
 
@@ -2118,19 +2534,25 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         }
 
         /* Get modulation params */
-        p->bandwidth = context->fsk_cfg.bandwidth;
-        p->datarate = context->fsk_cfg.datarate;
+        p->bandwidth = chan->bandwidth;
+        p->datarate = chan->datarate;
 
-        /* Compute timestamp correction to be applied */
-        timestamp_correction = ((uint32_t)680000 / context->fsk_cfg.datarate) - 20;
+        /* Get timestamp correction to be applied */
+        timestamp_correction = chan->ts_correction;
 
         /* RSSI correction */
+#if RX_FIXED_POINT
+        p->rssic_x10 = rssi_fsk_lut[pkt.rssi_chan_avg];
+#else
         p->rssic = RSSI_FSK_POLY_0 + RSSI_FSK_POLY_1 * p->rssic + RSSI_FSK_POLY_2 * pow(p->rssic, 2) + RSSI_FSK_POLY_3 * pow(p->rssic, 3);
+#endif
 
         /* Undefined for FSK */
         p->coderate = CR_UNDEFINED;
         p->snr = -128.0;
         p->rssis = -128.0;
+        p->snr_x10 = -1280;
+        p->rssis_x10 = -1280;
     } else {
         DEBUG_MSG("ERROR: UNEXPECTED PACKET ORIGIN\n");
         p->status = STAT_UNDEFINED;
@@ -2140,6 +2562,9 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         p->snr = -128.0;
         p->snr_min = -128.0;
         p->snr_max = -128.0;
+        p->rssic_x10 = -1280;
+        p->rssis_x10 = -1280;
+        p->snr_x10 = -1280;
         p->bandwidth = BW_UNDEFINED;
         p->datarate = DR_UNDEFINED;
         p->coderate = CR_UNDEFINED;
@@ -2149,7 +2574,8 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
     /* Scale 32 MHz packet timestamp to 1 MHz (microseconds) */
     p->count_us = pkt.timestamp_cnt / 32;
 
-    /* Expand 27-bits counter to 32-bits counter, based on current wrapping status (updated after fetch) */
+    /* Expand 27-bits counter to 64-bits counter, based on current wrapping status (updated after fetch) */
+    p->count_us64 = timestamp_pkt_expand64(&counter_us, p->count_us);
     p->count_us = timestamp_pkt_expand(&counter_us, p->count_us);
 
 
@@ -2177,10 +2603,13 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
 
     /* Packet timestamp corrected */
     p->count_us = p->count_us + timestamp_correction;
+    p->count_us64 = p->count_us64 + (int64_t)timestamp_correction;
 
     /* Packet CRC status */
     p->crc = pkt.rx_crc16_value;
 
+    rx_stats.nb_pkt += 1;
+
     _meas_time_stop(2, tm, __FUNCTION__);
 
     return LGW_REG_SUCCESS;
@@ -2188,16 +2617,21 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size) {
-    int i;
-    int crc = 0;
+int sx1302_get_rx_stats(struct lgw_rx_stats_s * stats, bool reset) {
+    CHECK_NULL(stats);
 
-    for (i = 0; i < size; i++) {
-        lora_crc16(data[i], &crc);
+    *stats = rx_stats;
+    if (reset == true) {
+        memset(&rx_stats, 0, sizeof rx_stats);
     }
 
-    //printf("CRC16: 0x%02X 0x%02X (%X)\n", (uint8_t)(crc >> 8), (uint8_t)crc, crc);
-    return (uint16_t)crc;
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size) {
+    return crc16_lora(data, size);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -2298,7 +2732,11 @@ uint8_t sx1302_tx_status(uint8_t rf_chain) {
     int err;
     int32_t read_value;
 
-    err = lgw_reg_r(SX1302_REG_TX_TOP_TX_FSM_STATUS_TX_STATUS(rf_chain), &read_value);
+    if (rf_chain == 0) {
+        err = lgw_reg_hot_r(LGW_REG_HOT(SX1302_REG_TX_TOP_A_TX_FSM_STATUS_TX_STATUS), &read_value);
+    } else {
+        err = lgw_reg_hot_r(LGW_REG_HOT(SX1302_REG_TX_TOP_B_TX_FSM_STATUS_TX_STATUS), &read_value);
+    }
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: Failed to read TX STATUS\n");
         return TX_STATUS_UNKNOWN;
@@ -2395,34 +2833,18 @@ int sx1302_tx_configure(lgw_radio_type_t radio_type) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data) {
+static int sx1302_tx_load(lgw_radio_type_t radio_type, const struct lgw_tx_gain_s * tx_gain, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data, uint16_t * tx_start_delay) {
     int err;
     uint32_t freq_reg, fdev_reg;
     uint32_t freq_dev;
     uint32_t fsk_br_reg;
     uint64_t fsk_sync_word_reg;
     uint16_t mem_addr;
-    uint32_t count_us;
     uint8_t power;
-    uint8_t pow_index;
     uint8_t mod_bw;
     uint8_t pa_en;
-    uint16_t tx_start_delay;
     uint8_t chirp_lowpass = 0;
     uint8_t buff[2]; /* for 16-bits register write operation */
-    /* performances variables */
-    struct timeval tm;
-
-    /* Record function start time */
-    _meas_time_start(&tm);
-
-    /* Check input parameters */
-    CHECK_NULL(tx_lut);
-    CHECK_NULL(pkt_data);
-
-    /* Setting BULK write mode (to speed up configuration on USB) */
-    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
-    CHECK_ERR(err);
 
     /* Select the proper modem */
     switch (pkt_data->modulation) {
@@ -2449,31 +2871,25 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
             return LGW_REG_ERROR;
     }
 
-    /* Find the proper index in the TX gain LUT according to requested rf_power */
-    for (pow_index = tx_lut->size-1; pow_index > 0; pow_index--) {
-        if (tx_lut->lut[pow_index].rf_power <= pkt_data->rf_power) {
-            break;
-        }
-    }
-    DEBUG_PRINTF("INFO: selecting TX Gain LUT index %u\n", pow_index);
+    DEBUG_PRINTF("INFO: applying TX gain of %d dBm\n", tx_gain->rf_power);
 
     /* loading calibrated Tx DC offsets */
-    err = lgw_reg_w(SX1302_REG_TX_TOP_TX_RFFE_IF_I_OFFSET_I_OFFSET(pkt_data->rf_chain), tx_lut->lut[pow_index].offset_i);
+    err = lgw_reg_w(SX1302_REG_TX_TOP_TX_RFFE_IF_I_OFFSET_I_OFFSET(pkt_data->rf_chain), tx_gain->offset_i);
     CHECK_ERR(err);
-    err = lgw_reg_w(SX1302_REG_TX_TOP_TX_RFFE_IF_Q_OFFSET_Q_OFFSET(pkt_data->rf_chain), tx_lut->lut[pow_index].offset_q);
+    err = lgw_reg_w(SX1302_REG_TX_TOP_TX_RFFE_IF_Q_OFFSET_Q_OFFSET(pkt_data->rf_chain), tx_gain->offset_q);
     CHECK_ERR(err);
 
-    DEBUG_PRINTF("INFO: Applying IQ offset (i:%d, q:%d)\n", tx_lut->lut[pow_index].offset_i, tx_lut->lut[pow_index].offset_q);
+    DEBUG_PRINTF("INFO: Applying IQ offset (i:%d, q:%d)\n", tx_gain->offset_i, tx_gain->offset_q);
 
     /* Set the power parameters to be used for TX */
     switch (radio_type) {
         case LGW_RADIO_TYPE_SX1250:
-            pa_en = (tx_lut->lut[pow_index].pa_gain > 0) ? 1 : 0; /* only 1 bit used to control the external PA */
-            power = (pa_en << 6) | tx_lut->lut[pow_index].pwr_idx;
+            pa_en = (tx_gain->pa_gain > 0) ? 1 : 0; /* only 1 bit used to control the external PA */
+            power = (pa_en << 6) | tx_gain->pwr_idx;
             break;
         case LGW_RADIO_TYPE_SX1255:
         case LGW_RADIO_TYPE_SX1257:
-            power = (tx_lut->lut[pow_index].pa_gain << 6) | (tx_lut->lut[pow_index].dac_gain << 4) | tx_lut->lut[pow_index].mix_gain;
+            power = (tx_gain->pa_gain << 6) | (tx_gain->dac_gain << 4) | tx_gain->mix_gain;
             break;
         default:
             DEBUG_MSG("ERROR: radio type not supported\n");
@@ -2483,7 +2899,7 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
     CHECK_ERR(err);
 
     /* Set digital gain */
-    err = lgw_reg_w(SX1302_REG_TX_TOP_TX_RFFE_IF_IQ_GAIN_IQ_GAIN(pkt_data->rf_chain), tx_lut->lut[pow_index].dig_gain);
+    err = lgw_reg_w(SX1302_REG_TX_TOP_TX_RFFE_IF_IQ_GAIN_IQ_GAIN(pkt_data->rf_chain), tx_gain->dig_gain);
     CHECK_ERR(err);
 
     /* Set Tx frequency */
@@ -2726,7 +3142,7 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
     }
 
     /* Set TX start delay */
-    err = sx1302_tx_set_start_delay(pkt_data->rf_chain, radio_type, pkt_data->modulation, pkt_data->bandwidth, chirp_lowpass, &tx_start_delay);
+    err = sx1302_tx_set_start_delay(pkt_data->rf_chain, radio_type, pkt_data->modulation, pkt_data->bandwidth, chirp_lowpass, tx_start_delay);
     CHECK_ERR(err);
 
     /* Write payload in transmit buffer */
@@ -2745,37 +3161,48 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
     err = lgw_reg_w(SX1302_REG_TX_TOP_TX_CTRL_WRITE_BUFFER(pkt_data->rf_chain), 0x00);
     CHECK_ERR(err);
 
+    DEBUG_PRINTF("Load Tx: Freq:%u %s%u size:%u preamb:%u\n", pkt_data->freq_hz, (pkt_data->modulation == MOD_LORA) ? "SF" : "DR:", pkt_data->datarate, pkt_data->size, pkt_data->preamble);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sx1302_tx_trigger(uint8_t rf_chain, uint8_t tx_mode, uint32_t trig_count_us, uint16_t tx_start_delay) {
+    int err;
+    uint32_t count_us;
+
     /* Trigger transmit */
-    DEBUG_PRINTF("Start Tx: Freq:%u %s%u size:%u preamb:%u\n", pkt_data->freq_hz, (pkt_data->modulation == MOD_LORA) ? "SF" : "DR:", pkt_data->datarate, pkt_data->size, pkt_data->preamble);
-    switch (pkt_data->tx_mode) {
+    DEBUG_PRINTF("Start Tx: rf_chain:%u mode:%u\n", rf_chain, tx_mode);
+    switch (tx_mode) {
         case IMMEDIATE:
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(pkt_data->rf_chain), 0x00); /* reset state machine */
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(rf_chain), 0x00); /* reset state machine */
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(pkt_data->rf_chain), 0x01);
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(rf_chain), 0x01);
             CHECK_ERR(err);
             break;
         case TIMESTAMPED:
-            count_us = pkt_data->count_us * 32 - tx_start_delay;
-            DEBUG_PRINTF("--> programming trig delay at %u (%u)\n", pkt_data->count_us - (tx_start_delay / 32), count_us);
+            count_us = trig_count_us * 32 - tx_start_delay;
+            DEBUG_PRINTF("--> programming trig delay at %u (%u)\n", trig_count_us - (tx_start_delay / 32), count_us);
 
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE0_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >>  0) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE0_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((count_us >>  0) & 0x000000FF));
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE1_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >>  8) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE1_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((count_us >>  8) & 0x000000FF));
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE2_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >> 16) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE2_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((count_us >> 16) & 0x000000FF));
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE3_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >> 24) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE3_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((count_us >> 24) & 0x000000FF));
             CHECK_ERR(err);
 
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(pkt_data->rf_chain), 0x00); /* reset state machine */
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(rf_chain), 0x00); /* reset state machine */
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(pkt_data->rf_chain), 0x01);
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(rf_chain), 0x01);
             CHECK_ERR(err);
             break;
         case ON_GPS:
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(pkt_data->rf_chain), 0x00); /* reset state machine */
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(rf_chain), 0x00); /* reset state machine */
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(pkt_data->rf_chain), 0x01);
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(rf_chain), 0x01);
             CHECK_ERR(err);
             break;
         default:
@@ -2783,6 +3210,153 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
             return LGW_REG_ERROR;
     }
 
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_send(lgw_radio_type_t radio_type, const struct lgw_tx_gain_s * tx_gain, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data) {
+    int err;
+    uint16_t tx_start_delay;
+    /* performances variables */
+    int64_t tm;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    /* Check input parameters */
+    CHECK_NULL(tx_gain);
+    CHECK_NULL(pkt_data);
+
+    /* Setting BULK write mode (to speed up configuration on USB) */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
+    /* Load the packet and arm the trigger in the same USB transfer */
+    err = sx1302_tx_load(radio_type, tx_gain, lwan_public, context_fsk, pkt_data, &tx_start_delay);
+    CHECK_ERR(err);
+    err = sx1302_tx_trigger(pkt_data->rf_chain, pkt_data->tx_mode, pkt_data->count_us, tx_start_delay);
+    CHECK_ERR(err);
+
+    /* Flush write (USB BULK mode) */
+    err = lgw_com_flush();
+    CHECK_ERR(err);
+
+    /* Setting back to SINGLE BULK write mode */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    CHECK_ERR(err);
+
+    /* Compute time spent in this function */
+    _meas_time_stop(2, tm, __FUNCTION__);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_send_prepare(lgw_radio_type_t radio_type, const struct lgw_tx_gain_s * tx_gain, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data, uint16_t * tx_start_delay) {
+    int err;
+    /* performances variables */
+    int64_t tm;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    /* Check input parameters */
+    CHECK_NULL(tx_gain);
+    CHECK_NULL(pkt_data);
+    CHECK_NULL(tx_start_delay);
+
+    /* Setting BULK write mode (to speed up configuration on USB) */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
+    err = sx1302_tx_load(radio_type, tx_gain, lwan_public, context_fsk, pkt_data, tx_start_delay);
+    CHECK_ERR(err);
+
+    /* Flush write (USB BULK mode) */
+    err = lgw_com_flush();
+    CHECK_ERR(err);
+
+    /* Setting back to SINGLE BULK write mode */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    CHECK_ERR(err);
+
+    /* Compute time spent in this function */
+    _meas_time_stop(2, tm, __FUNCTION__);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_send_batch(struct sx1302_tx_batch_s * batch, uint8_t nb_pkt, bool lwan_public, struct lgw_conf_rxif_s * context_fsk) {
+    int err;
+    int i;
+    /* performances variables */
+    int64_t tm;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    /* Check input parameters */
+    CHECK_NULL(batch);
+
+    /* Setting BULK write mode (to speed up configuration on USB) */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
+    /* Load the packets and arm their trigger in the same USB transfer */
+    /* A packet failing to load is not triggered, the other ones are still sent */
+    for (i = 0; i < nb_pkt; i++) {
+        batch[i].err = LGW_REG_SUCCESS;
+        if ((batch[i].pkt == NULL) || (batch[i].tx_gain == NULL)) {
+            batch[i].err = LGW_REG_ERROR;
+            continue;
+        }
+        if (batch[i].loaded == false) {
+            batch[i].err = sx1302_tx_load(batch[i].radio_type, batch[i].tx_gain, lwan_public, context_fsk, batch[i].pkt, &(batch[i].start_delay));
+        }
+        if (batch[i].err == LGW_REG_SUCCESS) {
+            batch[i].err = sx1302_tx_trigger(batch[i].pkt->rf_chain, batch[i].pkt->tx_mode, batch[i].pkt->count_us, batch[i].start_delay);
+        }
+    }
+
+    /* Flush write (USB BULK mode) */
+    err = lgw_com_flush();
+    if (err != LGW_COM_SUCCESS) {
+        for (i = 0; i < nb_pkt; i++) {
+            batch[i].err = LGW_REG_ERROR;
+        }
+    }
+
+    /* Setting back to SINGLE BULK write mode */
+    err |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    CHECK_ERR(err);
+
+    /* Compute time spent in this function */
+    _meas_time_stop(2, tm, __FUNCTION__);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_send_commit(uint8_t rf_chain, uint8_t tx_mode, uint32_t count_us, uint16_t tx_start_delay) {
+    int err;
+    /* performances variables */
+    int64_t tm;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    /* Setting BULK write mode (to speed up configuration on USB) */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
+    err = sx1302_tx_trigger(rf_chain, tx_mode, count_us, tx_start_delay);
+    CHECK_ERR(err);
+
     /* Flush write (USB BULK mode) */
     err = lgw_com_flush();
     CHECK_ERR(err);
@@ -2810,6 +3384,41 @@ int sx1302_set_gpio(uint8_t gpio_reg_val) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_check_running(uint32_t max_age_us, uint32_t tolerance_us) {
+    int32_t val;
+    uint8_t agc_status;
+    uint32_t expected_us, inst_us;
+    int32_t diff_us;
+
+    /* CONFIG_DONE GPIO, cleared by a reset */
+    if ((lgw_reg_r(SX1302_REG_GPIO_GPIO_OUT_L_OUT_VALUE, &val) != LGW_REG_SUCCESS) || ((val & 0x01) == 0)) {
+        printf("INFO: SX1302 configuration lost\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* AGC firmware still running */
+    if ((sx1302_agc_status(&agc_status) != LGW_REG_SUCCESS) || (agc_status == 0x00)) {
+        printf("INFO: SX1302 AGC firmware stopped\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* Timestamp counter not restarted, compared to its last value extrapolated with the host clock */
+    if (timestamp_counter_estimate(&counter_us, max_age_us, &expected_us) != 0) {
+        printf("INFO: SX1302 counter last read too long ago to be checked\n");
+        return LGW_REG_ERROR;
+    }
+    inst_us = (uint32_t)sx1302_timestamp_counter(false);
+    diff_us = (int32_t)(inst_us - expected_us);
+    if ((diff_us > (int32_t)tolerance_us) || (diff_us < -(int32_t)tolerance_us)) {
+        printf("INFO: SX1302 counter restarted (%u us, expected %u us)\n", inst_us, expected_us);
+        return LGW_REG_ERROR;
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 double sx1302_dc_notch_delay(double if_freq_khz) {
     double delay;
 
@@ -17,6 +17,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
 #include <string.h>     /* memset */
 #include <assert.h>     /* assert */
@@ -25,6 +26,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_reg.h"
 #include "loragw_sx1302_rx.h"
 #include "loragw_sx1302_timestamp.h"
+#include "loragw_trace.h"
+#include "loragw_rxrec.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -40,33 +43,6 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
     #define CHECK_NULL(a)                if(a==NULL){return LGW_REG_ERROR;}
 #endif
 
-#define SX1302_PKT_PAYLOAD_LENGTH(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index +  2], 0, 8)
-#define SX1302_PKT_CHANNEL(buffer, start_index)                 TAKE_N_BITS_FROM(buffer[start_index +  3], 0, 8)
-#define SX1302_PKT_CRC_EN(buffer, start_index)                  TAKE_N_BITS_FROM(buffer[start_index +  4], 0, 1)
-#define SX1302_PKT_CODING_RATE(buffer, start_index)             TAKE_N_BITS_FROM(buffer[start_index +  4], 1, 3)
-#define SX1302_PKT_DATARATE(buffer, start_index)                TAKE_N_BITS_FROM(buffer[start_index +  4], 4, 4)
-#define SX1302_PKT_MODEM_ID(buffer, start_index)                TAKE_N_BITS_FROM(buffer[start_index +  5], 0, 8)
-#define SX1302_PKT_FREQ_OFFSET_7_0(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index +  6], 0, 8)
-#define SX1302_PKT_FREQ_OFFSET_15_8(buffer, start_index)        TAKE_N_BITS_FROM(buffer[start_index +  7], 0, 8)
-#define SX1302_PKT_FREQ_OFFSET_19_16(buffer, start_index)       TAKE_N_BITS_FROM(buffer[start_index +  8], 0, 4)
-#define SX1302_PKT_CRC_ERROR(buffer, start_index)               TAKE_N_BITS_FROM(buffer[start_index +  9], 0, 1)
-#define SX1302_PKT_SYNC_ERROR(buffer, start_index)              TAKE_N_BITS_FROM(buffer[start_index +  9], 2, 1)
-#define SX1302_PKT_HEADER_ERROR(buffer, start_index)            TAKE_N_BITS_FROM(buffer[start_index +  9], 3, 1)
-#define SX1302_PKT_TIMING_SET(buffer, start_index)              TAKE_N_BITS_FROM(buffer[start_index +  9], 4, 1)
-#define SX1302_PKT_SNR_AVG(buffer, start_index)                 TAKE_N_BITS_FROM(buffer[start_index + 10], 0, 8)
-#define SX1302_PKT_RSSI_CHAN(buffer, start_index)               TAKE_N_BITS_FROM(buffer[start_index + 11], 0, 8)
-#define SX1302_PKT_RSSI_SIG(buffer, start_index)                TAKE_N_BITS_FROM(buffer[start_index + 12], 0, 8)
-#define SX1302_PKT_RSSI_CHAN_MAX_NEG_DELTA(buffer, start_index) TAKE_N_BITS_FROM(buffer[start_index + 13], 0, 4)
-#define SX1302_PKT_RSSI_CHAN_MAX_POS_DELTA(buffer, start_index) TAKE_N_BITS_FROM(buffer[start_index + 13], 4, 4)
-#define SX1302_PKT_RSSI_SIG_MAX_NEG_DELTA(buffer, start_index)  TAKE_N_BITS_FROM(buffer[start_index + 14], 0, 4)
-#define SX1302_PKT_RSSI_SIG_MAX_POS_DELTA(buffer, start_index)  TAKE_N_BITS_FROM(buffer[start_index + 14], 4, 4)
-#define SX1302_PKT_TIMESTAMP_7_0(buffer, start_index)           TAKE_N_BITS_FROM(buffer[start_index + 15], 0, 8)
-#define SX1302_PKT_TIMESTAMP_15_8(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index + 16], 0, 8)
-#define SX1302_PKT_TIMESTAMP_23_16(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 17], 0, 8)
-#define SX1302_PKT_TIMESTAMP_31_24(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 18], 0, 8)
-#define SX1302_PKT_CRC_PAYLOAD_7_0(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 19], 0, 8)
-#define SX1302_PKT_CRC_PAYLOAD_15_8(buffer, start_index)        TAKE_N_BITS_FROM(buffer[start_index + 20], 0, 8)
-#define SX1302_PKT_NUM_TS_METRICS(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index + 21], 0, 8)
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE TYPES -------------------------------------------------------- */
@@ -74,26 +50,33 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
-/* RX buffer packet structure */
-#define SX1302_PKT_SYNCWORD_BYTE_0  0xA5
-#define SX1302_PKT_SYNCWORD_BYTE_1  0xC0
-#define SX1302_PKT_HEAD_METADATA    9
-#define SX1302_PKT_TAIL_METADATA    14
-
-/* modem IDs */
-#define SX1302_LORA_MODEM_ID_MAX    15
-#define SX1302_LORA_STD_MODEM_ID    16
-#define SX1302_FSK_MODEM_ID         17
-
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
+static bool rx_buffer_pkt_incomplete(const rx_buffer_t * self, int idx);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+/* the packet starting at idx, header and fine timestamp metrics included, ends after the data fetched */
+static bool rx_buffer_pkt_incomplete(const rx_buffer_t * self, int idx) {
+    int remaining = self->buffer_size - idx;
+    uint8_t payload_len;
+
+    if (remaining < SX1302_PKT_HEAD_METADATA) {
+        return true;
+    }
+    payload_len = SX1302_PKT_PAYLOAD_LENGTH(self->buffer, idx);
+    if (remaining < (SX1302_PKT_HEAD_METADATA + payload_len + SX1302_PKT_TAIL_METADATA)) {
+        return true;
+    }
+
+    return (remaining < (SX1302_PKT_HEAD_METADATA + payload_len + SX1302_PKT_TAIL_METADATA + (2 * SX1302_PKT_NUM_TS_METRICS(self->buffer, idx + payload_len))));
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -102,10 +85,14 @@ int rx_buffer_new(rx_buffer_t * self) {
     CHECK_NULL(self);
 
     /* Initialize members */
-    memset(self->buffer, 0, sizeof self->buffer);
+    /* no need to clear the buffer, only the fetched bytes are ever parsed */
     self->buffer_size = 0;
+    self->fetch_size = 0;
+    self->chip_size = 0;
     self->buffer_index = 0;
     self->buffer_pkt_nb = 0;
+    self->tail_index = 0;
+    self->tail_size = 0;
 
     return LGW_REG_SUCCESS;
 }
@@ -120,6 +107,29 @@ int rx_buffer_del(rx_buffer_t * self) {
     self->buffer_size = 0;
     self->buffer_index = 0;
     self->buffer_pkt_nb = 0;
+    self->tail_size = 0;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_buffer_carry(rx_buffer_t * self, rx_buffer_t * from) {
+    uint16_t size;
+
+    /* Check input params */
+    CHECK_NULL(self);
+    CHECK_NULL(from);
+
+    if (from->tail_size == 0) {
+        return LGW_REG_SUCCESS;
+    }
+
+    size = from->tail_size;
+    memmove(self->buffer, &from->buffer[from->tail_index], size);
+    from->tail_size = 0;
+    self->tail_index = 0;
+    self->tail_size = size;
 
     return LGW_REG_SUCCESS;
 }
@@ -128,36 +138,64 @@ int rx_buffer_del(rx_buffer_t * self) {
 
 int rx_buffer_fetch(rx_buffer_t * self) {
     int i, res;
-    uint8_t buff[2];
+    uint8_t buff[4];
+    const uint16_t nb_bytes_reg[2] = {
+        SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES,
+        SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES
+    };
+    uint8_t * const nb_bytes_buff[2] = { &buff[0], &buff[2] };
+    const uint16_t nb_bytes_size[2] = { 2, 2 };
     uint8_t payload_len;
     uint16_t next_pkt_idx;
     int idx;
     uint16_t nb_bytes_1, nb_bytes_2;
+    uint16_t carried;
+    bool split;
 
     /* Check input params */
     CHECK_NULL(self);
 
     /* Check if there is data in the FIFO */
-    lgw_reg_rb(SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES, buff, sizeof buff);
+    /* Workaround for multi-byte read issue: read twice and ensure new read is not lower than the previous one */
+    /* Both reads are grouped in a single COM transfer (one round-trip on USB) */
+    res = lgw_reg_rb_multi(nb_bytes_reg, nb_bytes_buff, nb_bytes_size, 2);
+    if (res != LGW_REG_SUCCESS) {
+        printf("ERROR: Failed to read RX buffer size\n");
+        return LGW_REG_ERROR;
+    }
     nb_bytes_1 = (buff[0] << 8) | (buff[1] << 0);
-
-    /* Workaround for multi-byte read issue: read again and ensure new read is not lower than the previous one */
-    lgw_reg_rb(SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES, buff, sizeof buff);
-    nb_bytes_2 = (buff[0] << 8) | (buff[1] << 0);
-
-    self->buffer_size = (nb_bytes_2 > nb_bytes_1) ? nb_bytes_2 : nb_bytes_1;
+    nb_bytes_2 = (buff[2] << 8) | (buff[3] << 0);
+
+    /* The incomplete packet carried from the previous fetch, if any, is completed by this one */
+    carried = self->tail_size;
+    self->tail_size = 0;
+
+    /* Read what fits in the buffer, the rest is left in the SX1302 for the next fetch */
+    self->chip_size = (nb_bytes_2 > nb_bytes_1) ? nb_bytes_2 : nb_bytes_1;
+    self->fetch_size = self->chip_size;
+    split = false;
+    if (self->fetch_size > (sizeof self->buffer - carried)) {
+        self->fetch_size = sizeof self->buffer - carried;
+        split = true;
+    }
+    if (self->fetch_size == 0) {
+        self->tail_size = carried; /* still waiting for the end of the packet */
+        self->buffer_size = 0;
+        return LGW_REG_SUCCESS;
+    }
+    self->buffer_size = carried + self->fetch_size;
 
     /* Fetch bytes from fifo if any */
     if (self->buffer_size > 0) {
         DEBUG_MSG   ("-----------------\n");
-        DEBUG_PRINTF("%s: nb_bytes to be fetched: %u (%u %u)\n", __FUNCTION__, self->buffer_size, buff[1], buff[0]);
+        DEBUG_PRINTF("%s: nb_bytes to be fetched: %u (%u %u), %u carried\n", __FUNCTION__, self->fetch_size, nb_bytes_1, nb_bytes_2, carried);
 
-        memset(self->buffer, 0, sizeof self->buffer);
-        res = lgw_mem_rb(0x4000, self->buffer, self->buffer_size, true);
+        res = lgw_mem_rb(0x4000, &self->buffer[carried], self->fetch_size, true);
         if (res != LGW_REG_SUCCESS) {
             printf("ERROR: Failed to read RX buffer, SPI error\n");
             return LGW_REG_ERROR;
         }
+        lgw_rxrec_put(lgw_board_cur, &self->buffer[carried], self->fetch_size, self->chip_size);
 
         /* print debug info */
         DEBUG_MSG("RX_BUFFER: ");
@@ -179,7 +217,7 @@ int rx_buffer_fetch(rx_buffer_t * self) {
                 DEBUG_PRINTF("INFO: syncword found at idx %d\n", idx);
                 break;
             } else {
-                printf("INFO: syncword not found at idx %d\n", idx);
+                DEBUG_PRINTF("INFO: syncword not found at idx %d\n", idx);
                 idx += 1;
             }
         }
@@ -189,13 +227,22 @@ int rx_buffer_fetch(rx_buffer_t * self) {
         }
         if (idx != 0) {
             printf("INFO: re-sync rx_buffer at idx %d\n", idx);
-            memmove((void *)(self->buffer), (void *)(self->buffer + idx), self->buffer_size - idx);
-            self->buffer_size -= idx;
+            LGW_TRACE(TRACE_SX1302 >= LGW_TRACE_LVL_EVENT, LGW_TRACE_SX1302_RX_RESYNC, idx, self->buffer_size, 0, 0, 0);
         }
 
-        /* Rewind and parse buffer to get the number of packet fetched */
-        idx = 0;
+        /* Parsing will start from the first syncword, no need to move data */
+        self->buffer_index = idx;
+
+        /* Parse buffer to get the number of packet fetched */
         while (idx < self->buffer_size) {
+            /* Packet cut by a split fetch, kept to be completed by the next one */
+            if (split && (rx_buffer_pkt_incomplete(self, idx) == true)) {
+                self->tail_index = (uint16_t)idx;
+                self->tail_size = self->buffer_size - (uint16_t)idx;
+                self->buffer_size = (uint16_t)idx;
+                break;
+            }
+
             if ((self->buffer[idx] != SX1302_PKT_SYNCWORD_BYTE_0) || (self->buffer[idx + 1] != SX1302_PKT_SYNCWORD_BYTE_1)) {
                 printf("WARNING: syncword not found at idx %d, discard the rx_buffer\n", idx);
                 return rx_buffer_del(self);
@@ -205,6 +252,10 @@ int rx_buffer_fetch(rx_buffer_t * self) {
 
             /* Compute the number of bytes for this packet */
             payload_len = SX1302_PKT_PAYLOAD_LENGTH(self->buffer, idx);
+            if ((idx + SX1302_PKT_HEAD_METADATA + payload_len + SX1302_PKT_TAIL_METADATA) > self->buffer_size) {
+                /* truncated packet, will be reported when popped */
+                break;
+            }
             next_pkt_idx =  SX1302_PKT_HEAD_METADATA +
                             payload_len +
                             SX1302_PKT_TAIL_METADATA +
@@ -213,10 +264,9 @@ int rx_buffer_fetch(rx_buffer_t * self) {
             /* Move to next packet */
             idx += (int)next_pkt_idx;
         }
-    }
 
-    /* Initialize the current buffer index to iterate on */
-    self->buffer_index = 0;
+        LGW_TRACE(TRACE_SX1302 >= LGW_TRACE_LVL_EVENT, LGW_TRACE_SX1302_RX_FETCH, self->buffer_size, self->buffer_pkt_nb, 0, 0, 0);
+    }
 
     return LGW_REG_SUCCESS;
 }
@@ -351,8 +401,8 @@ int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt) {
         }
     }
 
-    /* Parse & copy payload in packet struct */
-    memcpy((void *)pkt->payload, (void *)(&(self->buffer[self->buffer_index + SX1302_PKT_HEAD_METADATA])), pkt->rxbytenb_modem);
+    /* Point to the payload in the rx buffer, it will be copied only once by the caller */
+    pkt->payload = &(self->buffer[self->buffer_index + SX1302_PKT_HEAD_METADATA]);
 
     /* Move buffer index toward next message */
     self->buffer_index += (SX1302_PKT_HEAD_METADATA + pkt->rxbytenb_modem + SX1302_PKT_TAIL_METADATA + (2 * pkt->num_ts_metrics_stored));
@@ -21,12 +21,21 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* boolean type */
 #include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* malloc, free */
 #include <memory.h>     /* memset */
 #include <inttypes.h>   /* PRIx64, PRIu64... */
 #include <assert.h>
+#include <time.h>       /* clock_gettime */
 
 #include "loragw_sx1302_timestamp.h"
 #include "loragw_reg.h"
@@ -56,6 +65,25 @@ struct timestamp_pps_history_s {
     uint8_t size; /* current size */
 };
 
+#define TIMESTAMP_CORR_BW_NB    3   /* 125, 250 and 500 kHz */
+#define TIMESTAMP_CORR_SF_NB    8   /* SF5 to SF12 */
+#define TIMESTAMP_CORR_CR_NB    4   /* 4/5 to 4/8 */
+#define TIMESTAMP_CORR_MOD_MAX  (TIMESTAMP_CORR_SF_NB + 1) /* multi-SF modems, and LoRa service modem */
+#define TIMESTAMP_CORR_MOD_SIZE (TIMESTAMP_CORR_CR_NB * 2 * 256) /* coding rate x CRC x payload length */
+struct timestamp_corr_table_s {
+    bool ftime_enable;                  /* precision timestamp mode the corrections were computed for */
+    int8_t mod_idx[TIMESTAMP_CORR_BW_NB][TIMESTAMP_CORR_SF_NB]; /* index of the (bandwidth, datarate) in corr, -1 if not computed */
+    int32_t * corr;                     /* corrections for RX_DFT_PEAK_MODE_AUTO, TIMESTAMP_CORR_MOD_SIZE per modulation */
+};
+
+struct timestamp_ftime_cache_s {
+    uint8_t notch_nb;                           /* number of IF frequencies with a precomputed DC notch delay */
+    int32_t notch_if_freq_hz[LGW_IF_CHAIN_NB];
+    double notch_delay[LGW_IF_CHAIN_NB];        /* sx1302_dc_notch_delay() of notch_if_freq_hz */
+    uint32_t xtal_diff_pps;                     /* PPS interval xtal_correct was computed for, 0 if none */
+    double xtal_correct;
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
@@ -66,11 +94,28 @@ struct timestamp_pps_history_s {
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
 /* history of the last PPS timestamps */
-static struct timestamp_pps_history_s timestamp_pps_history = {
-    .history = { 0 },
-    .idx = 0,
-    .size = 0
+static struct timestamp_pps_history_s timestamp_pps_history_board[LGW_BOARD_NB_MAX] = {
+    [0 ... LGW_BOARD_NB_MAX - 1] = {
+        .history = { 0 },
+        .idx = 0,
+        .size = 0
+    }
+};
+#define timestamp_pps_history timestamp_pps_history_board[lgw_board_cur]
+
+/* timestamp corrections precomputed for the configured channels */
+static struct timestamp_corr_table_s timestamp_corr_table_board[LGW_BOARD_NB_MAX] = {
+    [0 ... LGW_BOARD_NB_MAX - 1] = {
+        .ftime_enable = false,
+        .mod_idx = { { 0 } },
+        .corr = NULL
+    }
 };
+#define timestamp_corr_table timestamp_corr_table_board[lgw_board_cur]
+
+/* fine timestamp terms which only depend on the configuration or on the PPS */
+static struct timestamp_ftime_cache_s timestamp_ftime_cache_board[LGW_BOARD_NB_MAX];
+#define timestamp_ftime_cache timestamp_ftime_cache_board[lgw_board_cur]
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
@@ -97,6 +142,21 @@ int32_t precision_timestamp_correction(uint8_t bandwidth, uint8_t datarate, uint
 */
 void timestamp_pps_history_save(uint32_t timestamp_pps_reg);
 
+/**
+@brief Convert a host monotonic time to microseconds, wrapping on a uint32_t
+@param t host time
+@return the time in microseconds
+*/
+static inline uint32_t timestamp_host_us(const struct timespec * t);
+
+/**
+@brief Publish a counter read to the lock-free readers (single writer: the thread holding the concentrator)
+@param self     Pointer to the counter handler
+@param inst_us  The 64-bits counter read
+@param host_us  Host monotonic time of the read, in microseconds
+*/
+static void timestamp_snapshot_publish(timestamp_counter_t * self, uint64_t inst_us, uint32_t host_us);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -284,6 +344,26 @@ void timestamp_pps_history_save(uint32_t timestamp_pps_reg) {
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static inline uint32_t timestamp_host_us(const struct timespec * t) {
+    return (uint32_t)((uint64_t)t->tv_sec * 1000000 + (uint64_t)t->tv_nsec / 1000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void timestamp_snapshot_publish(timestamp_counter_t * self, uint64_t inst_us, uint32_t host_us) {
+    uint32_t seq = __atomic_load_n(&self->snap_seq, __ATOMIC_RELAXED);
+    uint32_t seq_next = (seq + 2 != 0) ? (seq + 2) : 2; /* 0 means nothing published */
+
+    __atomic_store_n(&self->snap_seq, seq + 1, __ATOMIC_RELAXED); /* odd: update in progress */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&self->snap_inst_us, (uint32_t)inst_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->snap_inst_us_hi, (uint32_t)(inst_us >> 32), __ATOMIC_RELAXED);
+    __atomic_store_n(&self->snap_host_us, host_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->snap_seq, seq_next, __ATOMIC_RELEASE);
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -306,10 +386,12 @@ void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t
     if (pps < self->pps.counter_us_27bits_ref) {
         self->pps.counter_us_27bits_wrap += 1;
         self->pps.counter_us_27bits_wrap %= 32;
+        self->pps.counter_us_27bits_wrap_nb += 1;
     }
     if (inst < self->inst.counter_us_27bits_ref) {
         self->inst.counter_us_27bits_wrap += 1;
         self->inst.counter_us_27bits_wrap %= 32;
+        self->inst.counter_us_27bits_wrap_nb += 1;
     }
 
     /* Update counter reference */
@@ -320,39 +402,51 @@ void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t * pps) {
+    uint64_t inst64, pps64;
+
+    if (timestamp_counter_get64(self, &inst64, &pps64) != 0) {
+        return -1;
+    }
+    *inst = (uint32_t)inst64;
+    *pps = (uint32_t)pps64;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int timestamp_counter_get64(timestamp_counter_t * self, uint64_t * inst, uint64_t * pps) {
     int x;
     uint8_t buff[8];
     uint8_t buff_wa[8];
     uint32_t counter_inst_us_raw_27bits_now;
     uint32_t counter_pps_us_raw_27bits_now;
+    const uint16_t reg[2] = { SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS };
+    uint8_t * const data[2] = { buff, buff_wa };
+    const uint16_t size[2] = { 8, 8 };
+    struct timespec now;
 
     /* Get the freerun and pps 32MHz timestamp counters - 8 bytes
             0 -> 3 : PPS counter
             4 -> 7 : Freerun counter (inst)
-    */
-    x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff[0], 8);
-    if (x != LGW_REG_SUCCESS) {
-        printf("ERROR: Failed to get timestamp counter value\n");
-        return -1;
-    }
-
-    /* Workaround concentrator chip issue:
-        - read MSB again
+       Workaround concentrator chip issue:
+        - read MSB again, in the same transfer
         - if MSB changed, read the full counter again
      */
-    x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff_wa[0], 8);
+    x = lgw_reg_rb_multi(reg, data, size, 2);
     if (x != LGW_REG_SUCCESS) {
-        printf("ERROR: Failed to get timestamp counter MSB value\n");
+        printf("ERROR: Failed to get timestamp counter value\n");
         return -1;
     }
     if ((buff[0] != buff_wa[0]) || (buff[4] != buff_wa[4])) {
-        x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff_wa[0], 8);
+        x = lgw_reg_hot_rb(LGW_REG_HOT(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS), &buff_wa[0], 8);
         if (x != LGW_REG_SUCCESS) {
             printf("ERROR: Failed to get timestamp counter MSB value\n");
             return -1;
         }
         memcpy(buff, buff_wa, 8); /* use the new read value */
     }
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
     counter_pps_us_raw_27bits_now  = (buff[0]<<24) | (buff[1]<<16) | (buff[2]<<8) | buff[3];
     counter_inst_us_raw_27bits_now = (buff[4]<<24) | (buff[5]<<16) | (buff[6]<<8) | buff[7];
@@ -367,9 +461,55 @@ int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t
     /* Update counter wrapping status */
     timestamp_counter_update(self, counter_pps_us_raw_27bits_now, counter_inst_us_raw_27bits_now);
 
-    /* Convert 27-bits counter to 32-bits counter */
-    *inst = timestamp_counter_expand(self, false, counter_inst_us_raw_27bits_now);
-    *pps  = timestamp_counter_expand(self, true, counter_pps_us_raw_27bits_now);
+    /* Convert 27-bits counter to 64-bits counter */
+    *inst = timestamp_counter_expand64(self, false, counter_inst_us_raw_27bits_now);
+    *pps  = timestamp_counter_expand64(self, true, counter_pps_us_raw_27bits_now);
+
+    /* Publish the read value as reference for estimates */
+    timestamp_snapshot_publish(self, *inst, timestamp_host_us(&now));
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int timestamp_counter_estimate(timestamp_counter_t * self, uint32_t max_age_us, uint32_t * inst) {
+    uint64_t inst64;
+
+    if (timestamp_counter_estimate64(self, max_age_us, &inst64) != 0) {
+        return -1;
+    }
+    *inst = (uint32_t)inst64; /* wraps on a uint32_t as the counter does */
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int timestamp_counter_estimate64(timestamp_counter_t * self, uint32_t max_age_us, uint64_t * inst) {
+    struct timespec now;
+    uint32_t seq, inst_us, inst_us_hi, host_us, elapsed_us;
+
+    /* Seqlock read: retry if the writer updated the snapshot meanwhile */
+    do {
+        seq = __atomic_load_n(&self->snap_seq, __ATOMIC_ACQUIRE);
+        inst_us = __atomic_load_n(&self->snap_inst_us, __ATOMIC_RELAXED);
+        inst_us_hi = __atomic_load_n(&self->snap_inst_us_hi, __ATOMIC_RELAXED);
+        host_us = __atomic_load_n(&self->snap_host_us, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (((seq & 1) != 0) || (seq != __atomic_load_n(&self->snap_seq, __ATOMIC_RELAXED)));
+
+    if (seq == 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_us = timestamp_host_us(&now) - host_us;
+    if (elapsed_us > max_age_us) {
+        return -1;
+    }
+
+    *inst = (((uint64_t)inst_us_hi << 32) | inst_us) + elapsed_us;
 
     return 0;
 }
@@ -425,6 +565,28 @@ uint32_t timestamp_pkt_expand(timestamp_counter_t * self, uint32_t pkt_cnt_us) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+uint64_t timestamp_counter_expand64(timestamp_counter_t * self, bool pps, uint32_t cnt_us) {
+    struct timestamp_info_s* tinfo = (pps == true) ? &self->pps : &self->inst;
+
+    return ((uint64_t)tinfo->counter_us_27bits_wrap_nb << 27) | cnt_us;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t timestamp_pkt_expand64(timestamp_counter_t * self, uint32_t pkt_cnt_us) {
+    struct timestamp_info_s* tinfo = &self->inst;
+    uint32_t wrap_nb = tinfo->counter_us_27bits_wrap_nb;
+
+    /* Use current wrap counter or previous, as timestamp_pkt_expand() */
+    if ((tinfo->counter_us_27bits_ref < pkt_cnt_us) && (wrap_nb > 0)) {
+        wrap_nb -= 1;
+    }
+
+    return ((uint64_t)wrap_nb << 27) | pkt_cnt_us;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int timestamp_counter_mode(bool ftime_enable) {
     int x = LGW_REG_SUCCESS;
 
@@ -450,6 +612,8 @@ int timestamp_counter_mode(bool ftime_enable) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int32_t timestamp_counter_correction(lgw_context_t * context, uint8_t bandwidth, uint8_t datarate, uint8_t coderate, bool crc_en, uint8_t payload_length, sx1302_rx_dft_peak_mode_t dft_peak_mode) {
+    int idx;
+
     /* Check input parameters */
     CHECK_NULL(context);
     if (IS_LORA_DR(datarate) == false) {
@@ -465,6 +629,14 @@ int32_t timestamp_counter_correction(lgw_context_t * context, uint8_t bandwidth,
         return 0;
     }
 
+    /* Get the correction precomputed for the channel, if any */
+    if ((timestamp_corr_table.corr != NULL) && (timestamp_corr_table.ftime_enable == context->ftime_cfg.enable) && (dft_peak_mode == RX_DFT_PEAK_MODE_AUTO)) {
+        idx = timestamp_corr_table.mod_idx[bandwidth - BW_125KHZ][datarate - DR_LORA_SF5];
+        if (idx >= 0) {
+            return timestamp_corr_table.corr[(idx * TIMESTAMP_CORR_MOD_SIZE) + (((coderate - CR_LORA_4_5) * 2 + (crc_en ? 1 : 0)) * 256) + payload_length];
+        }
+    }
+
     /* Calculate the correction to be applied */
     if (context->ftime_cfg.enable == false) {
         return legacy_timestamp_correction(bandwidth, datarate, coderate, crc_en, payload_length, dft_peak_mode);
@@ -475,10 +647,95 @@ int32_t timestamp_counter_correction(lgw_context_t * context, uint8_t bandwidth,
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int timestamp_correction_table_init(lgw_context_t * context) {
+    int i, sf, nb_mod = 0;
+    int cr, crc, len;
+    int32_t * corr;
+    bool multisf_en = false;
+    uint8_t bw_list[TIMESTAMP_CORR_MOD_MAX];
+    uint8_t sf_list[TIMESTAMP_CORR_MOD_MAX];
+
+    /* Check input parameters */
+    CHECK_NULL(context);
+
+    timestamp_correction_table_free();
+
+    /* DC notch filtering delay of the channels, used by fine timestamping */
+    if (context->ftime_cfg.enable == true) {
+        for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+            if (context->if_chain_cfg[i].enable == true) {
+                timestamp_ftime_cache.notch_if_freq_hz[timestamp_ftime_cache.notch_nb] = context->if_chain_cfg[i].freq_hz;
+                timestamp_ftime_cache.notch_delay[timestamp_ftime_cache.notch_nb] = sx1302_dc_notch_delay((double)context->if_chain_cfg[i].freq_hz / 1E3);
+                timestamp_ftime_cache.notch_nb += 1;
+            }
+        }
+    }
+
+    /* List the modulations which can be received with the channels configuration */
+    for (i = 0; i < LGW_MULTI_NB; i++) {
+        multisf_en |= context->if_chain_cfg[i].enable;
+    }
+    if (multisf_en == true) {
+        for (sf = DR_LORA_SF5; sf <= DR_LORA_SF12; sf++) {
+            bw_list[nb_mod] = BW_125KHZ;
+            sf_list[nb_mod] = sf;
+            nb_mod += 1;
+        }
+    }
+    if ((context->if_chain_cfg[8].enable == true) && IS_LORA_BW(context->lora_service_cfg.bandwidth) && IS_LORA_DR(context->lora_service_cfg.datarate)) {
+        if ((multisf_en == false) || (context->lora_service_cfg.bandwidth != BW_125KHZ)) {
+            bw_list[nb_mod] = context->lora_service_cfg.bandwidth;
+            sf_list[nb_mod] = context->lora_service_cfg.datarate;
+            nb_mod += 1;
+        }
+    }
+    if (nb_mod == 0) {
+        return LGW_REG_SUCCESS;
+    }
+
+    corr = malloc(nb_mod * TIMESTAMP_CORR_MOD_SIZE * sizeof(int32_t));
+    if (corr == NULL) {
+        printf("WARNING: failed to allocate timestamp correction table, corrections will be computed for each packet\n");
+        return LGW_REG_SUCCESS;
+    }
+
+    /* Compute the corrections for every coding rate, CRC and payload length */
+    memset(timestamp_corr_table.mod_idx, -1, sizeof timestamp_corr_table.mod_idx);
+    for (i = 0; i < nb_mod; i++) {
+        for (cr = 0; cr < TIMESTAMP_CORR_CR_NB; cr++) {
+            for (crc = 0; crc < 2; crc++) {
+                for (len = 0; len < 256; len++) {
+                    if (context->ftime_cfg.enable == false) {
+                        corr[(i * TIMESTAMP_CORR_MOD_SIZE) + ((cr * 2 + crc) * 256) + len] = legacy_timestamp_correction(bw_list[i], sf_list[i], CR_LORA_4_5 + cr, (crc == 1), len, RX_DFT_PEAK_MODE_AUTO);
+                    } else {
+                        corr[(i * TIMESTAMP_CORR_MOD_SIZE) + ((cr * 2 + crc) * 256) + len] = precision_timestamp_correction(bw_list[i], sf_list[i], CR_LORA_4_5 + cr, (crc == 1), len);
+                    }
+                }
+            }
+        }
+        timestamp_corr_table.mod_idx[bw_list[i] - BW_125KHZ][sf_list[i] - DR_LORA_SF5] = i;
+    }
+    timestamp_corr_table.ftime_enable = context->ftime_cfg.enable;
+    timestamp_corr_table.corr = corr;
+
+    DEBUG_PRINTF("INFO: timestamp corrections precomputed for %d modulations\n", nb_mod);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void timestamp_correction_table_free(void) {
+    free(timestamp_corr_table.corr);
+    timestamp_corr_table.corr = NULL;
+    memset(&timestamp_ftime_cache, 0, sizeof timestamp_ftime_cache);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics, uint32_t timestamp_cnt, uint8_t sf, int32_t if_freq_hz, double pkt_freq_error, uint32_t * result_ftime) {
     int i, x, timestamp_pps_idx, timestamp_pps_idx_next, timestamp_pps_idx_prev;
     int32_t ftime_sum;
-    int32_t ftime[256];
     float ftime_mean;
     uint32_t timestamp_cnt_end_of_preamble;
     uint32_t timestamp_pps = 0;
@@ -537,19 +794,17 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
     printf("\n");
 #endif
 
-    /* Compute the ftime cumulative sum */
-    ftime[0] = (int32_t)ts_metrics[0];
-    ftime_sum = ftime[0];
-    for (i = 1; i < (2 * ts_metrics_nb_clipped); i++) {
-        ftime[i] = ftime[i-1] + ts_metrics[i];
-        ftime_sum += ftime[i];
+    /* Compute the sum of the ftime cumulative sum: each metric is counted once per partial sum it belongs to */
+    ftime_sum = 0;
+    for (i = 0; i < (2 * ts_metrics_nb_clipped); i++) {
+        ftime_sum += (int32_t)ts_metrics[i] * ((2 * ts_metrics_nb_clipped) - i);
     }
 
     /* Compute the mean of the cumulative sum */
     ftime_mean = (float)ftime_sum / (float)(2 * ts_metrics_nb_clipped);
 
     /* Find the last timestamp_pps before packet to use as reference for ftime */
-    x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS , &buff[0], 4);
+    x = lgw_reg_hot_rb(LGW_REG_HOT(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS), &buff[0], 4);
     if (x != LGW_REG_SUCCESS) {
         printf("ERROR: Failed to get timestamp counter value\n");
         return 0;
@@ -581,7 +836,6 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
         /* Calculate the Xtal error between the reference PPS we just found and the next one */
         timestamp_pps_idx_next = (timestamp_pps_idx == (MAX_TIMESTAMP_PPS_HISTORY - 1)) ? 0 : timestamp_pps_idx + 1;
         diff_pps = timestamp_pps_history.history[timestamp_pps_idx_next] - timestamp_pps_history.history[timestamp_pps_idx];
-        xtal_correct = (double)32e6 / (double)(diff_pps);
     } else {
         /* The timestamp_pps_reg we just read is the reference we use to calculate the fine timestamp */
         timestamp_pps = timestamp_pps_reg;
@@ -591,9 +845,15 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
         timestamp_pps_idx = timestamp_pps_history.idx;
         timestamp_pps_idx_prev = (timestamp_pps_idx == 0) ? (MAX_TIMESTAMP_PPS_HISTORY - 1) : (timestamp_pps_idx - 1);
         diff_pps = timestamp_pps_history.history[timestamp_pps_idx] - timestamp_pps_history.history[timestamp_pps_idx_prev];
-        xtal_correct = (double)32e6 / (double)(diff_pps);
     }
 
+    /* The PPS interval only changes once per second */
+    if (diff_pps != timestamp_ftime_cache.xtal_diff_pps) {
+        timestamp_ftime_cache.xtal_correct = (double)32e6 / (double)(diff_pps);
+        timestamp_ftime_cache.xtal_diff_pps = diff_pps;
+    }
+    xtal_correct = timestamp_ftime_cache.xtal_correct;
+
     /* Sanity Check on xtal_correct */
     if ((xtal_correct > 1.2) || (xtal_correct < 0.8)) {
         printf("ERROR: xtal_error is invalid (%.15lf)\n", xtal_correct);
@@ -611,8 +871,17 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
     pkt_ftime = (double)diff_pps + (double)ftime_mean;
     DEBUG_PRINTF("pkt_ftime = %f\n", pkt_ftime);
 
-    /* Add the DC notch filtering delay if necessary */
-    pkt_ftime += sx1302_dc_notch_delay((double)if_freq_hz / 1E3);
+    /* Add the DC notch filtering delay if necessary, precomputed for the configured channels */
+    for (i = 0; i < timestamp_ftime_cache.notch_nb; i++) {
+        if (timestamp_ftime_cache.notch_if_freq_hz[i] == if_freq_hz) {
+            break;
+        }
+    }
+    if (i < timestamp_ftime_cache.notch_nb) {
+        pkt_ftime += timestamp_ftime_cache.notch_delay[i];
+    } else {
+        pkt_ftime += sx1302_dc_notch_delay((double)if_freq_hz / 1E3);
+    }
 
     /* Convert fine timestamp from 32 Mhz clock to nanoseconds */
     pkt_ftime *= 31.25;
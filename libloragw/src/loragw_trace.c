@@ -0,0 +1,233 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Lightweight binary trace log for the HAL hot paths.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <time.h>       /* clock_gettime */
+#include <pthread.h>
+
+#include "loragw_trace.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Single producer (owner thread), single consumer (decoder) ring buffer */
+typedef struct {
+    uint32_t head;      /* next record to be written, only modified by the owner thread */
+    uint32_t tail;      /* next record to be read, only modified by the decoder */
+    uint32_t dropped;   /* records dropped because the ring was full */
+    struct lgw_trace_rec_s rec[LGW_TRACE_RING_SIZE];
+} trace_ring_t;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static trace_ring_t trace_rings[LGW_TRACE_THREAD_NB_MAX];
+static uint32_t trace_ring_nb = 0; /* number of rings claimed by a thread */
+static uint32_t trace_ring_lost = 0; /* records dropped because no ring was left */
+
+static __thread trace_ring_t * trace_ring_self = NULL;
+
+static pthread_t thrid_trace;
+static volatile bool trace_run = false;
+static FILE * trace_file = NULL;
+static uint32_t trace_period_ms = 0;
+
+/* Decoding format of each record, indexed by lgw_trace_id_t */
+static const char * const trace_fmt[LGW_TRACE_ID_NB] = {
+    [LGW_TRACE_HAL_RX_FETCH]     = "HAL: rx fetch: nb_pkt=%u max_pkt=%u",
+    [LGW_TRACE_HAL_RX_PKT]       = "HAL: rx pkt %u: freq=%u rssic=%d/10 snr=%d/10 size|status<<16=0x%X",
+    [LGW_TRACE_HAL_RX_PAYLOAD]   = "HAL: rx pkt %u: size=%u payload=%08X %08X %08X...",
+    [LGW_TRACE_HAL_TX_PKT]       = "HAL: tx pkt: freq=%u count_us=%u power=%d mod<<16|dr=0x%X size=%u",
+    [LGW_TRACE_SX1302_RX_FETCH]  = "SX1302: rx buffer fetched: nb_bytes=%u nb_pkt=%u",
+    [LGW_TRACE_SX1302_RX_RESYNC] = "SX1302: rx buffer resync: skipped=%u nb_bytes=%u",
+    [LGW_TRACE_FWD_PUSH_DATA]    = "FWD: PUSH_DATA: token=0x%04X nb_pkt=%u size=%u"
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static void * thread_trace(void * arg);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void * thread_trace(void * arg) {
+    (void)arg;
+
+    while (trace_run == true) {
+        lgw_trace_flush(trace_file);
+        wait_ms(trace_period_ms);
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void lgw_trace_put(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4) {
+    trace_ring_t * ring = trace_ring_self;
+    struct lgw_trace_rec_s * rec;
+    struct timespec ts;
+    uint32_t head, idx;
+
+    /* claim a ring on first use by this thread */
+    if (ring == NULL) {
+        idx = __atomic_fetch_add(&trace_ring_nb, 1, __ATOMIC_RELAXED);
+        if (idx >= LGW_TRACE_THREAD_NB_MAX) {
+            __atomic_fetch_add(&trace_ring_lost, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        ring = &trace_rings[idx];
+        trace_ring_self = ring;
+    }
+
+    head = ring->head;
+    if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= LGW_TRACE_RING_SIZE) {
+        ring->dropped += 1;
+        return;
+    }
+
+    /* CLOCK_MONOTONIC is served by the vDSO, no system call */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    rec = &ring->rec[head & (LGW_TRACE_RING_SIZE - 1)];
+    rec->ts_ns = ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+    rec->id = id;
+    rec->thread = (uint16_t)(ring - trace_rings);
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+    rec->args[4] = a4;
+
+    /* publish the record to the decoder */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_trace_flush(FILE * file) {
+    uint32_t i, ring_nb, head, tail;
+    struct lgw_trace_rec_s * rec;
+    trace_ring_t * ring;
+    int nb_rec = 0;
+
+    if (file == NULL) {
+        return 0;
+    }
+
+    ring_nb = __atomic_load_n(&trace_ring_nb, __ATOMIC_RELAXED);
+    if (ring_nb > LGW_TRACE_THREAD_NB_MAX) {
+        ring_nb = LGW_TRACE_THREAD_NB_MAX;
+    }
+
+    for (i = 0; i < ring_nb; i++) {
+        ring = &trace_rings[i];
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        for (tail = ring->tail; tail != head; tail++) {
+            rec = &ring->rec[tail & (LGW_TRACE_RING_SIZE - 1)];
+            fprintf(file, "[%llu.%09llu] T%u ", (unsigned long long)(rec->ts_ns / 1000000000ULL), (unsigned long long)(rec->ts_ns % 1000000000ULL), rec->thread);
+            if (rec->id < ARRAY_SIZE(trace_fmt)) {
+                fprintf(file, trace_fmt[rec->id], rec->args[0], rec->args[1], rec->args[2], rec->args[3], rec->args[4]);
+            } else {
+                fprintf(file, "UNKNOWN(%u): %08X %08X %08X %08X %08X", rec->id, rec->args[0], rec->args[1], rec->args[2], rec->args[3], rec->args[4]);
+            }
+            fprintf(file, "\n");
+            nb_rec += 1;
+        }
+        /* release the decoded records to the producer */
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    if (nb_rec > 0) {
+        fflush(file);
+    }
+
+    return nb_rec;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_trace_start(FILE * file, uint32_t period_ms) {
+    if ((file == NULL) || (period_ms == 0)) {
+        return LGW_TRACE_ERROR;
+    }
+    if (trace_run == true) {
+        return LGW_TRACE_ERROR;
+    }
+
+    trace_file = file;
+    trace_period_ms = period_ms;
+    trace_run = true;
+    if (pthread_create(&thrid_trace, NULL, thread_trace, NULL) != 0) {
+        trace_run = false;
+        return LGW_TRACE_ERROR;
+    }
+
+    return LGW_TRACE_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_trace_stop(void) {
+    if (trace_run == false) {
+        return LGW_TRACE_ERROR;
+    }
+
+    trace_run = false;
+    pthread_join(thrid_trace, NULL);
+    lgw_trace_flush(trace_file);
+
+    return LGW_TRACE_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t lgw_trace_dropped(void) {
+    uint32_t i, ring_nb;
+    uint32_t dropped;
+
+    dropped = __atomic_load_n(&trace_ring_lost, __ATOMIC_RELAXED);
+    ring_nb = __atomic_load_n(&trace_ring_nb, __ATOMIC_RELAXED);
+    if (ring_nb > LGW_TRACE_THREAD_NB_MAX) {
+        ring_nb = LGW_TRACE_THREAD_NB_MAX;
+    }
+    for (i = 0; i < ring_nb; i++) {
+        dropped += __atomic_load_n(&trace_rings[i].dropped, __ATOMIC_RELAXED);
+    }
+
+    return dropped;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -56,8 +56,10 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES  --------------------------------------------------- */
 
-static lgw_com_write_mode_t _lgw_write_mode = LGW_COM_WRITE_MODE_SINGLE;
-static uint8_t _lgw_spi_req_nb = 0;
+static lgw_com_write_mode_t _lgw_write_mode_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = LGW_COM_WRITE_MODE_SINGLE };
+static uint8_t _lgw_spi_req_nb_board[LGW_BOARD_NB_MAX] = { 0 };
+#define _lgw_write_mode _lgw_write_mode_board[lgw_board_cur]
+#define _lgw_spi_req_nb _lgw_spi_req_nb_board[lgw_board_cur]
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
@@ -105,6 +107,31 @@ int set_interface_attribs_linux(int fd, int speed) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* store a SPI request in the bulk buffer, sending the pending ones first if it is full */
+static int spi_req_store(int usb_device, uint8_t * in_out_buf, uint16_t command_size, const uint8_t * data, uint16_t data_size) {
+    int a;
+
+    command_size += data_size;
+
+    if (command_size > mcu_spi_bulk_room()) {
+        DEBUG_MSG("INFO: USB write buffer full, flushing\n");
+        a = mcu_spi_flush(usb_device);
+        _lgw_spi_req_nb = 0;
+        if (a != 0) {
+            printf("ERROR: Failed to flush USB write buffer\n");
+            return -1;
+        }
+    }
+
+    in_out_buf[0] = _lgw_spi_req_nb; /* Req ID */
+    a = mcu_spi_store_sg(in_out_buf, command_size - data_size, data, data_size);
+    _lgw_spi_req_nb += 1;
+
+    return a;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* configure serial interface to be read blocking or not*/
 int set_blocking_linux(int fd, bool blocking) {
     struct termios tty;
@@ -117,8 +144,10 @@ int set_blocking_linux(int fd, bool blocking) {
         return LGW_USB_ERROR;
     }
 
-    tty.c_cc[VMIN] = (blocking == true) ? 1 : 0;    /* set blocking or non-blocking mode */
-    tty.c_cc[VTIME] = 1;                            /* wait for (n * 0.1) seconds before returning */
+    /* blocking: return as soon as some bytes are available, without inter-byte timer, so that ACKs
+       can be read with large buffered reads; non-blocking: wait for 0.1 second before returning */
+    tty.c_cc[VMIN] = (blocking == true) ? 1 : 0;
+    tty.c_cc[VTIME] = (blocking == true) ? 0 : 1;
 
     /* Set attributes */
     if (tcsetattr(fd, TCSANOW, &tty) != 0) {
@@ -129,11 +158,10 @@ int set_blocking_linux(int fd, bool blocking) {
     return LGW_USB_SUCCESS;
 }
 
-/* -------------------------------------------------------------------------- */
-/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_usb_open(const char * com_path, void **com_target_ptr) {
-    int *usb_device = NULL;
+/* Open and configure the tty, and check the MCU, the SX1302 is left as it is */
+static int usb_mcu_connect(const char * com_path) {
     char portname[50];
     int x;
     int fd;
@@ -142,6 +170,82 @@ int lgw_usb_open(const char * com_path, void **com_target_ptr) {
     uint8_t data;
     ssize_t n;
 
+    /* open tty port */
+    sprintf(portname, "%s", com_path);
+    fd = open(portname, O_RDWR | O_NOCTTY | O_SYNC);
+    if (fd < 0) {
+        printf("ERROR: failed to open COM port %s - %s\n", portname, strerror(errno));
+        return -1;
+    }
+
+    printf("INFO: Configuring TTY\n");
+    x = set_interface_attribs_linux(fd, B115200);
+    if (x != 0) {
+        printf("ERROR: failed to configure COM port %s\n", portname);
+        close(fd);
+        return -1;
+    }
+
+    /* flush tty port before setting it as blocking */
+    printf("INFO: Flushing TTY\n");
+    do {
+        n = read(fd, &data, 1);
+        if (n > 0) {
+            printf("NOTE: flushing serial port (0x%2X)\n", data);
+        }
+    } while (n > 0);
+    mcu_rx_reset();
+
+    /* set tty port blocking */
+    printf("INFO: Setting TTY in blocking mode\n");
+    x = set_blocking_linux(fd, true);
+    if (x != 0) {
+        printf("ERROR: failed to configure COM port %s\n", portname);
+        close(fd);
+        return -1;
+    }
+
+    /* Initialize pseudo-random generator for MCU request ID */
+    srand(0);
+
+    /* Check MCU version (ignore first char of the received version (release/debug) */
+    printf("INFO: Connect to MCU\n");
+    if (mcu_ping(fd, &gw_info) != 0) {
+        printf("ERROR: failed to ping the concentrator MCU\n");
+        close(fd);
+        return -1;
+    }
+    if (strncmp(gw_info.version + 1, mcu_version_string, sizeof mcu_version_string) != 0) {
+        printf("WARNING: MCU version mismatch (expected:%s, got:%s)\n", mcu_version_string, gw_info.version);
+    }
+    printf("INFO: Concentrator MCU version is %s\n", gw_info.version);
+
+    /* Get MCU status */
+    if (mcu_get_status(fd, &mcu_status) != 0) {
+        printf("ERROR: failed to get status from the concentrator MCU\n");
+        close(fd);
+        return -1;
+    }
+    printf("INFO: MCU status: sys_time:%u temperature:%.1foC\n", mcu_status.system_time_ms, mcu_status.temperature);
+
+    /* Let several requests be in flight, to overlap USB transfers and MCU processing */
+    if (mcu_set_pipeline_depth(fd, LGW_USB_PIPELINE_DEPTH) != 0) {
+        printf("ERROR: failed to set MCU pipeline depth\n");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_usb_open(const char * com_path, void **com_target_ptr) {
+    int *usb_device = NULL;
+    int x;
+    int fd;
+
     /*check input variables*/
     CHECK_NULL(com_target_ptr);
 
@@ -151,80 +255,51 @@ int lgw_usb_open(const char * com_path, void **com_target_ptr) {
         return LGW_USB_ERROR;
     }
 
-    /* open tty port */
-    sprintf(portname, "%s", com_path);
-    fd = open(portname, O_RDWR | O_NOCTTY | O_SYNC);
+    fd = usb_mcu_connect(com_path);
     if (fd < 0) {
-        printf("ERROR: failed to open COM port %s - %s\n", portname, strerror(errno));
-    } else {
-        printf("INFO: Configuring TTY\n");
-        x = set_interface_attribs_linux(fd, B115200);
-        if (x != 0) {
-            printf("ERROR: failed to configure COM port %s\n", portname);
-            free(usb_device);
-            return LGW_USB_ERROR;
-        }
+        free(usb_device);
+        return LGW_USB_ERROR;
+    }
+    *usb_device = fd;
+    *com_target_ptr = (void*)usb_device;
 
-        /* flush tty port before setting it as blocking */
-        printf("INFO: Flushing TTY\n");
-        do {
-            n = read(fd, &data, 1);
-            if (n > 0) {
-                printf("NOTE: flushing serial port (0x%2X)\n", data);
-            }
-        } while (n > 0);
-
-        /* set tty port blocking */
-        printf("INFO: Setting TTY in blocking mode\n");
-        x = set_blocking_linux(fd, true);
-        if (x != 0) {
-            printf("ERROR: failed to configure COM port %s\n", portname);
-            free(usb_device);
-            return LGW_USB_ERROR;
-        }
+    /* Reset SX1302 */
+    x  = mcu_gpio_write(fd, 0, 1, 1); /*   set PA1 : POWER_EN */
+    x |= mcu_gpio_write(fd, 0, 2, 1); /*   set PA2 : SX1302_RESET active */
+    x |= mcu_gpio_write(fd, 0, 2, 0); /* unset PA2 : SX1302_RESET inactive */
+    /* Reset SX1261 (LBT / Spectral Scan) */
+    x |= mcu_gpio_write(fd, 0, 8, 0); /*   set PA8 : SX1261_NRESET active */
+    x |= mcu_gpio_write(fd, 0, 8, 1); /* unset PA8 : SX1261_NRESET inactive */
+    if (x != 0) {
+        printf("ERROR: failed to reset SX1302\n");
+        free(usb_device);
+        return LGW_USB_ERROR;
+    }
 
-        *usb_device = fd;
-        *com_target_ptr = (void*)usb_device;
+    return LGW_USB_SUCCESS;
+}
 
-        /* Initialize pseudo-random generator for MCU request ID */
-        srand(0);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-        /* Check MCU version (ignore first char of the received version (release/debug) */
-        printf("INFO: Connect to MCU\n");
-        if (mcu_ping(fd, &gw_info) != 0) {
-            printf("ERROR: failed to ping the concentrator MCU\n");
-            return LGW_USB_ERROR;
-        }
-        if (strncmp(gw_info.version + 1, mcu_version_string, sizeof mcu_version_string) != 0) {
-            printf("WARNING: MCU version mismatch (expected:%s, got:%s)\n", mcu_version_string, gw_info.version);
-        }
-        printf("INFO: Concentrator MCU version is %s\n", gw_info.version);
+int lgw_usb_reopen(const char * com_path, void *com_target) {
+    int fd;
 
-        /* Get MCU status */
-        if (mcu_get_status(fd, &mcu_status) != 0) {
-            printf("ERROR: failed to get status from the concentrator MCU\n");
-            return LGW_USB_ERROR;
-        }
-        printf("INFO: MCU status: sys_time:%u temperature:%.1foC\n", mcu_status.system_time_ms, mcu_status.temperature);
-
-        /* Reset SX1302 */
-        x  = mcu_gpio_write(fd, 0, 1, 1); /*   set PA1 : POWER_EN */
-        x |= mcu_gpio_write(fd, 0, 2, 1); /*   set PA2 : SX1302_RESET active */
-        x |= mcu_gpio_write(fd, 0, 2, 0); /* unset PA2 : SX1302_RESET inactive */
-        /* Reset SX1261 (LBT / Spectral Scan) */
-        x |= mcu_gpio_write(fd, 0, 8, 0); /*   set PA8 : SX1261_NRESET active */
-        x |= mcu_gpio_write(fd, 0, 8, 1); /* unset PA8 : SX1261_NRESET inactive */
-        if (x != 0) {
-            printf("ERROR: failed to reset SX1302\n");
-            free(usb_device);
-            return LGW_USB_ERROR;
-        }
+    /* check input variables */
+    CHECK_NULL(com_target);
 
-        return LGW_USB_SUCCESS;
+    /* the SX1302 is not reset, it keeps its configuration and firmwares if it stayed powered */
+    close(*(int *)com_target);
+    *(int *)com_target = -1;
+    _lgw_write_mode = LGW_COM_WRITE_MODE_SINGLE;
+    _lgw_spi_req_nb = 0;
+
+    fd = usb_mcu_connect(com_path);
+    if (fd < 0) {
+        return LGW_USB_ERROR;
     }
+    *(int *)com_target = fd;
 
-    free(usb_device);
-    return LGW_USB_ERROR;
+    return LGW_USB_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -308,10 +383,10 @@ int lgw_usb_rmw(void *com_target, uint16_t address, uint8_t offs, uint8_t leng,
     in_out_buf[5] = data << offs;
 
     if (_lgw_write_mode == LGW_COM_WRITE_MODE_BULK) {
-        a = mcu_spi_store(in_out_buf, command_size);
-        _lgw_spi_req_nb += 1;
+        a = spi_req_store(usb_device, in_out_buf, command_size, NULL, 0);
     } else {
-        a = mcu_spi_write(usb_device, in_out_buf, command_size);
+        /* no data to read back, the ACK is checked later if requests are pipelined */
+        a = mcu_spi_post(usb_device, in_out_buf, command_size);
     }
 
     /* determine return code */
@@ -329,9 +404,7 @@ int lgw_usb_rmw(void *com_target, uint16_t address, uint8_t offs, uint8_t leng,
 /* Burst (multiple-byte) write */
 int lgw_usb_wb(void *com_target, uint8_t spi_mux_target, uint16_t address, const uint8_t *data, uint16_t size) {
     int usb_device;
-    uint16_t command_size = size + 8; /* 5 bytes: REQ metadata (MCU), 3 bytes: SPI header (SX1302) */
-    uint8_t in_out_buf[command_size];
-    int i;
+    uint8_t in_out_buf[8]; /* 5 bytes: REQ metadata (MCU), 3 bytes: SPI header (SX1302) */
     int a = 0;
 
     /* check input parameters */
@@ -351,15 +424,13 @@ int lgw_usb_wb(void *com_target, uint8_t spi_mux_target, uint16_t address, const
     in_out_buf[5] = spi_mux_target; /* SX1302 -> RADIO_A or RADIO_B */
     in_out_buf[6] = 0x80 | ((address >> 8) & 0x7F);
     in_out_buf[7] =        ((address >> 0) & 0xFF);
-    for (i = 0; i < size; i++) {
-        in_out_buf[i + 8] = data[i];
-    }
 
+    /* the payload is sent from the caller buffer, without copy */
     if (_lgw_write_mode == LGW_COM_WRITE_MODE_BULK) {
-        a = mcu_spi_store(in_out_buf, command_size);
-        _lgw_spi_req_nb += 1;
+        a = spi_req_store(usb_device, in_out_buf, sizeof in_out_buf, data, size);
     } else {
-        a = mcu_spi_write(usb_device, in_out_buf, command_size);
+        /* no data to read back, the ACK is checked later if requests are pipelined */
+        a = mcu_spi_post_sg(usb_device, in_out_buf, sizeof in_out_buf, data, size);
     }
 
     /* determine return code */
@@ -377,9 +448,7 @@ int lgw_usb_wb(void *com_target, uint8_t spi_mux_target, uint16_t address, const
 /* Burst (multiple-byte) read */
 int lgw_usb_rb(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t size) {
     int usb_device;
-    uint16_t command_size = size + 9;  /* 5 bytes: REQ metadata (MCU), 3 bytes: SPI header (SX1302), 1 byte: dummy*/
-    uint8_t in_out_buf[command_size];
-    int i;
+    uint8_t in_out_buf[9];  /* 5 bytes: REQ metadata (MCU), 3 bytes: SPI header (SX1302), 1 byte: dummy*/
     int a = 0;
 
     /* check input parameters */
@@ -400,16 +469,14 @@ int lgw_usb_rb(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8
     in_out_buf[6] = 0x00 | ((address >> 8) & 0x7F);
     in_out_buf[7] =        ((address >> 0) & 0xFF);
     in_out_buf[8] = 0x00; /* dummy byte */
-    for (i = 0; i < size; i++) {
-        in_out_buf[i + 9] = data[i];
-    }
 
     if (_lgw_write_mode == LGW_COM_WRITE_MODE_BULK) {
         /* makes no sense to read in bulk mode, as we can't get the result */
         printf("ERROR: USB READ BURST FAILURE - bulk mode is enabled\n");
         return -1;
     } else {
-        a = mcu_spi_write(usb_device, in_out_buf, command_size);
+        /* the caller buffer is clocked out as SPI payload, and receives the answer in place */
+        a = mcu_spi_write_sg(usb_device, in_out_buf, sizeof in_out_buf, data, size);
     }
 
     /* determine return code */
@@ -418,13 +485,72 @@ int lgw_usb_rb(void *com_target, uint8_t spi_mux_target, uint16_t address, uint8
         return -1;
     } else {
         DEBUG_MSG("Note: USB read burst success\n");
-        memcpy(data, in_out_buf + 9, size); /* remove the first bytes, keep only the payload */
         return 0;
     }
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_usb_rb_multi(void *com_target, struct lgw_com_rb_s * req, uint8_t nb_req) {
+    int usb_device;
+    uint8_t in_out_buf[LGW_USB_BURST_CHUNK];
+    uint16_t command_size = 0;
+    uint16_t offset;
+    int i;
+
+    /* check input parameters */
+    CHECK_NULL(com_target);
+    CHECK_NULL(req);
+
+    if (_lgw_write_mode == LGW_COM_WRITE_MODE_BULK) {
+        /* makes no sense to read in bulk mode, as we can't get the result */
+        printf("ERROR: USB READ MULTIPLE FAILURE - bulk mode is enabled\n");
+        return -1;
+    }
+
+    usb_device = *(int *)com_target;
+
+    /* prepare command: one SPI request per read, same layout as lgw_usb_rb */
+    for (i = 0; i < nb_req; i++) {
+        CHECK_NULL(req[i].data);
+        if ((command_size + req[i].size + 9) > LGW_USB_BURST_CHUNK) {
+            printf("ERROR: USB READ MULTIPLE FAILURE - requests too large (%u bytes)\n", command_size + req[i].size + 9);
+            return -1;
+        }
+        offset = command_size;
+        /* Request metadata */
+        in_out_buf[offset + 0] = (uint8_t)i; /* Req ID */
+        in_out_buf[offset + 1] = MCU_SPI_REQ_TYPE_READ_WRITE; /* Req type */
+        in_out_buf[offset + 2] = MCU_SPI_TARGET_SX1302; /* MCU -> SX1302 */
+        in_out_buf[offset + 3] = (uint8_t)((req[i].size + 4) >> 8); /* payload size + spi_mux_target + address + dummy byte */
+        in_out_buf[offset + 4] = (uint8_t)((req[i].size + 4) >> 0); /* payload size + spi_mux_target + address + dummy byte */
+        /* RAW SPI frame */
+        in_out_buf[offset + 5] = req[i].spi_mux_target; /* SX1302 -> RADIO_A or RADIO_B */
+        in_out_buf[offset + 6] = 0x00 | ((req[i].address >> 8) & 0x7F);
+        in_out_buf[offset + 7] =        ((req[i].address >> 0) & 0xFF);
+        in_out_buf[offset + 8] = 0x00; /* dummy byte */
+        memset(in_out_buf + offset + 9, 0, req[i].size);
+        command_size += req[i].size + 9;
+    }
+
+    if (mcu_spi_write(usb_device, in_out_buf, command_size) != 0) {
+        DEBUG_MSG("ERROR: USB READ MULTIPLE FAILURE\n");
+        return -1;
+    }
+
+    /* the ACK has the same layout as the request, extract the payloads */
+    offset = 0;
+    for (i = 0; i < nb_req; i++) {
+        memcpy(req[i].data, in_out_buf + offset + 9, req[i].size);
+        offset += req[i].size + 9;
+    }
+
+    DEBUG_MSG("Note: USB read multiple success\n");
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_usb_set_write_mode(lgw_com_write_mode_t write_mode) {
     if (write_mode >= LGW_COM_WRITE_MODE_UNKNOWN) {
         printf("ERROR: wrong write mode\n");
@@ -22,6 +22,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "sx1250_com.h"
 #include "sx1250_spi.h"
 #include "sx1250_usb.h"
+#include "loragw_replay.h"
+#include "loragw_sim.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -57,12 +59,20 @@ int sx1250_com_w(lgw_com_type_t com_type, void *com_target, uint8_t spi_mux_targ
         case LGW_COM_USB:
             com_stat = sx1250_usb_w(com_target, spi_mux_target, op_code, data, size);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(com_target, LGW_REPLAY_SX1250_W, spi_mux_target, (uint16_t)op_code, data, size);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_radio_cmd(com_target, spi_mux_target, (uint8_t)op_code, data, size, false);
+            break;
         default:
             printf("ERROR: wrong communication type (SHOULD NOT HAPPEN)\n");
             com_stat = LGW_COM_ERROR;
             break;
     }
 
+    lgw_replay_log(LGW_REPLAY_SX1250_W, spi_mux_target, (uint16_t)op_code, data, size, com_stat);
+
     return com_stat;
 }
 
@@ -82,12 +92,66 @@ int sx1250_com_r(lgw_com_type_t com_type, void *com_target, uint8_t spi_mux_targ
         case LGW_COM_USB:
             com_stat = sx1250_usb_r(com_target, spi_mux_target, op_code, data, size);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(com_target, LGW_REPLAY_SX1250_R, spi_mux_target, (uint16_t)op_code, data, size);
+            break;
+        case LGW_COM_SIM:
+            com_stat = lgw_sim_radio_cmd(com_target, spi_mux_target, (uint8_t)op_code, data, size, true);
+            break;
         default:
             printf("ERROR: wrong communication type (SHOULD NOT HAPPEN)\n");
             com_stat = LGW_COM_ERROR;
             break;
     }
 
+    lgw_replay_log(LGW_REPLAY_SX1250_R, spi_mux_target, (uint16_t)op_code, data, size, com_stat);
+
+    return com_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1250_com_set_write_mode(lgw_com_type_t com_type, lgw_com_write_mode_t write_mode) {
+    int com_stat = LGW_COM_SUCCESS;
+
+    switch (com_type) {
+        case LGW_COM_SPI:
+        case LGW_COM_REPLAY:
+        case LGW_COM_SIM:
+            /* Do nothing: only single mode is supported on SPI, replayed and simulated accesses are not grouped */
+            break;
+        case LGW_COM_USB:
+            com_stat = sx1250_usb_set_write_mode(write_mode);
+            break;
+        default:
+            printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
+            com_stat = LGW_COM_ERROR;
+            break;
+    }
+
+    return com_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1250_com_flush(lgw_com_type_t com_type, void *com_target) {
+    int com_stat = LGW_COM_SUCCESS;
+
+    switch (com_type) {
+        case LGW_COM_SPI:
+        case LGW_COM_REPLAY:
+        case LGW_COM_SIM:
+            /* Do nothing: only single mode is supported on SPI, replayed and simulated accesses are not grouped */
+            break;
+        case LGW_COM_USB:
+            com_stat = sx1250_usb_flush(com_target);
+            break;
+        default:
+            printf("ERROR(%s:%d): wrong communication type (SHOULD NOT HAPPEN)\n", __FUNCTION__, __LINE__);
+            com_stat = LGW_COM_ERROR;
+            break;
+    }
+
     return com_stat;
 }
 
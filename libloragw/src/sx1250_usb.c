@@ -43,6 +43,14 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define WAIT_BUSY_SX1250_MS  1
 
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static lgw_com_write_mode_t _sx1250_write_mode_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = LGW_COM_WRITE_MODE_SINGLE };
+static uint8_t _sx1250_spi_req_nb_board[LGW_BOARD_NB_MAX] = { 0 };
+#define _sx1250_write_mode  _sx1250_write_mode_board[lgw_board_cur]
+#define _sx1250_spi_req_nb  _sx1250_spi_req_nb_board[lgw_board_cur]
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -59,12 +67,15 @@ int sx1250_usb_w(void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_c
 
     usb_device = *(int *)com_target;
 
-    /* wait BUSY */
-    wait_ms(WAIT_BUSY_SX1250_MS);
+    /* wait BUSY, not seen by the host: the commands stored are sent back to back by the MCU,
+       bulk mode is only for the commands with a short BUSY (no mode change) */
+    if (_sx1250_write_mode != LGW_COM_WRITE_MODE_BULK) {
+        wait_ms(WAIT_BUSY_SX1250_MS);
+    }
 
     /* prepare command */
     /* Request metadata */
-    in_out_buf[0] = 0; /* Req ID */
+    in_out_buf[0] = _sx1250_spi_req_nb; /* Req ID */
     in_out_buf[1] = MCU_SPI_REQ_TYPE_READ_WRITE; /* Req type */
     in_out_buf[2] = MCU_SPI_TARGET_SX1302; /* MCU -> SX1302 */
     in_out_buf[3] = (uint8_t)((size + 2) >> 8); /* payload size + spi_mux_target + op_code */
@@ -75,7 +86,24 @@ int sx1250_usb_w(void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_c
     for (i = 0; i < size; i++) {
         in_out_buf[i + 7] = data[i];
     }
-    a = mcu_spi_write(usb_device, in_out_buf, command_size);
+
+    if (_sx1250_write_mode == LGW_COM_WRITE_MODE_BULK) {
+        /* send the pending requests first if the buffer is full, stay in bulk mode */
+        if (command_size > mcu_spi_bulk_room()) {
+            DEBUG_MSG("INFO: SX1250 USB write buffer full, flushing\n");
+            a = mcu_spi_flush(usb_device);
+            _sx1250_spi_req_nb = 0;
+            if (a != 0) {
+                printf("ERROR: Failed to flush sx1250 USB write buffer\n");
+                return -1;
+            }
+            in_out_buf[0] = _sx1250_spi_req_nb; /* Req ID */
+        }
+        a = mcu_spi_store(in_out_buf, command_size);
+        _sx1250_spi_req_nb += 1;
+    } else {
+        a = mcu_spi_write(usb_device, in_out_buf, command_size);
+    }
 
     /* determine return code */
     if (a != 0) {
@@ -102,6 +130,12 @@ int sx1250_usb_r(void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_c
 
     usb_device = *(int *)com_target;
 
+    if (_sx1250_write_mode == LGW_COM_WRITE_MODE_BULK) {
+        /* makes no sense to read in bulk mode, as we can't get the result */
+        printf("ERROR: USB SX1250 READ FAILURE - bulk mode is enabled\n");
+        return -1;
+    }
+
     /* wait BUSY */
     wait_ms(WAIT_BUSY_SX1250_MS);
 
@@ -131,4 +165,54 @@ int sx1250_usb_r(void *com_target, uint8_t spi_mux_target, sx1250_op_code_t op_c
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1250_usb_set_write_mode(lgw_com_write_mode_t write_mode) {
+    if (write_mode >= LGW_COM_WRITE_MODE_UNKNOWN) {
+        printf("ERROR: %s: wrong write mode\n", __FUNCTION__);
+        return -1;
+    }
+
+    DEBUG_PRINTF("INFO: setting SX1250 USB write mode to %s\n", (write_mode == LGW_COM_WRITE_MODE_SINGLE) ? "SINGLE" : "BULK");
+
+    _sx1250_write_mode = write_mode;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1250_usb_flush(void *com_target) {
+    int usb_device;
+    int a = 0;
+
+    /* Check input parameters */
+    CHECK_NULL(com_target);
+    if (_sx1250_write_mode != LGW_COM_WRITE_MODE_BULK) {
+        printf("ERROR: %s: cannot flush in single write mode\n", __FUNCTION__);
+        return -1;
+    }
+
+    /* Restore single mode after flushing */
+    _sx1250_write_mode = LGW_COM_WRITE_MODE_SINGLE;
+
+    if (_sx1250_spi_req_nb == 0) {
+        DEBUG_MSG("INFO: no SX1250 SPI request to flush\n");
+        return 0;
+    }
+
+    usb_device = *(int *)com_target;
+
+    DEBUG_MSG("INFO: flushing SX1250 USB write buffer\n");
+    a = mcu_spi_flush(usb_device);
+    if (a != 0) {
+        printf("ERROR: Failed to flush sx1250 USB write buffer\n");
+    }
+
+    /* reset the pending request number */
+    _sx1250_spi_req_nb = 0;
+
+    return a;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
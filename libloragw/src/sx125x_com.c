@@ -20,6 +20,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include "sx125x_com.h"
 #include "sx125x_spi.h"
+#include "loragw_replay.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -61,14 +62,22 @@ int sx125x_com_r(lgw_com_type_t com_type, void *com_target, uint8_t spi_mux_targ
         case LGW_COM_SPI:
             com_stat = sx125x_spi_r(com_target, spi_mux_target, address, data);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(com_target, LGW_REPLAY_SX125X_R, spi_mux_target, address, data, 1);
+            break;
         case LGW_COM_USB:
             printf("ERROR: USB COM type is not supported for sx125x\n");
             return -1;
+        case LGW_COM_SIM:
+            printf("ERROR: SIM COM type is not supported for sx125x\n");
+            return -1;
         default:
             printf("ERROR: wrong communication type (SHOULD NOT HAPPEN)\n");
             return -1;
     }
 
+    lgw_replay_log(LGW_REPLAY_SX125X_R, spi_mux_target, address, data, 1, com_stat);
+
     return com_stat;
 }
 
@@ -84,14 +93,22 @@ int sx125x_com_w(lgw_com_type_t com_type, void *com_target, uint8_t spi_mux_targ
         case LGW_COM_SPI:
             com_stat = sx125x_spi_w(com_target, spi_mux_target, address, data);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(com_target, LGW_REPLAY_SX125X_W, spi_mux_target, address, &data, 1);
+            break;
         case LGW_COM_USB:
             printf("ERROR: USB COM type is not supported for sx125x\n");
             return -1;
+        case LGW_COM_SIM:
+            printf("ERROR: SIM COM type is not supported for sx125x\n");
+            return -1;
         default:
             printf("ERROR: wrong communication type (SHOULD NOT HAPPEN)\n");
             return -1;
     }
 
+    lgw_replay_log(LGW_REPLAY_SX125X_W, spi_mux_target, address, &data, 1, com_stat);
+
     return com_stat;
 }
 
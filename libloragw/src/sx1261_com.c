@@ -24,6 +24,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "sx1261_com.h"
 #include "sx1261_spi.h"
 #include "sx1261_usb.h"
+#include "loragw_replay.h"
+#include "loragw_aux.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -46,14 +48,16 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
 /**
-@brief The current communication type in use (SPI, USB)
+@brief The current communication type in use (SPI, USB, REPLAY)
 */
-static lgw_com_type_t _sx1261_com_type = LGW_COM_UNKNOWN;
+static lgw_com_type_t _sx1261_com_type_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = LGW_COM_UNKNOWN };
+#define _sx1261_com_type _sx1261_com_type_board[lgw_board_cur]
 
 /**
 @brief A generic pointer to the COM device (file descriptor)
 */
-static void* _sx1261_com_target = NULL;
+static void* _sx1261_com_target_board[LGW_BOARD_NB_MAX] = { NULL };
+#define _sx1261_com_target _sx1261_com_target_board[lgw_board_cur]
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
@@ -77,7 +81,8 @@ int sx1261_com_open(lgw_com_type_t com_type, const char *com_path) {
             DEBUG_PRINTF("SX1261: connected with SPI %s\n", com_path);
             break;
         case LGW_COM_USB:
-            /* the USB link has already been opened (lgw_connect) */
+        case LGW_COM_REPLAY:
+            /* the USB link (or trace) has already been opened (lgw_connect) */
             _sx1261_com_target = lgw_com_target();
             DEBUG_MSG("SX1261: connected with USB\n");
             break;
@@ -104,6 +109,7 @@ int sx1261_com_close(void) {
             }
             break;
         case LGW_COM_USB:
+        case LGW_COM_REPLAY:
             break;
         default:
             printf("ERROR: %s: sx1261 not connected\n", __FUNCTION__);
@@ -120,6 +126,9 @@ int sx1261_com_close(void) {
 
 int sx1261_com_w(sx1261_op_code_t op_code, uint8_t *data, uint16_t size) {
     int com_stat;
+    uint64_t ts;
+
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_sx1261_com_target);
@@ -132,12 +141,18 @@ int sx1261_com_w(sx1261_op_code_t op_code, uint8_t *data, uint16_t size) {
         case LGW_COM_USB:
             com_stat = sx1261_usb_w(_sx1261_com_target, op_code, data, size);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_sx1261_com_target, LGW_REPLAY_SX1261_W, 0, (uint16_t)op_code, data, size);
+            break;
         default:
             printf("ERROR: wrong communication type (SHOULD NOT HAPPEN)\n");
             com_stat = LGW_COM_ERROR;
             break;
     }
 
+    lgw_com_stats_update(_sx1261_com_type, LGW_COM_STATS_SX1261, LGW_COM_STATS_WB, size, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_SX1261_W, 0, (uint16_t)op_code, data, size, com_stat);
+
     return com_stat;
 }
 
@@ -145,6 +160,9 @@ int sx1261_com_w(sx1261_op_code_t op_code, uint8_t *data, uint16_t size) {
 
 int sx1261_com_r(sx1261_op_code_t op_code, uint8_t *data, uint16_t size) {
     int com_stat;
+    uint64_t ts;
+
+    ts = lgw_com_stats_start();
 
     /* Check input parameters */
     CHECK_NULL(_sx1261_com_target);
@@ -157,12 +175,18 @@ int sx1261_com_r(sx1261_op_code_t op_code, uint8_t *data, uint16_t size) {
         case LGW_COM_USB:
             com_stat = sx1261_usb_r(_sx1261_com_target, op_code, data, size);
             break;
+        case LGW_COM_REPLAY:
+            com_stat = lgw_replay_xfer(_sx1261_com_target, LGW_REPLAY_SX1261_R, 0, (uint16_t)op_code, data, size);
+            break;
         default:
             printf("ERROR: wrong communication type (SHOULD NOT HAPPEN)\n");
             com_stat = LGW_COM_ERROR;
             break;
     }
 
+    lgw_com_stats_update(_sx1261_com_type, LGW_COM_STATS_SX1261, LGW_COM_STATS_RB, size, ts, com_stat);
+    lgw_replay_log(LGW_REPLAY_SX1261_R, 0, (uint16_t)op_code, data, size, com_stat);
+
     return com_stat;
 }
 
@@ -173,7 +197,8 @@ int sx1261_com_set_write_mode(lgw_com_write_mode_t write_mode) {
 
     switch (_sx1261_com_type) {
         case LGW_COM_SPI:
-            /* Do nothing: only single mode is supported on SPI */
+        case LGW_COM_REPLAY:
+            /* Do nothing: only single mode is supported on SPI, and replayed accesses are not grouped */
             break;
         case LGW_COM_USB:
             com_stat = sx1261_usb_set_write_mode(write_mode);
@@ -194,7 +219,8 @@ int sx1261_com_flush(void) {
 
     switch (_sx1261_com_type) {
         case LGW_COM_SPI:
-            /* Do nothing: only single mode is supported on SPI */
+        case LGW_COM_REPLAY:
+            /* Do nothing: only single mode is supported on SPI, and replayed accesses are not grouped */
             break;
         case LGW_COM_USB:
             com_stat = sx1261_usb_flush(_sx1261_com_target);
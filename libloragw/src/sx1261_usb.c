@@ -44,8 +44,10 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-static lgw_com_write_mode_t _sx1261_write_mode = LGW_COM_WRITE_MODE_SINGLE;
-static uint8_t _sx1261_spi_req_nb = 0;
+static lgw_com_write_mode_t _sx1261_write_mode_board[LGW_BOARD_NB_MAX] = { [0 ... LGW_BOARD_NB_MAX - 1] = LGW_COM_WRITE_MODE_SINGLE };
+static uint8_t _sx1261_spi_req_nb_board[LGW_BOARD_NB_MAX] = { 0 };
+#define _sx1261_write_mode  _sx1261_write_mode_board[lgw_board_cur]
+#define _sx1261_spi_req_nb  _sx1261_spi_req_nb_board[lgw_board_cur]
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
@@ -77,6 +79,17 @@ int sx1261_usb_w(void *com_target, sx1261_op_code_t op_code, uint8_t *data, uint
     }
 
     if (_sx1261_write_mode == LGW_COM_WRITE_MODE_BULK) {
+        /* send the pending requests first if the buffer is full, stay in bulk mode */
+        if (command_size > mcu_spi_bulk_room()) {
+            DEBUG_MSG("INFO: SX1261 USB write buffer full, flushing\n");
+            a = mcu_spi_flush(usb_device);
+            _sx1261_spi_req_nb = 0;
+            if (a != 0) {
+                printf("ERROR: Failed to flush sx1261 USB write buffer\n");
+                return -1;
+            }
+            in_out_buf[0] = _sx1261_spi_req_nb; /* Req ID */
+        }
         a = mcu_spi_store(in_out_buf, command_size);
         _sx1261_spi_req_nb += 1;
     } else {
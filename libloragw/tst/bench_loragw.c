@@ -0,0 +1,542 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Micro-benchmarks of the HAL, without hardware: time on air, timestamp
+    correction, and the parsing of the RX buffer on packet mixes generated by
+    the simulated concentrator, or recorded to a capture file (-R).
+
+    The rx_buffer_pop cases parse again and again a block fetched once from
+    the simulated RX buffer. The hal cases run lgw_receive on the simulated
+    concentrator and report the profiling probes of the HAL (see loragw_perf):
+    sx1302_parse and merge_packets only depend on the host, receive and
+    sx1302_fetch also include the simulated bus accesses.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, fopen, fread */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memset, memcmp, strcmp */
+#include <unistd.h>     /* getopt */
+
+#include "loragw_hal.h"
+#include "loragw_reg.h"
+#include "loragw_aux.h"
+#include "loragw_perf.h"
+#include "loragw_rxrec.h"
+#include "loragw_sx1302_rx.h"
+#include "loragw_sx1302_timestamp.h"
+#include "bench.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_PKT_MIX          64      /* packets cycled through by the ToA and timestamp cases */
+#define NB_BLOCK_MAX        64      /* blocks of the RX buffer parsed by a rx_buffer_pop case */
+#define HAL_PKT_NB          256     /* default number of packets received in a sample of the hal cases */
+#define HAL_FILL_MS         100     /* time to fill the simulated RX buffer before capturing it */
+#define RX_PKT_NB           255
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct mix_s {
+    const char * name;
+    const char * profile;   /* traffic profile of the simulated concentrator, see loragw_sim.h */
+    bool ftime;             /* fine timestamping enabled, the packets are then merged */
+};
+
+struct blocks_s {
+    int nb;
+    rx_buffer_t block[NB_BLOCK_MAX];
+    uint8_t pkt_nb[NB_BLOCK_MAX];   /* number of packets of each block */
+};
+
+struct ts_mix_s {
+    lgw_context_t * context;
+    uint8_t datarate[NB_PKT_MIX];
+    uint8_t coderate[NB_PKT_MIX];
+    bool crc_en[NB_PKT_MIX];
+    uint8_t size[NB_PKT_MIX];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const struct mix_s mixes[] = {
+    { "sf7",            "rate=5000,sf=7,size=16-24",                            false },
+    { "sf7-12",         "rate=5000,sf=7:6/8:3/9-12:1,size=16-51",               false },
+    { "large",          "rate=5000,sf=7-9,size=200-255",                        false },
+    { "crc_bad",        "rate=5000,sf=7-12,size=16-51,crc_bad=30",              false },
+    { "sf7-12_ftime",   "rate=5000,sf=7:6/8:3/9-12:1,size=16-51,chip=sx1303",   true }
+};
+
+/* same channel plan as test_loragw_hal_rx */
+static const int32_t channel_if[8] = { -400000, -200000, 0, -400000, -200000, 0, 200000, 400000 };
+static const uint8_t channel_rfchain[8] = { 1, 1, 1, 0, 0, 0, 0, 0 };
+
+/* profiling probes reported by the hal cases */
+static const char * hal_probe[] = { "receive", "sx1302_fetch", "sx1302_parse", "merge_packets" };
+
+static struct lgw_pkt_tx_s toa_pkt[NB_PKT_MIX];
+static struct ts_mix_s ts_mix;
+static lgw_context_t ts_context;
+static struct blocks_s blocks;
+static struct lgw_pkt_rx_s rxpkt[RX_PKT_NB];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("~~~ Library version string~~~\n");
+    printf(" %s\n", lgw_version_info());
+    printf("~~~ Available options ~~~\n");
+    printf(" -h            Print this help\n");
+    printf(" -S <options>  Also run the RX cases on this traffic profile of the simulated concentrator, eg. rate=5000,sf=10\n");
+    printf(" -R <path>     Also run rx_buffer_pop on the blocks of a RX buffer capture file (see loragw_rxrec.h)\n");
+    printf(" -p <uint>     Number of packets received in a sample of the hal cases, default %u\n", HAL_PKT_NB);
+    bench_usage();
+}
+
+/* Count the complete packets of a block, from its start, and set it up to be parsed */
+static int block_setup(rx_buffer_t * b) {
+    rx_packet_t pkt;
+    int nb = 0;
+
+    b->buffer_index = 0;
+    b->buffer_pkt_nb = 255;
+    while (rx_buffer_pop(b, &pkt) == LGW_REG_SUCCESS) {
+        nb += 1;
+    }
+    b->buffer_index = 0;
+    b->buffer_pkt_nb = nb;
+
+    return nb;
+}
+
+static int blocks_load(struct blocks_s * bl, const char * path) {
+    FILE * file;
+    struct lgw_rxrec_file_hdr_s fhdr;
+    struct lgw_rxrec_hdr_s hdr;
+    rx_buffer_t * b;
+    int nb;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("ERROR: failed to open %s\n", path);
+        return -1;
+    }
+    if ((fread(&fhdr, sizeof fhdr, 1, file) != 1) || (memcmp(fhdr.magic, LGW_RXREC_MAGIC, sizeof fhdr.magic) != 0) || (fhdr.endian != LGW_RXREC_ENDIAN)) {
+        printf("ERROR: %s is not a RX buffer capture of this host\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    /* The blocks starting with the end of a packet split by the fetch are skipped */
+    bl->nb = 0;
+    while ((bl->nb < NB_BLOCK_MAX) && (fread(&hdr, sizeof hdr, 1, file) == 1)) {
+        b = &bl->block[bl->nb];
+        rx_buffer_new(b);
+        if ((hdr.size > sizeof b->buffer) || (fread(b->buffer, hdr.size, 1, file) != 1)) {
+            break;
+        }
+        b->buffer_size = hdr.size;
+        nb = block_setup(b);
+        if (nb > 0) {
+            bl->pkt_nb[bl->nb] = nb;
+            bl->nb += 1;
+        }
+    }
+    fclose(file);
+
+    if (bl->nb == 0) {
+        printf("ERROR: no packet found in %s\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int hal_start(const char * profile, bool ftime) {
+    int i;
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    struct lgw_conf_ftime_s ftimeconf;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 0;
+    boardconf.com_type = LGW_COM_SIM;
+    strncpy(boardconf.com_path, profile, sizeof boardconf.com_path);
+    boardconf.com_path[sizeof boardconf.com_path - 1] = '\0'; /* ensure string termination */
+    if (lgw_board_setconf(&boardconf) != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to configure board\n");
+        return -1;
+    }
+
+    for (i = 0; i < 2; i++) {
+        memset(&rfconf, 0, sizeof rfconf);
+        rfconf.enable = true;
+        rfconf.freq_hz = (i == 0) ? 867500000 : 868500000;
+        rfconf.type = LGW_RADIO_TYPE_SX1250;
+        if (lgw_rxrf_setconf(i, &rfconf) != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to configure rxrf %d\n", i);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < 8; i++) {
+        memset(&ifconf, 0, sizeof ifconf);
+        ifconf.enable = true;
+        ifconf.rf_chain = channel_rfchain[i];
+        ifconf.freq_hz = channel_if[i];
+        ifconf.datarate = DR_LORA_SF7;
+        if (lgw_rxif_setconf(i, &ifconf) != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to configure rxif %d\n", i);
+            return -1;
+        }
+    }
+
+    memset(&ftimeconf, 0, sizeof ftimeconf);
+    ftimeconf.enable = ftime;
+    ftimeconf.mode = LGW_FTIME_MODE_ALL_SF;
+    if (lgw_ftime_setconf(&ftimeconf) != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to configure fine timestamping\n");
+        return -1;
+    }
+
+    if (lgw_start() != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to start the gateway\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Fetch the simulated RX buffer once it is full */
+static int hal_capture(struct blocks_s * bl) {
+    rx_buffer_t * b;
+    int nb;
+
+    bl->nb = 0;
+    while (bl->nb < NB_BLOCK_MAX) {
+        wait_ms(HAL_FILL_MS);
+        b = &bl->block[bl->nb];
+        if ((rx_buffer_new(b) != LGW_REG_SUCCESS) || (rx_buffer_fetch(b) != LGW_REG_SUCCESS)) {
+            printf("ERROR: failed to fetch the RX buffer\n");
+            return -1;
+        }
+        nb = block_setup(b);
+        if (nb > 0) {
+            bl->pkt_nb[bl->nb] = nb;
+            bl->nb += 1;
+            break;
+        }
+    }
+
+    return (bl->nb > 0) ? 0 : -1;
+}
+
+/* Receive packets, and report the mean duration of the HAL probes in each sample */
+static int hal_run(const struct bench_conf_s * conf, const char * mix, unsigned pkt_nb) {
+    struct lgw_perf_probe_s probes[LGW_PERF_PROBE_NB_MAX];
+    double ns_per_op[ARRAY_SIZE(hal_probe)][BENCH_SAMPLE_NB_MAX];
+    uint64_t ops[ARRAY_SIZE(hal_probe)];
+    unsigned s, k, nb_pkt;
+    int i, j, nb;
+    char name[64];
+
+    memset(ops, 0, sizeof ops);
+    lgw_perf_enable(true);
+    for (s = 0; s < (conf->warmup + conf->samples); s++) {
+        lgw_perf_reset();
+        nb_pkt = 0;
+        while (nb_pkt < pkt_nb) {
+            if (lgw_receive_wait(100) < 0) {
+                lgw_perf_enable(false);
+                return -1;
+            }
+            nb = lgw_receive(RX_PKT_NB, rxpkt);
+            if (nb < 0) {
+                printf("ERROR: failed to receive\n");
+                lgw_perf_enable(false);
+                return -1;
+            }
+            nb_pkt += nb;
+        }
+        if (s < conf->warmup) {
+            continue;
+        }
+
+        nb = lgw_perf_get(probes, LGW_PERF_PROBE_NB_MAX);
+        for (k = 0; k < ARRAY_SIZE(hal_probe); k++) {
+            ns_per_op[k][s - conf->warmup] = 0;
+            for (i = 0; i < nb; i++) {
+                if ((strcmp(probes[i].name, hal_probe[k]) == 0) && (probes[i].count > 0)) {
+                    ns_per_op[k][s - conf->warmup] = (double)probes[i].sum_ns / (double)probes[i].count;
+                    ops[k] += probes[i].count;
+                }
+            }
+        }
+    }
+    lgw_perf_enable(false);
+
+    for (k = 0; k < ARRAY_SIZE(hal_probe); k++) {
+        j = snprintf(name, sizeof name, "hal/%s/%s", mix, hal_probe[k]);
+        if ((j < (int)sizeof name) && (ops[k] > 0) && bench_selected(conf, name)) {
+            bench_report(conf, name, ns_per_op[k], conf->samples, ops[k]);
+        }
+    }
+
+    return 0;
+}
+
+static uint64_t case_toa(void * arg, uint64_t nb) {
+    const struct lgw_pkt_tx_s * pkt = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += lgw_time_on_air(pkt);
+    }
+
+    return nb;
+}
+
+static uint64_t case_toa_mix(void * arg, uint64_t nb) {
+    uint64_t i;
+
+    (void)arg;
+    for (i = 0; i < nb; i++) {
+        bench_sink += lgw_time_on_air(&toa_pkt[i % NB_PKT_MIX]);
+    }
+
+    return nb;
+}
+
+static uint64_t case_ts_corr(void * arg, uint64_t nb) {
+    const struct ts_mix_s * m = arg;
+    uint64_t i;
+    int k;
+
+    for (i = 0; i < nb; i++) {
+        k = i % NB_PKT_MIX;
+        bench_sink += timestamp_counter_correction(m->context, BW_125KHZ, m->datarate[k], m->coderate[k], m->crc_en[k], m->size[k], RX_DFT_PEAK_MODE_AUTO);
+    }
+
+    return nb;
+}
+
+static uint64_t case_rx_buffer_pop(void * arg, uint64_t nb) {
+    struct blocks_s * bl = arg;
+    rx_packet_t pkt;
+    rx_buffer_t * b;
+    uint64_t i, nb_pkt = 0;
+
+    for (i = 0; i < nb; i++) {
+        b = &bl->block[i % bl->nb];
+        b->buffer_index = 0;
+        b->buffer_pkt_nb = bl->pkt_nb[i % bl->nb];
+        while (rx_buffer_pop(b, &pkt) == LGW_REG_SUCCESS) {
+            bench_sink += pkt.rxbytenb_modem + pkt.timestamp_cnt;
+            nb_pkt += 1;
+        }
+    }
+
+    return nb_pkt;
+}
+
+/* Check if one of the RX cases of a mix is selected, the simulated concentrator is only started for them */
+static bool rx_selected(const struct bench_conf_s * conf, const char * mix) {
+    char name[64];
+    unsigned k;
+
+    snprintf(name, sizeof name, "rx_buffer_pop/%s", mix);
+    if (bench_selected(conf, name)) {
+        return true;
+    }
+    for (k = 0; k < ARRAY_SIZE(hal_probe); k++) {
+        snprintf(name, sizeof name, "hal/%s/%s", mix, hal_probe[k]);
+        if (bench_selected(conf, name)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int run_rx(const struct bench_conf_s * conf, const char * mix, const char * profile, bool ftime, unsigned pkt_nb) {
+    char name[64];
+    int err;
+
+    if (hal_start(profile, ftime) != 0) {
+        return -1;
+    }
+    err = hal_capture(&blocks);
+    if (err == 0) {
+        snprintf(name, sizeof name, "rx_buffer_pop/%s", mix);
+        err = bench_run(conf, name, case_rx_buffer_pop, &blocks);
+    }
+    if (err == 0) {
+        err = hal_run(conf, mix, pkt_nb);
+    }
+    lgw_stop();
+
+    return err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, err;
+    unsigned k, arg_u;
+    unsigned pkt_nb = HAL_PKT_NB;
+    const char * profile = NULL;
+    const char * capture = NULL;
+    struct lgw_pkt_tx_s pkt;
+    struct bench_conf_s conf;
+
+    bench_init(&conf, "libloragw");
+    while ((i = getopt(argc, argv, "hS:R:p:" BENCH_OPTIONS)) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return -1;
+            case 'S':
+                profile = optarg;
+                break;
+            case 'R':
+                capture = optarg;
+                break;
+            case 'p':
+                if ((sscanf(optarg, "%u", &arg_u) != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -p argument\n");
+                    return EXIT_FAILURE;
+                }
+                pkt_nb = arg_u;
+                break;
+            default:
+                if (bench_option(&conf, i, optarg) != 0) {
+                    printf("ERROR: argument parsing\n");
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+        }
+    }
+
+    /* Downlinks of the LoRaWAN datarates, and a few FSK ones */
+    srand(0);
+    for (i = 0; i < NB_PKT_MIX; i++) {
+        memset(&toa_pkt[i], 0, sizeof toa_pkt[i]);
+        toa_pkt[i].preamble = 8;
+        toa_pkt[i].size = 12 + (rand() % 52);
+        if ((i % 16) == 15) {
+            toa_pkt[i].modulation = MOD_FSK;
+            toa_pkt[i].datarate = 50000;
+            toa_pkt[i].f_dev = 25;
+            toa_pkt[i].preamble = 5;
+        } else {
+            toa_pkt[i].modulation = MOD_LORA;
+            toa_pkt[i].bandwidth = ((i % 8) == 7) ? BW_500KHZ : BW_125KHZ;
+            toa_pkt[i].datarate = DR_LORA_SF7 + (rand() % 6);
+            toa_pkt[i].coderate = CR_LORA_4_5;
+        }
+    }
+
+    /* Uplinks on the 8 multi-SF channels: the precomputed corrections cover all of them */
+    memset(&ts_context, 0, sizeof ts_context);
+    for (i = 0; i < 8; i++) {
+        ts_context.if_chain_cfg[i].enable = true;
+        ts_context.if_chain_cfg[i].freq_hz = channel_if[i];
+    }
+    ts_mix.context = &ts_context;
+    for (i = 0; i < NB_PKT_MIX; i++) {
+        ts_mix.datarate[i] = DR_LORA_SF7 + (rand() % 6);
+        ts_mix.coderate[i] = CR_LORA_4_5 + (rand() % 4);
+        ts_mix.crc_en[i] = ((rand() % 8) != 0);
+        ts_mix.size[i] = 16 + (rand() % 40);
+    }
+
+    bench_begin(&conf);
+
+    memset(&pkt, 0, sizeof pkt);
+    pkt.modulation = MOD_LORA;
+    pkt.bandwidth = BW_125KHZ;
+    pkt.coderate = CR_LORA_4_5;
+    pkt.preamble = 8;
+    pkt.size = 20;
+    pkt.datarate = DR_LORA_SF7;
+    bench_run(&conf, "toa/lora/sf7_20", case_toa, &pkt);
+    pkt.datarate = DR_LORA_SF12;
+    pkt.size = 51;
+    bench_run(&conf, "toa/lora/sf12_51", case_toa, &pkt);
+    pkt.modulation = MOD_FSK;
+    pkt.datarate = 50000;
+    pkt.f_dev = 25;
+    pkt.preamble = 5;
+    pkt.size = 64;
+    bench_run(&conf, "toa/fsk/50k_64", case_toa, &pkt);
+    bench_run(&conf, "toa/mix", case_toa_mix, NULL);
+
+    timestamp_correction_table_free();
+    ts_context.ftime_cfg.enable = false;
+    bench_run(&conf, "timestamp_correction/legacy", case_ts_corr, &ts_mix);
+    ts_context.ftime_cfg.enable = true;
+    bench_run(&conf, "timestamp_correction/ftime", case_ts_corr, &ts_mix);
+    ts_context.ftime_cfg.enable = false;
+    timestamp_correction_table_init(&ts_context);
+    bench_run(&conf, "timestamp_correction/legacy_table", case_ts_corr, &ts_mix);
+    ts_context.ftime_cfg.enable = true;
+    timestamp_correction_table_init(&ts_context);
+    bench_run(&conf, "timestamp_correction/ftime_table", case_ts_corr, &ts_mix);
+    timestamp_correction_table_free();
+
+    if (capture != NULL) {
+        if (blocks_load(&blocks, capture) != 0) {
+            bench_end(&conf);
+            return EXIT_FAILURE;
+        }
+        bench_run(&conf, "rx_buffer_pop/capture", case_rx_buffer_pop, &blocks);
+    }
+
+    err = 0;
+    for (k = 0; (k < ARRAY_SIZE(mixes)) && (err == 0); k++) {
+        if (rx_selected(&conf, mixes[k].name)) {
+            err = run_rx(&conf, mixes[k].name, mixes[k].profile, mixes[k].ftime, pkt_nb);
+        }
+    }
+    if ((profile != NULL) && (err == 0) && rx_selected(&conf, "custom")) {
+        err = run_rx(&conf, "custom", profile, false, pkt_nb);
+    }
+    bench_end(&conf);
+
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
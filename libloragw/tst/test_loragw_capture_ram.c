@@ -25,8 +25,13 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include <stdio.h>      /* printf */
 #include <stdlib.h>
+#include <string.h>     /* memcpy */
 #include <signal.h>     /* sigaction */
 #include <getopt.h>     /* getopt_long */
+#include <time.h>       /* clock_gettime */
+#include <fcntl.h>      /* open, posix_fallocate */
+#include <unistd.h>     /* close, ftruncate */
+#include <sys/mman.h>   /* mmap, msync */
 
 #include "loragw_hal.h"
 #include "loragw_com.h"
@@ -36,6 +41,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_sx125x.h"
 #include "loragw_sx1302.h"
 
+#include "test_loragw_capture_ram.h"
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
@@ -44,7 +51,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define COM_TYPE_DEFAULT LGW_COM_SPI
 #define COM_PATH_DEFAULT "/dev/spidev0.0"
 
-#define CAPTURE_RAM_SIZE 0x4000
+#define STREAM_NB_BLOCK_DEFAULT 1024 /* 16 MB of capture */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
@@ -66,6 +73,9 @@ void usage(void)
     printf(" -d [path] Path to the SPI interface (USB is not supported)\n");
     printf("            => default path: " COM_PATH_DEFAULT "\n");
     printf(" -s <uint> Capture source [0..31]\n");
+    printf(" -o <path> Stream the captures to a binary file, see test_loragw_capture_ram.h\n");
+    printf(" -n <uint> Number of captures to be streamed, the file is preallocated\n");
+    printf("            => default: %u\n", STREAM_NB_BLOCK_DEFAULT);
 }
 
 /* handle signals */
@@ -79,17 +89,126 @@ static void sig_handler(int sigio)
     }
 }
 
+/* launch a capture, and wait for it to be complete */
+static int capture_run(bool poll_delay) {
+    int32_t val = 0;
+
+    lgw_reg_w(SX1302_REG_CAPTURE_RAM_CAPTURE_CFG_CAPTURESTART, 1);
+    do {
+        lgw_reg_r(SX1302_REG_CAPTURE_RAM_STATUS_CAPCOMPLETE, &val);
+        if (poll_delay == true) {
+            wait_ms(10);
+        }
+        if ((quit_sig == 1) || (exit_sig == 1)) {
+            break;
+        }
+    } while (val != 1);
+    lgw_reg_w(SX1302_REG_CAPTURE_RAM_CAPTURE_CFG_CAPTURESTART, 0);
+
+    return (val == 1) ? 0 : -1;
+}
+
+/* read the capture RAM, with bursts as long as the interface allows */
+static void capture_read(uint8_t * buf) {
+    lgw_reg_w(SX1302_REG_COMMON_PAGE_PAGE, 1);
+    lgw_mem_rb(0, buf, CAPTURE_RAM_SIZE, false);
+    lgw_reg_w(SX1302_REG_COMMON_PAGE_PAGE, 0);
+}
+
+/* re-arm the capture until nb_block blocks are written to a memory-mapped file, or until a signal */
+static int capture_stream(const char * path, uint32_t nb_block, uint8_t capture_source) {
+    const size_t block_len = sizeof(struct capture_block_hdr_s) + CAPTURE_RAM_SIZE;
+    size_t file_len;
+    int fd;
+    uint8_t * map;
+    struct capture_file_hdr_s * file_hdr;
+    struct capture_block_hdr_s * block_hdr;
+    struct timespec start, now;
+    uint64_t count_us;
+    double elapsed;
+    uint32_t n;
+
+    /* preallocate the file, so that no block is written to a hole */
+    file_len = sizeof(struct capture_file_hdr_s) + (size_t)nb_block * block_len;
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("ERROR: failed to open the capture file");
+        return -1;
+    }
+    if (posix_fallocate(fd, 0, (off_t)file_len) != 0) {
+        fprintf(stderr, "ERROR: failed to allocate %zu bytes for the capture file\n", file_len);
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, file_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("ERROR: failed to map the capture file");
+        close(fd);
+        return -1;
+    }
+
+    file_hdr = (struct capture_file_hdr_s *)map;
+    memset(file_hdr, 0, sizeof *file_hdr);
+    memcpy(file_hdr->magic, CAPTURE_FILE_MAGIC, sizeof file_hdr->magic);
+    file_hdr->version = CAPTURE_FILE_VERSION;
+    file_hdr->endian = CAPTURE_FILE_ENDIAN;
+    file_hdr->hdr_size = sizeof(struct capture_file_hdr_s);
+    file_hdr->block_hdr_size = sizeof(struct capture_block_hdr_s);
+    file_hdr->block_size = CAPTURE_RAM_SIZE;
+    file_hdr->sampling_freq_hz = sampling_frequency[capture_source];
+    file_hdr->source = capture_source;
+    file_hdr->ram_config = 0;
+
+    /* the RAM is read straight into the file, the capture rate is bound by the bus */
+    printf("Streaming %u captures to %s...\n", nb_block, path);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < nb_block; n++) {
+        if (capture_run(false) != 0) {
+            break;
+        }
+        block_hdr = (struct capture_block_hdr_s *)(map + sizeof(struct capture_file_hdr_s) + (size_t)n * block_len);
+        clock_gettime(CLOCK_REALTIME, &now);
+        lgw_get_instcnt64(&count_us);
+        block_hdr->seq = n;
+        block_hdr->reserved = 0;
+        block_hdr->host_time_ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+        block_hdr->count_us = count_us;
+        capture_read((uint8_t *)(block_hdr + 1));
+        file_hdr->nb_block = n + 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_nsec - start.tv_nsec) / 1E9;
+
+    /* drop the blocks preallocated but not written */
+    file_len = sizeof(struct capture_file_hdr_s) + (size_t)n * block_len;
+    msync(map, file_len, MS_SYNC);
+    munmap(map, sizeof(struct capture_file_hdr_s) + (size_t)nb_block * block_len);
+    if (ftruncate(fd, (off_t)file_len) != 0) {
+        perror("WARNING: failed to truncate the capture file");
+    }
+    close(fd);
+
+    printf("%u captures in %.3f s", n, elapsed);
+    if (elapsed > 0) {
+        printf(" (%.1f captures/s, %.1f kB/s)", n / elapsed, n * (CAPTURE_RAM_SIZE / 1024.0) / elapsed);
+    }
+    printf("\n");
+
+    return 0;
+}
+
 /* Main program */
 int main(int argc, char **argv)
 {
     int i;
-    int32_t val = 0;
     int reg_stat;
     unsigned int arg_u;
     uint8_t capture_source = 0;
     uint16_t period_value = 0;
     int16_t real = 0, imag = 0;
     uint8_t capture_ram_buffer[CAPTURE_RAM_SIZE];
+    const char * stream_path = NULL;
+    uint32_t stream_nb_block = STREAM_NB_BLOCK_DEFAULT;
 
     static struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
 
@@ -105,7 +224,7 @@ int main(int argc, char **argv)
     };
 
     /* parse command line options */
-    while ((i = getopt_long (argc, argv, "h:s:d:", long_options, &option_index)) != -1) {
+    while ((i = getopt_long (argc, argv, "h:s:d:o:n:", long_options, &option_index)) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -128,6 +247,20 @@ int main(int argc, char **argv)
                 }
                 break;
 
+            case 'o': /* <path> Stream file */
+                stream_path = optarg;
+                break;
+
+            case 'n': /* <uint> Number of captures streamed */
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                } else {
+                    stream_nb_block = arg_u;
+                }
+                break;
+
             default:
                 printf("ERROR: argument parsing\n");
                 usage();
@@ -181,29 +314,22 @@ int main(int argc, char **argv)
     // lgw_reg_r(SX1302_REG_CAPTURE_RAM_CAPTURE_PERIOD_1_CAPTUREPERIOD, &val);
     // fprintf(stdout, "SX1302_REG_CAPTURE_RAM_CAPTURE_PERIOD_1_CAPTUREPERIOD value: %d\n", val);
 
-    /* Launch capture */
-    lgw_reg_w(SX1302_REG_CAPTURE_RAM_CAPTURE_CFG_CAPTURESTART, 1);
-    // lgw_reg_w(SX1302_REG_CAPTURE_RAM_CAPTURE_CFG_CAPTUREFORCETRIGGER, 1);
-
-    /* Poll Status.CapComplete */
-    do {
-        lgw_reg_r(SX1302_REG_CAPTURE_RAM_STATUS_CAPCOMPLETE, &val);
+    if (stream_path != NULL) {
+        i = capture_stream(stream_path, stream_nb_block, capture_source);
+        lgw_disconnect();
+        return (i == 0) ? 0 : -1;
+    }
 
-        wait_ms(10);
-        if ((quit_sig == 1) || (exit_sig == 1)) {
-            break;
-        }
-    } while (val != 1);
-    lgw_reg_w(SX1302_REG_CAPTURE_RAM_CAPTURE_CFG_CAPTURESTART, 0);
+    /* Launch capture, and poll Status.CapComplete */
+    capture_run(true);
+    // lgw_reg_w(SX1302_REG_CAPTURE_RAM_CAPTURE_CFG_CAPTUREFORCETRIGGER, 1);
 
     // lgw_reg_r(SX1302_REG_CAPTURE_RAM_LAST_RAM_ADDR_0_LASTRAMADDR, &val);
     // fprintf(stdout, "SX1302_REG_CAPTURE_RAM_LAST_RAM_ADDR_0_LASTRAMADDR value: %02x\n", val);
     // lgw_reg_r(SX1302_REG_CAPTURE_RAM_LAST_RAM_ADDR_1_LASTRAMADDR, &val);
     // fprintf(stdout, "SX1302_REG_CAPTURE_RAM_LAST_RAM_ADDR_1_LASTRAMADDR value: %02x\n", val);
 
-    lgw_reg_w(SX1302_REG_COMMON_PAGE_PAGE, 1);
-    lgw_mem_rb(0, capture_ram_buffer, CAPTURE_RAM_SIZE, false);
-    lgw_reg_w(SX1302_REG_COMMON_PAGE_PAGE, 0);
+    capture_read(capture_ram_buffer);
 
     printf("Data:\n");
     for (i = 0; i < CAPTURE_RAM_SIZE; i += 4) {
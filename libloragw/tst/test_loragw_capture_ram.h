@@ -0,0 +1,63 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Format of the files written by the streaming mode of test_loragw_capture_ram
+
+    The file starts with a capture_file_hdr_s, followed by nb_block blocks
+    made of a capture_block_hdr_s and of the block_size raw bytes of the
+    capture RAM, as read from address 0. All the fields are in the byte order
+    of the host which wrote the file, given by the endian field.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _TEST_LORAGW_CAPTURE_RAM_H
+#define _TEST_LORAGW_CAPTURE_RAM_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define CAPTURE_RAM_SIZE        0x4000
+
+#define CAPTURE_FILE_MAGIC      "LGWCAPT"   /* NUL included, 8 bytes */
+#define CAPTURE_FILE_VERSION    1
+#define CAPTURE_FILE_ENDIAN     0x01020304  /* reads 0x04030201 in the other byte order */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct capture_file_hdr_s {
+    char magic[8];              /* CAPTURE_FILE_MAGIC */
+    uint32_t version;           /* CAPTURE_FILE_VERSION */
+    uint32_t endian;            /* CAPTURE_FILE_ENDIAN, written by the host */
+    uint32_t hdr_size;          /* size of this header, offset of the first block */
+    uint32_t block_hdr_size;    /* size of the header of each block */
+    uint32_t block_size;        /* raw bytes of each block, CAPTURE_RAM_SIZE */
+    uint32_t nb_block;          /* blocks written, complete ones only */
+    uint32_t sampling_freq_hz;  /* sampling frequency of the capture source */
+    uint8_t source;             /* capture source [0..31] */
+    uint8_t ram_config;         /* 0: 4kx32, 1: 2kx64 */
+    uint8_t reserved[2];
+};
+
+struct capture_block_hdr_s {
+    uint32_t seq;               /* index of the block, from 0 */
+    uint32_t reserved;
+    int64_t host_time_ns;       /* CLOCK_REALTIME when the capture was complete, in ns */
+    uint64_t count_us;          /* concentrator counter when the capture was complete, 0 if not running */
+};
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
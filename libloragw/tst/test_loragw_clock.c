@@ -0,0 +1,208 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Simulate a drifting concentrator clock synchronized on GPS PPS, and compare
+    the counter extrapolated after PPS dropouts by the clock estimator and by
+    the single-point reference of lgw_gps_sync
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memset */
+#include <math.h>       /* sqrt, log, cos */
+#include <getopt.h>     /* getopt_long */
+
+#include "loragw_hal.h"
+#include "loragw_gps.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_SYNC_INIT    600         /* seconds of PPS before the dropout */
+#define GPS_START       1300000000  /* GPS time of the first PPS */
+#define LEAP_SECONDS    18
+#define DRIFT_INIT      1.5         /* ppm, initial frequency error of the simulated oscillator */
+#define DRIFT_WALK      1E-3        /* ppm/sqrt(s), frequency random walk of the simulated oscillator */
+#define PPS_JITTER      0.3         /* us, standard deviation of the PPS capture */
+
+static const int holdover[] = {10, 30, 60, 300, 600, 1200}; /* seconds */
+#define NB_HOLDOVER     (int)(sizeof holdover / sizeof holdover[0])
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* simulated oscillator */
+static double sim_phase; /* exact counter value, unwrapped, in us */
+static double sim_drift; /* ppm */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Library version information: %s\n", lgw_version_info());
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  Number of simulated dropouts, default 100\n");
+}
+
+static double gauss(void) {
+    double u1 = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+    double u2 = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/* advance the simulated oscillator by one second */
+static void sim_step(void) {
+    sim_phase += 1E6 + sim_drift;
+    sim_drift += DRIFT_WALK * gauss();
+}
+
+/* counter captured by the concentrator on PPS */
+static uint32_t sim_capture(void) {
+    return (uint32_t)(uint64_t)llround(sim_phase + PPS_JITTER * gauss());
+}
+
+static void sim_times(long t, struct timespec * utc, struct timespec * gps) {
+    gps->tv_sec = GPS_START + t;
+    gps->tv_nsec = 0;
+    utc->tv_sec = gps->tv_sec + 315964800 - LEAP_SECONDS;
+    utc->tv_nsec = 0;
+}
+
+/* counter error at GPS time, as extrapolated from a reference */
+static double extrapolation_error(struct tref ref, long t) {
+    struct timespec utc, gps;
+    uint32_t cnt;
+
+    sim_times(t, &utc, &gps);
+    if (lgw_gps2cnt(ref, gps, &cnt) != LGW_GPS_SUCCESS) {
+        return 1E9;
+    }
+
+    return (double)(int32_t)(cnt - (uint32_t)(uint64_t)llround(sim_phase));
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, h;
+    unsigned int arg_u;
+    unsigned r, nb_runs = 100;
+    unsigned nb_err = 0;
+    long t;
+    uint32_t cnt;
+    struct timespec utc, gps;
+    struct lgw_clock_s clk;
+    struct tref ref_clk, ref_sync;
+    double err_clk[NB_HOLDOVER], err_sync[NB_HOLDOVER], sigma[NB_HOLDOVER];
+    double e;
+
+    /* parse command line options */
+    while ((i = getopt(argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return -1;
+                break;
+            case 'n':
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                } else {
+                    nb_runs = arg_u;
+                }
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### Clock estimator simulation, %d s of PPS then dropout ###\n", NB_SYNC_INIT);
+
+    srand(0);
+    memset(err_clk, 0, sizeof err_clk);
+    memset(err_sync, 0, sizeof err_sync);
+    for (r = 0; r < nb_runs; r++) {
+        sim_phase = (double)rand() * 64.0; /* the counter wraps during the simulation */
+        sim_drift = DRIFT_INIT;
+        lgw_clock_init(&clk);
+        memset(&ref_sync, 0, sizeof ref_sync);
+
+        /* synchronization on every PPS, with one aberrant capture to be rejected */
+        for (t = 0; t < NB_SYNC_INIT; t++) {
+            sim_times(t, &utc, &gps);
+            cnt = sim_capture();
+            if (t == (NB_SYNC_INIT / 2)) {
+                if (lgw_clock_update(&clk, cnt + 500, utc, gps) == LGW_GPS_SUCCESS) {
+                    nb_err += 1;
+                }
+            } else if (lgw_clock_update(&clk, cnt, utc, gps) != LGW_GPS_SUCCESS) {
+                nb_err += 1;
+            }
+            lgw_gps_sync(&ref_sync, cnt, utc, gps);
+            if (t < (NB_SYNC_INIT - 1)) {
+                sim_step();
+            }
+        }
+        lgw_clock_tref(&clk, &ref_clk);
+
+        /* PPS lost, the references are extrapolated */
+        i = 0;
+        for (t = NB_SYNC_INIT - 1, h = 0; h < NB_HOLDOVER; ) {
+            sim_step();
+            t += 1;
+            if (t == (NB_SYNC_INIT - 1 + holdover[h])) {
+                e = extrapolation_error(ref_clk, t);
+                err_clk[h] += e * e;
+                e = extrapolation_error(ref_sync, t);
+                err_sync[h] += e * e;
+                sigma[h] = lgw_clock_error_us(&clk, holdover[h]);
+                h += 1;
+            }
+        }
+    }
+
+    printf("holdover    estimator (predicted)    lgw_gps_sync\n");
+    for (h = 0; h < NB_HOLDOVER; h++) {
+        err_clk[h] = sqrt(err_clk[h] / nb_runs);
+        err_sync[h] = sqrt(err_sync[h] / nb_runs);
+        printf("%6d s    %8.2f us (%6.2f)     %10.2f us\n", holdover[h], err_clk[h], sigma[h], err_sync[h]);
+    }
+
+    /* the estimator must stay within a few us for a minute, and do better than the single-point reference */
+    if ((err_clk[2] > 2.0) || (err_clk[NB_HOLDOVER - 1] > err_sync[NB_HOLDOVER - 1])) {
+        nb_err += 1;
+    }
+    printf("check: %u errors\n", nb_err);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
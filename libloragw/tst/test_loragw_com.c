@@ -7,7 +7,7 @@
   (C)2019 Semtech
 
 Description:
-    Minimum test program for the loragw_com module
+    Minimum test program for the loragw_com module, and transport benchmark
 
 License: Revised BSD License, see LICENSE.TXT file include in the project
 */
@@ -35,6 +35,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_com.h"
 #include "loragw_aux.h"
 #include "loragw_hal.h"
+#include "loragw_reg.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -54,6 +55,10 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define COM_TYPE_DEFAULT LGW_COM_SPI
 #define COM_PATH_DEFAULT "/dev/spidev0.0"
 
+#define BENCH_NB_DEFAULT    100     /* operations per benchmark result */
+#define BENCH_BULK_REQ_MAX  254     /* write requests queued per bulk transfer */
+#define BENCH_FIFO_CHUNK_NB 4       /* FIFO reads sweep up to this number of chunks */
+
 /* -------------------------------------------------------------------------- */
 /* --- GLOBAL VARIABLES ----------------------------------------------------- */
 
@@ -71,6 +76,7 @@ static uint8_t * read_buff = NULL;
 static void sig_handler(int sigio);
 static void usage(void);
 static void exit_failure(void);
+static void bench_run(uint16_t max_buff_size, unsigned nb);
 
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
@@ -80,6 +86,8 @@ int main(int argc, char ** argv)
     static struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
 
     uint16_t max_buff_size;
+    unsigned bench_nb = 0; /* 0 when not in benchmark mode */
+    unsigned arg_u;
     uint8_t data = 0;
     int cycle_number = 0;
     int i, x;
@@ -91,7 +99,7 @@ int main(int argc, char ** argv)
     lgw_com_type_t com_type = COM_TYPE_DEFAULT;
 
     /* Parse command line options */
-    while ((i = getopt(argc, argv, "hd:u")) != -1) {
+    while ((i = getopt(argc, argv, "hd:uS:bn:")) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -108,6 +116,25 @@ int main(int argc, char ** argv)
                 com_type = LGW_COM_USB;
                 break;
 
+            case 'S':
+                com_type = LGW_COM_SIM;
+                com_path = optarg;
+                break;
+
+            case 'b':
+                if (bench_nb == 0) {
+                    bench_nb = BENCH_NB_DEFAULT;
+                }
+                break;
+
+            case 'n':
+                if ((sscanf(optarg, "%u", &arg_u) != 1) || (arg_u == 0)) {
+                    printf("ERROR: argument parsing of -n argument, use -h option for help\n");
+                    return EXIT_FAILURE;
+                }
+                bench_nb = arg_u;
+                break;
+
             default:
                 printf("ERROR: argument parsing options, use -h option for help\n");
                 usage();
@@ -180,8 +207,12 @@ int main(int argc, char ** argv)
         exit_failure();
     }
 
+    if (bench_nb > 0) {
+        bench_run(max_buff_size, bench_nb);
+    }
+
     /* databuffer R/W stress test */
-    while ((quit_sig != 1) && (exit_sig != 1)) {
+    while ((bench_nb == 0) && (quit_sig != 1) && (exit_sig != 1)) {
         /*************************************************
          *
          *      WRITE BURST TEST
@@ -414,6 +445,126 @@ static void exit_failure(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+static double bench_elapsed_us(int64_t start_ns) {
+    return (double)(time_monotonic_ns() - start_ns) / 1000.0;
+}
+
+static void bench_print(const char * test, unsigned size, unsigned nb_op, double time_us, uint64_t nb_byte) {
+    /* one CSV line per result: test,size,nb_op,op_us,kB_s */
+    printf("bench,%s,%u,%u,%.2f,%.1f\n", test, size, nb_op, time_us / nb_op, (time_us > 0.0) ? (double)nb_byte * 1000.0 / time_us : 0.0);
+    fflush(stdout);
+}
+
+static void bench_run(uint16_t max_buff_size, unsigned nb) {
+    const uint16_t chunk_size = lgw_com_chunk_size();
+    const uint16_t burst_max = MIN(chunk_size, max_buff_size);
+    uint32_t fifo_max;
+    uint8_t * fifo_buff;
+    uint8_t data;
+    uint16_t size, nb_req;
+    unsigned n, i;
+    int64_t t;
+    int x = 0;
+
+    printf("Transport benchmark, chunk size %u, %u operations per result\n", chunk_size, nb);
+    printf("# bench,test,size,nb_op,op_us,kB_s\n");
+
+    /* single register accesses */
+    t = time_monotonic_ns();
+    for (n = 0; (n < nb) && (x == 0); n++) {
+        x = lgw_com_w(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM, (uint8_t)n);
+    }
+    bench_print("reg_w", 1, nb, bench_elapsed_us(t), nb);
+    t = time_monotonic_ns();
+    for (n = 0; (n < nb) && (x == 0); n++) {
+        x = lgw_com_r(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM, &data);
+    }
+    bench_print("reg_r", 1, nb, bench_elapsed_us(t), nb);
+    t = time_monotonic_ns();
+    for (n = 0; (n < nb) && (x == 0); n++) {
+        x = lgw_com_rmw(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM, 2, 3, (uint8_t)(n & 0x07));
+    }
+    bench_print("reg_rmw", 1, nb, bench_elapsed_us(t), nb);
+    if (x != 0) {
+        printf("ERROR (%d): failed to access register\n", __LINE__);
+        exit_failure();
+    }
+
+    /* burst accesses, from 1 byte to the chunk size, checked on the last loop */
+    for (size = 1; (size <= burst_max) && (quit_sig != 1) && (exit_sig != 1); size = (size < burst_max) ? MIN(size * 2, burst_max) : (burst_max + 1)) {
+        for (i = 0; i < size; i++) {
+            test_buff[i] = rand() & 0xFF;
+        }
+        t = time_monotonic_ns();
+        for (n = 0; (n < nb) && (x == 0); n++) {
+            x = lgw_com_wb(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM, test_buff, size);
+        }
+        bench_print("burst_w", size, nb, bench_elapsed_us(t), (uint64_t)nb * size);
+        t = time_monotonic_ns();
+        for (n = 0; (n < nb) && (x == 0); n++) {
+            x = lgw_com_rb(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM, read_buff, size);
+        }
+        bench_print("burst_r", size, nb, bench_elapsed_us(t), (uint64_t)nb * size);
+        if ((x != 0) || (memcmp(test_buff, read_buff, size) != 0)) {
+            printf("ERROR (%d): %u-byte burst R/W failed\n", __LINE__, size);
+            exit_failure();
+        }
+    }
+
+    /* bulk mode writes, as many requests as fit in one transfer (USB only, single writes otherwise), an operation is one flush */
+    x = 0;
+    for (size = 1; (size <= (max_buff_size / 2)) && (x == 0) && (quit_sig != 1) && (exit_sig != 1); size *= 2) {
+        nb_req = MIN(BENCH_BULK_REQ_MAX, (max_buff_size / 2) / size);
+        for (i = 0; i < (unsigned)(nb_req * size); i++) {
+            test_buff[i] = rand() & 0xFF;
+        }
+        t = time_monotonic_ns();
+        for (n = 0; (n < nb) && (x == 0); n++) {
+            x = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK); /* restored to single by each flush */
+            for (i = 0; (i < nb_req) && (x == 0); i++) {
+                x = lgw_com_wb(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM + (i * size), test_buff + (i * size), size);
+            }
+            if (x == 0) {
+                x = lgw_com_flush();
+            }
+        }
+        bench_print("bulk_w", size, nb, bench_elapsed_us(t), (uint64_t)nb * nb_req * size);
+        if (x == 0) {
+            x = lgw_com_rb(LGW_SPI_MUX_TARGET_SX1302, SX1302_AGC_MCU_MEM, read_buff, nb_req * size);
+        }
+        if ((x != 0) || (memcmp(test_buff, read_buff, nb_req * size) != 0)) {
+            printf("ERROR (%d): %ux%u-byte bulk write failed\n", __LINE__, nb_req, size);
+            exit_failure();
+        }
+    }
+    if (lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE) != 0) {
+        printf("ERROR (%d): failed to set single write mode\n", __LINE__);
+        exit_failure();
+    }
+
+    /* FIFO mode memory reads, the address is not incremented between chunks */
+    fifo_max = MIN((uint32_t)chunk_size * BENCH_FIFO_CHUNK_NB, 0x8000);
+    fifo_buff = (uint8_t*)malloc(fifo_max);
+    if (fifo_buff == NULL) {
+        printf("ERROR: failed to allocate memory for fifo_buff - %s\n", strerror(errno));
+        exit_failure();
+    }
+    for (size = 1; (size <= fifo_max) && (x == 0) && (quit_sig != 1) && (exit_sig != 1); size = ((uint32_t)size * 2 <= fifo_max) ? (size * 2) : UINT16_MAX) {
+        t = time_monotonic_ns();
+        for (n = 0; (n < nb) && (x == 0); n++) {
+            x = lgw_mem_rb(SX1302_AGC_MCU_MEM, fifo_buff, size, true);
+        }
+        bench_print("fifo_r", size, nb, bench_elapsed_us(t), (uint64_t)nb * size);
+    }
+    free(fifo_buff);
+    if (x != 0) {
+        printf("ERROR (%d): failed to read memory\n", __LINE__);
+        exit_failure();
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static void usage(void) {
     printf("~~~ Library version string~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
     printf(" %s\n", lgw_version_info());
@@ -422,6 +573,10 @@ static void usage(void) {
     printf(" -u            set COM type as USB (default is SPI)\n");
     printf(" -d <path>     COM path to be used to connect the concentrator\n");
     printf("               => default path (SPI): " COM_PATH_DEFAULT "\n");
+    printf(" -S <options>  Use a simulated concentrator with the given traffic profile\n");
+    printf(" -b            Run the transport benchmark instead of the R/W stress test\n");
+    printf(" -n <uint>     Benchmark with the given number of operations per result (default %u, implies -b)\n", BENCH_NB_DEFAULT);
+    printf("               => results are printed as CSV lines: bench,test,size,nb_op,op_us,kB_s\n");
 }
 
 /* --- EOF ------------------------------------------------------------------ */
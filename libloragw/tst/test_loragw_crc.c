@@ -0,0 +1,174 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Check the table-driven CRC16 routines against bitwise references, and
+    measure their throughput
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <getopt.h>     /* getopt_long */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_hal.h"
+#include "loragw_sx1302.h"
+#include "crc16.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_BUFFERS      256
+#define BUFFER_SIZE     255
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t buffers[NB_BUFFERS][BUFFER_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+void usage(void) {
+    printf("Library version information: %s\n", lgw_version_info());
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <uint>  Number of benchmark rounds over %d buffers of %d bytes, default 1000\n", NB_BUFFERS, BUFFER_SIZE);
+}
+
+/* Bit-at-a-time LoRa payload CRC, as formerly computed by the HAL */
+static uint16_t ref_crc16_lora(const uint8_t * data, unsigned size) {
+    uint16_t x = 0x0000;
+    unsigned i, j;
+
+    for (i = 0; i < size; i++) {
+        for (j = 0; j < 8; j++) {
+            x = (x & 0x8000) ? (uint16_t)(x << 1) ^ 0x1021 : (uint16_t)(x << 1);
+        }
+        x ^= data[i];
+    }
+
+    return x;
+}
+
+/* Bit-at-a-time CRC-16/CCITT, as formerly computed by the packet forwarder for beacons */
+static uint16_t ref_crc16_ccitt(const uint8_t * data, unsigned size) {
+    uint16_t x = 0x0000;
+    unsigned i, j;
+
+    for (i = 0; i < size; i++) {
+        x ^= (uint16_t)data[i] << 8;
+        for (j = 0; j < 8; j++) {
+            x = (x & 0x8000) ? (uint16_t)(x << 1) ^ 0x1021 : (uint16_t)(x << 1);
+        }
+    }
+
+    return x;
+}
+
+static double bench(uint16_t (*crc)(const uint8_t *, unsigned), unsigned nb_rounds, uint16_t * acc) {
+    struct timespec start, stop;
+    unsigned r, b;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < nb_rounds; r++) {
+        for (b = 0; b < NB_BUFFERS; b++) {
+            *acc ^= crc(buffers[b], BUFFER_SIZE);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    return (double)(stop.tv_sec - start.tv_sec) * 1E9 + (double)(stop.tv_nsec - start.tv_nsec);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i;
+    unsigned int arg_u;
+    unsigned b, size;
+    unsigned nb_rounds = 1000;
+    unsigned nb_err = 0;
+    uint16_t acc = 0;
+    double bytes, t_ref, t_tab;
+
+    /* parse command line options */
+    while ((i = getopt(argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return -1;
+                break;
+            case 'n':
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument. Use -h to print help\n");
+                    return EXIT_FAILURE;
+                } else {
+                    nb_rounds = arg_u;
+                }
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### CRC16 check & benchmark ###\n");
+
+    srand(0);
+    for (b = 0; b < NB_BUFFERS; b++) {
+        for (size = 0; size < BUFFER_SIZE; size++) {
+            buffers[b][size] = (uint8_t)rand();
+        }
+    }
+
+    /* Check every payload size against the reference implementations */
+    for (b = 0; b < NB_BUFFERS; b++) {
+        for (size = 0; size <= BUFFER_SIZE; size++) {
+            if (sx1302_lora_payload_crc(buffers[b], (uint8_t)size) != ref_crc16_lora(buffers[b], size)) {
+                nb_err += 1;
+            }
+            if (crc16_ccitt(buffers[b], size) != ref_crc16_ccitt(buffers[b], size)) {
+                nb_err += 1;
+            }
+        }
+    }
+    printf("check: %u mismatches\n", nb_err);
+
+    bytes = (double)nb_rounds * NB_BUFFERS * BUFFER_SIZE;
+    t_ref = bench(ref_crc16_lora, nb_rounds, &acc);
+    t_tab = bench(crc16_lora, nb_rounds, &acc);
+    printf("LoRa payload CRC: bitwise %.2f ns/byte, table %.2f ns/byte (x%.1f)\n", t_ref / bytes, t_tab / bytes, t_ref / t_tab);
+    t_ref = bench(ref_crc16_ccitt, nb_rounds, &acc);
+    t_tab = bench(crc16_ccitt, nb_rounds, &acc);
+    printf("CCITT CRC:        bitwise %.2f ns/byte, table %.2f ns/byte (x%.1f)\n", t_ref / bytes, t_tab / bytes, t_ref / t_tab);
+    printf("(accumulator 0x%04X)\n", acc);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
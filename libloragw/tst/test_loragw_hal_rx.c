@@ -31,10 +31,14 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <signal.h>
 #include <math.h>
 #include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>   /* getrusage */
 
 #include "loragw_hal.h"
 #include "loragw_reg.h"
 #include "loragw_aux.h"
+#include "loragw_replay.h"
+#include "loragw_rxrec.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -50,12 +54,29 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define DEFAULT_FREQ_HZ     868500000U
 
+#define BENCH_BIN_NB        24  /* bin k > 0 holds the lgw_receive() durations in [2^(k-1), 2^k[ us */
+
+#define RXREC_FILE_SIZE_MAX 64000000U /* rotation of the RX buffer capture files */
+#define RXREC_FILE_NB       4
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
 static int exit_sig = 0; /* 1 -> application terminates cleanly (shut down hardware, close open files, etc) */
 static int quit_sig = 0; /* 1 -> application terminates without shutting down the hardware */
 
+/* aggregate results of the benchmark mode, over one report interval */
+static struct {
+    uint64_t nb_receive;
+    uint64_t recv_hist[BENCH_BIN_NB];
+    uint64_t recv_max_ns;
+    unsigned long nb_pkt;
+    unsigned long nb_crc_bad;
+    unsigned long nb_no_crc;
+    int64_t start_ns;
+    struct rusage usage;
+} bench;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
 
@@ -85,6 +106,95 @@ void usage(void) {
     printf(" -j            Set radio in single input mode (SX1250 only)\n");
     printf( "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
     printf(" --fdd         Enable Full-Duplex mode (CN490 reference design)\n");
+    printf(" --bench <uint> Only print aggregate results, every given number of seconds\n");
+    printf(" --reconf <uint> Move the IF frequency of channel 0 by 100kHz, back and forth, every given number of seconds\n");
+    printf(" --cursor      Walk the packets with lgw_receive_begin/next/end instead of lgw_receive (-z ignored)\n");
+    printf( "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
+    printf(" -R <path>     Record the COM traffic to a trace file (single start/stop loop)\n");
+    printf(" --rxrec <path> Record the raw RX buffer fetches to rotating capture files (see loragw_rxrec.h)\n");
+    printf(" -P <path>     Replay a trace file instead of connecting the concentrator\n");
+    printf(" -S <options>  Use a simulated concentrator with the given traffic profile (SX1250 only), eg. rate=100,sf=7-9\n");
+}
+
+static uint64_t cpu_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static double tv_diff_ms(const struct timeval * a, const struct timeval * b) {
+    return ((double)(a->tv_sec - b->tv_sec) * 1000.0) + ((double)(a->tv_usec - b->tv_usec) / 1000.0);
+}
+
+static void bench_restart(void) {
+    memset(&bench, 0, sizeof bench);
+    bench.start_ns = time_monotonic_ns();
+    getrusage(RUSAGE_SELF, &bench.usage);
+}
+
+static void bench_add(uint64_t recv_ns) {
+    int k;
+    uint64_t us = recv_ns / 1000;
+
+    k = (us == 0) ? 0 : (64 - __builtin_clzll(us));
+    if (k >= BENCH_BIN_NB) {
+        k = BENCH_BIN_NB - 1;
+    }
+    bench.recv_hist[k] += 1;
+    bench.recv_max_ns = MAX(bench.recv_max_ns, recv_ns);
+    bench.nb_receive += 1;
+}
+
+static void bench_add_pkt(const struct lgw_pkt_rx_s * pkt) {
+    bench.nb_pkt += 1;
+    if (pkt->status == STAT_CRC_BAD) {
+        bench.nb_crc_bad += 1;
+    } else if (pkt->status == STAT_NO_CRC) {
+        bench.nb_no_crc += 1;
+    }
+}
+
+/* upper bound of the bin holding the percentile, in us */
+static unsigned bench_percentile(unsigned per_mille) {
+    int k;
+    uint64_t acc = 0;
+
+    if (bench.nb_receive == 0) {
+        return 0;
+    }
+    for (k = 0; k < (BENCH_BIN_NB - 1); k++) {
+        acc += bench.recv_hist[k];
+        if ((acc * 1000) >= (bench.nb_receive * per_mille)) {
+            break;
+        }
+    }
+    if (k == (BENCH_BIN_NB - 1)) {
+        return (unsigned)(bench.recv_max_ns / 1000);
+    }
+
+    return (unsigned)MIN((k == 0) ? 1 : (1ULL << k), bench.recv_max_ns / 1000);
+}
+
+static void bench_report(void) {
+    struct rusage usage;
+    struct lgw_rx_stats_s rx_stats;
+    double elapsed_s;
+
+    elapsed_s = (double)(time_monotonic_ns() - bench.start_ns) / 1E9;
+    getrusage(RUSAGE_SELF, &usage);
+    if (lgw_get_rx_stats(&rx_stats, true) != LGW_HAL_SUCCESS) {
+        memset(&rx_stats, 0, sizeof rx_stats);
+    }
+
+    printf("%.1f pkt/s (%lu pkt, CRC_BAD:%lu NO_CRC:%lu, discarded:%u)", bench.nb_pkt / elapsed_s, bench.nb_pkt, bench.nb_crc_bad, bench.nb_no_crc, rx_stats.nb_discard);
+    printf(" | lgw_receive x%llu us p50<=%u p90<=%u p99<=%u max:%llu", (unsigned long long)bench.nb_receive, bench_percentile(500), bench_percentile(900), bench_percentile(990), (unsigned long long)(bench.recv_max_ns / 1000));
+    printf(" | %.1f B/fetch (%u fetch, %u split), fill p50<=%u p99<=%u max %u/%u B", (rx_stats.nb_fetch > 0) ? (double)rx_stats.nb_byte / rx_stats.nb_fetch : 0.0, rx_stats.nb_fetch, rx_stats.nb_split, lgw_rx_fill_percentile(&rx_stats, 500), lgw_rx_fill_percentile(&rx_stats, 990), rx_stats.fill_max, LGW_RX_BUFFER_SIZE);
+    printf(" | CPU user %.1f ms sys %.1f ms\n", tv_diff_ms(&usage.ru_utime, &bench.usage.ru_utime), tv_diff_ms(&usage.ru_stime, &bench.usage.ru_stime));
+    fflush(stdout);
+
+    bench_restart();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -110,10 +220,21 @@ int main(int argc, char **argv)
     bool single_input_mode = false;
     float rssi_offset = 0.0;
     bool full_duplex = false;
+    const char * record_path = NULL;
+    const char * rxrec_path = NULL;
+    bool replay = false;
+    bool rx_cursor = false;
+    uint64_t cpu_ns = 0, nb_receive = 0, t0;
+    int64_t t1;
+    unsigned int bench_interval = 0; /* seconds, 0 when not in benchmark mode */
+    unsigned int reconf_interval = 0; /* seconds, 0 to keep the channels plan */
+    int64_t reconf_ns = 0;
 
     struct lgw_conf_board_s boardconf;
     struct lgw_conf_rxrf_s rfconf;
     struct lgw_conf_rxif_s ifconf;
+    struct lgw_conf_rxif_s ifconf_plan[LGW_IF_CHAIN_NB];
+    struct lgw_rx_stats_s rx_stats;
 
     unsigned long nb_pkt_crc_ok = 0, nb_loop = 0, cnt_loop;
     int nb_pkt;
@@ -152,11 +273,15 @@ int main(int argc, char **argv)
     int option_index = 0;
     static struct option long_options[] = {
         {"fdd",  no_argument, 0, 0},
+        {"bench", required_argument, 0, 0},
+        {"reconf", required_argument, 0, 0},
+        {"rxrec", required_argument, 0, 0},
+        {"cursor", no_argument, 0, 0},
         {0, 0, 0, 0}
     };
 
     /* parse command line options */
-    while ((i = getopt_long(argc, argv, "hja:b:k:r:n:z:m:o:d:u", long_options, &option_index)) != -1) {
+    while ((i = getopt_long(argc, argv, "hja:b:k:r:n:z:m:o:d:uR:P:S:", long_options, &option_index)) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -170,6 +295,18 @@ int main(int argc, char **argv)
             case 'u': /* Configure USB connection type */
                 com_type = LGW_COM_USB;
                 break;
+            case 'R': /* <char> Record trace path */
+                record_path = optarg;
+                break;
+            case 'P': /* <char> Replay trace path */
+                com_type = LGW_COM_REPLAY;
+                com_path = optarg;
+                replay = true;
+                break;
+            case 'S': /* <char> Simulated concentrator traffic profile */
+                com_type = LGW_COM_SIM;
+                com_path = optarg;
+                break;
             case 'r': /* <uint> Radio type */
                 i = sscanf(optarg, "%u", &arg_u);
                 if ((i != 1) || ((arg_u != 1255) && (arg_u != 1257) && (arg_u != 1250))) {
@@ -258,6 +395,24 @@ int main(int argc, char **argv)
             case 0:
                 if (strcmp(long_options[option_index].name, "fdd") == 0) {
                     full_duplex = true;
+                } else if (strcmp(long_options[option_index].name, "bench") == 0) {
+                    i = sscanf(optarg, "%u", &arg_u);
+                    if ((i != 1) || (arg_u == 0)) {
+                        printf("ERROR: argument parsing of --bench argument. Use -h to print help\n");
+                        return EXIT_FAILURE;
+                    }
+                    bench_interval = arg_u;
+                } else if (strcmp(long_options[option_index].name, "reconf") == 0) {
+                    i = sscanf(optarg, "%u", &arg_u);
+                    if ((i != 1) || (arg_u == 0)) {
+                        printf("ERROR: argument parsing of --reconf argument. Use -h to print help\n");
+                        return EXIT_FAILURE;
+                    }
+                    reconf_interval = arg_u;
+                } else if (strcmp(long_options[option_index].name, "rxrec") == 0) {
+                    rxrec_path = optarg;
+                } else if (strcmp(long_options[option_index].name, "cursor") == 0) {
+                    rx_cursor = true;
                 } else {
                     printf("ERROR: argument parsing options. Use -h to print help\n");
                     return EXIT_FAILURE;
@@ -319,6 +474,7 @@ int main(int argc, char **argv)
     }
 
     /* set configuration for LoRa multi-SF channels (bandwidth cannot be set) */
+    memset(ifconf_plan, 0, sizeof ifconf_plan);
     memset(&ifconf, 0, sizeof(ifconf));
     for (i = 0; i < 8; i++) {
         ifconf.enable = true;
@@ -337,6 +493,7 @@ int main(int argc, char **argv)
             printf("ERROR: failed to configure rxif %d\n", i);
             return EXIT_FAILURE;
         }
+        ifconf_plan[i] = ifconf;
     }
 
     /* set configuration for LoRa Service channel */
@@ -349,12 +506,27 @@ int main(int argc, char **argv)
         printf("ERROR: failed to configure rxif for LoRa service channel\n");
         return EXIT_FAILURE;
     }
+    ifconf_plan[8] = ifconf;
 
     /* set the buffer size to hold received packets */
     struct lgw_pkt_rx_s rxpkt[max_rx_pkt];
+    struct lgw_pkt_rx_s * p;
     printf("INFO: rxpkt buffer size is set to %u\n", max_rx_pkt);
     printf("INFO: Select channel mode %u\n", channel_mode);
 
+    if (record_path != NULL) {
+        if (lgw_replay_record_start(record_path) != LGW_REPLAY_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (rxrec_path != NULL) {
+        if (lgw_rxrec_start(rxrec_path, RXREC_FILE_SIZE_MAX, RXREC_FILE_NB) != LGW_RXREC_SUCCESS) {
+            printf("ERROR: failed to start recording the RX buffer to %s\n", rxrec_path);
+            return EXIT_FAILURE;
+        }
+    }
+
     /* Loop until user quits */
     cnt_loop = 0;
     while( (quit_sig != 1) && (exit_sig != 1) )
@@ -379,40 +551,93 @@ int main(int argc, char **argv)
         /* Loop until we have enough packets with CRC OK */
         printf("Waiting for packets...\n");
         nb_pkt_crc_ok = 0;
+        bench_restart();
+        lgw_get_rx_stats(&rx_stats, true);
+        reconf_ns = time_monotonic_ns();
         while (((nb_pkt_crc_ok < nb_loop) || nb_loop == 0) && (quit_sig != 1) && (exit_sig != 1)) {
             /* fetch N packets */
-            nb_pkt = lgw_receive(ARRAY_SIZE(rxpkt), rxpkt);
+            t0 = cpu_time_ns();
+            t1 = time_monotonic_ns();
+            if (rx_cursor == true) {
+                nb_pkt = lgw_receive_begin();
+            } else {
+                nb_pkt = lgw_receive(ARRAY_SIZE(rxpkt), rxpkt);
+            }
+            t1 = time_monotonic_ns() - t1;
+            cpu_ns += cpu_time_ns() - t0;
+            nb_receive += 1;
+
+            if (bench_interval > 0) {
+                bench_add((uint64_t)t1);
+                if ((time_monotonic_ns() - bench.start_ns) >= ((int64_t)bench_interval * 1000000000LL)) {
+                    bench_report();
+                }
+            }
+
+            if ((reconf_interval > 0) && ((time_monotonic_ns() - reconf_ns) >= ((int64_t)reconf_interval * 1000000000LL))) {
+                ifconf_plan[0].freq_hz += (ifconf_plan[0].freq_hz == channel_if_mode0[0]) ? 100000 : -100000;
+                printf("INFO: moving channel 0 to IF %d Hz\n", ifconf_plan[0].freq_hz);
+                if (lgw_reconfigure(NULL, ifconf_plan) != LGW_HAL_SUCCESS) {
+                    printf("ERROR: failed to reconfigure the channels\n");
+                    return EXIT_FAILURE;
+                }
+                reconf_ns = time_monotonic_ns();
+            }
 
-            if (nb_pkt == 0) {
-                wait_ms(10);
+            if ((nb_pkt < 0) && (replay == true)) {
+                /* end of the recorded receive loop */
+                break;
+            } else if (nb_pkt == 0) {
+                if (replay == false) {
+                    wait_ms(10);
+                }
             } else {
                 for (i = 0; i < nb_pkt; i++) {
-                    if (rxpkt[i].status == STAT_CRC_OK) {
+                    if (rx_cursor == true) {
+                        lgw_receive_next(&p);
+                    } else {
+                        p = &rxpkt[i];
+                    }
+                    if (p->status == STAT_CRC_OK) {
                         nb_pkt_crc_ok += 1;
                     }
-                    printf("\n----- %s packet -----\n", (rxpkt[i].modulation == MOD_LORA) ? "LoRa" : "FSK");
-                    printf("  count_us: %u\n", rxpkt[i].count_us);
-                    printf("  size:     %u\n", rxpkt[i].size);
-                    printf("  chan:     %u\n", rxpkt[i].if_chain);
-                    printf("  status:   0x%02X\n", rxpkt[i].status);
-                    printf("  datr:     %u\n", rxpkt[i].datarate);
-                    printf("  codr:     %u\n", rxpkt[i].coderate);
-                    printf("  rf_chain  %u\n", rxpkt[i].rf_chain);
-                    printf("  freq_hz   %u\n", rxpkt[i].freq_hz);
-                    printf("  snr_avg:  %.1f\n", rxpkt[i].snr);
-                    printf("  rssi_chan:%.1f\n", rxpkt[i].rssic);
-                    printf("  rssi_sig :%.1f\n", rxpkt[i].rssis);
-                    printf("  crc:      0x%04X\n", rxpkt[i].crc);
-                    for (j = 0; j < rxpkt[i].size; j++) {
-                        printf("%02X ", rxpkt[i].payload[j]);
+                    if (bench_interval > 0) {
+                        bench_add_pkt(p);
+                        continue;
+                    }
+                    printf("\n----- %s packet -----\n", (p->modulation == MOD_LORA) ? "LoRa" : "FSK");
+                    printf("  count_us: %u\n", p->count_us);
+                    printf("  size:     %u\n", p->size);
+                    printf("  chan:     %u\n", p->if_chain);
+                    printf("  status:   0x%02X\n", p->status);
+                    printf("  datr:     %u\n", p->datarate);
+                    printf("  codr:     %u\n", p->coderate);
+                    printf("  rf_chain  %u\n", p->rf_chain);
+                    printf("  freq_hz   %u\n", p->freq_hz);
+                    printf("  snr_avg:  %.1f\n", p->snr);
+                    printf("  rssi_chan:%.1f\n", p->rssic);
+                    printf("  rssi_sig :%.1f\n", p->rssis);
+                    printf("  crc:      0x%04X\n", p->crc);
+                    for (j = 0; j < p->size; j++) {
+                        printf("%02X ", p->payload[j]);
                     }
                     printf("\n");
                 }
-                printf("Received %d packets (total:%lu)\n", nb_pkt, nb_pkt_crc_ok);
+                if (bench_interval == 0) {
+                    printf("Received %d packets (total:%lu)\n", nb_pkt, nb_pkt_crc_ok);
+                }
+            }
+
+            /* the packets of the cursor are not used after this point */
+            if ((rx_cursor == true) && (nb_pkt >= 0)) {
+                lgw_receive_end();
             }
         }
 
         printf( "\nNb valid packets received: %lu CRC OK (%lu)\n", nb_pkt_crc_ok, cnt_loop );
+        if (nb_receive > 0) {
+            printf("CPU time per lgw_receive() call: %.1f us (%llu calls)\n", (double)cpu_ns / nb_receive / 1000.0, (unsigned long long)nb_receive);
+        }
 
         /* Stop the gateway */
         x = lgw_stop();
@@ -428,6 +653,20 @@ int main(int argc, char **argv)
                 exit(EXIT_FAILURE);
             }
         }
+
+        /* a trace holds a single start/stop sequence */
+        if ((record_path != NULL) || (replay == true)) {
+            break;
+        }
+    }
+
+    if (record_path != NULL) {
+        lgw_replay_record_stop();
+    }
+
+    if (rxrec_path != NULL) {
+        lgw_rxrec_stop();
+        printf("RX buffer fetches not recorded (ring full): %u\n", lgw_rxrec_dropped());
     }
 
     printf("=========== Test End ===========\n");
@@ -0,0 +1,123 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Record latency measures from several threads in the profiling probes, and
+    check the counters, the histograms and the percentiles
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <pthread.h>
+
+#include "loragw_aux.h"
+#include "loragw_perf.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_THREAD       4
+#define NB_RECORD       100000  /* measures per thread */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const char probe_fast[] = "fast";
+static const char probe_slow[] = "slow";
+static unsigned nb_err = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void check(const char * what, uint64_t value, uint64_t expected) {
+    printf("%-32s %10llu (expected %10llu)%s\n", what, (unsigned long long)value, (unsigned long long)expected, (value == expected) ? "" : " <- ERROR");
+    if (value != expected) {
+        nb_err += 1;
+    }
+}
+
+/* 99% of the measures at 1000 ns (bucket 10), 1% at 100000 ns (bucket 17) */
+static void * thread_record(void * arg) {
+    int i;
+
+    (void)arg;
+    for (i = 0; i < NB_RECORD; i++) {
+        lgw_perf_record(probe_fast, ((i % 100) == 0) ? 100000 : 1000);
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void) {
+    int i, n;
+    int64_t tm;
+    pthread_t thrid[NB_THREAD];
+    struct lgw_perf_probe_s probes[LGW_PERF_PROBE_NB_MAX];
+
+    printf("### Profiling probes, %u buckets ###\n", LGW_PERF_BUCKET_NB);
+
+    /* nothing recorded while disabled */
+    _meas_time_start(&tm);
+    _meas_time_stop(1, tm, probe_slow);
+    check("probes while disabled", lgw_perf_get(probes, LGW_PERF_PROBE_NB_MAX), 0);
+
+    lgw_perf_enable(true);
+
+    /* concurrent measures on the same probe */
+    for (i = 0; i < NB_THREAD; i++) {
+        pthread_create(&thrid[i], NULL, thread_record, NULL);
+    }
+    for (i = 0; i < NB_THREAD; i++) {
+        pthread_join(thrid[i], NULL);
+    }
+
+    /* measure of the monotonic clock */
+    _meas_time_start(&tm);
+    wait_ms(10);
+    _meas_time_stop(1, tm, probe_slow);
+
+    n = lgw_perf_get(probes, LGW_PERF_PROBE_NB_MAX);
+    if ((n != 2) || (probes[0].name != probe_fast) || (probes[1].name != probe_slow)) {
+        printf("ERROR: wrong probes, %d returned\n", n);
+        return EXIT_FAILURE;
+    }
+    check("fast count", probes[0].count, NB_THREAD * NB_RECORD);
+    check("fast sum", probes[0].sum_ns, (uint64_t)NB_THREAD * ((NB_RECORD / 100) * 100000 + (NB_RECORD - (NB_RECORD / 100)) * 1000));
+    check("fast max", probes[0].max_ns, 100000);
+    check("fast bucket 10", probes[0].hist[10], NB_THREAD * (NB_RECORD - (NB_RECORD / 100)));
+    check("fast bucket 17", probes[0].hist[17], NB_THREAD * (NB_RECORD / 100));
+    check("fast p50", lgw_perf_percentile(&probes[0], 500), 1024);
+    check("fast p99", lgw_perf_percentile(&probes[0], 990), 1024);
+    check("fast p999", lgw_perf_percentile(&probes[0], 999), 100000);
+    check("slow count", probes[1].count, 1);
+    check("slow above 10 ms", (probes[1].max_ns >= 10000000) ? 1 : 0, 1);
+
+    /* the probes are kept, and cleared */
+    lgw_perf_reset();
+    n = lgw_perf_get(probes, LGW_PERF_PROBE_NB_MAX);
+    check("probes after reset", n, 2);
+    check("fast count after reset", probes[0].count, 0);
+    check("fast p99 after reset", lgw_perf_percentile(&probes[0], 990), 0);
+
+    printf("check: %u errors\n", nb_err);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
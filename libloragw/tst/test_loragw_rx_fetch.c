@@ -0,0 +1,200 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Check that no packet is lost by the fetches of the RX buffer, on the
+    simulated concentrator, for several sizes of the RX packet array: the
+    packets split between two fetches must be completed by the second one.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <string.h>     /* memset strncpy */
+#include <unistd.h>     /* getopt */
+
+#include "loragw_hal.h"
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+/* large packets at a high rate in a small RX buffer, most fetches are split */
+#define SIM_PROFILE         "rate=3000,size=100-255,fifo=8191,seed=1"
+#define NB_PKT_DEFAULT      5000
+#define RX_PKT_MAX          255
+#define RX_TIMEOUT_MS       20000
+#define FETCH_PERIOD_MS     10  /* more than LGW_RX_BUFFER_SIZE bytes are received meanwhile */
+
+static const uint16_t rx_pkt_nb[] = { 16, 64, 255 }; /* sizes of the RX packet array passed to lgw_receive() */
+
+static const int32_t channel_if[9] = { -400000, -200000, 0, -400000, -200000, 0, 200000, 400000, -200000 };
+static const uint8_t channel_rfchain[9] = { 1, 1, 1, 0, 0, 0, 0, 0, 1 };
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_pkt_rx_s rxpkt[RX_PKT_MAX];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 0;
+    boardconf.com_type = LGW_COM_SIM;
+    strncpy(boardconf.com_path, SIM_PROFILE, sizeof boardconf.com_path);
+    boardconf.com_path[sizeof boardconf.com_path - 1] = '\0';
+    if (lgw_board_setconf(&boardconf) != LGW_HAL_SUCCESS) {
+        return -1;
+    }
+
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        memset(&rfconf, 0, sizeof rfconf);
+        rfconf.enable = true;
+        rfconf.freq_hz = (i == 0) ? 867500000 : 868500000;
+        rfconf.type = LGW_RADIO_TYPE_SX1250;
+        if (lgw_rxrf_setconf(i, &rfconf) != LGW_HAL_SUCCESS) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < 9; i++) {
+        memset(&ifconf, 0, sizeof ifconf);
+        ifconf.enable = true;
+        ifconf.rf_chain = channel_rfchain[i];
+        ifconf.freq_hz = channel_if[i];
+        ifconf.datarate = DR_LORA_SF7;
+        if (i == 8) {
+            ifconf.bandwidth = BW_250KHZ; /* LoRa service channel */
+        }
+        if (lgw_rxif_setconf(i, &ifconf) != LGW_HAL_SUCCESS) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* receive nb_pkt packets with an array of max_pkt, counts the errors */
+static unsigned check_fetch(uint16_t max_pkt, unsigned nb_pkt) {
+    struct lgw_rx_stats_s rx_stats;
+    uint32_t cnt, next_cnt = 0;
+    unsigned nb_rx = 0, nb_lost = 0, nb_crc_bad = 0;
+    int64_t start_ns;
+    int i, n;
+
+    if (lgw_start() != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to start the simulated concentrator\n");
+        return 1;
+    }
+    lgw_get_rx_stats(&rx_stats, true);
+
+    start_ns = time_monotonic_ns();
+    while (nb_rx < nb_pkt) {
+        n = lgw_receive(max_pkt, rxpkt);
+        if (n < 0) {
+            printf("ERROR: lgw_receive failed\n");
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (rxpkt[i].status != STAT_CRC_OK) {
+                nb_crc_bad += 1;
+                continue;
+            }
+            /* the simulated packets start with their counter, the packets dropped in the RX buffer are not counted */
+            cnt = ((uint32_t)rxpkt[i].payload[0] << 24) | ((uint32_t)rxpkt[i].payload[1] << 16) | ((uint32_t)rxpkt[i].payload[2] << 8) | rxpkt[i].payload[3];
+            if (cnt > next_cnt) {
+                nb_lost += cnt - next_cnt;
+            }
+            next_cnt = cnt + 1;
+            nb_rx += 1;
+        }
+        if (n < max_pkt) {
+            wait_ms(FETCH_PERIOD_MS); /* the packets parsed are all returned, let the RX buffer fill up */
+        }
+        if ((time_monotonic_ns() - start_ns) > (RX_TIMEOUT_MS * 1000000LL)) {
+            printf("ERROR: timeout\n");
+            break;
+        }
+    }
+    lgw_get_rx_stats(&rx_stats, false);
+    lgw_stop();
+
+    printf("%3u packets per fetch: %u received, %u lost, %u CRC errors, %u discarded, %u split fetches\n", max_pkt, nb_rx, nb_lost, nb_crc_bad, rx_stats.nb_discard, rx_stats.nb_split);
+
+    return ((nb_rx < nb_pkt) ? 1 : 0) + nb_lost + nb_crc_bad + rx_stats.nb_discard;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i;
+    unsigned int arg_u;
+    unsigned nb_pkt = NB_PKT_DEFAULT;
+    unsigned nb_err = 0;
+    unsigned k;
+
+    while ((i = getopt(argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                printf(" -n <uint>  Number of packets received for each size of the RX packet array, default %u\n", NB_PKT_DEFAULT);
+                return -1;
+            case 'n':
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument\n");
+                    return EXIT_FAILURE;
+                }
+                nb_pkt = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### RX buffer fetch check, simulated concentrator " SIM_PROFILE " ###\n");
+
+    if (configure() != 0) {
+        printf("ERROR: failed to configure the simulated concentrator\n");
+        return EXIT_FAILURE;
+    }
+    for (k = 0; k < ARRAY_SIZE(rx_pkt_nb); k++) {
+        nb_err += check_fetch(rx_pkt_nb[k], nb_pkt);
+    }
+    printf("check: %u errors\n", nb_err);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
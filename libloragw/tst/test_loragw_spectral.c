@@ -0,0 +1,143 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Merge synthetic spectral scan histograms in an aggregator, and check the
+    summarized percentiles and the decay of the rolling histogram
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <string.h>     /* memset */
+
+#include "loragw_hal.h"
+#include "loragw_spectral.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RSSI_OFFSET     -11     /* levels of the synthetic scans, as returned by the SX1261 with this offset */
+#define NB_POINTS       2000    /* samples per scan */
+#define DECAY_SHIFT     3
+#define FREQ_A          867100000
+#define FREQ_B          868500000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static int16_t levels[LGW_SPECTRAL_SCAN_RESULT_SIZE];
+static unsigned nb_err = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* scan with most samples around the noise floor and a few at a higher level */
+static void scan_two_levels(uint16_t * results, int floor_idx, int high_idx, uint16_t nb_high) {
+    memset(results, 0, LGW_SPECTRAL_SCAN_RESULT_SIZE * sizeof results[0]);
+    results[floor_idx] = NB_POINTS - nb_high;
+    results[high_idx] += nb_high;
+}
+
+static void check(const char * what, int value, int expected) {
+    printf("%-32s %5d dBm (expected %5d)%s\n", what, value, expected, (value == expected) ? "" : " <- ERROR");
+    if (value != expected) {
+        nb_err += 1;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void) {
+    int i, n;
+    uint16_t results[LGW_SPECTRAL_SCAN_RESULT_SIZE];
+    struct lgw_spectral_agg_s agg;
+    struct lgw_spectral_summary_s summary[LGW_SPECTRAL_FREQ_NB_MAX];
+
+    /* same levels as lgw_spectral_scan_get_results() */
+    for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
+        levels[i] = RSSI_OFFSET - (4 * i);
+    }
+    levels[LGW_SPECTRAL_SCAN_RESULT_SIZE - 1] = levels[LGW_SPECTRAL_SCAN_RESULT_SIZE - 2];
+
+    printf("### Spectral scan aggregation, %u bins of %u ###\n", LGW_SPECTRAL_BIN_NB, LGW_SPECTRAL_SCAN_RESULT_SIZE);
+
+    lgw_spectral_agg_init(&agg, DECAY_SHIFT);
+
+    /* an empty scan is rejected */
+    memset(results, 0, sizeof results);
+    if (lgw_spectral_agg_merge(&agg, FREQ_A, levels, results) != LGW_HAL_ERROR) {
+        printf("ERROR: empty scan merged\n");
+        nb_err += 1;
+    }
+
+    /* quiet channel: floor at level index 24, 5% of the samples at index 6 */
+    for (n = 0; n < 10; n++) {
+        scan_two_levels(results, 24, 6, NB_POINTS / 20);
+        lgw_spectral_agg_merge(&agg, FREQ_A, levels, results);
+        scan_two_levels(results, 30, 30, 0);
+        lgw_spectral_agg_merge(&agg, FREQ_B, levels, results);
+    }
+    n = lgw_spectral_agg_summary(&agg, summary, LGW_SPECTRAL_FREQ_NB_MAX);
+    if ((n != 2) || (summary[0].freq_hz != FREQ_A) || (summary[1].freq_hz != FREQ_B) || (summary[0].nb_scan != 10)) {
+        printf("ERROR: wrong summary, %d frequencies\n", n);
+        return EXIT_FAILURE;
+    }
+    check("quiet p50", summary[0].p50, levels[25]);
+    check("quiet p90", summary[0].p90, levels[25]);
+    check("quiet p99", summary[0].p99, levels[7]);
+    check("quiet max", summary[0].max, levels[7]);
+    check("idle p99", summary[1].p99, levels[31]);
+
+    /* the period restarts, the rolling histogram is kept */
+    n = lgw_spectral_agg_summary(&agg, summary, LGW_SPECTRAL_FREQ_NB_MAX);
+    if (summary[0].nb_scan != 0) {
+        printf("ERROR: period not restarted\n");
+        nb_err += 1;
+    }
+    check("no scan p99", summary[0].p99, levels[7]);
+    check("no scan max", summary[0].max, levels[LGW_SPECTRAL_SCAN_RESULT_SIZE - 1]);
+
+    /* interferer: 40% of the samples at index 10, only taken over after a few scans */
+    scan_two_levels(results, 24, 10, (NB_POINTS * 4) / 10);
+    lgw_spectral_agg_merge(&agg, FREQ_A, levels, results);
+    lgw_spectral_agg_summary(&agg, summary, LGW_SPECTRAL_FREQ_NB_MAX);
+    check("interferer 1 scan p50", summary[0].p50, levels[25]);
+    check("interferer 1 scan max", summary[0].max, levels[11]);
+    for (n = 0; n < 30; n++) {
+        scan_two_levels(results, 24, 10, (NB_POINTS * 4) / 10);
+        lgw_spectral_agg_merge(&agg, FREQ_A, levels, results);
+    }
+    lgw_spectral_agg_summary(&agg, summary, LGW_SPECTRAL_FREQ_NB_MAX);
+    check("interferer 31 scans p50", summary[0].p50, levels[25]);
+    check("interferer 31 scans p90", summary[0].p90, levels[11]);
+
+    /* no decay, only the latest scan is kept */
+    lgw_spectral_agg_init(&agg, 0);
+    scan_two_levels(results, 24, 6, NB_POINTS / 2);
+    lgw_spectral_agg_merge(&agg, FREQ_A, levels, results);
+    scan_two_levels(results, 24, 24, 0);
+    lgw_spectral_agg_merge(&agg, FREQ_A, levels, results);
+    lgw_spectral_agg_summary(&agg, summary, LGW_SPECTRAL_FREQ_NB_MAX);
+    check("latest only p99", summary[0].p99, levels[25]);
+    check("latest only max", summary[0].max, levels[7]);
+
+    printf("check: %u errors\n", nb_err);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,143 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Micro-benchmark harness, shared by the bench programs of the libraries
+    and of the packet forwarder.
+
+    Each case is a function running a given number of iterations. The number
+    of iterations of a sample is calibrated so that a sample lasts at least
+    the sample time, warmup samples are run and discarded, then the measured
+    samples give the min, median and max time per operation. One line is
+    printed per case, as a text table, CSV or JSON Lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* FILE */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define BENCH_OPTIONS           "w:n:t:i:f:k:o:"  /* getopt options handled by bench_option */
+#define BENCH_SAMPLE_NB_MAX     1000
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+enum bench_fmt_e {
+    BENCH_FMT_TEXT,
+    BENCH_FMT_CSV,
+    BENCH_FMT_JSON
+};
+
+struct bench_conf_s {
+    const char * suite;     /* name of the bench program, first field of the CSV and JSON lines */
+    unsigned warmup;        /* samples run and discarded before the measured ones */
+    unsigned samples;       /* samples measured for each case */
+    unsigned sample_ms;     /* minimum duration of a sample, when the iterations are calibrated */
+    uint64_t iter;          /* iterations of each sample, 0 to calibrate them to sample_ms */
+    enum bench_fmt_e fmt;
+    const char * filter;    /* only the cases whose name contains it are run, NULL for all */
+    FILE * out;             /* results, apart from the messages of the code measured */
+};
+
+/*
+A case runs nb iterations on its argument, and returns the number of
+operations done, the time being reported per operation. The results of the
+operations should be accumulated in bench_sink, so that they are not
+optimized away.
+*/
+typedef uint64_t (*bench_fn_t)(void * arg, uint64_t nb);
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+extern volatile uint32_t bench_sink;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set the default configuration: 2 warmup samples, 9 samples of at least 20 ms, text output on stdout
+@param conf configuration to be initialized
+@param suite name of the bench program
+*/
+void bench_init(struct bench_conf_s * conf, const char * suite);
+
+/**
+@brief Handle one of the BENCH_OPTIONS returned by getopt
+@param conf configuration to be updated
+@param opt option returned by getopt
+@param arg its argument
+@return 0 if the option was handled, 1 if it is not a bench option, -1 if its argument is invalid
+*/
+int bench_option(struct bench_conf_s * conf, int opt, const char * arg);
+
+/**
+@brief Close the results file opened by the -o option
+@param conf configuration of the run
+*/
+void bench_end(struct bench_conf_s * conf);
+
+/**
+@brief Print the usage of the BENCH_OPTIONS
+*/
+void bench_usage(void);
+
+/**
+@brief Print the header of the results, to be called before the first case
+@param conf configuration of the run
+*/
+void bench_begin(const struct bench_conf_s * conf);
+
+/**
+@brief Check if a case is selected by the filter
+@param conf configuration of the run
+@param name name of the case
+@return true if the case is to be run
+*/
+bool bench_selected(const struct bench_conf_s * conf, const char * name);
+
+/**
+@brief Run a case, warmup and calibration included, and print its result
+@param conf configuration of the run
+@param name name of the case, '/' separated, without comma nor quote
+@param fn function of the case
+@param arg argument given to fn
+@return 0 if the case was run or skipped by the filter, -1 if it did no operation
+*/
+int bench_run(const struct bench_conf_s * conf, const char * name, bench_fn_t fn, void * arg);
+
+/**
+@brief Print the result of a case measured by the caller, one duration per operation for each sample
+@param conf configuration of the run
+@param name name of the case, '/' separated, without comma nor quote
+@param ns_per_op mean duration of an operation in each sample, in nanoseconds, sorted in place
+@param nb number of samples
+@param ops total number of operations of the samples
+*/
+void bench_report(const struct bench_conf_s * conf, const char * name, double * ns_per_op, unsigned nb, uint64_t ops);
+
+/**
+@brief Get the time of the monotonic clock
+@return time in nanoseconds
+*/
+int64_t bench_time_ns(void);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,47 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Table-driven CRC16 (polynomial 0x1021) library
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _CRC16_H
+#define _CRC16_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Compute the CRC-16/CCITT (XMODEM) of a buffer, as used by LoRaWAN beacons
+@param data pointer to the data buffer
+@param size number of bytes in the buffer
+@return CRC16 of the buffer, initial value 0x0000, no reflection
+*/
+uint16_t crc16_ccitt(const uint8_t * data, unsigned size);
+
+/**
+@brief Compute the CRC16 a LoRa modem appends to a payload
+@param data pointer to the payload
+@param size number of bytes in the payload
+@return CRC16 of the payload, as received in the packet metadata by the SX1302
+The payload bytes are shifted through the register, without augmentation,
+starting from 0x0000.
+*/
+uint16_t crc16_lora(const uint8_t * data, unsigned size);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
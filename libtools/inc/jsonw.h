@@ -0,0 +1,90 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Fast JSON number & string emitters, writing directly into a buffer
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _JSONW_H
+#define _JSONW_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/*
+The emitters below do not check the space left in the output buffer and do not
+add a null char, the caller must size the buffer for the worst case. They all
+return the number of chars written.
+*/
+
+/**
+@brief Append a string, without quotes nor escaping
+@param out pointer to where the string is written
+@param str null-terminated string to be copied
+@return number of chars written
+*/
+int jsonw_str(char * out, const char * str);
+
+/**
+@brief Append an unsigned integer, same output as printf "%u" / "%" PRIu64
+@param out pointer to where the number is written
+@param val value to be written
+@return number of chars written
+*/
+int jsonw_uint(char * out, uint64_t val);
+
+/**
+@brief Append a signed integer, same output as printf "%d" / "%" PRId64
+@param out pointer to where the number is written
+@param val value to be written
+@return number of chars written
+*/
+int jsonw_int(char * out, int64_t val);
+
+/**
+@brief Append an unsigned integer padded to a minimum width, same output as printf "%*u" or "%0*u"
+@param out pointer to where the number is written
+@param val value to be written
+@param width minimum number of chars to be written
+@param pad padding char, ' ' or '0'
+@return number of chars written
+*/
+int jsonw_uint_pad(char * out, uint32_t val, int width, char pad);
+
+/**
+@brief Append a number with a fixed number of decimals, same output as printf "%.*f"
+@param out pointer to where the number is written
+@param val value to be written
+@param decimals number of decimals to be written [0..9]
+@return number of chars written
+The output matches printf as long as val multiplied by 10^decimals is exactly
+representable as a double, which is always the case for a float promoted to
+double. Values too large or not finite are formatted by snprintf.
+*/
+int jsonw_fixed(char * out, double val, unsigned decimals);
+
+/**
+@brief Append a fixed-point integer scaled by 10^decimals, same output as printf "%.*f" of val / 10^decimals
+@param out pointer to where the number is written
+@param val value to be written, in units of 10^-decimals (-1234 is written -123.4 with 1 decimal)
+@param decimals number of decimals to be written [0..9]
+@return number of chars written
+*/
+int jsonw_decimal(char * out, int64_t val, unsigned decimals);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
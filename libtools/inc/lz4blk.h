@@ -0,0 +1,68 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LZ4 block format compression & decompression, with an external dictionary
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LZ4BLK_H
+#define _LZ4BLK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LZ4BLK_BOUND(size)      ((size) + ((size) / 255) + 16)  /* worst case size of a compressed block */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+/* dictionary of the compressed PUSH_DATA, made of the usual rxpk and stat keys */
+extern const uint8_t lz4blk_dict_up[];
+extern const int lz4blk_dict_up_size;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Compress data in a single LZ4 block
+@param in pointer to the data to be compressed
+@param size number of bytes to be compressed
+@param out pointer to the buffer receiving the block
+@param max_len usable size of the out buffer, LZ4BLK_BOUND(size) is always enough
+@param dict data preceding the input, that the block can refer to, NULL if none
+@param dict_len size of the dictionary, only its last 64 kB are used
+@return >=0 size of the block, -1 for error
+
+The block is the raw LZ4 block format, without frame, as decoded by
+LZ4_decompress_safe_usingDict of the reference library.
+*/
+int lz4blk_compress(const uint8_t * in, int size, uint8_t * out, int max_len, const uint8_t * dict, int dict_len);
+
+/**
+@brief Decompress a single LZ4 block
+@param in pointer to the block
+@param size size of the block
+@param out pointer to the buffer receiving the data
+@param max_len usable size of the out buffer
+@param dict dictionary used for the compression, NULL if none
+@param dict_len size of the dictionary
+@return >=0 number of bytes written to the out buffer, -1 for a malformed block or a too small buffer
+*/
+int lz4blk_decompress(const uint8_t * in, int size, uint8_t * out, int max_len, const uint8_t * dict, int dict_len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -34,11 +34,39 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
+#define CODE_INVALID    0xFF    /* char_to_code_table value for chars out of the Base64 alphabet */
+
+/* RFC 1421 alphabet, '+' and '/' for codes 62 and 63 */
+static const char code_to_char_table[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+    'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+    'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'
+};
+
+/* Reverse of code_to_char_table, indexed by the ASCII value of the char */
+static const uint8_t char_to_code_table[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MODULE-WIDE VARIABLES ---------------------------------------- */
 
-static char code_62 = '+';    /* RFC 1421 standard character for code 62 */
-static char code_63 = '/';    /* RFC 1421 standard character for code 63 */
 static char code_pad = '=';    /* RFC 1421 padding character if padding */
 
 /* -------------------------------------------------------------------------- */
@@ -47,48 +75,29 @@ static char code_pad = '=';    /* RFC 1421 padding character if padding */
 /**
 @brief Convert a code in the range 0-63 to an ASCII character
 */
-char code_to_char(uint8_t x);
+static inline char code_to_char(uint8_t x);
 
 /**
 @brief Convert an ASCII character to a code in the range 0-63
 */
-uint8_t char_to_code(char x);
+static inline uint8_t char_to_code(char x);
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
-char code_to_char(uint8_t x) {
-    if (x <= 25) {
-        return 'A' + x;
-    } else if ((x >= 26) && (x <= 51)) {
-        return 'a' + (x-26);
-    } else if ((x >= 52) && (x <= 61)) {
-        return '0' + (x-52);
-    } else if (x == 62) {
-        return code_62;
-    } else if (x == 63) {
-        return code_63;
-    } else {
-        DEBUG("ERROR: %i IS OUT OF RANGE 0-63 FOR BASE64 ENCODING\n", x);
-        exit(EXIT_FAILURE);
-    } //TODO: improve error management
+static inline char code_to_char(uint8_t x) {
+    return code_to_char_table[x & 0x3F];
 }
 
-uint8_t char_to_code(char x) {
-    if ((x >= 'A') && (x <= 'Z')) {
-        return (uint8_t)x - (uint8_t)'A';
-    } else if ((x >= 'a') && (x <= 'z')) {
-        return (uint8_t)x - (uint8_t)'a' + 26;
-    } else if ((x >= '0') && (x <= '9')) {
-        return (uint8_t)x - (uint8_t)'0' + 52;
-    } else if (x == code_62) {
-        return 62;
-    } else if (x == code_63) {
-        return 63;
-    } else {
+static inline uint8_t char_to_code(char x) {
+    uint8_t code = char_to_code_table[(uint8_t)x];
+
+    if (code == CODE_INVALID) {
         DEBUG("ERROR: %c (0x%x) IS INVALID CHARACTER FOR BASE64 DECODING\n", x, x);
         exit(EXIT_FAILURE);
     } //TODO: improve error management
+
+    return code;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -141,10 +150,10 @@ int bin_to_b64_nopad(const uint8_t * in, int size, char * out, int max_len) {
         b  = (0xFF & in[3*i]    ) << 16;
         b |= (0xFF & in[3*i + 1]) << 8;
         b |=  0xFF & in[3*i + 2];
-        out[4*i + 0] = code_to_char((b >> 18) & 0x3F);
-        out[4*i + 1] = code_to_char((b >> 12) & 0x3F);
-        out[4*i + 2] = code_to_char((b >> 6 ) & 0x3F);
-        out[4*i + 3] = code_to_char( b        & 0x3F);
+        out[4*i + 0] = code_to_char_table[(b >> 18) & 0x3F];
+        out[4*i + 1] = code_to_char_table[(b >> 12) & 0x3F];
+        out[4*i + 2] = code_to_char_table[(b >> 6 ) & 0x3F];
+        out[4*i + 3] = code_to_char_table[ b        & 0x3F];
     }
 
     /* process the last 'partial' block and terminate string */
@@ -175,7 +184,7 @@ int b64_to_bin_nopad(const char * in, int size, uint8_t * out, int max_len) {
     int last_chars; /* number of characters <4 in the last block */
     int last_bytes; /* number of unsigned chars <3 in the last block */
     uint32_t b;
-    ;
+    uint8_t c0, c1, c2, c3;
 
     /* check input values */
     if ((out == NULL) || (in == NULL)) {
@@ -215,10 +224,21 @@ int b64_to_bin_nopad(const char * in, int size, uint8_t * out, int max_len) {
 
     /* process all the full blocks */
     for (i=0; i < full_blocks; ++i) {
-        b  = (0x3F & char_to_code(in[4*i]    )) << 18;
-        b |= (0x3F & char_to_code(in[4*i + 1])) << 12;
-        b |= (0x3F & char_to_code(in[4*i + 2])) << 6;
-        b |=  0x3F & char_to_code(in[4*i + 3]);
+        c0 = char_to_code_table[(uint8_t)in[4*i]    ];
+        c1 = char_to_code_table[(uint8_t)in[4*i + 1]];
+        c2 = char_to_code_table[(uint8_t)in[4*i + 2]];
+        c3 = char_to_code_table[(uint8_t)in[4*i + 3]];
+        if (((c0 | c1 | c2 | c3) & 0xC0) != 0) {
+            /* at least one invalid char in the block, let char_to_code report it */
+            c0 = char_to_code(in[4*i]);
+            c1 = char_to_code(in[4*i + 1]);
+            c2 = char_to_code(in[4*i + 2]);
+            c3 = char_to_code(in[4*i + 3]);
+        }
+        b  = (uint32_t)c0 << 18;
+        b |= (uint32_t)c1 << 12;
+        b |= (uint32_t)c2 << 6;
+        b |= (uint32_t)c3;
         out[3*i + 0] = (b >> 16) & 0xFF;
         out[3*i + 1] = (b >> 8 ) & 0xFF;
         out[3*i + 2] =  b        & 0xFF;
@@ -0,0 +1,263 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Micro-benchmark harness: calibration, warmup, samples and report
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, sscanf */
+#include <stdlib.h>     /* qsort */
+#include <string.h>     /* strcmp, strstr */
+#include <time.h>       /* clock_gettime */
+
+#include "bench.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define BENCH_ITER_MAX      (1ULL << 40)    /* bound of the calibration */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+volatile uint32_t bench_sink;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int compare_double(const void * a, const void * b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void bench_init(struct bench_conf_s * conf, const char * suite) {
+    conf->suite = suite;
+    conf->warmup = 2;
+    conf->samples = 9;
+    conf->sample_ms = 20;
+    conf->iter = 0;
+    conf->fmt = BENCH_FMT_TEXT;
+    conf->filter = NULL;
+    conf->out = stdout;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int bench_option(struct bench_conf_s * conf, int opt, const char * arg) {
+    unsigned arg_u;
+    unsigned long long arg_ull;
+
+    switch (opt) {
+        case 'w':
+            if (sscanf(arg, "%u", &arg_u) != 1) {
+                return -1;
+            }
+            conf->warmup = arg_u;
+            return 0;
+        case 'n':
+            if ((sscanf(arg, "%u", &arg_u) != 1) || (arg_u < 1) || (arg_u > BENCH_SAMPLE_NB_MAX)) {
+                return -1;
+            }
+            conf->samples = arg_u;
+            return 0;
+        case 't':
+            if ((sscanf(arg, "%u", &arg_u) != 1) || (arg_u < 1)) {
+                return -1;
+            }
+            conf->sample_ms = arg_u;
+            return 0;
+        case 'i':
+            if ((sscanf(arg, "%llu", &arg_ull) != 1) || (arg_ull > BENCH_ITER_MAX)) {
+                return -1;
+            }
+            conf->iter = arg_ull;
+            return 0;
+        case 'f':
+            if (strcmp(arg, "text") == 0) {
+                conf->fmt = BENCH_FMT_TEXT;
+            } else if (strcmp(arg, "csv") == 0) {
+                conf->fmt = BENCH_FMT_CSV;
+            } else if (strcmp(arg, "json") == 0) {
+                conf->fmt = BENCH_FMT_JSON;
+            } else {
+                return -1;
+            }
+            return 0;
+        case 'k':
+            conf->filter = arg;
+            return 0;
+        case 'o':
+            bench_end(conf);
+            conf->out = fopen(arg, "w");
+            if (conf->out == NULL) {
+                conf->out = stdout;
+                return -1;
+            }
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void bench_usage(void) {
+    printf(" -w <uint>  Number of warmup samples, discarded, default 2\n");
+    printf(" -n <uint>  Number of samples measured for each case, default 9\n");
+    printf(" -t <uint>  Minimum duration of a sample in ms, to calibrate the iterations, default 20\n");
+    printf(" -i <uint>  Number of iterations of each sample, instead of calibrating them\n");
+    printf(" -f <fmt>   Output format: text, csv or json (one object per line), default text\n");
+    printf(" -k <str>   Only run the cases whose name contains str\n");
+    printf(" -o <path>  Write the results to a file instead of stdout\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void bench_end(struct bench_conf_s * conf) {
+    if (conf->out != stdout) {
+        fclose(conf->out);
+        conf->out = stdout;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void bench_begin(const struct bench_conf_s * conf) {
+    switch (conf->fmt) {
+        case BENCH_FMT_TEXT:
+            fprintf(conf->out, "# %s: %u warmup, %u samples of ", conf->suite, conf->warmup, conf->samples);
+            if (conf->iter > 0) {
+                fprintf(conf->out, "%llu iterations\n", (unsigned long long)conf->iter);
+            } else {
+                fprintf(conf->out, "%u ms\n", conf->sample_ms);
+            }
+            fprintf(conf->out, "%-44s %12s %12s %12s %12s\n", "case", "ns/op med", "ns/op min", "ns/op max", "ops");
+            break;
+        case BENCH_FMT_CSV:
+            fprintf(conf->out, "suite,case,samples,ops,ns_min,ns_med,ns_max\n");
+            break;
+        default:
+            break;
+    }
+    fflush(conf->out);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool bench_selected(const struct bench_conf_s * conf, const char * name) {
+    return (conf->filter == NULL) || (strstr(name, conf->filter) != NULL);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int bench_run(const struct bench_conf_s * conf, const char * name, bench_fn_t fn, void * arg) {
+    unsigned i;
+    uint64_t iter, ops, ops_total = 0;
+    int64_t t, target_ns;
+    double ns_per_op[BENCH_SAMPLE_NB_MAX];
+
+    if (bench_selected(conf, name) == false) {
+        return 0;
+    }
+
+    /* Double the iterations until a sample lasts the sample time, this also warms up the caches */
+    iter = conf->iter;
+    if (iter == 0) {
+        target_ns = (int64_t)conf->sample_ms * 1000000;
+        for (iter = 1; iter < BENCH_ITER_MAX; iter *= 2) {
+            t = bench_time_ns();
+            ops = fn(arg, iter);
+            t = bench_time_ns() - t;
+            if (ops == 0) {
+                break;
+            }
+            if (t >= target_ns) {
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < conf->warmup; i++) {
+        fn(arg, iter);
+    }
+
+    for (i = 0; i < conf->samples; i++) {
+        t = bench_time_ns();
+        ops = fn(arg, iter);
+        t = bench_time_ns() - t;
+        if (ops == 0) {
+            printf("ERROR: case %s did no operation\n", name);
+            return -1;
+        }
+        ns_per_op[i] = (double)t / (double)ops;
+        ops_total += ops;
+    }
+
+    bench_report(conf, name, ns_per_op, conf->samples, ops_total);
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void bench_report(const struct bench_conf_s * conf, const char * name, double * ns_per_op, unsigned nb, uint64_t ops) {
+    double min, med, max;
+
+    if (nb == 0) {
+        return;
+    }
+    qsort(ns_per_op, nb, sizeof ns_per_op[0], compare_double);
+    min = ns_per_op[0];
+    max = ns_per_op[nb - 1];
+    med = ((nb % 2) == 1) ? ns_per_op[nb / 2] : ((ns_per_op[nb / 2 - 1] + ns_per_op[nb / 2]) / 2);
+
+    switch (conf->fmt) {
+        case BENCH_FMT_TEXT:
+            fprintf(conf->out, "%-44s %12.2f %12.2f %12.2f %12llu\n", name, med, min, max, (unsigned long long)ops);
+            break;
+        case BENCH_FMT_CSV:
+            fprintf(conf->out, "%s,%s,%u,%llu,%.2f,%.2f,%.2f\n", conf->suite, name, nb, (unsigned long long)ops, min, med, max);
+            break;
+        case BENCH_FMT_JSON:
+            fprintf(conf->out, "{\"suite\":\"%s\",\"case\":\"%s\",\"samples\":%u,\"ops\":%llu,\"ns_min\":%.2f,\"ns_med\":%.2f,\"ns_max\":%.2f}\n", conf->suite, name, nb, (unsigned long long)ops, min, med, max);
+            break;
+    }
+    fflush(conf->out);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int64_t bench_time_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,156 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Fast JSON number & string emitters, writing directly into a buffer
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>       /* signbit, isfinite */
+
+#include "jsonw.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define FIXED_MAX       4503599627370496.0 /* 2^52, largest scaled value for which the rounding below is exact */
+
+static const uint32_t pow10_table[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int jsonw_str(char * out, const char * str) {
+    size_t len = strlen(str);
+
+    memcpy(out, str, len);
+
+    return (int)len;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int jsonw_uint(char * out, uint64_t val) {
+    char tmp[20];
+    int n = 0;
+    int i;
+
+    /* digits are generated from the least significant one, then reversed */
+    do {
+        tmp[n++] = (char)('0' + (val % 10));
+        val /= 10;
+    } while (val != 0);
+    for (i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int jsonw_int(char * out, int64_t val) {
+    if (val < 0) {
+        out[0] = '-';
+        return 1 + jsonw_uint(out + 1, (uint64_t)0 - (uint64_t)val);
+    }
+
+    return jsonw_uint(out, (uint64_t)val);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int jsonw_uint_pad(char * out, uint32_t val, int width, char pad) {
+    char tmp[10];
+    int n, i;
+
+    n = jsonw_uint(tmp, val);
+    for (i = 0; i < (width - n); i++) {
+        out[i] = pad;
+    }
+    memcpy(out + i, tmp, n);
+
+    return i + n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int jsonw_fixed(char * out, double val, unsigned decimals) {
+    char tmp[64];
+    double scaled;
+    uint64_t u, p;
+    int n = 0;
+    int len;
+
+    if (decimals > 9) {
+        decimals = 9;
+    }
+    p = pow10_table[decimals];
+    scaled = ((val < 0) ? -val : val) * (double)p;
+    if (!isfinite(val) || (scaled >= FIXED_MAX)) {
+        len = snprintf(tmp, sizeof tmp, "%.*f", decimals, val);
+        memcpy(out, tmp, len);
+        return len;
+    }
+
+    /* round half to even, as printf does with the default rounding mode */
+    u = (uint64_t)scaled;
+    if (((scaled - (double)u) > 0.5) || (((scaled - (double)u) == 0.5) && ((u & 1) == 1))) {
+        u += 1;
+    }
+
+    /* the sign is kept for negative values rounded to zero, as with printf */
+    if (signbit(val)) {
+        out[n++] = '-';
+    }
+    n += jsonw_uint(out + n, u / p);
+    if (decimals > 0) {
+        out[n++] = '.';
+        n += jsonw_uint_pad(out + n, (uint32_t)(u % p), decimals, '0');
+    }
+
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int jsonw_decimal(char * out, int64_t val, unsigned decimals) {
+    uint64_t u, p;
+    int n = 0;
+
+    if (decimals > 9) {
+        decimals = 9;
+    }
+    p = pow10_table[decimals];
+
+    if (val < 0) {
+        out[n++] = '-';
+        u = -(uint64_t)val;
+    } else {
+        u = (uint64_t)val;
+    }
+    n += jsonw_uint(out + n, u / p);
+    if (decimals > 0) {
+        out[n++] = '.';
+        n += jsonw_uint_pad(out + n, (uint32_t)(u % p), decimals, '0');
+    }
+
+    return n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,294 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LZ4 block format compression & decompression, with an external dictionary
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>     /* memcpy */
+
+#include "lz4blk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define MIN_MATCH       4       /* shortest match, coded as 0 in the token */
+#define LAST_LITERALS   5       /* the last bytes of a block are always literals */
+#define MF_LIMIT        12      /* no match starts in the last bytes of a block */
+#define MAX_OFFSET      65535   /* farthest match */
+#define RUN_MASK        15      /* length field of the token saturated, more length bytes follow */
+
+#define HASH_LOG        12      /* size of the table of the last positions of each hash */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+/* the most common values come last, to be the positions kept in the hash table */
+const uint8_t lz4blk_dict_up[] =
+    "{\"stat\":{\"time\":\"2019-01-01 00:00:00 GMT\",\"lati\":0.00000,\"long\":0.00000,\"alti\":0,"
+    "\"rxnb\":0,\"rxok\":0,\"rxfw\":0,\"ackr\":100.0,\"dwnb\":0,\"txnb\":0,\"temp\":0.0,"
+    "\"ulat\":{\"parse\":[0,0,0],\"queue\":[0,0,0],\"serial\":[0,0,0],\"send\":[0,0,0],\"total\":[0,0,0]},"
+    "\"rxfl\":{\"addr\":0,\"join\":0},\"rxdp\":0,"
+    "\"chst\":[{\"chan\":0,\"rxnb\":0,\"rxbd\":0,\"rxnc\":0,\"rssi\":[-100.0,0.0,-100.0,-100.0],\"lsnr\":[0.0,0.0,0.0,0.0],\"sf\":[0,0,0,0,0,0,0,0]}],"
+    "\"arbs\":{\"sf\":0,\"det\":[0,0,0,0],\"alc\":[0,0,0,0]},"
+    "\"spec\":[{\"freq\":868.100000,\"nscan\":0,\"p50\":-100,\"p90\":-100,\"p99\":-100,\"max\":-100}]}}"
+    "{\"rxpk\":[{\"jver\":1,\"tmst\":0,\"time\":\"2019-01-01T00:00:00.000000Z\",\"tmms\":0,\"ftime\":0,"
+    "\"chan\":0,\"rfch\":0,\"freq\":868.100000,\"mid\": 0,\"stat\":1,\"modu\":\"FSK\",\"datr\":50000,"
+    "\"rssi\":-100,\"size\":0,\"data\":\"\",\"hlat\":0},"
+    "{\"jver\":1,\"tmst\":0,\"chan\":0,\"rfch\":1,\"freq\":867.100000,\"mid\": 0,\"stat\":-1,\"modu\":\"LORA\","
+    "\"datr\":\"SF12BW125\",\"codr\":\"4/5\",\"rssis\":-110,\"lsnr\":-10.0,\"foff\":0,\"rssi\":-110,\"size\":0,\"data\":\"\"},"
+    "{\"jver\":1,\"tmst\":0,\"chan\":0,\"rfch\":0,\"freq\":868.300000,\"mid\": 0,\"stat\":1,\"modu\":\"LORA\","
+    "\"datr\":\"SF7BW125\",\"codr\":\"4/5\",\"rssis\":-100,\"lsnr\":9.0,\"foff\":0,\"rssi\":-100,\"size\":0,\"data\":\"";
+
+const int lz4blk_dict_up_size = sizeof lz4blk_dict_up - 1; /* without the string terminator */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* the dictionary and the input seen as a single window, positions below dict_len being in the dictionary */
+struct window_s {
+    const uint8_t * dict;
+    int dict_len;
+    const uint8_t * in;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static inline uint8_t win_byte(const struct window_s * w, int pos) {
+    return (pos < w->dict_len) ? w->dict[pos] : w->in[pos - w->dict_len];
+}
+
+static inline uint32_t win_read32(const struct window_s * w, int pos) {
+    uint8_t b[4];
+    uint32_t x;
+    int k;
+
+    if (pos >= w->dict_len) {
+        memcpy(&x, w->in + (pos - w->dict_len), 4);
+    } else if ((pos + 4) <= w->dict_len) {
+        memcpy(&x, w->dict + pos, 4);
+    } else {
+        /* across the end of the dictionary */
+        for (k = 0; k < 4; k++) {
+            b[k] = win_byte(w, pos + k);
+        }
+        memcpy(&x, b, 4);
+    }
+
+    return x;
+}
+
+static inline uint32_t hash32(uint32_t x) {
+    return (x * 2654435761U) >> (32 - HASH_LOG);
+}
+
+static int put_length(uint8_t * out, int max_len, int op, int len) {
+    while (len >= 255) {
+        if (op >= max_len) {
+            return -1;
+        }
+        out[op++] = 255;
+        len -= 255;
+    }
+    if (op >= max_len) {
+        return -1;
+    }
+    out[op++] = (uint8_t)len;
+
+    return op;
+}
+
+/* one sequence: literals from the input, then a match if match_len is not 0 */
+static int put_sequence(uint8_t * out, int max_len, int op, const uint8_t * lit, int lit_len, int offset, int match_len) {
+    int tok = op;
+
+    if (op >= max_len) {
+        return -1;
+    }
+    out[op++] = (uint8_t)((((lit_len < RUN_MASK) ? lit_len : RUN_MASK) << 4));
+    if (lit_len >= RUN_MASK) {
+        op = put_length(out, max_len, op, lit_len - RUN_MASK);
+        if (op < 0) {
+            return -1;
+        }
+    }
+    if ((op + lit_len) > max_len) {
+        return -1;
+    }
+    memcpy(out + op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+    if ((op + 2) > max_len) {
+        return -1;
+    }
+    out[op++] = (uint8_t)offset;
+    out[op++] = (uint8_t)(offset >> 8);
+    match_len -= MIN_MATCH;
+    out[tok] |= (uint8_t)((match_len < RUN_MASK) ? match_len : RUN_MASK);
+    if (match_len >= RUN_MASK) {
+        op = put_length(out, max_len, op, match_len - RUN_MASK);
+    }
+
+    return op;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lz4blk_compress(const uint8_t * in, int size, uint8_t * out, int max_len, const uint8_t * dict, int dict_len) {
+    int32_t table[1 << HASH_LOG]; /* last position of each hash, in the window, -1 if none */
+    struct window_s w;
+    uint32_t x;
+    int end, mf_limit, match_limit;
+    int ip, anchor, ref, len, op, h;
+
+    if ((in == NULL) || (out == NULL) || (size < 0)) {
+        return -1;
+    }
+    if ((dict == NULL) || (dict_len < 0)) {
+        dict_len = 0;
+    }
+    if (dict_len > MAX_OFFSET) {
+        dict += dict_len - MAX_OFFSET;
+        dict_len = MAX_OFFSET;
+    }
+
+    w.dict = dict;
+    w.dict_len = dict_len;
+    w.in = in;
+    memset(table, 0xFF, sizeof table);
+    for (ip = 0; (ip + MIN_MATCH) <= dict_len; ip++) {
+        table[hash32(win_read32(&w, ip))] = ip;
+    }
+
+    ip = dict_len;
+    anchor = ip;
+    end = dict_len + size;
+    mf_limit = end - MF_LIMIT;
+    match_limit = end - LAST_LITERALS;
+    op = 0;
+    while (ip < mf_limit) {
+        x = win_read32(&w, ip);
+        h = hash32(x);
+        ref = table[h];
+        table[h] = ip;
+        if ((ref < 0) || ((ip - ref) > MAX_OFFSET) || (win_read32(&w, ref) != x)) {
+            ip += 1;
+            continue;
+        }
+
+        /* extend the match backward on the pending literals, then forward */
+        while ((ip > anchor) && (ref > 0) && (in[ip - 1 - dict_len] == win_byte(&w, ref - 1))) {
+            ip -= 1;
+            ref -= 1;
+        }
+        len = MIN_MATCH;
+        while (((ip + len) < match_limit) && (in[ip + len - dict_len] == win_byte(&w, ref + len))) {
+            len += 1;
+        }
+
+        op = put_sequence(out, max_len, op, in + (anchor - dict_len), ip - anchor, ip - ref, len);
+        if (op < 0) {
+            return -1;
+        }
+        ip += len;
+        anchor = ip;
+        if (ip < mf_limit) {
+            table[hash32(win_read32(&w, ip - 2))] = ip - 2;
+        }
+    }
+
+    /* the rest is the literals of the last sequence */
+    return put_sequence(out, max_len, op, in + (anchor - dict_len), end - anchor, 0, 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lz4blk_decompress(const uint8_t * in, int size, uint8_t * out, int max_len, const uint8_t * dict, int dict_len) {
+    int ip = 0;
+    int op = 0;
+    int len, offset, src, k;
+    uint8_t token;
+    uint8_t b;
+
+    if ((in == NULL) || (out == NULL) || (size <= 0)) {
+        return -1;
+    }
+    if ((dict == NULL) || (dict_len < 0)) {
+        dict_len = 0;
+    }
+
+    while (1) {
+        token = in[ip++];
+
+        /* literals */
+        len = token >> 4;
+        if (len == RUN_MASK) {
+            do {
+                if (ip >= size) {
+                    return -1;
+                }
+                b = in[ip++];
+                len += b;
+            } while (b == 255);
+        }
+        if (((ip + len) > size) || ((op + len) > max_len)) {
+            return -1;
+        }
+        memcpy(out + op, in + ip, len);
+        ip += len;
+        op += len;
+        if (ip == size) {
+            return op; /* the last sequence has no match */
+        }
+
+        /* match */
+        if ((ip + 2) > size) {
+            return -1;
+        }
+        offset = in[ip] | (in[ip + 1] << 8);
+        ip += 2;
+        len = token & RUN_MASK;
+        if (len == RUN_MASK) {
+            do {
+                if (ip >= size) {
+                    return -1;
+                }
+                b = in[ip++];
+                len += b;
+            } while (b == 255);
+        }
+        len += MIN_MATCH;
+        if ((offset == 0) || (offset > (op + dict_len)) || ((op + len) > max_len) || (ip >= size)) {
+            return -1;
+        }
+        src = op - offset;
+        if ((src >= 0) && (offset >= len)) {
+            memcpy(out + op, out + src, len);
+            op += len;
+            continue;
+        }
+        /* from the dictionary, or overlapping the bytes being written */
+        for (k = 0; k < len; k++, src++) {
+            out[op++] = (src < 0) ? dict[dict_len + src] : out[src];
+        }
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
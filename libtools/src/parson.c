@@ -35,6 +35,7 @@
 #define STARTING_CAPACITY         15
 #define ARRAY_MAX_CAPACITY    122880 /* 15*(2^13) */
 #define OBJECT_MAX_CAPACITY      960 /* 15*(2^6)  */
+#define OBJECT_INDEX_THRESHOLD    16 /* objects with more names are looked up through a hash index */
 #define MAX_NESTING               19
 #define DOUBLE_SERIALIZATION_FORMAT "%f"
 
@@ -67,10 +68,13 @@ struct json_value_t {
 };
 
 struct json_object_t {
-    char       **names;
-    JSON_Value **values;
-    size_t       count;
-    size_t       capacity;
+    char          **names;
+    JSON_Value    **values;
+    unsigned long  *hashes;         /* hash of each name, computed once when added */
+    size_t         *index;          /* open addressing on the hashes, item index + 1, 0 if free, NULL for small objects */
+    size_t          index_capacity; /* power of 2, at least twice the capacity */
+    size_t          count;
+    size_t          capacity;
 };
 
 struct json_array_t {
@@ -95,6 +99,10 @@ static JSON_Object * json_object_init(void);
 static JSON_Status   json_object_add(JSON_Object *object, const char *name, JSON_Value *value);
 static JSON_Status   json_object_resize(JSON_Object *object, size_t new_capacity);
 static JSON_Value  * json_object_nget_value(const JSON_Object *object, const char *name, size_t n);
+static unsigned long json_name_hash(const char *name, size_t n);
+static int           json_object_nget_index(const JSON_Object *object, const char *name, size_t n, size_t *item);
+static void          json_object_index_insert(JSON_Object *object, size_t item);
+static JSON_Status   json_object_index_build(JSON_Object *object);
 static void          json_object_free(JSON_Object *object);
 
 /* JSON Array */
@@ -293,6 +301,9 @@ static JSON_Object * json_object_init(void) {
         return NULL;
     new_obj->names = (char**)NULL;
     new_obj->values = (JSON_Value**)NULL;
+    new_obj->hashes = (unsigned long*)NULL;
+    new_obj->index = (size_t*)NULL;
+    new_obj->index_capacity = 0;
     new_obj->capacity = 0;
     new_obj->count = 0;
     return new_obj;
@@ -317,13 +328,20 @@ static JSON_Status json_object_add(JSON_Object *object, const char *name, JSON_V
     if (object->names[index] == NULL)
         return JSONFailure;
     object->values[index] = value;
+    object->hashes[index] = json_name_hash(name, strlen(name));
     object->count++;
+    if (object->index != NULL) {
+        json_object_index_insert(object, index);
+    } else if (object->count > OBJECT_INDEX_THRESHOLD) {
+        json_object_index_build(object); /* lookups stay linear if it fails */
+    }
     return JSONSuccess;
 }
 
 static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity) {
     char **temp_names = NULL;
     JSON_Value **temp_values = NULL;
+    unsigned long *temp_hashes = NULL;
 
     if ((object->names == NULL && object->values != NULL) ||
         (object->names != NULL && object->values == NULL) ||
@@ -341,27 +359,99 @@ static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity)
         return JSONFailure;
     }
 
+    temp_hashes = (unsigned long*)parson_malloc(new_capacity * sizeof(unsigned long));
+    if (temp_hashes == NULL) {
+        parson_free(temp_names);
+        parson_free(temp_values);
+        return JSONFailure;
+    }
+
     if (object->names != NULL && object->values != NULL && object->count > 0) {
         memcpy(temp_names, object->names, object->count * sizeof(char*));
         memcpy(temp_values, object->values, object->count * sizeof(JSON_Value*));
+        memcpy(temp_hashes, object->hashes, object->count * sizeof(unsigned long));
     }
     parson_free(object->names);
     parson_free(object->values);
+    parson_free(object->hashes);
     object->names = temp_names;
     object->values = temp_values;
+    object->hashes = temp_hashes;
     object->capacity = new_capacity;
+    if (object->count > OBJECT_INDEX_THRESHOLD) {
+        json_object_index_build(object); /* sized for the new capacity */
+    }
     return JSONSuccess;
 }
 
-static JSON_Value * json_object_nget_value(const JSON_Object *object, const char *name, size_t n) {
-    size_t i, name_length;
-    for (i = 0; i < json_object_get_count(object); i++) {
-        name_length = strlen(object->names[i]);
-        if (name_length != n)
-            continue;
-        if (strncmp(object->names[i], name, n) == 0)
-            return object->values[i];
+static unsigned long json_name_hash(const char *name, size_t n) {
+    unsigned long hash = 2166136261UL; /* FNV-1a */
+    size_t i;
+    for (i = 0; i < n; i++) {
+        hash = ((hash ^ (unsigned char)name[i]) * 16777619UL) & 0xFFFFFFFFUL;
     }
+    return hash;
+}
+
+static int json_object_nget_index(const JSON_Object *object, const char *name, size_t n, size_t *item) {
+    size_t i, slot;
+    unsigned long hash;
+    if (object == NULL || object->names == NULL) {
+        return 0;
+    }
+    if (object->index == NULL) {
+        for (i = 0; i < object->count; i++) {
+            if (strncmp(object->names[i], name, n) == 0 && object->names[i][n] == '\0') {
+                *item = i;
+                return 1;
+            }
+        }
+        return 0;
+    }
+    hash = json_name_hash(name, n);
+    for (slot = hash & (object->index_capacity - 1); object->index[slot] != 0; slot = (slot + 1) & (object->index_capacity - 1)) {
+        i = object->index[slot] - 1;
+        if (object->hashes[i] == hash && strncmp(object->names[i], name, n) == 0 && object->names[i][n] == '\0') {
+            *item = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void json_object_index_insert(JSON_Object *object, size_t item) {
+    size_t slot = object->hashes[item] & (object->index_capacity - 1);
+    while (object->index[slot] != 0) {
+        slot = (slot + 1) & (object->index_capacity - 1);
+    }
+    object->index[slot] = item + 1;
+}
+
+static JSON_Status json_object_index_build(JSON_Object *object) {
+    size_t i, new_capacity = 1;
+    while (new_capacity < (2 * object->capacity)) {
+        new_capacity *= 2;
+    }
+    if (object->index == NULL || object->index_capacity != new_capacity) {
+        parson_free(object->index);
+        object->index = (size_t*)parson_malloc(new_capacity * sizeof(size_t));
+        if (object->index == NULL) {
+            object->index_capacity = 0;
+            return JSONFailure;
+        }
+        object->index_capacity = new_capacity;
+    }
+    memset(object->index, 0, object->index_capacity * sizeof(size_t));
+    for (i = 0; i < object->count; i++) {
+        json_object_index_insert(object, i);
+    }
+    return JSONSuccess;
+}
+
+static JSON_Value * json_object_nget_value(const JSON_Object *object, const char *name, size_t n) {
+    size_t i;
+    if (json_object_nget_index(object, name, n, &i))
+        return object->values[i];
     return NULL;
 }
 
@@ -372,6 +462,8 @@ static void json_object_free(JSON_Object *object) {
     }
     parson_free(object->names);
     parson_free(object->values);
+    parson_free(object->hashes);
+    parson_free(object->index);
     parson_free(object);
 }
 
@@ -1464,15 +1556,11 @@ JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Va
     JSON_Value *old_value;
     if (object == NULL || name == NULL || value == NULL)
         return JSONFailure;
-    old_value = json_object_get_value(object, name);
-    if (old_value != NULL) { /* free and overwrite old value */
+    if (json_object_nget_index(object, name, strlen(name), &i)) { /* free and overwrite old value */
+        old_value = object->values[i];
         json_value_free(old_value);
-        for (i = 0; i < json_object_get_count(object); i++) {
-            if (strcmp(object->names[i], name) == 0) {
-                object->values[i] = value;
-                return JSONSuccess;
-            }
-        }
+        object->values[i] = value;
+        return JSONSuccess;
     }
     /* add new key value pair */
     return json_object_add(object, name, value);
@@ -1571,22 +1659,21 @@ JSON_Status json_object_dotset_null(JSON_Object *object, const char *name) {
 
 JSON_Status json_object_remove(JSON_Object *object, const char *name) {
     size_t i = 0, last_item_index = 0;
-    if (object == NULL || json_object_get_value(object, name) == NULL)
+    if (object == NULL || name == NULL || !json_object_nget_index(object, name, strlen(name), &i))
         return JSONFailure;
     last_item_index = json_object_get_count(object) - 1;
-    for (i = 0; i < json_object_get_count(object); i++) {
-        if (strcmp(object->names[i], name) == 0) {
-            parson_free(object->names[i]);
-            json_value_free(object->values[i]);
-            if (i != last_item_index) { /* Replace key value pair with one from the end */
-                object->names[i] = object->names[last_item_index];
-                object->values[i] = object->values[last_item_index];
-            }
-            object->count -= 1;
-            return JSONSuccess;
-        }
+    parson_free(object->names[i]);
+    json_value_free(object->values[i]);
+    if (i != last_item_index) { /* Replace key value pair with one from the end */
+        object->names[i] = object->names[last_item_index];
+        object->values[i] = object->values[last_item_index];
+        object->hashes[i] = object->hashes[last_item_index];
+    }
+    object->count -= 1;
+    if (object->index != NULL) {
+        json_object_index_build(object); /* lookups stay linear if it fails, the item is removed anyway */
     }
-    return JSONFailure; /* No execution path should end here */
+    return JSONSuccess;
 }
 
 JSON_Status json_object_dotremove(JSON_Object *object, const char *name) {
@@ -1617,6 +1704,9 @@ JSON_Status json_object_clear(JSON_Object *object) {
         json_value_free(object->values[i]);
     }
     object->count = 0;
+    if (object->index != NULL) {
+        memset(object->index, 0, object->index_capacity * sizeof(size_t));
+    }
     return JSONSuccess;
 }
 
@@ -0,0 +1,289 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Micro-benchmarks of the libtools: Base64, CRC16, and the serialization
+    of a rxpk object with the JSON emitters, against snprintf
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* printf, snprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* strcmp */
+#include <unistd.h>     /* getopt */
+
+#include "bench.h"
+#include "base64.h"
+#include "crc16.h"
+#include "jsonw.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_BUFFERS      64      /* payloads cycled through, to not always hit the same cache lines */
+#define BUFFER_SIZE     255
+#define B64_SIZE        341     /* 255 bytes = 340 chars in b64 + null char */
+#define RXPK_SIZE       768     /* longest rxpk object, with a 255-byte payload */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* Metadata of a received packet, as serialized by the packet forwarder */
+struct rxpk_s {
+    uint32_t tmst;
+    uint8_t chan;
+    uint8_t rfch;
+    uint32_t freq_hz;
+    uint8_t mid;
+    int8_t stat;
+    uint8_t sf;
+    uint16_t bw_khz;
+    uint8_t cr;         /* 4/<cr> */
+    int16_t rssis;
+    int16_t snr_x10;
+    int32_t foff;
+    int16_t rssi;
+    const uint8_t * payload;
+};
+
+struct case_s {
+    int size;           /* payload size */
+    char * out;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t buffers[NB_BUFFERS][BUFFER_SIZE];
+static char strings[NB_BUFFERS][B64_SIZE];
+static struct rxpk_s rxpk[NB_BUFFERS];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t case_b64_encode(void * arg, uint64_t nb) {
+    const struct case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += bin_to_b64(buffers[i % NB_BUFFERS], c->size, c->out, B64_SIZE);
+    }
+
+    return nb;
+}
+
+static uint64_t case_b64_decode(void * arg, uint64_t nb) {
+    const struct case_s * c = arg;
+    uint8_t bin[BUFFER_SIZE];
+    uint64_t i;
+    int len = ((c->size + 2) / 3) * 4;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += b64_to_bin(strings[i % NB_BUFFERS], len, bin, sizeof bin);
+    }
+
+    return nb;
+}
+
+static uint64_t case_crc16_ccitt(void * arg, uint64_t nb) {
+    const struct case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += crc16_ccitt(buffers[i % NB_BUFFERS], c->size);
+    }
+
+    return nb;
+}
+
+static uint64_t case_crc16_lora(void * arg, uint64_t nb) {
+    const struct case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += crc16_lora(buffers[i % NB_BUFFERS], c->size);
+    }
+
+    return nb;
+}
+
+/* Same object as the packet forwarder, its payload of the given size encoded in Base64 */
+static int rxpk_jsonw(char * out, const struct rxpk_s * p, int size) {
+    char * o = out;
+
+    o += jsonw_str(o, "{\"jver\":1,\"tmst\":");
+    o += jsonw_uint(o, p->tmst);
+    o += jsonw_str(o, ",\"chan\":");
+    o += jsonw_uint(o, p->chan);
+    o += jsonw_str(o, ",\"rfch\":");
+    o += jsonw_uint(o, p->rfch);
+    o += jsonw_str(o, ",\"freq\":");
+    o += jsonw_uint(o, p->freq_hz / 1000000);
+    *(o++) = '.';
+    o += jsonw_uint_pad(o, p->freq_hz % 1000000, 6, '0');
+    o += jsonw_str(o, ",\"mid\":");
+    o += jsonw_uint_pad(o, p->mid, 2, ' ');
+    o += jsonw_str(o, ",\"stat\":");
+    o += jsonw_int(o, p->stat);
+    o += jsonw_str(o, ",\"modu\":\"LORA\",\"datr\":\"SF");
+    o += jsonw_uint(o, p->sf);
+    o += jsonw_str(o, "BW");
+    o += jsonw_uint(o, p->bw_khz);
+    o += jsonw_str(o, "\",\"codr\":\"4/");
+    o += jsonw_uint(o, p->cr);
+    o += jsonw_str(o, "\",\"rssis\":");
+    o += jsonw_int(o, p->rssis);
+    o += jsonw_str(o, ",\"lsnr\":");
+    o += jsonw_decimal(o, p->snr_x10, 1);
+    o += jsonw_str(o, ",\"foff\":");
+    o += jsonw_int(o, p->foff);
+    o += jsonw_str(o, ",\"rssi\":");
+    o += jsonw_int(o, p->rssi);
+    o += jsonw_str(o, ",\"size\":");
+    o += jsonw_uint(o, size);
+    o += jsonw_str(o, ",\"data\":\"");
+    o += bin_to_b64(p->payload, size, o, B64_SIZE);
+    o += jsonw_str(o, "\"}");
+    *o = '\0';
+
+    return o - out;
+}
+
+static int rxpk_snprintf(char * out, const struct rxpk_s * p, int size) {
+    int n;
+
+    n = snprintf(out, RXPK_SIZE, "{\"jver\":1,\"tmst\":%u,\"chan\":%u,\"rfch\":%u,\"freq\":%u.%06u,\"mid\":%2u,\"stat\":%d"
+                 ",\"modu\":\"LORA\",\"datr\":\"SF%uBW%u\",\"codr\":\"4/%u\",\"rssis\":%d,\"lsnr\":%.1f,\"foff\":%d,\"rssi\":%d,\"size\":%u,\"data\":\"",
+                 p->tmst, p->chan, p->rfch, p->freq_hz / 1000000, p->freq_hz % 1000000, p->mid, p->stat,
+                 p->sf, p->bw_khz, p->cr, p->rssis, p->snr_x10 / 10.0, p->foff, p->rssi, size);
+    n += bin_to_b64(p->payload, size, out + n, RXPK_SIZE - n);
+    n += snprintf(out + n, RXPK_SIZE - n, "\"}");
+
+    return n;
+}
+
+static uint64_t case_rxpk_jsonw(void * arg, uint64_t nb) {
+    const struct case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += rxpk_jsonw(c->out, &rxpk[i % NB_BUFFERS], c->size);
+    }
+
+    return nb;
+}
+
+static uint64_t case_rxpk_snprintf(void * arg, uint64_t nb) {
+    const struct case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += rxpk_snprintf(c->out, &rxpk[i % NB_BUFFERS], c->size);
+    }
+
+    return nb;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    static const int sizes[] = { 16, 64, 255 };
+    int i, s, b;
+    char name[64];
+    char out[RXPK_SIZE];
+    char ref[RXPK_SIZE];
+    struct case_s c;
+    struct bench_conf_s conf;
+
+    bench_init(&conf, "libtools");
+    while ((i = getopt(argc, argv, "h" BENCH_OPTIONS)) != -1) {
+        if (i == 'h') {
+            bench_usage();
+            return -1;
+        }
+        if (bench_option(&conf, i, optarg) != 0) {
+            printf("ERROR: argument parsing\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    srand(0);
+    for (b = 0; b < NB_BUFFERS; b++) {
+        for (i = 0; i < BUFFER_SIZE; i++) {
+            buffers[b][i] = (uint8_t)rand();
+        }
+        bin_to_b64(buffers[b], BUFFER_SIZE, strings[b], B64_SIZE);
+        rxpk[b].tmst = (uint32_t)rand();
+        rxpk[b].chan = rand() % 8;
+        rxpk[b].rfch = rand() % 2;
+        rxpk[b].freq_hz = 867100000 + (rand() % 8) * 200000;
+        rxpk[b].mid = rand() % 16;
+        rxpk[b].stat = 1;
+        rxpk[b].sf = 7 + (rand() % 6);
+        rxpk[b].bw_khz = 125;
+        rxpk[b].cr = 5;
+        rxpk[b].rssis = -120 + (rand() % 80);
+        rxpk[b].snr_x10 = -200 + (rand() % 300);
+        rxpk[b].foff = -5000 + (rand() % 10000);
+        rxpk[b].rssi = rxpk[b].rssis + 2;
+        rxpk[b].payload = buffers[b];
+    }
+
+    /* The emitters must match snprintf before being compared to it */
+    for (b = 0; b < NB_BUFFERS; b++) {
+        rxpk_jsonw(out, &rxpk[b], 64);
+        rxpk_snprintf(ref, &rxpk[b], 64);
+        if (strcmp(out, ref) != 0) {
+            printf("ERROR: rxpk mismatch:\n%s\n%s\n", out, ref);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_begin(&conf);
+    c.out = out;
+    for (s = 0; s < (int)(sizeof sizes / sizeof sizes[0]); s++) {
+        c.size = sizes[s];
+        snprintf(name, sizeof name, "base64/encode/%d", c.size);
+        bench_run(&conf, name, case_b64_encode, &c);
+        snprintf(name, sizeof name, "base64/decode/%d", c.size);
+        bench_run(&conf, name, case_b64_decode, &c);
+    }
+    for (s = 0; s < (int)(sizeof sizes / sizeof sizes[0]); s++) {
+        c.size = sizes[s];
+        snprintf(name, sizeof name, "crc16/ccitt/%d", c.size);
+        bench_run(&conf, name, case_crc16_ccitt, &c);
+        snprintf(name, sizeof name, "crc16/lora/%d", c.size);
+        bench_run(&conf, name, case_crc16_lora, &c);
+    }
+    for (s = 0; s < (int)(sizeof sizes / sizeof sizes[0]); s++) {
+        c.size = sizes[s];
+        snprintf(name, sizeof name, "rxpk/jsonw/%d", c.size);
+        bench_run(&conf, name, case_rxpk_jsonw, &c);
+        snprintf(name, sizeof name, "rxpk/snprintf/%d", c.size);
+        bench_run(&conf, name, case_rxpk_snprintf, &c);
+    }
+    bench_end(&conf);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
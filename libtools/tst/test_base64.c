@@ -0,0 +1,160 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Check the table-driven Base64 library against a char-by-char reference,
+    round-trip all payload sizes, and measure the throughput
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memcmp */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* getopt */
+
+#include "base64.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_BUFFERS      64
+#define BUFFER_SIZE     255
+#define B64_SIZE        341 /* 255 bytes = 340 chars in b64 + null char */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t buffers[NB_BUFFERS][BUFFER_SIZE];
+static char strings[NB_BUFFERS][B64_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Char by char reference encoder, padded */
+static int ref_bin_to_b64(const uint8_t * in, int size, char * out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int i, n = 0;
+    uint32_t b;
+
+    for (i = 0; i < size; i += 3) {
+        b = (uint32_t)in[i] << 16;
+        if (i + 1 < size) b |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < size) b |= (uint32_t)in[i + 2];
+        out[n++] = alphabet[(b >> 18) & 0x3F];
+        out[n++] = alphabet[(b >> 12) & 0x3F];
+        out[n++] = (i + 1 < size) ? alphabet[(b >> 6) & 0x3F] : '=';
+        out[n++] = (i + 2 < size) ? alphabet[b & 0x3F] : '=';
+    }
+    out[n] = 0;
+
+    return n;
+}
+
+static double elapsed_ns(struct timespec start, struct timespec stop) {
+    return (double)(stop.tv_sec - start.tv_sec) * 1E9 + (double)(stop.tv_nsec - start.tv_nsec);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, size, len;
+    unsigned int arg_u;
+    unsigned r, b;
+    unsigned nb_rounds = 1000;
+    unsigned nb_err = 0;
+    char ref[B64_SIZE];
+    uint8_t bin[BUFFER_SIZE];
+    struct timespec start, stop;
+    double bytes, t_enc, t_dec;
+
+    while ((i = getopt(argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                printf(" -n <uint>  Number of benchmark rounds, default 1000\n");
+                return -1;
+            case 'n':
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument\n");
+                    return EXIT_FAILURE;
+                }
+                nb_rounds = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### Base64 check & benchmark ###\n");
+
+    srand(0);
+    for (b = 0; b < NB_BUFFERS; b++) {
+        for (i = 0; i < BUFFER_SIZE; i++) {
+            buffers[b][i] = (uint8_t)rand();
+        }
+    }
+
+    /* Encode against the reference, then round-trip, padded and unpadded, for every size */
+    for (b = 0; b < NB_BUFFERS; b++) {
+        for (size = 0; size <= BUFFER_SIZE; size++) {
+            ref_bin_to_b64(buffers[b], size, ref);
+            len = bin_to_b64(buffers[b], size, strings[b], B64_SIZE);
+            if ((len != (int)strlen(ref)) || (strcmp(ref, strings[b]) != 0)) {
+                nb_err += 1;
+            }
+            if ((b64_to_bin(strings[b], len, bin, sizeof bin) != size) || (memcmp(bin, buffers[b], size) != 0)) {
+                nb_err += 1;
+            }
+            len = bin_to_b64_nopad(buffers[b], size, strings[b], B64_SIZE);
+            if ((b64_to_bin_nopad(strings[b], len, bin, sizeof bin) != size) || (memcmp(bin, buffers[b], size) != 0)) {
+                nb_err += 1;
+            }
+        }
+    }
+    printf("check: %u mismatches\n", nb_err);
+
+    /* Throughput on full size payloads */
+    bytes = (double)nb_rounds * NB_BUFFERS * BUFFER_SIZE;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < nb_rounds; r++) {
+        for (b = 0; b < NB_BUFFERS; b++) {
+            bin_to_b64(buffers[b], BUFFER_SIZE, strings[b], B64_SIZE);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    t_enc = elapsed_ns(start, stop);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < nb_rounds; r++) {
+        for (b = 0; b < NB_BUFFERS; b++) {
+            b64_to_bin(strings[b], B64_SIZE - 1, buffers[b], BUFFER_SIZE);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    t_dec = elapsed_ns(start, stop);
+    printf("encode %.2f ns/byte, decode %.2f ns/byte\n", t_enc / bytes, t_dec / bytes);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
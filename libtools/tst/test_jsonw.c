@@ -0,0 +1,256 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Check the JSON emitters against snprintf, and measure the time needed to
+    serialize the numeric fields of a datagram of 255 rxpk
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* printf, snprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memcmp */
+#include <math.h>       /* roundf */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* getopt */
+
+#include "jsonw.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_RXPK         255
+#define RXPK_MAX_SIZE   256 /* numeric fields only, payload excluded */
+
+static const double pow10_ref[4] = { 1.0, 10.0, 100.0, 1000.0 };
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct rxpk_s {
+    uint32_t    count_us;
+    uint32_t    ftime;
+    uint64_t    tmms;
+    uint8_t     if_chain;
+    uint8_t     rf_chain;
+    uint8_t     modem_id;
+    uint32_t    freq_hz;
+    float       rssis;
+    float       snr;
+    int32_t     freq_offset;
+    float       rssic;
+    uint16_t    size;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct rxpk_s rxpk[NB_RXPK];
+static char dgram_ref[NB_RXPK * RXPK_MAX_SIZE];
+static char dgram_jsonw[NB_RXPK * RXPK_MAX_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Numeric fields of the packet forwarder rxpk objects, as formatted with snprintf */
+static int serialize_ref(char * out) {
+    int i, n = 0;
+    const struct rxpk_s * p;
+
+    for (i = 0; i < NB_RXPK; i++) {
+        p = &rxpk[i];
+        n += sprintf(out + n, "{\"jver\":%d", 1);
+        n += sprintf(out + n, ",\"tmst\":%u", p->count_us);
+        n += sprintf(out + n, ",\"tmms\":%llu", (unsigned long long)p->tmms);
+        n += sprintf(out + n, ",\"ftime\":%u", p->ftime);
+        n += sprintf(out + n, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf,\"mid\":%2u", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6), p->modem_id);
+        n += sprintf(out + n, ",\"rssis\":%.0f", roundf(p->rssis));
+        n += sprintf(out + n, ",\"lsnr\":%.1f", p->snr);
+        n += sprintf(out + n, ",\"foff\":%d", p->freq_offset);
+        n += sprintf(out + n, ",\"rssi\":%.0f,\"size\":%u}", roundf(p->rssic), p->size);
+    }
+
+    return n;
+}
+
+/* Same fields, written by the JSON emitters */
+static int serialize_jsonw(char * out) {
+    int i;
+    char * o = out;
+    const struct rxpk_s * p;
+
+    for (i = 0; i < NB_RXPK; i++) {
+        p = &rxpk[i];
+        o += jsonw_str(o, "{\"jver\":");
+        o += jsonw_int(o, 1);
+        o += jsonw_str(o, ",\"tmst\":");
+        o += jsonw_uint(o, p->count_us);
+        o += jsonw_str(o, ",\"tmms\":");
+        o += jsonw_uint(o, p->tmms);
+        o += jsonw_str(o, ",\"ftime\":");
+        o += jsonw_uint(o, p->ftime);
+        o += jsonw_str(o, ",\"chan\":");
+        o += jsonw_uint(o, p->if_chain);
+        o += jsonw_str(o, ",\"rfch\":");
+        o += jsonw_uint(o, p->rf_chain);
+        o += jsonw_str(o, ",\"freq\":");
+        o += jsonw_uint(o, p->freq_hz / 1000000);
+        *o++ = '.';
+        o += jsonw_uint_pad(o, p->freq_hz % 1000000, 6, '0');
+        o += jsonw_str(o, ",\"mid\":");
+        o += jsonw_uint_pad(o, p->modem_id, 2, ' ');
+        o += jsonw_str(o, ",\"rssis\":");
+        o += jsonw_fixed(o, roundf(p->rssis), 0);
+        o += jsonw_str(o, ",\"lsnr\":");
+        o += jsonw_fixed(o, p->snr, 1);
+        o += jsonw_str(o, ",\"foff\":");
+        o += jsonw_int(o, p->freq_offset);
+        o += jsonw_str(o, ",\"rssi\":");
+        o += jsonw_fixed(o, roundf(p->rssic), 0);
+        o += jsonw_str(o, ",\"size\":");
+        o += jsonw_uint(o, p->size);
+        *o++ = '}';
+    }
+
+    return o - out;
+}
+
+static double elapsed_ns(struct timespec start, struct timespec stop) {
+    return (double)(stop.tv_sec - start.tv_sec) * 1E9 + (double)(stop.tv_nsec - start.tv_nsec);
+}
+
+static float rand_float(float min, float max) {
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, n, n_ref = 0, n_jsonw = 0;
+    unsigned int arg_u;
+    unsigned r, d;
+    unsigned nb_rounds = 1000;
+    unsigned nb_err = 0;
+    char ref[64], out[64];
+    float f;
+    struct timespec start, stop;
+    double t_ref, t_jsonw;
+
+    while ((i = getopt(argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                printf(" -n <uint>  Number of benchmark rounds, default 1000\n");
+                return -1;
+            case 'n':
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument\n");
+                    return EXIT_FAILURE;
+                }
+                nb_rounds = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### JSON emitters check & benchmark ###\n");
+
+    /* Fixed decimals formatting, including ties and negative zero */
+    srand(0);
+    for (r = 0; r < 1000000; r++) {
+        switch (r) {
+            case 0: f = -0.04f; break;
+            case 1: f = 0.25f; break;
+            case 2: f = -0.25f; break;
+            case 3: f = 2.5f; break;
+            default: f = rand_float(-150.0, 50.0); break;
+        }
+        for (d = 0; d < 4; d++) {
+            snprintf(ref, sizeof ref, "%.*f", d, f);
+            out[jsonw_fixed(out, f, d)] = '\0';
+            if (strcmp(ref, out) != 0) {
+                if (nb_err < 10) {
+                    printf("mismatch: %s vs %s\n", ref, out);
+                }
+                nb_err += 1;
+            }
+        }
+    }
+
+    /* Fixed-point integers formatting */
+    for (r = 0; r < 1000000; r++) {
+        n = (r < 2001) ? ((int)r - 1000) : ((rand() % 4000001) - 2000000);
+        for (d = 0; d < 4; d++) {
+            snprintf(ref, sizeof ref, "%.*f", d, (double)n / pow10_ref[d]);
+            out[jsonw_decimal(out, n, d)] = '\0';
+            if (strcmp(ref, out) != 0) {
+                if (nb_err < 10) {
+                    printf("mismatch: %s vs %s\n", ref, out);
+                }
+                nb_err += 1;
+            }
+        }
+    }
+
+    /* Datagram of 255 rxpk with random metadata */
+    for (i = 0; i < NB_RXPK; i++) {
+        rxpk[i].count_us = (uint32_t)rand() * 2 + (rand() & 1);
+        rxpk[i].ftime = (uint32_t)rand() % 1000000000;
+        rxpk[i].tmms = 1285579871592ULL + (uint64_t)rand();
+        rxpk[i].if_chain = rand() % 10;
+        rxpk[i].rf_chain = rand() % 2;
+        rxpk[i].modem_id = rand() % 16;
+        rxpk[i].freq_hz = 863000000 + (uint32_t)rand() % 65000000;
+        rxpk[i].rssis = rand_float(-140.0, -20.0);
+        rxpk[i].snr = rand_float(-25.0, 15.0);
+        rxpk[i].freq_offset = (rand() % 60001) - 30000;
+        rxpk[i].rssic = rand_float(-140.0, -20.0);
+        rxpk[i].size = rand() % 256;
+    }
+    n_ref = serialize_ref(dgram_ref);
+    n_jsonw = serialize_jsonw(dgram_jsonw);
+    if ((n_ref != n_jsonw) || (memcmp(dgram_ref, dgram_jsonw, n_ref) != 0)) {
+        printf("mismatch in datagram serialization\n");
+        nb_err += 1;
+    }
+    printf("check: %u mismatches\n", nb_err);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < nb_rounds; r++) {
+        n_ref = serialize_ref(dgram_ref);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    t_ref = elapsed_ns(start, stop) / nb_rounds;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < nb_rounds; r++) {
+        n_jsonw = serialize_jsonw(dgram_jsonw);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    t_jsonw = elapsed_ns(start, stop) / nb_rounds;
+    printf("%d rxpk (%d bytes): snprintf %.1f us, jsonw %.1f us (x%.1f)\n", NB_RXPK, n_jsonw, t_ref / 1000, t_jsonw / 1000, t_ref / t_jsonw);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
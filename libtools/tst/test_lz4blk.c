@@ -0,0 +1,202 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Check the LZ4 block library on a reference block, round-trip rxpk-like
+    and random data with and without dictionary, and measure the throughput
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* printf, snprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memcmp */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* getopt */
+
+#include "lz4blk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_BUFFERS      16
+#define BUFFER_SIZE     4096
+
+/* "abc", a match of 6 bytes 3 bytes back, then "xyzzy" */
+static const uint8_t ref_block[] = { 0x32, 'a', 'b', 'c', 0x03, 0x00, 0x50, 'x', 'y', 'z', 'z', 'y' };
+static const char ref_text[] = "abcabcabcxyzzy";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t json[NB_BUFFERS][BUFFER_SIZE];
+static int json_size[NB_BUFFERS];
+static uint8_t rnd[BUFFER_SIZE];
+static uint8_t block[LZ4BLK_BOUND(BUFFER_SIZE)];
+static uint8_t data[BUFFER_SIZE];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* a PUSH_DATA JSON body, with nb_pkt random rxpk */
+static int make_json(uint8_t * out, int max_len, int nb_pkt) {
+    static const char * datr[] = { "SF7BW125", "SF8BW125", "SF9BW125", "SF10BW125", "SF12BW125" };
+    int n, i, k, size;
+
+    n = snprintf((char *)out, max_len, "{\"rxpk\":[");
+    for (i = 0; i < nb_pkt; i++) {
+        size = 10 + (rand() % 40);
+        n += snprintf((char *)out + n, max_len - n, "%s{\"jver\":1,\"tmst\":%u,\"chan\":%d,\"rfch\":%d,\"freq\":%.6f,\"mid\":%2d,\"stat\":1,\"modu\":\"LORA\",\"datr\":\"%s\",\"codr\":\"4/5\",\"rssis\":%d,\"lsnr\":%.1f,\"foff\":%d,\"rssi\":%d,\"size\":%d,\"data\":\"",
+                      (i == 0) ? "" : ",", (unsigned)rand(), rand() % 8, rand() % 2, 867.1 + 0.2 * (rand() % 8), rand() % 16, datr[rand() % 5], -(rand() % 120), (rand() % 200) / 10.0 - 10.0, rand() % 500, -(rand() % 120), size);
+        for (k = 0; k < ((size * 4) / 3); k++) {
+            out[n++] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[rand() % 64];
+        }
+        n += snprintf((char *)out + n, max_len - n, "\"}");
+    }
+    n += snprintf((char *)out + n, max_len - n, "]}");
+
+    return n;
+}
+
+/* compress and decompress, counts the errors */
+static unsigned round_trip(const uint8_t * in, int size, const uint8_t * dict, int dict_len, int * packed) {
+    int len, n;
+
+    len = lz4blk_compress(in, size, block, sizeof block, dict, dict_len);
+    if ((len < 0) || (len > LZ4BLK_BOUND(size))) {
+        return 1;
+    }
+    *packed = len;
+    n = lz4blk_decompress(block, len, data, sizeof data, dict, dict_len);
+    if ((n != size) || (memcmp(data, in, size) != 0)) {
+        return 1;
+    }
+    /* the exact size must be enough, one byte less must be refused */
+    if ((size > 0) && (lz4blk_decompress(block, len, data, size - 1, dict, dict_len) != -1)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static double elapsed_ns(struct timespec start, struct timespec stop) {
+    return (double)(stop.tv_sec - start.tv_sec) * 1E9 + (double)(stop.tv_nsec - start.tv_nsec);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i, b, size, len;
+    unsigned int arg_u;
+    unsigned r;
+    unsigned nb_rounds = 1000;
+    unsigned nb_err = 0;
+    double in_bytes = 0.0, out_bytes = 0.0, dict_bytes = 0.0;
+    struct timespec start, stop;
+    double bytes, t_comp, t_dec;
+
+    while ((i = getopt(argc, argv, "hn:")) != -1) {
+        switch (i) {
+            case 'h':
+                printf(" -n <uint>  Number of benchmark rounds, default 1000\n");
+                return -1;
+            case 'n':
+                i = sscanf(optarg, "%u", &arg_u);
+                if ((i != 1) || (arg_u < 1)) {
+                    printf("ERROR: argument parsing of -n argument\n");
+                    return EXIT_FAILURE;
+                }
+                nb_rounds = arg_u;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("### LZ4 block check & benchmark ###\n");
+
+    /* Reference block */
+    len = lz4blk_decompress(ref_block, sizeof ref_block, data, sizeof data, NULL, 0);
+    if ((len != (int)strlen(ref_text)) || (memcmp(data, ref_text, len) != 0)) {
+        nb_err += 1;
+    }
+    /* truncated or pointing before the start, it must be refused */
+    for (i = 1; i < (int)sizeof ref_block; i++) {
+        if ((i != 4) && (lz4blk_decompress(ref_block, i, data, sizeof data, NULL, 0) != -1)) {
+            nb_err += 1;
+        }
+    }
+
+    /* Round-trip of all sizes of random and JSON data, then of full JSON datagrams */
+    srand(0);
+    for (i = 0; i < BUFFER_SIZE; i++) {
+        rnd[i] = (uint8_t)rand();
+    }
+    for (b = 0; b < NB_BUFFERS; b++) {
+        json_size[b] = make_json(json[b], BUFFER_SIZE, 1 + b);
+    }
+    for (size = 0; size <= 600; size++) {
+        nb_err += round_trip(rnd, size, NULL, 0, &len);
+        nb_err += round_trip(rnd, size, rnd + 1000, 500, &len);
+        nb_err += round_trip(json[NB_BUFFERS - 1], size, NULL, 0, &len);
+        nb_err += round_trip(json[NB_BUFFERS - 1], size, lz4blk_dict_up, lz4blk_dict_up_size, &len);
+    }
+    for (b = 0; b < NB_BUFFERS; b++) {
+        nb_err += round_trip(json[b], json_size[b], NULL, 0, &len);
+        out_bytes += len;
+        nb_err += round_trip(json[b], json_size[b], lz4blk_dict_up, lz4blk_dict_up_size, &len);
+        dict_bytes += len;
+        in_bytes += json_size[b];
+    }
+    /* random blocks must not crash the decoder */
+    for (r = 0; r < 10000; r++) {
+        for (i = 0; i < 64; i++) {
+            block[i] = (uint8_t)rand();
+        }
+        lz4blk_decompress(block, 1 + (r % 64), data, 256, lz4blk_dict_up, lz4blk_dict_up_size);
+    }
+    printf("check: %u mismatches\n", nb_err);
+    printf("rxpk ratio: %.1f %% without dictionary, %.1f %% with the upstream dictionary\n", 100.0 * out_bytes / in_bytes, 100.0 * dict_bytes / in_bytes);
+
+    /* Throughput on the JSON datagrams, with the dictionary */
+    bytes = (double)nb_rounds * in_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < nb_rounds; r++) {
+        for (b = 0; b < NB_BUFFERS; b++) {
+            lz4blk_compress(json[b], json_size[b], block, sizeof block, lz4blk_dict_up, lz4blk_dict_up_size);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    t_comp = elapsed_ns(start, stop);
+    len = lz4blk_compress(json[NB_BUFFERS - 1], json_size[NB_BUFFERS - 1], block, sizeof block, lz4blk_dict_up, lz4blk_dict_up_size);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < (nb_rounds * NB_BUFFERS); r++) {
+        lz4blk_decompress(block, len, data, sizeof data, lz4blk_dict_up, lz4blk_dict_up_size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    t_dec = elapsed_ns(start, stop);
+    printf("compress %.2f ns/byte, decompress %.2f ns/byte\n", t_comp / bytes, t_dec / ((double)nb_rounds * NB_BUFFERS * json_size[NB_BUFFERS - 1]));
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,174 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Check the parson object lookups across the hash index threshold: add, set
+    and remove names, with and without the index (allocation failure)
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, snprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, malloc */
+
+#include "parson.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_NAMES        100 /* well above the index threshold of the object */
+#define NB_NAMES_NOIDX  40  /* above the threshold, capacity of 60 names at most */
+#define ALLOC_LIMIT     512 /* the index of 30 names or more, not the name arrays of 60 names */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static bool alloc_fail = false; /* refuse the big allocations */
+static bool present[NB_NAMES];
+static double number[NB_NAMES];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void * test_malloc(size_t size) {
+    if (alloc_fail && (size >= ALLOC_LIMIT)) {
+        return NULL;
+    }
+    return malloc(size);
+}
+
+static const char * name_of(int i) {
+    static char name[16];
+    snprintf(name, sizeof name, "name_%03d", i);
+    return name;
+}
+
+/* all the present names must be found with their number, the others not, counts the errors */
+static unsigned check_object(const JSON_Object * obj, int nb) {
+    int i;
+    size_t count = 0;
+    unsigned nb_err = 0;
+    JSON_Value * val;
+
+    for (i = 0; i < nb; i++) {
+        val = json_object_get_value(obj, name_of(i));
+        if (present[i]) {
+            count += 1;
+            if ((val == NULL) || (json_value_get_number(val) != number[i])) {
+                nb_err += 1;
+            }
+        } else if (val != NULL) {
+            nb_err += 1;
+        }
+    }
+    if (json_object_get_count(obj) != count) {
+        nb_err += 1;
+    }
+    if (json_object_get_value(obj, "missing") != NULL) {
+        nb_err += 1;
+    }
+
+    return nb_err;
+}
+
+/* add, set then remove nb names, checking the whole object after each step */
+static unsigned add_set_remove(int nb) {
+    int i, j;
+    unsigned nb_err = 0;
+    JSON_Value * root;
+    JSON_Object * obj;
+
+    root = json_value_init_object();
+    obj = json_value_get_object(root);
+    if (obj == NULL) {
+        return 1;
+    }
+    for (i = 0; i < nb; i++) {
+        present[i] = false;
+    }
+
+    /* add, crosses the threshold on the way up */
+    for (i = 0; i < nb; i++) {
+        number[i] = i;
+        if (json_object_set_number(obj, name_of(i), number[i]) != JSONSuccess) {
+            nb_err += 1;
+        }
+        present[i] = true;
+        nb_err += check_object(obj, nb);
+    }
+
+    /* set, replaces the value without adding a name */
+    for (i = 0; i < nb; i += 3) {
+        number[i] = 1000 + i;
+        if (json_object_set_number(obj, name_of(i), number[i]) != JSONSuccess) {
+            nb_err += 1;
+        }
+    }
+    nb_err += check_object(obj, nb);
+
+    /* remove the even then the odd names, crosses the threshold on the way down */
+    for (j = 0; j < 2; j++) {
+        for (i = j; i < nb; i += 2) {
+            if (json_object_remove(obj, name_of(i)) != JSONSuccess) {
+                nb_err += 1;
+            }
+            present[i] = false;
+            nb_err += check_object(obj, nb);
+            if (json_object_remove(obj, name_of(i)) != JSONFailure) {
+                nb_err += 1;
+            }
+        }
+    }
+
+    /* add again in an empty object which had an index */
+    for (i = 0; i < nb; i++) {
+        number[i] = -i;
+        if (json_object_set_number(obj, name_of(i), number[i]) != JSONSuccess) {
+            nb_err += 1;
+        }
+        present[i] = true;
+    }
+    nb_err += check_object(obj, nb);
+
+    json_value_free(root);
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void) {
+    unsigned nb_err_idx, nb_err_noidx;
+
+    json_set_allocation_functions(test_malloc, free);
+
+    printf("### parson object check ###\n");
+
+    nb_err_idx = add_set_remove(NB_NAMES);
+    printf("with the index: %u mismatches\n", nb_err_idx);
+
+    alloc_fail = true;
+    nb_err_noidx = add_set_remove(NB_NAMES_NOIDX);
+    alloc_fail = false;
+    printf("index allocation failed: %u mismatches\n", nb_err_noidx);
+
+    return ((nb_err_idx + nb_err_noidx) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,139 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : serialization of the accesses to the concentrator,
+    by a mutex or by a command thread owning it and serving the requests of
+    the other threads by priority.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_CONCENT_H
+#define _LORA_PKTFWD_CONCENT_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <pthread.h>
+#include <semaphore.h>
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+/* priority classes of the requests, the first one is served first */
+enum concent_prio_e {
+    CONCENT_PRIO_TX,        /* downlinks, and their TX status */
+    CONCENT_PRIO_RX,        /* fetch of the uplinks */
+    CONCENT_PRIO_HK,        /* housekeeping: counters, statistics, temperature, spectral scan */
+    CONCENT_PRIO_NB
+};
+
+/* type of a request, which sets its priority class */
+enum concent_cmd_e {
+    CONCENT_CMD_SEND,           /* TX batch */
+    CONCENT_CMD_SEND_PREPARE,   /* TX payload and settings loaded ahead */
+    CONCENT_CMD_TX_STATUS,      /* TX status of an RF chain */
+    CONCENT_CMD_RECEIVE,        /* RX packets fetch */
+    CONCENT_CMD_RECEIVE_WAIT,   /* RX buffer status */
+    CONCENT_CMD_RECOVER,        /* link recovery after a failed fetch */
+    CONCENT_CMD_COUNTER,        /* counters read, PPS or current */
+    CONCENT_CMD_STATS,          /* statistics of the HAL */
+    CONCENT_CMD_TEMPERATURE,    /* temperature sensor */
+    CONCENT_CMD_SPECTRAL_SCAN,  /* spectral scan control and results */
+    CONCENT_CMD_NB
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* a request, on the stack of the requesting thread until it is served */
+struct concent_req_s {
+    enum concent_cmd_e cmd;
+    int (*fn)(void * arg);      /* concentrator accesses of the request, run by the thread owning the concentrator */
+    void * arg;
+    int result;                 /* value returned by fn */
+    int64_t submit_ns;          /* time at which the request was queued */
+    sem_t done;                 /* posted once fn returned */
+    struct concent_req_s * next;
+};
+
+struct concent_stat_s {
+    uint32_t nb_req;            /* number of requests served */
+    uint64_t wait_us;           /* sum of the time spent waiting for the concentrator */
+    uint32_t wait_max_us;       /* longest wait */
+};
+
+struct concent_s {
+    bool actor;                 /* the requests are served by a command thread, else under the mutex */
+    bool stop;                  /* the command thread returns once the queue is empty */
+    pthread_mutex_t mx;         /* the concentrator itself, or the queue of the command thread */
+    pthread_cond_t cond;        /* signaled when a request is queued */
+    struct concent_req_s * head[CONCENT_PRIO_NB];
+    struct concent_req_s * tail[CONCENT_PRIO_NB];
+    struct concent_stat_s stat[CONCENT_PRIO_NB];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize the concentrator access, before the threads using it are started
+@param c the concentrator access to be initialized
+@param actor true if the requests are served by a command thread running concent_serve
+@return 0 if no error, -1 otherwise
+*/
+int concent_init(struct concent_s * c, bool actor);
+
+/**
+@brief Release the resources of the concentrator access, once all its threads are stopped
+@param c the concentrator access
+*/
+void concent_deinit(struct concent_s * c);
+
+/**
+@brief Run a request on the concentrator, exclusively of the other ones
+@param c the concentrator access
+@param cmd type of the request, giving its priority
+@param fn function doing the concentrator accesses
+@param arg argument of fn
+@return the value returned by fn
+
+Blocks until fn has returned. With the command thread, fn runs in that thread
+once the requests of a higher priority class queued meanwhile are served; the
+request which is running is always completed first. The thread calling
+concent_run can not be canceled while the request is queued.
+*/
+int concent_run(struct concent_s * c, enum concent_cmd_e cmd, int (*fn)(void * arg), void * arg);
+
+/**
+@brief Serve the requests, main function of the command thread
+@param c the concentrator access
+Only returns once concent_stop was called and all the queued requests are served.
+*/
+void concent_serve(struct concent_s * c);
+
+/**
+@brief Stop the command thread, once the threads submitting requests are stopped
+@param c the concentrator access
+*/
+void concent_stop(struct concent_s * c);
+
+/**
+@brief Get the statistics of the waits for the concentrator, per priority class
+@param c the concentrator access
+@param stat array of CONCENT_PRIO_NB statistics to be filled
+@param clear reset the statistics once read
+*/
+void concent_get_stats(struct concent_s * c, struct concent_stat_s * stat, bool clear);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
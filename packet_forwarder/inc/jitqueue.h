@@ -28,8 +28,11 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
-#define JIT_QUEUE_MAX           32  /* Maximum number of packets to be stored in JiT queue */
+#define JIT_QUEUE_SIZE_DEFAULT  32  /* Default number of packets which can be stored in a JiT queue */
+#define JIT_QUEUE_SIZE_MAX      1024 /* Maximum number of packets which can be stored in a JiT queue */
 #define JIT_NUM_BEACON_IN_QUEUE 3   /* Number of beacons to be loaded in JiT queue at any time */
+#define JIT_AIRTIME_BAND_NB_MAX 8   /* Maximum number of sub-bands with a duty cycle limit */
+#define JIT_AIRTIME_WINDOW_S    3600 /* Sliding window of the duty cycle, one bucket per second */
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC TYPES --------------------------------------------------------- */
@@ -52,7 +55,8 @@ enum jit_error_e {
     JIT_ERROR_TX_FREQ,      /* The required frequency for downlink is not supported */
     JIT_ERROR_TX_POWER,     /* The required power for downlink is not supported */
     JIT_ERROR_GPS_UNLOCKED, /* GPS timestamp could not be used as GPS is unlocked */
-    JIT_ERROR_INVALID       /* Packet is invalid */
+    JIT_ERROR_INVALID,      /* Packet is invalid */
+    JIT_ERROR_DUTY_CYCLE    /* The duty cycle of the sub-band would be exceeded */
 };
 
 struct jit_node_s {
@@ -63,12 +67,31 @@ struct jit_node_s {
     /* Internal fields */
     uint32_t pre_delay;             /* Amount of time before packet timestamp to be reserved */
     uint32_t post_delay;            /* Amount of time after packet timestamp to be reserved (time on air) */
+    int8_t airtime_band;            /* Sub-band whose airtime is reserved by the packet, -1 if none */
+    uint32_t airtime_us;            /* Airtime reserved by the packet in its sub-band */
+};
+
+struct jit_airtime_band_s {
+    uint32_t freq_min;              /* Lowest frequency of the sub-band, in Hz */
+    uint32_t freq_max;              /* Highest frequency of the sub-band, in Hz */
+    float duty_cycle;               /* Ratio of the window the sub-band can be used, ]0..1] */
+};
+
+struct jit_airtime_stat_s {
+    float usage;                    /* Ratio of the window used by the packets sent */
+    float reserved;                 /* Ratio of the window reserved by the packets queued, not sent yet */
+    uint32_t nb_rejected;           /* Downlinks rejected with JIT_ERROR_DUTY_CYCLE */
 };
 
 struct jit_queue_s {
-    uint8_t num_pkt;                /* Total number of packets in the queue (downlinks, beacons...) */
+    uint16_t size;                  /* Maximum number of packets in the queue */
+    uint16_t num_pkt;               /* Total number of packets in the queue (downlinks, beacons...) */
+    uint16_t max_num_pkt;           /* Highest number of packets in the queue, since init */
     uint8_t num_beacon;             /* Number of beacons in the queue */
-    struct jit_node_s nodes[JIT_QUEUE_MAX]; /* Nodes/packets array in the queue */
+    uint32_t max_post_delay;        /* Longest post delay of the packets in the queue, bounds the collision search */
+    struct jit_node_s *nodes;       /* Nodes/packets pool of the queue, a node index is stable while the packet is queued */
+    uint16_t *order;                /* Indexes of the used nodes, in ascending order of packet timestamp */
+    uint16_t *free_nodes;           /* Indexes of the unused nodes (stack) */
 };
 
 /* -------------------------------------------------------------------------- */
@@ -90,35 +113,98 @@ bool jit_queue_is_full(struct jit_queue_s *queue);
 */
 bool jit_queue_is_empty(struct jit_queue_s *queue);
 
+/**
+@brief Get the occupancy of a JiT queue.
+
+@param queue[in] Just in Time queue to be checked.
+@param num_pkt[out] Number of packets in the queue.
+@param max_num_pkt[out] Highest number of packets in the queue, since init.
+*/
+void jit_queue_get_occupancy(struct jit_queue_s *queue, uint16_t *num_pkt, uint16_t *max_num_pkt);
+
 /**
 @brief Initialize a Just in Time queue.
 
-@param queue[in] Just in Time queue to be initialized. Memory should have been allocated already.
+@param queue[in] Just in Time queue to be initialized.
+@param size[in] Maximum number of packets in the queue [1..JIT_QUEUE_SIZE_MAX].
+@return JIT_ERROR_OK if the queue was allocated, JIT_ERROR_INVALID otherwise.
+
+This function is used to allocate the queue nodes, and reset every elements in the queue.
+*/
+enum jit_error_e jit_queue_init(struct jit_queue_s *queue, uint16_t size);
+
+/**
+@brief Set the sub-bands whose airtime is accounted by the Just-in-Time queues.
+
+@param band[in] Sub-bands, which should not overlap
+@param nb_band[in] Number of sub-bands [0..JIT_AIRTIME_BAND_NB_MAX], 0 to disable the accounting
+@return JIT_ERROR_OK if the sub-bands are valid, JIT_ERROR_INVALID otherwise.
+
+The airtime of the packets sent, in all the queues, is summed per second of their emission,
+over the last JIT_AIRTIME_WINDOW_S seconds. The packets queued reserve their airtime until they
+are removed from their queue. A downlink which would exceed the duty cycle of its sub-band, with
+the airtime sent and reserved, is rejected by jit_enqueue, a beacon is always accepted but reserved.
+*/
+enum jit_error_e jit_airtime_init(const struct jit_airtime_band_s *band, int nb_band);
+
+/**
+@brief Charge the airtime of a packet sent to its sub-band, at the current second.
+
+@param packet[in] Packet dequeued and sent successfully
+
+This function is typically called once lgw_send has accepted a dequeued packet, the packets
+dropped, flushed or failing to be sent are never charged.
+*/
+void jit_airtime_charge(const struct lgw_pkt_tx_s *packet);
+
+/**
+@brief Get the airtime usage of the sub-bands.
 
-This function is used to reset every elements in the allocated queue.
+@param stats[out] Usage of each sub-band set by jit_airtime_init
+@param nb_band[in] Number of elements of stats
+@return Number of sub-bands reported.
 */
-void jit_queue_init(struct jit_queue_s *queue);
+int jit_airtime_get_stats(struct jit_airtime_stat_s *stats, int nb_band);
 
 /**
 @brief Add a packet in a Just-in-Time queue
 
 @param queue[in/out] Just in Time queue in which the packet should be inserted
-@param time_us[in] Current concentrator time
+@param time_us[in] Current concentrator time, extended to 64 bits
 @param packet[in] Packet to be queued in JiT queue
 @param pkt_type[in] Type of packet to be queued: Downlink, Beacon
 @return success if the function was able to queue the packet
 
+The packet is scheduled on its count_us64 timestamp if set, else on the next occurrence of its
+32-bit count_us after time_us. Both are set on the packet queued, so that the queue never has to
+handle the counter roll-over.
+
 This function is typically used when a packet is received from server for downlink.
 It will check if packet can be queued, with several criterias. Once the packet is queued, it has to be
 sent over the air. So all checks should happen before the packet being actually in the queue.
 */
-enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type);
+enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint64_t time_us, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type);
+
+/**
+@brief Check if a packet can be queued in a Just-in-Time queue, from its timestamp only
+
+@param queue[in] Just in Time queue in which the packet would be inserted
+@param time_us[in] Current concentrator time, extended to 64 bits
+@param count_us[in] 32-bit timestamp of the packet, taken after time_us, ignored for Class C downlinks
+@param pkt_type[in] Type of packet to be queued: Downlink, Beacon
+@return JIT_ERROR_OK if the packet may be queued, or the error jit_enqueue would return
+
+This function is typically used to reject a downlink before its payload is decoded and its
+time on air computed. A collision found is certain, as the packet takes at least no time on
+air, but a packet admitted can still be rejected by jit_enqueue.
+*/
+enum jit_error_e jit_admit(struct jit_queue_s *queue, uint64_t time_us, uint32_t count_us, enum jit_pkt_type_e pkt_type);
 
 /**
 @brief Dequeue a packet from a Just-in-Time queue
 
 @param queue[in/out] Just in Time queue from which the packet should be removed
-@param index[in] in the queue where to get the packet to be removed
+@param index[in] node index in the queue where to get the packet to be removed
 @param packet[out] that was at index
 @param pkt_type[out] Type of packet dequeued: Downlink, Beacon
 @return success if the function was able to dequeue the packet
@@ -132,15 +218,52 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 @brief Check if there is a packet soon to be sent from the JiT queue.
 
 @param queue[in] Just in Time queue to parse for peeking a packet
-@param time_us[in] Current concentrator time
+@param time_us[in] Current concentrator time, extended to 64 bits
 @param pkt_idx[out] Packet index which is soon to be dequeued.
 @return success if the function was able to parse the queue. pkt_idx is set to -1 if no packet found.
 
 This function is typically used to check in JiT queue if there is a packet soon to be sent.
-It search the packet with the highest priority in queue, and check if its timestamp is near
-enough the current concentrator time.
+It takes the packet with the highest priority (earliest timestamp) in queue, and check if its timestamp is near
+enough the current concentrator time. Packets which have been missed are dropped.
+*/
+enum jit_error_e jit_peek(struct jit_queue_s *queue, uint64_t time_us, int *pkt_idx);
+
+/**
+@brief Get the time left before the next packet of the JiT queue can be peeked.
+
+@param queue[in] Just in Time queue to be checked
+@param time_us[in] Current concentrator time, extended to 64 bits
+@param delay_us[out] Time from time_us to the moment jit_peek will return the first packet, 0 if already due
+@return JIT_ERROR_OK if a packet is queued, JIT_ERROR_EMPTY otherwise.
+
+This function is typically used by the JiT thread to sleep until the queue needs to be served.
+*/
+enum jit_error_e jit_peek_delay(struct jit_queue_s *queue, uint64_t time_us, uint32_t *delay_us);
+
+/**
+@brief Get a copy of the first packet of the JiT queue, without removing it.
+
+@param queue[in] Just in Time queue to be checked
+@param packet[out] Copy of the packet with the earliest timestamp
+@param pkt_type[out] Type of the packet: Downlink, Beacon
+@return JIT_ERROR_OK if a packet is queued, JIT_ERROR_EMPTY otherwise.
+
+This function is typically used to upload the next packet to the concentrator before it is due.
+*/
+enum jit_error_e jit_get_head(struct jit_queue_s *queue, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e *pkt_type);
+
+/**
+@brief Remove all the packets of a JiT queue.
+
+@param queue[in/out] Just in Time queue to be emptied
+@param fn[in] Function called with each packet removed, in timestamp order, NULL to only discard them
+@param arg[in] Argument given to fn
+@return Number of packets removed
+
+This function is typically used when the concentrator counter was reset, making the queued timestamps meaningless.
+The queue is locked while fn is called, fn must not access the JiT queues.
 */
-enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_idx);
+int jit_flush(struct jit_queue_s *queue, void (*fn)(const struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type, void *arg), void *arg);
 
 /**
 @brief Debug function to print the queue's content on console
@@ -0,0 +1,118 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : persistent journal of the upstream datagrams.
+    Fixed-size ring of datagrams in a memory-mapped file, the datagrams which
+    are not acknowledged by the server are kept to be sent again later.
+    Only accessed by the upstream thread.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_JOURNAL_H
+#define _LORA_PKTFWD_JOURNAL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define JOURNAL_SIZE_MIN        65536   /* bytes, smallest ring accepted */
+#define JOURNAL_SIZE_DEFAULT    1048576 /* bytes */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct journal_hdr_s;
+
+struct journal_s {
+    int fd;                         /* journal file */
+    uint8_t * map;                  /* mapping of the whole file */
+    struct journal_hdr_s * hdr;     /* persistent state, at the start of the file */
+    uint8_t * ring;                 /* records, after the header */
+    uint32_t replay;                /* offset of the next record to be checked for replay */
+    uint32_t dropped;               /* number of datagrams overwritten before being acknowledged */
+};
+
+/* reference of a record, given when appended, to report its acknowledge */
+struct journal_ref_s {
+    uint32_t offset;
+    uint32_t seq;                   /* sequence number of the record, 0 for none */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Open the journal file, or create it, and map it in memory
+The records of a previous run which were not acknowledged are marked to be sent again.
+A file which is not a valid journal of the requested size is reset.
+@param jrn the journal to be opened
+@param path path of the journal file
+@param size size of the ring of records, in bytes
+@return 0 if no error, -1 otherwise
+*/
+int journal_open(struct journal_s * jrn, const char * path, uint32_t size);
+
+/**
+@brief Unmap and close the journal file
+@param jrn the journal to be closed
+*/
+void journal_close(struct journal_s * jrn);
+
+/**
+@brief Write a datagram at the end of the journal, waiting for its acknowledge, never blocks
+The oldest records are overwritten when the ring is full, even if they were not acknowledged.
+@param jrn the journal in which the datagram is written
+@param dgram the datagram which has been sent
+@param size size of the datagram, in bytes
+@param ref the reference of the record, to be given to journal_ack or journal_lost
+@return 0 if no error, -1 if the datagram is too large for the ring
+*/
+int journal_append(struct journal_s * jrn, const uint8_t * dgram, uint32_t size, struct journal_ref_s * ref);
+
+/**
+@brief Release a record, the datagram having been acknowledged by the server
+Nothing is done if the record has already been overwritten.
+@param jrn the journal holding the record
+@param ref the reference of the record
+*/
+void journal_ack(struct journal_s * jrn, struct journal_ref_s ref);
+
+/**
+@brief Mark a record to be sent again, the datagram having not been acknowledged in time
+Nothing is done if the record has already been overwritten.
+@param jrn the journal holding the record
+@param ref the reference of the record
+*/
+void journal_lost(struct journal_s * jrn, struct journal_ref_s ref);
+
+/**
+@brief Get the oldest datagram to be sent again, it is then waiting for its acknowledge
+@param jrn the journal holding the records
+@param size pointer to return the size of the datagram
+@param ref pointer to return the reference of the record
+@return pointer to the datagram, within the mapping and valid until the next append, or NULL if there is none
+*/
+uint8_t * journal_replay_next(struct journal_s * jrn, uint32_t * size, struct journal_ref_s * ref);
+
+/**
+@brief Get the number of datagrams waiting to be sent again
+@param jrn the journal holding the records
+@return the number of records marked as lost
+*/
+uint32_t journal_backlog(struct journal_s * jrn);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,120 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : metrics endpoint, serving the counters of the packet
+    forwarder and of the HAL as OpenMetrics text.
+    The snapshot is formatted by the statistics thread in a buffer reused from
+    one snapshot to the next, and swapped with the published one. A scrape
+    only copies the published snapshot and writes it to the client, from the
+    endpoint thread, without touching the counters.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_METRICS_H
+#define _LORA_PKTFWD_METRICS_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+#include <pthread.h>
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define METRICS_BUF_SIZE_INIT   16384   /* bytes, grown on the first snapshots if needed and then kept */
+#define METRICS_PATH_SIZE       108     /* size of sun_path */
+#define METRICS_CONTENT_TYPE    "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct metrics_buf_s {
+    char * data;
+    size_t len;                     /* bytes written, data is NUL terminated */
+    size_t size;                    /* bytes allocated */
+};
+
+struct metrics_s {
+    int fd;                         /* listening socket */
+    bool http;                      /* HTTP listener, or Unix socket written on connection */
+    char path[METRICS_PATH_SIZE];   /* path of the Unix socket, removed on stop */
+    pthread_t thrid;
+    bool run;
+    pthread_mutex_t mx;             /* protects front */
+    struct metrics_buf_s snap[2];   /* snap[front] is published, the other one is built by the statistics thread */
+    int front;
+    struct metrics_buf_s out;       /* copy of the published snapshot being sent, owned by the endpoint thread */
+    uint32_t nb_scrape;             /* number of snapshots sent */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Open the endpoint, and start the thread serving the snapshots
+@param metrics the endpoint to be started
+@param endpoint "unix:<path>" for a Unix socket, or "[<host>:]<port>" for an HTTP listener, on all the interfaces if no host is given
+@return 0 if no error, -1 otherwise
+*/
+int metrics_start(struct metrics_s * metrics, const char * endpoint);
+
+/**
+@brief Stop the thread, close the endpoint and free the buffers
+@param metrics the endpoint to be stopped
+*/
+void metrics_stop(struct metrics_s * metrics);
+
+/**
+@brief Get the buffer of the next snapshot, emptied, to be filled and then published
+@param metrics the endpoint
+@return the buffer, only used by the calling thread until metrics_publish is called
+*/
+struct metrics_buf_s * metrics_begin(struct metrics_s * metrics);
+
+/**
+@brief Publish the snapshot filled since metrics_begin, the "# EOF" line is added
+@param metrics the endpoint
+*/
+void metrics_publish(struct metrics_s * metrics);
+
+/**
+@brief Append formatted text to a snapshot, the buffer being grown if needed
+@param buf the snapshot
+@param format printf format
+*/
+void metrics_printf(struct metrics_buf_s * buf, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+@brief Append the metadata of a metric family
+@param buf the snapshot
+@param name name of the family, without the _total suffix of the counters
+@param type "counter", "gauge" or "histogram"
+@param help description of the family
+*/
+void metrics_family(struct metrics_buf_s * buf, const char * name, const char * type, const char * help);
+
+/**
+@brief Append a histogram of log2 bins, as cumulative buckets
+@param buf the snapshot
+@param name name of the family
+@param labels labels of the histogram, as 'a="x",b="y"', or "" for none
+@param hist number of values in each bin: bin 0 is < unit, bin i is [2^(i-1), 2^i[ x unit, the last bin also counts the larger values
+@param nb number of bins
+@param unit upper bound of bin 0, in the unit of the family
+@param sum sum of the values, in the unit of the family, negative if unknown
+*/
+void metrics_hist(struct metrics_buf_s * buf, const char * name, const char * labels, const uint64_t * hist, int nb, double unit, double sum);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,86 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : pool of RX packet descriptors, filled by the HAL in the
+    fetch thread and handed over by reference to the upstream thread.
+    The last descriptor released is the first one reused, to stay in cache.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_PKTPOOL_H
+#define _LORA_PKTFWD_PKTPOOL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <pthread.h>
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define PKT_POOL_SIZE           512 /* Number of RX packet descriptors, for the fetch thread, the uplink queue and the upstream thread */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct pkt_pool_s {
+    pthread_mutex_t mx;             /* protects the free stack, taken once per batch */
+    int nb_free;                    /* number of descriptors in the free stack */
+    int min_free;                   /* lowest number of free descriptors since init */
+    struct lgw_pkt_rx_s * free_pkt[PKT_POOL_SIZE]; /* stack of the free descriptors */
+    struct lgw_pkt_rx_s pkt[PKT_POOL_SIZE]; /* storage of the descriptors */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize the pool, all the descriptors are free
+@param pool the pool to be initialized
+@return 0 if no error, -1 otherwise
+*/
+int pkt_pool_init(struct pkt_pool_s * pool);
+
+/**
+@brief Release resources of the pool, once no thread uses it anymore
+@param pool the pool to be released
+*/
+void pkt_pool_deinit(struct pkt_pool_s * pool);
+
+/**
+@brief Take free descriptors from the pool, never blocks
+@param pool the pool from which the descriptors are taken
+@param pkt array receiving the references to the descriptors
+@param nb_pkt number of descriptors wanted
+@return the number of descriptors actually taken, fewer if the pool runs out
+*/
+int pkt_pool_get(struct pkt_pool_s * pool, struct lgw_pkt_rx_s ** pkt, int nb_pkt);
+
+/**
+@brief Give descriptors back to the pool
+@param pool the pool the descriptors were taken from
+@param pkt array of references to the descriptors
+@param nb_pkt number of descriptors in the array
+*/
+void pkt_pool_put(struct pkt_pool_s * pool, struct lgw_pkt_rx_s * const * pkt, int nb_pkt);
+
+/**
+@brief Get the highest number of descriptors used at the same time
+@param pool the pool to be checked
+@return the number of descriptors, since init
+*/
+int pkt_pool_max_used(struct pkt_pool_s * pool);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
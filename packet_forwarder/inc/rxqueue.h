@@ -0,0 +1,110 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : uplink queue between the packet fetch thread and the
+    uplink serialization thread.
+    Single producer, single consumer, lock-free ring buffer of references to
+    RX packets, the descriptors themselves come from the packet pool.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_RXQ_H
+#define _LORA_PKTFWD_RXQ_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RX_QUEUE_SIZE           512 /* Maximum number of packets stored in the uplink queue, must be a power of 2 */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct rx_queue_s {
+    uint32_t head;                  /* next slot to be written, only modified by the producer */
+    uint32_t tail;                  /* next slot to be read, only modified by the consumer */
+    uint32_t dropped;               /* number of packets dropped because the queue was full */
+    uint32_t max_used;              /* highest number of packets in the queue, only modified by the producer */
+    int ready_fd;                   /* eventfd signaled by the producer when new packets are available */
+    struct lgw_pkt_rx_s * pkt[RX_QUEUE_SIZE];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize the uplink queue, must be called before producer and consumer threads are started
+@param queue the queue to be initialized
+@return 0 if no error, -1 otherwise
+*/
+int rx_queue_init(struct rx_queue_s * queue);
+
+/**
+@brief Release resources of the uplink queue, once producer and consumer threads are stopped
+@param queue the queue to be released
+*/
+void rx_queue_deinit(struct rx_queue_s * queue);
+
+/**
+@brief Hand over packets at the end of the queue (producer side), never blocks
+@param queue the queue in which packets are pushed
+@param pkt array of references to the packets to be pushed
+@param nb_pkt number of packets in the array
+@return the number of packets actually queued, the first ones of the array, the remaining ones are dropped and left to the producer
+*/
+int rx_queue_push(struct rx_queue_s * queue, struct lgw_pkt_rx_s * const * pkt, int nb_pkt);
+
+/**
+@brief Take packets from the head of the queue (consumer side), never blocks
+@param queue the queue from which packets are popped
+@param pkt array receiving the references to the packets, now owned by the consumer
+@param max_pkt maximum number of packets to be taken
+@return the number of packets taken
+*/
+int rx_queue_pop(struct rx_queue_s * queue, struct lgw_pkt_rx_s ** pkt, int max_pkt);
+
+/**
+@brief Get the file descriptor which becomes readable when the producer pushes packets (consumer side)
+To be waited on with poll or epoll, after rx_queue_pop returned no packet.
+@param queue the queue to wait on
+@return the file descriptor
+*/
+int rx_queue_fd(struct rx_queue_s * queue);
+
+/**
+@brief Reset the readability of the queue file descriptor, once woken up (consumer side)
+@param queue the queue which was waited on
+*/
+void rx_queue_clear(struct rx_queue_s * queue);
+
+/**
+@brief Get the number of packets dropped because the queue was full
+@param queue the queue to be checked
+@return the number of packets dropped since init
+*/
+uint32_t rx_queue_dropped(struct rx_queue_s * queue);
+
+/**
+@brief Get the highest number of packets waiting in the queue
+@param queue the queue
+@return the number of packets, since init
+*/
+uint32_t rx_queue_max_used(struct rx_queue_s * queue);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
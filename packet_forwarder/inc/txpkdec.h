@@ -0,0 +1,102 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : decoder of the "txpk" object of the PULL_RESP
+    datagrams, straight from the JSON text into the TX packet structure.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_TXPKDEC_H
+#define _LORA_PKTFWD_TXPKDEC_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+enum txpk_key_e {
+    TXPK_IMME, TXPK_TMST, TXPK_TMMS, TXPK_FREQ, TXPK_RFCH, TXPK_POWE, TXPK_MODU, TXPK_DATR,
+    TXPK_CODR, TXPK_FDEV, TXPK_IPOL, TXPK_PREA, TXPK_SIZE, TXPK_DATA, TXPK_NCRC, TXPK_NHDR,
+    TXPK_KEY_NB
+};
+
+#define TXPK_FOUND(key)         (1U << (key))   /* bit of a key in the txpk_dec_s.found bitmap */
+
+enum txpk_dec_e {
+    TXPK_DEC_OK,
+    TXPK_DEC_ERR_JSON,      /* JSON syntax error */
+    TXPK_DEC_ERR_NO_TXPK,   /* no "txpk" object */
+    TXPK_DEC_ERR_TYPE,      /* value of the wrong type for a key, the key is in txpk_dec_s.key */
+    TXPK_DEC_ERR_MODU,      /* unknown modulation */
+    TXPK_DEC_ERR_DATR,      /* format error in the LoRa datarate */
+    TXPK_DEC_ERR_SF,        /* invalid spreading factor */
+    TXPK_DEC_ERR_BW,        /* invalid bandwidth */
+    TXPK_DEC_ERR_CODR       /* format error in the coding rate */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct txpk_dec_s {
+    uint32_t found;         /* keys of the txpk object found, bitmap of TXPK_FOUND() */
+    bool imme;              /* "imme" is true */
+    uint64_t tmms;          /* GPS time of the TX, in ms */
+    const char * data;      /* base64 payload, unescaped in the JSON text */
+    int data_len;           /* number of characters of the base64 payload */
+    enum txpk_key_e key;    /* key of a TXPK_DEC_ERR_TYPE error */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Decode the txpk object of a PULL_RESP JSON payload, in a single pass
+@param json NUL terminated JSON text, its strings are unescaped in place
+@param pkt TX packet receiving the values of the keys found
+@param dec receives the keys found and the values with no field in pkt
+@return TXPK_DEC_OK, or the first error met
+
+Only the values given are set in pkt, the rest is cleared: the defaults and
+the checks of the mandatory keys are left to the caller. "powe" is the RF
+power requested, the antenna gain is not removed. "prea" is stored as is,
+saturated to 0 if negative. Unknown keys are skipped, and comments are
+allowed as by json_parse_string_with_comments. As for parson, a duplicate name
+in any object is a syntax error, a string ends at its first \u0000, a \u escape
+of a surrogate must be a pair, and the text after the root value is ignored.
+The numbers must follow the JSON grammar, which is stricter than parson: it
+accepts "-inf", "1." or an overflow to infinity. The payload is only located,
+so that a packet rejected from its metadata is not decoded further.
+*/
+enum txpk_dec_e txpk_decode(char * json, struct lgw_pkt_tx_s * pkt, struct txpk_dec_s * dec);
+
+/**
+@brief Decode the base64 payload located by txpk_decode
+@param dec the txpk decoded, its JSON text must still be valid
+@param pkt TX packet receiving the payload
+@return size of the payload, -1 if it is not valid base64 or too long
+*/
+int txpk_decode_payload(const struct txpk_dec_s * dec, struct lgw_pkt_tx_s * pkt);
+
+/**
+@brief Name of a txpk key, for the error messages
+@param key the key
+@return its name in the JSON object
+*/
+const char * txpk_key_name(enum txpk_key_e key);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,76 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : de-duplication of the uplinks received several times,
+    by several demodulators or boards, before serialization.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_UPDEDUP_H
+#define _LORA_PKTFWD_UPDEDUP_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define UP_DEDUP_SLOT_NB        1024    /* Number of packets remembered, must be a power of 2 */
+#define UP_DEDUP_PROBE_NB       8       /* Slots checked for a payload, a copy is missed if they are all recent */
+
+#define UP_DEDUP_UNIQUE         -1      /* Packet to be forwarded */
+#define UP_DEDUP_FORWARDED      -2      /* Copy of a packet forwarded in a previous batch */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct up_dedup_slot_s {
+    uint64_t hash;          /* hash of the payload */
+    int64_t fetch_ns;       /* host time at which the packet was fetched, 0 if the slot is free */
+    uint32_t batch;         /* batch in which the packet was received */
+    int16_t idx;            /* index of the copy kept, in its batch */
+};
+
+struct up_dedup_s {
+    int64_t window_ns;      /* copies fetched less than that after the first one are dropped */
+    uint32_t batch;         /* number of batches checked */
+    struct up_dedup_slot_s slot[UP_DEDUP_SLOT_NB];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize the de-duplication, no packet seen
+@param dedup the de-duplication context to be initialized
+@param window_ms time window in which copies of a packet are dropped
+*/
+void up_dedup_init(struct up_dedup_s * dedup, uint32_t window_ms);
+
+/**
+@brief Find the copies of the packets of a batch, keeping the best-RSSI one
+@param dedup the de-duplication context
+@param pkt array of references to the packets of the batch
+@param nb_pkt number of packets in the batch
+@param dup_of array receiving, for each packet, UP_DEDUP_UNIQUE, UP_DEDUP_FORWARDED or the index of the copy kept in the batch
+@return number of copies found
+
+Only the packets with a valid CRC are checked, the other ones are UP_DEDUP_UNIQUE.
+*/
+int up_dedup_batch(struct up_dedup_s * dedup, struct lgw_pkt_rx_s * const * pkt, int nb_pkt, int16_t * dup_of);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
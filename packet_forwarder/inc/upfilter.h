@@ -0,0 +1,106 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : filter of the uplinks on their DevAddr, NetID and
+    JoinEUI, to drop the packets of the foreign networks before serialization.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_UPFILTER_H
+#define _LORA_PKTFWD_UPFILTER_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define UP_FILTER_BLOCK_BITS    16  /* DevAddr prefixes up to that length are resolved by a bitmap of the blocks */
+#define UP_FILTER_LONG_NB_MAX   64  /* Maximum number of DevAddr prefixes longer than UP_FILTER_BLOCK_BITS */
+#define UP_FILTER_JOIN_NB_MAX   256 /* Maximum number of JoinEUIs allowed */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+enum up_filter_e {
+    UP_FILTER_PASS,         /* Packet to be forwarded */
+    UP_FILTER_DROP_DEVADDR, /* Data uplink whose DevAddr matches no allowed prefix */
+    UP_FILTER_DROP_JOIN_EUI /* Join request whose JoinEUI is not allowed */
+};
+
+struct up_filter_rule_s {
+    uint32_t prefix;        /* DevAddr prefix, left aligned, lower bits cleared */
+    uint8_t len;            /* number of significant bits of the prefix */
+};
+
+struct up_filter_s {
+    bool devaddr_enabled;   /* data uplinks are filtered, at least one prefix allowed */
+    bool join_enabled;      /* join requests are filtered, at least one JoinEUI allowed */
+    uint32_t block_all[(1 << UP_FILTER_BLOCK_BITS) / 32];   /* blocks fully allowed */
+    uint32_t block_long[(1 << UP_FILTER_BLOCK_BITS) / 32];  /* blocks holding a longer prefix */
+    int nb_long;
+    struct up_filter_rule_s long_rule[UP_FILTER_LONG_NB_MAX];
+    int nb_join;
+    uint64_t join_eui[2 * UP_FILTER_JOIN_NB_MAX];           /* open addressing hash set, at most half full */
+    uint8_t join_used[2 * UP_FILTER_JOIN_NB_MAX];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Initialize the filter, every packet passes until a rule is added
+@param filter the filter to be initialized
+*/
+void up_filter_init(struct up_filter_s * filter);
+
+/**
+@brief Allow the data uplinks of a DevAddr prefix
+@param filter the filter to be updated
+@param prefix DevAddr prefix, its bits beyond len are ignored
+@param len number of significant bits, from 0 (all DevAddr) to 32
+@return 0 if no error, -1 if the length is invalid or too many long prefixes
+*/
+int up_filter_add_devaddr(struct up_filter_s * filter, uint32_t prefix, int len);
+
+/**
+@brief Allow the data uplinks of a network, from the DevAddr prefix of its NetID
+@param filter the filter to be updated
+@param netid 24-bit NetID, its type in the 3 MSBits
+@return 0 if no error, -1 otherwise
+*/
+int up_filter_add_netid(struct up_filter_s * filter, uint32_t netid);
+
+/**
+@brief Allow the join requests to a JoinEUI
+@param filter the filter to be updated
+@param join_eui JoinEUI, as a 64-bit number
+@return 0 if no error, -1 if too many JoinEUIs
+*/
+int up_filter_add_join_eui(struct up_filter_s * filter, uint64_t join_eui);
+
+/**
+@brief Check if a packet is to be forwarded, from its LoRaWAN header
+@param filter the filter to be checked
+@param payload PHYPayload of the packet
+@param size size of the payload
+@return UP_FILTER_PASS, or the reason to drop the packet
+
+Only the data uplinks and the join requests are filtered, the other message
+types and the packets too short for their header always pass.
+*/
+enum up_filter_e up_filter_check(const struct up_filter_s * filter, const uint8_t * payload, uint16_t size);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,193 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : serialization of the accesses to the concentrator,
+    by a mutex or by a command thread owning it and serving the requests of
+    the other threads by priority.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <string.h>     /* memset */
+#include <errno.h>      /* EINTR */
+#include <time.h>       /* clock_gettime */
+
+#include "concent.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const enum concent_prio_e cmd_prio[CONCENT_CMD_NB] = {
+    [CONCENT_CMD_SEND]          = CONCENT_PRIO_TX,
+    [CONCENT_CMD_SEND_PREPARE]  = CONCENT_PRIO_TX,
+    [CONCENT_CMD_TX_STATUS]     = CONCENT_PRIO_TX,
+    [CONCENT_CMD_RECEIVE]       = CONCENT_PRIO_RX,
+    [CONCENT_CMD_RECEIVE_WAIT]  = CONCENT_PRIO_RX,
+    [CONCENT_CMD_RECOVER]       = CONCENT_PRIO_RX,
+    [CONCENT_CMD_COUNTER]       = CONCENT_PRIO_HK,
+    [CONCENT_CMD_STATS]         = CONCENT_PRIO_HK,
+    [CONCENT_CMD_TEMPERATURE]   = CONCENT_PRIO_HK,
+    [CONCENT_CMD_SPECTRAL_SCAN] = CONCENT_PRIO_HK
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int64_t time_ns(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((int64_t)t.tv_sec * 1000000000) + t.tv_nsec;
+}
+
+static void stat_add(struct concent_stat_s * stat, int64_t wait_ns) {
+    uint32_t wait_us = (uint32_t)(wait_ns / 1000);
+
+    stat->nb_req += 1;
+    stat->wait_us += wait_us;
+    if (wait_us > stat->wait_max_us) {
+        stat->wait_max_us = wait_us;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int concent_init(struct concent_s * c, bool actor) {
+    memset(c, 0, sizeof *c);
+    c->actor = actor;
+    if (pthread_mutex_init(&c->mx, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_cond_init(&c->cond, NULL) != 0) {
+        pthread_mutex_destroy(&c->mx);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void concent_deinit(struct concent_s * c) {
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int concent_run(struct concent_s * c, enum concent_cmd_e cmd, int (*fn)(void * arg), void * arg) {
+    struct concent_req_s req;
+    enum concent_prio_e prio = cmd_prio[cmd];
+    int64_t submit_ns = time_ns();
+    int cancel_state;
+    int result;
+
+    if (c->actor == false) {
+        pthread_mutex_lock(&c->mx);
+        stat_add(&c->stat[prio], time_ns() - submit_ns);
+        result = fn(arg);
+        pthread_mutex_unlock(&c->mx);
+        return result;
+    }
+
+    /* the request lives on this stack until it is served, it must not be left behind by a cancellation */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    req.cmd = cmd;
+    req.fn = fn;
+    req.arg = arg;
+    req.submit_ns = submit_ns;
+    req.next = NULL;
+    sem_init(&req.done, 0, 0);
+
+    pthread_mutex_lock(&c->mx);
+    if (c->tail[prio] == NULL) {
+        c->head[prio] = &req;
+    } else {
+        c->tail[prio]->next = &req;
+    }
+    c->tail[prio] = &req;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->mx);
+
+    while ((sem_wait(&req.done) != 0) && (errno == EINTR));
+    sem_destroy(&req.done);
+    pthread_setcancelstate(cancel_state, NULL);
+
+    return req.result;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void concent_serve(struct concent_s * c) {
+    struct concent_req_s * req;
+    int i;
+
+    pthread_mutex_lock(&c->mx);
+    while (true) {
+        /* oldest request of the highest priority class */
+        req = NULL;
+        for (i = 0; (i < CONCENT_PRIO_NB) && (req == NULL); i++) {
+            req = c->head[i];
+            if (req != NULL) {
+                c->head[i] = req->next;
+                if (c->head[i] == NULL) {
+                    c->tail[i] = NULL;
+                }
+                stat_add(&c->stat[i], time_ns() - req->submit_ns);
+            }
+        }
+        if (req == NULL) {
+            if (c->stop == true) {
+                break;
+            }
+            pthread_cond_wait(&c->cond, &c->mx);
+            continue;
+        }
+
+        /* the queue stays open while the concentrator is accessed, the request is released as soon as it is done */
+        pthread_mutex_unlock(&c->mx);
+        req->result = req->fn(req->arg);
+        sem_post(&req->done);
+        pthread_mutex_lock(&c->mx);
+    }
+    pthread_mutex_unlock(&c->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void concent_stop(struct concent_s * c) {
+    pthread_mutex_lock(&c->mx);
+    c->stop = true;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void concent_get_stats(struct concent_s * c, struct concent_stat_s * stat, bool clear) {
+    pthread_mutex_lock(&c->mx);
+    memcpy(stat, c->stat, sizeof c->stat);
+    if (clear == true) {
+        memset(c->stat, 0, sizeof c->stat);
+    }
+    pthread_mutex_unlock(&c->mx);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
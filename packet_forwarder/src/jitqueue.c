@@ -15,12 +15,21 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
-#include <stdlib.h>     /* qsort */
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdlib.h>     /* calloc, free */
 #include <stdio.h>      /* printf, fprintf, snprintf, fopen, fputs */
 #include <string.h>     /* memset, memcpy */
 #include <pthread.h>
 #include <assert.h>
+#include <time.h>       /* clock_gettime */
 #include <math.h>
+#include <inttypes.h>   /* PRIu64 */
 
 #include "trace.h"
 #include "jitqueue.h"
@@ -39,13 +48,153 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
                                             to ensure beacon can be sent */
 #define BEACON_RESERVED         2120000 /* Time on air of the beacon, with some margin */
 
+#define JIT_PRE_DELAY_MAX       (TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY) /* Longest pre delay of a queued packet (beacon) */
+
+/* Airtime of the packets sent, per sub-band: ring of per-second sums and their running total,
+   and airtime reserved by the packets still queued */
+struct jit_airtime_s {
+    int nb_band;
+    struct jit_airtime_band_s conf[JIT_AIRTIME_BAND_NB_MAX];
+    uint64_t limit_us[JIT_AIRTIME_BAND_NB_MAX];     /* airtime allowed in the window */
+    uint64_t sum_us[JIT_AIRTIME_BAND_NB_MAX];       /* airtime of the buckets of the window */
+    uint64_t queued_us[JIT_AIRTIME_BAND_NB_MAX];    /* airtime of the packets queued, not sent yet */
+    int64_t head_s[JIT_AIRTIME_BAND_NB_MAX];        /* second of the latest bucket */
+    uint32_t nb_rejected[JIT_AIRTIME_BAND_NB_MAX];
+    uint32_t bucket_us[JIT_AIRTIME_BAND_NB_MAX][JIT_AIRTIME_WINDOW_S];
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
 static pthread_mutex_t mx_jit_queue = PTHREAD_MUTEX_INITIALIZER; /* control access to JIT queue */
+static struct jit_airtime_s airtime; /* shared by all the queues, protected by mx_jit_queue */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+/* Extended timestamp of a 32-bit counter value, taken in the 2^32 us following time_us
+   as the unsigned arithmetic on the 32-bit counter did */
+static inline uint64_t jit_time_expand(uint64_t time_us, uint32_t count_us) {
+    return time_us + (uint32_t)(count_us - (uint32_t)time_us);
+}
+
+/* Extended timestamp a given delay before count_us, saturated to the counter start */
+static inline uint64_t jit_time_sub(uint64_t count_us, uint32_t delay_us) {
+    return (count_us > delay_us) ? (count_us - delay_us) : 0;
+}
+
+/* Position in the order array of the first packet not before count_us (binary search) */
+static int jit_lower_bound(struct jit_queue_s *queue, uint64_t count_us) {
+    int lo = 0;
+    int hi = queue->num_pkt;
+    int mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (queue->nodes[queue->order[mid]].pkt.count_us64 < count_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool jit_collision_test(uint64_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint64_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
+    if (((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
+        ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY))) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+/* Position in the order array of a packet colliding with the given one, -1 if none
+ * Only the packets whose timestamp is close enough to collide are tested */
+static int jit_find_collision(struct jit_queue_s *queue, uint64_t count_us, uint32_t pre_delay, uint32_t post_delay, enum jit_pkt_type_e pkt_type) {
+    struct jit_node_s *node;
+    uint32_t target_pre_delay;
+    uint64_t window_end;
+    int pos;
+
+    window_end = count_us + JIT_PRE_DELAY_MAX + post_delay + TX_MARGIN_DELAY;
+    for (pos = jit_lower_bound(queue, jit_time_sub(count_us, pre_delay + queue->max_post_delay + TX_MARGIN_DELAY)); pos < queue->num_pkt; pos++) {
+        node = &(queue->nodes[queue->order[pos]]);
+        if (window_end < node->pkt.count_us64) {
+            break;
+        }
+
+        /* We ignore Beacon Guard for Class A/C downlinks */
+        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (node->pkt_type == JIT_PKT_TYPE_BEACON)) {
+            target_pre_delay = TX_START_DELAY;
+        } else {
+            target_pre_delay = node->pre_delay;
+        }
+
+        if (jit_collision_test(count_us, pre_delay, post_delay, node->pkt.count_us64, target_pre_delay, node->post_delay) == true) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+/* Sub-band of a frequency, -1 if it has no duty cycle limit */
+static int jit_airtime_band(uint32_t freq_hz) {
+    int i;
+
+    for (i = 0; i < airtime.nb_band; i++) {
+        if ((freq_hz >= airtime.conf[i].freq_min) && (freq_hz <= airtime.conf[i].freq_max)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Slide the window of a sub-band up to the current second, the expired buckets are released */
+static void jit_airtime_advance(int band, int64_t sec) {
+    int64_t s;
+
+    if (sec <= airtime.head_s[band]) {
+        return;
+    }
+    if ((sec - airtime.head_s[band]) >= JIT_AIRTIME_WINDOW_S) {
+        memset(airtime.bucket_us[band], 0, sizeof airtime.bucket_us[band]);
+        airtime.sum_us[band] = 0;
+    } else {
+        for (s = airtime.head_s[band] + 1; s <= sec; s++) {
+            airtime.sum_us[band] -= airtime.bucket_us[band][s % JIT_AIRTIME_WINDOW_S];
+            airtime.bucket_us[band][s % JIT_AIRTIME_WINDOW_S] = 0;
+        }
+    }
+    airtime.head_s[band] = sec;
+}
+
+/* Account the airtime of a packet sent in the latest bucket of its sub-band */
+static void jit_airtime_add(int band, uint32_t toa_us) {
+    airtime.bucket_us[band][airtime.head_s[band] % JIT_AIRTIME_WINDOW_S] += toa_us;
+    airtime.sum_us[band] += toa_us;
+}
+
+/* Remove the packet at the given position in the order array, its node and airtime reservation are released */
+static void jit_remove(struct jit_queue_s *queue, int pos) {
+    uint16_t index = queue->order[pos];
+    struct jit_node_s *node = &(queue->nodes[index]);
+
+    if (node->pkt_type == JIT_PKT_TYPE_BEACON) {
+        queue->num_beacon--;
+    }
+    if ((node->airtime_band >= 0) && (node->airtime_band < airtime.nb_band)) {
+        /* the reservations may have been reset by jit_airtime_init meanwhile */
+        airtime.queued_us[node->airtime_band] -= (airtime.queued_us[node->airtime_band] > node->airtime_us) ? node->airtime_us : airtime.queued_us[node->airtime_band];
+    }
+    memset(&(queue->nodes[index]), 0, sizeof(struct jit_node_s));
+    memmove(&(queue->order[pos]), &(queue->order[pos + 1]), (queue->num_pkt - pos - 1) * sizeof(queue->order[0]));
+    queue->num_pkt--;
+    queue->free_nodes[queue->size - queue->num_pkt - 1] = index;
+    if (queue->num_pkt == 0) {
+        queue->max_post_delay = 0;
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -54,7 +203,7 @@ bool jit_queue_is_full(struct jit_queue_s *queue) {
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    result = (queue->num_pkt == JIT_QUEUE_MAX)?true:false;
+    result = (queue->num_pkt == queue->size)?true:false;
 
     pthread_mutex_unlock(&mx_jit_queue);
 
@@ -73,58 +222,132 @@ bool jit_queue_is_empty(struct jit_queue_s *queue) {
     return result;
 }
 
-void jit_queue_init(struct jit_queue_s *queue) {
+void jit_queue_get_occupancy(struct jit_queue_s *queue, uint16_t *num_pkt, uint16_t *max_num_pkt) {
+    pthread_mutex_lock(&mx_jit_queue);
+
+    *num_pkt = queue->num_pkt;
+    *max_num_pkt = queue->max_num_pkt;
+
+    pthread_mutex_unlock(&mx_jit_queue);
+}
+
+enum jit_error_e jit_queue_init(struct jit_queue_s *queue, uint16_t size) {
     int i;
 
+    if ((size == 0) || (size > JIT_QUEUE_SIZE_MAX)) {
+        MSG("ERROR: invalid JIT queue size %u\n", size);
+        return JIT_ERROR_INVALID;
+    }
+
     pthread_mutex_lock(&mx_jit_queue);
 
+    free(queue->nodes);
+    free(queue->order);
+    free(queue->free_nodes);
     memset(queue, 0, sizeof(*queue));
-    for (i=0; i<JIT_QUEUE_MAX; i++) {
-        queue->nodes[i].pre_delay = 0;
-        queue->nodes[i].post_delay = 0;
+    queue->nodes = calloc(size, sizeof(struct jit_node_s));
+    queue->order = calloc(size, sizeof(uint16_t));
+    queue->free_nodes = calloc(size, sizeof(uint16_t));
+    if ((queue->nodes == NULL) || (queue->order == NULL) || (queue->free_nodes == NULL)) {
+        free(queue->nodes);
+        free(queue->order);
+        free(queue->free_nodes);
+        memset(queue, 0, sizeof(*queue));
+        pthread_mutex_unlock(&mx_jit_queue);
+        MSG("ERROR: failed to allocate JIT queue of %u packets\n", size);
+        return JIT_ERROR_INVALID;
+    }
+    queue->size = size;
+    for (i=0; i<size; i++) {
+        queue->free_nodes[i] = size - 1 - i; /* first node on top of the stack */
     }
 
     pthread_mutex_unlock(&mx_jit_queue);
+
+    return JIT_ERROR_OK;
 }
 
-int compare(const void *a, const void *b)
-{
-    int p_count, q_count;
+enum jit_error_e jit_airtime_init(const struct jit_airtime_band_s *band, int nb_band) {
+    int i;
 
-    p_count = ((struct lgw_pkt_rx_s *)a)->count_us;
-    q_count = ((struct lgw_pkt_rx_s *)b)->count_us;
+    if ((nb_band < 0) || (nb_band > JIT_AIRTIME_BAND_NB_MAX) || ((nb_band > 0) && (band == NULL))) {
+        return JIT_ERROR_INVALID;
+    }
+    for (i = 0; i < nb_band; i++) {
+        if ((band[i].freq_min > band[i].freq_max) || !(band[i].duty_cycle > 0.0) || (band[i].duty_cycle > 1.0)) {
+            return JIT_ERROR_INVALID;
+        }
+    }
+
+    pthread_mutex_lock(&mx_jit_queue);
 
-    return (p_count - q_count);
+    memset(&airtime, 0, sizeof airtime);
+    airtime.nb_band = nb_band;
+    for (i = 0; i < nb_band; i++) {
+        airtime.conf[i] = band[i];
+        airtime.limit_us[i] = (uint64_t)((double)band[i].duty_cycle * JIT_AIRTIME_WINDOW_S * 1E6);
+    }
+
+    pthread_mutex_unlock(&mx_jit_queue);
+
+    return JIT_ERROR_OK;
 }
 
-void jit_sort_queue(struct jit_queue_s *queue) {
-    if (queue->num_pkt == 0) {
-        return;
+int jit_airtime_get_stats(struct jit_airtime_stat_s *stats, int nb_band) {
+    struct timespec now;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    for (i = 0; (i < nb_band) && (i < airtime.nb_band); i++) {
+        jit_airtime_advance(i, (int64_t)now.tv_sec);
+        stats[i].usage = (float)((double)airtime.sum_us[i] / (JIT_AIRTIME_WINDOW_S * 1E6));
+        stats[i].reserved = (float)((double)airtime.queued_us[i] / (JIT_AIRTIME_WINDOW_S * 1E6));
+        stats[i].nb_rejected = airtime.nb_rejected[i];
     }
 
-    MSG_DEBUG(DEBUG_JIT, "sorting queue in ascending order packet timestamp - queue size:%u\n", queue->num_pkt);
-    qsort(queue->nodes, queue->num_pkt, sizeof(queue->nodes[0]), compare);
-    MSG_DEBUG(DEBUG_JIT, "sorting queue done - swapped\n");
+    pthread_mutex_unlock(&mx_jit_queue);
+
+    return i;
 }
 
-bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
-    if (((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
-        ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY))) {
-        return true;
-    } else {
-        return false;
+void jit_airtime_charge(const struct lgw_pkt_tx_s *packet) {
+    struct timespec now;
+    int band;
+
+    if (packet == NULL) {
+        return;
     }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    band = jit_airtime_band(packet->freq_hz);
+    if (band >= 0) {
+        jit_airtime_advance(band, (int64_t)now.tv_sec);
+        jit_airtime_add(band, lgw_time_on_air(packet) * 1000UL);
+    }
+
+    pthread_mutex_unlock(&mx_jit_queue);
 }
 
-enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type) {
-    int i = 0;
+enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint64_t time_us, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type) {
+    int pos;
+    int band;
+    uint32_t toa_us = 0;
+    struct timespec now;
+    uint16_t index;
     uint32_t packet_post_delay = 0;
     uint32_t packet_pre_delay = 0;
-    uint32_t target_pre_delay = 0;
+    uint64_t candidate_count_us;
     enum jit_error_e err_collision;
-    uint32_t asap_count_us;
+    uint64_t asap_count_us;
+    struct jit_node_s *node;
 
-    MSG_DEBUG(DEBUG_JIT, "Current concentrator time is %u, pkt_type=%d\n", time_us, pkt_type);
+    MSG_DEBUG(DEBUG_JIT, "Current concentrator time is %" PRIu64 ", pkt_type=%d\n", time_us, pkt_type);
 
     if (packet == NULL) {
         MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: invalid parameter\n");
@@ -165,59 +388,44 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
         asap_count_us = time_us + 2 * TX_JIT_DELAY; /* margin */
         if (queue->num_pkt == 0) {
             /* If the jit queue is empty, we can insert this packet */
-            MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink, first in JiT queue (count_us=%u)\n", asap_count_us);
+            MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink, first in JiT queue (count_us=%" PRIu64 ")\n", asap_count_us);
+        } else if (jit_find_collision(queue, asap_count_us, packet_pre_delay, packet_post_delay, pkt_type) < 0) {
+            /* No collision with ASAP time, we can insert it */
+            MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink ASAP at %" PRIu64 " (no collision)\n", asap_count_us);
         } else {
-            /* Else we can try to insert it:
-                - ASAP meaning NOW + MARGIN
-                - at the last index of the queue
-                - between 2 downlinks in the queue
-            */
-
-            /* First, try if the ASAP time collides with an already enqueued downlink */
-            for (i=0; i<queue->num_pkt; i++) {
-                if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, queue->nodes[i].pre_delay, queue->nodes[i].post_delay) == true) {
-                    MSG_DEBUG(DEBUG_JIT, "DEBUG: cannot insert IMMEDIATE downlink at count_us=%u, collides with %u (index=%d)\n", asap_count_us, queue->nodes[i].pkt.count_us, i);
-                    break;
+            /* Else try to insert it right after one of the following downlinks in the queue,
+               the slot after the last one is always free */
+            for (pos = jit_lower_bound(queue, jit_time_sub(asap_count_us, packet_pre_delay + queue->max_post_delay + TX_MARGIN_DELAY)); pos < queue->num_pkt; pos++) {
+                node = &(queue->nodes[queue->order[pos]]);
+                candidate_count_us = node->pkt.count_us64 + node->post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
+                if (candidate_count_us < asap_count_us) {
+                    continue;
                 }
-            }
-            if (i == queue->num_pkt) {
-                /* No collision with ASAP time, we can insert it */
-                MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink ASAP at %u (no collision)\n", asap_count_us);
-            } else {
-                /* Search for the best slot then */
-                for (i=0; i<queue->num_pkt; i++) {
-                    asap_count_us = queue->nodes[i].pkt.count_us + queue->nodes[i].post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
-                    if (i == (queue->num_pkt - 1)) {
-                        /* Last packet index, we can insert after this one */
-                        MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink, last in JiT queue (count_us=%u)\n", asap_count_us);
-                    } else {
-                        /* Check if packet can be inserted between this index and the next one */
-                        MSG_DEBUG(DEBUG_JIT, "DEBUG: try to insert IMMEDIATE downlink (count_us=%u) between index %d and index %d?\n", asap_count_us, i, i+1);
-                        if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i+1].pkt.count_us, queue->nodes[i+1].pre_delay, queue->nodes[i+1].post_delay) == true) {
-                            MSG_DEBUG(DEBUG_JIT, "DEBUG: failed to insert IMMEDIATE downlink (count_us=%u), continue...\n", asap_count_us);
-                            continue;
-                        } else {
-                            MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink (count_us=%u)\n", asap_count_us);
-                            break;
-                        }
-                    }
+                asap_count_us = candidate_count_us;
+                MSG_DEBUG(DEBUG_JIT, "DEBUG: try to insert IMMEDIATE downlink (count_us=%" PRIu64 ") after position %d?\n", asap_count_us, pos);
+                if (jit_find_collision(queue, asap_count_us, packet_pre_delay, packet_post_delay, pkt_type) < 0) {
+                    break;
                 }
             }
+            MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink (count_us=%" PRIu64 ")\n", asap_count_us);
         }
         /* Set packet with ASAP timestamp */
-        packet->count_us = asap_count_us;
+        packet->count_us64 = asap_count_us;
+    } else if (packet->count_us64 == 0) {
+        /* Only the 32-bit counter value is given, take its next occurrence */
+        packet->count_us64 = jit_time_expand(time_us, packet->count_us);
     }
+    packet->count_us = (uint32_t)packet->count_us64;
 
     /* Check criteria_1: is it already too late to send this packet ?
      *  The packet should arrive at least at (tmst - TX_START_DELAY) to be programmed into concentrator
      *  Note: - Also add some margin, to be checked how much is needed, if needed
      *        - Valid for both Downlinks and Beacon packets
      *
-     *  Warning: unsigned arithmetic (handle roll-over)
      *      t_packet < t_current + TX_START_DELAY + MARGIN
      */
-    if ((packet->count_us - time_us) <= (TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY)) {
-        MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet REJECTED, already too late to send it (current=%u, packet=%u, type=%d)\n", time_us, packet->count_us, pkt_type);
+    if (packet->count_us64 <= (time_us + TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY)) {
+        MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet REJECTED, already too late to send it (current=%" PRIu64 ", packet=%" PRIu64 ", type=%d)\n", time_us, packet->count_us64, pkt_type);
         pthread_mutex_unlock(&mx_jit_queue);
         return JIT_ERROR_TOO_LATE;
     }
@@ -230,12 +438,11 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
      *  So let's define a safe delay above which we can say that the packet is out of bound: TX_MAX_ADVANCE_DELAY
      *  Note: - Valid for Downlinks only, not for Beacon packets
      *
-     *  Warning: unsigned arithmetic (handle roll-over)
                 t_packet > t_current + TX_MAX_ADVANCE_DELAY
      */
     if ((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_B)) {
-        if ((packet->count_us - time_us) > TX_MAX_ADVANCE_DELAY) {
-            MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet REJECTED, timestamp seems wrong, too much in advance (current=%u, packet=%u, type=%d)\n", time_us, packet->count_us, pkt_type);
+        if ((packet->count_us64 - time_us) > TX_MAX_ADVANCE_DELAY) {
+            MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet REJECTED, timestamp seems wrong, too much in advance (current=%" PRIu64 ", packet=%" PRIu64 ", type=%d)\n", time_us, packet->count_us64, pkt_type);
             pthread_mutex_unlock(&mx_jit_queue);
             return JIT_ERROR_TOO_EARLY;
         }
@@ -245,75 +452,133 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, uint32_t time_us, struct
      *  Note: - need to take into account packet's pre_delay and post_delay of each packet
      *        - Valid for both Downlinks and beacon packets
      *        - Beacon guard can be ignored if we try to queue a Class A downlink
+     *
+     *  Check if there is a collision
+     *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
+     *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
      */
-    for (i=0; i<queue->num_pkt; i++) {
-        /* We ignore Beacon Guard for Class A/C downlinks */
-        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON)) {
-            target_pre_delay = TX_START_DELAY;
-        } else {
-            target_pre_delay = queue->nodes[i].pre_delay;
+    pos = jit_find_collision(queue, packet->count_us64, packet_pre_delay, packet_post_delay, pkt_type);
+    if (pos >= 0) {
+        node = &(queue->nodes[queue->order[pos]]);
+        switch (node->pkt_type) {
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
+                MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with packet already programmed at %" PRIu64 " (%" PRIu64 ")\n", pkt_type, node->pkt.count_us64, packet->count_us64);
+                err_collision = JIT_ERROR_COLLISION_PACKET;
+                break;
+            case JIT_PKT_TYPE_BEACON:
+                if (pkt_type != JIT_PKT_TYPE_BEACON) {
+                    /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
+                    MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with beacon already programmed at %" PRIu64 " (%" PRIu64 ")\n", pkt_type, node->pkt.count_us64, packet->count_us64);
+                }
+                err_collision = JIT_ERROR_COLLISION_BEACON;
+                break;
+            default:
+                MSG("ERROR: Unknown packet type, should not occur, BUG?\n");
+                assert(0);
+                break;
         }
+        pthread_mutex_unlock(&mx_jit_queue);
+        return err_collision;
+    }
 
-        /* Check if there is a collision
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
-         *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
-         */
-        if (jit_collision_test(packet->count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, target_pre_delay, queue->nodes[i].post_delay) == true) {
-            switch (queue->nodes[i].pkt_type) {
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
-                    MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    err_collision = JIT_ERROR_COLLISION_PACKET;
-                    break;
-                case JIT_PKT_TYPE_BEACON:
-                    if (pkt_type != JIT_PKT_TYPE_BEACON) {
-                        /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
-                        MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    }
-                    err_collision = JIT_ERROR_COLLISION_BEACON;
-                    break;
-                default:
-                    MSG("ERROR: Unknown packet type, should not occur, BUG?\n");
-                    assert(0);
-                    break;
-            }
+    /* Check criteria_4: does this new packet fit in the duty cycle of its sub-band ?
+     *  The airtime sent in the window and the airtime of the packets queued are counted, the
+     *  packet is reserved until it is removed from the queue, and charged by jit_airtime_charge
+     *  if it is actually sent
+     *  Note: - Beacons are reserved with their actual time on air, and never rejected
+     */
+    band = jit_airtime_band(packet->freq_hz);
+    if (band >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        toa_us = (pkt_type == JIT_PKT_TYPE_BEACON) ? (lgw_time_on_air(packet) * 1000UL) : packet_post_delay;
+        jit_airtime_advance(band, (int64_t)now.tv_sec);
+        if ((pkt_type != JIT_PKT_TYPE_BEACON) && ((airtime.sum_us[band] + airtime.queued_us[band] + toa_us) > airtime.limit_us[band])) {
+            MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet REJECTED, duty cycle of sub-band %u-%u exceeded (%u us on air)\n", airtime.conf[band].freq_min, airtime.conf[band].freq_max, toa_us);
+            airtime.nb_rejected[band] += 1;
             pthread_mutex_unlock(&mx_jit_queue);
-            return err_collision;
+            return JIT_ERROR_DUTY_CYCLE;
         }
+        airtime.queued_us[band] += toa_us;
     }
 
     /* Finally enqueue it */
-    /* Insert packet at the end of the queue */
-    memcpy(&(queue->nodes[queue->num_pkt].pkt), packet, sizeof(struct lgw_pkt_tx_s));
-    queue->nodes[queue->num_pkt].pre_delay = packet_pre_delay;
-    queue->nodes[queue->num_pkt].post_delay = packet_post_delay;
-    queue->nodes[queue->num_pkt].pkt_type = pkt_type;
+    /* Take a free node, and insert its index in the order array, in ascending order of packet timestamp */
+    index = queue->free_nodes[queue->size - queue->num_pkt - 1];
+    memcpy(&(queue->nodes[index].pkt), packet, sizeof(struct lgw_pkt_tx_s));
+    queue->nodes[index].pre_delay = packet_pre_delay;
+    queue->nodes[index].post_delay = packet_post_delay;
+    queue->nodes[index].pkt_type = pkt_type;
+    queue->nodes[index].airtime_band = (int8_t)band;
+    queue->nodes[index].airtime_us = toa_us;
+    pos = jit_lower_bound(queue, packet->count_us64);
+    memmove(&(queue->order[pos + 1]), &(queue->order[pos]), (queue->num_pkt - pos) * sizeof(queue->order[0]));
+    queue->order[pos] = index;
     if (pkt_type == JIT_PKT_TYPE_BEACON) {
         queue->num_beacon++;
     }
     queue->num_pkt++;
-    /* Sort the queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    if (queue->num_pkt > queue->max_num_pkt) {
+        queue->max_num_pkt = queue->num_pkt;
+    }
+    if (packet_post_delay > queue->max_post_delay) {
+        queue->max_post_delay = packet_post_delay;
+    }
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
 
     jit_print_queue(queue, false, DEBUG_JIT);
 
-    MSG_DEBUG(DEBUG_JIT, "enqueued packet with count_us=%u (size=%u bytes, toa=%u us, type=%u)\n", packet->count_us, packet->size, packet_post_delay, pkt_type);
+    MSG_DEBUG(DEBUG_JIT, "enqueued packet with count_us=%" PRIu64 " (size=%u bytes, toa=%u us, type=%u)\n", packet->count_us64, packet->size, packet_post_delay, pkt_type);
 
     return JIT_ERROR_OK;
 }
 
+enum jit_error_e jit_admit(struct jit_queue_s *queue, uint64_t time_us, uint32_t count_us, enum jit_pkt_type_e pkt_type) {
+    enum jit_error_e result = JIT_ERROR_OK;
+    uint64_t count_us64;
+    int pos;
+
+    count_us64 = jit_time_expand(time_us, count_us);
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    if (queue->num_pkt == queue->size) {
+        result = JIT_ERROR_FULL;
+    } else if ((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_B)) {
+        /* same criteria as jit_enqueue, the collisions are tested with no time on air */
+        if (count_us64 <= (time_us + TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY)) {
+            result = JIT_ERROR_TOO_LATE;
+        } else if ((count_us64 - time_us) > TX_MAX_ADVANCE_DELAY) {
+            result = JIT_ERROR_TOO_EARLY;
+        } else {
+            pos = jit_find_collision(queue, count_us64, TX_START_DELAY + TX_JIT_DELAY, 0, pkt_type);
+            if (pos >= 0) {
+                result = (queue->nodes[queue->order[pos]].pkt_type == JIT_PKT_TYPE_BEACON) ? JIT_ERROR_COLLISION_BEACON : JIT_ERROR_COLLISION_PACKET;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mx_jit_queue);
+
+    if (result != JIT_ERROR_OK) {
+        MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet REJECTED before decoding, jit error=%d (current=%" PRIu64 ", packet=%" PRIu64 ", type=%d)\n", result, time_us, count_us64, pkt_type);
+    }
+
+    return result;
+}
+
 enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e *pkt_type) {
+    int pos;
+
     if (packet == NULL) {
         MSG("ERROR: invalid parameter\n");
         return JIT_ERROR_INVALID;
     }
 
-    if ((index < 0) || (index >= JIT_QUEUE_MAX)) {
+    if ((index < 0) || (index >= queue->size)) {
         MSG("ERROR: invalid parameter\n");
         return JIT_ERROR_INVALID;
     }
@@ -325,36 +590,36 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
     pthread_mutex_lock(&mx_jit_queue);
 
+    /* Find the node in the order array (timestamps are unique, packets cannot collide) */
+    pos = jit_lower_bound(queue, queue->nodes[index].pkt.count_us64);
+    if ((pos >= queue->num_pkt) || (queue->order[pos] != index)) {
+        pthread_mutex_unlock(&mx_jit_queue);
+        MSG("ERROR: cannot dequeue packet, no packet queued at index %d\n", index);
+        return JIT_ERROR_INVALID;
+    }
+
     /* Dequeue requested packet */
     memcpy(packet, &(queue->nodes[index].pkt), sizeof(struct lgw_pkt_tx_s));
-    queue->num_pkt--;
     *pkt_type = queue->nodes[index].pkt_type;
     if (*pkt_type == JIT_PKT_TYPE_BEACON) {
-        queue->num_beacon--;
         MSG_DEBUG(DEBUG_BEACON, "--- Beacon dequeued ---\n");
     }
-
-    /* Replace dequeued packet with last packet of the queue */
-    memcpy(&(queue->nodes[index]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-    memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-    /* Sort queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    jit_remove(queue, pos);
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
 
     jit_print_queue(queue, false, DEBUG_JIT);
 
-    MSG_DEBUG(DEBUG_JIT, "dequeued packet with count_us=%u from index %d\n", packet->count_us, index);
+    MSG_DEBUG(DEBUG_JIT, "dequeued packet with count_us=%" PRIu64 " from index %d\n", packet->count_us64, index);
 
     return JIT_ERROR_OK;
 }
 
-enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_idx) {
+enum jit_error_e jit_peek(struct jit_queue_s *queue, uint64_t time_us, int *pkt_idx) {
     /* Return index of node containing a packet inline with given time */
-    int i = 0;
-    int idx_highest_priority = -1;
+    struct jit_node_s *node = NULL;
+
     if (pkt_idx == NULL) {
         MSG("ERROR: invalid parameter\n");
         return JIT_ERROR_INVALID;
@@ -366,54 +631,36 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    /* Search for highest priority packet to be sent */
-    for (i=0; i<queue->num_pkt; i++) {
+    /* The highest priority packet to be sent is the first of the order array */
+    while (queue->num_pkt > 0) {
+        node = &(queue->nodes[queue->order[0]]);
+
         /* First check if that packet is outdated:
          *  If a packet seems too much in advance, and was not rejected at enqueue time,
          *  it means that we missed it for peeking, we need to drop it
          *
-         *  Warning: unsigned arithmetic
+         *  Warning: unsigned arithmetic, a packet in the past is far in advance
          *      t_packet > t_current + TX_MAX_ADVANCE_DELAY
          */
-        if ((queue->nodes[i].pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY) {
-            /* We drop the packet to avoid lock-up */
-            queue->num_pkt--;
-            if (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON) {
-                queue->num_beacon--;
-                MSG("WARNING: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            } else {
-                MSG("WARNING: --- Packet dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            }
-
-            /* Replace dropped packet with last packet of the queue */
-            memcpy(&(queue->nodes[i]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-            memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-            /* Sort queue in ascending order of packet timestamp */
-            jit_sort_queue(queue);
-
-            /* restart loop  after purge to find packet to be sent */
-            i = 0;
-            continue;
+        if ((node->pkt.count_us64 - time_us) < TX_MAX_ADVANCE_DELAY) {
+            break;
         }
 
-        /* Then look for highest priority packet to be sent:
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet < t_highest
-         */
-        if ((idx_highest_priority == -1) || (((queue->nodes[i].pkt.count_us - time_us) < (queue->nodes[idx_highest_priority].pkt.count_us - time_us)))) {
-            idx_highest_priority = i;
+        /* We drop the packet to avoid lock-up */
+        if (node->pkt_type == JIT_PKT_TYPE_BEACON) {
+            MSG("WARNING: --- Beacon dropped (current_time=%" PRIu64 ", packet_time=%" PRIu64 ") ---\n", time_us, node->pkt.count_us64);
+        } else {
+            MSG("WARNING: --- Packet dropped (current_time=%" PRIu64 ", packet_time=%" PRIu64 ") ---\n", time_us, node->pkt.count_us64);
         }
+        jit_remove(queue, 0);
     }
 
     /* Peek criteria 1: look for a packet to be sent in next TX_JIT_DELAY ms timeframe
-     *  Warning: unsigned arithmetic (handle roll-over)
      *      t_packet < t_current + TX_JIT_DELAY
      */
-    if ((queue->nodes[idx_highest_priority].pkt.count_us - time_us) < TX_JIT_DELAY) {
-        *pkt_idx = idx_highest_priority;
-        MSG_DEBUG(DEBUG_JIT, "peek packet with count_us=%u at index %d\n",
-            queue->nodes[idx_highest_priority].pkt.count_us, idx_highest_priority);
+    if ((queue->num_pkt > 0) && ((node->pkt.count_us64 - time_us) < TX_JIT_DELAY)) {
+        *pkt_idx = queue->order[0];
+        MSG_DEBUG(DEBUG_JIT, "peek packet with count_us=%" PRIu64 " at index %d\n", node->pkt.count_us64, *pkt_idx);
     } else {
         *pkt_idx = -1;
     }
@@ -423,9 +670,76 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, uint32_t time_us, int *pkt_
     return JIT_ERROR_OK;
 }
 
+enum jit_error_e jit_peek_delay(struct jit_queue_s *queue, uint64_t time_us, uint32_t *delay_us) {
+    int64_t delay;
+
+    if (delay_us == NULL) {
+        MSG("ERROR: invalid parameter\n");
+        return JIT_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    if (queue->num_pkt == 0) {
+        pthread_mutex_unlock(&mx_jit_queue);
+        return JIT_ERROR_EMPTY;
+    }
+
+    /* The head packet is peeked once it is less than TX_JIT_DELAY ahead of current time,
+       outdated packets are due immediately so that jit_peek can drop them */
+    delay = (int64_t)(queue->nodes[queue->order[0]].pkt.count_us64 - TX_JIT_DELAY - time_us);
+    *delay_us = (delay >= 0) ? ((delay < UINT32_MAX) ? (uint32_t)delay + 1 : UINT32_MAX) : 0;
+
+    pthread_mutex_unlock(&mx_jit_queue);
+
+    return JIT_ERROR_OK;
+}
+
+enum jit_error_e jit_get_head(struct jit_queue_s *queue, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e *pkt_type) {
+    if ((packet == NULL) || (pkt_type == NULL)) {
+        MSG("ERROR: invalid parameter\n");
+        return JIT_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    if (queue->num_pkt == 0) {
+        pthread_mutex_unlock(&mx_jit_queue);
+        return JIT_ERROR_EMPTY;
+    }
+
+    memcpy(packet, &(queue->nodes[queue->order[0]].pkt), sizeof(struct lgw_pkt_tx_s));
+    *pkt_type = queue->nodes[queue->order[0]].pkt_type;
+
+    pthread_mutex_unlock(&mx_jit_queue);
+
+    return JIT_ERROR_OK;
+}
+
+int jit_flush(struct jit_queue_s *queue, void (*fn)(const struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type, void *arg), void *arg) {
+    int nb_pkt;
+    int pos;
+
+    pthread_mutex_lock(&mx_jit_queue);
+
+    nb_pkt = queue->num_pkt;
+    for (pos = 0; (pos < nb_pkt) && (fn != NULL); pos++) {
+        fn(&(queue->nodes[queue->order[pos]].pkt), queue->nodes[queue->order[pos]].pkt_type, arg);
+    }
+    /* from the end of the order array, nothing has to be moved */
+    while (queue->num_pkt > 0) {
+        jit_remove(queue, queue->num_pkt - 1);
+    }
+
+    pthread_mutex_unlock(&mx_jit_queue);
+
+    MSG_DEBUG(DEBUG_JIT, "flushed %d packets\n", nb_pkt);
+
+    return nb_pkt;
+}
+
 void jit_print_queue(struct jit_queue_s *queue, bool show_all, int debug_level) {
     int i = 0;
-    int loop_end;
 
     if (jit_queue_is_empty(queue)) {
         MSG_DEBUG(debug_level, "INFO: [jit] queue is empty\n");
@@ -434,12 +748,20 @@ void jit_print_queue(struct jit_queue_s *queue, bool show_all, int debug_level)
 
         MSG_DEBUG(debug_level, "INFO: [jit] queue contains %d packets:\n", queue->num_pkt);
         MSG_DEBUG(debug_level, "INFO: [jit] queue contains %d beacons:\n", queue->num_beacon);
-        loop_end = (show_all == true) ? JIT_QUEUE_MAX : queue->num_pkt;
-        for (i=0; i<loop_end; i++) {
-            MSG_DEBUG(debug_level, " - node[%d]: count_us=%u - type=%d\n",
-                        i,
-                        queue->nodes[i].pkt.count_us,
-                        queue->nodes[i].pkt_type);
+        if (show_all == true) {
+            for (i=0; i<queue->size; i++) {
+                MSG_DEBUG(debug_level, " - node[%d]: count_us=%" PRIu64 " - type=%d\n",
+                            i,
+                            queue->nodes[i].pkt.count_us64,
+                            queue->nodes[i].pkt_type);
+            }
+        } else {
+            for (i=0; i<queue->num_pkt; i++) {
+                MSG_DEBUG(debug_level, " - node[%d]: count_us=%" PRIu64 " - type=%d\n",
+                            queue->order[i],
+                            queue->nodes[queue->order[i]].pkt.count_us64,
+                            queue->nodes[queue->order[i]].pkt_type);
+            }
         }
 
         pthread_mutex_unlock(&mx_jit_queue);
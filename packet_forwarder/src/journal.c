@@ -0,0 +1,359 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : persistent journal of the upstream datagrams.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <string.h>     /* memcpy, memset */
+#include <fcntl.h>      /* open */
+#include <unistd.h>     /* close, ftruncate */
+#include <sys/mman.h>   /* mmap, msync, munmap */
+#include <sys/stat.h>   /* fstat */
+
+#include "journal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define JOURNAL_MAGIC           0x4A524E4C  /* "JRNL" */
+#define JOURNAL_VERSION         1
+#define JOURNAL_HDR_SIZE        64          /* bytes reserved for the header at the start of the file */
+
+#define REC_HDR_SIZE            (sizeof(struct journal_rec_s))
+#define REC_SIZE(size)          (REC_HDR_SIZE + (((size) + 3) & ~3UL)) /* records are 4-byte aligned */
+
+/* record states, the values are stored in the file */
+#define REC_PENDING             1   /* sent, waiting for its acknowledge */
+#define REC_LOST                2   /* not acknowledged in time, to be sent again */
+#define REC_ACKED               3   /* acknowledged, to be released */
+#define REC_WRAP                4   /* not a record, the next one is at the start of the ring */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* persistent state, all offsets are relative to the start of the ring */
+struct journal_hdr_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          /* size of the ring */
+    uint32_t head;          /* offset where the next record is written */
+    uint32_t tail;          /* offset of the oldest record */
+    uint32_t nb_rec;        /* number of records in the ring */
+    uint32_t nb_lost;       /* number of records to be sent again */
+    uint32_t next_seq;      /* sequence number of the next record, never 0 */
+};
+
+struct journal_rec_s {
+    uint32_t seq;
+    uint32_t size;          /* size of the datagram following the record header */
+    uint32_t state;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static struct journal_rec_s * rec_at(struct journal_s * jrn, uint32_t offset) {
+    return (struct journal_rec_s *)(jrn->ring + offset);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* offset of the record following the one at offset, or head if it is the last one */
+static uint32_t rec_next(struct journal_s * jrn, uint32_t offset) {
+    offset += REC_SIZE(rec_at(jrn, offset)->size);
+    if (offset == jrn->hdr->head) {
+        return offset;
+    }
+    if (((jrn->hdr->size - offset) < REC_HDR_SIZE) || (rec_at(jrn, offset)->state == REC_WRAP)) {
+        return 0;
+    }
+    return offset;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static struct journal_rec_s * rec_get(struct journal_s * jrn, struct journal_ref_s ref) {
+    struct journal_rec_s * rec;
+
+    if ((ref.seq == 0) || (ref.offset > (jrn->hdr->size - REC_HDR_SIZE))) {
+        return NULL;
+    }
+    rec = rec_at(jrn, ref.offset);
+    if ((rec->seq != ref.seq) || ((rec->state != REC_PENDING) && (rec->state != REC_LOST))) {
+        return NULL; /* overwritten, or already acknowledged */
+    }
+    return rec;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rec_drop_tail(struct journal_s * jrn) {
+    struct journal_hdr_s * hdr = jrn->hdr;
+    struct journal_rec_s * rec = rec_at(jrn, hdr->tail);
+    uint32_t tail;
+
+    if (rec->state == REC_LOST) {
+        hdr->nb_lost -= 1;
+    }
+    if (rec->state != REC_ACKED) {
+        jrn->dropped += 1;
+    }
+
+    hdr->nb_rec -= 1;
+    if (hdr->nb_rec == 0) {
+        hdr->head = 0;
+        hdr->tail = 0;
+        jrn->replay = 0;
+        return;
+    }
+    tail = rec_next(jrn, hdr->tail);
+    if (jrn->replay == hdr->tail) {
+        jrn->replay = tail;
+    }
+    hdr->tail = tail;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void journal_reset(struct journal_s * jrn, uint32_t size) {
+    memset(jrn->hdr, 0, JOURNAL_HDR_SIZE);
+    jrn->hdr->magic = JOURNAL_MAGIC;
+    jrn->hdr->version = JOURNAL_VERSION;
+    jrn->hdr->size = size;
+    jrn->hdr->next_seq = 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* check the records left by a previous run, the pending ones will never be acknowledged */
+static int journal_recover(struct journal_s * jrn, uint32_t size) {
+    struct journal_hdr_s * hdr = jrn->hdr;
+    struct journal_rec_s * rec;
+    uint32_t offset, i;
+
+    if ((hdr->magic != JOURNAL_MAGIC) || (hdr->version != JOURNAL_VERSION) || (hdr->size != size)) {
+        return -1;
+    }
+    if ((hdr->head > size) || (hdr->tail > (size - REC_HDR_SIZE)) || (hdr->nb_rec > (size / REC_HDR_SIZE))) {
+        return -1;
+    }
+
+    hdr->nb_lost = 0;
+    offset = hdr->tail;
+    for (i = 0; i < hdr->nb_rec; i++) {
+        rec = rec_at(jrn, offset);
+        if ((rec->size > size) || (REC_SIZE(rec->size) > (size - offset)) || (rec->state < REC_PENDING) || (rec->state > REC_ACKED)) {
+            return -1;
+        }
+        if ((rec->state == REC_PENDING) || (rec->state == REC_LOST)) {
+            rec->state = REC_LOST;
+            hdr->nb_lost += 1;
+        }
+        offset = rec_next(jrn, offset);
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void journal_trim(struct journal_s * jrn) {
+    while ((jrn->hdr->nb_rec > 0) && (rec_at(jrn, jrn->hdr->tail)->state == REC_ACKED)) {
+        rec_drop_tail(jrn);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int journal_open(struct journal_s * jrn, const char * path, uint32_t size) {
+    struct stat st;
+    size_t file_size;
+
+    size &= ~3UL;
+    if (size < JOURNAL_SIZE_MIN) {
+        return -1;
+    }
+    file_size = JOURNAL_HDR_SIZE + (size_t)size;
+
+    jrn->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (jrn->fd < 0) {
+        return -1;
+    }
+    if ((fstat(jrn->fd, &st) != 0) || (((size_t)st.st_size != file_size) && (ftruncate(jrn->fd, file_size) != 0))) {
+        close(jrn->fd);
+        return -1;
+    }
+
+    jrn->map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, jrn->fd, 0);
+    if (jrn->map == MAP_FAILED) {
+        close(jrn->fd);
+        return -1;
+    }
+    jrn->hdr = (struct journal_hdr_s *)jrn->map;
+    jrn->ring = jrn->map + JOURNAL_HDR_SIZE;
+
+    if (journal_recover(jrn, size) != 0) {
+        journal_reset(jrn, size);
+    }
+    jrn->replay = jrn->hdr->tail;
+    jrn->dropped = 0;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void journal_close(struct journal_s * jrn) {
+    size_t file_size = JOURNAL_HDR_SIZE + (size_t)jrn->hdr->size;
+
+    msync(jrn->map, file_size, MS_SYNC);
+    munmap(jrn->map, file_size);
+    close(jrn->fd);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int journal_append(struct journal_s * jrn, const uint8_t * dgram, uint32_t size, struct journal_ref_s * ref) {
+    struct journal_hdr_s * hdr = jrn->hdr;
+    struct journal_rec_s * rec;
+    uint32_t need;
+
+    if (size > (hdr->size / 2)) {
+        ref->seq = 0;
+        return -1;
+    }
+    need = REC_SIZE(size);
+
+    /* make room for the record, overwriting the oldest ones if needed */
+    while (true) {
+        if (hdr->nb_rec == 0) {
+            hdr->head = 0;
+            hdr->tail = 0;
+            jrn->replay = 0;
+        }
+        if ((hdr->nb_rec == 0) || (hdr->head > hdr->tail)) {
+            /* free space after head, up to the end of the ring */
+            if ((hdr->size - hdr->head) >= need) {
+                break;
+            }
+            if ((hdr->size - hdr->head) >= REC_HDR_SIZE) {
+                rec_at(jrn, hdr->head)->state = REC_WRAP;
+            }
+            if (jrn->replay == hdr->head) {
+                jrn->replay = 0;
+            }
+            hdr->head = 0;
+        } else {
+            /* free space between head and the oldest record */
+            if ((hdr->tail - hdr->head) >= need) {
+                break;
+            }
+            rec_drop_tail(jrn);
+        }
+    }
+
+    /* the state is written last, and the record published by moving head */
+    rec = rec_at(jrn, hdr->head);
+    rec->seq = hdr->next_seq;
+    rec->size = size;
+    memcpy(jrn->ring + hdr->head + REC_HDR_SIZE, dgram, size);
+    rec->state = REC_PENDING;
+    ref->offset = hdr->head;
+    ref->seq = hdr->next_seq;
+
+    hdr->next_seq = (hdr->next_seq == UINT32_MAX) ? 1 : (hdr->next_seq + 1);
+    hdr->head += need;
+    hdr->nb_rec += 1;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void journal_ack(struct journal_s * jrn, struct journal_ref_s ref) {
+    struct journal_rec_s * rec = rec_get(jrn, ref);
+
+    if (rec == NULL) {
+        return;
+    }
+    if (rec->state == REC_LOST) {
+        jrn->hdr->nb_lost -= 1;
+    }
+    rec->state = REC_ACKED;
+    journal_trim(jrn);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void journal_lost(struct journal_s * jrn, struct journal_ref_s ref) {
+    struct journal_rec_s * rec = rec_get(jrn, ref);
+
+    if ((rec == NULL) || (rec->state != REC_PENDING)) {
+        return;
+    }
+    rec->state = REC_LOST;
+    jrn->hdr->nb_lost += 1;
+    jrn->replay = jrn->hdr->tail; /* the record may be before the replay position */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint8_t * journal_replay_next(struct journal_s * jrn, uint32_t * size, struct journal_ref_s * ref) {
+    struct journal_hdr_s * hdr = jrn->hdr;
+    struct journal_rec_s * rec;
+    uint32_t offset = jrn->replay;
+    uint32_t next, i;
+
+    if ((hdr->nb_lost == 0) || ((offset == hdr->head) && (offset != hdr->tail))) {
+        return NULL;
+    }
+
+    /* look for the oldest lost record after the replay position */
+    for (i = 0; i < hdr->nb_rec; i++) {
+        rec = rec_at(jrn, offset);
+        next = rec_next(jrn, offset);
+        if (rec->state == REC_LOST) {
+            rec->state = REC_PENDING;
+            hdr->nb_lost -= 1;
+            jrn->replay = next;
+            *size = rec->size;
+            ref->offset = offset;
+            ref->seq = rec->seq;
+            return jrn->ring + offset + REC_HDR_SIZE;
+        }
+        offset = next;
+        if (offset == hdr->head) {
+            break;
+        }
+    }
+    jrn->replay = offset;
+
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t journal_backlog(struct journal_s * jrn) {
+    return jrn->hdr->nb_lost;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -24,6 +24,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #else
     #define _XOPEN_SOURCE 500
 #endif
+#define _GNU_SOURCE /* recvmmsg, sendmmsg */
 
 #include <stdint.h>         /* C99 types */
 #include <stdbool.h>        /* bool type */
@@ -43,17 +44,38 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <netinet/in.h>     /* INET constants and stuff */
 #include <arpa/inet.h>      /* IP address conversion stuff */
 #include <netdb.h>          /* gai_strerror */
+#include <sys/epoll.h>      /* epoll_create1, epoll_ctl, epoll_wait */
+#include <sys/eventfd.h>    /* eventfd */
+#include <poll.h>           /* poll */
 
 #include <pthread.h>
+#include <semaphore.h>      /* sem_t */
+#include <sched.h>          /* SCHED_FIFO, cpu_set_t */
+#include <sys/mman.h>       /* mlockall */
 
 #include "trace.h"
 #include "jitqueue.h"
+#include "rxqueue.h"
+#include "pktpool.h"
+#include "journal.h"
+#include "upfilter.h"
+#include "updedup.h"
+#include "txpkdec.h"
+#include "concent.h"
+#include "metrics.h"
 #include "parson.h"
 #include "base64.h"
+#include "crc16.h"
+#include "jsonw.h"
+#include "lz4blk.h"
 #include "loragw_hal.h"
 #include "loragw_aux.h"
+#include "loragw_com.h"
 #include "loragw_reg.h"
 #include "loragw_gps.h"
+#include "loragw_spectral.h"
+#include "loragw_trace.h"
+#include "loragw_perf.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -73,22 +95,64 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define JSON_CONF_DEFAULT   "global_conf.json"
 
+#define CONF_SNAP_MAGIC     0x50414E53  /* "SNAP", first bytes of a configuration snapshot file */
+#define CONF_SNAP_VERSION   9           /* to be increased when the content of the snapshot changes */
+
+/* HAL configuration calls recorded in a snapshot, besides the board configuration */
+#define CONF_SNAP_CAL_PATH  (1 << 0)
+#define CONF_SNAP_CAL_FAST  (1 << 1)
+#define CONF_SNAP_FTIME     (1 << 2)
+#define CONF_SNAP_SX1261    (1 << 3)
+#define CONF_SNAP_DEMOD     (1 << 4)
+#define CONF_SNAP_DEBUG     (1 << 5)
+#define CONF_SNAP_FW_FAST   (1 << 6)
+#define CONF_SNAP_TXGAIN(i) (1 << (8 + (i)))
+#define CONF_SNAP_RXRF(i)   (1 << (10 + (i)))
+#define CONF_SNAP_RXIF(i)   (1 << (12 + (i)))
+
 #define DEFAULT_SERVER      127.0.0.1   /* hostname also supported */
 #define DEFAULT_PORT_UP     1780
 #define DEFAULT_PORT_DW     1782
 #define DEFAULT_KEEPALIVE   5           /* default time interval for downstream keep-alive packet */
 #define DEFAULT_STAT        30          /* default time interval for statistics */
 #define PUSH_TIMEOUT_MS     100
-#define PULL_TIMEOUT_MS     200
+#define DEFAULT_JOURNAL_REPLAY_RATE 10  /* default number of journaled datagrams sent again per second */
 #define GPS_REF_MAX_AGE     30          /* maximum admitted delay in seconds of GPS loss before considering latest GPS sync unusable */
-#define FETCH_SLEEP_MS      10          /* nb of ms waited when a fetch return no packets */
-#define BEACON_POLL_MS      50          /* time in ms between polling of beacon TX status */
-
-#define PROTOCOL_VERSION    2           /* v1.6 */
+#define GPS_HOLDOVER_ERR_MAX 10.0       /* beyond GPS_REF_MAX_AGE, max expected error in us of the extrapolated counter for GPS sync to be usable */
+#define FETCH_IDLE_MS       500         /* longest time in ms without a full fetch while idle, for the counters sampled by lgw_receive */
+#define FETCH_POLL_MS       1           /* time in ms waited for packet descriptors to be given back to the pool */
+#define FETCH_POLL_MAX_MS   8           /* default longest time in ms between checks of the RX buffer, the interval doubling while idle */
+#define FETCH_POLL_LIMIT_MS 20          /* longest fetch_poll_max_ms, a wait holds the concentrator and must stay short of the 40 ms TX lead */
+#define RECOVER_NB_TRY      5           /* number of reconnections tried after a concentrator link error, before exiting */
+#define RECOVER_WAIT_MS     1000        /* time in ms between reconnection tries, for the link to come back */
+#define BEACON_WAKEUP_MS    100         /* time in ms after a beacon slot before the JiT queue is refilled with beacons */
+#define GPS_POLL_MS         500         /* max time in ms the GPS thread waits for serial data before checking the exit flags */
+#define BEACON_PREPARE_NB   (2 * JIT_NUM_BEACON_IN_QUEUE) /* nb of beacon frames computed ahead of their hand-off to the JiT queue */
+#define JIT_WAIT_MAX_US     1000000     /* max time in us the JIT thread sleeps, to stay in sync with the concentrator counter */
+#define JIT_PREPARE_RETRY_US 10000      /* time in us between attempts to upload the next packet while its TX chain is busy */
+#define JIT_WAKEUP_LATE_US  1000        /* the JIT thread waking up later than that after its deadline is counted as late */
+#define JIT_TX_LATE_US      1500        /* a downlink handed to the concentrator less than that before its emission missed its deadline */
+#define SPECTRAL_SCAN_POINT_NS  8200    /* time in ns between 2 scan points of the SX1261 */
+#define SPECTRAL_SCAN_SETUP_US  2000    /* time in us for the SX1261 to start a scan on a new frequency */
+#define SPECTRAL_SCAN_MARGIN_US 10000   /* time in us kept between the end of a scan and the next downlink taken by the JIT thread */
+#define SPECTRAL_SCAN_RETRY_MS  100     /* time in ms between checks of the downlink schedule for a gap to scan */
+#define SPECTRAL_SCAN_POLL_MS   2       /* time in ms between status reads when a scan takes longer than expected */
+#define SPECTRAL_SCAN_TIMEOUT_MS 2000   /* max time in ms waited for a scan beyond its expected duration */
+#define SPECTRAL_AGG_DECAY_SHIFT 3      /* a new scan weights 1/8 in the rolling histogram of its frequency */
+
+/* stages of an uplink, from the fetch of the packet to the send of its datagram */
+#define UP_LAT_PARSE        0           /* RX buffer fetch to parse completion */
+#define UP_LAT_QUEUE        1           /* parse completion to pop by the upstream thread */
+#define UP_LAT_SERIAL       2           /* pop to serialization of the packet */
+#define UP_LAT_SEND         3           /* serialization to send of the datagram */
+#define UP_LAT_TOTAL        4           /* RX buffer fetch to send of the datagram */
+#define UP_LAT_NB           5
+#define UP_LAT_BIN_NB       24          /* latency histogram: bin 0 is < 1us, bin i is [2^(i-1), 2^i[ us, the last bin also counts longer ones */
+
+#define PROTOCOL_VERSION    2           /* v1.8 */
 #define PROTOCOL_JSON_RXPK_FRAME_FORMAT 1
 
-#define XERR_INIT_AVG       16          /* nb of measurements the XTAL correction is averaged on as initial value */
-#define XERR_FILT_COEF      256         /* coefficient for low-pass XTAL error tracking */
+#define XERR_INIT_AVG       16          /* nb of synchronizations for the clock drift estimate to be used as XTAL correction */
 
 #define PKT_PUSH_DATA   0
 #define PKT_PUSH_ACK    1
@@ -96,6 +160,23 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define PKT_PULL_RESP   3
 #define PKT_PULL_ACK    4
 #define PKT_TX_ACK      5
+#define PKT_PUSH_DATA_BIN 6
+#define PKT_PUSH_DATA_LZ4 7
+
+#define PUSH_DATA_BIN_HEADER_SIZE   14  /* 12-byte header, number of rxpk, flags */
+#define PUSH_DATA_LZ4_HEADER_SIZE   16  /* 12-byte header, size of the JSON object once decompressed */
+#define RXPK_BIN_SIZE               52  /* fixed size part of a binary rxpk, followed by the payload */
+#define STAT_BIN_SIZE               45  /* size of a binary status block */
+#define RXPK_JSON_META_MAX          300 /* upper bound of the size of a JSON rxpk, without its base64 payload */
+#define COALESCE_BYTES_DEFAULT      1400 /* rxpk bytes per coalesced datagram, to stay below the path MTU */
+
+#define RXPK_BIN_FLAG_TIME          0x01
+#define RXPK_BIN_FLAG_TMMS          0x02
+#define RXPK_BIN_FLAG_FTIME         0x04
+#define RXPK_BIN_MODU_LORA          1
+#define RXPK_BIN_MODU_FSK           2
+#define PUSH_DATA_BIN_FLAG_STAT     0x01
+#define STAT_BIN_FLAG_COORD         0x01
 
 #define NB_PKT_MAX      255 /* max number of packets per fetch/send cycle */
 
@@ -104,9 +185,19 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define MIN_FSK_PREAMB  3 /* minimum FSK preamble length for this application */
 #define STD_FSK_PREAMB  5
 
-#define STATUS_SIZE     200
-#define TX_BUFF_SIZE    ((540 * NB_PKT_MAX) + 30 + STATUS_SIZE)
+#define SPEC_STAT_SIZE  96  /* max size of the JSON summary of one scanned frequency */
+#define ULAT_STAT_SIZE  192 /* max size of the JSON summary of the uplink latency */
+#define FILT_STAT_SIZE  64  /* max size of the JSON counters of the uplink filter and de-duplication */
+#define CHAN_STAT_SIZE  256 /* max size of the JSON statistics of one IF chain */
+#define ARB_STAT_SIZE   224 /* max size of the JSON counters of the ARB firmware */
+#define STATUS_SIZE     (256 + ULAT_STAT_SIZE + FILT_STAT_SIZE + (CHAN_STAT_SIZE * LGW_IF_CHAIN_NB) + ARB_STAT_SIZE + (SPEC_STAT_SIZE * LGW_SPECTRAL_FREQ_NB_MAX))
+#define TX_BUFF_SIZE    ((560 * NB_PKT_MAX) + 30 + STATUS_SIZE)
 #define ACK_BUFF_SIZE   64
+#define DOWN_BUFF_SIZE  1000
+#define DOWN_BATCH_NB   32  /* max number of datagrams received, or TX_ACK sent, by a single syscall */
+#define DOWN_TOKEN_NB   (LGW_RF_CHAIN_NB * JIT_QUEUE_SIZE_MAX) /* tokens of the queued downlinks remembered, the oldest ones are overwritten */
+#define UP_SERV_NB_MAX  4   /* max number of servers receiving the uplinks, primary server included */
+#define PUSH_TOKEN_NB   (32 * UP_SERV_NB_MAX)  /* max number of PUSH_DATA datagrams waiting for their acknowledge */
 
 #define UNIX_GPS_EPOCH_OFFSET 315964800 /* Number of seconds ellapsed between 01.Jan.1970 00:00:00
                                                                           and 06.Jan.1980 00:00:00 */
@@ -131,6 +222,56 @@ typedef struct spectral_scan_s {
     uint32_t pace_s;        /* number of seconds between 2 scans in the thread */
 } spectral_scan_t;
 
+/* threads configurable in thread_conf */
+enum thread_id_e {
+    THREAD_FETCH,
+    THREAD_UP,
+    THREAD_DOWN,
+    THREAD_JIT,
+    THREAD_GPS,
+    THREAD_VALID,
+    THREAD_BEACON,
+    THREAD_SPECTRAL_SCAN,
+    THREAD_CONCENT,
+    THREAD_NB
+};
+
+/* scheduling of a thread, default attributes if the policy is SCHED_OTHER and the CPU mask empty */
+struct thread_conf_s {
+    int policy;         /* SCHED_OTHER, SCHED_FIFO or SCHED_RR */
+    int priority;       /* real-time priority, for SCHED_FIFO and SCHED_RR */
+    uint64_t cpu_mask;  /* CPUs the thread can run on, bit i for CPU i, 0 for all */
+};
+
+/* configuration snapshot, HAL configuration as submitted while parsing the JSON file */
+struct conf_snap_hal_s {
+    uint32_t                    set;                        /* CONF_SNAP_xxx calls made */
+    struct lgw_conf_board_s     board;
+    char                        cal_cache_path[128];
+    bool                        cal_fast;
+    bool                        fw_fast_check;
+    struct lgw_conf_ftime_s     ftime;
+    struct lgw_conf_sx1261_s    sx1261;
+    struct lgw_tx_gain_lut_s    txgain[LGW_RF_CHAIN_NB];
+    struct lgw_conf_rxrf_s      rxrf[LGW_RF_CHAIN_NB];
+    struct lgw_conf_demod_s     demod;
+    struct lgw_conf_rxif_s      rxif[LGW_IF_CHAIN_NB];
+    struct lgw_conf_debug_s     debug;
+};
+
+/* configuration snapshot file: header, HAL configuration, then the forwarder configuration variables */
+struct conf_snap_hdr_s {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;  /* hash of the JSON file and of the build */
+    uint32_t size;  /* size of the data following the header */
+};
+
+struct conf_var_s {
+    void * addr;
+    size_t size;
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
 
@@ -142,12 +283,51 @@ volatile bool quit_sig = false; /* 1 -> application terminates without shutting
 static bool fwd_valid_pkt = true; /* packets with PAYLOAD CRC OK are forwarded */
 static bool fwd_error_pkt = false; /* packets with PAYLOAD CRC ERROR are NOT forwarded */
 static bool fwd_nocrc_pkt = false; /* packets with NO PAYLOAD CRC are NOT forwarded */
+static struct up_filter_s up_filter; /* allowed DevAddr prefixes and JoinEUIs, every packet passes if empty */
+static uint32_t dedup_window_ms = 0; /* copies of an uplink received in that window are dropped, 0 to disable */
+static bool dedup_meta = false; /* add the metadata of the copies dropped to the rxpk of the copy kept */
+static struct up_dedup_s up_dedup; /* only accessed by the upstream thread */
+
+/* uplink coalescing, the packets of several fetches are sent in one datagram, disabled if the delay is 0 */
+static uint32_t coalesce_delay_us = 0; /* longest wait for more packets, from the first one of the datagram */
+static uint32_t coalesce_max_pkt = NB_PKT_MAX; /* the wait ends once that many packets are gathered */
+static uint32_t coalesce_max_bytes = COALESCE_BYTES_DEFAULT; /* no packet is added beyond that estimated rxpk size */
+
+/* upstream encoding */
+static bool push_data_binary = false; /* packets and status are sent as JSON in PUSH_DATA, or in binary in PUSH_DATA_BIN */
+static bool rxpk_latency = false; /* add the host latency of each packet to its JSON rxpk */
+
+/* persistent journal of the datagrams sent to the primary server, disabled if no path is configured */
+static char journal_path[128] = "";
+static uint32_t journal_size = JOURNAL_SIZE_DEFAULT; /* size of the ring of datagrams, in bytes */
+static uint32_t journal_replay_rate = DEFAULT_JOURNAL_REPLAY_RATE; /* datagrams sent again per second, while the server acknowledges */
+static struct journal_s journal; /* only accessed by the upstream thread */
+static struct timespec replay_time = {0, 0}; /* last time a journaled datagram was sent again */
+
+/* metrics endpoint, disabled if not configured */
+static char metrics_endpoint[128] = "";
+static bool metrics_hal_perf = false; /* record the latency of the HAL functions, to be exported */
+static struct metrics_s metrics;
+static struct lgw_com_stats_s metrics_com; /* COM statistics since start, the report reads them since the previous one */
+static uint64_t metrics_rx_fetch = 0; /* RX buffer fetches since start */
+static uint64_t metrics_rx_split = 0;
 
 /* network configuration variables */
 static uint64_t lgwm = 0; /* Lora gateway MAC address */
 static char serv_addr[64] = STR(DEFAULT_SERVER); /* address of the server (host name or IPv4/IPv6) */
 static char serv_port_up[8] = STR(DEFAULT_PORT_UP); /* server port for upstream traffic */
 static char serv_port_down[8] = STR(DEFAULT_PORT_DW); /* server port for downstream traffic */
+
+/* servers receiving the uplinks, the 1st one is the primary server which is also used for downstream traffic */
+struct up_server_s {
+    char addr[64]; /* address of the server (host name or IPv4/IPv6) */
+    char port[8]; /* server port for upstream traffic */
+    struct sockaddr_storage sa; /* resolved address, destination of the PUSH_DATA and origin of the PUSH_ACK */
+    socklen_t sa_len;
+    bool compress; /* the JSON object is sent compressed, in PUSH_DATA_LZ4 */
+};
+static struct up_server_s up_server[UP_SERV_NB_MAX];
+static int up_server_nb = 1;
 static int keepalive_time = DEFAULT_KEEPALIVE; /* send a PULL_DATA request every X seconds, negative = disabled */
 
 /* statistics collection configuration variables */
@@ -163,23 +343,68 @@ static int sock_down; /* socket for downstream traffic */
 
 /* network protocol variables */
 static struct timeval push_timeout_half = {0, (PUSH_TIMEOUT_MS * 500)}; /* cut in half, critical for throughput */
-static struct timeval pull_timeout = {0, (PULL_TIMEOUT_MS * 1000)}; /* non critical for throughput */
+
+/* eventfds waking up the network threads, which only wait on epoll */
+static int exit_fd = -1; /* signaled on exit, never cleared */
+static int report_fd = -1; /* signaled when a new status report is ready for the upstream thread */
+
+/* PUSH_DATA datagrams waiting for their acknowledge, only accessed by the upstream thread */
+struct push_token_s {
+    bool pending;
+    uint8_t server; /* index of the server the datagram was sent to */
+    struct journal_ref_s jrn; /* journal record of the datagram, if any */
+    uint8_t token_h;
+    uint8_t token_l;
+    struct timespec send_time;
+};
+static struct push_token_s push_token[PUSH_TOKEN_NB];
+static int push_token_nb = 0; /* number of pending tokens in the table */
+static bool push_ack_ok = true; /* false once a datagram to the primary server is not acknowledged, until the next PUSH_ACK */
+
+/* TX_ACK datagrams waiting to be sent, only accessed by the downstream thread */
+static uint8_t tx_ack_buff[DOWN_BATCH_NB][ACK_BUFF_SIZE];
+static struct iovec tx_ack_iov[DOWN_BATCH_NB];
+static struct mmsghdr tx_ack_msg[DOWN_BATCH_NB];
+static int tx_ack_nb = 0;
+
+/* TX_ACK tokens of the queued downlinks, to notify the server of the ones flushed from the JiT queues */
+struct down_token_s {
+    bool used;
+    uint8_t rf_chain;
+    uint8_t token_h;
+    uint8_t token_l;
+    uint64_t count_us64; /* timestamp of the downlink in its JiT queue, unique on a TX chain */
+};
+static struct down_token_s down_token[DOWN_TOKEN_NB];
+static int down_token_idx = 0; /* next entry written */
+static pthread_mutex_t mx_down_token = PTHREAD_MUTEX_INITIALIZER; /* written by the downstream thread, read by the fetch thread */
+
+/* downlinks flushed from a JiT queue */
+struct jit_flush_s {
+    int nb_downlink;
+    int nb_beacon;
+    uint64_t count_us64[JIT_QUEUE_SIZE_MAX];
+};
 
 /* hardware access control and correction */
-pthread_mutex_t mx_concent = PTHREAD_MUTEX_INITIALIZER; /* control access to the concentrator */
-static pthread_mutex_t mx_xcorr = PTHREAD_MUTEX_INITIALIZER; /* control access to the XTAL correction */
+static struct concent_s concent; /* control access to the concentrator, by a mutex or by the command thread */
+static bool concent_thread = false; /* the concentrator is owned by the command thread, which serves the requests by priority */
+static uint32_t seq_xcorr = 0; /* sequence counter publishing the XTAL correction, only written by the validation thread */
 static bool xtal_correct_ok = false; /* set true when XTAL correction is stable enough */
 static double xtal_correct = 1.0;
 
 /* GPS configuration and synchronization */
 static char gps_tty_path[64] = "\0"; /* path of the TTY port GPS is connected on */
 static int gps_tty_fd = -1; /* file descriptor of the GPS TTY port */
+static bool gps_nmea_enabled = true; /* decode NMEA sentences, or only the UBX time messages */
 static bool gps_enabled = false; /* is GPS enabled on that gateway ? */
 
 /* GPS time reference */
-static pthread_mutex_t mx_timeref = PTHREAD_MUTEX_INITIALIZER; /* control access to GPS time reference */
+static pthread_mutex_t mx_timeref = PTHREAD_MUTEX_INITIALIZER; /* serialize the writers of GPS time reference (GPS and validation threads) */
+static uint32_t seq_timeref = 0; /* sequence counter publishing GPS time reference, readers never lock */
 static bool gps_ref_valid; /* is GPS reference acceptable (ie. not too old) */
 static struct tref time_reference_gps; /* time reference used for GPS <-> timestamp conversion */
+static struct lgw_clock_s gps_clock; /* offset and drift estimator of the concentrator clock, written under mx_timeref */
 
 /* Reference coordinates, for broadcasting (beacon) */
 static struct coord_s reference_coord;
@@ -187,34 +412,67 @@ static struct coord_s reference_coord;
 /* Enable faking the GPS coordinates of the gateway */
 static bool gps_fake_enable; /* enable the feature */
 
-/* measurements to establish statistics */
-static pthread_mutex_t mx_meas_up = PTHREAD_MUTEX_INITIALIZER; /* control access to the upstream measurements */
-static uint32_t meas_nb_rx_rcv = 0; /* count packets received */
-static uint32_t meas_nb_rx_ok = 0; /* count packets received with PAYLOAD CRC OK */
-static uint32_t meas_nb_rx_bad = 0; /* count packets received with PAYLOAD CRC ERROR */
-static uint32_t meas_nb_rx_nocrc = 0; /* count packets received with NO PAYLOAD CRC */
-static uint32_t meas_up_pkt_fwd = 0; /* number of radio packet forwarded to the server */
-static uint32_t meas_up_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_up_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_up_dgram_sent = 0; /* number of datagrams sent for upstream traffic */
-static uint32_t meas_up_ack_rcv = 0; /* number of datagrams acknowledged for upstream traffic */
-
-static pthread_mutex_t mx_meas_dw = PTHREAD_MUTEX_INITIALIZER; /* control access to the downstream measurements */
-static uint32_t meas_dw_pull_sent = 0; /* number of PULL requests sent for downstream traffic */
-static uint32_t meas_dw_ack_rcv = 0; /* number of PULL requests acknowledged for downstream traffic */
-static uint32_t meas_dw_dgram_rcv = 0; /* count PULL response packets received for downstream traffic */
-static uint32_t meas_dw_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_dw_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_nb_tx_ok = 0; /* count packets emitted successfully */
-static uint32_t meas_nb_tx_fail = 0; /* count packets were TX failed for other reasons */
-static uint32_t meas_nb_tx_requested = 0; /* count TX request from server (downlinks) */
-static uint32_t meas_nb_tx_rejected_collision_packet = 0; /* count packets were TX request were rejected due to collision with another packet already programmed */
-static uint32_t meas_nb_tx_rejected_collision_beacon = 0; /* count packets were TX request were rejected due to collision with a beacon already programmed */
-static uint32_t meas_nb_tx_rejected_too_late = 0; /* count packets were TX request were rejected because it is too late to program it */
-static uint32_t meas_nb_tx_rejected_too_early = 0; /* count packets were TX request were rejected because timestamp is too much in advance */
-static uint32_t meas_nb_beacon_queued = 0; /* count beacon inserted in jit queue */
-static uint32_t meas_nb_beacon_sent = 0; /* count beacon actually sent to concentrator */
-static uint32_t meas_nb_beacon_rejected = 0; /* count beacon rejected for queuing */
+/* measurements to establish statistics, each group is only written by one thread */
+/* the counters are never reset, the main thread reads them without lock and reports the increase since the previous report */
+#define MEAS_ADD(cnt, val)  __atomic_store_n(&(cnt), __atomic_load_n(&(cnt), __ATOMIC_RELAXED) + (val), __ATOMIC_RELAXED) /* single writer, no locked instruction */
+#define MEAS_SET(cnt, val)  __atomic_store_n(&(cnt), (val), __ATOMIC_RELAXED)
+
+struct meas_up_s { /* written by the upstream thread */
+    uint32_t rx_rcv; /* count packets received */
+    uint32_t rx_ok; /* count packets received with PAYLOAD CRC OK */
+    uint32_t rx_bad; /* count packets received with PAYLOAD CRC ERROR */
+    uint32_t rx_nocrc; /* count packets received with NO PAYLOAD CRC */
+    uint32_t rx_drop_devaddr; /* count data uplinks dropped by the DevAddr/NetID filter */
+    uint32_t rx_drop_join_eui; /* count join requests dropped by the JoinEUI filter */
+    uint32_t rx_drop_dup; /* count copies of uplinks dropped by the de-duplication */
+    uint32_t pkt_fwd; /* number of radio packet forwarded to the server */
+    uint32_t network_byte; /* sum of UDP bytes sent for upstream traffic */
+    uint32_t payload_byte; /* sum of radio payload bytes sent for upstream traffic */
+    uint32_t dgram_sent; /* number of datagrams sent for upstream traffic */
+    uint32_t ack_rcv[UP_SERV_NB_MAX]; /* number of datagrams acknowledged for upstream traffic, per server */
+    uint32_t jrn_replayed; /* number of journaled datagrams sent again */
+    uint32_t lz4_in_byte; /* sum of JSON bytes compressed in PUSH_DATA_LZ4 */
+    uint32_t lz4_out_byte; /* sum of the compressed sizes */
+    uint32_t jrn_backlog; /* current number of journaled datagrams waiting to be sent again */
+    uint32_t jrn_dropped; /* number of journaled datagrams overwritten before being acknowledged */
+    uint32_t lat_hist[UP_LAT_NB][UP_LAT_BIN_NB]; /* latency histogram of the forwarded packets, per stage */
+    uint32_t ack_rtt_hist[UP_SERV_NB_MAX][UP_LAT_BIN_NB]; /* histogram of the PUSH_ACK round-trip times, per server */
+} __attribute__((aligned(64))); /* one cache line per writer thread */
+
+static const char * const up_lat_str[UP_LAT_NB] = { "parse", "queue", "serial", "send", "total" };
+
+struct meas_dw_s { /* written by the downstream thread */
+    uint32_t pull_sent; /* number of PULL requests sent for downstream traffic */
+    uint32_t ack_rcv; /* number of PULL requests acknowledged for downstream traffic */
+    uint32_t dgram_rcv; /* count PULL response packets received for downstream traffic */
+    uint32_t network_byte; /* sum of UDP bytes received for downstream traffic */
+    uint32_t payload_byte; /* sum of radio payload bytes received for downstream traffic */
+    uint32_t tx_requested; /* count TX request from server (downlinks) */
+    uint32_t tx_rejected_collision_packet; /* count packets were TX request were rejected due to collision with another packet already programmed */
+    uint32_t tx_rejected_collision_beacon; /* count packets were TX request were rejected due to collision with a beacon already programmed */
+    uint32_t tx_rejected_too_late; /* count packets were TX request were rejected because it is too late to program it */
+    uint32_t tx_rejected_too_early; /* count packets were TX request were rejected because timestamp is too much in advance */
+    uint32_t tx_rejected_admission; /* count packets among the rejected ones, rejected before their payload was decoded */
+} __attribute__((aligned(64)));
+
+struct meas_bcn_s { /* written by the beacon thread */
+    uint32_t beacon_queued; /* count beacon inserted in jit queue */
+    uint32_t beacon_rejected; /* count beacon rejected for queuing */
+} __attribute__((aligned(64)));
+
+struct meas_jit_s { /* written by the JIT thread */
+    uint32_t tx_ok; /* count packets emitted successfully */
+    uint32_t tx_fail; /* count packets were TX failed for other reasons */
+    uint32_t tx_late; /* count packets handed to the concentrator less than JIT_TX_LATE_US before their emission */
+    uint32_t beacon_sent; /* count beacon actually sent to concentrator */
+    uint32_t wakeup_late; /* count wake-ups of the JIT thread more than JIT_WAKEUP_LATE_US after their deadline */
+    uint32_t wakeup_late_max_us; /* longest delay of a wake-up after its deadline */
+} __attribute__((aligned(64)));
+
+static struct meas_up_s meas_up;
+static struct meas_dw_s meas_dw;
+static struct meas_jit_s meas_jit;
+static struct meas_bcn_s meas_bcn;
 
 static pthread_mutex_t mx_meas_gps = PTHREAD_MUTEX_INITIALIZER; /* control access to the GPS statistics */
 static bool gps_coord_valid; /* could we get valid GPS coordinates ? */
@@ -224,6 +482,7 @@ static struct coord_s meas_gps_err; /* GPS position of the gateway */
 static pthread_mutex_t mx_stat_rep = PTHREAD_MUTEX_INITIALIZER; /* control access to the status report */
 static bool report_ready = false; /* true when there is a new report to send to the server */
 static char status_report[STATUS_SIZE]; /* status report as a JSON object */
+static uint8_t status_report_bin[STAT_BIN_SIZE]; /* status report as a binary block */
 
 /* beacon parameters */
 static uint32_t beacon_period = 0; /* set beaconing period, must be a sub-multiple of 86400, the nb of sec in a day */
@@ -235,11 +494,26 @@ static uint32_t beacon_bw_hz = DEFAULT_BEACON_BW_HZ; /* set beacon bandwidth, in
 static int8_t beacon_power = DEFAULT_BEACON_POWER; /* set beacon TX power, in dBm */
 static uint8_t beacon_infodesc = DEFAULT_BEACON_INFODESC; /* set beacon information descriptor */
 
+/* beacon frames, only accessed by the beacon thread */
+static struct lgw_pkt_tx_s beacon_template; /* modulation and constant fields, common to all beacons */
+static uint8_t beacon_time_idx; /* index of the time field in the payload, followed by its CRC */
+static struct lgw_pkt_tx_s beacon_ring[BEACON_PREPARE_NB]; /* frames built ahead, in the order they are to be sent */
+static uint32_t beacon_ring_gps[BEACON_PREPARE_NB]; /* GPS time of each prepared frame */
+
 /* auto-quit function */
 static uint32_t autoquit_threshold = 0; /* enable auto-quit after a number of non-acknowledged PULL_DATA (0 = disabled)*/
 
 /* Just In Time TX scheduling */
 static struct jit_queue_s jit_queue[LGW_RF_CHAIN_NB];
+static uint16_t jit_queue_size = JIT_QUEUE_SIZE_DEFAULT; /* number of packets each JIT queue can hold */
+static sem_t jit_wakeup; /* posted when a packet is enqueued or on a signal, to wake up the JIT thread before its deadline */
+static struct jit_airtime_band_s airtime_band[JIT_AIRTIME_BAND_NB_MAX]; /* sub-bands with a duty cycle limit */
+static int airtime_band_nb = 0;
+
+/* Uplink packets, from the fetch thread to the upstream thread, by reference to descriptors of the pool */
+static struct rx_queue_s rx_queue;
+static struct pkt_pool_s pkt_pool;
+static uint32_t fetch_poll_max_ms = FETCH_POLL_MAX_MS; /* longest time between checks of the RX buffer while idle */
 
 /* Gateway specificities */
 static int8_t antenna_gain = 0;
@@ -260,7 +534,13 @@ static uint32_t nb_pkt_received_ref[16];
 /* Interface type */
 static lgw_com_type_t com_type = LGW_COM_SPI;
 
+/* Threads scheduling */
+static const char * const thread_name[THREAD_NB] = { "fetch", "up", "down", "jit", "gps", "valid", "beacon", "spectral_scan", "concent" };
+static struct thread_conf_s thread_conf[THREAD_NB]; /* all SCHED_OTHER (0), on all CPUs */
+static bool mem_lock = false; /* lock the memory of the process, to never wait for a page fault */
+
 /* Spectral Scan */
+static bool spectral_scan_busy = false; /* the SX1261 is scanning, only accessed by the concentrator requests */
 static spectral_scan_t spectral_scan_params = {
     .enable = false,
     .freq_hz_start = 0,
@@ -268,6 +548,29 @@ static spectral_scan_t spectral_scan_params = {
     .nb_scan = 0,
     .pace_s = 10
 };
+static pthread_mutex_t mx_spectral = PTHREAD_MUTEX_INITIALIZER; /* control access to the spectral scan aggregator */
+static struct lgw_spectral_agg_s spectral_agg; /* rolling histograms of the scanned frequencies */
+
+/* Configuration snapshot */
+static struct conf_snap_hal_s conf_snap; /* filled while parsing the JSON file */
+
+#define CONF_VAR(v) { &(v), sizeof (v) }
+static const struct conf_var_s conf_vars[] = { /* every variable set by the JSON parsing functions */
+    CONF_VAR(com_type), CONF_VAR(antenna_gain), CONF_VAR(txlut), CONF_VAR(tx_freq_min), CONF_VAR(tx_freq_max),
+    CONF_VAR(tx_enable), CONF_VAR(spectral_scan_params), CONF_VAR(debugconf),
+    CONF_VAR(lgwm), CONF_VAR(serv_addr), CONF_VAR(serv_port_up), CONF_VAR(serv_port_down),
+    CONF_VAR(up_server), CONF_VAR(up_server_nb), CONF_VAR(keepalive_time), CONF_VAR(stat_interval),
+    CONF_VAR(push_timeout_half), CONF_VAR(fwd_valid_pkt), CONF_VAR(fwd_error_pkt), CONF_VAR(fwd_nocrc_pkt),
+    CONF_VAR(push_data_binary), CONF_VAR(rxpk_latency), CONF_VAR(journal_path), CONF_VAR(journal_size),
+    CONF_VAR(journal_replay_rate), CONF_VAR(gps_tty_path), CONF_VAR(gps_nmea_enabled), CONF_VAR(reference_coord),
+    CONF_VAR(gps_fake_enable), CONF_VAR(beacon_period), CONF_VAR(beacon_freq_hz), CONF_VAR(beacon_freq_nb),
+    CONF_VAR(beacon_freq_step), CONF_VAR(beacon_datarate), CONF_VAR(beacon_bw_hz), CONF_VAR(beacon_power),
+    CONF_VAR(beacon_infodesc), CONF_VAR(autoquit_threshold), CONF_VAR(jit_queue_size), CONF_VAR(fetch_poll_max_ms),
+    CONF_VAR(thread_conf), CONF_VAR(mem_lock), CONF_VAR(concent_thread), CONF_VAR(up_filter),
+    CONF_VAR(dedup_window_ms), CONF_VAR(dedup_meta), CONF_VAR(airtime_band), CONF_VAR(airtime_band_nb),
+    CONF_VAR(coalesce_delay_us), CONF_VAR(coalesce_max_pkt), CONF_VAR(coalesce_max_bytes),
+    CONF_VAR(metrics_endpoint), CONF_VAR(metrics_hal_perf)
+};
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
@@ -282,23 +585,129 @@ static int parse_gateway_configuration(const char * conf_file);
 
 static int parse_debug_configuration(const char * conf_file);
 
-static uint16_t crc16(const uint8_t * data, unsigned size);
+static int parse_thread_configuration(JSON_Object * conf_obj);
+
+static int parse_uplink_filter(JSON_Object * conf_obj);
+
+static int parse_duty_cycle(JSON_Array * conf_array);
+
+static void thread_sched_apply(pthread_t thrid, int thread);
+
+static uint64_t fnv1a_64(uint64_t h, const void * data, size_t size);
+
+static int conf_snap_hash(const char * conf_file, uint64_t * hash);
+
+static size_t conf_snap_size(void);
+
+static int conf_snap_apply(struct conf_snap_hal_s * snap);
+
+static int conf_snap_load(const char * snap_file, uint64_t hash);
+
+static void conf_snap_save(const char * snap_file, uint64_t hash);
+
 
 static double difftimespec(struct timespec end, struct timespec beginning);
 
+static void meas_snapshot(void * dst, const void * src, size_t size);
+
+static void up_lat_add(uint32_t * hist, int64_t start_ns, int64_t end_ns);
+
+static uint32_t up_lat_bound(const uint32_t * hist, float ratio);
+
+static void seq_write_begin(uint32_t * seq);
+
+static void seq_write_end(uint32_t * seq);
+
+static uint32_t seq_read_begin(const uint32_t * seq);
+
+static bool seq_read_retry(const uint32_t * seq, uint32_t start);
+
+static void timeref_get(bool * valid, struct tref * ref);
+
+static void xcorr_get(bool * ok, double * correct);
+
 static void gps_process_sync(void);
 
 static void gps_process_coords(void);
 
-static int get_tx_gain_lut_index(uint8_t rf_chain, int8_t rf_power, uint8_t * lut_index);
+static int up_server_find(const struct sockaddr_storage * sa);
+
+static void push_ack_register(uint8_t server, uint8_t token_h, uint8_t token_l, struct timespec send_time, struct journal_ref_s jrn);
+
+static void push_ack_timeout(int slot);
+
+static double push_ack_delay_max(void);
+
+static int push_ack_process(void);
+
+static int rxpk_size_max(const struct lgw_pkt_rx_s * p);
+
+static int up_coalesce(struct lgw_pkt_rx_s ** pkt, int nb_pkt, int64_t start_ns, struct lgw_pkt_rx_s ** carry);
+
+static void push_data_replay(void);
+
+static int up_wait_timeout_ms(void);
+
+static int net_epoll_create(const int * fd, int nb_fd);
+
+static void print_com_stats(const struct lgw_com_stats_s * stats);
+
+static void hist_u64(uint64_t * dst, const uint32_t * src, int nb);
+
+static void metrics_update(const struct meas_up_s * up, const struct meas_dw_s * dw, const struct meas_jit_s * jit, const struct meas_bcn_s * bcn, const struct lgw_com_stats_s * com, const struct lgw_rx_stats_s * rx);
+
+static void get_concentrator_time(uint64_t * count_us);
+
+static void jit_wait(uint32_t timeout_us);
+
+static uint32_t beacon_freq_correct(uint32_t freq_hz);
+
+static void beacon_template_init(void);
+
+static void beacon_prepare(struct lgw_pkt_tx_s * pkt, uint32_t gps_sec);
+
+static void put_le16(uint8_t * buf, uint16_t val);
+
+static int x10_round(int16_t val);
+
+static void put_le32(uint8_t * buf, uint32_t val);
+
+static void put_le64(uint8_t * buf, uint64_t val);
+
+static int rxpk_serialize_bin(uint8_t * buf, const struct lgw_pkt_rx_s * p, const struct timespec * utc, const struct timespec * gps_time);
+
+static int utc_to_iso8601(char * out, const struct timespec * utc);
+
+static void rxpk_log(const struct lgw_pkt_rx_s * p);
+
+static int tx_ack_format(uint8_t * buff_ack, uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value);
+
+static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value);
+
+static void flush_tx_ack(void);
+
+static void down_token_add(uint8_t rf_chain, uint64_t count_us64, uint8_t token_h, uint8_t token_l);
+
+static void jit_flush_collect(const struct lgw_pkt_tx_s * pkt, enum jit_pkt_type_e pkt_type, void * arg);
+
+static void downlinks_flush(void);
+
+static void timeref_reset(void);
+
+static bool concentrator_recover(void);
+
+static bool spectral_scan_window(uint32_t duration_us);
 
 /* threads */
+void thread_fetch(void);
 void thread_up(void);
 void thread_down(void);
 void thread_jit(void);
 void thread_gps(void);
 void thread_valid(void);
+void thread_beacon(void);
 void thread_spectral_scan(void);
+void thread_concent(void);
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
@@ -310,15 +719,24 @@ static void usage( void )
     printf("~~~ Available options ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
     printf(" -h  print this help\n");
     printf(" -c <filename>  use config file other than 'global_conf.json'\n");
+    printf(" -s <filename>  load the configuration from this binary snapshot if it matches the config file, write it otherwise\n");
     printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
 }
 
 static void sig_handler(int sigio) {
+    uint64_t one = 1;
+    ssize_t n;
+
     if (sigio == SIGQUIT) {
         quit_sig = true;
     } else if ((sigio == SIGINT) || (sigio == SIGTERM)) {
         exit_sig = true;
     }
+    sem_post(&jit_wakeup); /* async-signal-safe, do not wait for the JIT thread deadline */
+    if (exit_fd >= 0) {
+        n = write(exit_fd, &one, sizeof one); /* async-signal-safe, wakes up the network threads */
+        (void)n;
+    }
     return;
 }
 
@@ -376,8 +794,10 @@ static int parse_SX130x_configuration(const char * conf_file) {
         boardconf.com_type = LGW_COM_SPI;
     } else if (!strncmp(str, "USB", 3) || !strncmp(str, "usb", 3)) {
         boardconf.com_type = LGW_COM_USB;
+    } else if (!strncmp(str, "SIM", 3) || !strncmp(str, "sim", 3)) {
+        boardconf.com_type = LGW_COM_SIM; /* com_path holds the traffic profile, see loragw_sim.h */
     } else {
-        MSG("ERROR: invalid com type: %s (should be SPI or USB)\n", str);
+        MSG("ERROR: invalid com type: %s (should be SPI, USB or SIM)\n", str);
         return -1;
     }
     com_type = boardconf.com_type;
@@ -410,12 +830,49 @@ static int parse_SX130x_configuration(const char * conf_file) {
         MSG("WARNING: Data type for full_duplex seems wrong, please check\n");
         boardconf.full_duplex = false;
     }
-    MSG("INFO: com_type %s, com_path %s, lorawan_public %d, clksrc %d, full_duplex %d\n", (boardconf.com_type == LGW_COM_SPI) ? "SPI" : "USB", boardconf.com_path, boardconf.lorawan_public, boardconf.clksrc, boardconf.full_duplex);
+    MSG("INFO: com_type %s, com_path %s, lorawan_public %d, clksrc %d, full_duplex %d\n", (boardconf.com_type == LGW_COM_SPI) ? "SPI" : ((boardconf.com_type == LGW_COM_USB) ? "USB" : "SIM"), boardconf.com_path, boardconf.lorawan_public, boardconf.clksrc, boardconf.full_duplex);
     /* all parameters parsed, submitting configuration to the HAL */
     if (lgw_board_setconf(&boardconf) != LGW_HAL_SUCCESS) {
         MSG("ERROR: Failed to configure board\n");
         return -1;
     }
+    conf_snap.board = boardconf;
+
+    /* set calibration cache configuration (sx1255/sx1257 radios only) */
+    str = json_object_get_string(conf_obj, "cal_cache_path");
+    if (str != NULL) {
+        if (lgw_cal_cache_set_path(str) != LGW_HAL_SUCCESS) {
+            MSG("ERROR: Failed to set calibration cache path\n");
+            return -1;
+        }
+        if (strlen(str) < sizeof conf_snap.cal_cache_path) {
+            strcpy(conf_snap.cal_cache_path, str);
+            conf_snap.set |= CONF_SNAP_CAL_PATH;
+        }
+        MSG("INFO: cal_cache_path %s\n", str);
+    }
+    val = json_object_get_value(conf_obj, "cal_fast"); /* fetch value (if possible) */
+    if (val != NULL) {
+        if (json_value_get_type(val) == JSONBoolean) {
+            lgw_cal_set_fast_mode((bool)json_value_get_boolean(val));
+            conf_snap.cal_fast = (bool)json_value_get_boolean(val);
+            conf_snap.set |= CONF_SNAP_CAL_FAST;
+            MSG("INFO: cal_fast %d\n", json_value_get_boolean(val));
+        } else {
+            MSG("WARNING: Data type for cal_fast seems wrong, please check\n");
+        }
+    }
+    val = json_object_get_value(conf_obj, "fw_fast_check"); /* fetch value (if possible) */
+    if (val != NULL) {
+        if (json_value_get_type(val) == JSONBoolean) {
+            lgw_fw_set_fast_check((bool)json_value_get_boolean(val));
+            conf_snap.fw_fast_check = (bool)json_value_get_boolean(val);
+            conf_snap.set |= CONF_SNAP_FW_FAST;
+            MSG("INFO: fw_fast_check %d\n", json_value_get_boolean(val));
+        } else {
+            MSG("WARNING: Data type for fw_fast_check seems wrong, please check\n");
+        }
+    }
 
     /* set antenna gain configuration */
     val = json_object_get_value(conf_obj, "antenna_gain"); /* fetch value (if possible) */
@@ -461,6 +918,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
                 MSG("ERROR: Failed to configure fine timestamp\n");
                 return -1;
             }
+            conf_snap.ftime = tsconf;
+            conf_snap.set |= CONF_SNAP_FTIME;
         } else {
             MSG("INFO: Configuring legacy timestamp\n");
         }
@@ -648,6 +1107,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
             MSG("ERROR: Failed to configure the SX1261 radio\n");
             return -1;
         }
+        conf_snap.sx1261 = sx1261conf;
+        conf_snap.set |= CONF_SNAP_SX1261;
     }
 
     /* set configuration for RF chains */
@@ -804,6 +1265,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
                                 MSG("ERROR: Failed to configure concentrator TX Gain LUT for rf_chain %u\n", i);
                                 return -1;
                             }
+                            conf_snap.txgain[i] = txlut[i];
+                            conf_snap.set |= CONF_SNAP_TXGAIN(i);
                         } else {
                             MSG("WARNING: No TX gain LUT defined for rf_chain %u\n", i);
                         }
@@ -821,6 +1284,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
             MSG("ERROR: invalid configuration for radio %i\n", i);
             return -1;
         }
+        conf_snap.rxrf[i] = rfconf;
+        conf_snap.set |= CONF_SNAP_RXRF(i);
     }
 
     /* set configuration for demodulators */
@@ -851,6 +1316,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
             MSG("ERROR: invalid configuration for demodulation parameters\n");
             return -1;
         }
+        conf_snap.demod = demodconf;
+        conf_snap.set |= CONF_SNAP_DEMOD;
     }
 
     /* set configuration for Lora multi-SF channels (bandwidth cannot be set) */
@@ -885,6 +1352,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
             MSG("ERROR: invalid configuration for Lora multi-SF channel %i\n", i);
             return -1;
         }
+        conf_snap.rxif[i] = ifconf;
+        conf_snap.set |= CONF_SNAP_RXIF(i);
     }
 
     /* set configuration for Lora standard channel */
@@ -959,6 +1428,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
             MSG("ERROR: invalid configuration for Lora standard channel\n");
             return -1;
         }
+        conf_snap.rxif[8] = ifconf;
+        conf_snap.set |= CONF_SNAP_RXIF(8);
     }
 
     /* set configuration for FSK channel */
@@ -1004,6 +1475,8 @@ static int parse_SX130x_configuration(const char * conf_file) {
             MSG("ERROR: invalid configuration for FSK channel\n");
             return -1;
         }
+        conf_snap.rxif[9] = ifconf;
+        conf_snap.set |= CONF_SNAP_RXIF(9);
     }
     json_value_free(root_val);
 
@@ -1015,8 +1488,12 @@ static int parse_gateway_configuration(const char * conf_file) {
     JSON_Value *root_val;
     JSON_Object *conf_obj = NULL;
     JSON_Value *val = NULL; /* needed to detect the absence of some fields */
+    JSON_Array *conf_array = NULL;
+    JSON_Object *serv_obj = NULL;
+    JSON_Object *coal_obj = NULL;
     const char *str; /* pointer to sub-strings in the JSON data */
     unsigned long long ull = 0;
+    int i;
 
     /* try to parse JSON */
     root_val = json_parse_file_with_comments(conf_file);
@@ -1062,6 +1539,31 @@ static int parse_gateway_configuration(const char * conf_file) {
         MSG("INFO: downstream port is configured to \"%s\"\n", serv_port_down);
     }
 
+    /* additional servers receiving a copy of the uplinks (optional) */
+    conf_array = json_object_get_array(conf_obj, "extra_servers");
+    if (conf_array != NULL) {
+        up_server_nb = 1;
+        for (i = 0; i < (int)json_array_get_count(conf_array); i++) {
+            if (up_server_nb == UP_SERV_NB_MAX) {
+                MSG("WARNING: only %d extra servers can be configured, ignoring the others\n", UP_SERV_NB_MAX - 1);
+                break;
+            }
+            serv_obj = json_array_get_object(conf_array, i);
+            str = json_object_get_string(serv_obj, "server_address");
+            val = json_object_get_value(serv_obj, "serv_port_up");
+            if ((str == NULL) || (val == NULL) || (json_value_get_type(val) != JSONNumber)) {
+                MSG("ERROR: extra server %d must define \"server_address\" and \"serv_port_up\"\n", i);
+                exit(EXIT_FAILURE);
+            }
+            strncpy(up_server[up_server_nb].addr, str, sizeof up_server[up_server_nb].addr);
+            up_server[up_server_nb].addr[sizeof up_server[up_server_nb].addr - 1] = '\0'; /* ensure string termination */
+            snprintf(up_server[up_server_nb].port, sizeof up_server[up_server_nb].port, "%u", (uint16_t)json_value_get_number(val));
+            up_server[up_server_nb].compress = (json_object_get_boolean(serv_obj, "push_compress") == 1);
+            MSG("INFO: uplinks are also forwarded to \"%s\", port \"%s\"%s\n", up_server[up_server_nb].addr, up_server[up_server_nb].port, (up_server[up_server_nb].compress ? ", compressed" : ""));
+            up_server_nb += 1;
+        }
+    }
+
     /* get keep-alive interval (in seconds) for downstream (optional) */
     val = json_object_get_value(conf_obj, "keepalive_interval");
     if (val != NULL) {
@@ -1100,6 +1602,108 @@ static int parse_gateway_configuration(const char * conf_file) {
     }
     MSG("INFO: packets received with no CRC will%s be forwarded\n", (fwd_nocrc_pkt ? "" : " NOT"));
 
+    /* uplinks de-duplication (optional) */
+    val = json_object_get_value(conf_obj, "dedup_window_ms");
+    if (json_value_get_type(val) == JSONNumber) {
+        dedup_window_ms = (uint32_t)json_value_get_number(val);
+    }
+    val = json_object_get_value(conf_obj, "dedup_meta");
+    if (json_value_get_type(val) == JSONBoolean) {
+        dedup_meta = (bool)json_value_get_boolean(val);
+    }
+    if (dedup_window_ms > 0) {
+        MSG("INFO: copies of an uplink received within %u ms are dropped, their metadata is%s forwarded\n", dedup_window_ms, (dedup_meta ? "" : " NOT"));
+    }
+
+    /* uplinks coalescing (optional) */
+    coal_obj = json_object_get_object(conf_obj, "push_coalesce");
+    if (coal_obj != NULL) {
+        val = json_object_get_value(coal_obj, "delay_us");
+        if (json_value_get_type(val) == JSONNumber) {
+            coalesce_delay_us = (uint32_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(coal_obj, "max_pkt");
+        if (json_value_get_type(val) == JSONNumber) {
+            coalesce_max_pkt = (uint32_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(coal_obj, "max_bytes");
+        if (json_value_get_type(val) == JSONNumber) {
+            coalesce_max_bytes = (uint32_t)json_value_get_number(val);
+        }
+        if ((coalesce_delay_us > 1000000) || (coalesce_max_pkt < 1) || (coalesce_max_pkt > NB_PKT_MAX)) {
+            MSG("ERROR: push_coalesce.delay_us must be at most 1000000, and max_pkt between 1 and %d\n", NB_PKT_MAX);
+            json_value_free(root_val);
+            return -1;
+        }
+    }
+    if (coalesce_delay_us > 0) {
+        MSG("INFO: uplinks are coalesced for up to %u us, %u packets or %u bytes per datagram\n", coalesce_delay_us, coalesce_max_pkt, coalesce_max_bytes);
+    }
+
+    /* uplinks filtering on their LoRaWAN header (optional) */
+    if (parse_uplink_filter(json_object_get_object(conf_obj, "uplink_filter")) != 0) {
+        json_value_free(root_val);
+        return -1;
+    }
+
+    /* upstream encoding (optional) */
+    val = json_object_get_value(conf_obj, "push_data_binary");
+    if (json_value_get_type(val) == JSONBoolean) {
+        push_data_binary = (bool)json_value_get_boolean(val);
+    }
+    MSG("INFO: upstream packets will be sent %s\n", (push_data_binary ? "in binary (PUSH_DATA_BIN)" : "as JSON (PUSH_DATA)"));
+    val = json_object_get_value(conf_obj, "push_compress");
+    if (json_value_get_type(val) == JSONBoolean) {
+        up_server[0].compress = (bool)json_value_get_boolean(val);
+    }
+    for (i = 0; i < up_server_nb; i++) {
+        if ((up_server[i].compress == true) && (push_data_binary == true)) {
+            MSG("WARNING: only the JSON object can be compressed, PUSH_DATA_BIN is sent to all the servers\n");
+            up_server[i].compress = false;
+        }
+    }
+    if (up_server[0].compress == true) {
+        MSG("INFO: the JSON object is sent compressed to the primary server (PUSH_DATA_LZ4)\n");
+    }
+    val = json_object_get_value(conf_obj, "rxpk_latency");
+    if (json_value_get_type(val) == JSONBoolean) {
+        rxpk_latency = (bool)json_value_get_boolean(val);
+    }
+    if (rxpk_latency == true) {
+        MSG("INFO: the host latency of each packet will be added to its JSON rxpk\n");
+    }
+
+    /* persistent journal of the upstream datagrams (optional) */
+    str = json_object_get_string(conf_obj, "journal_path");
+    if (str != NULL) {
+        strncpy(journal_path, str, sizeof journal_path);
+        journal_path[sizeof journal_path - 1] = '\0'; /* ensure string termination */
+        val = json_object_get_value(conf_obj, "journal_size");
+        if (val != NULL) {
+            journal_size = (uint32_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(conf_obj, "journal_replay_rate");
+        if (val != NULL) {
+            journal_replay_rate = (uint32_t)json_value_get_number(val);
+            if (journal_replay_rate < 1) {
+                journal_replay_rate = 1;
+            }
+        }
+        MSG("INFO: upstream datagrams are journaled in %s (%u bytes), and sent again at %u datagrams/s\n", journal_path, journal_size, journal_replay_rate);
+    }
+
+    /* metrics endpoint (optional) */
+    str = json_object_get_string(conf_obj, "metrics_endpoint");
+    if (str != NULL) {
+        strncpy(metrics_endpoint, str, sizeof metrics_endpoint);
+        metrics_endpoint[sizeof metrics_endpoint - 1] = '\0'; /* ensure string termination */
+        val = json_object_get_value(conf_obj, "metrics_hal_perf");
+        if (json_value_get_type(val) == JSONBoolean) {
+            metrics_hal_perf = (bool)json_value_get_boolean(val);
+        }
+        MSG("INFO: metrics are served on %s, refreshed every %u seconds%s\n", metrics_endpoint, stat_interval, (metrics_hal_perf == true) ? ", with the HAL latencies" : "");
+    }
+
     /* GPS module TTY path (optional) */
     str = json_object_get_string(conf_obj, "gps_tty_path");
     if (str != NULL) {
@@ -1108,6 +1712,15 @@ static int parse_gateway_configuration(const char * conf_file) {
         MSG("INFO: GPS serial port path is configured to \"%s\"\n", gps_tty_path);
     }
 
+    /* GPS NMEA decoding, not needed for synchronization (optional) */
+    val = json_object_get_value(conf_obj, "gps_nmea");
+    if (json_value_get_type(val) == JSONBoolean) {
+        gps_nmea_enabled = (bool)json_value_get_boolean(val);
+        if (gps_nmea_enabled == false) {
+            MSG("INFO: GPS NMEA sentences are not decoded, no GPS coordinates\n");
+        }
+    }
+
     /* get reference coordinates */
     val = json_object_get_value(conf_obj, "ref_latitude");
     if (val != NULL) {
@@ -1204,11 +1817,207 @@ static int parse_gateway_configuration(const char * conf_file) {
         MSG("INFO: Auto-quit after %u non-acknowledged PULL_DATA\n", autoquit_threshold);
     }
 
+    /* JIT queue size (optional) */
+    val = json_object_get_value(conf_obj, "jit_queue_size");
+    if (val != NULL) {
+        if ((json_value_get_number(val) < 1) || (json_value_get_number(val) > JIT_QUEUE_SIZE_MAX)) {
+            MSG("ERROR: jit_queue_size must be between 1 and %d\n", JIT_QUEUE_SIZE_MAX);
+            json_value_free(root_val);
+            return -1;
+        }
+        jit_queue_size = (uint16_t)json_value_get_number(val);
+        MSG("INFO: JIT queues can hold %u packets\n", jit_queue_size);
+    }
+
+    /* duty cycle of the TX sub-bands (optional) */
+    if (parse_duty_cycle(json_object_get_array(conf_obj, "duty_cycle")) != 0) {
+        json_value_free(root_val);
+        return -1;
+    }
+
+    /* RX buffer polling back-off while idle (optional) */
+    val = json_object_get_value(conf_obj, "fetch_poll_max_ms");
+    if (val != NULL) {
+        if ((json_value_get_number(val) < 1) || (json_value_get_number(val) > FETCH_POLL_LIMIT_MS)) {
+            MSG("ERROR: fetch_poll_max_ms must be between 1 and %d\n", FETCH_POLL_LIMIT_MS);
+            json_value_free(root_val);
+            return -1;
+        }
+        fetch_poll_max_ms = (uint32_t)json_value_get_number(val);
+        MSG("INFO: RX buffer checked every %u ms at most while idle\n", fetch_poll_max_ms);
+    }
+
+    /* threads scheduling and memory locking (optional) */
+    if (parse_thread_configuration(json_object_get_object(conf_obj, "thread_conf")) != 0) {
+        json_value_free(root_val);
+        return -1;
+    }
+
     /* free JSON parsing data structure */
     json_value_free(root_val);
     return 0;
 }
 
+static int parse_thread_configuration(JSON_Object * conf_obj) {
+    JSON_Object *thread_obj;
+    JSON_Array *cpu_array;
+    JSON_Value *val;
+    const char *str;
+    double cpu;
+    int i, j;
+
+    if (conf_obj == NULL) {
+        return 0;
+    }
+
+    val = json_object_get_value(conf_obj, "mlockall");
+    if (val != NULL) {
+        mem_lock = (bool)json_value_get_boolean(val);
+        MSG("INFO: memory of the process will%s be locked\n", (mem_lock ? "" : " NOT"));
+    }
+    val = json_object_get_value(conf_obj, "concent_thread");
+    if (json_value_get_type(val) == JSONBoolean) {
+        concent_thread = (bool)json_value_get_boolean(val);
+        MSG("INFO: concentrator accessed %s\n", (concent_thread ? "by a command thread, TX requests first" : "under a mutex"));
+    }
+
+    for (i = 0; i < THREAD_NB; i++) {
+        thread_obj = json_object_get_object(conf_obj, thread_name[i]);
+        if (thread_obj == NULL) {
+            continue;
+        }
+
+        str = json_object_get_string(thread_obj, "policy");
+        if ((str == NULL) || !strcmp(str, "other")) {
+            thread_conf[i].policy = SCHED_OTHER;
+        } else if (!strcmp(str, "fifo")) {
+            thread_conf[i].policy = SCHED_FIFO;
+        } else if (!strcmp(str, "rr")) {
+            thread_conf[i].policy = SCHED_RR;
+        } else {
+            MSG("ERROR: thread_conf.%s.policy must be \"other\", \"fifo\" or \"rr\"\n", thread_name[i]);
+            return -1;
+        }
+        thread_conf[i].priority = 0;
+        if (thread_conf[i].policy != SCHED_OTHER) {
+            thread_conf[i].priority = (int)json_object_get_number(thread_obj, "priority");
+            if ((thread_conf[i].priority < sched_get_priority_min(thread_conf[i].policy)) || (thread_conf[i].priority > sched_get_priority_max(thread_conf[i].policy))) {
+                MSG("ERROR: thread_conf.%s.priority must be between %d and %d\n", thread_name[i], sched_get_priority_min(thread_conf[i].policy), sched_get_priority_max(thread_conf[i].policy));
+                return -1;
+            }
+        }
+
+        thread_conf[i].cpu_mask = 0;
+        cpu_array = json_object_get_array(thread_obj, "cpus");
+        if (cpu_array != NULL) {
+            for (j = 0; j < (int)json_array_get_count(cpu_array); j++) {
+                cpu = json_array_get_number(cpu_array, j);
+                if ((cpu < 0) || (cpu > 63)) {
+                    MSG("ERROR: thread_conf.%s.cpus must hold CPU indexes between 0 and 63\n", thread_name[i]);
+                    return -1;
+                }
+                thread_conf[i].cpu_mask |= (uint64_t)1 << (int)cpu;
+            }
+        }
+
+        MSG("INFO: %s thread scheduled with policy %s, priority %d, CPU mask 0x%" PRIx64 "\n", thread_name[i], (str != NULL) ? str : "other", thread_conf[i].priority, thread_conf[i].cpu_mask);
+    }
+
+    return 0;
+}
+
+static int parse_uplink_filter(JSON_Object * conf_obj) {
+    JSON_Array *arr;
+    const char *str;
+    char *end;
+    unsigned long long num;
+    long len;
+    int i;
+
+    if (conf_obj == NULL) {
+        return 0;
+    }
+    up_filter_init(&up_filter);
+
+    /* NetIDs, 6 hex digits */
+    arr = json_object_get_array(conf_obj, "net_id");
+    for (i = 0; (arr != NULL) && (i < (int)json_array_get_count(arr)); i++) {
+        str = json_array_get_string(arr, i);
+        num = (str != NULL) ? strtoull(str, &end, 16) : 0;
+        if ((str == NULL) || (*str == '\0') || (*end != '\0') || (up_filter_add_netid(&up_filter, (uint32_t)MIN(num, UINT32_MAX)) != 0)) {
+            MSG("ERROR: invalid uplink_filter.net_id[%d]\n", i);
+            return -1;
+        }
+    }
+
+    /* DevAddr prefixes, 8 hex digits and the prefix length in bits */
+    arr = json_object_get_array(conf_obj, "dev_addr");
+    for (i = 0; (arr != NULL) && (i < (int)json_array_get_count(arr)); i++) {
+        str = json_array_get_string(arr, i);
+        num = (str != NULL) ? strtoull(str, &end, 16) : 0;
+        len = 32;
+        if ((str != NULL) && (*end == '/')) {
+            len = strtol(end + 1, &end, 10);
+        }
+        if ((str == NULL) || (*str == '\0') || (*end != '\0') || (num > UINT32_MAX) || (up_filter_add_devaddr(&up_filter, (uint32_t)num, (int)len) != 0)) {
+            MSG("ERROR: invalid uplink_filter.dev_addr[%d], expecting \"26011000/20\"\n", i);
+            return -1;
+        }
+    }
+
+    /* JoinEUIs, 16 hex digits */
+    arr = json_object_get_array(conf_obj, "join_eui");
+    for (i = 0; (arr != NULL) && (i < (int)json_array_get_count(arr)); i++) {
+        str = json_array_get_string(arr, i);
+        num = (str != NULL) ? strtoull(str, &end, 16) : 0;
+        if ((str == NULL) || (*str == '\0') || (*end != '\0') || (up_filter_add_join_eui(&up_filter, (uint64_t)num) != 0)) {
+            MSG("ERROR: invalid uplink_filter.join_eui[%d], at most %d JoinEUIs\n", i, UP_FILTER_JOIN_NB_MAX);
+            return -1;
+        }
+    }
+
+    MSG("INFO: data uplinks %s, join requests %s\n", (up_filter.devaddr_enabled ? "filtered on DevAddr" : "NOT filtered"), (up_filter.join_enabled ? "filtered on JoinEUI" : "NOT filtered"));
+
+    return 0;
+}
+
+static int parse_duty_cycle(JSON_Array * conf_array) {
+    JSON_Object *band_obj;
+    JSON_Value *val[3];
+    int i;
+
+    if (conf_array == NULL) {
+        return 0;
+    }
+    if (json_array_get_count(conf_array) > JIT_AIRTIME_BAND_NB_MAX) {
+        MSG("ERROR: at most %d duty_cycle sub-bands\n", JIT_AIRTIME_BAND_NB_MAX);
+        return -1;
+    }
+
+    /* sub-bands, as {"freq_min":Hz, "freq_max":Hz, "percent":duty cycle} */
+    for (i = 0; i < (int)json_array_get_count(conf_array); i++) {
+        band_obj = json_array_get_object(conf_array, i);
+        val[0] = json_object_get_value(band_obj, "freq_min");
+        val[1] = json_object_get_value(band_obj, "freq_max");
+        val[2] = json_object_get_value(band_obj, "percent");
+        if ((json_value_get_type(val[0]) != JSONNumber) || (json_value_get_type(val[1]) != JSONNumber) || (json_value_get_type(val[2]) != JSONNumber)) {
+            MSG("ERROR: invalid duty_cycle[%d], expecting {\"freq_min\", \"freq_max\", \"percent\"}\n", i);
+            return -1;
+        }
+        airtime_band[i].freq_min = (uint32_t)json_value_get_number(val[0]);
+        airtime_band[i].freq_max = (uint32_t)json_value_get_number(val[1]);
+        airtime_band[i].duty_cycle = (float)(json_value_get_number(val[2]) / 100.0);
+        MSG("INFO: TX duty cycle of %u-%u Hz limited to %.2f%% over %d s\n", airtime_band[i].freq_min, airtime_band[i].freq_max, 100.0 * airtime_band[i].duty_cycle, JIT_AIRTIME_WINDOW_S);
+    }
+    airtime_band_nb = i;
+    if (jit_airtime_init(airtime_band, airtime_band_nb) != JIT_ERROR_OK) { /* checked again when the queues are started */
+        MSG("ERROR: invalid duty_cycle sub-bands, the frequencies must be ordered and the percent in ]0..100]\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 static int parse_debug_configuration(const char * conf_file) {
     int i;
     const char conf_obj_name[] = "debug_conf";
@@ -1272,48 +2081,1331 @@ static int parse_debug_configuration(const char * conf_file) {
         json_value_free(root_val);
         return -1;
     }
+    conf_snap.debug = debugconf;
+    conf_snap.set |= CONF_SNAP_DEBUG;
 
     /* free JSON parsing data structure */
     json_value_free(root_val);
     return 0;
 }
 
-static uint16_t crc16(const uint8_t * data, unsigned size) {
-    const uint16_t crc_poly = 0x1021;
-    const uint16_t init_val = 0x0000;
-    uint16_t x = init_val;
-    unsigned i, j;
+static uint64_t fnv1a_64(uint64_t h, const void * data, size_t size) {
+    const uint8_t * p = data;
+    size_t i;
 
-    if (data == NULL)  {
-        return 0;
+    for (i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 0x100000001B3ULL;
     }
+    return h;
+}
 
-    for (i=0; i<size; ++i) {
-        x ^= (uint16_t)data[i] << 8;
-        for (j=0; j<8; ++j) {
-            x = (x & 0x8000) ? (x<<1) ^ crc_poly : (x<<1);
-        }
+static int conf_snap_hash(const char * conf_file, uint64_t * hash) {
+    FILE * fp;
+    uint8_t buf[4096];
+    size_t n;
+    uint64_t h = 0xCBF29CE484222325ULL; /* FNV-1a offset basis */
+    const char * lib_version = lgw_version_info();
+
+    fp = fopen(conf_file, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    while ((n = fread(buf, 1, sizeof buf, fp)) > 0) {
+        h = fnv1a_64(h, buf, n);
     }
+    fclose(fp);
 
-    return x;
-}
+    /* a snapshot is only valid for the build which wrote it */
+    h = fnv1a_64(h, VERSION_STRING, strlen(VERSION_STRING));
+    h = fnv1a_64(h, lib_version, strlen(lib_version));
+    *hash = h;
 
-static double difftimespec(struct timespec end, struct timespec beginning) {
-    double x;
+    return 0;
+}
 
-    x = 1E-9 * (double)(end.tv_nsec - beginning.tv_nsec);
-    x += (double)(end.tv_sec - beginning.tv_sec);
+static size_t conf_snap_size(void) {
+    size_t size = sizeof conf_snap;
+    unsigned i;
 
-    return x;
+    for (i = 0; i < ARRAY_SIZE(conf_vars); i++) {
+        size += conf_vars[i].size;
+    }
+    return size;
 }
 
-static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value) {
-    uint8_t buff_ack[ACK_BUFF_SIZE]; /* buffer to give feedback to server */
+static int conf_snap_apply(struct conf_snap_hal_s * snap) {
+    int i;
+
+    /* same order as the JSON parsing functions */
+    if (lgw_board_setconf(&snap->board) != LGW_HAL_SUCCESS) {
+        return -1;
+    }
+    if (((snap->set & CONF_SNAP_CAL_PATH) != 0) && (lgw_cal_cache_set_path(snap->cal_cache_path) != LGW_HAL_SUCCESS)) {
+        return -1;
+    }
+    if ((snap->set & CONF_SNAP_CAL_FAST) != 0) {
+        lgw_cal_set_fast_mode(snap->cal_fast);
+    }
+    if ((snap->set & CONF_SNAP_FW_FAST) != 0) {
+        lgw_fw_set_fast_check(snap->fw_fast_check);
+    }
+    if (((snap->set & CONF_SNAP_FTIME) != 0) && (lgw_ftime_setconf(&snap->ftime) != LGW_HAL_SUCCESS)) {
+        return -1;
+    }
+    if (((snap->set & CONF_SNAP_SX1261) != 0) && (lgw_sx1261_setconf(&snap->sx1261) != LGW_HAL_SUCCESS)) {
+        return -1;
+    }
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (((snap->set & CONF_SNAP_TXGAIN(i)) != 0) && (lgw_txgain_setconf(i, &snap->txgain[i]) != LGW_HAL_SUCCESS)) {
+            return -1;
+        }
+        if (((snap->set & CONF_SNAP_RXRF(i)) != 0) && (lgw_rxrf_setconf(i, &snap->rxrf[i]) != LGW_HAL_SUCCESS)) {
+            return -1;
+        }
+    }
+    if (((snap->set & CONF_SNAP_DEMOD) != 0) && (lgw_demod_setconf(&snap->demod) != LGW_HAL_SUCCESS)) {
+        return -1;
+    }
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        if (((snap->set & CONF_SNAP_RXIF(i)) != 0) && (lgw_rxif_setconf(i, &snap->rxif[i]) != LGW_HAL_SUCCESS)) {
+            return -1;
+        }
+    }
+    if (((snap->set & CONF_SNAP_DEBUG) != 0) && (lgw_debug_setconf(&snap->debug) != LGW_HAL_SUCCESS)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int conf_snap_load(const char * snap_file, uint64_t hash) {
+    FILE * fp;
+    struct conf_snap_hdr_s hdr;
+    size_t size = conf_snap_size();
+    uint8_t * data;
+    size_t offset;
+    unsigned i;
+
+    fp = fopen(snap_file, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    if ((fread(&hdr, sizeof hdr, 1, fp) != 1) || (hdr.magic != CONF_SNAP_MAGIC) || (hdr.version != CONF_SNAP_VERSION) || (hdr.size != size)) {
+        MSG("INFO: configuration snapshot %s not valid, ignored\n", snap_file);
+        fclose(fp);
+        return -1;
+    }
+    if (hdr.hash != hash) {
+        MSG("INFO: configuration snapshot %s out of date, ignored\n", snap_file);
+        fclose(fp);
+        return -1;
+    }
+    data = malloc(size);
+    if (data == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    if (fread(data, size, 1, fp) != 1) {
+        MSG("INFO: configuration snapshot %s truncated, ignored\n", snap_file);
+        free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    /* the HAL still checks each configuration, the JSON file is parsed if one is refused */
+    memcpy(&conf_snap, data, sizeof conf_snap);
+    if (conf_snap_apply(&conf_snap) != 0) {
+        MSG("WARNING: configuration snapshot %s refused by the HAL, ignored\n", snap_file);
+        memset(&conf_snap, 0, sizeof conf_snap);
+        free(data);
+        return -1;
+    }
+    offset = sizeof conf_snap;
+    for (i = 0; i < ARRAY_SIZE(conf_vars); i++) {
+        memcpy(conf_vars[i].addr, data + offset, conf_vars[i].size);
+        offset += conf_vars[i].size;
+    }
+    free(data);
+
+    return 0;
+}
+
+static void conf_snap_save(const char * snap_file, uint64_t hash) {
+    FILE * fp;
+    struct conf_snap_hdr_s hdr;
+    char tmp_file[256];
+    unsigned i;
+    bool ok;
+
+    /* written aside then renamed, a snapshot is never read partially written */
+    if (snprintf(tmp_file, sizeof tmp_file, "%s.tmp", snap_file) >= (int)sizeof tmp_file) {
+        MSG("WARNING: configuration snapshot path too long, not written\n");
+        return;
+    }
+    fp = fopen(tmp_file, "wb");
+    if (fp == NULL) {
+        MSG("WARNING: failed to write configuration snapshot %s, %s\n", tmp_file, strerror(errno));
+        return;
+    }
+    memset(&hdr, 0, sizeof hdr);
+    hdr.magic = CONF_SNAP_MAGIC;
+    hdr.version = CONF_SNAP_VERSION;
+    hdr.hash = hash;
+    hdr.size = conf_snap_size();
+    ok = (fwrite(&hdr, sizeof hdr, 1, fp) == 1) && (fwrite(&conf_snap, sizeof conf_snap, 1, fp) == 1);
+    for (i = 0; ok && (i < ARRAY_SIZE(conf_vars)); i++) {
+        ok = (fwrite(conf_vars[i].addr, conf_vars[i].size, 1, fp) == 1);
+    }
+    if ((fclose(fp) != 0) || !ok || (rename(tmp_file, snap_file) != 0)) {
+        MSG("WARNING: failed to write configuration snapshot %s, %s\n", snap_file, strerror(errno));
+        unlink(tmp_file);
+        return;
+    }
+    MSG("INFO: configuration snapshot written to %s\n", snap_file);
+}
+
+static double difftimespec(struct timespec end, struct timespec beginning) {
+    double x;
+
+    x = 1E-9 * (double)(end.tv_nsec - beginning.tv_nsec);
+    x += (double)(end.tv_sec - beginning.tv_sec);
+
+    return x;
+}
+
+static void meas_snapshot(void * dst, const void * src, size_t size) {
+    uint32_t * d = (uint32_t *)dst;
+    const uint32_t * c = (const uint32_t *)src;
+    size_t i;
+
+    /* counters are read one by one, each one is consistent but the group may be updated meanwhile */
+    for (i = 0; i < (size / sizeof(uint32_t)); i++) {
+        d[i] = __atomic_load_n(&c[i], __ATOMIC_RELAXED);
+    }
+}
+
+static void up_lat_add(uint32_t * hist, int64_t start_ns, int64_t end_ns) {
+    int64_t lat_us = (end_ns - start_ns) / 1000;
+    int i = 0;
+
+    /* first bin with an upper bound above the latency */
+    while ((i < (UP_LAT_BIN_NB - 1)) && (lat_us >= ((int64_t)1 << i))) {
+        i++;
+    }
+    MEAS_ADD(hist[i], 1);
+}
+
+/* upper bound of the latency histogram bin holding the given fraction of the packets, in us, 0 if no packet */
+static uint32_t up_lat_bound(const uint32_t * hist, float ratio) {
+    uint32_t total = 0;
+    uint32_t nb = 0;
+    int i;
+
+    for (i = 0; i < UP_LAT_BIN_NB; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    for (i = 0; i < (UP_LAT_BIN_NB - 1); i++) {
+        nb += hist[i];
+        if (nb >= (ratio * total)) {
+            break;
+        }
+    }
+
+    return (uint32_t)1 << i;
+}
+
+/* Sequence counters: odd while the writer updates the data, readers copy the data and retry if it changed meanwhile */
+static void seq_write_begin(uint32_t * seq) {
+    __atomic_store_n(seq, __atomic_load_n(seq, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void seq_write_end(uint32_t * seq) {
+    __atomic_store_n(seq, __atomic_load_n(seq, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+}
+
+static uint32_t seq_read_begin(const uint32_t * seq) {
+    uint32_t start;
+
+    /* updates are a few stores once per second, spinning is cheaper than sleeping */
+    while ((start = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1);
+
+    return start;
+}
+
+static bool seq_read_retry(const uint32_t * seq, uint32_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (__atomic_load_n(seq, __ATOMIC_RELAXED) != start);
+}
+
+static void timeref_get(bool * valid, struct tref * ref) {
+    uint32_t start;
+
+    do {
+        start = seq_read_begin(&seq_timeref);
+        *valid = gps_ref_valid;
+        *ref = time_reference_gps;
+    } while (seq_read_retry(&seq_timeref, start));
+}
+
+static void xcorr_get(bool * ok, double * correct) {
+    uint32_t start;
+
+    do {
+        start = seq_read_begin(&seq_xcorr);
+        *ok = xtal_correct_ok;
+        *correct = xtal_correct;
+    } while (seq_read_retry(&seq_xcorr, start));
+}
+
+static int up_server_find(const struct sockaddr_storage * sa) {
+    const struct sockaddr_in * a4 = (const struct sockaddr_in *)sa;
+    const struct sockaddr_in6 * a6 = (const struct sockaddr_in6 *)sa;
+    const struct sockaddr_in * s4;
+    const struct sockaddr_in6 * s6;
+    int i;
+
+    for (i = 0; i < up_server_nb; i++) {
+        if (up_server[i].sa.ss_family != sa->ss_family) {
+            continue;
+        }
+        if (sa->ss_family == AF_INET) {
+            s4 = (const struct sockaddr_in *)&up_server[i].sa;
+            if ((s4->sin_port == a4->sin_port) && (s4->sin_addr.s_addr == a4->sin_addr.s_addr)) {
+                return i;
+            }
+        } else if (sa->ss_family == AF_INET6) {
+            s6 = (const struct sockaddr_in6 *)&up_server[i].sa;
+            if ((s6->sin6_port == a6->sin6_port) && (memcmp(&s6->sin6_addr, &a6->sin6_addr, sizeof s6->sin6_addr) == 0)) {
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void push_ack_register(uint8_t server, uint8_t token_h, uint8_t token_l, struct timespec send_time, struct journal_ref_s jrn) {
+    int i;
+    int slot = -1;
+
+    for (i = 0; i < PUSH_TOKEN_NB; i++) {
+        if (push_token[i].pending == false) {
+            slot = i;
+            break;
+        }
+        /* table full, recycle the oldest datagram (which will never be counted as acknowledged) */
+        if ((slot < 0) || (difftimespec(push_token[slot].send_time, push_token[i].send_time) > 0)) {
+            slot = i;
+        }
+    }
+
+    if (push_token[slot].pending == true) {
+        push_ack_timeout(slot);
+    }
+    push_token_nb += 1;
+    push_token[slot].pending = true;
+    push_token[slot].server = server;
+    push_token[slot].jrn = jrn;
+    push_token[slot].token_h = token_h;
+    push_token[slot].token_l = token_l;
+    push_token[slot].send_time = send_time;
+}
+
+static void push_ack_timeout(int slot) {
+    push_token[slot].pending = false;
+    push_token_nb -= 1;
+    if (push_token[slot].server == 0) {
+        push_ack_ok = false;
+        if (push_token[slot].jrn.seq != 0) {
+            journal_lost(&journal, push_token[slot].jrn);
+        }
+    }
+}
+
+static double push_ack_delay_max(void) {
+    /* a PUSH_ACK is waited for 2 half time-outs, as the blocking recv calls used to do */
+    return 2.0 * ((double)push_timeout_half.tv_sec + (1E-6 * (double)push_timeout_half.tv_usec));
+}
+
+static int push_ack_process(void) {
+    uint8_t buff_ack[32]; /* buffer to receive acknowledges */
+    struct sockaddr_storage src; /* server which sent the acknowledge */
+    socklen_t src_len;
+    struct timespec recv_time;
+    double push_timeout;
+    int i, j, k;
+    int nb_ack[UP_SERV_NB_MAX] = {0};
+    int nb_ack_total = 0;
+
+    push_timeout = push_ack_delay_max();
+
+    while (true) {
+        /* never blocks, the upstream thread waits for the socket with epoll, drain it */
+        src_len = sizeof src;
+        j = recvfrom(sock_up, (void *)buff_ack, sizeof buff_ack, MSG_DONTWAIT, (struct sockaddr *)&src, &src_len);
+        clock_gettime(CLOCK_MONOTONIC, &recv_time);
+
+        /* forget datagrams which are not acknowledged in time */
+        for (i = 0; i < PUSH_TOKEN_NB; i++) {
+            if ((push_token[i].pending == true) && (difftimespec(recv_time, push_token[i].send_time) > push_timeout)) {
+                push_ack_timeout(i);
+            }
+        }
+
+        if (j == -1) {
+            /* no more ACK to process (EAGAIN), or server connection error */
+            break;
+        } else if ((j < 4) || (buff_ack[0] != PROTOCOL_VERSION) || (buff_ack[3] != PKT_PUSH_ACK)) {
+            //MSG("WARNING: [up] ignored invalid non-ACL packet\n");
+            continue;
+        }
+
+        /* the upstream socket is not connected, only accept acknowledges from the configured servers */
+        k = up_server_find(&src);
+        if (k < 0) {
+            continue;
+        }
+
+        for (i = 0; i < PUSH_TOKEN_NB; i++) {
+            if ((push_token[i].pending == true) && (push_token[i].server == k) && (buff_ack[1] == push_token[i].token_h) && (buff_ack[2] == push_token[i].token_l)) {
+                break;
+            }
+        }
+        if (i == PUSH_TOKEN_NB) {
+            //MSG("WARNING: [up] ignored out-of sync ACK packet\n");
+            continue;
+        }
+
+        MSG("INFO: [up] PUSH_ACK received from server %d in %i ms\n", k, (int)(1000 * difftimespec(recv_time, push_token[i].send_time)));
+        up_lat_add(meas_up.ack_rtt_hist[k], 0, (int64_t)(1E9 * difftimespec(recv_time, push_token[i].send_time)));
+        push_token[i].pending = false;
+        push_token_nb -= 1;
+        nb_ack[k] += 1;
+        if (k == 0) {
+            push_ack_ok = true;
+            if (push_token[i].jrn.seq != 0) {
+                journal_ack(&journal, push_token[i].jrn);
+            }
+        }
+        nb_ack_total += 1;
+    }
+
+    if (nb_ack_total > 0) {
+        for (k = 0; k < up_server_nb; k++) {
+            MEAS_ADD(meas_up.ack_rcv[k], nb_ack[k]);
+        }
+    }
+
+    return nb_ack_total;
+}
+
+static int rxpk_size_max(const struct lgw_pkt_rx_s * p) {
+    if (push_data_binary == true) {
+        return RXPK_BIN_SIZE + p->size;
+    }
+    return RXPK_JSON_META_MAX + (4 * ((p->size + 2) / 3)); /* base64 payload */
+}
+
+static int up_coalesce(struct lgw_pkt_rx_s ** pkt, int nb_pkt, int64_t start_ns, struct lgw_pkt_rx_s ** carry) {
+    struct pollfd fds[4];
+    struct timespec timeout;
+    eventfd_t ev_count;
+    int64_t left_ns;
+    int max_pkt = (int)coalesce_max_pkt;
+    int bytes = 0;
+    int i;
+
+    for (i = 0; i < nb_pkt; i++) {
+        bytes += rxpk_size_max(pkt[i]);
+    }
+
+    /* PUSH_ACK are processed while waiting, a status report ends the wait */
+    fds[0].fd = rx_queue_fd(&rx_queue);
+    fds[1].fd = sock_up;
+    fds[2].fd = report_fd;
+    fds[3].fd = exit_fd;
+    for (i = 0; i < 4; i++) {
+        fds[i].events = POLLIN;
+    }
+    while ((nb_pkt < max_pkt) && (report_ready == false) && !exit_sig && !quit_sig) {
+        /* take the available packets one by one, the first one which does not fit waits for the next datagram */
+        while ((nb_pkt < max_pkt) && (rx_queue_pop(&rx_queue, &pkt[nb_pkt], 1) == 1)) {
+            bytes += rxpk_size_max(pkt[nb_pkt]);
+            if (bytes > (int)coalesce_max_bytes) {
+                *carry = pkt[nb_pkt];
+                return nb_pkt;
+            }
+            nb_pkt += 1;
+        }
+        if (nb_pkt == max_pkt) {
+            break;
+        }
+
+        left_ns = start_ns + (1000 * (int64_t)coalesce_delay_us) - time_monotonic_ns();
+        if (left_ns <= 0) {
+            break;
+        }
+        timeout.tv_sec = (time_t)(left_ns / 1000000000);
+        timeout.tv_nsec = (long)(left_ns % 1000000000);
+        if (ppoll(fds, 4, &timeout, NULL) <= 0) {
+            break;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            push_ack_process();
+        }
+        if ((fds[2].revents & POLLIN) != 0) {
+            eventfd_read(report_fd, &ev_count);
+            break;
+        }
+        if ((fds[3].revents & POLLIN) != 0) {
+            break;
+        }
+        if ((fds[0].revents & POLLIN) != 0) {
+            rx_queue_clear(&rx_queue);
+        }
+    }
+
+    return nb_pkt;
+}
+
+static void push_data_replay(void) {
+    struct timespec now;
+    struct journal_ref_s ref;
+    uint8_t * dgram;
+    uint32_t size;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (difftimespec(now, replay_time) < (1.0 / journal_replay_rate)) {
+        return;
+    }
+    dgram = journal_replay_next(&journal, &size, &ref);
+    if (dgram == NULL) {
+        return;
+    }
+    replay_time = now;
+
+    /* the datagram is sent from the journal mapping, only its token is changed */
+    dgram[1] = (uint8_t)rand();
+    dgram[2] = (uint8_t)rand();
+    sendto(sock_up, (void *)dgram, size, 0, (struct sockaddr *)&up_server[0].sa, up_server[0].sa_len);
+    push_ack_register(0, dgram[1], dgram[2], now, ref);
+
+    MEAS_ADD(meas_up.dgram_sent, 1);
+    MEAS_ADD(meas_up.network_byte, size);
+    MEAS_ADD(meas_up.jrn_replayed, 1);
+    MEAS_SET(meas_up.jrn_backlog, journal_backlog(&journal));
+}
+
+static int up_wait_timeout_ms(void) {
+    struct timespec now;
+    double push_timeout = push_ack_delay_max();
+    bool deadline = false;
+    double wait = 0.0;
+    double x;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* oldest PUSH_DATA time-out */
+    for (i = 0; (i < PUSH_TOKEN_NB) && (push_token_nb > 0); i++) {
+        if (push_token[i].pending == true) {
+            x = push_timeout - difftimespec(now, push_token[i].send_time);
+            if ((deadline == false) || (x < wait)) {
+                wait = x;
+                deadline = true;
+            }
+        }
+    }
+
+    /* next journaled datagram to be sent again */
+    if ((journal_path[0] != '\0') && (push_ack_ok == true) && (journal_backlog(&journal) > 0)) {
+        x = (1.0 / journal_replay_rate) - difftimespec(now, replay_time);
+        if ((deadline == false) || (x < wait)) {
+            wait = x;
+            deadline = true;
+        }
+    }
+
+    if (deadline == false) {
+        return -1;
+    } else if (wait <= 0.0) {
+        return 0;
+    }
+    return (int)(1000 * wait) + 1; /* rounded up, not to wake up just before the deadline */
+}
+
+static int net_epoll_create(const int * fd, int nb_fd) {
+    struct epoll_event ev;
+    int epfd;
+    int i;
+
+    epfd = epoll_create1(0);
+    if (epfd < 0) {
+        return -1;
+    }
+    for (i = 0; i < nb_fd; i++) {
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = fd[i];
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd[i], &ev) != 0) {
+            close(epfd);
+            return -1;
+        }
+    }
+
+    return epfd;
+}
+
+/* upper bound of the latency histogram bin holding the given fraction of the calls, in us */
+static uint32_t com_stats_lat_bound(const struct lgw_com_stats_op_s * op, float ratio) {
+    uint32_t nb = 0;
+    int i;
+
+    for (i = 0; i < (LGW_COM_STATS_LAT_NB - 1); i++) {
+        nb += op->lat_hist[i];
+        if (nb >= (ratio * op->nb_call)) {
+            break;
+        }
+    }
+
+    return (uint32_t)1 << i;
+}
+
+static void print_com_stats(const struct lgw_com_stats_s * stats) {
+    const char * type_str[LGW_COM_UNKNOWN] = { "SPI", "USB", "REPLAY", "SIM" };
+    const char * target_str[LGW_COM_STATS_TARGET_NB] = { "SX1302", "RADIO_A", "RADIO_B", "SX1261" };
+    const char * op_str[LGW_COM_STATS_OP_NB] = { "w", "r", "rmw", "wb", "rb", "flush" };
+    const struct lgw_com_stats_op_s * op;
+    int i, j, k;
+
+    for (i = 0; i < LGW_COM_UNKNOWN; i++) {
+        for (j = 0; j < LGW_COM_STATS_TARGET_NB; j++) {
+            for (k = 0; k < LGW_COM_STATS_OP_NB; k++) {
+                op = &stats->op[i][j][k];
+                if (op->nb_call == 0) {
+                    continue;
+                }
+                printf("# %s %s %s: %u calls (%u errors), %" PRIu64 " bytes, %" PRIu64 " us total, p50<%uus p99<%uus\n", type_str[i], target_str[j], op_str[k],
+                        op->nb_call, op->nb_error, op->nb_byte, op->time_us, com_stats_lat_bound(op, 0.5), com_stats_lat_bound(op, 0.99));
+            }
+        }
+    }
+}
+
+static void hist_u64(uint64_t * dst, const uint32_t * src, int nb) {
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        dst[i] = src[i];
+    }
+}
+
+/* format the counters since start in the next snapshot of the metrics endpoint, com and rx are the statistics since the previous report, NULL if unknown */
+static void metrics_update(const struct meas_up_s * up, const struct meas_dw_s * dw, const struct meas_jit_s * jit, const struct meas_bcn_s * bcn, const struct lgw_com_stats_s * com, const struct lgw_rx_stats_s * rx) {
+    const char * type_str[LGW_COM_UNKNOWN] = { "spi", "usb", "replay", "sim" };
+    const char * target_str[LGW_COM_STATS_TARGET_NB] = { "sx1302", "radio_a", "radio_b", "sx1261" };
+    const char * op_str[LGW_COM_STATS_OP_NB] = { "w", "r", "rmw", "wb", "rb", "flush" };
+    static struct lgw_perf_probe_s probe[LGW_PERF_PROBE_NB_MAX]; /* too large for the stack */
+    uint64_t hist[LGW_PERF_BUCKET_NB]; /* the largest of the histograms */
+    struct lgw_com_stats_op_s * op;
+    struct metrics_buf_s * b;
+    char labels[128];
+    uint16_t jit_nb[LGW_RF_CHAIN_NB], jit_max[LGW_RF_CHAIN_NB];
+    int nb_probe = 0;
+    int f, i, j, k;
+
+    if (com != NULL) {
+        for (i = 0; i < LGW_COM_UNKNOWN; i++) {
+            for (j = 0; j < LGW_COM_STATS_TARGET_NB; j++) {
+                for (k = 0; k < LGW_COM_STATS_OP_NB; k++) {
+                    op = &metrics_com.op[i][j][k];
+                    op->nb_call += com->op[i][j][k].nb_call;
+                    op->nb_error += com->op[i][j][k].nb_error;
+                    op->nb_byte += com->op[i][j][k].nb_byte;
+                    op->time_us += com->op[i][j][k].time_us;
+                    for (f = 0; f < LGW_COM_STATS_LAT_NB; f++) {
+                        op->lat_hist[f] += com->op[i][j][k].lat_hist[f];
+                    }
+                }
+            }
+        }
+    }
+    if (rx != NULL) {
+        metrics_rx_fetch += rx->nb_fetch;
+        metrics_rx_split += rx->nb_split;
+    }
+
+    b = metrics_begin(&metrics);
+
+    /* upstream */
+    metrics_family(b, "lora_pkt_fwd_rx_packets", "counter", "Packets received by the concentrator, by CRC status");
+    metrics_printf(b, "lora_pkt_fwd_rx_packets_total{status=\"crc_ok\"} %u\n", up->rx_ok);
+    metrics_printf(b, "lora_pkt_fwd_rx_packets_total{status=\"crc_bad\"} %u\n", up->rx_bad);
+    metrics_printf(b, "lora_pkt_fwd_rx_packets_total{status=\"no_crc\"} %u\n", up->rx_nocrc);
+    metrics_family(b, "lora_pkt_fwd_rx_dropped", "counter", "Packets received and not forwarded, by reason");
+    metrics_printf(b, "lora_pkt_fwd_rx_dropped_total{reason=\"devaddr\"} %u\n", up->rx_drop_devaddr);
+    metrics_printf(b, "lora_pkt_fwd_rx_dropped_total{reason=\"join_eui\"} %u\n", up->rx_drop_join_eui);
+    metrics_printf(b, "lora_pkt_fwd_rx_dropped_total{reason=\"duplicate\"} %u\n", up->rx_drop_dup);
+    metrics_printf(b, "lora_pkt_fwd_rx_dropped_total{reason=\"queue_full\"} %u\n", rx_queue_dropped(&rx_queue));
+    metrics_family(b, "lora_pkt_fwd_up_packets", "counter", "Packets forwarded to the servers");
+    metrics_printf(b, "lora_pkt_fwd_up_packets_total %u\n", up->pkt_fwd);
+    metrics_family(b, "lora_pkt_fwd_up_payload_bytes", "counter", "Payload bytes of the packets forwarded");
+    metrics_printf(b, "lora_pkt_fwd_up_payload_bytes_total %u\n", up->payload_byte);
+    metrics_family(b, "lora_pkt_fwd_push_data", "counter", "PUSH_DATA datagrams sent");
+    metrics_printf(b, "lora_pkt_fwd_push_data_total %u\n", up->dgram_sent);
+    metrics_family(b, "lora_pkt_fwd_push_data_bytes", "counter", "UDP bytes of the PUSH_DATA datagrams sent");
+    metrics_printf(b, "lora_pkt_fwd_push_data_bytes_total %u\n", up->network_byte);
+    metrics_family(b, "lora_pkt_fwd_push_ack", "counter", "PUSH_DATA datagrams acknowledged, by server");
+    for (i = 0; i < up_server_nb; i++) {
+        metrics_printf(b, "lora_pkt_fwd_push_ack_total{server=\"%s:%s\"} %u\n", up_server[i].addr, up_server[i].port, up->ack_rcv[i]);
+    }
+    metrics_family(b, "lora_pkt_fwd_push_ack_rtt_seconds", "histogram", "Time from the send of a PUSH_DATA to its PUSH_ACK, by server");
+    for (i = 0; i < up_server_nb; i++) {
+        snprintf(labels, sizeof labels, "server=\"%.63s:%.7s\"", up_server[i].addr, up_server[i].port);
+        hist_u64(hist, up->ack_rtt_hist[i], UP_LAT_BIN_NB);
+        metrics_hist(b, "lora_pkt_fwd_push_ack_rtt_seconds", labels, hist, UP_LAT_BIN_NB, 1E-6, -1);
+    }
+    metrics_family(b, "lora_pkt_fwd_up_latency_seconds", "histogram", "Host latency of the packets forwarded, by stage from the RX buffer fetch to the send");
+    for (i = 0; i < UP_LAT_NB; i++) {
+        snprintf(labels, sizeof labels, "stage=\"%s\"", up_lat_str[i]);
+        hist_u64(hist, up->lat_hist[i], UP_LAT_BIN_NB);
+        metrics_hist(b, "lora_pkt_fwd_up_latency_seconds", labels, hist, UP_LAT_BIN_NB, 1E-6, -1);
+    }
+    if (journal_path[0] != '\0') {
+        metrics_family(b, "lora_pkt_fwd_journal_replayed", "counter", "Journaled datagrams sent again");
+        metrics_printf(b, "lora_pkt_fwd_journal_replayed_total %u\n", up->jrn_replayed);
+        metrics_family(b, "lora_pkt_fwd_journal_dropped", "counter", "Journaled datagrams overwritten before being acknowledged");
+        metrics_printf(b, "lora_pkt_fwd_journal_dropped_total %u\n", up->jrn_dropped);
+        metrics_family(b, "lora_pkt_fwd_journal_backlog", "gauge", "Journaled datagrams waiting to be sent again");
+        metrics_printf(b, "lora_pkt_fwd_journal_backlog %u\n", up->jrn_backlog);
+    }
+
+    /* downstream */
+    metrics_family(b, "lora_pkt_fwd_pull_data", "counter", "PULL_DATA datagrams sent");
+    metrics_printf(b, "lora_pkt_fwd_pull_data_total %u\n", dw->pull_sent);
+    metrics_family(b, "lora_pkt_fwd_pull_ack", "counter", "PULL_DATA datagrams acknowledged");
+    metrics_printf(b, "lora_pkt_fwd_pull_ack_total %u\n", dw->ack_rcv);
+    metrics_family(b, "lora_pkt_fwd_pull_resp", "counter", "PULL_RESP datagrams received");
+    metrics_printf(b, "lora_pkt_fwd_pull_resp_total %u\n", dw->dgram_rcv);
+    metrics_family(b, "lora_pkt_fwd_pull_resp_bytes", "counter", "UDP bytes of the PULL_RESP datagrams received");
+    metrics_printf(b, "lora_pkt_fwd_pull_resp_bytes_total %u\n", dw->network_byte);
+    metrics_family(b, "lora_pkt_fwd_tx_requested", "counter", "Downlinks requested by the server");
+    metrics_printf(b, "lora_pkt_fwd_tx_requested_total %u\n", dw->tx_requested);
+    metrics_family(b, "lora_pkt_fwd_tx_rejected", "counter", "Downlinks rejected by the JIT queue, by reason");
+    metrics_printf(b, "lora_pkt_fwd_tx_rejected_total{reason=\"collision_packet\"} %u\n", dw->tx_rejected_collision_packet);
+    metrics_printf(b, "lora_pkt_fwd_tx_rejected_total{reason=\"collision_beacon\"} %u\n", dw->tx_rejected_collision_beacon);
+    metrics_printf(b, "lora_pkt_fwd_tx_rejected_total{reason=\"too_late\"} %u\n", dw->tx_rejected_too_late);
+    metrics_printf(b, "lora_pkt_fwd_tx_rejected_total{reason=\"too_early\"} %u\n", dw->tx_rejected_too_early);
+    metrics_family(b, "lora_pkt_fwd_tx_rejected_admission", "counter", "Downlinks among the rejected ones, rejected before their payload was decoded");
+    metrics_printf(b, "lora_pkt_fwd_tx_rejected_admission_total %u\n", dw->tx_rejected_admission);
+    metrics_family(b, "lora_pkt_fwd_tx", "counter", "Packets handed to the concentrator, by result");
+    metrics_printf(b, "lora_pkt_fwd_tx_total{result=\"ok\"} %u\n", jit->tx_ok);
+    metrics_printf(b, "lora_pkt_fwd_tx_total{result=\"fail\"} %u\n", jit->tx_fail);
+    metrics_family(b, "lora_pkt_fwd_tx_late", "counter", "Packets handed to the concentrator less than " STR(JIT_TX_LATE_US) " us before their emission");
+    metrics_printf(b, "lora_pkt_fwd_tx_late_total %u\n", jit->tx_late);
+    metrics_family(b, "lora_pkt_fwd_jit_wakeup_late", "counter", "Wake-ups of the JIT thread late by more than " STR(JIT_WAKEUP_LATE_US) " us");
+    metrics_printf(b, "lora_pkt_fwd_jit_wakeup_late_total %u\n", jit->wakeup_late);
+    metrics_family(b, "lora_pkt_fwd_jit_wakeup_late_max_seconds", "gauge", "Longest delay of a wake-up of the JIT thread after its deadline");
+    metrics_printf(b, "lora_pkt_fwd_jit_wakeup_late_max_seconds %g\n", jit->wakeup_late_max_us / 1E6);
+    metrics_family(b, "lora_pkt_fwd_beacon", "counter", "Beacons, by state");
+    metrics_printf(b, "lora_pkt_fwd_beacon_total{state=\"queued\"} %u\n", bcn->beacon_queued);
+    metrics_printf(b, "lora_pkt_fwd_beacon_total{state=\"sent\"} %u\n", jit->beacon_sent);
+    metrics_printf(b, "lora_pkt_fwd_beacon_total{state=\"rejected\"} %u\n", bcn->beacon_rejected);
+
+    /* queues occupancy and high-water marks */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        jit_queue_get_occupancy(&jit_queue[i], &jit_nb[i], &jit_max[i]);
+    }
+    metrics_family(b, "lora_pkt_fwd_jit_queue_packets", "gauge", "Packets in the JIT queue, by RF chain");
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        metrics_printf(b, "lora_pkt_fwd_jit_queue_packets{rf_chain=\"%d\"} %u\n", i, jit_nb[i]);
+    }
+    metrics_family(b, "lora_pkt_fwd_jit_queue_packets_max", "gauge", "Highest number of packets in the JIT queue since start, by RF chain");
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        metrics_printf(b, "lora_pkt_fwd_jit_queue_packets_max{rf_chain=\"%d\"} %u\n", i, jit_max[i]);
+    }
+    metrics_family(b, "lora_pkt_fwd_rx_queue_packets_max", "gauge", "Highest number of packets in the uplink queue since start, of " STR(RX_QUEUE_SIZE));
+    metrics_printf(b, "lora_pkt_fwd_rx_queue_packets_max %u\n", rx_queue_max_used(&rx_queue));
+    metrics_family(b, "lora_pkt_fwd_pkt_pool_used_max", "gauge", "Highest number of RX packet descriptors taken from the pool since start, of " STR(PKT_POOL_SIZE));
+    metrics_printf(b, "lora_pkt_fwd_pkt_pool_used_max %d\n", pkt_pool_max_used(&pkt_pool));
+    if (rx != NULL) {
+        metrics_family(b, "lgw_rx_buffer_fill_max_bytes", "gauge", "Highest number of bytes waiting in the SX1302 RX buffer at a fetch, since the previous snapshot");
+        metrics_printf(b, "lgw_rx_buffer_fill_max_bytes %u\n", rx->fill_max);
+    }
+    metrics_family(b, "lgw_rx_fetches", "counter", "RX buffer fetches returning data");
+    metrics_printf(b, "lgw_rx_fetches_total %" PRIu64 "\n", metrics_rx_fetch);
+    metrics_family(b, "lgw_rx_fetches_split", "counter", "RX buffer fetches limited by the host buffer size");
+    metrics_printf(b, "lgw_rx_fetches_split_total %" PRIu64 "\n", metrics_rx_split);
+
+    /* transport to the concentrator, one family at a time */
+    for (f = 0; f < 5; f++) {
+        switch (f) {
+            case 0: metrics_family(b, "lgw_com_calls", "counter", "Accesses to the concentrator, by link, device and kind of access"); break;
+            case 1: metrics_family(b, "lgw_com_errors", "counter", "Accesses to the concentrator which failed"); break;
+            case 2: metrics_family(b, "lgw_com_bytes", "counter", "Register and payload bytes moved"); break;
+            case 3: metrics_family(b, "lgw_com_time_seconds", "counter", "Time spent in the accesses"); break;
+            default: metrics_family(b, "lgw_com_latency_seconds", "histogram", "Duration of the accesses"); break;
+        }
+        for (i = 0; i < LGW_COM_UNKNOWN; i++) {
+            for (j = 0; j < LGW_COM_STATS_TARGET_NB; j++) {
+                for (k = 0; k < LGW_COM_STATS_OP_NB; k++) {
+                    op = &metrics_com.op[i][j][k];
+                    if (op->nb_call == 0) {
+                        continue;
+                    }
+                    snprintf(labels, sizeof labels, "com=\"%s\",target=\"%s\",op=\"%s\"", type_str[i], target_str[j], op_str[k]);
+                    switch (f) {
+                        case 0: metrics_printf(b, "lgw_com_calls_total{%s} %u\n", labels, op->nb_call); break;
+                        case 1: metrics_printf(b, "lgw_com_errors_total{%s} %u\n", labels, op->nb_error); break;
+                        case 2: metrics_printf(b, "lgw_com_bytes_total{%s} %" PRIu64 "\n", labels, op->nb_byte); break;
+                        case 3: metrics_printf(b, "lgw_com_time_seconds_total{%s} %.9g\n", labels, op->time_us / 1E6); break;
+                        default:
+                            hist_u64(hist, op->lat_hist, LGW_COM_STATS_LAT_NB);
+                            metrics_hist(b, "lgw_com_latency_seconds", labels, hist, LGW_COM_STATS_LAT_NB, 1E-6, op->time_us / 1E6);
+                            break;
+                    }
+                }
+            }
+        }
+    }
+
+    /* HAL profiling registry, see loragw_perf.h */
+    if (lgw_perf_is_enabled() == true) {
+        nb_probe = lgw_perf_get(probe, LGW_PERF_PROBE_NB_MAX);
+    }
+    if (nb_probe > 0) {
+        metrics_family(b, "lgw_hal_latency_seconds", "histogram", "Duration of the HAL functions, by probe");
+        for (i = 0; i < nb_probe; i++) {
+            snprintf(labels, sizeof labels, "probe=\"%s\"", probe[i].name);
+            metrics_hist(b, "lgw_hal_latency_seconds", labels, probe[i].hist, LGW_PERF_BUCKET_NB, 1E-9, probe[i].sum_ns / 1E9);
+        }
+    }
+
+    metrics_publish(&metrics);
+}
+
+/* concentrator requests, run by concent_run exclusively of each other, in the command thread if enabled */
+
+struct cmd_counter_s {
+    uint64_t * inst; /* current counter, extended to 64 bits, NULL if not needed */
+    uint32_t * trig; /* counter captured on the last PPS, NULL if not needed */
+};
+
+struct cmd_rx_stats_s {
+    struct lgw_rx_stats_s * rx_stats;
+    struct lgw_chan_stats_s * chan_stats;
+    struct lgw_arb_stats_s * arb_stats;
+    bool chan_stats_ok;
+    bool arb_stats_ok;
+};
+
+struct cmd_receive_s {
+    uint8_t max_pkt;
+    struct lgw_pkt_rx_s ** pkt;
+};
+
+struct cmd_tx_status_s {
+    uint8_t rf_chain;
+    uint8_t status;
+};
+
+struct cmd_send_s {
+    struct lgw_pkt_tx_s * pkt;
+    uint8_t nb_pkt;
+    int * result;
+    uint64_t count_us; /* concentrator time when the triggers were armed */
+};
+
+struct cmd_scan_start_s {
+    uint32_t freq_hz;
+    uint16_t nb_scan;
+};
+
+struct cmd_scan_poll_s {
+    lgw_spectral_scan_status_t status;
+    int16_t * levels;
+    uint16_t * results;
+};
+
+static int cmd_counter(void * arg) {
+    struct cmd_counter_s * cmd = arg;
+    int i = LGW_HAL_SUCCESS;
+
+    if (cmd->inst != NULL) {
+        i |= lgw_get_instcnt64(cmd->inst);
+    }
+    if (cmd->trig != NULL) {
+        i |= lgw_get_trigcnt(cmd->trig);
+    }
+    return i;
+}
+
+static int cmd_recover(void * arg) {
+    return lgw_recover((bool *)arg);
+}
+
+static int cmd_rx_stats(void * arg) {
+    struct cmd_rx_stats_s * cmd = arg;
+
+    cmd->chan_stats_ok = (lgw_get_chan_stats(cmd->chan_stats, true) == LGW_HAL_SUCCESS);
+    cmd->arb_stats_ok = (lgw_get_arb_stats(cmd->arb_stats, true) == LGW_HAL_SUCCESS);
+    return lgw_get_rx_stats(cmd->rx_stats, true);
+}
+
+static int cmd_com_stats(void * arg) {
+    return lgw_com_get_stats((struct lgw_com_stats_s *)arg, true);
+}
+
+static int cmd_temperature(void * arg) {
+    return lgw_get_temperature((float *)arg);
+}
+
+static int cmd_receive(void * arg) {
+    struct cmd_receive_s * cmd = arg;
+
+    return lgw_receive_ref(cmd->max_pkt, cmd->pkt);
+}
+
+static int cmd_receive_wait(void * arg) {
+    return lgw_receive_wait(*(const uint32_t *)arg);
+}
+
+static int cmd_send_prepare(void * arg) {
+    return lgw_send_prepare((struct lgw_pkt_tx_s *)arg);
+}
+
+static int cmd_tx_status(void * arg) {
+    struct cmd_tx_status_s * cmd = arg;
+
+    return lgw_status(cmd->rf_chain, TX_STATUS, &cmd->status);
+}
+
+static int cmd_send(void * arg) {
+    struct cmd_send_s * cmd = arg;
+    int result;
+
+    if (spectral_scan_busy == true) {
+        /* the scan did not fit before this packet, which was enqueued after its start */
+        result = lgw_spectral_scan_abort();
+        if (result != LGW_HAL_SUCCESS) {
+            MSG("WARNING: [jit] lgw_spectral_scan_abort failed\n");
+        }
+        spectral_scan_busy = false;
+    }
+    if (lgw_get_instcnt_estimate64(&cmd->count_us) != LGW_HAL_SUCCESS) {
+        lgw_get_instcnt64(&cmd->count_us);
+    }
+    return lgw_send_batch(cmd->pkt, cmd->nb_pkt, cmd->result); /* only arms the triggers of the packets prepared */
+}
+
+static int cmd_scan_start(void * arg) {
+    struct cmd_scan_start_s * cmd = arg;
+    uint8_t tx_status;
+    int i, x;
+
+    /* no scan while a downlink is programmed */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (tx_enable[i] == true) {
+            x = lgw_status((uint8_t)i, TX_STATUS, &tx_status);
+            if (x != LGW_HAL_SUCCESS) {
+                printf("ERROR: failed to get TX status on chain %d\n", i);
+            } else if ((tx_status == TX_SCHEDULED) || (tx_status == TX_EMITTING)) {
+                printf("INFO: skip spectral scan (downlink programmed on RF chain %d)\n", i);
+                return 1;
+            }
+        }
+    }
+    x = lgw_spectral_scan_start(cmd->freq_hz, cmd->nb_scan);
+    if (x != 0) {
+        return -1;
+    }
+    spectral_scan_busy = true;
+    return 0;
+}
+
+static int cmd_scan_poll(void * arg) {
+    struct cmd_scan_poll_s * cmd = arg;
+    int x;
+
+    x = lgw_spectral_scan_get_status(&cmd->status);
+    if ((x == 0) && (cmd->status == LGW_SPECTRAL_SCAN_STATUS_COMPLETED)) {
+        memset(cmd->levels, 0, LGW_SPECTRAL_SCAN_RESULT_SIZE * sizeof cmd->levels[0]);
+        memset(cmd->results, 0, LGW_SPECTRAL_SCAN_RESULT_SIZE * sizeof cmd->results[0]);
+        x = lgw_spectral_scan_get_results(cmd->levels, cmd->results);
+    }
+    if ((x != 0) || (cmd->status != LGW_SPECTRAL_SCAN_STATUS_ON_GOING)) {
+        spectral_scan_busy = false;
+    }
+    return x;
+}
+
+static int cmd_scan_abort(void * arg) {
+    (void)arg;
+    spectral_scan_busy = false;
+    return lgw_spectral_scan_abort();
+}
+
+static void get_concentrator_time(uint64_t * count_us) {
+    struct cmd_counter_s cmd = { count_us, NULL };
+
+    /* Use the counter value published by the HAL, so that the scheduling does not wait for an ongoing concentrator access */
+    if (lgw_get_instcnt_estimate64(count_us) != LGW_HAL_SUCCESS) {
+        concent_run(&concent, CONCENT_CMD_COUNTER, cmd_counter, &cmd);
+    }
+}
+
+static void jit_wait(uint32_t timeout_us) {
+    struct timespec ts;
+    struct timespec now;
+    int64_t late_us;
+    int i;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_us / 1000000;
+    ts.tv_nsec += (timeout_us % 1000000) * 1000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    do {
+        i = sem_timedwait(&jit_wakeup, &ts);
+    } while ((i != 0) && (errno == EINTR) && !exit_sig && !quit_sig);
+
+    /* a wake-up on the deadline is late if the thread was not scheduled in time */
+    if ((i != 0) && (errno == ETIMEDOUT)) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        late_us = (now.tv_sec - ts.tv_sec) * 1000000LL + (now.tv_nsec - ts.tv_nsec) / 1000;
+        if (late_us > JIT_WAKEUP_LATE_US) {
+            MEAS_ADD(meas_jit.wakeup_late, 1);
+            if (late_us > meas_jit.wakeup_late_max_us) {
+                MEAS_SET(meas_jit.wakeup_late_max_us, (uint32_t)MIN(late_us, UINT32_MAX));
+            }
+        }
+    }
+
+    /* several packets may have been enqueued meanwhile, the queues are checked once for all of them */
+    while (sem_trywait(&jit_wakeup) == 0);
+}
+
+static uint32_t beacon_freq_correct(uint32_t freq_hz) {
+    uint32_t corrected;
+    bool ok;
+    double correct;
+
+    /* Compensate beacon frequency with xtal error */
+    xcorr_get(&ok, &correct);
+    corrected = (uint32_t)(correct * (double)freq_hz);
+    MSG_DEBUG(DEBUG_BEACON, "beacon_pkt.freq_hz=%u (xtal_correct=%.15lf)\n", corrected, correct);
+
+    return corrected;
+}
+
+static void beacon_template_init(void) {
+    int i;
+    size_t beacon_RFU1_size = 0;
+    size_t beacon_RFU2_size = 0;
+    uint8_t beacon_pyld_idx = 0;
+
+    /* beacon data fields, byte 0 is Least Significant Byte */
+    int32_t field_latitude; /* 3 bytes, derived from reference latitude */
+    int32_t field_longitude; /* 3 bytes, derived from reference longitude */
+    uint16_t field_crc2;
+
+    /* beacon packet parameters */
+    memset(&beacon_template, 0, sizeof beacon_template);
+    beacon_template.tx_mode = ON_GPS; /* send on PPS pulse */
+    beacon_template.rf_chain = 0; /* antenna A */
+    beacon_template.rf_power = beacon_power;
+    beacon_template.modulation = MOD_LORA;
+    switch (beacon_bw_hz) {
+        case 125000:
+            beacon_template.bandwidth = BW_125KHZ;
+            break;
+        case 500000:
+            beacon_template.bandwidth = BW_500KHZ;
+            break;
+        default:
+            /* should not happen */
+            MSG("ERROR: unsupported bandwidth for beacon\n");
+            exit(EXIT_FAILURE);
+    }
+    switch (beacon_datarate) {
+        case 8:
+            beacon_template.datarate = DR_LORA_SF8;
+            beacon_RFU1_size = 1;
+            beacon_RFU2_size = 3;
+            break;
+        case 9:
+            beacon_template.datarate = DR_LORA_SF9;
+            beacon_RFU1_size = 2;
+            beacon_RFU2_size = 0;
+            break;
+        case 10:
+            beacon_template.datarate = DR_LORA_SF10;
+            beacon_RFU1_size = 3;
+            beacon_RFU2_size = 1;
+            break;
+        case 12:
+            beacon_template.datarate = DR_LORA_SF12;
+            beacon_RFU1_size = 5;
+            beacon_RFU2_size = 3;
+            break;
+        default:
+            /* should not happen */
+            MSG("ERROR: unsupported datarate for beacon\n");
+            exit(EXIT_FAILURE);
+    }
+    beacon_template.size = beacon_RFU1_size + 4 + 2 + 7 + beacon_RFU2_size + 2;
+    beacon_template.coderate = CR_LORA_4_5;
+    beacon_template.invert_pol = false;
+    beacon_template.preamble = 10;
+    beacon_template.no_crc = true;
+    beacon_template.no_header = true;
+
+    /* network common part beacon fields (little endian) */
+    for (i = 0; i < (int)beacon_RFU1_size; i++) {
+        beacon_template.payload[beacon_pyld_idx++] = 0x0;
+    }
+
+    /* network common part beacon fields (little endian) */
+    beacon_time_idx = beacon_pyld_idx;
+    beacon_pyld_idx += 4; /* time (variable), filled for each beacon */
+    beacon_pyld_idx += 2; /* crc1 (variable), filled for each beacon */
+
+    /* calculate the latitude and longitude that must be publicly reported */
+    field_latitude = (int32_t)((reference_coord.lat / 90.0) * (double)(1<<23));
+    if (field_latitude > (int32_t)0x007FFFFF) {
+        field_latitude = (int32_t)0x007FFFFF; /* +90 N is represented as 89.99999 N */
+    } else if (field_latitude < (int32_t)0xFF800000) {
+        field_latitude = (int32_t)0xFF800000;
+    }
+    field_longitude = (int32_t)((reference_coord.lon / 180.0) * (double)(1<<23));
+    if (field_longitude > (int32_t)0x007FFFFF) {
+        field_longitude = (int32_t)0x007FFFFF; /* +180 E is represented as 179.99999 E */
+    } else if (field_longitude < (int32_t)0xFF800000) {
+        field_longitude = (int32_t)0xFF800000;
+    }
+
+    /* gateway specific beacon fields */
+    beacon_template.payload[beacon_pyld_idx++] = beacon_infodesc;
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF &  field_latitude;
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF & (field_latitude >>  8);
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF & (field_latitude >> 16);
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF &  field_longitude;
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF & (field_longitude >>  8);
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF & (field_longitude >> 16);
+
+    /* RFU */
+    for (i = 0; i < (int)beacon_RFU2_size; i++) {
+        beacon_template.payload[beacon_pyld_idx++] = 0x0;
+    }
+
+    /* CRC of the beacon gateway specific part fields, constant */
+    field_crc2 = crc16_ccitt((beacon_template.payload + 6 + beacon_RFU1_size), 7 + beacon_RFU2_size);
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF &  field_crc2;
+    beacon_template.payload[beacon_pyld_idx++] = 0xFF & (field_crc2 >> 8);
+}
+
+static void beacon_prepare(struct lgw_pkt_tx_s * pkt, uint32_t gps_sec) {
+    uint8_t beacon_chan;
+    uint16_t field_crc1;
+
+    *pkt = beacon_template;
+
+    /* frequency hopping, the XTAL correction is applied by the JIT thread when the beacon is sent */
+    if (beacon_freq_nb > 1) {
+        beacon_chan = (gps_sec / beacon_period) % beacon_freq_nb; /* floor rounding */
+    } else {
+        beacon_chan = 0;
+    }
+    pkt->freq_hz = beacon_freq_hz + (beacon_chan * beacon_freq_step);
+
+    /* load time in beacon payload, and the CRC of the network common part */
+    put_le32(pkt->payload + beacon_time_idx, gps_sec);
+    field_crc1 = crc16_ccitt(pkt->payload, 4 + beacon_time_idx);
+    put_le16(pkt->payload + beacon_time_idx + 4, field_crc1);
+}
+
+static void put_le16(uint8_t * buf, uint16_t val) {
+    buf[0] = (uint8_t)(val >> 0);
+    buf[1] = (uint8_t)(val >> 8);
+}
+
+static void put_le32(uint8_t * buf, uint32_t val) {
+    put_le16(buf, (uint16_t)(val >> 0));
+    put_le16(buf + 2, (uint16_t)(val >> 16));
+}
+
+static void put_le64(uint8_t * buf, uint64_t val) {
+    put_le32(buf, (uint32_t)(val >> 0));
+    put_le32(buf + 4, (uint32_t)(val >> 32));
+}
+
+/* value in 0.1 units rounded to an integer, half away from zero */
+static int x10_round(int16_t val) {
+    return (val < 0) ? ((val - 5) / 10) : ((val + 5) / 10);
+}
+
+static int rxpk_serialize_bin(uint8_t * buf, const struct lgw_pkt_rx_s * p, const struct timespec * utc, const struct timespec * gps_time) {
+    uint8_t flags = 0;
+    uint16_t bw_khz = 0;
+    uint8_t codr = 0;
+    int8_t stat;
+
+    /* fixed size fields are all written, the flags tell which optional ones are valid */
+    memset(buf, 0, RXPK_BIN_SIZE);
+
+    /* RAW timestamp, UTC and GPS time of RX, fine timestamp */
+    put_le32(buf + 1, p->count_us);
+    if (p->ftime_received == true) {
+        flags |= RXPK_BIN_FLAG_FTIME;
+        put_le32(buf + 5, p->ftime);
+    }
+    if (utc != NULL) {
+        flags |= RXPK_BIN_FLAG_TIME;
+        put_le64(buf + 9, (uint64_t)utc->tv_sec * 1000000 + (uint64_t)(utc->tv_nsec / 1000));
+    }
+    if (gps_time != NULL) {
+        flags |= RXPK_BIN_FLAG_TMMS;
+        put_le64(buf + 17, (uint64_t)gps_time->tv_sec * 1000 + (uint64_t)(gps_time->tv_nsec / 1000000));
+    }
+    buf[0] = flags;
+
+    /* Packet RX frequency, concentrator channel, RF chain & modem */
+    put_le32(buf + 25, p->freq_hz);
+    buf[29] = p->if_chain;
+    buf[30] = p->rf_chain;
+    buf[31] = p->modem_id;
+
+    /* Packet status */
+    switch (p->status) {
+        case STAT_CRC_OK:   stat = 1;   break;
+        case STAT_CRC_BAD:  stat = -1;  break;
+        case STAT_NO_CRC:   stat = 0;   break;
+        default:
+            MSG("ERROR: [up] received packet with unknown status 0x%02X\n", p->status);
+            return -1;
+    }
+    buf[32] = (uint8_t)stat;
+
+    /* Packet modulation, datarate, bandwidth, coding rate and LoRa signal quality */
+    if (p->modulation == MOD_LORA) {
+        buf[33] = RXPK_BIN_MODU_LORA;
+        if ((p->datarate < DR_LORA_SF5) || (p->datarate > DR_LORA_SF12)) {
+            MSG("ERROR: [up] lora packet with unknown datarate 0x%02X\n", p->datarate);
+            return -1;
+        }
+        switch (p->bandwidth) {
+            case BW_125KHZ: bw_khz = 125; break;
+            case BW_250KHZ: bw_khz = 250; break;
+            case BW_500KHZ: bw_khz = 500; break;
+            default:
+                MSG("ERROR: [up] lora packet with unknown bandwidth 0x%02X\n", p->bandwidth);
+                return -1;
+        }
+        switch (p->coderate) {
+            case CR_LORA_4_5:   codr = 1; break;
+            case CR_LORA_4_6:   codr = 2; break;
+            case CR_LORA_4_7:   codr = 3; break;
+            case CR_LORA_4_8:   codr = 4; break;
+            case 0:             codr = 0; break; /* treat the CR0 case (mostly false sync) */
+            default:
+                MSG("ERROR: [up] lora packet with unknown coderate 0x%02X\n", p->coderate);
+                return -1;
+        }
+        put_le16(buf + 43, (uint16_t)p->rssis_x10);
+        put_le16(buf + 45, (uint16_t)p->snr_x10);
+        put_le32(buf + 47, (uint32_t)p->freq_offset);
+    } else if (p->modulation == MOD_FSK) {
+        buf[33] = RXPK_BIN_MODU_FSK;
+    } else {
+        MSG("ERROR: [up] received packet with unknown modulation 0x%02X\n", p->modulation);
+        return -1;
+    }
+    put_le32(buf + 34, p->datarate);
+    put_le16(buf + 38, bw_khz);
+    buf[40] = codr;
+
+    /* Channel RSSI, raw payload */
+    put_le16(buf + 41, (uint16_t)p->rssic_x10);
+    buf[51] = (uint8_t)p->size;
+    memcpy(buf + RXPK_BIN_SIZE, p->payload, p->size);
+
+    return RXPK_BIN_SIZE + p->size;
+}
+
+static int utc_to_iso8601(char * out, const struct timespec * utc) {
+    /* only used by the upstream thread, the packets of a fetch are usually in the same second */
+    static time_t cache_sec = 0;
+    static char cache_str[20]; /* YYYY-MM-DDThh:mm:ss */
+    struct tm x; /* broken-up UTC time */
+    char * o;
+
+    if ((utc->tv_sec != cache_sec) || (cache_str[0] == '\0')) {
+        /* split the UNIX timestamp to its calendar components */
+        gmtime_r(&(utc->tv_sec), &x);
+        o = cache_str;
+        o += jsonw_uint_pad(o, (x.tm_year)+1900, 4, '0');
+        *o++ = '-';
+        o += jsonw_uint_pad(o, (x.tm_mon)+1, 2, '0');
+        *o++ = '-';
+        o += jsonw_uint_pad(o, x.tm_mday, 2, '0');
+        *o++ = 'T';
+        o += jsonw_uint_pad(o, x.tm_hour, 2, '0');
+        *o++ = ':';
+        o += jsonw_uint_pad(o, x.tm_min, 2, '0');
+        *o++ = ':';
+        o += jsonw_uint_pad(o, x.tm_sec, 2, '0');
+        *o = '\0';
+        cache_sec = utc->tv_sec;
+    }
+
+    /* ISO 8601 format, microseconds resolution */
+    o = out;
+    memcpy(o, cache_str, 19);
+    o += 19;
+    *o++ = '.';
+    o += jsonw_uint_pad(o, (utc->tv_nsec)/1000, 6, '0');
+    *o++ = 'Z';
+
+    return o - out;
+}
+
+static void rxpk_log(const struct lgw_pkt_rx_s * p) {
+    int k;
+
+    if (p->modulation == MOD_LORA) {
+        /* Log nb of packets per channel, per SF */
+        nb_pkt_log[p->if_chain][p->datarate - 5] += 1;
+        nb_pkt_received_lora += 1;
+
+        /* Log nb of packets for ref_payload (DEBUG) */
+        for (k = 0; k < debugconf.nb_ref_payload; k++) {
+            if ((p->payload[0] == (uint8_t)(debugconf.ref_payload[k].id >> 24)) &&
+                (p->payload[1] == (uint8_t)(debugconf.ref_payload[k].id >> 16)) &&
+                (p->payload[2] == (uint8_t)(debugconf.ref_payload[k].id >> 8))  &&
+                (p->payload[3] == (uint8_t)(debugconf.ref_payload[k].id >> 0))) {
+                    nb_pkt_received_ref[k] += 1;
+                }
+        }
+    } else if (p->modulation == MOD_FSK) {
+        nb_pkt_log[p->if_chain][0] += 1;
+        nb_pkt_received_fsk += 1;
+    }
+}
+
+static int tx_ack_format(uint8_t * buff_ack, uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value) {
     int buff_index;
     int j;
 
     /* reset buffer */
-    memset(&buff_ack, 0, sizeof buff_ack);
+    memset(buff_ack, 0, ACK_BUFF_SIZE);
 
     /* Prepare downlink feedback to be sent to server */
     buff_ack[0] = PROTOCOL_VERSION;
@@ -1347,33 +3439,25 @@ static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error,
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"COLLISION_PACKET\"", 18);
                 buff_index += 18;
                 /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_collision_packet += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
+                MEAS_ADD(meas_dw.tx_rejected_collision_packet, 1);
                 break;
             case JIT_ERROR_TOO_LATE:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"TOO_LATE\"", 10);
                 buff_index += 10;
                 /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_too_late += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
+                MEAS_ADD(meas_dw.tx_rejected_too_late, 1);
                 break;
             case JIT_ERROR_TOO_EARLY:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"TOO_EARLY\"", 11);
                 buff_index += 11;
                 /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_too_early += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
+                MEAS_ADD(meas_dw.tx_rejected_too_early, 1);
                 break;
             case JIT_ERROR_COLLISION_BEACON:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"COLLISION_BEACON\"", 18);
                 buff_index += 18;
                 /* update stats */
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_rejected_collision_beacon += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
+                MEAS_ADD(meas_dw.tx_rejected_collision_beacon, 1);
                 break;
             case JIT_ERROR_TX_FREQ:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"TX_FREQ\"", 9);
@@ -1387,6 +3471,10 @@ static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error,
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"GPS_UNLOCKED\"", 14);
                 buff_index += 14;
                 break;
+            case JIT_ERROR_DUTY_CYCLE:
+                memcpy((void *)(buff_ack + buff_index), (void *)"\"DUTY_CYCLE\"", 12);
+                buff_index += 12;
+                break;
             default:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"UNKNOWN\"", 9);
                 buff_index += 9;
@@ -1414,8 +3502,175 @@ static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error,
 
     buff_ack[buff_index] = 0; /* add string terminator, for safety */
 
-    /* send datagram to server */
-    return send(sock_down, (void *)buff_ack, buff_index, 0);
+    return buff_index;
+}
+
+static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value) {
+    uint8_t * buff_ack; /* buffer to give feedback to server */
+    int buff_index;
+
+    /* take the next slot of the TX_ACK batch */
+    if (tx_ack_nb == DOWN_BATCH_NB) {
+        flush_tx_ack();
+    }
+    buff_ack = tx_ack_buff[tx_ack_nb];
+    buff_index = tx_ack_format(buff_ack, token_h, token_l, error, error_value);
+
+    /* datagram is sent to server with the rest of the batch by flush_tx_ack */
+    tx_ack_iov[tx_ack_nb].iov_base = (void *)buff_ack;
+    tx_ack_iov[tx_ack_nb].iov_len = buff_index;
+    memset(&tx_ack_msg[tx_ack_nb], 0, sizeof tx_ack_msg[tx_ack_nb]);
+    tx_ack_msg[tx_ack_nb].msg_hdr.msg_iov = &tx_ack_iov[tx_ack_nb];
+    tx_ack_msg[tx_ack_nb].msg_hdr.msg_iovlen = 1;
+    tx_ack_nb += 1;
+
+    return buff_index;
+}
+
+static void flush_tx_ack(void) {
+    int i = 0;
+    int j;
+
+    /* sendmmsg can stop before the end of the batch, resume until all TX_ACK are sent or an error occurs */
+    while (i < tx_ack_nb) {
+        j = sendmmsg(sock_down, &tx_ack_msg[i], tx_ack_nb - i, 0);
+        if (j <= 0) {
+            MSG("WARNING: [down] failed to send %d TX_ACK, %s\n", tx_ack_nb - i, strerror(errno));
+            break;
+        }
+        i += j;
+    }
+    tx_ack_nb = 0;
+}
+
+static void down_token_add(uint8_t rf_chain, uint64_t count_us64, uint8_t token_h, uint8_t token_l) {
+    pthread_mutex_lock(&mx_down_token);
+    down_token[down_token_idx].used = true;
+    down_token[down_token_idx].rf_chain = rf_chain;
+    down_token[down_token_idx].token_h = token_h;
+    down_token[down_token_idx].token_l = token_l;
+    down_token[down_token_idx].count_us64 = count_us64;
+    down_token_idx = (down_token_idx + 1) % DOWN_TOKEN_NB;
+    pthread_mutex_unlock(&mx_down_token);
+}
+
+static void jit_flush_collect(const struct lgw_pkt_tx_s * pkt, enum jit_pkt_type_e pkt_type, void * arg) {
+    struct jit_flush_s * flush = arg;
+
+    if (pkt_type == JIT_PKT_TYPE_BEACON) {
+        flush->nb_beacon += 1;
+    } else if (flush->nb_downlink < JIT_QUEUE_SIZE_MAX) {
+        flush->count_us64[flush->nb_downlink] = pkt->count_us64;
+        flush->nb_downlink += 1;
+    }
+}
+
+static void downlinks_flush(void) {
+    static struct jit_flush_s flush; /* only used by the fetch thread */
+    uint8_t buff_ack[ACK_BUFF_SIZE];
+    int nb_nack = 0;
+    int len;
+    int i, j, k;
+
+    /* the queued timestamps refer to the counter before the restart, the downlinks can not be sent */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        flush.nb_downlink = 0;
+        flush.nb_beacon = 0;
+        if (jit_flush(&jit_queue[i], jit_flush_collect, &flush) == 0) {
+            continue;
+        }
+        MSG("WARNING: [fetch] %d downlinks and %d beacons flushed from JiT queue %d\n", flush.nb_downlink, flush.nb_beacon, i);
+
+        /* their TX_ACK was already sent when they were queued, a second one reports the failure */
+        pthread_mutex_lock(&mx_down_token);
+        for (j = 0; j < flush.nb_downlink; j++) {
+            for (k = 0; k < DOWN_TOKEN_NB; k++) {
+                if ((down_token[k].used == true) && (down_token[k].rf_chain == i) && (down_token[k].count_us64 == flush.count_us64[j])) {
+                    len = tx_ack_format(buff_ack, down_token[k].token_h, down_token[k].token_l, JIT_ERROR_TOO_LATE, 0);
+                    if (send(sock_down, buff_ack, len, 0) >= 0) {
+                        nb_nack += 1;
+                    }
+                    down_token[k].used = false;
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&mx_down_token);
+    }
+    if (nb_nack > 0) {
+        MSG("INFO: [fetch] %d flushed downlinks reported TOO_LATE to the server\n", nb_nack);
+    }
+
+    /* the tokens of the downlinks sent meanwhile are not needed anymore */
+    pthread_mutex_lock(&mx_down_token);
+    memset(down_token, 0, sizeof down_token);
+    pthread_mutex_unlock(&mx_down_token);
+}
+
+static void timeref_reset(void) {
+    /* the synchronizations were made against the counter before the restart, start again from scratch */
+    /* the XTAL correction is invalidated by the validation thread, once the reference is found invalid */
+    pthread_mutex_lock(&mx_timeref);
+    lgw_clock_init(&gps_clock);
+    seq_write_begin(&seq_timeref);
+    gps_ref_valid = false;
+    time_reference_gps.systime = 0;
+    seq_write_end(&seq_timeref);
+    pthread_mutex_unlock(&mx_timeref);
+}
+
+static bool concentrator_recover(void) {
+    int i, x;
+    bool restarted = false;
+
+    for (i = 0; (i < RECOVER_NB_TRY) && !exit_sig && !quit_sig; i++) {
+        wait_ms(RECOVER_WAIT_MS);
+        x = concent_run(&concent, CONCENT_CMD_RECOVER, cmd_recover, &restarted);
+        if (x == LGW_HAL_SUCCESS) {
+            if (restarted == true) {
+                MSG("WARNING: [fetch] concentrator restarted, packets received during the link outage are lost\n");
+                downlinks_flush();
+                if (gps_enabled == true) {
+                    timeref_reset();
+                    MSG("WARNING: [fetch] GPS time reference reset, the counter restarted\n");
+                }
+            } else {
+                MSG("INFO: [fetch] concentrator link recovered\n");
+            }
+            return true;
+        }
+        MSG("WARNING: [fetch] concentrator recovery failed (try %d/%d)\n", i + 1, RECOVER_NB_TRY);
+    }
+
+    return false;
+}
+
+static void thread_sched_apply(pthread_t thrid, int thread) {
+    struct sched_param param;
+    cpu_set_t cpus;
+    int i;
+
+    /* a thread which can not be configured still runs, with the default scheduling */
+    if (thread_conf[thread].policy != SCHED_OTHER) {
+        memset(&param, 0, sizeof param);
+        param.sched_priority = thread_conf[thread].priority;
+        i = pthread_setschedparam(thrid, thread_conf[thread].policy, &param);
+        if (i != 0) {
+            MSG("WARNING: [main] failed to set the scheduling of the %s thread, %s\n", thread_name[thread], strerror(i));
+        }
+    }
+    if (thread_conf[thread].cpu_mask != 0) {
+        CPU_ZERO(&cpus);
+        for (i = 0; i < 64; i++) {
+            if ((thread_conf[thread].cpu_mask & ((uint64_t)1 << i)) != 0) {
+                CPU_SET(i, &cpus);
+            }
+        }
+        i = pthread_setaffinity_np(thrid, sizeof cpus, &cpus);
+        if (i != 0) {
+            MSG("WARNING: [main] failed to set the CPU affinity of the %s thread, %s\n", thread_name[thread], strerror(i));
+        }
+    }
 }
 
 /* -------------------------------------------------------------------------- */
@@ -1424,21 +3679,28 @@ static int send_tx_ack(uint8_t token_h, uint8_t token_l, enum jit_error_e error,
 int main(int argc, char ** argv)
 {
     struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
-    int i; /* loop variable and temporary variable for return value */
+    int i, j, k; /* loop variables and temporary variable for return value */
     int x;
     int l, m;
+    int s; /* upstream server index */
 
     /* configuration file related */
     const char defaut_conf_fname[] = JSON_CONF_DEFAULT;
     const char * conf_fname = defaut_conf_fname; /* pointer to a string we won't touch */
+    const char * snap_fname = NULL; /* binary snapshot of the parsed configuration, not used by default */
+    uint64_t snap_hash = 0;
+    bool snap_ok = false; /* hash of the configuration file computed */
 
     /* threads */
+    pthread_t thrid_fetch;
     pthread_t thrid_up;
     pthread_t thrid_down;
     pthread_t thrid_gps;
     pthread_t thrid_valid;
     pthread_t thrid_jit;
+    pthread_t thrid_beacon;
     pthread_t thrid_ss;
+    pthread_t thrid_concent;
 
     /* network socket creation */
     struct addrinfo hints;
@@ -1453,10 +3715,18 @@ int main(int argc, char ** argv)
     uint32_t cp_nb_rx_bad;
     uint32_t cp_nb_rx_nocrc;
     uint32_t cp_up_pkt_fwd;
+    uint32_t cp_up_drop_devaddr;
+    uint32_t cp_up_drop_join_eui;
+    uint32_t cp_up_drop_dup;
     uint32_t cp_up_network_byte;
     uint32_t cp_up_payload_byte;
     uint32_t cp_up_dgram_sent;
-    uint32_t cp_up_ack_rcv;
+    uint32_t cp_up_ack_rcv[UP_SERV_NB_MAX];
+    uint32_t cp_up_jrn_replayed;
+    uint32_t cp_up_lz4_in_byte;
+    uint32_t cp_up_lz4_out_byte;
+    uint32_t cp_up_jrn_backlog;
+    uint32_t cp_up_jrn_dropped;
     uint32_t cp_dw_pull_sent;
     uint32_t cp_dw_ack_rcv;
     uint32_t cp_dw_dgram_rcv;
@@ -1464,24 +3734,52 @@ int main(int argc, char ** argv)
     uint32_t cp_dw_payload_byte;
     uint32_t cp_nb_tx_ok;
     uint32_t cp_nb_tx_fail;
+    uint32_t cp_nb_tx_late;
+    uint32_t cp_nb_jit_wakeup_late;
+    uint32_t cp_jit_wakeup_late_max_us;
     uint32_t cp_nb_tx_requested = 0;
     uint32_t cp_nb_tx_rejected_collision_packet = 0;
     uint32_t cp_nb_tx_rejected_collision_beacon = 0;
     uint32_t cp_nb_tx_rejected_too_late = 0;
     uint32_t cp_nb_tx_rejected_too_early = 0;
+    uint32_t cp_nb_tx_rejected_admission = 0;
+    struct jit_airtime_stat_s airtime_stat[JIT_AIRTIME_BAND_NB_MAX];
     uint32_t cp_nb_beacon_queued = 0;
     uint32_t cp_nb_beacon_sent = 0;
     uint32_t cp_nb_beacon_rejected = 0;
+    struct meas_up_s up_now, up_prev = {0};
+    uint32_t cp_up_lat[UP_LAT_NB][UP_LAT_BIN_NB];
+    uint32_t cp_up_ack_rtt[UP_SERV_NB_MAX][UP_LAT_BIN_NB];
+    struct meas_dw_s dw_now, dw_prev = {0};
+    struct meas_jit_s jit_now, jit_prev = {0};
+    struct meas_bcn_s bcn_now;
 
     /* GPS coordinates variables */
     bool coord_ok = false;
     struct coord_s cp_gps_coord = {0.0, 0.0, 0};
+    bool ref_ok;
+    struct tref local_ref;
 
     /* SX1302 data variables */
     uint32_t trig_tstamp;
-    uint32_t inst_tstamp;
+    struct lgw_com_stats_s com_stats;
+    struct lgw_rx_stats_s rx_stats;
+    struct lgw_chan_stats_s chan_stats;
+    struct lgw_chan_stat_s chan_sum[LGW_IF_CHAIN_NB];
+    bool chan_stats_ok;
+    struct lgw_arb_stats_s arb_stats;
+    bool arb_stats_ok;
+    bool rx_stats_ok, com_stats_ok;
+    uint32_t arb_detect, arb_alloc;
+    int16_t rssi_mean, snr_mean;
+    uint16_t rssi_std, snr_std;
+    uint64_t inst_tstamp;
     uint64_t eui;
     float temperature;
+    struct cmd_rx_stats_s cmd_rx = { &rx_stats, &chan_stats, &arb_stats, false, false };
+    struct cmd_counter_s cmd_cnt = { &inst_tstamp, &trig_tstamp };
+    struct concent_stat_s concent_stat[CONCENT_PRIO_NB];
+    const char * concent_prio_str[CONCENT_PRIO_NB] = { "TX", "RX", "housekeeping" };
 
     /* statistics variable */
     time_t t;
@@ -1491,9 +3789,14 @@ int main(int argc, char ** argv)
     float rx_nocrc_ratio;
     float up_ack_ratio;
     float dw_ack_ratio;
+    int rep_len;
+
+    /* spectral scan summary */
+    struct lgw_spectral_summary_s spec_sum[LGW_SPECTRAL_FREQ_NB_MAX];
+    int nb_spec = 0;
 
     /* Parse command line options */
-    while( (i = getopt( argc, argv, "hc:" )) != -1 )
+    while( (i = getopt( argc, argv, "hc:s:" )) != -1 )
     {
         switch( i )
         {
@@ -1506,6 +3809,10 @@ int main(int argc, char ** argv)
             conf_fname = optarg;
             break;
 
+        case 's':
+            snap_fname = optarg;
+            break;
+
         default:
             printf( "ERROR: argument parsing options, use -h option for help\n" );
             usage( );
@@ -1527,7 +3834,12 @@ int main(int argc, char ** argv)
     #endif
 
     /* load configuration files */
-    if (access(conf_fname, R_OK) == 0) { /* if there is a global conf, parse it  */
+    if (snap_fname != NULL) {
+        snap_ok = (conf_snap_hash(conf_fname, &snap_hash) == 0);
+    }
+    if (snap_ok && (conf_snap_load(snap_fname, snap_hash) == 0)) {
+        MSG("INFO: configuration loaded from snapshot %s, matching %s\n", snap_fname, conf_fname);
+    } else if (access(conf_fname, R_OK) == 0) { /* if there is a global conf, parse it  */
         MSG("INFO: found configuration file %s, parsing it\n", conf_fname);
         x = parse_SX130x_configuration(conf_fname);
         if (x != 0) {
@@ -1541,6 +3853,9 @@ int main(int argc, char ** argv)
         if (x != 0) {
             MSG("INFO: no debug configuration\n");
         }
+        if (snap_ok) {
+            conf_snap_save(snap_fname, snap_hash);
+        }
     } else {
         MSG("ERROR: [main] failed to find any configuration file named %s\n", conf_fname);
         exit(EXIT_FAILURE);
@@ -1548,6 +3863,7 @@ int main(int argc, char ** argv)
 
     /* Start GPS a.s.a.p., to allow it to lock */
     if (gps_tty_path[0] != '\0') { /* do not try to open GPS device if no path set */
+        lgw_clock_init(&gps_clock);
         i = lgw_gps_enable(gps_tty_path, "ubx7", 0, &gps_tty_fd); /* HAL only supports u-blox 7 for now */
         if (i != LGW_GPS_SUCCESS) {
             printf("WARNING: [main] impossible to open %s for GPS sync (check permissions)\n", gps_tty_path);
@@ -1599,14 +3915,28 @@ int main(int argc, char ** argv)
         exit(EXIT_FAILURE);
     }
 
-    /* connect so we can send/receive packet with the server only */
-    i = connect(sock_up, q->ai_addr, q->ai_addrlen);
-    if (i != 0) {
-        MSG("ERROR: [up] connect returned %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
+    /* the socket is shared by all the upstream servers, it is not connected and the destination is given per datagram */
+    strncpy(up_server[0].addr, serv_addr, sizeof up_server[0].addr);
+    up_server[0].addr[sizeof up_server[0].addr - 1] = '\0'; /* ensure string termination */
+    strncpy(up_server[0].port, serv_port_up, sizeof up_server[0].port);
+    up_server[0].port[sizeof up_server[0].port - 1] = '\0'; /* ensure string termination */
+    memcpy(&up_server[0].sa, q->ai_addr, q->ai_addrlen);
+    up_server[0].sa_len = q->ai_addrlen;
     freeaddrinfo(result);
 
+    /* look for the addresses of the extra upstream servers */
+    for (s = 1; s < up_server_nb; s++) {
+        hints.ai_family = up_server[0].sa.ss_family; /* must be reachable from the upstream socket */
+        i = getaddrinfo(up_server[s].addr, up_server[s].port, &hints, &result);
+        if (i != 0) {
+            MSG("ERROR: [up] getaddrinfo on address %s (PORT %s) returned %s\n", up_server[s].addr, up_server[s].port, gai_strerror(i));
+            exit(EXIT_FAILURE);
+        }
+        memcpy(&up_server[s].sa, result->ai_addr, result->ai_addrlen);
+        up_server[s].sa_len = result->ai_addrlen;
+        freeaddrinfo(result);
+    }
+
     /* look for server address w/ downstream port */
     i = getaddrinfo(serv_addr, serv_port_down, &hints, &result);
     if (i != 0) {
@@ -1670,30 +4000,115 @@ int main(int argc, char ** argv)
         printf("INFO: concentrator EUI: 0x%016" PRIx64 "\n", eui);
     }
 
+    /* start decoding binary trace records, if any is compiled in */
+    if ((TRACE_PKT_FWD > 0) || LGW_TRACE_ENABLED) {
+        i = lgw_trace_start(stdout, 100);
+        if (i != LGW_TRACE_SUCCESS) {
+            MSG("WARNING: [main] failed to start trace decoding\n");
+        }
+    }
+
     /* spawn threads to manage upstream and downstream */
+    if ((rx_queue_init(&rx_queue) != 0) || (pkt_pool_init(&pkt_pool) != 0)) {
+        MSG("ERROR: [main] failed to initialize uplink queue\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (jit_queue_init(&jit_queue[i], jit_queue_size) != JIT_ERROR_OK) {
+            MSG("ERROR: [main] failed to initialize JIT queue %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (jit_airtime_init(airtime_band, airtime_band_nb) != JIT_ERROR_OK) {
+        MSG("ERROR: [main] failed to initialize TX duty cycle accounting\n");
+        exit(EXIT_FAILURE);
+    }
+    /* before the signal handlers are installed, sig_handler posts it */
+    if (sem_init(&jit_wakeup, 0, 0) != 0) {
+        MSG("ERROR: [main] failed to initialize JIT wake-up semaphore\n");
+        exit(EXIT_FAILURE);
+    }
+    exit_fd = eventfd(0, EFD_NONBLOCK);
+    report_fd = eventfd(0, EFD_NONBLOCK);
+    if ((exit_fd < 0) || (report_fd < 0)) {
+        MSG("ERROR: [main] failed to create eventfd, %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if ((journal_path[0] != '\0') && (journal_open(&journal, journal_path, journal_size) != 0)) {
+        MSG("ERROR: [main] failed to open upstream journal %s (size must be at least %u bytes)\n", journal_path, JOURNAL_SIZE_MIN);
+        exit(EXIT_FAILURE);
+    }
+    if ((metrics_endpoint[0] != '\0') && (metrics_start(&metrics, metrics_endpoint) != 0)) {
+        MSG("ERROR: [main] failed to open metrics endpoint %s\n", metrics_endpoint);
+        exit(EXIT_FAILURE);
+    }
+    if (metrics_hal_perf == true) {
+        lgw_perf_enable(true);
+    }
+    if (concent_init(&concent, concent_thread) != 0) {
+        MSG("ERROR: [main] failed to initialize concentrator access\n");
+        exit(EXIT_FAILURE);
+    }
+    /* lock the memory once allocated, before the threads start */
+    if ((mem_lock == true) && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)) {
+        MSG("WARNING: [main] failed to lock the memory of the process, %s\n", strerror(errno));
+    }
+
+    /* the command thread, if enabled, serves the concentrator requests of all the other threads */
+    if (concent_thread == true) {
+        i = pthread_create(&thrid_concent, NULL, (void * (*)(void *))thread_concent, NULL);
+        if (i != 0) {
+            MSG("ERROR: [main] impossible to create concentrator command thread\n");
+            exit(EXIT_FAILURE);
+        }
+        thread_sched_apply(thrid_concent, THREAD_CONCENT);
+    }
+
+    i = pthread_create(&thrid_fetch, NULL, (void * (*)(void *))thread_fetch, NULL);
+    if (i != 0) {
+        MSG("ERROR: [main] impossible to create fetch thread\n");
+        exit(EXIT_FAILURE);
+    }
+    thread_sched_apply(thrid_fetch, THREAD_FETCH);
     i = pthread_create(&thrid_up, NULL, (void * (*)(void *))thread_up, NULL);
     if (i != 0) {
         MSG("ERROR: [main] impossible to create upstream thread\n");
         exit(EXIT_FAILURE);
     }
+    thread_sched_apply(thrid_up, THREAD_UP);
     i = pthread_create(&thrid_down, NULL, (void * (*)(void *))thread_down, NULL);
     if (i != 0) {
         MSG("ERROR: [main] impossible to create downstream thread\n");
         exit(EXIT_FAILURE);
     }
+    thread_sched_apply(thrid_down, THREAD_DOWN);
     i = pthread_create(&thrid_jit, NULL, (void * (*)(void *))thread_jit, NULL);
     if (i != 0) {
         MSG("ERROR: [main] impossible to create JIT thread\n");
         exit(EXIT_FAILURE);
     }
+    thread_sched_apply(thrid_jit, THREAD_JIT);
+
+    /* spawn thread to prepare beacons, the frames are computed once for all */
+    if (beacon_period > 0) {
+        beacon_template_init();
+        i = pthread_create(&thrid_beacon, NULL, (void * (*)(void *))thread_beacon, NULL);
+        if (i != 0) {
+            MSG("ERROR: [main] impossible to create beacon thread\n");
+            exit(EXIT_FAILURE);
+        }
+        thread_sched_apply(thrid_beacon, THREAD_BEACON);
+    }
 
     /* spawn thread for background spectral scan */
     if (spectral_scan_params.enable == true) {
+        lgw_spectral_agg_init(&spectral_agg, SPECTRAL_AGG_DECAY_SHIFT);
         i = pthread_create(&thrid_ss, NULL, (void * (*)(void *))thread_spectral_scan, NULL);
         if (i != 0) {
             MSG("ERROR: [main] impossible to create Spectral Scan thread\n");
             exit(EXIT_FAILURE);
         }
+        thread_sched_apply(thrid_ss, THREAD_SPECTRAL_SCAN);
     }
 
     /* spawn thread to manage GPS */
@@ -1703,11 +4118,13 @@ int main(int argc, char ** argv)
             MSG("ERROR: [main] impossible to create GPS thread\n");
             exit(EXIT_FAILURE);
         }
+        thread_sched_apply(thrid_gps, THREAD_GPS);
         i = pthread_create(&thrid_valid, NULL, (void * (*)(void *))thread_valid, NULL);
         if (i != 0) {
             MSG("ERROR: [main] impossible to create validation thread\n");
             exit(EXIT_FAILURE);
         }
+        thread_sched_apply(thrid_valid, THREAD_VALID);
     }
 
     /* configure signal handling */
@@ -1727,27 +4144,38 @@ int main(int argc, char ** argv)
         t = time(NULL);
         strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&t));
 
-        /* access upstream statistics, copy and reset them */
-        pthread_mutex_lock(&mx_meas_up);
-        cp_nb_rx_rcv       = meas_nb_rx_rcv;
-        cp_nb_rx_ok        = meas_nb_rx_ok;
-        cp_nb_rx_bad       = meas_nb_rx_bad;
-        cp_nb_rx_nocrc     = meas_nb_rx_nocrc;
-        cp_up_pkt_fwd      = meas_up_pkt_fwd;
-        cp_up_network_byte = meas_up_network_byte;
-        cp_up_payload_byte = meas_up_payload_byte;
-        cp_up_dgram_sent   = meas_up_dgram_sent;
-        cp_up_ack_rcv      = meas_up_ack_rcv;
-        meas_nb_rx_rcv = 0;
-        meas_nb_rx_ok = 0;
-        meas_nb_rx_bad = 0;
-        meas_nb_rx_nocrc = 0;
-        meas_up_pkt_fwd = 0;
-        meas_up_network_byte = 0;
-        meas_up_payload_byte = 0;
-        meas_up_dgram_sent = 0;
-        meas_up_ack_rcv = 0;
-        pthread_mutex_unlock(&mx_meas_up);
+        /* read upstream statistics, the report gives the increase since the previous one */
+        meas_snapshot(&up_now, &meas_up, sizeof up_now);
+        cp_nb_rx_rcv       = up_now.rx_rcv - up_prev.rx_rcv;
+        cp_nb_rx_ok        = up_now.rx_ok - up_prev.rx_ok;
+        cp_nb_rx_bad       = up_now.rx_bad - up_prev.rx_bad;
+        cp_nb_rx_nocrc     = up_now.rx_nocrc - up_prev.rx_nocrc;
+        cp_up_pkt_fwd      = up_now.pkt_fwd - up_prev.pkt_fwd;
+        cp_up_drop_devaddr  = up_now.rx_drop_devaddr - up_prev.rx_drop_devaddr;
+        cp_up_drop_join_eui = up_now.rx_drop_join_eui - up_prev.rx_drop_join_eui;
+        cp_up_drop_dup      = up_now.rx_drop_dup - up_prev.rx_drop_dup;
+        cp_up_network_byte = up_now.network_byte - up_prev.network_byte;
+        cp_up_payload_byte = up_now.payload_byte - up_prev.payload_byte;
+        cp_up_dgram_sent   = up_now.dgram_sent - up_prev.dgram_sent;
+        for (s = 0; s < UP_SERV_NB_MAX; s++) {
+            cp_up_ack_rcv[s] = up_now.ack_rcv[s] - up_prev.ack_rcv[s];
+        }
+        cp_up_jrn_replayed = up_now.jrn_replayed - up_prev.jrn_replayed;
+        cp_up_lz4_in_byte  = up_now.lz4_in_byte - up_prev.lz4_in_byte;
+        cp_up_lz4_out_byte = up_now.lz4_out_byte - up_prev.lz4_out_byte;
+        cp_up_jrn_backlog  = up_now.jrn_backlog;
+        cp_up_jrn_dropped  = up_now.jrn_dropped;
+        for (i = 0; i < UP_LAT_NB; i++) {
+            for (j = 0; j < UP_LAT_BIN_NB; j++) {
+                cp_up_lat[i][j] = up_now.lat_hist[i][j] - up_prev.lat_hist[i][j];
+            }
+        }
+        for (s = 0; s < UP_SERV_NB_MAX; s++) {
+            for (j = 0; j < UP_LAT_BIN_NB; j++) {
+                cp_up_ack_rtt[s][j] = up_now.ack_rtt_hist[s][j] - up_prev.ack_rtt_hist[s][j];
+            }
+        }
+        up_prev = up_now;
         if (cp_nb_rx_rcv > 0) {
             rx_ok_ratio = (float)cp_nb_rx_ok / (float)cp_nb_rx_rcv;
             rx_bad_ratio = (float)cp_nb_rx_bad / (float)cp_nb_rx_rcv;
@@ -1758,44 +4186,36 @@ int main(int argc, char ** argv)
             rx_nocrc_ratio = 0.0;
         }
         if (cp_up_dgram_sent > 0) {
-            up_ack_ratio = (float)cp_up_ack_rcv / (float)cp_up_dgram_sent;
+            up_ack_ratio = (float)cp_up_ack_rcv[0] / (float)cp_up_dgram_sent; /* primary server */
         } else {
             up_ack_ratio = 0.0;
         }
 
-        /* access downstream statistics, copy and reset them */
-        pthread_mutex_lock(&mx_meas_dw);
-        cp_dw_pull_sent    =  meas_dw_pull_sent;
-        cp_dw_ack_rcv      =  meas_dw_ack_rcv;
-        cp_dw_dgram_rcv    =  meas_dw_dgram_rcv;
-        cp_dw_network_byte =  meas_dw_network_byte;
-        cp_dw_payload_byte =  meas_dw_payload_byte;
-        cp_nb_tx_ok        =  meas_nb_tx_ok;
-        cp_nb_tx_fail      =  meas_nb_tx_fail;
-        cp_nb_tx_requested                 +=  meas_nb_tx_requested;
-        cp_nb_tx_rejected_collision_packet +=  meas_nb_tx_rejected_collision_packet;
-        cp_nb_tx_rejected_collision_beacon +=  meas_nb_tx_rejected_collision_beacon;
-        cp_nb_tx_rejected_too_late         +=  meas_nb_tx_rejected_too_late;
-        cp_nb_tx_rejected_too_early        +=  meas_nb_tx_rejected_too_early;
-        cp_nb_beacon_queued   +=  meas_nb_beacon_queued;
-        cp_nb_beacon_sent     +=  meas_nb_beacon_sent;
-        cp_nb_beacon_rejected +=  meas_nb_beacon_rejected;
-        meas_dw_pull_sent = 0;
-        meas_dw_ack_rcv = 0;
-        meas_dw_dgram_rcv = 0;
-        meas_dw_network_byte = 0;
-        meas_dw_payload_byte = 0;
-        meas_nb_tx_ok = 0;
-        meas_nb_tx_fail = 0;
-        meas_nb_tx_requested = 0;
-        meas_nb_tx_rejected_collision_packet = 0;
-        meas_nb_tx_rejected_collision_beacon = 0;
-        meas_nb_tx_rejected_too_late = 0;
-        meas_nb_tx_rejected_too_early = 0;
-        meas_nb_beacon_queued = 0;
-        meas_nb_beacon_sent = 0;
-        meas_nb_beacon_rejected = 0;
-        pthread_mutex_unlock(&mx_meas_dw);
+        /* read downstream statistics, TX rejections and beacons are reported since start */
+        meas_snapshot(&dw_now, &meas_dw, sizeof dw_now);
+        meas_snapshot(&jit_now, &meas_jit, sizeof jit_now);
+        meas_snapshot(&bcn_now, &meas_bcn, sizeof bcn_now);
+        cp_dw_pull_sent    = dw_now.pull_sent - dw_prev.pull_sent;
+        cp_dw_ack_rcv      = dw_now.ack_rcv - dw_prev.ack_rcv;
+        cp_dw_dgram_rcv    = dw_now.dgram_rcv - dw_prev.dgram_rcv;
+        cp_dw_network_byte = dw_now.network_byte - dw_prev.network_byte;
+        cp_dw_payload_byte = dw_now.payload_byte - dw_prev.payload_byte;
+        cp_nb_tx_ok        = jit_now.tx_ok - jit_prev.tx_ok;
+        cp_nb_tx_fail      = jit_now.tx_fail - jit_prev.tx_fail;
+        cp_nb_tx_late             = jit_now.tx_late;
+        cp_nb_jit_wakeup_late     = jit_now.wakeup_late;
+        cp_jit_wakeup_late_max_us = jit_now.wakeup_late_max_us;
+        cp_nb_tx_requested                 = dw_now.tx_requested;
+        cp_nb_tx_rejected_collision_packet = dw_now.tx_rejected_collision_packet;
+        cp_nb_tx_rejected_collision_beacon = dw_now.tx_rejected_collision_beacon;
+        cp_nb_tx_rejected_too_late         = dw_now.tx_rejected_too_late;
+        cp_nb_tx_rejected_too_early        = dw_now.tx_rejected_too_early;
+        cp_nb_tx_rejected_admission        = dw_now.tx_rejected_admission;
+        cp_nb_beacon_queued   = bcn_now.beacon_queued;
+        cp_nb_beacon_sent     = jit_now.beacon_sent;
+        cp_nb_beacon_rejected = bcn_now.beacon_rejected;
+        dw_prev = dw_now;
+        jit_prev = jit_now;
         if (cp_dw_pull_sent > 0) {
             dw_ack_ratio = (float)cp_dw_ack_rcv / (float)cp_dw_pull_sent;
         } else {
@@ -1821,33 +4241,109 @@ int main(int argc, char ** argv)
         printf("# RF packets received by concentrator: %u\n", cp_nb_rx_rcv);
         printf("# CRC_OK: %.2f%%, CRC_FAIL: %.2f%%, NO_CRC: %.2f%%\n", 100.0 * rx_ok_ratio, 100.0 * rx_bad_ratio, 100.0 * rx_nocrc_ratio);
         printf("# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
+        if ((up_filter.devaddr_enabled == true) || (up_filter.join_enabled == true)) {
+            printf("# RF packets dropped by uplink filter: %u on DevAddr, %u on JoinEUI\n", cp_up_drop_devaddr, cp_up_drop_join_eui);
+        }
+        if (dedup_window_ms > 0) {
+            printf("# RF packets dropped as copies of another one: %u\n", cp_up_drop_dup);
+        }
+        printf("# RF packets dropped by uplink queue: %u\n", rx_queue_dropped(&rx_queue));
+        printf("# RX packet descriptors taken from the pool at most: %d/%d\n", pkt_pool_max_used(&pkt_pool), PKT_POOL_SIZE);
+        rx_stats_ok = (concent_run(&concent, CONCENT_CMD_STATS, cmd_rx_stats, &cmd_rx) == LGW_HAL_SUCCESS);
+        chan_stats_ok = cmd_rx.chan_stats_ok;
+        arb_stats_ok = cmd_rx.arb_stats_ok;
+        if ((rx_stats_ok == true) && (rx_stats.nb_fetch > 0)) {
+            printf("# RX buffer fill level at fetch: p50<=%u p90<=%u p99<=%u max:%u bytes (%u fetches, %u split)\n", lgw_rx_fill_percentile(&rx_stats, 500), lgw_rx_fill_percentile(&rx_stats, 900), lgw_rx_fill_percentile(&rx_stats, 990), rx_stats.fill_max, rx_stats.nb_fetch, rx_stats.nb_split);
+        }
+        memset(chan_sum, 0, sizeof chan_sum);
+        for (i = 0; (chan_stats_ok == true) && (i < LGW_IF_CHAIN_NB); i++) {
+            for (j = 0; j < LGW_CHAN_STAT_SF_NB; j++) {
+                lgw_chan_stat_merge(&chan_sum[i], &chan_stats.chan[i][j]);
+            }
+            if (chan_sum[i].nb_pkt == 0) {
+                continue;
+            }
+            lgw_rx_moments_get(&chan_sum[i].rssi, &rssi_mean, &rssi_std);
+            printf("# CH%d: %u packets (%u CRC_FAIL, %u NO_CRC), RSSI mean %.1f std %.1f min %.1f max %.1f dBm", i, chan_sum[i].nb_pkt, chan_sum[i].nb_crc_bad, chan_sum[i].nb_no_crc, rssi_mean / 10.0, rssi_std / 10.0, chan_sum[i].rssi.min_x10 / 10.0, chan_sum[i].rssi.max_x10 / 10.0);
+            if (lgw_rx_moments_get(&chan_sum[i].snr, &snr_mean, &snr_std) > 0) {
+                printf(", SNR mean %.1f std %.1f min %.1f max %.1f dB, SF", snr_mean / 10.0, snr_std / 10.0, chan_sum[i].snr.min_x10 / 10.0, chan_sum[i].snr.max_x10 / 10.0);
+                for (j = 0; j < LGW_CHAN_STAT_SF_NB; j++) {
+                    if (chan_stats.chan[i][j].nb_pkt > 0) {
+                        printf(" %d:%u", j + 5, chan_stats.chan[i][j].nb_pkt);
+                    }
+                }
+            }
+            printf("\n");
+        }
+        arb_detect = 0;
+        arb_alloc = 0;
+        for (i = 0; (arb_stats_ok == true) && (i < LGW_MULTI_NB); i++) {
+            arb_detect += arb_stats.nb_detect[i];
+            arb_alloc += arb_stats.nb_alloc[i];
+        }
+        if (arb_detect > 0) {
+            /* detects which never got a demodulator, the capacity limit of the concentrator */
+            printf("# SF%u preambles detected: %u, demodulated: %u (%.2f%% without demodulator)\n", arb_stats.sf, arb_detect, arb_alloc, (arb_alloc < arb_detect) ? (100.0 * (arb_detect - arb_alloc) / arb_detect) : 0.0);
+        }
         printf("# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
         printf("# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
+        for (s = 1; s < up_server_nb; s++) {
+            printf("# PUSH_DATA acknowledged by %s:%s: %.2f%%\n", up_server[s].addr, up_server[s].port, (cp_up_dgram_sent > 0) ? (100.0 * cp_up_ack_rcv[s] / cp_up_dgram_sent) : 0.0);
+        }
+        for (s = 0; s < up_server_nb; s++) {
+            if (cp_up_ack_rcv[s] > 0) {
+                printf("# PUSH_ACK round-trip time from %s:%s: p50<%uus p90<%uus p99<%uus\n", up_server[s].addr, up_server[s].port, up_lat_bound(cp_up_ack_rtt[s], 0.5), up_lat_bound(cp_up_ack_rtt[s], 0.9), up_lat_bound(cp_up_ack_rtt[s], 0.99));
+            }
+        }
+        if (cp_up_lz4_in_byte > 0) {
+            printf("# PUSH_DATA_LZ4 compression: %u JSON bytes sent in %u bytes (%.1f%%)\n", cp_up_lz4_in_byte, cp_up_lz4_out_byte, 100.0 * cp_up_lz4_out_byte / cp_up_lz4_in_byte);
+        }
+        if (journal_path[0] != '\0') {
+            printf("# PUSH_DATA journal: %u sent again, %u waiting, %u overwritten\n", cp_up_jrn_replayed, cp_up_jrn_backlog, cp_up_jrn_dropped);
+        }
+        if (cp_up_pkt_fwd > 0) {
+            for (i = 0; i < UP_LAT_NB; i++) {
+                printf("# Uplink latency (%s): p50<%uus p90<%uus p99<%uus\n", up_lat_str[i], up_lat_bound(cp_up_lat[i], 0.5), up_lat_bound(cp_up_lat[i], 0.9), up_lat_bound(cp_up_lat[i], 0.99));
+            }
+        }
         printf("### [DOWNSTREAM] ###\n");
         printf("# PULL_DATA sent: %u (%.2f%% acknowledged)\n", cp_dw_pull_sent, 100.0 * dw_ack_ratio);
         printf("# PULL_RESP(onse) datagrams received: %u (%u bytes)\n", cp_dw_dgram_rcv, cp_dw_network_byte);
         printf("# RF packets sent to concentrator: %u (%u bytes)\n", (cp_nb_tx_ok+cp_nb_tx_fail), cp_dw_payload_byte);
         printf("# TX errors: %u\n", cp_nb_tx_fail);
+        printf("# TX handed to concentrator less than %u us before emission: %u\n", JIT_TX_LATE_US, cp_nb_tx_late);
+        printf("# JIT wake-ups late by more than %u us: %u (max %u us)\n", JIT_WAKEUP_LATE_US, cp_nb_jit_wakeup_late, cp_jit_wakeup_late_max_us);
         if (cp_nb_tx_requested != 0 ) {
             printf("# TX rejected (collision packet): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_collision_packet / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_collision_packet);
             printf("# TX rejected (collision beacon): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_collision_beacon / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_collision_beacon);
             printf("# TX rejected (too late): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_too_late / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_too_late);
             printf("# TX rejected (too early): %.2f%% (req:%u, rej:%u)\n", 100.0 * cp_nb_tx_rejected_too_early / cp_nb_tx_requested, cp_nb_tx_requested, cp_nb_tx_rejected_too_early);
+            printf("# TX rejected before payload decoding: %u\n", cp_nb_tx_rejected_admission);
+        }
+        j = jit_airtime_get_stats(airtime_stat, JIT_AIRTIME_BAND_NB_MAX);
+        for (i = 0; i < j; i++) {
+            printf("# TX duty cycle %u-%u Hz: %.3f%% used (%.3f%% queued) of %.2f%%, %u rejected\n", airtime_band[i].freq_min, airtime_band[i].freq_max, 100.0 * airtime_stat[i].usage, 100.0 * airtime_stat[i].reserved, 100.0 * airtime_band[i].duty_cycle, airtime_stat[i].nb_rejected);
         }
         printf("### SX1302 Status ###\n");
-        pthread_mutex_lock(&mx_concent);
-        i  = lgw_get_instcnt(&inst_tstamp);
-        i |= lgw_get_trigcnt(&trig_tstamp);
-        pthread_mutex_unlock(&mx_concent);
+        i = concent_run(&concent, CONCENT_CMD_COUNTER, cmd_counter, &cmd_cnt);
         if (i != LGW_HAL_SUCCESS) {
             printf("# SX1302 counter unknown\n");
         } else {
-            printf("# SX1302 counter (INST): %u\n", inst_tstamp);
+            printf("# SX1302 counter (INST): %" PRIu64 "\n", inst_tstamp);
             printf("# SX1302 counter (PPS):  %u\n", trig_tstamp);
         }
         printf("# BEACON queued: %u\n", cp_nb_beacon_queued);
         printf("# BEACON sent so far: %u\n", cp_nb_beacon_sent);
         printf("# BEACON rejected: %u\n", cp_nb_beacon_rejected);
+        printf("### [COM] ###\n");
+        com_stats_ok = (concent_run(&concent, CONCENT_CMD_STATS, cmd_com_stats, &com_stats) == LGW_HAL_SUCCESS);
+        print_com_stats(&com_stats);
+        concent_get_stats(&concent, concent_stat, true);
+        for (i = 0; i < CONCENT_PRIO_NB; i++) {
+            if (concent_stat[i].nb_req > 0) {
+                printf("# concentrator %s requests: %u, wait mean %" PRIu64 " us, max %u us\n", concent_prio_str[i], concent_stat[i].nb_req, concent_stat[i].wait_us / concent_stat[i].nb_req, concent_stat[i].wait_max_us);
+            }
+        }
         printf("### [JIT] ###\n");
         /* get timestamp captured on PPM pulse  */
         jit_print_queue (&jit_queue[0], false, DEBUG_LOG);
@@ -1855,11 +4351,11 @@ int main(int argc, char ** argv)
         jit_print_queue (&jit_queue[1], false, DEBUG_LOG);
         printf("### [GPS] ###\n");
         if (gps_enabled == true) {
-            /* no need for mutex, display is not critical */
-            if (gps_ref_valid == true) {
-                printf("# Valid time reference (age: %li sec)\n", (long)difftime(time(NULL), time_reference_gps.systime));
+            timeref_get(&ref_ok, &local_ref);
+            if (ref_ok == true) {
+                printf("# Valid time reference (age: %li sec)\n", (long)difftime(time(NULL), local_ref.systime));
             } else {
-                printf("# Invalid time reference (age: %li sec)\n", (long)difftime(time(NULL), time_reference_gps.systime));
+                printf("# Invalid time reference (age: %li sec)\n", (long)difftime(time(NULL), local_ref.systime));
             }
             if (coord_ok == true) {
                 printf("# GPS coordinates: latitude %.5f, longitude %.5f, altitude %i m\n", cp_gps_coord.lat, cp_gps_coord.lon, cp_gps_coord.alt);
@@ -1871,32 +4367,127 @@ int main(int argc, char ** argv)
         } else {
             printf("# GPS sync is disabled\n");
         }
-        pthread_mutex_lock(&mx_concent);
-        i = lgw_get_temperature(&temperature);
-        pthread_mutex_unlock(&mx_concent);
+        i = concent_run(&concent, CONCENT_CMD_TEMPERATURE, cmd_temperature, &temperature);
         if (i != LGW_HAL_SUCCESS) {
             printf("### Concentrator temperature unknown ###\n");
         } else {
             printf("### Concentrator temperature: %.0f C ###\n", temperature);
         }
+        if (spectral_scan_params.enable == true) {
+            printf("### [SPECTRAL SCAN] ###\n");
+            pthread_mutex_lock(&mx_spectral);
+            nb_spec = lgw_spectral_agg_summary(&spectral_agg, spec_sum, LGW_SPECTRAL_FREQ_NB_MAX);
+            pthread_mutex_unlock(&mx_spectral);
+            for (i = 0; i < nb_spec; i++) {
+                printf("# %.3f MHz: %u scans, RSSI p50 %d dBm, p90 %d dBm, p99 %d dBm, max %d dBm\n", (double)spec_sum[i].freq_hz / 1E6, spec_sum[i].nb_scan, spec_sum[i].p50, spec_sum[i].p90, spec_sum[i].p99, spec_sum[i].max);
+            }
+        }
         printf("##### END #####\n");
 
         /* generate a JSON report (will be sent to server by upstream thread) */
         pthread_mutex_lock(&mx_stat_rep);
         if (((gps_enabled == true) && (coord_ok == true)) || (gps_fake_enable == true)) {
-            snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"lati\":%.5f,\"long\":%.5f,\"alti\":%i,\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"temp\":%.1f}", stat_timestamp, cp_gps_coord.lat, cp_gps_coord.lon, cp_gps_coord.alt, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok, temperature);
+            rep_len = snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"lati\":%.5f,\"long\":%.5f,\"alti\":%i,\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"temp\":%.1f", stat_timestamp, cp_gps_coord.lat, cp_gps_coord.lon, cp_gps_coord.alt, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok, temperature);
         } else {
-            snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"temp\":%.1f}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok, temperature);
+            rep_len = snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"temp\":%.1f", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok, temperature);
+        }
+        if (cp_up_pkt_fwd > 0) {
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, ",\"ulat\":{");
+            for (i = 0; i < UP_LAT_NB; i++) {
+                rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "%s\"%s\":[%u,%u,%u]", (i > 0) ? "," : "", up_lat_str[i], up_lat_bound(cp_up_lat[i], 0.5), up_lat_bound(cp_up_lat[i], 0.9), up_lat_bound(cp_up_lat[i], 0.99));
+            }
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "}");
+        }
+        if ((up_filter.devaddr_enabled == true) || (up_filter.join_enabled == true)) {
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, ",\"rxfl\":{\"addr\":%u,\"join\":%u}", cp_up_drop_devaddr, cp_up_drop_join_eui);
+        }
+        if (dedup_window_ms > 0) {
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, ",\"rxdp\":%u", cp_up_drop_dup);
+        }
+        k = 0;
+        for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+            if (chan_sum[i].nb_pkt == 0) {
+                continue;
+            }
+            lgw_rx_moments_get(&chan_sum[i].rssi, &rssi_mean, &rssi_std);
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "%s{\"chan\":%d,\"rxnb\":%u,\"rxbd\":%u,\"rxnc\":%u,\"rssi\":[%.1f,%.1f,%.1f,%.1f]", (k == 0) ? ",\"chst\":[" : ",", i, chan_sum[i].nb_pkt, chan_sum[i].nb_crc_bad, chan_sum[i].nb_no_crc, rssi_mean / 10.0, rssi_std / 10.0, chan_sum[i].rssi.min_x10 / 10.0, chan_sum[i].rssi.max_x10 / 10.0);
+            if (lgw_rx_moments_get(&chan_sum[i].snr, &snr_mean, &snr_std) > 0) {
+                rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, ",\"lsnr\":[%.1f,%.1f,%.1f,%.1f],\"sf\":[", snr_mean / 10.0, snr_std / 10.0, chan_sum[i].snr.min_x10 / 10.0, chan_sum[i].snr.max_x10 / 10.0);
+                for (j = 0; j < LGW_CHAN_STAT_SF_NB; j++) {
+                    rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "%s%u", (j > 0) ? "," : "", chan_stats.chan[i][j].nb_pkt);
+                }
+                rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "]");
+            }
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "}");
+            k += 1;
+        }
+        if (k > 0) {
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "]");
+        }
+        if (arb_detect > 0) {
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, ",\"arbs\":{\"sf\":%u,\"det\":[", arb_stats.sf);
+            for (i = 0; i < LGW_MULTI_NB; i++) {
+                rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "%s%u", (i > 0) ? "," : "", arb_stats.nb_detect[i]);
+            }
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "],\"alc\":[");
+            for (i = 0; i < LGW_MULTI_NB; i++) {
+                rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "%s%u", (i > 0) ? "," : "", arb_stats.nb_alloc[i]);
+            }
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "]}");
+        }
+        if (nb_spec > 0) {
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, ",\"spec\":[");
+            for (i = 0; i < nb_spec; i++) {
+                rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "%s{\"freq\":%.6f,\"nscan\":%u,\"p50\":%d,\"p90\":%d,\"p99\":%d,\"max\":%d}", (i > 0) ? "," : "", (double)spec_sum[i].freq_hz / 1E6, spec_sum[i].nb_scan, spec_sum[i].p50, spec_sum[i].p90, spec_sum[i].p99, spec_sum[i].max);
+            }
+            rep_len += snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "]");
+        }
+        snprintf(status_report + rep_len, STATUS_SIZE - rep_len, "}");
+        if (push_data_binary == true) {
+            memset(status_report_bin, 0, sizeof status_report_bin);
+            if (((gps_enabled == true) && (coord_ok == true)) || (gps_fake_enable == true)) {
+                status_report_bin[0] = STAT_BIN_FLAG_COORD;
+                put_le32(status_report_bin + 9, (uint32_t)(int32_t)lround(cp_gps_coord.lat * 1E7));
+                put_le32(status_report_bin + 13, (uint32_t)(int32_t)lround(cp_gps_coord.lon * 1E7));
+                put_le32(status_report_bin + 17, (uint32_t)(int32_t)cp_gps_coord.alt);
+            }
+            put_le64(status_report_bin + 1, (uint64_t)(int64_t)t);
+            put_le32(status_report_bin + 21, cp_nb_rx_rcv);
+            put_le32(status_report_bin + 25, cp_nb_rx_ok);
+            put_le32(status_report_bin + 29, cp_up_pkt_fwd);
+            put_le16(status_report_bin + 33, (uint16_t)lround(1000.0 * up_ack_ratio));
+            put_le32(status_report_bin + 35, cp_dw_dgram_rcv);
+            put_le32(status_report_bin + 39, cp_nb_tx_ok);
+            put_le16(status_report_bin + 43, (uint16_t)(int16_t)lroundf(temperature * 10));
         }
         report_ready = true;
         pthread_mutex_unlock(&mx_stat_rep);
+        eventfd_write(report_fd, 1); /* wake up the upstream thread */
+
+        /* format the metrics once, the scrapes only copy them */
+        if (metrics_endpoint[0] != '\0') {
+            metrics_update(&up_now, &dw_now, &jit_now, &bcn_now, (com_stats_ok == true) ? &com_stats : NULL, (rx_stats_ok == true) ? &rx_stats : NULL);
+        }
+    }
+
+    if (metrics_endpoint[0] != '\0') {
+        metrics_stop(&metrics);
     }
 
     /* wait for all threads with a COM with the concentrator board to finish (1 fetch cycle max) */
+    i = pthread_join(thrid_fetch, NULL);
+    if (i != 0) {
+        printf("ERROR: failed to join fetch thread with %d - %s\n", i, strerror(errno));
+    }
     i = pthread_join(thrid_up, NULL);
     if (i != 0) {
         printf("ERROR: failed to join upstream thread with %d - %s\n", i, strerror(errno));
     }
+    rx_queue_deinit(&rx_queue);
+    pkt_pool_deinit(&pkt_pool);
+    if (journal_path[0] != '\0') {
+        journal_close(&journal);
+    }
     i = pthread_join(thrid_down, NULL);
     if (i != 0) {
         printf("ERROR: failed to join downstream thread with %d - %s\n", i, strerror(errno));
@@ -1905,6 +4496,13 @@ int main(int argc, char ** argv)
     if (i != 0) {
         printf("ERROR: failed to join JIT thread with %d - %s\n", i, strerror(errno));
     }
+    if (beacon_period > 0) {
+        i = pthread_join(thrid_beacon, NULL);
+        if (i != 0) {
+            printf("ERROR: failed to join beacon thread with %d - %s\n", i, strerror(errno));
+        }
+    }
+    /* jit_wakeup is not destroyed, sig_handler may still post it until exit */
     if (spectral_scan_params.enable == true) {
         i = pthread_join(thrid_ss, NULL);
         if (i != 0) {
@@ -1912,7 +4510,11 @@ int main(int argc, char ** argv)
         }
     }
     if (gps_enabled == true) {
-        pthread_cancel(thrid_gps); /* don't wait for GPS thread, no access to concentrator board */
+        /* the GPS thread reads the counter through the concentrator thread, it must be stopped before it */
+        i = pthread_join(thrid_gps, NULL);
+        if (i != 0) {
+            printf("ERROR: failed to join GPS thread with %d - %s\n", i, strerror(errno));
+        }
         pthread_cancel(thrid_valid); /* don't wait for validation thread, no access to concentrator board */
 
         i = lgw_gps_disable(gps_tty_fd);
@@ -1922,6 +4524,15 @@ int main(int argc, char ** argv)
             MSG("WARNING: failed to close GPS successfully\n");
         }
     }
+    if (concent_thread == true) {
+        /* the requests still queued are served first */
+        concent_stop(&concent);
+        i = pthread_join(thrid_concent, NULL);
+        if (i != 0) {
+            printf("ERROR: failed to join concentrator command thread with %d - %s\n", i, strerror(errno));
+        }
+    }
+    concent_deinit(&concent);
 
     /* if an exit signal was received, try to quit properly */
     if (exit_sig) {
@@ -1945,23 +4556,96 @@ int main(int argc, char ** argv)
         }
     }
 
+    if ((TRACE_PKT_FWD > 0) || LGW_TRACE_ENABLED) {
+        lgw_trace_stop();
+    }
+
     MSG("INFO: Exiting packet forwarder program\n");
     exit(EXIT_SUCCESS);
 }
 
 /* -------------------------------------------------------------------------- */
-/* --- THREAD 1: RECEIVING PACKETS AND FORWARDING THEM ---------------------- */
+/* --- THREAD 1a: FETCHING PACKETS FROM THE CONCENTRATOR -------------------- */
+
+void thread_fetch(void) {
+    int i, j; /* loop variables */
+    struct lgw_pkt_rx_s * rxpkt[NB_PKT_MAX]; /* descriptors taken from the pool, to receive inbound packets + metadata */
+    int nb_ref = 0; /* number of descriptors held */
+    struct cmd_receive_s cmd_rx = { 0, rxpkt };
+    int nb_pkt;
+    int64_t idle_ns; /* start of the wait for new packets */
+
+    while (!exit_sig && !quit_sig) {
+
+        /* replace the descriptors handed over by the previous fetch */
+        if (nb_ref < NB_PKT_MAX) {
+            nb_ref += pkt_pool_get(&pkt_pool, &rxpkt[nb_ref], NB_PKT_MAX - nb_ref);
+        }
+        if (nb_ref == 0) {
+            /* all descriptors are waiting to be forwarded, leave the packets in the RX buffer meanwhile */
+            wait_ms(FETCH_POLL_MS);
+            continue;
+        }
+
+        /* fetch packets */
+        cmd_rx.max_pkt = (uint8_t)nb_ref;
+        nb_pkt = concent_run(&concent, CONCENT_CMD_RECEIVE, cmd_receive, &cmd_rx);
+        if (nb_pkt == LGW_HAL_ERROR) {
+            MSG("ERROR: [fetch] failed packet fetch, reconnecting\n");
+            if (concentrator_recover() == false) {
+                MSG("ERROR: [fetch] failed to recover the concentrator, exiting\n");
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        /* hand the packets over to the upstream thread, never wait for it */
+        if (nb_pkt > 0) {
+            i = rx_queue_push(&rx_queue, rxpkt, nb_pkt);
+            if (i < nb_pkt) {
+                MSG("WARNING: [fetch] uplink queue full, %d packets dropped\n", nb_pkt - i);
+            }
+            /* the descriptors queued now belong to the upstream thread, the dropped ones are reused */
+            nb_ref -= i;
+            memmove(&rxpkt[0], &rxpkt[i], nb_ref * sizeof rxpkt[0]);
+            continue;
+        }
+
+        /* wait for new packets, the HAL paces the checks of the RX buffer and backs them off while idle */
+        /* the concentrator is released between waits of fetch_poll_max_ms at most, to not delay downlinks */
+        idle_ns = time_monotonic_ns();
+        while (((time_monotonic_ns() - idle_ns) < ((int64_t)FETCH_IDLE_MS * 1000000)) && !exit_sig && !quit_sig) {
+            j = concent_run(&concent, CONCENT_CMD_RECEIVE_WAIT, cmd_receive_wait, &fetch_poll_max_ms);
+            if (j == LGW_HAL_ERROR) {
+                MSG("ERROR: [fetch] failed to check RX buffer status, reconnecting\n");
+                if (concentrator_recover() == false) {
+                    MSG("ERROR: [fetch] failed to recover the concentrator, exiting\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            } else if (j > 0) {
+                break;
+            }
+        }
+    }
+    pkt_pool_put(&pkt_pool, rxpkt, nb_ref);
+    MSG("\nINFO: End of fetch thread\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 1b: FORWARDING RECEIVED PACKETS TO THE SERVER ----------------- */
 
 void thread_up(void) {
-    int i, j, k; /* loop variables */
+    int i, j; /* loop variables */
     unsigned pkt_in_dgram; /* nb on Lora packet in the current datagram */
     char stat_timestamp[24];
     time_t t;
 
-    /* allocate memory for packet fetching and processing */
-    struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets + metadata */
+    /* packets handed over by the fetch thread, given back to the pool once forwarded */
+    struct lgw_pkt_rx_s * rxpkt[NB_PKT_MAX]; /* references to inbound packets + metadata */
     struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
-    int nb_pkt;
+    int nb_pkt = 0;
+    struct lgw_pkt_rx_s * coalesce_carry = NULL; /* packet which did not fit in the previous coalesced datagram */
 
     /* local copy of GPS time reference */
     bool ref_ok = false; /* determine if GPS time reference must be used or not */
@@ -1970,7 +4654,22 @@ void thread_up(void) {
     /* data buffers */
     uint8_t buff_up[TX_BUFF_SIZE]; /* buffer to compose the upstream packet */
     int buff_index;
-    uint8_t buff_ack[32]; /* buffer to receive acknowledges */
+    char * out; /* write pointer for the JSON emitters */
+
+    /* the datagram is serialized once, and sent to all the upstream servers by a single syscall */
+    struct iovec iov_up;
+    struct iovec iov_lz4; /* datagram of the servers receiving it compressed */
+    uint8_t buff_lz4[PUSH_DATA_LZ4_HEADER_SIZE + LZ4BLK_BOUND(TX_BUFF_SIZE)];
+    bool compress = false; /* at least one server receives the datagram compressed */
+    struct mmsghdr msg_up[UP_SERV_NB_MAX];
+    struct journal_ref_s jrn_ref; /* journal record of the datagram */
+
+    /* event loop variables */
+    int epfd;
+    int ev_fd[4];
+    struct epoll_event ev[4];
+    int nb_ev;
+    eventfd_t ev_count;
 
     /* protocol variables */
     uint8_t token_h; /* random token for acknowledgement matching */
@@ -1978,12 +4677,20 @@ void thread_up(void) {
 
     /* ping measurement variables */
     struct timespec send_time;
-    struct timespec recv_time;
+
+    /* latency measurement variables, host monotonic times in ns */
+    int64_t pop_ns;
+    int64_t send_ns;
+    int64_t pkt_serial_ns[NB_PKT_MAX]; /* negative if the packet is not forwarded */
+
+    /* de-duplication variables */
+    int16_t pkt_dup_of[NB_PKT_MAX]; /* copy kept for each packet of the batch, see up_dedup_batch */
+    int k;
 
     /* GPS synchronization variables */
-    struct timespec pkt_utc_time;
-    struct tm * x; /* broken-up UTC time */
-    struct timespec pkt_gps_time;
+    uint32_t pkt_count_us[NB_PKT_MAX];
+    struct timespec pkt_utc_time[NB_PKT_MAX]; /* converted for the whole fetch at once */
+    struct timespec pkt_gps_time[NB_PKT_MAX];
     uint64_t pkt_gps_time_ms;
 
     /* report management variable */
@@ -1993,50 +4700,102 @@ void thread_up(void) {
     uint32_t mote_addr = 0;
     uint16_t mote_fcnt = 0;
 
-    /* set upstream socket RX timeout */
-    i = setsockopt(sock_up, SOL_SOCKET, SO_RCVTIMEO, (void *)&push_timeout_half, sizeof push_timeout_half);
-    if (i != 0) {
-        MSG("ERROR: [up] setsockopt returned %s\n", strerror(errno));
+    /* wait for new packets, status reports and PUSH_ACK on a single epoll, deadlines are given as epoll timeout */
+    ev_fd[0] = rx_queue_fd(&rx_queue);
+    ev_fd[1] = report_fd;
+    ev_fd[2] = sock_up;
+    ev_fd[3] = exit_fd;
+    epfd = net_epoll_create(ev_fd, 4);
+    if (epfd < 0) {
+        MSG("ERROR: [up] failed to create epoll, %s\n", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
+    /* one message per server, all pointing to the same datagram, or to its compressed copy */
+    iov_up.iov_base = (void *)buff_up;
+    iov_lz4.iov_base = (void *)buff_lz4;
+    memset(msg_up, 0, sizeof msg_up);
+    for (i = 0; i < up_server_nb; i++) {
+        msg_up[i].msg_hdr.msg_name = (void *)&up_server[i].sa;
+        msg_up[i].msg_hdr.msg_namelen = up_server[i].sa_len;
+        msg_up[i].msg_hdr.msg_iov = (up_server[i].compress == true) ? &iov_lz4 : &iov_up;
+        msg_up[i].msg_hdr.msg_iovlen = 1;
+        compress |= up_server[i].compress;
+    }
+
+    up_dedup_init(&up_dedup, dedup_window_ms);
+
     /* pre-fill the data buffer with fixed fields */
     buff_up[0] = PROTOCOL_VERSION;
-    buff_up[3] = PKT_PUSH_DATA;
+    buff_up[3] = (push_data_binary == true) ? PKT_PUSH_DATA_BIN : PKT_PUSH_DATA;
     *(uint32_t *)(buff_up + 4) = net_mac_h;
     *(uint32_t *)(buff_up + 8) = net_mac_l;
+    memcpy(buff_lz4, buff_up, 12);
+    buff_lz4[3] = PKT_PUSH_DATA_LZ4;
 
     while (!exit_sig && !quit_sig) {
 
-        /* fetch packets */
-        pthread_mutex_lock(&mx_concent);
-        nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);
-        pthread_mutex_unlock(&mx_concent);
-        if (nb_pkt == LGW_HAL_ERROR) {
-            MSG("ERROR: [up] failed packet fetch, exiting\n");
-            exit(EXIT_FAILURE);
+        /* send again the journaled datagrams, at a limited rate, while the primary server acknowledges */
+        if ((journal_path[0] != '\0') && (push_ack_ok == true)) {
+            push_data_replay();
+        }
+
+        /* release the packets of the previous loop, and get packets fetched by the fetch thread */
+        pkt_pool_put(&pkt_pool, rxpkt, nb_pkt);
+        nb_pkt = 0;
+        if (coalesce_carry != NULL) {
+            rxpkt[nb_pkt++] = coalesce_carry;
+            coalesce_carry = NULL;
+        }
+        nb_pkt += rx_queue_pop(&rx_queue, rxpkt + nb_pkt, NB_PKT_MAX - nb_pkt);
+        pop_ns = time_monotonic_ns();
+
+        /* wait for the packets of the next fetches, to send them in the same datagram */
+        if ((coalesce_delay_us > 0) && (nb_pkt > 0) && (nb_pkt < (int)coalesce_max_pkt)) {
+            nb_pkt = up_coalesce(rxpkt, nb_pkt, pop_ns, &coalesce_carry);
         }
 
         /* check if there are status report to send */
         send_report = report_ready; /* copy the variable so it doesn't change mid-function */
         /* no mutex, we're only reading */
 
-        /* wait a short time if no packets, nor status report */
+        /* wait for new packets if no packets, nor status report */
+        /* pending PUSH_ACK are processed meanwhile, until the next time-out or journal replay */
         if ((nb_pkt == 0) && (send_report == false)) {
-            wait_ms(FETCH_SLEEP_MS);
+            nb_ev = epoll_wait(epfd, ev, 4, up_wait_timeout_ms());
+            for (i = 0; i < nb_ev; i++) {
+                if (ev[i].data.fd == rx_queue_fd(&rx_queue)) {
+                    rx_queue_clear(&rx_queue);
+                } else if (ev[i].data.fd == report_fd) {
+                    eventfd_read(report_fd, &ev_count);
+                }
+            }
+            push_ack_process();
             continue;
         }
 
-        /* get a copy of GPS time reference (avoid 1 mutex per packet) */
+        /* get a copy of GPS time reference (avoid 1 copy per packet) */
         if ((nb_pkt > 0) && (gps_enabled == true)) {
-            pthread_mutex_lock(&mx_timeref);
-            ref_ok = gps_ref_valid;
-            local_ref = time_reference_gps;
-            pthread_mutex_unlock(&mx_timeref);
+            timeref_get(&ref_ok, &local_ref);
         } else {
             ref_ok = false;
         }
 
+        /* convert all packet timestamps to UTC and GPS absolute times */
+        if (ref_ok == true) {
+            for (i = 0; i < nb_pkt; ++i) {
+                pkt_count_us[i] = rxpkt[i]->count_us;
+            }
+            if (lgw_cnt2time_array(local_ref, pkt_count_us, nb_pkt, pkt_utc_time, pkt_gps_time) != LGW_GPS_SUCCESS) {
+                ref_ok = false;
+            }
+        }
+
+        /* find the copies of the same uplink, only the best-RSSI one is forwarded */
+        if ((nb_pkt > 0) && (dedup_window_ms > 0)) {
+            up_dedup_batch(&up_dedup, rxpkt, nb_pkt, pkt_dup_of);
+        }
+
         /* get timestamp for statistics */
         t = time(NULL);
         strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&t));
@@ -2047,16 +4806,21 @@ void thread_up(void) {
         token_l = (uint8_t)rand(); /* random token */
         buff_up[1] = token_h;
         buff_up[2] = token_l;
-        buff_index = 12; /* 12-byte header */
+        if (push_data_binary == true) {
+            buff_index = PUSH_DATA_BIN_HEADER_SIZE; /* 12-byte header, number of rxpk and flags filled once known */
+        } else {
+            buff_index = 12; /* 12-byte header */
 
-        /* start of JSON structure */
-        memcpy((void *)(buff_up + buff_index), (void *)"{\"rxpk\":[", 9);
-        buff_index += 9;
+            /* start of JSON structure */
+            memcpy((void *)(buff_up + buff_index), (void *)"{\"rxpk\":[", 9);
+            buff_index += 9;
+        }
 
         /* serialize Lora packets metadata and payload */
         pkt_in_dgram = 0;
         for (i = 0; i < nb_pkt; ++i) {
-            p = &rxpkt[i];
+            p = rxpkt[i];
+            pkt_serial_ns[i] = -1;
 
             /* Get mote information from current packet (addr, fcnt) */
             /* FHDR - DevAddr */
@@ -2074,41 +4838,64 @@ void thread_up(void) {
             }
 
             /* basic packet filtering */
-            pthread_mutex_lock(&mx_meas_up);
-            meas_nb_rx_rcv += 1;
+            MEAS_ADD(meas_up.rx_rcv, 1);
             switch(p->status) {
                 case STAT_CRC_OK:
-                    meas_nb_rx_ok += 1;
+                    MEAS_ADD(meas_up.rx_ok, 1);
                     if (!fwd_valid_pkt) {
-                        pthread_mutex_unlock(&mx_meas_up);
                         continue; /* skip that packet */
                     }
                     break;
                 case STAT_CRC_BAD:
-                    meas_nb_rx_bad += 1;
+                    MEAS_ADD(meas_up.rx_bad, 1);
                     if (!fwd_error_pkt) {
-                        pthread_mutex_unlock(&mx_meas_up);
                         continue; /* skip that packet */
                     }
                     break;
                 case STAT_NO_CRC:
-                    meas_nb_rx_nocrc += 1;
+                    MEAS_ADD(meas_up.rx_nocrc, 1);
                     if (!fwd_nocrc_pkt) {
-                        pthread_mutex_unlock(&mx_meas_up);
                         continue; /* skip that packet */
                     }
                     break;
                 default:
                     MSG("WARNING: [up] received packet with unknown status %u (size %u, modulation %u, BW %u, DR %u, RSSI %.1f)\n", p->status, p->size, p->modulation, p->bandwidth, p->datarate, p->rssic);
-                    pthread_mutex_unlock(&mx_meas_up);
                     continue; /* skip that packet */
                     // exit(EXIT_FAILURE);
             }
-            meas_up_pkt_fwd += 1;
-            meas_up_payload_byte += p->size;
-            pthread_mutex_unlock(&mx_meas_up);
+
+            /* packets of foreign networks, dropped before serialization */
+            switch (up_filter_check(&up_filter, p->payload, p->size)) {
+                case UP_FILTER_DROP_DEVADDR:
+                    MEAS_ADD(meas_up.rx_drop_devaddr, 1);
+                    continue; /* skip that packet */
+                case UP_FILTER_DROP_JOIN_EUI:
+                    MEAS_ADD(meas_up.rx_drop_join_eui, 1);
+                    continue; /* skip that packet */
+                default:
+                    break;
+            }
+            if ((dedup_window_ms > 0) && (pkt_dup_of[i] != UP_DEDUP_UNIQUE)) {
+                MEAS_ADD(meas_up.rx_drop_dup, 1);
+                continue; /* skip that packet */
+            }
+            MEAS_ADD(meas_up.pkt_fwd, 1);
+            MEAS_ADD(meas_up.payload_byte, p->size);
             printf( "\nINFO: Received pkt from mote: %08X (fcnt=%u)\n", mote_addr, mote_fcnt );
 
+            /* Binary serialization, fixed-width metadata and raw payload */
+            if (push_data_binary == true) {
+                j = rxpk_serialize_bin(buff_up + buff_index, p, (ref_ok ? &pkt_utc_time[i] : NULL), (ref_ok ? &pkt_gps_time[i] : NULL));
+                if (j < 0) {
+                    exit(EXIT_FAILURE);
+                }
+                buff_index += j;
+                ++pkt_in_dgram;
+                pkt_serial_ns[i] = time_monotonic_ns();
+                rxpk_log(p);
+                continue;
+            }
+
             /* Start of packet, add inter-packet separator if necessary */
             if (pkt_in_dgram == 0) {
                 buff_up[buff_index] = '{';
@@ -2119,72 +4906,46 @@ void thread_up(void) {
                 buff_index += 2;
             }
 
+            /* JSON numbers are written by the jsonw emitters, each rxpk fits in the space reserved by TX_BUFF_SIZE */
+            out = (char *)(buff_up + buff_index);
+
             /* JSON rxpk frame format version, 8 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "\"jver\":%d", PROTOCOL_JSON_RXPK_FRAME_FORMAT );
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
+            out += jsonw_str(out, "\"jver\":");
+            out += jsonw_int(out, PROTOCOL_JSON_RXPK_FRAME_FORMAT);
 
             /* RAW timestamp, 8-17 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"tmst\":%u", p->count_us);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
+            out += jsonw_str(out, ",\"tmst\":");
+            out += jsonw_uint(out, p->count_us);
 
             /* Packet RX time (GPS based), 37 useful chars */
             if (ref_ok == true) {
-                /* convert packet timestamp to UTC absolute time */
-                j = lgw_cnt2utc(local_ref, p->count_us, &pkt_utc_time);
-                if (j == LGW_GPS_SUCCESS) {
-                    /* split the UNIX timestamp to its calendar components */
-                    x = gmtime(&(pkt_utc_time.tv_sec));
-                    j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"time\":\"%04i-%02i-%02iT%02i:%02i:%02i.%06liZ\"", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (pkt_utc_time.tv_nsec)/1000); /* ISO 8601 format */
-                    if (j > 0) {
-                        buff_index += j;
-                    } else {
-                        MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                /* convert packet timestamp to GPS absolute time */
-                j = lgw_cnt2gps(local_ref, p->count_us, &pkt_gps_time);
-                if (j == LGW_GPS_SUCCESS) {
-                    pkt_gps_time_ms = pkt_gps_time.tv_sec * 1E3 + pkt_gps_time.tv_nsec / 1E6;
-                    j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"tmms\":%" PRIu64 "", pkt_gps_time_ms); /* GPS time in milliseconds since 06.Jan.1980 */
-                    if (j > 0) {
-                        buff_index += j;
-                    } else {
-                        MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                        exit(EXIT_FAILURE);
-                    }
-                }
+                out += jsonw_str(out, ",\"time\":\"");
+                out += utc_to_iso8601(out, &pkt_utc_time[i]);
+                *out++ = '"';
+                pkt_gps_time_ms = pkt_gps_time[i].tv_sec * 1E3 + pkt_gps_time[i].tv_nsec / 1E6;
+                out += jsonw_str(out, ",\"tmms\":"); /* GPS time in milliseconds since 06.Jan.1980 */
+                out += jsonw_uint(out, pkt_gps_time_ms);
             }
 
             /* Fine timestamp */
             if (p->ftime_received == true) {
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"ftime\":%u", p->ftime);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
+                out += jsonw_str(out, ",\"ftime\":");
+                out += jsonw_uint(out, p->ftime);
             }
 
             /* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf,\"mid\":%2u", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6), p->modem_id);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
+            /* the frequency in MHz with 6 decimals is exactly the frequency in Hz */
+            out += jsonw_str(out, ",\"chan\":");
+            out += jsonw_uint(out, p->if_chain);
+            out += jsonw_str(out, ",\"rfch\":");
+            out += jsonw_uint(out, p->rf_chain);
+            out += jsonw_str(out, ",\"freq\":");
+            out += jsonw_uint(out, p->freq_hz / 1000000);
+            *out++ = '.';
+            out += jsonw_uint_pad(out, p->freq_hz % 1000000, 6, '0');
+            out += jsonw_str(out, ",\"mid\":");
+            out += jsonw_uint_pad(out, p->modem_id, 2, ' ');
+            buff_index = out - (char *)buff_up;
 
             /* Packet status, 9-10 useful chars */
             switch (p->status) {
@@ -2301,57 +5062,41 @@ void thread_up(void) {
                         exit(EXIT_FAILURE);
                 }
 
+                out = (char *)(buff_up + buff_index);
+
                 /* Signal RSSI, payload size */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"rssis\":%.0f", roundf(p->rssis));
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
+                out += jsonw_str(out, ",\"rssis\":");
+                out += jsonw_int(out, x10_round(p->rssis_x10));
 
                 /* Lora SNR */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"lsnr\":%.1f", p->snr);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
+                out += jsonw_str(out, ",\"lsnr\":");
+                out += jsonw_decimal(out, p->snr_x10, 1);
 
                 /* Lora frequency offset */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"foff\":%d", p->freq_offset);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
+                out += jsonw_str(out, ",\"foff\":");
+                out += jsonw_int(out, p->freq_offset);
+                buff_index = out - (char *)buff_up;
             } else if (p->modulation == MOD_FSK) {
                 memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"FSK\"", 13);
                 buff_index += 13;
 
                 /* FSK datarate, 11-14 useful chars */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"datr\":%u", p->datarate);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                    exit(EXIT_FAILURE);
-                }
+                out = (char *)(buff_up + buff_index);
+                out += jsonw_str(out, ",\"datr\":");
+                out += jsonw_uint(out, p->datarate);
+                buff_index = out - (char *)buff_up;
             } else {
                 MSG("ERROR: [up] received packet with unknown modulation 0x%02X\n", p->modulation);
                 exit(EXIT_FAILURE);
             }
 
             /* Channel RSSI, payload size, 18-23 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"rssi\":%.0f,\"size\":%u", roundf(p->rssic), p->size);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-                exit(EXIT_FAILURE);
-            }
+            out = (char *)(buff_up + buff_index);
+            out += jsonw_str(out, ",\"rssi\":");
+            out += jsonw_int(out, x10_round(p->rssic_x10));
+            out += jsonw_str(out, ",\"size\":");
+            out += jsonw_uint(out, p->size);
+            buff_index = out - (char *)buff_up;
 
             /* Packet base64-encoded payload, 14-350 useful chars */
             memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
@@ -2366,29 +5111,51 @@ void thread_up(void) {
             buff_up[buff_index] = '"';
             ++buff_index;
 
+            /* Host latency since the fetch of the packet, optional, 10-18 useful chars */
+            pkt_serial_ns[i] = time_monotonic_ns();
+            if (rxpk_latency == true) {
+                out = (char *)(buff_up + buff_index);
+                out += jsonw_str(out, ",\"hlat\":");
+                out += jsonw_uint(out, (uint32_t)((pkt_serial_ns[i] - p->host_fetch_ns) / 1000));
+                buff_index = out - (char *)buff_up;
+            }
+
+            /* Metadata of the copies dropped, optional, fit in the space they did not use */
+            if ((dedup_window_ms > 0) && (dedup_meta == true)) {
+                out = (char *)(buff_up + buff_index);
+                j = 0;
+                for (k = 0; k < nb_pkt; k++) {
+                    if (pkt_dup_of[k] != i) {
+                        continue;
+                    }
+                    out += jsonw_str(out, (j == 0) ? ",\"dupl\":[{\"tmst\":" : ",{\"tmst\":");
+                    out += jsonw_uint(out, rxpkt[k]->count_us);
+                    out += jsonw_str(out, ",\"chan\":");
+                    out += jsonw_uint(out, rxpkt[k]->if_chain);
+                    out += jsonw_str(out, ",\"rfch\":");
+                    out += jsonw_uint(out, rxpkt[k]->rf_chain);
+                    out += jsonw_str(out, ",\"rssi\":");
+                    out += jsonw_int(out, x10_round(rxpkt[k]->rssic_x10));
+                    if (rxpkt[k]->modulation == MOD_LORA) {
+                        out += jsonw_str(out, ",\"rssis\":");
+                        out += jsonw_int(out, x10_round(rxpkt[k]->rssis_x10));
+                        out += jsonw_str(out, ",\"lsnr\":");
+                        out += jsonw_decimal(out, rxpkt[k]->snr_x10, 1);
+                    }
+                    *out++ = '}';
+                    j += 1;
+                }
+                if (j > 0) {
+                    *out++ = ']';
+                }
+                buff_index = out - (char *)buff_up;
+            }
+
             /* End of packet serialization */
             buff_up[buff_index] = '}';
             ++buff_index;
             ++pkt_in_dgram;
-
-            if (p->modulation == MOD_LORA) {
-                /* Log nb of packets per channel, per SF */
-                nb_pkt_log[p->if_chain][p->datarate - 5] += 1;
-                nb_pkt_received_lora += 1;
-
-                /* Log nb of packets for ref_payload (DEBUG) */
-                for (k = 0; k < debugconf.nb_ref_payload; k++) {
-                    if ((p->payload[0] == (uint8_t)(debugconf.ref_payload[k].id >> 24)) &&
-                        (p->payload[1] == (uint8_t)(debugconf.ref_payload[k].id >> 16)) &&
-                        (p->payload[2] == (uint8_t)(debugconf.ref_payload[k].id >> 8))  &&
-                        (p->payload[3] == (uint8_t)(debugconf.ref_payload[k].id >> 0))) {
-                            nb_pkt_received_ref[k] += 1;
-                        }
-                }
-            } else if (p->modulation == MOD_FSK) {
-                nb_pkt_log[p->if_chain][0] += 1;
-                nb_pkt_received_fsk += 1;
-            }
+            rxpk_log(p);
         }
 
 
@@ -2412,303 +5179,221 @@ void thread_up(void) {
             }
         }
 
-        /* restart fetch sequence without sending empty JSON if all packets have been filtered out */
-        if (pkt_in_dgram == 0) {
-            if (send_report == true) {
-                /* need to clean up the beginning of the payload */
-                buff_index -= 8; /* removes "rxpk":[ */
-            } else {
+        /* binary datagram: number of rxpk, optional status block */
+        if (push_data_binary == true) {
+            if ((pkt_in_dgram == 0) && (send_report == false)) {
                 /* all packet have been filtered out and no report, restart loop */
                 continue;
             }
-        } else {
-            /* end of packet array */
-            buff_up[buff_index] = ']';
-            ++buff_index;
-            /* add separator if needed */
+            buff_up[12] = (uint8_t)pkt_in_dgram;
+            buff_up[13] = 0;
             if (send_report == true) {
-                buff_up[buff_index] = ',';
+                pthread_mutex_lock(&mx_stat_rep);
+                report_ready = false;
+                memcpy(buff_up + buff_index, status_report_bin, STAT_BIN_SIZE);
+                pthread_mutex_unlock(&mx_stat_rep);
+                buff_up[13] |= PUSH_DATA_BIN_FLAG_STAT;
+                buff_index += STAT_BIN_SIZE;
+            }
+        } else {
+            /* restart fetch sequence without sending empty JSON if all packets have been filtered out */
+            if (pkt_in_dgram == 0) {
+                if (send_report == true) {
+                    /* need to clean up the beginning of the payload */
+                    buff_index -= 8; /* removes "rxpk":[ */
+                } else {
+                    /* all packet have been filtered out and no report, restart loop */
+                    continue;
+                }
+            } else {
+                /* end of packet array */
+                buff_up[buff_index] = ']';
                 ++buff_index;
+                /* add separator if needed */
+                if (send_report == true) {
+                    buff_up[buff_index] = ',';
+                    ++buff_index;
+                }
+            }
+
+            /* add status report if a new one is available */
+            if (send_report == true) {
+                pthread_mutex_lock(&mx_stat_rep);
+                report_ready = false;
+                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "%s", status_report);
+                pthread_mutex_unlock(&mx_stat_rep);
+                if (j > 0) {
+                    buff_index += j;
+                } else {
+                    MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 5));
+                    exit(EXIT_FAILURE);
+                }
             }
+
+            /* end of JSON datagram payload */
+            buff_up[buff_index] = '}';
+            ++buff_index;
+            buff_up[buff_index] = 0; /* add string terminator, for safety */
+
+            MSG_DEBUG(DEBUG_PKT_FWD, "\nJSON up: %s\n", (char *)(buff_up + 12)); /* DEBUG: display JSON payload */
         }
 
-        /* add status report if a new one is available */
-        if (send_report == true) {
-            pthread_mutex_lock(&mx_stat_rep);
-            report_ready = false;
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "%s", status_report);
-            pthread_mutex_unlock(&mx_stat_rep);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 5));
+        LGW_TRACE(TRACE_PKT_FWD >= LGW_TRACE_LVL_EVENT, LGW_TRACE_FWD_PUSH_DATA, (token_h << 8) | token_l, pkt_in_dgram, buff_index, 0, 0);
+
+        /* the JSON object is compressed once for all the servers asking for it */
+        iov_up.iov_len = buff_index;
+        if (compress == true) {
+            buff_lz4[1] = token_h;
+            buff_lz4[2] = token_l;
+            buff_lz4[12] = (uint8_t)(buff_index - 12);
+            buff_lz4[13] = (uint8_t)((buff_index - 12) >> 8);
+            buff_lz4[14] = (uint8_t)((buff_index - 12) >> 16);
+            buff_lz4[15] = (uint8_t)((buff_index - 12) >> 24);
+            j = lz4blk_compress(buff_up + 12, buff_index - 12, buff_lz4 + PUSH_DATA_LZ4_HEADER_SIZE, sizeof buff_lz4 - PUSH_DATA_LZ4_HEADER_SIZE, lz4blk_dict_up, lz4blk_dict_up_size);
+            if (j < 0) {
+                MSG("ERROR: [up] failed to compress PUSH_DATA\n");
                 exit(EXIT_FAILURE);
             }
+            iov_lz4.iov_len = PUSH_DATA_LZ4_HEADER_SIZE + j;
+            MEAS_ADD(meas_up.lz4_in_byte, buff_index - 12);
+            MEAS_ADD(meas_up.lz4_out_byte, j);
         }
 
-        /* end of JSON datagram payload */
-        buff_up[buff_index] = '}';
-        ++buff_index;
-        buff_up[buff_index] = 0; /* add string terminator, for safety */
-
-        printf("\nJSON up: %s\n", (char *)(buff_up + 12)); /* DEBUG: display JSON payload */
-
-        /* send datagram to server */
-        send(sock_up, (void *)buff_up, buff_index, 0);
+        /* send datagram to all servers, sendmmsg can stop before the last one */
+        for (i = 0; i < up_server_nb; i += j) {
+            j = sendmmsg(sock_up, &msg_up[i], up_server_nb - i, 0);
+            if (j <= 0) {
+                MSG("WARNING: [up] failed to send PUSH_DATA to server %d, %s\n", i, strerror(errno));
+                j = 1; /* skip this server */
+            }
+        }
         clock_gettime(CLOCK_MONOTONIC, &send_time);
-        pthread_mutex_lock(&mx_meas_up);
-        meas_up_dgram_sent += 1;
-        meas_up_network_byte += buff_index;
+        send_ns = ((int64_t)send_time.tv_sec * 1000000000) + send_time.tv_nsec;
 
-        /* wait for acknowledge (in 2 times, to catch extra packets) */
-        for (i=0; i<2; ++i) {
-            j = recv(sock_up, (void *)buff_ack, sizeof buff_ack, 0);
-            clock_gettime(CLOCK_MONOTONIC, &recv_time);
-            if (j == -1) {
-                if (errno == EAGAIN) { /* timeout */
-                    continue;
-                } else { /* server connection error */
-                    break;
-                }
-            } else if ((j < 4) || (buff_ack[0] != PROTOCOL_VERSION) || (buff_ack[3] != PKT_PUSH_ACK)) {
-                //MSG("WARNING: [up] ignored invalid non-ACL packet\n");
-                continue;
-            } else if ((buff_ack[1] != token_h) || (buff_ack[2] != token_l)) {
-                //MSG("WARNING: [up] ignored out-of sync ACK packet\n");
+        /* latency of each stage of the forwarded packets */
+        for (i = 0; i < nb_pkt; ++i) {
+            if (pkt_serial_ns[i] < 0) {
                 continue;
-            } else {
-                MSG("INFO: [up] PUSH_ACK received in %i ms\n", (int)(1000 * difftimespec(recv_time, send_time)));
-                meas_up_ack_rcv += 1;
-                break;
             }
+            up_lat_add(meas_up.lat_hist[UP_LAT_PARSE], rxpkt[i]->host_fetch_ns, rxpkt[i]->host_parse_ns);
+            up_lat_add(meas_up.lat_hist[UP_LAT_QUEUE], rxpkt[i]->host_parse_ns, pop_ns);
+            up_lat_add(meas_up.lat_hist[UP_LAT_SERIAL], pop_ns, pkt_serial_ns[i]);
+            up_lat_add(meas_up.lat_hist[UP_LAT_SEND], pkt_serial_ns[i], send_ns);
+            up_lat_add(meas_up.lat_hist[UP_LAT_TOTAL], rxpkt[i]->host_fetch_ns, send_ns);
         }
-        pthread_mutex_unlock(&mx_meas_up);
-    }
-    MSG("\nINFO: End of upstream thread\n");
-}
-
-/* -------------------------------------------------------------------------- */
-/* --- THREAD 2: POLLING SERVER AND ENQUEUING PACKETS IN JIT QUEUE ---------- */
-
-static int get_tx_gain_lut_index(uint8_t rf_chain, int8_t rf_power, uint8_t * lut_index) {
-    uint8_t pow_index;
-    int current_best_index = -1;
-    uint8_t current_best_match = 0xFF;
-    int diff;
 
-    /* Check input parameters */
-    if (lut_index == NULL) {
-        MSG("ERROR: %s - wrong parameter\n", __FUNCTION__);
-        return -1;
-    }
+        /* keep the datagrams carrying packets until the primary server acknowledges them */
+        jrn_ref.seq = 0;
+        if ((journal_path[0] != '\0') && (pkt_in_dgram > 0)) {
+            journal_append(&journal, msg_up[0].msg_hdr.msg_iov->iov_base, msg_up[0].msg_hdr.msg_iov->iov_len, &jrn_ref);
+        }
 
-    /* Search requested power in TX gain LUT */
-    for (pow_index = 0; pow_index < txlut[rf_chain].size; pow_index++) {
-        diff = rf_power - txlut[rf_chain].lut[pow_index].rf_power;
-        if (diff < 0) {
-            /* The selected power must be lower or equal to requested one */
-            continue;
-        } else {
-            /* Record the index corresponding to the closest rf_power available in LUT */
-            if ((current_best_index == -1) || (diff < current_best_match)) {
-                current_best_match = diff;
-                current_best_index = pow_index;
-            }
+        MEAS_ADD(meas_up.dgram_sent, 1);
+        MEAS_ADD(meas_up.network_byte, msg_up[0].msg_hdr.msg_iov->iov_len); /* as sent to the primary server */
+        if (journal_path[0] != '\0') {
+            MEAS_SET(meas_up.jrn_backlog, journal_backlog(&journal));
+            MEAS_SET(meas_up.jrn_dropped, journal.dropped);
         }
-    }
 
-    /* Return corresponding index */
-    if (current_best_index > -1) {
-        *lut_index = (uint8_t)current_best_index;
-    } else {
-        *lut_index = 0;
-        MSG("ERROR: %s - failed to find tx gain lut index\n", __FUNCTION__);
-        return -1;
+        /* the acknowledges are matched later, process the ones already received */
+        push_ack_register(0, token_h, token_l, send_time, jrn_ref);
+        jrn_ref.seq = 0;
+        for (i = 1; i < up_server_nb; i++) {
+            push_ack_register(i, token_h, token_l, send_time, jrn_ref);
+        }
+        push_ack_process();
     }
-
-    return 0;
+    pkt_pool_put(&pkt_pool, rxpkt, nb_pkt);
+    close(epfd);
+    MSG("\nINFO: End of upstream thread\n");
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 2: POLLING SERVER AND ENQUEUING PACKETS IN JIT QUEUE ---------- */
+
 void thread_down(void) {
     int i; /* loop variables */
 
     /* configuration and metadata for an outbound packet */
     struct lgw_pkt_tx_s txpkt;
-    bool sent_immediate = false; /* option to sent the packet immediately */
-
-    /* local timekeeping variables */
-    struct timespec send_time; /* time of the pull request */
-    struct timespec recv_time; /* time of return from recv socket call */
-
-    /* data buffers */
-    uint8_t buff_down[1000]; /* buffer to receive downstream packets */
-    uint8_t buff_req[12]; /* buffer to compose pull requests */
-    int msg_len;
-
-    /* protocol variables */
-    uint8_t token_h; /* random token for acknowledgement matching */
-    uint8_t token_l; /* random token for acknowledgement matching */
-    bool req_ack = false; /* keep track of whether PULL_DATA was acknowledged or not */
-
-    /* JSON parsing variables */
-    JSON_Value *root_val = NULL;
-    JSON_Object *txpk_obj = NULL;
-    JSON_Value *val = NULL; /* needed to detect the absence of some fields */
-    const char *str; /* pointer to sub-strings in the JSON data */
-    short x0, x1;
-    uint64_t x2;
-    double x3, x4;
-
-    /* variables to send on GPS timestamp */
-    struct tref local_ref; /* time reference used for GPS <-> timestamp conversion */
-    struct timespec gps_tx; /* GPS time that needs to be converted to timestamp */
-
-    /* beacon variables */
-    struct lgw_pkt_tx_s beacon_pkt;
-    uint8_t beacon_chan;
-    uint8_t beacon_loop;
-    size_t beacon_RFU1_size = 0;
-    size_t beacon_RFU2_size = 0;
-    uint8_t beacon_pyld_idx = 0;
-    time_t diff_beacon_time;
-    struct timespec next_beacon_gps_time; /* gps time of next beacon packet */
-    struct timespec last_beacon_gps_time; /* gps time of last enqueued beacon packet */
-    int retry;
-
-    /* beacon data fields, byte 0 is Least Significant Byte */
-    int32_t field_latitude; /* 3 bytes, derived from reference latitude */
-    int32_t field_longitude; /* 3 bytes, derived from reference longitude */
-    uint16_t field_crc1, field_crc2;
-
-    /* auto-quit variable */
-    uint32_t autoquit_cnt = 0; /* count the number of PULL_DATA sent since the latest PULL_ACK */
-
-    /* Just In Time downlink */
-    uint32_t current_concentrator_time;
-    enum jit_error_e jit_result = JIT_ERROR_OK;
-    enum jit_pkt_type_e downlink_type;
-    enum jit_error_e warning_result = JIT_ERROR_OK;
-    int32_t warning_value = 0;
-    uint8_t tx_lut_idx = 0;
-
-    /* set downstream socket RX timeout */
-    i = setsockopt(sock_down, SOL_SOCKET, SO_RCVTIMEO, (void *)&pull_timeout, sizeof pull_timeout);
-    if (i != 0) {
-        MSG("ERROR: [down] setsockopt returned %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-
-    /* pre-fill the pull request buffer with fixed fields */
-    buff_req[0] = PROTOCOL_VERSION;
-    buff_req[3] = PKT_PULL_DATA;
-    *(uint32_t *)(buff_req + 4) = net_mac_h;
-    *(uint32_t *)(buff_req + 8) = net_mac_l;
-
-    /* beacon variables initialization */
-    last_beacon_gps_time.tv_sec = 0;
-    last_beacon_gps_time.tv_nsec = 0;
-
-    /* beacon packet parameters */
-    beacon_pkt.tx_mode = ON_GPS; /* send on PPS pulse */
-    beacon_pkt.rf_chain = 0; /* antenna A */
-    beacon_pkt.rf_power = beacon_power;
-    beacon_pkt.modulation = MOD_LORA;
-    switch (beacon_bw_hz) {
-        case 125000:
-            beacon_pkt.bandwidth = BW_125KHZ;
-            break;
-        case 500000:
-            beacon_pkt.bandwidth = BW_500KHZ;
-            break;
-        default:
-            /* should not happen */
-            MSG("ERROR: unsupported bandwidth for beacon\n");
-            exit(EXIT_FAILURE);
-    }
-    switch (beacon_datarate) {
-        case 8:
-            beacon_pkt.datarate = DR_LORA_SF8;
-            beacon_RFU1_size = 1;
-            beacon_RFU2_size = 3;
-            break;
-        case 9:
-            beacon_pkt.datarate = DR_LORA_SF9;
-            beacon_RFU1_size = 2;
-            beacon_RFU2_size = 0;
-            break;
-        case 10:
-            beacon_pkt.datarate = DR_LORA_SF10;
-            beacon_RFU1_size = 3;
-            beacon_RFU2_size = 1;
-            break;
-        case 12:
-            beacon_pkt.datarate = DR_LORA_SF12;
-            beacon_RFU1_size = 5;
-            beacon_RFU2_size = 3;
-            break;
-        default:
-            /* should not happen */
-            MSG("ERROR: unsupported datarate for beacon\n");
-            exit(EXIT_FAILURE);
-    }
-    beacon_pkt.size = beacon_RFU1_size + 4 + 2 + 7 + beacon_RFU2_size + 2;
-    beacon_pkt.coderate = CR_LORA_4_5;
-    beacon_pkt.invert_pol = false;
-    beacon_pkt.preamble = 10;
-    beacon_pkt.no_crc = true;
-    beacon_pkt.no_header = true;
+    bool sent_immediate = false; /* option to sent the packet immediately */
 
-    /* network common part beacon fields (little endian) */
-    for (i = 0; i < (int)beacon_RFU1_size; i++) {
-        beacon_pkt.payload[beacon_pyld_idx++] = 0x0;
-    }
+    /* local timekeeping variables */
+    struct timespec send_time; /* time of the pull request */
+    struct timespec recv_time; /* time of return from recv socket call */
 
-    /* network common part beacon fields (little endian) */
-    beacon_pyld_idx += 4; /* time (variable), filled later */
-    beacon_pyld_idx += 2; /* crc1 (variable), filled later */
+    /* data buffers */
+    uint8_t buff_batch[DOWN_BATCH_NB][DOWN_BUFF_SIZE]; /* buffers to receive a batch of downstream packets */
+    struct iovec iov_batch[DOWN_BATCH_NB];
+    struct mmsghdr msg_batch[DOWN_BATCH_NB];
+    int msg_nb = 0; /* number of datagrams in the batch */
+    int msg_idx = 0; /* next datagram of the batch to be processed */
+    uint8_t * buff_down = NULL; /* datagram being processed */
+
+    /* event loop variables */
+    int epfd;
+    int ev_fd[2];
+    struct epoll_event ev[2];
+    int wait_ms;
+    uint8_t buff_req[12]; /* buffer to compose pull requests */
+    int msg_len;
 
-    /* calculate the latitude and longitude that must be publicly reported */
-    field_latitude = (int32_t)((reference_coord.lat / 90.0) * (double)(1<<23));
-    if (field_latitude > (int32_t)0x007FFFFF) {
-        field_latitude = (int32_t)0x007FFFFF; /* +90 N is represented as 89.99999 N */
-    } else if (field_latitude < (int32_t)0xFF800000) {
-        field_latitude = (int32_t)0xFF800000;
-    }
-    field_longitude = (int32_t)((reference_coord.lon / 180.0) * (double)(1<<23));
-    if (field_longitude > (int32_t)0x007FFFFF) {
-        field_longitude = (int32_t)0x007FFFFF; /* +180 E is represented as 179.99999 E */
-    } else if (field_longitude < (int32_t)0xFF800000) {
-        field_longitude = (int32_t)0xFF800000;
-    }
+    /* protocol variables */
+    uint8_t token_h; /* random token for acknowledgement matching */
+    uint8_t token_l; /* random token for acknowledgement matching */
+    bool req_ack = false; /* keep track of whether PULL_DATA was acknowledged or not */
 
-    /* gateway specific beacon fields */
-    beacon_pkt.payload[beacon_pyld_idx++] = beacon_infodesc;
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF &  field_latitude;
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (field_latitude >>  8);
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (field_latitude >> 16);
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF &  field_longitude;
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (field_longitude >>  8);
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (field_longitude >> 16);
+    /* JSON decoding variables */
+    struct txpk_dec_s txpk_dec;
+    enum txpk_dec_e dec_result;
+    double x3, x4;
 
-    /* RFU */
-    for (i = 0; i < (int)beacon_RFU2_size; i++) {
-        beacon_pkt.payload[beacon_pyld_idx++] = 0x0;
+    /* variables to send on GPS timestamp */
+    struct tref local_ref; /* time reference used for GPS <-> timestamp conversion */
+    bool ref_ok; /* is the copy of the GPS time reference valid */
+    struct timespec gps_tx; /* GPS time that needs to be converted to timestamp */
+
+    /* auto-quit variable */
+    uint32_t autoquit_cnt = 0; /* count the number of PULL_DATA sent since the latest PULL_ACK */
+
+    /* Just In Time downlink */
+    uint64_t current_concentrator_time;
+    enum jit_error_e jit_result = JIT_ERROR_OK;
+    enum jit_pkt_type_e downlink_type;
+    enum jit_error_e warning_result = JIT_ERROR_OK;
+    int32_t warning_value = 0;
+    int8_t tx_power_used;
+
+    /* wait for datagrams on epoll, the keep-alive deadline is given as epoll timeout */
+    ev_fd[0] = sock_down;
+    ev_fd[1] = exit_fd;
+    epfd = net_epoll_create(ev_fd, 2);
+    if (epfd < 0) {
+        MSG("ERROR: [down] failed to create epoll, %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
     }
 
-    /* CRC of the beacon gateway specific part fields */
-    field_crc2 = crc16((beacon_pkt.payload + 6 + beacon_RFU1_size), 7 + beacon_RFU2_size);
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF &  field_crc2;
-    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (field_crc2 >> 8);
+    /* describe the receive buffers, one datagram each, room is kept for a string terminator */
+    memset(msg_batch, 0, sizeof msg_batch);
+    for (i = 0; i < DOWN_BATCH_NB; i++) {
+        iov_batch[i].iov_base = (void *)buff_batch[i];
+        iov_batch[i].iov_len = DOWN_BUFF_SIZE - 1;
+        msg_batch[i].msg_hdr.msg_iov = &iov_batch[i];
+        msg_batch[i].msg_hdr.msg_iovlen = 1;
+    }
 
-    /* JIT queue initialization */
-    jit_queue_init(&jit_queue[0]);
-    jit_queue_init(&jit_queue[1]);
+    /* pre-fill the pull request buffer with fixed fields */
+    buff_req[0] = PROTOCOL_VERSION;
+    buff_req[3] = PKT_PULL_DATA;
+    *(uint32_t *)(buff_req + 4) = net_mac_h;
+    *(uint32_t *)(buff_req + 8) = net_mac_l;
 
     while (!exit_sig && !quit_sig) {
 
         /* auto-quit if the threshold is crossed */
         if ((autoquit_threshold > 0) && (autoquit_cnt >= autoquit_threshold)) {
             exit_sig = true;
+            eventfd_write(exit_fd, 1); /* wake up the threads waiting on events */
             MSG("INFO: [down] the last %u PULL_DATA were not ACKed, exiting application\n", autoquit_threshold);
             break;
         }
@@ -2722,9 +5407,7 @@ void thread_down(void) {
         /* send PULL request and record time */
         send(sock_down, (void *)buff_req, sizeof buff_req, 0);
         clock_gettime(CLOCK_MONOTONIC, &send_time);
-        pthread_mutex_lock(&mx_meas_dw);
-        meas_dw_pull_sent += 1;
-        pthread_mutex_unlock(&mx_meas_dw);
+        MEAS_ADD(meas_dw.pull_sent, 1);
         req_ack = false;
         autoquit_cnt++;
 
@@ -2732,114 +5415,23 @@ void thread_down(void) {
         recv_time = send_time;
         while (((int)difftimespec(recv_time, send_time) < keepalive_time) && !exit_sig && !quit_sig) {
 
-            /* try to receive a datagram */
-            msg_len = recv(sock_down, (void *)buff_down, (sizeof buff_down)-1, 0);
-            clock_gettime(CLOCK_MONOTONIC, &recv_time);
-
-            /* Pre-allocate beacon slots in JiT queue, to check downlink collisions */
-            beacon_loop = JIT_NUM_BEACON_IN_QUEUE - jit_queue[0].num_beacon;
-            retry = 0;
-            while (beacon_loop && (beacon_period != 0)) {
-                pthread_mutex_lock(&mx_timeref);
-                /* Wait for GPS to be ready before inserting beacons in JiT queue */
-                if ((gps_ref_valid == true) && (xtal_correct_ok == true)) {
-
-                    /* compute GPS time for next beacon to come      */
-                    /*   LoRaWAN: T = k*beacon_period + TBeaconDelay */
-                    /*            with TBeaconDelay = [1.5ms +/- 1µs]*/
-                    if (last_beacon_gps_time.tv_sec == 0) {
-                        /* if no beacon has been queued, get next slot from current GPS time */
-                        diff_beacon_time = time_reference_gps.gps.tv_sec % ((time_t)beacon_period);
-                        next_beacon_gps_time.tv_sec = time_reference_gps.gps.tv_sec +
-                                                        ((time_t)beacon_period - diff_beacon_time);
-                    } else {
-                        /* if there is already a beacon, take it as reference */
-                        next_beacon_gps_time.tv_sec = last_beacon_gps_time.tv_sec + beacon_period;
-                    }
-                    /* now we can add a beacon_period to the reference to get next beacon GPS time */
-                    next_beacon_gps_time.tv_sec += (retry * beacon_period);
-                    next_beacon_gps_time.tv_nsec = 0;
-
-#if DEBUG_BEACON
-                    {
-                    time_t time_unix;
-
-                    time_unix = time_reference_gps.gps.tv_sec + UNIX_GPS_EPOCH_OFFSET;
-                    MSG_DEBUG(DEBUG_BEACON, "GPS-now : %s", ctime(&time_unix));
-                    time_unix = last_beacon_gps_time.tv_sec + UNIX_GPS_EPOCH_OFFSET;
-                    MSG_DEBUG(DEBUG_BEACON, "GPS-last: %s", ctime(&time_unix));
-                    time_unix = next_beacon_gps_time.tv_sec + UNIX_GPS_EPOCH_OFFSET;
-                    MSG_DEBUG(DEBUG_BEACON, "GPS-next: %s", ctime(&time_unix));
-                    }
-#endif
-
-                    /* convert GPS time to concentrator time, and set packet counter for JiT trigger */
-                    lgw_gps2cnt(time_reference_gps, next_beacon_gps_time, &(beacon_pkt.count_us));
-                    pthread_mutex_unlock(&mx_timeref);
-
-                    /* apply frequency correction to beacon TX frequency */
-                    if (beacon_freq_nb > 1) {
-                        beacon_chan = (next_beacon_gps_time.tv_sec / beacon_period) % beacon_freq_nb; /* floor rounding */
-                    } else {
-                        beacon_chan = 0;
-                    }
-                    /* Compute beacon frequency */
-                    beacon_pkt.freq_hz = beacon_freq_hz + (beacon_chan * beacon_freq_step);
-
-                    /* load time in beacon payload */
-                    beacon_pyld_idx = beacon_RFU1_size;
-                    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF &  next_beacon_gps_time.tv_sec;
-                    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (next_beacon_gps_time.tv_sec >>  8);
-                    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (next_beacon_gps_time.tv_sec >> 16);
-                    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (next_beacon_gps_time.tv_sec >> 24);
-
-                    /* calculate CRC */
-                    field_crc1 = crc16(beacon_pkt.payload, 4 + beacon_RFU1_size); /* CRC for the network common part */
-                    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & field_crc1;
-                    beacon_pkt.payload[beacon_pyld_idx++] = 0xFF & (field_crc1 >> 8);
-
-                    /* Insert beacon packet in JiT queue */
-                    pthread_mutex_lock(&mx_concent);
-                    lgw_get_instcnt(&current_concentrator_time);
-                    pthread_mutex_unlock(&mx_concent);
-                    jit_result = jit_enqueue(&jit_queue[0], current_concentrator_time, &beacon_pkt, JIT_PKT_TYPE_BEACON);
-                    if (jit_result == JIT_ERROR_OK) {
-                        /* update stats */
-                        pthread_mutex_lock(&mx_meas_dw);
-                        meas_nb_beacon_queued += 1;
-                        pthread_mutex_unlock(&mx_meas_dw);
-
-                        /* One more beacon in the queue */
-                        beacon_loop--;
-                        retry = 0;
-                        last_beacon_gps_time.tv_sec = next_beacon_gps_time.tv_sec; /* keep this beacon time as reference for next one to be programmed */
-
-                        /* display beacon payload */
-                        MSG("INFO: Beacon queued (count_us=%u, freq_hz=%u, size=%u):\n", beacon_pkt.count_us, beacon_pkt.freq_hz, beacon_pkt.size);
-                        printf( "   => " );
-                        for (i = 0; i < beacon_pkt.size; ++i) {
-                            MSG("%02X ", beacon_pkt.payload[i]);
-                        }
-                        MSG("\n");
-                    } else {
-                        MSG_DEBUG(DEBUG_BEACON, "--> beacon queuing failed with %d\n", jit_result);
-                        /* update stats */
-                        pthread_mutex_lock(&mx_meas_dw);
-                        if (jit_result != JIT_ERROR_COLLISION_BEACON) {
-                            meas_nb_beacon_rejected += 1;
-                        }
-                        pthread_mutex_unlock(&mx_meas_dw);
-                        /* In case previous enqueue failed, we retry one period later until it succeeds */
-                        /* Note: In case the GPS has been unlocked for a while, there can be lots of retries */
-                        /*       to be done from last beacon time to a new valid one */
-                        retry++;
-                        MSG_DEBUG(DEBUG_BEACON, "--> beacon queuing retry=%d\n", retry);
-                    }
-                } else {
-                    pthread_mutex_unlock(&mx_timeref);
-                    break;
-                }
+            /* once the previous batch is processed, send its TX_ACK and wait for a new one */
+            /* until the next keep-alive */
+            if (msg_idx >= msg_nb) {
+                flush_tx_ack();
+                wait_ms = (int)(1000 * (keepalive_time - difftimespec(recv_time, send_time))) + 1;
+                epoll_wait(epfd, ev, 2, (wait_ms > 0) ? wait_ms : 0);
+                msg_nb = recvmmsg(sock_down, msg_batch, DOWN_BATCH_NB, MSG_DONTWAIT, NULL);
+                msg_idx = 0;
+            }
+            if (msg_nb > 0) {
+                buff_down = buff_batch[msg_idx];
+                msg_len = (int)msg_batch[msg_idx].msg_len;
+                msg_idx += 1;
+            } else {
+                msg_len = -1;
             }
+            clock_gettime(CLOCK_MONOTONIC, &recv_time);
 
             /* if no network message was received, got back to listening sock_down socket */
             if (msg_len == -1) {
@@ -2862,9 +5454,7 @@ void thread_down(void) {
                     } else { /* if that packet was not already acknowledged */
                         req_ack = true;
                         autoquit_cnt = 0;
-                        pthread_mutex_lock(&mx_meas_dw);
-                        meas_dw_ack_rcv += 1;
-                        pthread_mutex_unlock(&mx_meas_dw);
+                        MEAS_ADD(meas_dw.ack_rcv, 1);
                         MSG("INFO: [down] PULL_ACK received in %i ms\n", (int)(1000 * difftimespec(recv_time, send_time)));
                     }
                 } else { /* out-of-sync token */
@@ -2878,55 +5468,63 @@ void thread_down(void) {
             MSG("INFO: [down] PULL_RESP received  - token[%d:%d] :)\n", buff_down[1], buff_down[2]); /* very verbose */
             printf("\nJSON down: %s\n", (char *)(buff_down + 4)); /* DEBUG: display JSON payload */
 
-            /* initialize TX struct and try to parse JSON */
-            memset(&txpkt, 0, sizeof txpkt);
-            root_val = json_parse_string_with_comments((const char *)(buff_down + 4)); /* JSON offset */
-            if (root_val == NULL) {
-                MSG("WARNING: [down] invalid JSON, TX aborted\n");
-                continue;
+            /* decode the txpk object straight into the TX struct */
+            dec_result = txpk_decode((char *)(buff_down + 4), &txpkt, &txpk_dec); /* JSON offset */
+            switch (dec_result) {
+                case TXPK_DEC_OK:
+                    break;
+                case TXPK_DEC_ERR_NO_TXPK:
+                    MSG("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
+                    break;
+                case TXPK_DEC_ERR_TYPE:
+                    MSG("WARNING: [down] invalid type of \"txpk.%s\" object in JSON, TX aborted\n", txpk_key_name(txpk_dec.key));
+                    break;
+                case TXPK_DEC_ERR_MODU:
+                    MSG("WARNING: [down] invalid modulation in \"txpk.modu\", TX aborted\n");
+                    break;
+                case TXPK_DEC_ERR_DATR:
+                    MSG("WARNING: [down] format error in \"txpk.datr\", TX aborted\n");
+                    break;
+                case TXPK_DEC_ERR_SF:
+                    MSG("WARNING: [down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
+                    break;
+                case TXPK_DEC_ERR_BW:
+                    MSG("WARNING: [down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
+                    break;
+                case TXPK_DEC_ERR_CODR:
+                    MSG("WARNING: [down] format error in \"txpk.codr\", TX aborted\n");
+                    break;
+                default:
+                    MSG("WARNING: [down] invalid JSON, TX aborted\n");
+                    break;
             }
-
-            /* look for JSON sub-object 'txpk' */
-            txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
-            if (txpk_obj == NULL) {
-                MSG("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
+            if (dec_result != TXPK_DEC_OK) {
                 continue;
             }
 
             /* Parse "immediate" tag, or target timestamp, or UTC time to be converted by GPS (mandatory) */
-            i = json_object_get_boolean(txpk_obj,"imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
-            if (i == 1) {
+            if (txpk_dec.imme == true) {
                 /* TX procedure: send immediately */
                 sent_immediate = true;
                 downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_C;
                 MSG("INFO: [down] a packet will be sent in \"immediate\" mode\n");
             } else {
                 sent_immediate = false;
-                val = json_object_get_value(txpk_obj,"tmst");
-                if (val != NULL) {
-                    /* TX procedure: send on timestamp value */
-                    txpkt.count_us = (uint32_t)json_value_get_number(val);
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_TMST)) != 0) {
+                    /* TX procedure: send on timestamp value, already in txpkt.count_us */
 
                     /* Concentrator timestamp is given, we consider it is a Class A downlink */
                     downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
                 } else {
                     /* TX procedure: send on GPS time (converted to timestamp value) */
-                    val = json_object_get_value(txpk_obj, "tmms");
-                    if (val == NULL) {
+                    if ((txpk_dec.found & TXPK_FOUND(TXPK_TMMS)) == 0) {
                         MSG("WARNING: [down] no mandatory \"txpk.tmst\" or \"txpk.tmms\" objects in JSON, TX aborted\n");
-                        json_value_free(root_val);
                         continue;
                     }
                     if (gps_enabled == true) {
-                        pthread_mutex_lock(&mx_timeref);
-                        if (gps_ref_valid == true) {
-                            local_ref = time_reference_gps;
-                            pthread_mutex_unlock(&mx_timeref);
-                        } else {
-                            pthread_mutex_unlock(&mx_timeref);
+                        timeref_get(&ref_ok, &local_ref);
+                        if (ref_ok == false) {
                             MSG("WARNING: [down] no valid GPS time reference yet, impossible to send packet on specific GPS time, TX aborted\n");
-                            json_value_free(root_val);
 
                             /* send acknoledge datagram to server */
                             send_tx_ack(buff_down[1], buff_down[2], JIT_ERROR_GPS_UNLOCKED, 0);
@@ -2934,18 +5532,14 @@ void thread_down(void) {
                         }
                     } else {
                         MSG("WARNING: [down] GPS disabled, impossible to send packet on specific GPS time, TX aborted\n");
-                        json_value_free(root_val);
 
                         /* send acknoledge datagram to server */
                         send_tx_ack(buff_down[1], buff_down[2], JIT_ERROR_GPS_UNLOCKED, 0);
                         continue;
                     }
 
-                    /* Get GPS time from JSON */
-                    x2 = (uint64_t)json_value_get_number(val);
-
                     /* Convert GPS time from milliseconds to timespec */
-                    x3 = modf((double)x2/1E3, &x4);
+                    x3 = modf((double)txpk_dec.tmms/1E3, &x4);
                     gps_tx.tv_sec = (time_t)x4; /* get seconds from integer part */
                     gps_tx.tv_nsec = (long)(x3 * 1E9); /* get nanoseconds from fractional part */
 
@@ -2953,7 +5547,6 @@ void thread_down(void) {
                     i = lgw_gps2cnt(local_ref, gps_tx, &(txpkt.count_us));
                     if (i != LGW_GPS_SUCCESS) {
                         MSG("WARNING: [down] could not convert GPS time to timestamp, TX aborted\n");
-                        json_value_free(root_val);
                         continue;
                     } else {
                         MSG("INFO: [down] a packet will be sent on timestamp value %u (calculated from GPS time)\n", txpkt.count_us);
@@ -2964,197 +5557,83 @@ void thread_down(void) {
                 }
             }
 
-            /* Parse "No CRC" flag (optional field) */
-            val = json_object_get_value(txpk_obj,"ncrc");
-            if (val != NULL) {
-                txpkt.no_crc = (bool)json_value_get_boolean(val);
-            }
-
-            /* Parse "No header" flag (optional field) */
-            val = json_object_get_value(txpk_obj,"nhdr");
-            if (val != NULL) {
-                txpkt.no_header = (bool)json_value_get_boolean(val);
-            }
-
-            /* parse target frequency (mandatory) */
-            val = json_object_get_value(txpk_obj,"freq");
-            if (val == NULL) {
+            /* check target frequency (mandatory) */
+            if ((txpk_dec.found & TXPK_FOUND(TXPK_FREQ)) == 0) {
                 MSG("WARNING: [down] no mandatory \"txpk.freq\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            txpkt.freq_hz = (uint32_t)((double)(1.0e6) * json_value_get_number(val));
 
-            /* parse RF chain used for TX (mandatory) */
-            val = json_object_get_value(txpk_obj,"rfch");
-            if (val == NULL) {
+            /* check RF chain used for TX (mandatory) */
+            if ((txpk_dec.found & TXPK_FOUND(TXPK_RFCH)) == 0) {
                 MSG("WARNING: [down] no mandatory \"txpk.rfch\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            txpkt.rf_chain = (uint8_t)json_value_get_number(val);
-            if (tx_enable[txpkt.rf_chain] == false) {
+            if ((txpkt.rf_chain >= LGW_RF_CHAIN_NB) || (tx_enable[txpkt.rf_chain] == false)) {
                 MSG("WARNING: [down] TX is not enabled on RF chain %u, TX aborted\n", txpkt.rf_chain);
-                json_value_free(root_val);
                 continue;
             }
 
-            /* parse TX power (optional field) */
-            val = json_object_get_value(txpk_obj,"powe");
-            if (val != NULL) {
-                txpkt.rf_power = (int8_t)json_value_get_number(val) - antenna_gain;
+            /* TX power (optional field), requested at the antenna */
+            if ((txpk_dec.found & TXPK_FOUND(TXPK_POWE)) != 0) {
+                txpkt.rf_power -= antenna_gain;
             }
 
-            /* Parse modulation (mandatory) */
-            str = json_object_get_string(txpk_obj, "modu");
-            if (str == NULL) {
+            /* check modulation (mandatory) */
+            if ((txpk_dec.found & TXPK_FOUND(TXPK_MODU)) == 0) {
                 MSG("WARNING: [down] no mandatory \"txpk.modu\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            if (strcmp(str, "LORA") == 0) {
-                /* Lora modulation */
-                txpkt.modulation = MOD_LORA;
-
-                /* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
-                str = json_object_get_string(txpk_obj, "datr");
-                if (str == NULL) {
+            if (txpkt.modulation == MOD_LORA) {
+                /* check Lora spreading-factor and modulation bandwidth (mandatory) */
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_DATR)) == 0) {
                     MSG("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                i = sscanf(str, "SF%2hdBW%3hd", &x0, &x1);
-                if (i != 2) {
-                    MSG("WARNING: [down] format error in \"txpk.datr\", TX aborted\n");
-                    json_value_free(root_val);
-                    continue;
-                }
-                switch (x0) {
-                    case  5: txpkt.datarate = DR_LORA_SF5;  break;
-                    case  6: txpkt.datarate = DR_LORA_SF6;  break;
-                    case  7: txpkt.datarate = DR_LORA_SF7;  break;
-                    case  8: txpkt.datarate = DR_LORA_SF8;  break;
-                    case  9: txpkt.datarate = DR_LORA_SF9;  break;
-                    case 10: txpkt.datarate = DR_LORA_SF10; break;
-                    case 11: txpkt.datarate = DR_LORA_SF11; break;
-                    case 12: txpkt.datarate = DR_LORA_SF12; break;
-                    default:
-                        MSG("WARNING: [down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
-                        json_value_free(root_val);
-                        continue;
-                }
-                switch (x1) {
-                    case 125: txpkt.bandwidth = BW_125KHZ; break;
-                    case 250: txpkt.bandwidth = BW_250KHZ; break;
-                    case 500: txpkt.bandwidth = BW_500KHZ; break;
-                    default:
-                        MSG("WARNING: [down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
-                        json_value_free(root_val);
-                        continue;
-                }
 
-                /* Parse ECC coding rate (optional field) */
-                str = json_object_get_string(txpk_obj, "codr");
-                if (str == NULL) {
+                /* check ECC coding rate */
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_CODR)) == 0) {
                     MSG("WARNING: [down] no mandatory \"txpk.codr\" object in json, TX aborted\n");
-                    json_value_free(root_val);
-                    continue;
-                }
-                if      (strcmp(str, "4/5") == 0) txpkt.coderate = CR_LORA_4_5;
-                else if (strcmp(str, "4/6") == 0) txpkt.coderate = CR_LORA_4_6;
-                else if (strcmp(str, "2/3") == 0) txpkt.coderate = CR_LORA_4_6;
-                else if (strcmp(str, "4/7") == 0) txpkt.coderate = CR_LORA_4_7;
-                else if (strcmp(str, "4/8") == 0) txpkt.coderate = CR_LORA_4_8;
-                else if (strcmp(str, "1/2") == 0) txpkt.coderate = CR_LORA_4_8;
-                else {
-                    MSG("WARNING: [down] format error in \"txpk.codr\", TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
 
-                /* Parse signal polarity switch (optional field) */
-                val = json_object_get_value(txpk_obj,"ipol");
-                if (val != NULL) {
-                    txpkt.invert_pol = (bool)json_value_get_boolean(val);
-                }
-
-                /* parse Lora preamble length (optional field, optimum min value enforced) */
-                val = json_object_get_value(txpk_obj,"prea");
-                if (val != NULL) {
-                    i = (int)json_value_get_number(val);
-                    if (i >= MIN_LORA_PREAMB) {
-                        txpkt.preamble = (uint16_t)i;
-                    } else {
-                        txpkt.preamble = (uint16_t)MIN_LORA_PREAMB;
-                    }
-                } else {
+                /* Lora preamble length (optional field, optimum min value enforced) */
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_PREA)) == 0) {
                     txpkt.preamble = (uint16_t)STD_LORA_PREAMB;
+                } else if (txpkt.preamble < MIN_LORA_PREAMB) {
+                    txpkt.preamble = (uint16_t)MIN_LORA_PREAMB;
                 }
-
-            } else if (strcmp(str, "FSK") == 0) {
-                /* FSK modulation */
-                txpkt.modulation = MOD_FSK;
-
-                /* parse FSK bitrate (mandatory) */
-                val = json_object_get_value(txpk_obj,"datr");
-                if (val == NULL) {
+            } else {
+                /* check FSK bitrate (mandatory) */
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_DATR)) == 0) {
                     MSG("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                txpkt.datarate = (uint32_t)(json_value_get_number(val));
 
-                /* parse frequency deviation (mandatory) */
-                val = json_object_get_value(txpk_obj,"fdev");
-                if (val == NULL) {
+                /* check frequency deviation (mandatory) */
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_FDEV)) == 0) {
                     MSG("WARNING: [down] no mandatory \"txpk.fdev\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                txpkt.f_dev = (uint8_t)(json_value_get_number(val) / 1000.0); /* JSON value in Hz, txpkt.f_dev in kHz */
-
-                /* parse FSK preamble length (optional field, optimum min value enforced) */
-                val = json_object_get_value(txpk_obj,"prea");
-                if (val != NULL) {
-                    i = (int)json_value_get_number(val);
-                    if (i >= MIN_FSK_PREAMB) {
-                        txpkt.preamble = (uint16_t)i;
-                    } else {
-                        txpkt.preamble = (uint16_t)MIN_FSK_PREAMB;
-                    }
-                } else {
+
+                /* FSK preamble length (optional field, optimum min value enforced) */
+                if ((txpk_dec.found & TXPK_FOUND(TXPK_PREA)) == 0) {
                     txpkt.preamble = (uint16_t)STD_FSK_PREAMB;
+                } else if (txpkt.preamble < MIN_FSK_PREAMB) {
+                    txpkt.preamble = (uint16_t)MIN_FSK_PREAMB;
                 }
-
-            } else {
-                MSG("WARNING: [down] invalid modulation in \"txpk.modu\", TX aborted\n");
-                json_value_free(root_val);
-                continue;
             }
 
-            /* Parse payload length (mandatory) */
-            val = json_object_get_value(txpk_obj,"size");
-            if (val == NULL) {
+            /* check payload length (mandatory) */
+            if ((txpk_dec.found & TXPK_FOUND(TXPK_SIZE)) == 0) {
                 MSG("WARNING: [down] no mandatory \"txpk.size\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            txpkt.size = (uint16_t)json_value_get_number(val);
 
-            /* Parse payload data (mandatory) */
-            str = json_object_get_string(txpk_obj, "data");
-            if (str == NULL) {
+            /* check payload data (mandatory), decoded once the packet is admitted */
+            if ((txpk_dec.found & TXPK_FOUND(TXPK_DATA)) == 0) {
                 MSG("WARNING: [down] no mandatory \"txpk.data\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            i = b64_to_bin(str, strlen(str), txpkt.payload, sizeof txpkt.payload);
-            if (i != txpkt.size) {
-                MSG("WARNING: [down] mismatch between .size and .data size once converter to binary\n");
-            }
-
-            /* free the JSON parse tree from memory */
-            json_value_free(root_val);
 
             /* select TX mode */
             if (sent_immediate) {
@@ -3164,11 +5643,9 @@ void thread_down(void) {
             }
 
             /* record measurement data */
-            pthread_mutex_lock(&mx_meas_dw);
-            meas_dw_dgram_rcv += 1; /* count only datagrams with no JSON errors */
-            meas_dw_network_byte += msg_len; /* meas_dw_network_byte */
-            meas_dw_payload_byte += txpkt.size;
-            pthread_mutex_unlock(&mx_meas_dw);
+            MEAS_ADD(meas_dw.dgram_rcv, 1); /* count only datagrams with no JSON errors */
+            MEAS_ADD(meas_dw.network_byte, msg_len);
+            MEAS_ADD(meas_dw.payload_byte, txpkt.size);
 
             /* reset error/warning results */
             jit_result = warning_result = JIT_ERROR_OK;
@@ -3180,39 +5657,58 @@ void thread_down(void) {
                 MSG("ERROR: Packet REJECTED, unsupported frequency - %u (min:%u,max:%u)\n", txpkt.freq_hz, tx_freq_min[txpkt.rf_chain], tx_freq_max[txpkt.rf_chain]);
             }
 
+            /* admission: reject the packet from its timestamp and the JIT queue occupancy, before decoding its payload */
+            if (jit_result == JIT_ERROR_OK) {
+                get_concentrator_time(&current_concentrator_time);
+                jit_result = jit_admit(&jit_queue[txpkt.rf_chain], current_concentrator_time, txpkt.count_us, downlink_type);
+                if (jit_result != JIT_ERROR_OK) {
+                    printf("ERROR: Packet REJECTED (jit error=%d)\n", jit_result);
+                    MEAS_ADD(meas_dw.tx_requested, 1);
+                    MEAS_ADD(meas_dw.tx_rejected_admission, 1);
+                }
+            }
+
+            /* decode the payload */
+            if (jit_result == JIT_ERROR_OK) {
+                if (txpk_decode_payload(&txpk_dec, &txpkt) != txpkt.size) {
+                    MSG("WARNING: [down] mismatch between .size and .data size once converter to binary\n");
+                }
+            }
+
             /* check TX power before trying to queue packet, send a warning if not supported */
             if (jit_result == JIT_ERROR_OK) {
-                i = get_tx_gain_lut_index(txpkt.rf_chain, txpkt.rf_power, &tx_lut_idx);
-                if ((i < 0) || (txlut[txpkt.rf_chain].lut[tx_lut_idx].rf_power != txpkt.rf_power)) {
+                tx_power_used = txpkt.rf_power;
+                if (lgw_txgain_lookup(txpkt.rf_chain, txpkt.rf_power, NULL, &tx_power_used) != LGW_HAL_SUCCESS) {
                     /* this RF power is not supported, throw a warning, and use the closest lower power supported */
                     warning_result = JIT_ERROR_TX_POWER;
-                    warning_value = (int32_t)txlut[txpkt.rf_chain].lut[tx_lut_idx].rf_power;
+                    warning_value = (int32_t)tx_power_used;
                     printf("WARNING: Requested TX power is not supported (%ddBm), actual power used: %ddBm\n", txpkt.rf_power, warning_value);
-                    txpkt.rf_power = txlut[txpkt.rf_chain].lut[tx_lut_idx].rf_power;
+                    txpkt.rf_power = tx_power_used;
                 }
             }
 
             /* insert packet to be sent into JIT queue */
             if (jit_result == JIT_ERROR_OK) {
-                pthread_mutex_lock(&mx_concent);
-                lgw_get_instcnt(&current_concentrator_time);
-                pthread_mutex_unlock(&mx_concent);
                 jit_result = jit_enqueue(&jit_queue[txpkt.rf_chain], current_concentrator_time, &txpkt, downlink_type);
                 if (jit_result != JIT_ERROR_OK) {
                     printf("ERROR: Packet REJECTED (jit error=%d)\n", jit_result);
                 } else {
+                    /* the JIT thread may be sleeping until a later packet */
+                    sem_post(&jit_wakeup);
+                    down_token_add(txpkt.rf_chain, txpkt.count_us64, buff_down[1], buff_down[2]);
+
                     /* In case of a warning having been raised before, we notify it */
                     jit_result = warning_result;
                 }
-                pthread_mutex_lock(&mx_meas_dw);
-                meas_nb_tx_requested += 1;
-                pthread_mutex_unlock(&mx_meas_dw);
+                MEAS_ADD(meas_dw.tx_requested, 1);
             }
 
             /* Send acknoledge datagram to server */
             send_tx_ack(buff_down[1], buff_down[2], jit_result, warning_value);
         }
+        flush_tx_ack();
     }
+    close(epfd);
     MSG("\nINFO: End of downstream thread\n");
 }
 
@@ -3244,44 +5740,68 @@ void thread_jit(void) {
     int result = LGW_HAL_SUCCESS;
     struct lgw_pkt_tx_s pkt;
     int pkt_index = -1;
-    uint32_t current_concentrator_time;
+    uint64_t current_concentrator_time;
     enum jit_error_e jit_result;
     enum jit_pkt_type_e pkt_type;
     uint8_t tx_status;
+    uint32_t delay_us;
+    uint32_t wait_us;
+    struct lgw_pkt_tx_s tx_pkt[LGW_RF_CHAIN_NB]; /* packets due, one per TX chain */
+    int tx_result[LGW_RF_CHAIN_NB];
+    int nb_tx;
+    struct cmd_tx_status_s cmd_status;
+    struct cmd_send_s cmd_tx = { tx_pkt, 0, tx_result, 0 };
     int i;
 
     while (!exit_sig && !quit_sig) {
-        wait_ms(10);
+        /* upload the first queued packets ahead of their slot, when their TX chain is free */
+        wait_us = JIT_WAIT_MAX_US;
+        for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+            if (jit_get_head(&jit_queue[i], &pkt, &pkt_type) == JIT_ERROR_OK) {
+                if (pkt_type == JIT_PKT_TYPE_BEACON) {
+                    pkt.freq_hz = beacon_freq_correct(pkt.freq_hz);
+                }
+                result = concent_run(&concent, CONCENT_CMD_SEND_PREPARE, cmd_send_prepare, &pkt);
+                if (result != LGW_HAL_SUCCESS) {
+                    /* try again once the ongoing TX is done, else it is fully sent when due */
+                    wait_us = JIT_PREPARE_RETRY_US;
+                }
+            }
+        }
+
+        /* sleep until the first queued packet is due, or until a packet is enqueued */
+        get_concentrator_time(&current_concentrator_time);
+        for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+            if ((jit_peek_delay(&jit_queue[i], current_concentrator_time, &delay_us) == JIT_ERROR_OK) && (delay_us < wait_us)) {
+                wait_us = delay_us;
+            }
+        }
+        if (wait_us > 0) {
+            jit_wait(wait_us);
+        }
 
+        /* dequeue the packets due on each TX chain, they are sent together */
+        nb_tx = 0;
         for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
-            /* transfer data and metadata to the concentrator, and schedule TX */
-            pthread_mutex_lock(&mx_concent);
-            lgw_get_instcnt(&current_concentrator_time);
-            pthread_mutex_unlock(&mx_concent);
+            get_concentrator_time(&current_concentrator_time);
             jit_result = jit_peek(&jit_queue[i], current_concentrator_time, &pkt_index);
             if (jit_result == JIT_ERROR_OK) {
                 if (pkt_index > -1) {
-                    jit_result = jit_dequeue(&jit_queue[i], pkt_index, &pkt, &pkt_type);
+                    jit_result = jit_dequeue(&jit_queue[i], pkt_index, &tx_pkt[nb_tx], &pkt_type);
                     if (jit_result == JIT_ERROR_OK) {
                         /* update beacon stats */
                         if (pkt_type == JIT_PKT_TYPE_BEACON) {
-                            /* Compensate breacon frequency with xtal error */
-                            pthread_mutex_lock(&mx_xcorr);
-                            pkt.freq_hz = (uint32_t)(xtal_correct * (double)pkt.freq_hz);
-                            MSG_DEBUG(DEBUG_BEACON, "beacon_pkt.freq_hz=%u (xtal_correct=%.15lf)\n", pkt.freq_hz, xtal_correct);
-                            pthread_mutex_unlock(&mx_xcorr);
+                            tx_pkt[nb_tx].freq_hz = beacon_freq_correct(tx_pkt[nb_tx].freq_hz);
 
                             /* Update statistics */
-                            pthread_mutex_lock(&mx_meas_dw);
-                            meas_nb_beacon_sent += 1;
-                            pthread_mutex_unlock(&mx_meas_dw);
-                            MSG("INFO: Beacon dequeued (count_us=%u)\n", pkt.count_us);
+                            MEAS_ADD(meas_jit.beacon_sent, 1);
+                            MSG("INFO: Beacon dequeued (count_us=%u)\n", tx_pkt[nb_tx].count_us);
                         }
 
                         /* check if concentrator is free for sending new packet */
-                        pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-                        result = lgw_status(pkt.rf_chain, TX_STATUS, &tx_status);
-                        pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
+                        cmd_status.rf_chain = tx_pkt[nb_tx].rf_chain;
+                        result = concent_run(&concent, CONCENT_CMD_TX_STATUS, cmd_tx_status, &cmd_status); /* may have to wait for a fetch to finish */
+                        tx_status = cmd_status.status;
                         if (result == LGW_HAL_ERROR) {
                             MSG("WARNING: [jit%d] lgw_status failed\n", i);
                         } else {
@@ -3296,29 +5816,7 @@ void thread_jit(void) {
                                 /* Nothing to do */
                             }
                         }
-
-                        /* send packet to concentrator */
-                        pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-                        if (spectral_scan_params.enable == true) {
-                            result = lgw_spectral_scan_abort();
-                            if (result != LGW_HAL_SUCCESS) {
-                                MSG("WARNING: [jit%d] lgw_spectral_scan_abort failed\n", i);
-                            }
-                        }
-                        result = lgw_send(&pkt);
-                        pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
-                        if (result != LGW_HAL_SUCCESS) {
-                            pthread_mutex_lock(&mx_meas_dw);
-                            meas_nb_tx_fail += 1;
-                            pthread_mutex_unlock(&mx_meas_dw);
-                            MSG("WARNING: [jit] lgw_send failed on rf_chain %d\n", i);
-                            continue;
-                        } else {
-                            pthread_mutex_lock(&mx_meas_dw);
-                            meas_nb_tx_ok += 1;
-                            pthread_mutex_unlock(&mx_meas_dw);
-                            MSG_DEBUG(DEBUG_PKT_FWD, "lgw_send done on rf_chain %d: count_us=%u\n", i, pkt.count_us);
-                        }
+                        nb_tx += 1;
                     } else {
                         MSG("ERROR: jit_dequeue failed on rf_chain %d with %d\n", i, jit_result);
                     }
@@ -3329,6 +5827,27 @@ void thread_jit(void) {
                 MSG("ERROR: jit_peek failed on rf_chain %d with %d\n", i, jit_result);
             }
         }
+        if (nb_tx == 0) {
+            continue;
+        }
+
+        /* transfer data and metadata to the concentrator, and schedule TX, in a single transfer */
+        cmd_tx.nb_pkt = (uint8_t)nb_tx;
+        concent_run(&concent, CONCENT_CMD_SEND, cmd_send, &cmd_tx); /* may have to wait for a fetch to finish */
+        current_concentrator_time = cmd_tx.count_us;
+        for (i = 0; i < nb_tx; i++) {
+            if ((tx_pkt[i].tx_mode == TIMESTAMPED) && ((int64_t)(tx_pkt[i].count_us64 - current_concentrator_time) < JIT_TX_LATE_US)) {
+                MEAS_ADD(meas_jit.tx_late, 1);
+            }
+            if (tx_result[i] != LGW_HAL_SUCCESS) {
+                MEAS_ADD(meas_jit.tx_fail, 1);
+                MSG("WARNING: [jit] lgw_send failed on rf_chain %d\n", tx_pkt[i].rf_chain);
+            } else {
+                MEAS_ADD(meas_jit.tx_ok, 1);
+                jit_airtime_charge(&tx_pkt[i]); /* its reservation was released by jit_dequeue */
+                MSG_DEBUG(DEBUG_PKT_FWD, "lgw_send done on rf_chain %d: count_us=%u\n", tx_pkt[i].rf_chain, tx_pkt[i].count_us);
+            }
+        }
     }
 
     MSG("\nINFO: End of JIT thread\n");
@@ -3341,6 +5860,8 @@ static void gps_process_sync(void) {
     struct timespec gps_time;
     struct timespec utc;
     uint32_t trig_tstamp; /* concentrator timestamp associated with PPM pulse */
+    struct cmd_counter_s cmd_cnt = { NULL, &trig_tstamp };
+    struct tref new_ref;
     int i = lgw_gps_get(&utc, &gps_time, NULL, NULL);
 
     /* get GPS time for synchronization */
@@ -3350,17 +5871,21 @@ static void gps_process_sync(void) {
     }
 
     /* get timestamp captured on PPM pulse  */
-    pthread_mutex_lock(&mx_concent);
-    i = lgw_get_trigcnt(&trig_tstamp);
-    pthread_mutex_unlock(&mx_concent);
+    i = concent_run(&concent, CONCENT_CMD_COUNTER, cmd_counter, &cmd_cnt);
     if (i != LGW_HAL_SUCCESS) {
         MSG("WARNING: [gps] failed to read concentrator timestamp\n");
         return;
     }
 
-    /* try to update time reference with the new GPS time & timestamp */
+    /* try to update the clock estimator with the new GPS time & timestamp, and publish the new time reference */
     pthread_mutex_lock(&mx_timeref);
-    i = lgw_gps_sync(&time_reference_gps, trig_tstamp, utc, gps_time);
+    i = lgw_clock_update(&gps_clock, trig_tstamp, utc, gps_time);
+    if (i == LGW_GPS_SUCCESS) {
+        lgw_clock_tref(&gps_clock, &new_ref);
+        seq_write_begin(&seq_timeref);
+        time_reference_gps = new_ref;
+        seq_write_end(&seq_timeref);
+    }
     pthread_mutex_unlock(&mx_timeref);
     if (i != LGW_GPS_SUCCESS) {
         MSG("WARNING: [gps] GPS out of sync, keeping previous time reference\n");
@@ -3388,95 +5913,39 @@ static void gps_process_coords(void) {
 
 void thread_gps(void) {
     /* serial variables */
-    char serial_buff[128]; /* buffer to receive GPS data */
-    size_t wr_idx = 0;     /* pointer to end of chars in buffer */
+    uint8_t serial_buff[128]; /* buffer to receive GPS data */
+    size_t rd_idx;
 
     /* variables for PPM pulse GPS synchronization */
+    struct lgw_gps_stream_s stream; /* frame being received, kept between reads */
     enum gps_msg latest_msg; /* keep track of latest NMEA message parsed */
 
-    /* initialize some variables before loop */
-    memset(serial_buff, 0, sizeof serial_buff);
+    struct pollfd pfd = { .fd = gps_tty_fd, .events = POLLIN };
+
+    lgw_gps_stream_init(&stream, gps_nmea_enabled);
 
     while (!exit_sig && !quit_sig) {
-        size_t rd_idx = 0;
-        size_t frame_end_idx = 0;
+        /* wait for serial data with a timeout, so that the thread can be joined when the GPS is silent */
+        if (poll(&pfd, 1, GPS_POLL_MS) <= 0) {
+            continue;
+        }
 
-        /* blocking non-canonical read on serial port */
-        ssize_t nb_char = read(gps_tty_fd, serial_buff + wr_idx, LGW_GPS_MIN_MSG_SIZE);
+        /* non-canonical read on serial port, at least LGW_GPS_MIN_MSG_SIZE bytes */
+        ssize_t nb_char = read(gps_tty_fd, serial_buff, sizeof serial_buff);
         if (nb_char <= 0) {
             MSG("WARNING: [gps] read() returned value %zd\n", nb_char);
             continue;
         }
-        wr_idx += (size_t)nb_char;
-
-        /*******************************************
-         * Scan buffer for UBX/NMEA sync chars and *
-         * attempt to decode frame if one is found *
-         *******************************************/
-        while (rd_idx < wr_idx) {
-            size_t frame_size = 0;
-
-            /* Scan buffer for UBX sync char */
-            if (serial_buff[rd_idx] == (char)LGW_GPS_UBX_SYNC_CHAR) {
-
-                /***********************
-                 * Found UBX sync char *
-                 ***********************/
-                latest_msg = lgw_parse_ubx(&serial_buff[rd_idx], (wr_idx - rd_idx), &frame_size);
-
-                if (frame_size > 0) {
-                    if (latest_msg == INCOMPLETE) {
-                        /* UBX header found but frame appears to be missing bytes */
-                        frame_size = 0;
-                    } else if (latest_msg == INVALID) {
-                        /* message header received but message appears to be corrupted */
-                        MSG("WARNING: [gps] could not get a valid message from GPS (no time)\n");
-                        frame_size = 0;
-                    } else if (latest_msg == UBX_NAV_TIMEGPS) {
-                        gps_process_sync();
-                    }
-                }
-            } else if (serial_buff[rd_idx] == (char)LGW_GPS_NMEA_SYNC_CHAR) {
-                /************************
-                 * Found NMEA sync char *
-                 ************************/
-                /* scan for NMEA end marker (LF = 0x0a) */
-                char* nmea_end_ptr = memchr(&serial_buff[rd_idx],(int)0x0a, (wr_idx - rd_idx));
-
-                if(nmea_end_ptr) {
-                    /* found end marker */
-                    frame_size = nmea_end_ptr - &serial_buff[rd_idx] + 1;
-                    latest_msg = lgw_parse_nmea(&serial_buff[rd_idx], frame_size);
-
-                    if(latest_msg == INVALID || latest_msg == UNKNOWN) {
-                        /* checksum failed */
-                        frame_size = 0;
-                    } else if (latest_msg == NMEA_RMC) { /* Get location from RMC frames */
-                        gps_process_coords();
-                    }
-                }
-            }
 
-            if (frame_size > 0) {
-                /* At this point message is a checksum verified frame
-                   we're processed or ignored. Remove frame from buffer */
-                rd_idx += frame_size;
-                frame_end_idx = rd_idx;
-            } else {
-                rd_idx++;
+        /* each byte is parsed once, frames are processed as soon as their last byte is received */
+        rd_idx = 0;
+        while (rd_idx < (size_t)nb_char) {
+            rd_idx += lgw_gps_stream_parse(&stream, &serial_buff[rd_idx], (size_t)nb_char - rd_idx, &latest_msg);
+            if (latest_msg == UBX_NAV_TIMEGPS) {
+                gps_process_sync();
+            } else if (latest_msg == NMEA_RMC) { /* Get location from RMC frames */
+                gps_process_coords();
             }
-        } /* ...for(rd_idx = 0... */
-
-        if (frame_end_idx) {
-          /* Frames have been processed. Remove bytes to end of last processed frame */
-          memcpy(serial_buff, &serial_buff[frame_end_idx], wr_idx - frame_end_idx);
-          wr_idx -= frame_end_idx;
-        } /* ...for(rd_idx = 0... */
-
-        /* Prevent buffer overflow */
-        if ((sizeof(serial_buff) - wr_idx) < LGW_GPS_MIN_MSG_SIZE) {
-            memcpy(serial_buff, &serial_buff[LGW_GPS_MIN_MSG_SIZE], wr_idx - LGW_GPS_MIN_MSG_SIZE);
-            wr_idx -= LGW_GPS_MIN_MSG_SIZE;
         }
     }
     MSG("\nINFO: End of GPS thread\n");
@@ -3489,80 +5958,49 @@ void thread_valid(void) {
 
     /* GPS reference validation variables */
     long gps_ref_age = 0;
+    double holdover_err;
     bool ref_valid_local = false;
-    double xtal_err_cpy;
-
-    /* variables for XTAL correction averaging */
-    unsigned init_cpt = 0;
-    double init_acc = 0.0;
-    double x;
-
-    /* correction debug */
-    // FILE * log_file = NULL;
-    // time_t now_time;
-    // char log_name[64];
-
-    /* initialization */
-    // time(&now_time);
-    // strftime(log_name,sizeof log_name,"xtal_err_%Y%m%dT%H%M%SZ.csv",localtime(&now_time));
-    // log_file = fopen(log_name, "w");
-    // setbuf(log_file, NULL);
-    // fprintf(log_file,"\"xtal_correct\",\"XERR_INIT_AVG %u XERR_FILT_COEF %u\"\n", XERR_INIT_AVG, XERR_FILT_COEF); // DEBUG
+    double xtal_err_cpy = 1.0;
+    uint32_t nb_sync;
 
     /* main loop task */
     while (!exit_sig && !quit_sig) {
         wait_ms(1000);
 
-        /* calculate when the time reference was last updated */
+        /* calculate when the time reference was last updated, and the error of its extrapolation since then */
         pthread_mutex_lock(&mx_timeref);
         gps_ref_age = (long)difftime(time(NULL), time_reference_gps.systime);
-        if ((gps_ref_age >= 0) && (gps_ref_age <= GPS_REF_MAX_AGE)) {
-            /* time ref is ok, validate and  */
-            gps_ref_valid = true;
+        holdover_err = lgw_clock_error_us(&gps_clock, (double)gps_ref_age);
+        nb_sync = gps_clock.nb_sync;
+        if ((gps_ref_age >= 0) && (holdover_err >= 0.0) && ((gps_ref_age <= GPS_REF_MAX_AGE) || (holdover_err <= GPS_HOLDOVER_ERR_MAX))) {
+            /* time ref is ok, or can still be extrapolated accurately through the GPS loss */
             ref_valid_local = true;
             xtal_err_cpy = time_reference_gps.xtal_err;
-            //printf("XTAL err: %.15lf (1/XTAL_err:%.15lf)\n", xtal_err_cpy, 1/xtal_err_cpy); // DEBUG
         } else {
             /* time ref is too old, invalidate */
-            gps_ref_valid = false;
             ref_valid_local = false;
         }
+        if (gps_ref_valid != ref_valid_local) {
+            seq_write_begin(&seq_timeref);
+            gps_ref_valid = ref_valid_local;
+            seq_write_end(&seq_timeref);
+            if (ref_valid_local == false) {
+                MSG("WARNING: [valid] GPS time reference lost for %li s, extrapolation error %.1f us\n", gps_ref_age, holdover_err);
+            }
+        }
         pthread_mutex_unlock(&mx_timeref);
 
-        /* manage XTAL correction */
-        if (ref_valid_local == false) {
-            /* couldn't sync, or sync too old -> invalidate XTAL correction */
-            pthread_mutex_lock(&mx_xcorr);
+        /* manage XTAL correction, the drift estimate is already filtered */
+        seq_write_begin(&seq_xcorr);
+        if ((ref_valid_local == false) || (nb_sync < XERR_INIT_AVG)) {
+            /* couldn't sync, sync too old, or drift estimate not accurate yet -> invalidate XTAL correction */
             xtal_correct_ok = false;
             xtal_correct = 1.0;
-            pthread_mutex_unlock(&mx_xcorr);
-            init_cpt = 0;
-            init_acc = 0.0;
         } else {
-            if (init_cpt < XERR_INIT_AVG) {
-                /* initial accumulation */
-                init_acc += xtal_err_cpy;
-                ++init_cpt;
-            } else if (init_cpt == XERR_INIT_AVG) {
-                /* initial average calculation */
-                pthread_mutex_lock(&mx_xcorr);
-                xtal_correct = (double)(XERR_INIT_AVG) / init_acc;
-                //printf("XERR_INIT_AVG=%d, init_acc=%.15lf\n", XERR_INIT_AVG, init_acc);
-                xtal_correct_ok = true;
-                pthread_mutex_unlock(&mx_xcorr);
-                ++init_cpt;
-                // fprintf(log_file,"%.18lf,\"average\"\n", xtal_correct); // DEBUG
-            } else {
-                /* tracking with low-pass filter */
-                x = 1 / xtal_err_cpy;
-                pthread_mutex_lock(&mx_xcorr);
-                xtal_correct = xtal_correct - xtal_correct/XERR_FILT_COEF + x/XERR_FILT_COEF;
-                pthread_mutex_unlock(&mx_xcorr);
-                // fprintf(log_file,"%.18lf,\"track\"\n", xtal_correct); // DEBUG
-            }
+            xtal_correct_ok = true;
+            xtal_correct = 1.0 / xtal_err_cpy;
         }
-
-        //printf("Time ref: %s, XTAL correct: %s (%.15lf)\n", ref_valid_local?"valid":"invalid", xtal_correct_ok?"valid":"invalid", xtal_correct); // DEBUG
+        seq_write_end(&seq_xcorr);
     }
     MSG("\nINFO: End of validation thread\n");
 }
@@ -3570,15 +6008,33 @@ void thread_valid(void) {
 /* -------------------------------------------------------------------------- */
 /* --- THREAD 6: BACKGROUND SPECTRAL SCAN                           --------- */
 
+static bool spectral_scan_window(uint32_t duration_us) {
+    int i;
+    uint64_t current_concentrator_time;
+    uint32_t delay_us;
+
+    /* the scan must be over before the JIT thread takes the next packet of any TX chain */
+    get_concentrator_time(&current_concentrator_time);
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if ((tx_enable[i] == true) && (jit_peek_delay(&jit_queue[i], current_concentrator_time, &delay_us) == JIT_ERROR_OK) && (delay_us < duration_us)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void thread_spectral_scan(void) {
     int i, x;
     uint32_t freq_hz = spectral_scan_params.freq_hz_start;
     uint32_t freq_hz_stop = spectral_scan_params.freq_hz_start + spectral_scan_params.nb_chan * 200E3;
     int16_t levels[LGW_SPECTRAL_SCAN_RESULT_SIZE];
     uint16_t results[LGW_SPECTRAL_SCAN_RESULT_SIZE];
-    struct timeval tm_start;
+    uint32_t scan_us = (uint32_t)spectral_scan_params.nb_scan * SPECTRAL_SCAN_POINT_NS / 1000 + SPECTRAL_SCAN_SETUP_US; /* expected scan duration */
+    uint32_t waited_ms;
     lgw_spectral_scan_status_t status;
-    uint8_t tx_status = TX_FREE;
+    struct cmd_scan_start_s cmd_start = { 0, spectral_scan_params.nb_scan };
+    struct cmd_scan_poll_s cmd_poll = { LGW_SPECTRAL_SCAN_STATUS_UNKNOWN, levels, results };
     bool spectral_scan_started;
     bool exit_thread = false;
 
@@ -3596,77 +6052,59 @@ void thread_spectral_scan(void) {
             break;
         }
 
+        /* wait for a gap in the downlink schedule long enough for the whole scan */
+        while (!exit_sig && !quit_sig && (spectral_scan_window(scan_us + SPECTRAL_SCAN_MARGIN_US) == false)) {
+            wait_ms(SPECTRAL_SCAN_RETRY_MS);
+        }
+        if (exit_sig || quit_sig) {
+            break;
+        }
+
         spectral_scan_started = false;
 
-        /* Start spectral scan (if no downlink programmed) */
-        pthread_mutex_lock(&mx_concent);
-        /* -- Check if there is a downlink programmed */
-        for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
-            if (tx_enable[i] == true) {
-                x = lgw_status((uint8_t)i, TX_STATUS, &tx_status);
-                if (x != LGW_HAL_SUCCESS) {
-                    printf("ERROR: failed to get TX status on chain %d\n", i);
-                } else {
-                    if (tx_status == TX_SCHEDULED || tx_status == TX_EMITTING) {
-                        printf("INFO: skip spectral scan (downlink programmed on RF chain %d)\n", i);
-                        break; /* exit for loop */
-                    }
-                }
-            }
+        /* Start spectral scan (if no downlink is being emitted) */
+        cmd_start.freq_hz = freq_hz;
+        x = concent_run(&concent, CONCENT_CMD_SPECTRAL_SCAN, cmd_scan_start, &cmd_start);
+        if (x < 0) {
+            printf("ERROR: spectral scan start failed\n");
+            continue; /* main while loop */
         }
-        if (tx_status != TX_SCHEDULED && tx_status != TX_EMITTING) {
-            x = lgw_spectral_scan_start(freq_hz, spectral_scan_params.nb_scan);
-            if (x != 0) {
-                printf("ERROR: spectral scan start failed\n");
-                pthread_mutex_unlock(&mx_concent);
-                continue; /* main while loop */
-            }
-            spectral_scan_started = true;
-        }
-        pthread_mutex_unlock(&mx_concent);
+        spectral_scan_started = (x == 0);
 
         if (spectral_scan_started == true) {
-            /* Wait for scan to be completed */
-            status = LGW_SPECTRAL_SCAN_STATUS_UNKNOWN;
-            timeout_start(&tm_start);
-            do {
-                /* handle timeout */
-                if (timeout_check(tm_start, 2000) != 0) {
-                    printf("ERROR: %s: TIMEOUT on Spectral Scan\n", __FUNCTION__);
-                    break;  /* do while */
+            /* Sleep for the expected scan duration, the status is then normally read once */
+            wait_us(scan_us);
+            cmd_poll.status = LGW_SPECTRAL_SCAN_STATUS_UNKNOWN;
+            waited_ms = 0;
+            while (true) {
+                x = concent_run(&concent, CONCENT_CMD_SPECTRAL_SCAN, cmd_scan_poll, &cmd_poll);
+                status = cmd_poll.status;
+                if ((x != 0) || (status != LGW_SPECTRAL_SCAN_STATUS_ON_GOING)) {
+                    break;
                 }
 
-                /* get spectral scan status */
-                pthread_mutex_lock(&mx_concent);
-                x = lgw_spectral_scan_get_status(&status);
-                pthread_mutex_unlock(&mx_concent);
-                if (x != 0) {
-                    printf("ERROR: spectral scan status failed\n");
-                    break; /* do while */
+                /* handle timeout, the scan took longer than expected */
+                if (waited_ms >= SPECTRAL_SCAN_TIMEOUT_MS) {
+                    printf("ERROR: %s: TIMEOUT on Spectral Scan\n", __FUNCTION__);
+                    concent_run(&concent, CONCENT_CMD_SPECTRAL_SCAN, cmd_scan_abort, NULL);
+                    break;
                 }
-
-                /* wait a bit before checking status again */
-                wait_ms(10);
-            } while (status != LGW_SPECTRAL_SCAN_STATUS_COMPLETED && status != LGW_SPECTRAL_SCAN_STATUS_ABORTED);
+                wait_ms(SPECTRAL_SCAN_POLL_MS);
+                waited_ms += SPECTRAL_SCAN_POLL_MS;
+            }
+            if (x != 0) {
+                printf("ERROR: spectral scan status or results failed\n");
+                continue; /* main while loop */
+            }
 
             if (status == LGW_SPECTRAL_SCAN_STATUS_COMPLETED) {
-                /* Get spectral scan results */
-                memset(levels, 0, sizeof levels);
-                memset(results, 0, sizeof results);
-                pthread_mutex_lock(&mx_concent);
-                x = lgw_spectral_scan_get_results(levels, results);
-                pthread_mutex_unlock(&mx_concent);
-                if (x != 0) {
-                    printf("ERROR: spectral scan get results failed\n");
-                    continue; /* main while loop */
-                }
-
-                /* print results */
-                printf("SPECTRAL SCAN - %u Hz: ", freq_hz);
-                for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
-                    printf("%u ", results[i]);
+                /* merge results, summarized in the statistics report */
+                pthread_mutex_lock(&mx_spectral);
+                x = lgw_spectral_agg_merge(&spectral_agg, freq_hz, levels, results);
+                pthread_mutex_unlock(&mx_spectral);
+                if (x != LGW_HAL_SUCCESS) {
+                    printf("WARNING: %s: spectral scan results of %u Hz not aggregated\n", __FUNCTION__, freq_hz);
                 }
-                printf("\n");
 
                 /* Next frequency to scan */
                 freq_hz += 200000; /* 200kHz channels */
@@ -3675,7 +6113,7 @@ void thread_spectral_scan(void) {
                 }
             } else if (status == LGW_SPECTRAL_SCAN_STATUS_ABORTED) {
                 printf("INFO: %s: spectral scan has been aborted\n", __FUNCTION__);
-            } else {
+            } else if (status != LGW_SPECTRAL_SCAN_STATUS_ON_GOING) {
                 printf("ERROR: %s: spectral scan status us unexpected 0x%02X\n", __FUNCTION__, status);
             }
         }
@@ -3683,4 +6121,128 @@ void thread_spectral_scan(void) {
     printf("\nINFO: End of Spectral Scan thread\n");
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 7: PREPARE BEACONS AHEAD AND LOAD THEM IN JIT QUEUE ----------- */
+
+void thread_beacon(void) {
+    int i;
+
+    /* variables to get the GPS time of the beacons */
+    struct tref local_ref; /* time reference used for GPS <-> timestamp conversion */
+    bool ref_ok; /* is the copy of the GPS time reference valid */
+    bool xcorr_ok; /* is the XTAL correction stable enough for beacons */
+    double xcorr; /* XTAL correction, only its validity is needed here */
+    struct timespec gps_now; /* GPS time of the concentrator counter */
+    struct timespec next_beacon_gps_time; /* GPS time of a beacon to be loaded in JiT queue */
+    uint32_t next_gps = 0; /* GPS time of the next beacon to be prepared, 0 when the ring must be restarted */
+
+    /* ring of prepared beacons */
+    int ring_idx = 0; /* oldest prepared beacon */
+    int ring_nb = 0; /* nb of prepared beacons */
+    struct lgw_pkt_tx_s * beacon_pkt;
+    int attempts;
+
+    /* Just In Time downlink */
+    uint64_t current_concentrator_time;
+    enum jit_error_e jit_result;
+
+    /* timer aligned on the beacon period */
+    struct pollfd pfd;
+    int wait_ms;
+
+    pfd.fd = exit_fd;
+    pfd.events = POLLIN;
+
+    while (!exit_sig && !quit_sig) {
+        wait_ms = 1000; /* while waiting for GPS */
+
+        timeref_get(&ref_ok, &local_ref);
+        xcorr_get(&xcorr_ok, &xcorr);
+        /* Wait for GPS to be ready before inserting beacons in JiT queue */
+        if ((ref_ok == true) && (xcorr_ok == true)) {
+            get_concentrator_time(&current_concentrator_time);
+            lgw_cnt2gps(local_ref, (uint32_t)current_concentrator_time, &gps_now);
+
+            /* after a GPS loss, the prepared beacons are outdated, restart from the next slot */
+            /*   LoRaWAN: T = k*beacon_period + TBeaconDelay */
+            /*            with TBeaconDelay = [1.5ms +/- 1µs]*/
+            if ((next_gps == 0) || ((ring_nb > 0) && ((time_t)beacon_ring_gps[ring_idx] <= gps_now.tv_sec)) || ((time_t)next_gps <= gps_now.tv_sec)) {
+                next_gps = (uint32_t)(gps_now.tv_sec - (gps_now.tv_sec % (time_t)beacon_period) + (time_t)beacon_period);
+                ring_nb = 0;
+            }
+
+            /* load the JiT queue, preparing frames as they are consumed: a rejected slot is skipped for the next one */
+            for (attempts = 0; (jit_queue[0].num_beacon < JIT_NUM_BEACON_IN_QUEUE) && (attempts < BEACON_PREPARE_NB); attempts++) {
+                /* build the frames to come, only their counter is left to be set when loaded */
+                while (ring_nb < BEACON_PREPARE_NB) {
+                    i = (ring_idx + ring_nb) % BEACON_PREPARE_NB;
+                    beacon_prepare(&beacon_ring[i], next_gps);
+                    beacon_ring_gps[i] = next_gps;
+                    next_gps += beacon_period;
+                    ring_nb += 1;
+                }
+                beacon_pkt = &beacon_ring[ring_idx];
+                next_beacon_gps_time.tv_sec = (time_t)beacon_ring_gps[ring_idx];
+                next_beacon_gps_time.tv_nsec = 0;
+                ring_idx = (ring_idx + 1) % BEACON_PREPARE_NB;
+                ring_nb -= 1;
+
+#if DEBUG_BEACON
+                {
+                time_t time_unix;
+
+                time_unix = gps_now.tv_sec + UNIX_GPS_EPOCH_OFFSET;
+                MSG_DEBUG(DEBUG_BEACON, "GPS-now : %s", ctime(&time_unix));
+                time_unix = next_beacon_gps_time.tv_sec + UNIX_GPS_EPOCH_OFFSET;
+                MSG_DEBUG(DEBUG_BEACON, "GPS-next: %s", ctime(&time_unix));
+                }
+#endif
+
+                /* convert GPS time to concentrator time with the latest reference, and set packet counter for JiT trigger */
+                lgw_gps2cnt(local_ref, next_beacon_gps_time, &(beacon_pkt->count_us));
+
+                /* Insert beacon packet in JiT queue */
+                get_concentrator_time(&current_concentrator_time);
+                jit_result = jit_enqueue(&jit_queue[0], current_concentrator_time, beacon_pkt, JIT_PKT_TYPE_BEACON);
+                if (jit_result == JIT_ERROR_OK) {
+                    sem_post(&jit_wakeup);
+
+                    /* update stats */
+                    MEAS_ADD(meas_bcn.beacon_queued, 1);
+
+                    /* display beacon payload */
+                    MSG("INFO: Beacon queued (count_us=%u, freq_hz=%u, size=%u):\n", beacon_pkt->count_us, beacon_pkt->freq_hz, beacon_pkt->size);
+                    printf( "   => " );
+                    for (i = 0; i < beacon_pkt->size; ++i) {
+                        MSG("%02X ", beacon_pkt->payload[i]);
+                    }
+                    MSG("\n");
+                } else {
+                    MSG_DEBUG(DEBUG_BEACON, "--> beacon queuing failed with %d\n", jit_result);
+                    /* update stats */
+                    if (jit_result != JIT_ERROR_COLLISION_BEACON) {
+                        MEAS_ADD(meas_bcn.beacon_rejected, 1);
+                    }
+                }
+            }
+
+            /* wake up just after the next beacon slot, when the JiT queue has room for one more beacon */
+            wait_ms = (int)((time_t)beacon_period - (gps_now.tv_sec % (time_t)beacon_period)) * 1000 - (int)(gps_now.tv_nsec / 1000000) + BEACON_WAKEUP_MS;
+        }
+
+        /* sleep until the timer, or exit */
+        poll(&pfd, 1, wait_ms);
+    }
+    MSG("\nINFO: End of beacon thread\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 8: OWN THE CONCENTRATOR AND RUN THE REQUESTS BY PRIORITY ------ */
+
+void thread_concent(void) {
+    /* returns once stopped, after the other threads */
+    concent_serve(&concent);
+    MSG("\nINFO: End of concentrator command thread\n");
+}
+
 /* --- EOF ------------------------------------------------------------------ */
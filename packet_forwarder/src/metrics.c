@@ -0,0 +1,420 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : metrics endpoint, serving the counters of the packet
+    forwarder and of the HAL as OpenMetrics text.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>      /* vsnprintf */
+#include <stdlib.h>     /* malloc, realloc, free */
+#include <stdarg.h>     /* va_list */
+#include <string.h>     /* memcpy, strncmp, strstr */
+#include <unistd.h>     /* close, unlink */
+#include <poll.h>
+#include <netdb.h>      /* getaddrinfo */
+#include <sys/socket.h>
+#include <sys/un.h>     /* sockaddr_un */
+#include <sys/time.h>   /* timeval */
+
+#include "metrics.h"
+#include "trace.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define METRICS_POLL_MS         200     /* time between two checks of the stop request */
+#define METRICS_IO_TIMEOUT_S    1       /* time allowed to a client to send its request and to read the snapshot */
+#define METRICS_BACKLOG         4
+#define METRICS_REQ_SIZE        1024    /* longest HTTP request header read, the rest is ignored */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int buf_reserve(struct metrics_buf_s * buf, size_t size) {
+    char * data;
+    size_t new_size;
+
+    if (size <= buf->size) {
+        return 0;
+    }
+    for (new_size = (buf->size > 0) ? buf->size : METRICS_BUF_SIZE_INIT; new_size < size; new_size *= 2);
+    data = realloc(buf->data, new_size);
+    if (data == NULL) {
+        return -1;
+    }
+    buf->data = data;
+    buf->size = new_size;
+
+    return 0;
+}
+
+static int send_all(int fd, const char * data, size_t size) {
+    ssize_t n;
+
+    while (size > 0) {
+        n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+
+    return 0;
+}
+
+/* copy the published snapshot, so that a slow client never holds the lock */
+static int snapshot_copy(struct metrics_s * metrics) {
+    struct metrics_buf_s * snap;
+    int err = 0;
+
+    pthread_mutex_lock(&metrics->mx);
+    snap = &metrics->snap[metrics->front];
+    if (buf_reserve(&metrics->out, snap->len + 1) == 0) {
+        memcpy(metrics->out.data, snap->data, snap->len + 1);
+        metrics->out.len = snap->len;
+    } else {
+        err = -1;
+    }
+    pthread_mutex_unlock(&metrics->mx);
+
+    return err;
+}
+
+static void serve_http(struct metrics_s * metrics, int fd) {
+    char req[METRICS_REQ_SIZE];
+    char hdr[256];
+    size_t len = 0;
+    ssize_t n;
+    int hdr_len;
+
+    /* read the request header, the method and the path are enough */
+    while (len < (sizeof req - 1)) {
+        n = recv(fd, req + len, sizeof req - 1 - len, 0);
+        if (n <= 0) {
+            return;
+        }
+        len += (size_t)n;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n") != NULL) {
+            break;
+        }
+    }
+
+    if (strncmp(req, "GET ", 4) != 0) {
+        hdr_len = snprintf(hdr, sizeof hdr, "HTTP/1.0 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send_all(fd, hdr, (size_t)hdr_len);
+        return;
+    }
+    if ((strncmp(req + 4, "/metrics", 8) != 0) || ((req[12] != ' ') && (req[12] != '?'))) {
+        hdr_len = snprintf(hdr, sizeof hdr, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send_all(fd, hdr, (size_t)hdr_len);
+        return;
+    }
+
+    if (snapshot_copy(metrics) != 0) {
+        hdr_len = snprintf(hdr, sizeof hdr, "HTTP/1.0 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send_all(fd, hdr, (size_t)hdr_len);
+        return;
+    }
+    hdr_len = snprintf(hdr, sizeof hdr, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", METRICS_CONTENT_TYPE, metrics->out.len);
+    if (send_all(fd, hdr, (size_t)hdr_len) == 0) {
+        send_all(fd, metrics->out.data, metrics->out.len);
+        metrics->nb_scrape += 1;
+    }
+}
+
+static void serve_unix(struct metrics_s * metrics, int fd) {
+    /* no request, the snapshot is written on connection */
+    if (snapshot_copy(metrics) == 0) {
+        send_all(fd, metrics->out.data, metrics->out.len);
+        metrics->nb_scrape += 1;
+    }
+}
+
+static void * thread_metrics(void * arg) {
+    struct metrics_s * metrics = arg;
+    struct pollfd pfd;
+    struct timeval tv;
+    int fd;
+
+    pfd.fd = metrics->fd;
+    pfd.events = POLLIN;
+    tv.tv_sec = METRICS_IO_TIMEOUT_S;
+    tv.tv_usec = 0;
+
+    while (__atomic_load_n(&metrics->run, __ATOMIC_ACQUIRE) == true) {
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) {
+            continue;
+        }
+        fd = accept(metrics->fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        /* clients are served one at a time, a stalled one is dropped */
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+        if (metrics->http == true) {
+            serve_http(metrics, fd);
+        } else {
+            serve_unix(metrics, fd);
+        }
+        close(fd);
+    }
+
+    return NULL;
+}
+
+static int listen_unix(struct metrics_s * metrics, const char * path) {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof addr.sun_path) {
+        MSG("ERROR: [metrics] socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    metrics->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (metrics->fd < 0) {
+        return -1;
+    }
+    unlink(path); /* left by a previous run */
+    if ((bind(metrics->fd, (struct sockaddr *)&addr, sizeof addr) != 0) || (listen(metrics->fd, METRICS_BACKLOG) != 0)) {
+        MSG("ERROR: [metrics] failed to listen on %s\n", path);
+        close(metrics->fd);
+        metrics->fd = -1;
+        return -1;
+    }
+    strcpy(metrics->path, path);
+    metrics->http = false;
+
+    return 0;
+}
+
+static int listen_tcp(struct metrics_s * metrics, const char * endpoint) {
+    struct addrinfo hints;
+    struct addrinfo * result;
+    struct addrinfo * q;
+    char host[64];
+    const char * port;
+    const char * sep;
+    int opt = 1;
+
+    /* the port is after the last ':' */
+    sep = strrchr(endpoint, ':');
+    if (sep == NULL) {
+        port = endpoint;
+    } else {
+        if ((size_t)(sep - endpoint) >= sizeof host) {
+            return -1;
+        }
+        memcpy(host, endpoint, sep - endpoint);
+        host[sep - endpoint] = '\0';
+        port = sep + 1;
+    }
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo((sep == NULL) ? NULL : host, port, &hints, &result) != 0) {
+        MSG("ERROR: [metrics] invalid endpoint %s\n", endpoint);
+        return -1;
+    }
+
+    metrics->fd = -1;
+    for (q = result; q != NULL; q = q->ai_next) {
+        metrics->fd = socket(q->ai_family, q->ai_socktype, q->ai_protocol);
+        if (metrics->fd < 0) {
+            continue;
+        }
+        setsockopt(metrics->fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt);
+        if ((bind(metrics->fd, q->ai_addr, q->ai_addrlen) == 0) && (listen(metrics->fd, METRICS_BACKLOG) == 0)) {
+            break;
+        }
+        close(metrics->fd);
+        metrics->fd = -1;
+    }
+    freeaddrinfo(result);
+    if (metrics->fd < 0) {
+        MSG("ERROR: [metrics] failed to listen on %s\n", endpoint);
+        return -1;
+    }
+    metrics->path[0] = '\0';
+    metrics->http = true;
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int metrics_start(struct metrics_s * metrics, const char * endpoint) {
+    int i, err;
+
+    memset(metrics, 0, sizeof *metrics);
+    metrics->fd = -1;
+    pthread_mutex_init(&metrics->mx, NULL);
+    for (i = 0; i < 2; i++) {
+        if (buf_reserve(&metrics->snap[i], METRICS_BUF_SIZE_INIT) != 0) {
+            metrics_stop(metrics);
+            return -1;
+        }
+    }
+    /* valid, empty, until the first snapshot is published */
+    metrics->snap[0].len = (size_t)snprintf(metrics->snap[0].data, metrics->snap[0].size, "# EOF\n");
+
+    if (strncmp(endpoint, "unix:", 5) == 0) {
+        err = listen_unix(metrics, endpoint + 5);
+    } else {
+        err = listen_tcp(metrics, endpoint);
+    }
+    if (err != 0) {
+        metrics_stop(metrics);
+        return -1;
+    }
+
+    __atomic_store_n(&metrics->run, true, __ATOMIC_RELEASE);
+    if (pthread_create(&metrics->thrid, NULL, thread_metrics, metrics) != 0) {
+        __atomic_store_n(&metrics->run, false, __ATOMIC_RELEASE);
+        metrics_stop(metrics);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void metrics_stop(struct metrics_s * metrics) {
+    int i;
+
+    if (__atomic_load_n(&metrics->run, __ATOMIC_ACQUIRE) == true) {
+        __atomic_store_n(&metrics->run, false, __ATOMIC_RELEASE);
+        pthread_join(metrics->thrid, NULL);
+    }
+    if (metrics->fd >= 0) {
+        close(metrics->fd);
+        metrics->fd = -1;
+    }
+    if (metrics->path[0] != '\0') {
+        unlink(metrics->path);
+        metrics->path[0] = '\0';
+    }
+    for (i = 0; i < 2; i++) {
+        free(metrics->snap[i].data);
+        metrics->snap[i].data = NULL;
+        metrics->snap[i].size = 0;
+    }
+    free(metrics->out.data);
+    metrics->out.data = NULL;
+    metrics->out.size = 0;
+    pthread_mutex_destroy(&metrics->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct metrics_buf_s * metrics_begin(struct metrics_s * metrics) {
+    struct metrics_buf_s * buf;
+
+    /* the back buffer is only touched by the statistics thread, no lock needed */
+    buf = &metrics->snap[1 - __atomic_load_n(&metrics->front, __ATOMIC_ACQUIRE)];
+    buf->len = 0;
+    buf->data[0] = '\0';
+
+    return buf;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void metrics_publish(struct metrics_s * metrics) {
+    metrics_printf(&metrics->snap[1 - metrics->front], "# EOF\n");
+
+    pthread_mutex_lock(&metrics->mx);
+    __atomic_store_n(&metrics->front, 1 - metrics->front, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&metrics->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void metrics_printf(struct metrics_buf_s * buf, const char * format, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, format);
+    n = vsnprintf(buf->data + buf->len, buf->size - buf->len, format, ap);
+    va_end(ap);
+    if (n < 0) {
+        return;
+    }
+
+    if ((buf->len + (size_t)n) >= buf->size) {
+        /* only on the first snapshots, the buffer is kept for the next ones */
+        if (buf_reserve(buf, buf->len + (size_t)n + 1) != 0) {
+            buf->data[buf->len] = '\0'; /* the line is dropped */
+            return;
+        }
+        va_start(ap, format);
+        vsnprintf(buf->data + buf->len, buf->size - buf->len, format, ap);
+        va_end(ap);
+    }
+    buf->len += (size_t)n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void metrics_family(struct metrics_buf_s * buf, const char * name, const char * type, const char * help) {
+    metrics_printf(buf, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void metrics_hist(struct metrics_buf_s * buf, const char * name, const char * labels, const uint64_t * hist, int nb, double unit, double sum) {
+    const char * sep = (labels[0] != '\0') ? "," : "";
+    uint64_t count = 0;
+    double bound = unit;
+    int i;
+
+    /* the bins have exclusive upper bounds, reported as the le of their bucket */
+    for (i = 0; i < (nb - 1); i++) {
+        count += hist[i];
+        metrics_printf(buf, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep, bound, (unsigned long long)count);
+        bound *= 2;
+    }
+    count += hist[nb - 1];
+    metrics_printf(buf, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)count);
+    if (labels[0] != '\0') {
+        metrics_printf(buf, "%s_count{%s} %llu\n", name, labels, (unsigned long long)count);
+        if (sum >= 0) {
+            metrics_printf(buf, "%s_sum{%s} %.9g\n", name, labels, sum);
+        }
+    } else {
+        metrics_printf(buf, "%s_count %llu\n", name, (unsigned long long)count);
+        if (sum >= 0) {
+            metrics_printf(buf, "%s_sum %.9g\n", name, sum);
+        }
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
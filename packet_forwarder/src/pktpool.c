@@ -0,0 +1,96 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : pool of RX packet descriptors shared by the packet
+    fetch thread and the uplink serialization thread.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include "pktpool.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int pkt_pool_init(struct pkt_pool_s * pool) {
+    int i;
+
+    /* the first descriptors are at the top of the stack */
+    for (i = 0; i < PKT_POOL_SIZE; i++) {
+        pool->free_pkt[i] = &pool->pkt[PKT_POOL_SIZE - 1 - i];
+    }
+    pool->nb_free = PKT_POOL_SIZE;
+    pool->min_free = PKT_POOL_SIZE;
+
+    return (pthread_mutex_init(&pool->mx, NULL) != 0) ? -1 : 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_pool_deinit(struct pkt_pool_s * pool) {
+    pthread_mutex_destroy(&pool->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int pkt_pool_get(struct pkt_pool_s * pool, struct lgw_pkt_rx_s ** pkt, int nb_pkt) {
+    int i;
+
+    pthread_mutex_lock(&pool->mx);
+    if (nb_pkt > pool->nb_free) {
+        nb_pkt = pool->nb_free;
+    }
+    for (i = 0; i < nb_pkt; i++) {
+        pkt[i] = pool->free_pkt[--pool->nb_free];
+    }
+    if (pool->nb_free < pool->min_free) {
+        pool->min_free = pool->nb_free;
+    }
+    pthread_mutex_unlock(&pool->mx);
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_pool_put(struct pkt_pool_s * pool, struct lgw_pkt_rx_s * const * pkt, int nb_pkt) {
+    int i;
+
+    /* in reverse order, so that the first descriptor of the array is the next one reused */
+    pthread_mutex_lock(&pool->mx);
+    for (i = nb_pkt - 1; (i >= 0) && (pool->nb_free < PKT_POOL_SIZE); i--) {
+        pool->free_pkt[pool->nb_free++] = pkt[i];
+    }
+    pthread_mutex_unlock(&pool->mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int pkt_pool_max_used(struct pkt_pool_s * pool) {
+    int min_free;
+
+    pthread_mutex_lock(&pool->mx);
+    min_free = pool->min_free;
+    pthread_mutex_unlock(&pool->mx);
+
+    return PKT_POOL_SIZE - min_free;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
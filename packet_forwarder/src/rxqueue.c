@@ -0,0 +1,131 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : uplink queue between the packet fetch thread and the
+    uplink serialization thread.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <unistd.h>     /* close */
+#include <sys/eventfd.h> /* eventfd */
+
+#include "rxqueue.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int rx_queue_init(struct rx_queue_s * queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->dropped = 0;
+    queue->max_used = 0;
+    queue->ready_fd = eventfd(0, EFD_NONBLOCK);
+    return (queue->ready_fd < 0) ? -1 : 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void rx_queue_deinit(struct rx_queue_s * queue) {
+    close(queue->ready_fd);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_queue_push(struct rx_queue_s * queue, struct lgw_pkt_rx_s * const * pkt, int nb_pkt) {
+    uint32_t head, tail;
+    int i, nb_free;
+
+    head = queue->head;
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    nb_free = RX_QUEUE_SIZE - (int)(head - tail);
+
+    if (nb_pkt > nb_free) {
+        __atomic_fetch_add(&queue->dropped, (uint32_t)(nb_pkt - nb_free), __ATOMIC_RELAXED);
+        nb_pkt = nb_free;
+    }
+    if (nb_pkt <= 0) {
+        return 0;
+    }
+
+    for (i = 0; i < nb_pkt; i++) {
+        queue->pkt[(head + i) & (RX_QUEUE_SIZE - 1)] = pkt[i];
+    }
+
+    if ((head + nb_pkt - tail) > queue->max_used) {
+        __atomic_store_n(&queue->max_used, head + nb_pkt - tail, __ATOMIC_RELAXED);
+    }
+
+    /* publish the packets to the consumer, and wake it up */
+    __atomic_store_n(&queue->head, head + nb_pkt, __ATOMIC_RELEASE);
+    eventfd_write(queue->ready_fd, 1); /* only adds to the eventfd counter, never blocks */
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_queue_pop(struct rx_queue_s * queue, struct lgw_pkt_rx_s ** pkt, int max_pkt) {
+    uint32_t head, tail;
+    int i, nb_pkt;
+
+    tail = queue->tail;
+    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    nb_pkt = (int)(head - tail);
+    if (nb_pkt > max_pkt) {
+        nb_pkt = max_pkt;
+    }
+
+    for (i = 0; i < nb_pkt; i++) {
+        pkt[i] = queue->pkt[(tail + i) & (RX_QUEUE_SIZE - 1)];
+    }
+
+    /* release the slots to the producer */
+    __atomic_store_n(&queue->tail, tail + nb_pkt, __ATOMIC_RELEASE);
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_queue_fd(struct rx_queue_s * queue) {
+    return queue->ready_fd;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void rx_queue_clear(struct rx_queue_s * queue) {
+    eventfd_t count;
+
+    eventfd_read(queue->ready_fd, &count); /* fails with EAGAIN if not signaled */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t rx_queue_dropped(struct rx_queue_s * queue) {
+    return __atomic_load_n(&queue->dropped, __ATOMIC_RELAXED);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t rx_queue_max_used(struct rx_queue_s * queue) {
+    return __atomic_load_n(&queue->max_used, __ATOMIC_RELAXED);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,573 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : decoder of the "txpk" object of the PULL_RESP
+    datagrams, straight from the JSON text into the TX packet structure.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stddef.h>     /* offsetof */
+#include <stdio.h>      /* sscanf */
+#include <stdlib.h>     /* strtod */
+#include <math.h>       /* isfinite */
+#include <string.h>     /* memset, memcmp, strcmp, strstr, strchr */
+
+#include "txpkdec.h"
+#include "base64.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define MAX_NESTING             19  /* same limit as parson */
+#define KEY_NB_MAX              256 /* keys of the objects being scanned, more than a PULL_RESP datagram holds */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct txpk_key_ref_s {
+    const char * str;       /* unescaped name, in the JSON text */
+    int len;
+};
+
+struct txpk_ctx_s {
+    struct lgw_pkt_tx_s * pkt;
+    struct txpk_dec_s * dec;
+    enum txpk_dec_e err;    /* first type error met, reported if the whole text is valid JSON */
+    bool txpk;              /* the txpk object was found */
+    bool txpk_key;          /* the "txpk" name was found, whatever its value */
+    const char * modu;      /* strings resolved once the modulation is known */
+    const char * codr;
+    const char * datr_str;  /* LoRa datarate */
+    double datr_num;        /* FSK bitrate */
+    int nb_key;             /* names of the objects being scanned, to refuse the duplicates */
+    struct txpk_key_ref_s keys[KEY_NB_MAX];
+};
+
+typedef char * (*member_fn)(char * p, const char * key, int key_len, struct txpk_ctx_s * ctx, int depth, int base);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const char key_name[TXPK_KEY_NB][5] = {
+    "imme", "tmst", "tmms", "freq", "rfch", "powe", "modu", "datr",
+    "codr", "fdev", "ipol", "prea", "size", "data", "ncrc", "nhdr"
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static char * skip_value(char * p, int depth, struct txpk_ctx_s * ctx);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static char * skip_ws(char * p) {
+    char * end;
+
+    for (;;) {
+        while ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r') || (*p == '\v') || (*p == '\f')) {
+            p++;
+        }
+        /* as json_parse_string_with_comments, an unterminated comment only removes its opening token */
+        if ((p[0] == '/') && (p[1] == '*')) {
+            end = strstr(p + 2, "*/");
+            p = (end != NULL) ? (end + 2) : (p + 2);
+        } else if ((p[0] == '/') && (p[1] == '/')) {
+            end = strchr(p + 2, '\n');
+            p = (end != NULL) ? end : (p + 2);
+        } else {
+            return p;
+        }
+    }
+}
+
+static int hex_digit(char c) {
+    if ((c >= '0') && (c <= '9')) return c - '0';
+    if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return -1;
+}
+
+/* Value of the 4 hex digits of a \u escape sequence, -1 if invalid */
+static long hex4(const char * p) {
+    long v = 0;
+    int i, h;
+
+    for (i = 0; i < 4; i++) {
+        h = hex_digit(p[i]);
+        if (h < 0) {
+            return -1;
+        }
+        v = (v << 4) | h;
+    }
+
+    return v;
+}
+
+/* The length of a string is up to its first NUL, escaped as \u0000, as the C strings of parson */
+static char * scan_string(char * p, char ** str, int * len) {
+    char * w;
+    char * nul = NULL;
+    long cp, trail;
+
+    /* unescape in place, the string can only get shorter */
+    p++;
+    *str = w = p;
+    while (*p != '"') {
+        if ((unsigned char)*p < 0x20) { /* end of text, or control character */
+            return NULL;
+        }
+        if (*p != '\\') {
+            *w++ = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case '"':
+            case '\\':
+            case '/': *w++ = *p; break;
+            case 'b': *w++ = '\b'; break;
+            case 'f': *w++ = '\f'; break;
+            case 'n': *w++ = '\n'; break;
+            case 'r': *w++ = '\r'; break;
+            case 't': *w++ = '\t'; break;
+            case 'u':
+                cp = hex4(p + 1);
+                if (cp < 0) {
+                    return NULL;
+                }
+                p += 4;
+                if ((cp >= 0xD800) && (cp <= 0xDBFF)) { /* lead surrogate, a trail one must follow */
+                    trail = ((p[1] == '\\') && (p[2] == 'u')) ? hex4(p + 3) : -1;
+                    if ((trail < 0xDC00) || (trail > 0xDFFF)) {
+                        return NULL;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (trail - 0xDC00);
+                    p += 6;
+                } else if ((cp >= 0xDC00) && (cp <= 0xDFFF)) { /* trail surrogate alone */
+                    return NULL;
+                }
+                /* UTF-8, at most 3 bytes for 6 characters of escape sequence, 4 bytes for 12 */
+                if (cp < 0x80) {
+                    if ((cp == 0) && (nul == NULL)) {
+                        nul = w;
+                    }
+                    *w++ = (char)cp;
+                } else if (cp < 0x800) {
+                    *w++ = (char)(0xC0 | (cp >> 6));
+                    *w++ = (char)(0x80 | (cp & 0x3F));
+                } else if (cp < 0x10000) {
+                    *w++ = (char)(0xE0 | (cp >> 12));
+                    *w++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    *w++ = (char)(0x80 | (cp & 0x3F));
+                } else {
+                    *w++ = (char)(0xF0 | (cp >> 18));
+                    *w++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+                    *w++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    *w++ = (char)(0x80 | (cp & 0x3F));
+                }
+                break;
+            default:
+                return NULL;
+        }
+        p++;
+    }
+    *len = (int)(((nul != NULL) ? nul : w) - *str);
+    *w = '\0';
+
+    return p + 1;
+}
+
+static char * scan_digits(char * p) {
+    char * q = p;
+
+    while ((*q >= '0') && (*q <= '9')) {
+        q++;
+    }
+
+    return (q == p) ? NULL : q;
+}
+
+/* First character of a number for parson, any other value is of another type */
+static bool is_number_start(char c) {
+    return (c == '-') || ((c >= '0') && (c <= '9'));
+}
+
+static char * scan_number(char * p, double * x) {
+    char * q = p;
+    char * end;
+
+    /* JSON grammar first, strtod would also take inf, nan, hex and leading zeros */
+    if (*q == '-') {
+        q++;
+    }
+    if (*q == '0') {
+        q++;
+        if ((*q == 'e') || (*q == 'E')) {
+            return NULL; /* refused by parson */
+        }
+    } else if ((q = scan_digits(q)) == NULL) {
+        return NULL;
+    }
+    if ((*q == '.') && ((q = scan_digits(q + 1)) == NULL)) {
+        return NULL;
+    }
+    if ((*q == 'e') || (*q == 'E')) {
+        q++;
+        if ((*q == '+') || (*q == '-')) {
+            q++;
+        }
+        if ((q = scan_digits(q)) == NULL) {
+            return NULL;
+        }
+    }
+    *x = strtod(p, &end);
+
+    return ((end == q) && isfinite(*x)) ? end : NULL;
+}
+
+static char * scan_literal(char * p, const char * lit) {
+    size_t n = strlen(lit);
+
+    return (strncmp(p, lit, n) == 0) ? (p + n) : NULL;
+}
+
+/* Check that a name is not already in its object, whose names start at base, then add it
+ * A duplicate name is refused by parson, the names are compared in the unescaped text */
+static bool key_unique(struct txpk_ctx_s * ctx, int base, const char * key, int key_len) {
+    int i;
+
+    for (i = base; i < ctx->nb_key; i++) {
+        if ((ctx->keys[i].len == key_len) && (memcmp(ctx->keys[i].str, key, key_len) == 0)) {
+            return false;
+        }
+    }
+    if (ctx->nb_key >= KEY_NB_MAX) {
+        return false;
+    }
+    ctx->keys[ctx->nb_key].str = key;
+    ctx->keys[ctx->nb_key].len = key_len;
+    ctx->nb_key += 1;
+
+    return true;
+}
+
+/* Object at the given nesting depth of values, its members are one level deeper
+ * The member function checks the names it handles itself, key_unique() checks the others */
+static char * scan_object(char * p, int depth, member_fn fn, struct txpk_ctx_s * ctx) {
+    char * key;
+    int key_len;
+    int base = ctx->nb_key;
+
+    p = skip_ws(p + 1);
+    if (*p == '}') {
+        return p + 1;
+    }
+    for (;;) {
+        if (*p != '"') {
+            return NULL;
+        }
+        p = scan_string(p, &key, &key_len);
+        if (p == NULL) {
+            return NULL;
+        }
+        if ((fn == NULL) && !key_unique(ctx, base, key, key_len)) {
+            return NULL;
+        }
+        p = skip_ws(p);
+        if (*p != ':') {
+            return NULL;
+        }
+        p = skip_ws(p + 1);
+        p = (fn != NULL) ? fn(p, key, key_len, ctx, depth + 1, base) : skip_value(p, depth + 1, ctx);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_ws(p);
+        if (*p == '}') {
+            ctx->nb_key = base;
+            return p + 1;
+        }
+        if (*p != ',') {
+            return NULL;
+        }
+        p = skip_ws(p + 1);
+    }
+}
+
+/* Value at the given nesting depth, the root object being at depth 0 */
+static char * skip_value(char * p, int depth, struct txpk_ctx_s * ctx) {
+    char * str;
+    int len;
+    double x;
+
+    if (depth > MAX_NESTING) {
+        return NULL;
+    }
+    switch (*p) {
+        case '"':
+            return scan_string(p, &str, &len);
+        case '{':
+            return scan_object(p, depth, NULL, ctx);
+        case '[':
+            p = skip_ws(p + 1);
+            if (*p == ']') {
+                return p + 1;
+            }
+            for (;;) {
+                p = skip_value(p, depth + 1, ctx);
+                if (p == NULL) {
+                    return NULL;
+                }
+                p = skip_ws(p);
+                if (*p == ']') {
+                    return p + 1;
+                }
+                if (*p != ',') {
+                    return NULL;
+                }
+                p = skip_ws(p + 1);
+            }
+        case 't':
+            return scan_literal(p, "true");
+        case 'f':
+            return scan_literal(p, "false");
+        case 'n':
+            return scan_literal(p, "null");
+        default:
+            return scan_number(p, &x);
+    }
+}
+
+/* A value of the wrong type is skipped, so that a syntax error found later takes precedence as with parson */
+static char * type_error(char * p, struct txpk_ctx_s * ctx, enum txpk_key_e key, int depth) {
+    if (ctx->err == TXPK_DEC_OK) {
+        ctx->err = TXPK_DEC_ERR_TYPE;
+        ctx->dec->key = key;
+    }
+    ctx->dec->found |= TXPK_FOUND(key); /* still a duplicate name if found again */
+    return skip_value(p, depth, ctx);
+}
+
+static char * txpk_member(char * p, const char * key, int key_len, struct txpk_ctx_s * ctx, int depth, int base) {
+    struct lgw_pkt_tx_s * pkt = ctx->pkt;
+    struct txpk_dec_s * dec = ctx->dec;
+    char * str = NULL;
+    int len = 0;
+    double x = 0.0;
+    bool b = false;
+    int k;
+
+    for (k = 0; (k < TXPK_KEY_NB) && ((key_len != 4) || (memcmp(key, key_name[k], 4) != 0)); k++);
+    if (k == TXPK_KEY_NB) {
+        return key_unique(ctx, base, key, key_len) ? skip_value(p, depth, ctx) : NULL;
+    }
+    if ((dec->found & TXPK_FOUND(k)) != 0) {
+        return NULL; /* duplicate name */
+    }
+
+    /* scan the value with the type expected for the key */
+    switch (k) {
+        case TXPK_IMME:
+        case TXPK_IPOL:
+        case TXPK_NCRC:
+        case TXPK_NHDR:
+            if (*p == 't') {
+                b = true;
+                p = scan_literal(p, "true");
+            } else if (*p == 'f') {
+                p = scan_literal(p, "false");
+            } else {
+                return type_error(p, ctx, k, depth);
+            }
+            break;
+        case TXPK_MODU:
+        case TXPK_CODR:
+        case TXPK_DATA:
+            if (*p != '"') {
+                return type_error(p, ctx, k, depth);
+            }
+            p = scan_string(p, &str, &len);
+            break;
+        case TXPK_DATR: /* a string for LoRa, a number for FSK */
+            if (*p == '"') {
+                p = scan_string(p, &str, &len);
+            } else if (is_number_start(*p)) {
+                p = scan_number(p, &x);
+            } else {
+                return type_error(p, ctx, k, depth);
+            }
+            break;
+        default:
+            if (!is_number_start(*p)) {
+                return type_error(p, ctx, k, depth);
+            }
+            p = scan_number(p, &x);
+            break;
+    }
+    if (p == NULL) {
+        return NULL;
+    }
+
+    switch (k) {
+        case TXPK_IMME: dec->imme = b; break;
+        case TXPK_TMST: pkt->count_us = (uint32_t)x; break;
+        case TXPK_TMMS: dec->tmms = (uint64_t)x; break;
+        case TXPK_FREQ: pkt->freq_hz = (uint32_t)((double)(1.0e6) * x); break;
+        case TXPK_RFCH: pkt->rf_chain = (uint8_t)x; break;
+        case TXPK_POWE: pkt->rf_power = (int8_t)x; break;
+        case TXPK_MODU: ctx->modu = str; break;
+        case TXPK_DATR: ctx->datr_str = str; ctx->datr_num = x; break;
+        case TXPK_CODR: ctx->codr = str; break;
+        case TXPK_FDEV: pkt->f_dev = (uint8_t)(x / 1000.0); break; /* JSON value in Hz, f_dev in kHz */
+        case TXPK_IPOL: pkt->invert_pol = b; break;
+        case TXPK_PREA: pkt->preamble = (x < 0.0) ? 0 : ((x > 65535.0) ? 65535 : (uint16_t)x); break;
+        case TXPK_SIZE: pkt->size = (uint16_t)x; break;
+        case TXPK_DATA: dec->data = str; dec->data_len = len; break;
+        case TXPK_NCRC: pkt->no_crc = b; break;
+        case TXPK_NHDR: pkt->no_header = b; break;
+        default: break;
+    }
+    dec->found |= TXPK_FOUND(k);
+
+    return p;
+}
+
+static char * top_member(char * p, const char * key, int key_len, struct txpk_ctx_s * ctx, int depth, int base) {
+    if ((key_len == 4) && (memcmp(key, "txpk", 4) == 0)) {
+        if (ctx->txpk_key) {
+            return NULL; /* duplicate name */
+        }
+        ctx->txpk_key = true;
+        if (*p == '{') {
+            ctx->txpk = true;
+            return scan_object(p, depth, txpk_member, ctx);
+        }
+        return skip_value(p, depth, ctx);
+    }
+
+    return key_unique(ctx, base, key, key_len) ? skip_value(p, depth, ctx) : NULL;
+}
+
+static enum txpk_dec_e resolve_modulation(struct txpk_ctx_s * ctx) {
+    struct lgw_pkt_tx_s * pkt = ctx->pkt;
+    struct txpk_dec_s * dec = ctx->dec;
+    short sf, bw;
+
+    if ((dec->found & TXPK_FOUND(TXPK_MODU)) == 0) {
+        return TXPK_DEC_OK;
+    }
+
+    if (strcmp(ctx->modu, "LORA") == 0) {
+        pkt->modulation = MOD_LORA;
+        if ((dec->found & TXPK_FOUND(TXPK_DATR)) != 0) {
+            if ((ctx->datr_str == NULL) || (sscanf(ctx->datr_str, "SF%2hdBW%3hd", &sf, &bw) != 2)) {
+                return TXPK_DEC_ERR_DATR;
+            }
+            switch (sf) {
+                case  5: pkt->datarate = DR_LORA_SF5;  break;
+                case  6: pkt->datarate = DR_LORA_SF6;  break;
+                case  7: pkt->datarate = DR_LORA_SF7;  break;
+                case  8: pkt->datarate = DR_LORA_SF8;  break;
+                case  9: pkt->datarate = DR_LORA_SF9;  break;
+                case 10: pkt->datarate = DR_LORA_SF10; break;
+                case 11: pkt->datarate = DR_LORA_SF11; break;
+                case 12: pkt->datarate = DR_LORA_SF12; break;
+                default: return TXPK_DEC_ERR_SF;
+            }
+            switch (bw) {
+                case 125: pkt->bandwidth = BW_125KHZ; break;
+                case 250: pkt->bandwidth = BW_250KHZ; break;
+                case 500: pkt->bandwidth = BW_500KHZ; break;
+                default: return TXPK_DEC_ERR_BW;
+            }
+        }
+        if ((dec->found & TXPK_FOUND(TXPK_CODR)) != 0) {
+            if      (strcmp(ctx->codr, "4/5") == 0) pkt->coderate = CR_LORA_4_5;
+            else if (strcmp(ctx->codr, "4/6") == 0) pkt->coderate = CR_LORA_4_6;
+            else if (strcmp(ctx->codr, "2/3") == 0) pkt->coderate = CR_LORA_4_6;
+            else if (strcmp(ctx->codr, "4/7") == 0) pkt->coderate = CR_LORA_4_7;
+            else if (strcmp(ctx->codr, "4/8") == 0) pkt->coderate = CR_LORA_4_8;
+            else if (strcmp(ctx->codr, "1/2") == 0) pkt->coderate = CR_LORA_4_8;
+            else return TXPK_DEC_ERR_CODR;
+        }
+    } else if (strcmp(ctx->modu, "FSK") == 0) {
+        pkt->modulation = MOD_FSK;
+        if ((dec->found & TXPK_FOUND(TXPK_DATR)) != 0) {
+            if (ctx->datr_str != NULL) {
+                dec->key = TXPK_DATR;
+                return TXPK_DEC_ERR_TYPE;
+            }
+            pkt->datarate = (uint32_t)ctx->datr_num;
+        }
+    } else {
+        return TXPK_DEC_ERR_MODU;
+    }
+
+    return TXPK_DEC_OK;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+enum txpk_dec_e txpk_decode(char * json, struct lgw_pkt_tx_s * pkt, struct txpk_dec_s * dec) {
+    struct txpk_ctx_s ctx;
+    char * p;
+
+    memset(pkt, 0, sizeof *pkt);
+    memset(dec, 0, sizeof *dec);
+    memset(&ctx, 0, offsetof(struct txpk_ctx_s, keys)); /* the keys are set as they are found */
+    ctx.pkt = pkt;
+    ctx.dec = dec;
+    ctx.err = TXPK_DEC_OK;
+
+    /* as parson, the text after the root value is ignored */
+    p = skip_ws(json);
+    if (*p == '[') {
+        return (skip_value(p, 0, &ctx) != NULL) ? TXPK_DEC_ERR_NO_TXPK : TXPK_DEC_ERR_JSON;
+    }
+    if (*p != '{') {
+        return TXPK_DEC_ERR_JSON;
+    }
+    p = scan_object(p, 0, top_member, &ctx);
+    if (p == NULL) {
+        return TXPK_DEC_ERR_JSON;
+    }
+    if (ctx.txpk == false) {
+        return TXPK_DEC_ERR_NO_TXPK;
+    }
+    if (ctx.err != TXPK_DEC_OK) {
+        return ctx.err;
+    }
+
+    return resolve_modulation(&ctx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int txpk_decode_payload(const struct txpk_dec_s * dec, struct lgw_pkt_tx_s * pkt) {
+    if (dec->data == NULL) {
+        return -1;
+    }
+
+    return b64_to_bin(dec->data, dec->data_len, pkt->payload, sizeof pkt->payload);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+const char * txpk_key_name(enum txpk_key_e key) {
+    return (key < TXPK_KEY_NB) ? key_name[key] : "";
+}
+
+/* --- EOF ------------------------------------------------------------------ */
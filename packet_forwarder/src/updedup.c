@@ -0,0 +1,119 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : de-duplication of the uplinks received several times,
+    by several demodulators or boards, before serialization.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>     /* memset */
+
+#include "updedup.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t payload_hash(const struct lgw_pkt_rx_s * p) {
+    uint64_t h = 0xCBF29CE484222325ULL ^ p->size; /* FNV-1a, seeded with the size */
+    int i;
+
+    for (i = 0; i < p->size; i++) {
+        h = (h ^ p->payload[i]) * 0x100000001B3ULL;
+    }
+
+    return h;
+}
+
+static int16_t pkt_rssi(const struct lgw_pkt_rx_s * p) {
+    /* the signal RSSI is only estimated for LoRa */
+    return (p->modulation == MOD_LORA) ? p->rssis_x10 : p->rssic_x10;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void up_dedup_init(struct up_dedup_s * dedup, uint32_t window_ms) {
+    memset(dedup, 0, sizeof *dedup);
+    dedup->window_ns = (int64_t)window_ms * 1000000LL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int up_dedup_batch(struct up_dedup_s * dedup, struct lgw_pkt_rx_s * const * pkt, int nb_pkt, int16_t * dup_of) {
+    struct up_dedup_slot_s * s;
+    struct up_dedup_slot_s * found;
+    struct up_dedup_slot_s * victim;
+    uint64_t h;
+    int i, j, k;
+    int nb_dup = 0;
+
+    dedup->batch += 1;
+    for (i = 0; i < nb_pkt; i++) {
+        dup_of[i] = UP_DEDUP_UNIQUE;
+        if (pkt[i]->status != STAT_CRC_OK) {
+            continue;
+        }
+
+        /* look for a recent copy, and the slot to reuse if none: a free or expired one, else the oldest */
+        h = payload_hash(pkt[i]);
+        found = NULL;
+        victim = NULL;
+        for (k = 0; k < UP_DEDUP_PROBE_NB; k++) {
+            s = &dedup->slot[(h + k) & (UP_DEDUP_SLOT_NB - 1)];
+            if ((s->fetch_ns == 0) || ((pkt[i]->host_fetch_ns - s->fetch_ns) >= dedup->window_ns)) {
+                if ((victim == NULL) || (victim->fetch_ns != 0)) {
+                    victim = s;
+                }
+                continue;
+            }
+            if (s->hash == h) {
+                found = s;
+                break;
+            }
+            if ((victim == NULL) || ((victim->fetch_ns != 0) && (s->fetch_ns < victim->fetch_ns))) {
+                victim = s;
+            }
+        }
+
+        if (found == NULL) {
+            victim->hash = h;
+            victim->fetch_ns = pkt[i]->host_fetch_ns;
+            victim->batch = dedup->batch;
+            victim->idx = (int16_t)i;
+            continue;
+        }
+
+        nb_dup += 1;
+        if (found->batch != dedup->batch) {
+            dup_of[i] = UP_DEDUP_FORWARDED;
+        } else if (pkt_rssi(pkt[i]) > pkt_rssi(pkt[found->idx])) {
+            dup_of[found->idx] = (int16_t)i;
+            found->idx = (int16_t)i;
+        } else {
+            dup_of[i] = found->idx;
+        }
+    }
+
+    /* the copies point to the copy kept in the end, and not to one it replaced */
+    for (i = 0; i < nb_pkt; i++) {
+        for (j = dup_of[i]; (j >= 0) && (dup_of[j] >= 0); j = dup_of[j]);
+        if (dup_of[i] >= 0) {
+            dup_of[i] = (int16_t)j;
+        }
+    }
+
+    return nb_dup;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
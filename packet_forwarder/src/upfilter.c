@@ -0,0 +1,197 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    LoRa concentrator : filter of the uplinks on their DevAddr, NetID and
+    JoinEUI, to drop the packets of the foreign networks before serialization.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>     /* memset */
+
+#include "upfilter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define MTYPE_JOIN_REQUEST      0
+#define MTYPE_UNCONF_DATA_UP    2
+#define MTYPE_CONF_DATA_UP      4
+
+#define JOIN_REQUEST_SIZE       23  /* MHDR, JoinEUI, DevEUI, DevNonce, MIC */
+#define DATA_UP_SIZE_MIN        12  /* MHDR, DevAddr, FCtrl, FCnt, MIC */
+
+#define JOIN_SLOT_NB            (2 * UP_FILTER_JOIN_NB_MAX)
+#define JOIN_SLOT_BITS          9   /* log2 of JOIN_SLOT_NB */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* number of NwkID bits of the DevAddr, for each NetID type (LoRaWAN Backend Interfaces) */
+static const uint8_t nwkid_bits[8] = { 6, 6, 9, 11, 12, 13, 15, 17 };
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint32_t prefix_mask(int len) {
+    return (len == 0) ? 0 : (0xFFFFFFFFU << (32 - len));
+}
+
+static unsigned join_slot(uint64_t join_eui) {
+    return (unsigned)((join_eui * 0x9E3779B97F4A7C15ULL) >> (64 - JOIN_SLOT_BITS));
+}
+
+static uint32_t get_le32(const uint8_t * buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t * buf) {
+    return (uint64_t)get_le32(buf) | ((uint64_t)get_le32(buf + 4) << 32);
+}
+
+static bool devaddr_allowed(const struct up_filter_s * filter, uint32_t devaddr) {
+    uint32_t block = devaddr >> (32 - UP_FILTER_BLOCK_BITS);
+    int i;
+
+    if ((filter->block_all[block / 32] & (1U << (block % 32))) != 0) {
+        return true;
+    }
+    if ((filter->block_long[block / 32] & (1U << (block % 32))) != 0) {
+        for (i = 0; i < filter->nb_long; i++) {
+            if ((devaddr & prefix_mask(filter->long_rule[i].len)) == filter->long_rule[i].prefix) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool join_eui_allowed(const struct up_filter_s * filter, uint64_t join_eui) {
+    unsigned i = join_slot(join_eui);
+
+    while (filter->join_used[i] != 0) {
+        if (filter->join_eui[i] == join_eui) {
+            return true;
+        }
+        i = (i + 1) % JOIN_SLOT_NB;
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void up_filter_init(struct up_filter_s * filter) {
+    memset(filter, 0, sizeof *filter);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int up_filter_add_devaddr(struct up_filter_s * filter, uint32_t prefix, int len) {
+    uint32_t block, nb_block;
+
+    if ((len < 0) || (len > 32)) {
+        return -1;
+    }
+    prefix &= prefix_mask(len);
+    block = prefix >> (32 - UP_FILTER_BLOCK_BITS);
+
+    if (len <= UP_FILTER_BLOCK_BITS) {
+        /* every block of the prefix is allowed as a whole */
+        for (nb_block = 1U << (UP_FILTER_BLOCK_BITS - len); nb_block > 0; nb_block--, block++) {
+            filter->block_all[block / 32] |= 1U << (block % 32);
+        }
+    } else {
+        if (filter->nb_long >= UP_FILTER_LONG_NB_MAX) {
+            return -1;
+        }
+        filter->long_rule[filter->nb_long].prefix = prefix;
+        filter->long_rule[filter->nb_long].len = (uint8_t)len;
+        filter->nb_long += 1;
+        filter->block_long[block / 32] |= 1U << (block % 32);
+    }
+    filter->devaddr_enabled = true;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int up_filter_add_netid(struct up_filter_s * filter, uint32_t netid) {
+    int type, bits;
+    uint32_t prefix;
+
+    if (netid > 0xFFFFFF) {
+        return -1;
+    }
+    type = (int)(netid >> 21);
+    bits = nwkid_bits[type];
+
+    /* DevAddr: type as a prefix of 'type' ones and a zero, then the NwkID (LSBits of the NetID), then the NwkAddr */
+    prefix = prefix_mask(type);
+    prefix |= (netid & ((1U << bits) - 1)) << (32 - (type + 1) - bits);
+
+    return up_filter_add_devaddr(filter, prefix, type + 1 + bits);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int up_filter_add_join_eui(struct up_filter_s * filter, uint64_t join_eui) {
+    unsigned i;
+
+    if (join_eui_allowed(filter, join_eui)) {
+        filter->join_enabled = true;
+        return 0;
+    }
+    if (filter->nb_join >= UP_FILTER_JOIN_NB_MAX) {
+        return -1;
+    }
+
+    for (i = join_slot(join_eui); filter->join_used[i] != 0; i = (i + 1) % JOIN_SLOT_NB);
+    filter->join_eui[i] = join_eui;
+    filter->join_used[i] = 1;
+    filter->nb_join += 1;
+    filter->join_enabled = true;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+enum up_filter_e up_filter_check(const struct up_filter_s * filter, const uint8_t * payload, uint16_t size) {
+    if (size == 0) {
+        return UP_FILTER_PASS;
+    }
+
+    switch (payload[0] >> 5) {
+        case MTYPE_UNCONF_DATA_UP:
+        case MTYPE_CONF_DATA_UP:
+            if ((filter->devaddr_enabled == true) && (size >= DATA_UP_SIZE_MIN) && !devaddr_allowed(filter, get_le32(&payload[1]))) {
+                return UP_FILTER_DROP_DEVADDR;
+            }
+            break;
+        case MTYPE_JOIN_REQUEST:
+            if ((filter->join_enabled == true) && (size >= JOIN_REQUEST_SIZE) && !join_eui_allowed(filter, get_le64(&payload[1]))) {
+                return UP_FILTER_DROP_JOIN_EUI;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return UP_FILTER_PASS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
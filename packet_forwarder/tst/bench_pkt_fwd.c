@@ -0,0 +1,334 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Micro-benchmarks of the downlink path of the packet forwarder: decoding
+    of the txpk objects, and the JiT queue at several occupancies.
+
+    A jit enqueue case queues a downlink among N queued ones, and dequeues it
+    so that the occupancy stays N, both calls being timed. The peek cases do
+    not change the queue.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, snprintf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memset, memcpy, strlen */
+#include <unistd.h>     /* getopt */
+
+#include "loragw_hal.h"
+#include "jitqueue.h"
+#include "txpkdec.h"
+#include "parson.h"
+#include "base64.h"
+#include "bench.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define JIT_TIME_US         1000000ULL  /* concentrator time of the cases */
+#define JIT_FIRST_US        100000      /* first packet queued, after the current time */
+#define JIT_SPACING_US      200000      /* the packets of 41 ms queued leave gaps too short for an immediate one */
+#define TXPK_SIZE           1024
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct jit_case_s {
+    struct jit_queue_s * queue;
+    struct lgw_pkt_tx_s pkt;        /* downlink enqueued and dequeued */
+    enum jit_pkt_type_e type;
+    uint64_t count_us64;            /* 0 for an immediate downlink */
+    int index;                      /* node taken by the downlink, the same one each time */
+    uint64_t time_us;               /* current time of the peek cases */
+};
+
+struct txpk_case_s {
+    const char * json;
+    int len;
+    char work[TXPK_SIZE];           /* txpk_decode unescapes the JSON text in place */
+    struct lgw_pkt_tx_s pkt;
+    struct txpk_dec_s dec;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct jit_queue_s jit_queue;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("~~~ Library version string~~~\n");
+    printf(" %s\n", lgw_version_info());
+    printf("~~~ Available options ~~~\n");
+    printf(" -h            Print this help\n");
+    bench_usage();
+}
+
+static void jit_pkt_set(struct lgw_pkt_tx_s * pkt, uint64_t count_us64) {
+    memset(pkt, 0, sizeof *pkt);
+    pkt->freq_hz = 869525000;
+    pkt->tx_mode = TIMESTAMPED;
+    pkt->count_us64 = count_us64;
+    pkt->count_us = (uint32_t)count_us64;
+    pkt->rf_power = 14;
+    pkt->modulation = MOD_LORA;
+    pkt->bandwidth = BW_125KHZ;
+    pkt->datarate = DR_LORA_SF7;
+    pkt->coderate = CR_LORA_4_5;
+    pkt->invert_pol = true;
+    pkt->preamble = 8;
+    pkt->size = 12;
+}
+
+/* Queue nb downlinks, and find the node taken by the one of the case */
+static int jit_setup(struct jit_case_s * c, int nb) {
+    struct lgw_pkt_tx_s pkt;
+    enum jit_pkt_type_e type;
+    int i;
+
+    if (jit_queue_init(&jit_queue, nb + 1) != JIT_ERROR_OK) {
+        return -1;
+    }
+    for (i = 0; i < nb; i++) {
+        jit_pkt_set(&pkt, JIT_TIME_US + JIT_FIRST_US + (uint64_t)i * JIT_SPACING_US);
+        if (jit_enqueue(&jit_queue, JIT_TIME_US, &pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_A) != JIT_ERROR_OK) {
+            printf("ERROR: failed to queue downlink %d\n", i);
+            return -1;
+        }
+    }
+    c->queue = &jit_queue;
+
+    jit_pkt_set(&c->pkt, c->count_us64);
+    if (jit_enqueue(&jit_queue, JIT_TIME_US, &c->pkt, c->type) != JIT_ERROR_OK) {
+        printf("ERROR: failed to queue the downlink of the case\n");
+        return -1;
+    }
+    c->index = -1;
+    for (i = 0; i < jit_queue.num_pkt; i++) {
+        if (jit_queue.nodes[jit_queue.order[i]].pkt.count_us64 == c->pkt.count_us64) {
+            c->index = jit_queue.order[i];
+        }
+    }
+    if ((c->index < 0) || (jit_dequeue(&jit_queue, c->index, &pkt, &type) != JIT_ERROR_OK)) {
+        printf("ERROR: failed to dequeue the downlink of the case\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static uint64_t case_jit_enqueue(void * arg, uint64_t nb) {
+    struct jit_case_s * c = arg;
+    struct lgw_pkt_tx_s pkt;
+    enum jit_pkt_type_e type;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        c->pkt.count_us64 = c->count_us64;
+        c->pkt.count_us = (uint32_t)c->count_us64;
+        c->pkt.tx_mode = TIMESTAMPED;
+        bench_sink += jit_enqueue(c->queue, JIT_TIME_US, &c->pkt, c->type);
+        bench_sink += jit_dequeue(c->queue, c->index, &pkt, &type);
+    }
+
+    return nb;
+}
+
+static uint64_t case_jit_peek(void * arg, uint64_t nb) {
+    struct jit_case_s * c = arg;
+    uint64_t i;
+    int index;
+
+    for (i = 0; i < nb; i++) {
+        jit_peek(c->queue, c->time_us, &index);
+        bench_sink += index;
+    }
+
+    return nb;
+}
+
+static uint64_t case_txpk_decode(void * arg, uint64_t nb) {
+    struct txpk_case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        memcpy(c->work, c->json, c->len + 1);
+        bench_sink += txpk_decode(c->work, &c->pkt, &c->dec);
+        bench_sink += c->pkt.count_us;
+    }
+
+    return nb;
+}
+
+static uint64_t case_txpk_payload(void * arg, uint64_t nb) {
+    struct txpk_case_s * c = arg;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        bench_sink += txpk_decode_payload(&c->dec, &c->pkt);
+    }
+
+    return nb;
+}
+
+/* Reference: the txpk object parsed into a tree, and read back, by parson */
+static uint64_t case_txpk_parson(void * arg, uint64_t nb) {
+    struct txpk_case_s * c = arg;
+    JSON_Value * root;
+    JSON_Object * txpk;
+    const char * str;
+    uint64_t i;
+
+    for (i = 0; i < nb; i++) {
+        root = json_parse_string_with_comments(c->json);
+        txpk = json_object_get_object(json_value_get_object(root), "txpk");
+        bench_sink += (uint32_t)json_object_get_number(txpk, "tmst");
+        bench_sink += (uint32_t)(json_object_get_number(txpk, "freq") * 1e6);
+        bench_sink += (uint32_t)json_object_get_number(txpk, "powe");
+        bench_sink += (uint32_t)json_object_get_number(txpk, "size");
+        bench_sink += json_object_get_boolean(txpk, "ipol");
+        str = json_object_get_string(txpk, "datr");
+        bench_sink += (str != NULL) ? str[2] : 0;
+        str = json_object_get_string(txpk, "data");
+        if (str != NULL) {
+            bench_sink += b64_to_bin(str, strlen(str), c->pkt.payload, sizeof c->pkt.payload);
+        }
+        json_value_free(root);
+    }
+
+    return nb;
+}
+
+static int txpk_setup(struct txpk_case_s * c, const char * json) {
+    c->json = json;
+    c->len = strlen(json);
+    if (c->len >= TXPK_SIZE) {
+        return -1;
+    }
+    memcpy(c->work, c->json, c->len + 1);
+    if ((txpk_decode(c->work, &c->pkt, &c->dec) != TXPK_DEC_OK) || (txpk_decode_payload(&c->dec, &c->pkt) < 0)) {
+        printf("ERROR: failed to decode %s\n", json);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    static const int occupancy[] = { 1, 8, 64, 512 };
+    static char txpk_lora[TXPK_SIZE];
+    static char txpk_fsk[TXPK_SIZE];
+    static char txpk_large[TXPK_SIZE];
+    static struct txpk_case_s txpk_case;
+    uint8_t payload[255];
+    char b64[341];
+    char name[64];
+    int i, n;
+    struct jit_case_s c;
+    struct bench_conf_s conf;
+
+    bench_init(&conf, "packet_forwarder");
+    while ((i = getopt(argc, argv, "h" BENCH_OPTIONS)) != -1) {
+        if (i == 'h') {
+            usage();
+            return -1;
+        }
+        if (bench_option(&conf, i, optarg) != 0) {
+            printf("ERROR: argument parsing\n");
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    srand(0);
+    for (i = 0; i < (int)sizeof payload; i++) {
+        payload[i] = (uint8_t)rand();
+    }
+
+    bench_begin(&conf);
+
+    /* Class A downlink in the middle of the queue, immediate one after the last one */
+    memset(&c, 0, sizeof c);
+    for (i = 0; i < (int)ARRAY_SIZE(occupancy); i++) {
+        n = occupancy[i];
+        c.type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
+        c.count_us64 = JIT_TIME_US + JIT_FIRST_US + (uint64_t)(n / 2) * JIT_SPACING_US + (JIT_SPACING_US / 2);
+        snprintf(name, sizeof name, "jit/enqueue_dequeue/%d", n);
+        if (bench_selected(&conf, name) && (jit_setup(&c, n) == 0)) {
+            bench_run(&conf, name, case_jit_enqueue, &c);
+        }
+        c.type = JIT_PKT_TYPE_DOWNLINK_CLASS_C;
+        c.count_us64 = 0;
+        snprintf(name, sizeof name, "jit/enqueue_dequeue_imme/%d", n);
+        if (bench_selected(&conf, name) && (jit_setup(&c, n) == 0)) {
+            bench_run(&conf, name, case_jit_enqueue, &c);
+        }
+        c.time_us = JIT_TIME_US;
+        snprintf(name, sizeof name, "jit/peek/%d", n);
+        if (bench_selected(&conf, name) && (jit_setup(&c, n) == 0)) {
+            bench_run(&conf, name, case_jit_peek, &c);
+        }
+        c.time_us = JIT_TIME_US + JIT_FIRST_US - 10000;
+        snprintf(name, sizeof name, "jit/peek_due/%d", n);
+        if (bench_selected(&conf, name) && (jit_setup(&c, n) == 0)) {
+            bench_run(&conf, name, case_jit_peek, &c);
+        }
+    }
+
+    bin_to_b64(payload, 32, b64, sizeof b64);
+    snprintf(txpk_lora, sizeof txpk_lora, "{\"txpk\":{\"imme\":false,\"tmst\":3512348611,\"freq\":869.525,\"rfch\":0,\"powe\":14,\"modu\":\"LORA\",\"datr\":\"SF9BW125\",\"codr\":\"4/5\",\"ipol\":true,\"size\":32,\"data\":\"%s\"}}", b64);
+    bin_to_b64(payload, 64, b64, sizeof b64);
+    snprintf(txpk_fsk, sizeof txpk_fsk, "{\"txpk\":{\"imme\":true,\"freq\":868.8,\"rfch\":0,\"powe\":14,\"modu\":\"FSK\",\"datr\":50000,\"fdev\":25000,\"prea\":5,\"size\":64,\"data\":\"%s\"}}", b64);
+    bin_to_b64(payload, 255, b64, sizeof b64);
+    snprintf(txpk_large, sizeof txpk_large, "{\"txpk\":{\"imme\":false,\"tmst\":3512348611,\"freq\":869.525,\"rfch\":0,\"powe\":14,\"modu\":\"LORA\",\"datr\":\"SF7BW125\",\"codr\":\"4/5\",\"ipol\":true,\"size\":255,\"data\":\"%s\"}}", b64);
+
+    if (txpk_setup(&txpk_case, txpk_lora) == 0) {
+        bench_run(&conf, "txpk/decode/lora_32", case_txpk_decode, &txpk_case);
+        bench_run(&conf, "txpk/decode_payload/lora_32", case_txpk_payload, &txpk_case);
+        bench_run(&conf, "txpk/parson/lora_32", case_txpk_parson, &txpk_case);
+    }
+    if (txpk_setup(&txpk_case, txpk_fsk) == 0) {
+        bench_run(&conf, "txpk/decode/fsk_64", case_txpk_decode, &txpk_case);
+        bench_run(&conf, "txpk/decode_payload/fsk_64", case_txpk_payload, &txpk_case);
+    }
+    if (txpk_setup(&txpk_case, txpk_large) == 0) {
+        bench_run(&conf, "txpk/decode/lora_255", case_txpk_decode, &txpk_case);
+        bench_run(&conf, "txpk/decode_payload/lora_255", case_txpk_payload, &txpk_case);
+        bench_run(&conf, "txpk/parson/lora_255", case_txpk_parson, &txpk_case);
+    }
+    bench_end(&conf);
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,521 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Check the JiT queue against a reference model of the previous one: a
+    sorted array scanned linearly, with the same criteria. Random sequences
+    of enqueues, peeks, dequeues by index and time steps must give the same
+    errors and the same queued packets, in the same order. Boundary cases of
+    TOO_LATE, TOO_EARLY and the beacon guard are checked first.
+
+    The immediate downlinks take the earliest free slot, at least 2 JIT
+    delays ahead: the previous queue only checked the packet following a
+    candidate slot, and could take a slot before that margin.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, sscanf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memset, memmove */
+#include <unistd.h>     /* getopt */
+
+#include "loragw_hal.h"
+#include "jitqueue.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+/* delays of jitqueue.c */
+#define TX_START_DELAY          1500
+#define TX_MARGIN_DELAY         1000
+#define TX_JIT_DELAY            40000
+#define TX_MAX_ADVANCE_DELAY    ((JIT_NUM_BEACON_IN_QUEUE + 1) * 128 * 1E6)
+#define BEACON_GUARD            3000000
+#define BEACON_RESERVED         2120000
+
+#define QUEUE_SIZE              16
+#define NB_OPS_DEFAULT          200000
+#define TIME_START_US           ((1ULL << 32) - 600000000ULL) /* the 32-bit counter rolls over during the run */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct ref_node_s {
+    uint64_t count_us;
+    uint32_t pre_delay;
+    uint32_t post_delay;
+    enum jit_pkt_type_e pkt_type;
+};
+
+struct ref_queue_s {
+    int num_pkt;
+    struct ref_node_s nodes[QUEUE_SIZE];    /* sorted by timestamp */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct jit_queue_s queue;
+static struct ref_queue_s ref;
+static uint64_t time_us;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static bool ref_collision(uint64_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint64_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
+    return ((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
+           ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY));
+}
+
+/* first packet colliding with the given one, in timestamp order, -1 if none */
+static int ref_find_collision(uint64_t count_us, uint32_t pre_delay, uint32_t post_delay, enum jit_pkt_type_e pkt_type) {
+    uint32_t target_pre_delay;
+    int i;
+
+    for (i = 0; i < ref.num_pkt; i++) {
+        /* the beacon guard is ignored for Class A/C downlinks */
+        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (ref.nodes[i].pkt_type == JIT_PKT_TYPE_BEACON)) {
+            target_pre_delay = TX_START_DELAY;
+        } else {
+            target_pre_delay = ref.nodes[i].pre_delay;
+        }
+        if (ref_collision(count_us, pre_delay, post_delay, ref.nodes[i].count_us, target_pre_delay, ref.nodes[i].post_delay)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* earliest slot of an immediate downlink: the margin, or right after a queued packet */
+static uint64_t ref_asap(uint32_t pre_delay, uint32_t post_delay) {
+    uint64_t asap = time_us + 2 * TX_JIT_DELAY;
+    uint64_t candidate;
+    uint64_t best = 0;
+    int i;
+
+    if (ref_find_collision(asap, pre_delay, post_delay, JIT_PKT_TYPE_DOWNLINK_CLASS_C) < 0) {
+        return asap;
+    }
+    for (i = 0; i < ref.num_pkt; i++) {
+        candidate = ref.nodes[i].count_us + ref.nodes[i].post_delay + pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
+        if ((candidate >= asap) && ((best == 0) || (candidate < best)) && (ref_find_collision(candidate, pre_delay, post_delay, JIT_PKT_TYPE_DOWNLINK_CLASS_C) < 0)) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+static enum jit_error_e ref_enqueue(const struct lgw_pkt_tx_s * pkt, uint64_t count_us, enum jit_pkt_type_e pkt_type, uint64_t * count_out) {
+    uint32_t pre_delay, post_delay;
+    int i;
+
+    *count_out = count_us;
+    if (ref.num_pkt == QUEUE_SIZE) {
+        return JIT_ERROR_FULL;
+    }
+    if (pkt_type == JIT_PKT_TYPE_BEACON) {
+        pre_delay = TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY;
+        post_delay = BEACON_RESERVED;
+    } else {
+        pre_delay = TX_START_DELAY + TX_JIT_DELAY;
+        post_delay = lgw_time_on_air(pkt) * 1000UL;
+    }
+    if (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C) {
+        count_us = (ref.num_pkt == 0) ? (time_us + 2 * TX_JIT_DELAY) : ref_asap(pre_delay, post_delay);
+    }
+    *count_out = count_us;
+
+    if (count_us <= (time_us + TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY)) {
+        return JIT_ERROR_TOO_LATE;
+    }
+    if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_B)) && ((count_us - time_us) > TX_MAX_ADVANCE_DELAY)) {
+        return JIT_ERROR_TOO_EARLY;
+    }
+    i = ref_find_collision(count_us, pre_delay, post_delay, pkt_type);
+    if (i >= 0) {
+        return (ref.nodes[i].pkt_type == JIT_PKT_TYPE_BEACON) ? JIT_ERROR_COLLISION_BEACON : JIT_ERROR_COLLISION_PACKET;
+    }
+
+    for (i = ref.num_pkt; (i > 0) && (ref.nodes[i - 1].count_us > count_us); i--) {
+        ref.nodes[i] = ref.nodes[i - 1];
+    }
+    ref.nodes[i].count_us = count_us;
+    ref.nodes[i].pre_delay = pre_delay;
+    ref.nodes[i].post_delay = post_delay;
+    ref.nodes[i].pkt_type = pkt_type;
+    ref.num_pkt += 1;
+
+    return JIT_ERROR_OK;
+}
+
+static void ref_remove(int pos) {
+    memmove(&ref.nodes[pos], &ref.nodes[pos + 1], (ref.num_pkt - pos - 1) * sizeof ref.nodes[0]);
+    ref.num_pkt -= 1;
+}
+
+/* the outdated packets are dropped, the first one is returned if due, -1 otherwise */
+static int ref_peek(void) {
+    while ((ref.num_pkt > 0) && ((ref.nodes[0].count_us - time_us) >= TX_MAX_ADVANCE_DELAY)) {
+        ref_remove(0);
+    }
+    return ((ref.num_pkt > 0) && ((ref.nodes[0].count_us - time_us) < TX_JIT_DELAY)) ? 0 : -1;
+}
+
+/* the queue must hold the packets of the model, in the same order */
+static unsigned check_content(const char * op) {
+    const struct jit_node_s * node;
+    int nb_beacon = 0;
+    int i;
+
+    for (i = 0; i < ref.num_pkt; i++) {
+        nb_beacon += (ref.nodes[i].pkt_type == JIT_PKT_TYPE_BEACON) ? 1 : 0;
+    }
+    if ((queue.num_pkt != ref.num_pkt) || (queue.num_beacon != nb_beacon)) {
+        printf("MISMATCH after %s: %u packets and %u beacons queued, %d and %d expected\n", op, queue.num_pkt, queue.num_beacon, ref.num_pkt, nb_beacon);
+        return 1;
+    }
+    for (i = 0; i < ref.num_pkt; i++) {
+        node = &queue.nodes[queue.order[i]];
+        if ((node->pkt.count_us64 != ref.nodes[i].count_us) || ((uint32_t)node->pkt.count_us != (uint32_t)ref.nodes[i].count_us) ||
+            (node->pkt_type != ref.nodes[i].pkt_type) || (node->pre_delay != ref.nodes[i].pre_delay) || (node->post_delay != ref.nodes[i].post_delay)) {
+            printf("MISMATCH after %s: packet %d at %llu type %d, %llu type %d expected\n", op, i,
+                   (unsigned long long)node->pkt.count_us64, node->pkt_type, (unsigned long long)ref.nodes[i].count_us, ref.nodes[i].pkt_type);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void pkt_set(struct lgw_pkt_tx_s * pkt, uint8_t sf, uint16_t size) {
+    memset(pkt, 0, sizeof *pkt);
+    pkt->freq_hz = 868100000;
+    pkt->tx_mode = TIMESTAMPED;
+    pkt->rf_power = 14;
+    pkt->modulation = MOD_LORA;
+    pkt->bandwidth = BW_125KHZ;
+    pkt->datarate = sf;
+    pkt->coderate = CR_LORA_4_5;
+    pkt->invert_pol = true;
+    pkt->preamble = 8;
+    pkt->size = size;
+}
+
+/* enqueue in both queues, the 64-bit timestamp or only its 32-bit value given */
+static unsigned enqueue(uint64_t count_us, enum jit_pkt_type_e pkt_type, uint8_t sf, uint16_t size, bool count_32, enum jit_error_e * result) {
+    struct lgw_pkt_tx_s pkt;
+    enum jit_error_e err, ref_err;
+    uint64_t ref_count;
+
+    pkt_set(&pkt, sf, size);
+    if (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C) {
+        pkt.tx_mode = IMMEDIATE;
+    } else if (count_32) {
+        pkt.count_us = (uint32_t)count_us;
+        count_us = time_us + (uint32_t)(pkt.count_us - (uint32_t)time_us); /* next occurrence of the 32-bit value */
+    } else {
+        pkt.count_us64 = count_us;
+    }
+    err = jit_enqueue(&queue, time_us, &pkt, pkt_type);
+    ref_err = ref_enqueue(&pkt, count_us, pkt_type, &ref_count);
+    if (result != NULL) {
+        *result = err;
+    }
+    if (err != ref_err) {
+        printf("MISMATCH: enqueue of type %d at %llu (time %llu): error %d, %d expected\n", pkt_type, (unsigned long long)ref_count, (unsigned long long)time_us, err, ref_err);
+        return 1;
+    }
+    if ((err == JIT_ERROR_OK) && ((pkt.count_us64 != ref_count) || (pkt.tx_mode != TIMESTAMPED))) {
+        printf("MISMATCH: enqueue of type %d scheduled at %llu, %llu expected\n", pkt_type, (unsigned long long)pkt.count_us64, (unsigned long long)ref_count);
+        return 1;
+    }
+    return check_content("enqueue");
+}
+
+/* peek in both queues, and dequeue the packet due by its index */
+static unsigned peek(void) {
+    struct lgw_pkt_tx_s pkt;
+    enum jit_pkt_type_e pkt_type;
+    enum jit_error_e err;
+    int index, ref_pos;
+
+    err = jit_peek(&queue, time_us, &index);
+    if (ref.num_pkt == 0) {
+        if (err != JIT_ERROR_EMPTY) {
+            printf("MISMATCH: peek of an empty queue: error %d\n", err);
+            return 1;
+        }
+        return 0;
+    }
+    ref_pos = ref_peek();
+    if ((err != JIT_ERROR_OK) || ((index >= 0) != (ref_pos >= 0))) {
+        printf("MISMATCH: peek at %llu: error %d, index %d, %s expected\n", (unsigned long long)time_us, err, index, (ref_pos >= 0) ? "a packet" : "none");
+        return 1;
+    }
+    if (check_content("peek") != 0) {
+        return 1;
+    }
+    if (index < 0) {
+        return 0;
+    }
+    err = jit_dequeue(&queue, index, &pkt, &pkt_type);
+    if ((err != JIT_ERROR_OK) || (pkt.count_us64 != ref.nodes[0].count_us) || (pkt_type != ref.nodes[0].pkt_type)) {
+        printf("MISMATCH: dequeue of the packet peeked: error %d, packet at %llu\n", err, (unsigned long long)pkt.count_us64);
+        return 1;
+    }
+    ref_remove(0);
+    return check_content("dequeue");
+}
+
+/* dequeue the packet at a position of the order array, by its node index */
+static unsigned dequeue_at(int pos) {
+    struct lgw_pkt_tx_s pkt;
+    enum jit_pkt_type_e pkt_type;
+    enum jit_error_e err;
+    bool used[QUEUE_SIZE];
+    int i;
+
+    if (ref.num_pkt == 0) {
+        err = jit_dequeue(&queue, 0, &pkt, &pkt_type);
+        if (err != JIT_ERROR_EMPTY) {
+            printf("MISMATCH: dequeue of an empty queue: error %d\n", err);
+            return 1;
+        }
+        return 0;
+    }
+
+    /* an unused node and an index out of the pool are refused, the queue is unchanged */
+    memset(used, 0, sizeof used);
+    for (i = 0; i < queue.num_pkt; i++) {
+        used[queue.order[i]] = true;
+    }
+    for (i = 0; (i < QUEUE_SIZE) && used[i]; i++);
+    if (((i < QUEUE_SIZE) && (jit_dequeue(&queue, i, &pkt, &pkt_type) != JIT_ERROR_INVALID)) ||
+        (jit_dequeue(&queue, QUEUE_SIZE, &pkt, &pkt_type) != JIT_ERROR_INVALID) || (jit_dequeue(&queue, -1, &pkt, &pkt_type) != JIT_ERROR_INVALID)) {
+        printf("MISMATCH: dequeue of an unused node accepted\n");
+        return 1;
+    }
+    if (check_content("invalid dequeue") != 0) {
+        return 1;
+    }
+
+    err = jit_dequeue(&queue, queue.order[pos], &pkt, &pkt_type);
+    if ((err != JIT_ERROR_OK) || (pkt.count_us64 != ref.nodes[pos].count_us) || (pkt_type != ref.nodes[pos].pkt_type)) {
+        printf("MISMATCH: dequeue of packet %d: error %d, packet at %llu\n", pos, err, (unsigned long long)pkt.count_us64);
+        return 1;
+    }
+    ref_remove(pos);
+    return check_content("dequeue");
+}
+
+/* a timestamp at the edge of the collision window of a queued packet, before or after it */
+static uint64_t edge_of(enum jit_pkt_type_e pkt_type, uint8_t sf, uint16_t size) {
+    struct lgw_pkt_tx_s pkt;
+    const struct ref_node_s * node;
+    uint32_t pre_delay, post_delay, target_pre_delay;
+    int64_t jitter = (rand() % 4) - 1;
+
+    if (ref.num_pkt == 0) {
+        return time_us + 40000 + (uint64_t)(rand() % 8000) * 1000;
+    }
+    node = &ref.nodes[rand() % ref.num_pkt];
+    if (pkt_type == JIT_PKT_TYPE_BEACON) {
+        pre_delay = TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY;
+        post_delay = BEACON_RESERVED;
+    } else {
+        pkt_set(&pkt, sf, size);
+        pre_delay = TX_START_DELAY + TX_JIT_DELAY;
+        post_delay = lgw_time_on_air(&pkt) * 1000UL;
+    }
+    if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (node->pkt_type == JIT_PKT_TYPE_BEACON)) {
+        target_pre_delay = TX_START_DELAY;
+    } else {
+        target_pre_delay = node->pre_delay;
+    }
+    if (rand() % 2) {
+        return node->count_us + node->post_delay + pre_delay + TX_MARGIN_DELAY + jitter;
+    }
+    return node->count_us - (target_pre_delay + post_delay + TX_MARGIN_DELAY) - jitter;
+}
+
+static void reset(void) {
+    jit_queue_init(&queue, QUEUE_SIZE);
+    memset(&ref, 0, sizeof ref);
+    time_us = TIME_START_US;
+}
+
+/* boundaries of the criteria, with the expected errors */
+static unsigned check_boundaries(void) {
+    static const struct {
+        int64_t offset_us;          /* from the current time */
+        enum jit_pkt_type_e pkt_type;
+        enum jit_error_e expected;
+    } step[] = {
+        { TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY,      JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_TOO_LATE },
+        { TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY + 1,  JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_OK },
+        { 512000000,                                            JIT_PKT_TYPE_DOWNLINK_CLASS_B, JIT_ERROR_OK },
+        { 512000001,                                            JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_TOO_EARLY },
+        { 520000000,                                            JIT_PKT_TYPE_BEACON,           JIT_ERROR_OK },  /* never too early */
+        { 10000000,                                             JIT_PKT_TYPE_BEACON,           JIT_ERROR_OK },
+        { 10000000 - 2500000,                                   JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_OK },  /* guard ignored */
+        { 10000000 - 2000000,                                   JIT_PKT_TYPE_DOWNLINK_CLASS_B, JIT_ERROR_COLLISION_BEACON }, /* in the guard */
+        { 10000000 - 30000,                                     JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_COLLISION_BEACON },
+        { 10000000 + 2150000,                                   JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_COLLISION_BEACON }, /* in the beacon */
+        { 10000000 + 2200000,                                   JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_ERROR_OK },
+        { 10000000 + 2200000 + 20000,                           JIT_PKT_TYPE_DOWNLINK_CLASS_B, JIT_ERROR_COLLISION_PACKET },
+        { 12000000,                                             JIT_PKT_TYPE_BEACON,           JIT_ERROR_COLLISION_BEACON },
+        { 0,                                                    JIT_PKT_TYPE_DOWNLINK_CLASS_C, JIT_ERROR_OK },  /* at the margin */
+        { 0,                                                    JIT_PKT_TYPE_DOWNLINK_CLASS_C, JIT_ERROR_OK }   /* after the first one */
+    };
+    struct lgw_pkt_tx_s pkt;
+    enum jit_error_e err;
+    uint64_t beacon_us, edge_us;
+    uint32_t toa_us;
+    unsigned nb_err = 0;
+    unsigned i;
+
+    reset();
+    for (i = 0; i < ARRAY_SIZE(step); i++) {
+        nb_err += enqueue(time_us + step[i].offset_us, step[i].pkt_type, DR_LORA_SF7, 12, false, &err);
+        if (err != step[i].expected) {
+            printf("MISMATCH: boundary step %u: error %d, %d expected\n", i, err, step[i].expected);
+            nb_err += 1;
+        }
+    }
+
+    /* edges of the collision window before a beacon, with and without its guard */
+    pkt_set(&pkt, DR_LORA_SF7, 12);
+    toa_us = lgw_time_on_air(&pkt) * 1000UL;
+    beacon_us = time_us + 30000000;
+    nb_err += enqueue(beacon_us, JIT_PKT_TYPE_BEACON, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_OK) ? 1 : 0;
+    edge_us = beacon_us - (TX_START_DELAY + toa_us + TX_MARGIN_DELAY);
+    nb_err += enqueue(edge_us, JIT_PKT_TYPE_DOWNLINK_CLASS_A, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_COLLISION_BEACON) ? 1 : 0;
+    nb_err += enqueue(edge_us - 1, JIT_PKT_TYPE_DOWNLINK_CLASS_A, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_OK) ? 1 : 0;
+    edge_us = beacon_us - (TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY + toa_us + TX_MARGIN_DELAY);
+    nb_err += enqueue(edge_us, JIT_PKT_TYPE_DOWNLINK_CLASS_B, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_COLLISION_BEACON) ? 1 : 0;
+    nb_err += enqueue(edge_us - 1, JIT_PKT_TYPE_DOWNLINK_CLASS_B, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_OK) ? 1 : 0;
+    edge_us = beacon_us + BEACON_RESERVED + TX_START_DELAY + TX_JIT_DELAY + TX_MARGIN_DELAY;
+    nb_err += enqueue(edge_us, JIT_PKT_TYPE_DOWNLINK_CLASS_B, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_COLLISION_BEACON) ? 1 : 0;
+    nb_err += enqueue(edge_us + 1, JIT_PKT_TYPE_DOWNLINK_CLASS_B, DR_LORA_SF7, 12, false, &err);
+    nb_err += (err != JIT_ERROR_OK) ? 1 : 0;
+
+    printf("boundaries: %u steps, %u mismatches\n", (unsigned)ARRAY_SIZE(step) + 7, nb_err);
+
+    return nb_err;
+}
+
+/* random operations, the timestamps being packed to collide often */
+static unsigned check_random(unsigned nb_ops) {
+    static const enum jit_pkt_type_e types[] = {
+        JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_PKT_TYPE_DOWNLINK_CLASS_A, JIT_PKT_TYPE_DOWNLINK_CLASS_B,
+        JIT_PKT_TYPE_DOWNLINK_CLASS_C, JIT_PKT_TYPE_BEACON
+    };
+    enum jit_pkt_type_e pkt_type;
+    uint64_t count_us;
+    uint8_t sf;
+    uint16_t size;
+    unsigned nb_err = 0;
+    unsigned i;
+    int r;
+
+    reset();
+    for (i = 0; (i < nb_ops) && (nb_err == 0); i++) {
+        r = rand() % 20;
+        if (r < 10) {
+            pkt_type = types[rand() % ARRAY_SIZE(types)];
+            sf = DR_LORA_SF7 + (rand() % 6);
+            size = 1 + (rand() % 64);
+            switch (rand() % 8) {
+                case 0: count_us = time_us + (rand() % 50000); break;                       /* around TOO_LATE */
+                case 1: count_us = time_us + 511900000 + (rand() % 200000); break;          /* around TOO_EARLY */
+                case 2: case 3: count_us = edge_of(pkt_type, sf, size); break;
+                default: count_us = time_us + 40000 + (uint64_t)(rand() % 8000) * 1000; break;
+            }
+            nb_err += enqueue(count_us, pkt_type, sf, size, (rand() % 4) == 0, NULL);
+        } else if (r < 15) {
+            nb_err += peek();
+        } else if (r < 17) {
+            nb_err += dequeue_at((ref.num_pkt > 0) ? (rand() % ref.num_pkt) : 0);
+        } else if (r < 19) {
+            time_us += rand() % TX_JIT_DELAY;
+        } else {
+            time_us += (uint64_t)(rand() % 3000) * 1000; /* the packets missed are dropped by the next peek */
+        }
+    }
+    printf("random: %u operations, %u mismatches, time %llu us\n", i, nb_err, (unsigned long long)time_us);
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i;
+    unsigned int arg_u;
+    unsigned nb_ops = NB_OPS_DEFAULT;
+    unsigned seed = 1;
+    unsigned nb_err = 0;
+
+    while ((i = getopt(argc, argv, "hn:s:")) != -1) {
+        switch (i) {
+            case 'h':
+                printf(" -n <uint>  Number of random operations, default %u\n", NB_OPS_DEFAULT);
+                printf(" -s <uint>  Seed of the random operations, default 1\n");
+                return -1;
+            case 'n':
+            case 's':
+                if (sscanf(optarg, "%u", &arg_u) != 1) {
+                    printf("ERROR: argument parsing of -%c argument\n", i);
+                    return EXIT_FAILURE;
+                }
+                if (i == 'n') {
+                    nb_ops = arg_u;
+                } else {
+                    seed = arg_u;
+                }
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+    srand(seed);
+
+    printf("### JiT queue check against the reference model ###\n");
+
+    nb_err += check_boundaries();
+    nb_err += check_random(nb_ops);
+    printf("check: %u mismatches\n", nb_err);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
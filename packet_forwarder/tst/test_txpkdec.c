@@ -0,0 +1,406 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Check the single-pass txpk decoder against parson, which the packet
+    forwarder used before: valid, malformed, duplicate name, escaped string,
+    nested and truncated PULL_RESP payloads must give the same result and
+    the same txpk values. The numbers refused by the JSON grammar but taken
+    by parson are checked apart.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, snprintf, sscanf */
+#include <stdlib.h>     /* EXIT_FAILURE */
+#include <string.h>     /* memcmp, strcmp, strlen */
+
+#include "loragw_hal.h"
+#include "txpkdec.h"
+#include "parson.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define JSON_SIZE_MAX       1000    /* DOWN_BUFF_SIZE of the packet forwarder */
+#define NESTING_MIN         15      /* nesting depths tried around the parson limit */
+#define NESTING_MAX         25
+
+static const char * const valid_json[] = {
+    "{\"txpk\":{\"imme\":true,\"freq\":868.1,\"rfch\":0,\"powe\":14,\"modu\":\"LORA\",\"datr\":\"SF7BW125\",\"codr\":\"4/5\",\"ipol\":true,\"size\":4,\"data\":\"AQIDBA==\"}}",
+    "{\"txpk\":{\"imme\":false,\"tmst\":3512348611,\"freq\":869.525,\"rfch\":1,\"powe\":27,\"modu\":\"LORA\",\"datr\":\"SF12BW500\",\"codr\":\"4/8\",\"ipol\":false,\"prea\":12,\"size\":3,\"data\":\"AQID\",\"ncrc\":true,\"nhdr\":false}}",
+    "{\"txpk\":{\"tmms\":1234567890123,\"freq\":868.8,\"rfch\":0,\"powe\":14,\"modu\":\"FSK\",\"datr\":50000,\"fdev\":25000,\"size\":2,\"data\":\"AQI=\",\"prea\":70000}}",
+    "/* c */ {\"foo\":[1,{\"a\":null,\"b\":[true,false,\"x\"]}],\"txpk\":{\"data\":\"AQID\",\"size\":3,\"prea\":-4,\"codr\":\"2/3\",\"datr\":\"SF9BW250\",\"modu\":\"LORA\",\"rfch\":0,\"freq\":868.3,\"imme\":true, \"x\":\"\\u00e9\"} // end\n}",
+    "{\v\"txpk\"\f:{\"imme\":true,\"freq\":8.68e2,\"size\":0,\"data\":\"\"}  \r\n}",
+    "{\"txpk\":{\"imme\":true}} trailing text",
+    "{\"txpk\":{\"imme\":true}}}",
+    "{\"txpk\":{\"imme\":true}} /* unterminated",
+    "{\"txpk\":{\"imme\":true}//}",
+    "{\"txpk\":{\"size\":1 /* ,\"imme\":true}}",
+    "{\"txpk\":{}}",
+    "{\"txpk\":{\"freq\":-0,\"tmst\":0,\"powe\":-1.5E1,\"size\":1e2,\"rfch\":0.0}}",
+    "{\"a\":{\"b\":1},\"b\":{\"a\":2,\"b\":{\"b\":3}},\"txpk\":{\"size\":1,\"a\":{\"size\":2}},\"c\":[{\"a\":1},{\"a\":1}]}",
+    "{\"nope\":1}",
+    "{\"txpk\":[1]}",
+    "{\"txpk\":\"x\"}",
+    "[{\"txpk\":{\"imme\":true}}]",
+    "{\"txpk\":{\"freq\":\"868.1\"}}",
+    "{\"txpk\":{\"imme\":1}}",
+    "{\"txpk\":{\"data\":4}}",
+    "{\"txpk\":{\"size\":null}}",
+    "{\"txpk\":{\"datr\":true}}",
+    "{\"txpk\":{\"modu\":\"GFSK\"}}",
+    "{\"txpk\":{\"modu\":\"LORA\",\"datr\":\"SF7\"}}",
+    "{\"txpk\":{\"modu\":\"LORA\",\"datr\":\"SF13BW125\"}}",
+    "{\"txpk\":{\"modu\":\"LORA\",\"datr\":\"SF7BW200\"}}",
+    "{\"txpk\":{\"modu\":\"LORA\",\"codr\":\"4/9\"}}",
+    "{\"txpk\":{\"modu\":\"FSK\",\"datr\":\"SF7BW125\"}}"
+};
+
+static const char * const malformed_json[] = {
+    "",
+    "   ",
+    "txpk",
+    "{",
+    "{,}",
+    "{\"txpk\":{\"imme\":true,}}",
+    "{\"txpk\" {\"imme\":true}}",
+    "{\"txpk\":{\"imme\":true \"size\":1}}",
+    "{\"txpk\":{\"imme\":tru}}",
+    "{\"txpk\":{\"imme\":true}",
+    "{\"txpk\":{\"freq\":01}}",
+    "{\"txpk\":{\"freq\":0x10}}",
+    "{\"txpk\":{\"freq\":0e1}}",
+    "{\"txpk\":{\"freq\":-0e1}}",
+    "{\"txpk\":{\"freq\":+1}}",
+    "{\"txpk\":{\"freq\":inf}}",
+    "{\"txpk\":{\"freq\":nan}}",
+    "{\"txpk\":{\"size\":1.5.3}}",
+    "{\"txpk\":{\"size\":1e}}",
+    "{\"txpk\":{\"size\":-}}",
+    "{\"txpk\":{\"data\":\"AQ==}}",
+    "{\"txpk\":{\"data\":\"A\tQ==\"}}",
+    "{\"txpk\":{\"x\":[1,2}}",
+    "{\"txpk\":{\"x\":nul}}",
+    "[1,2"
+};
+
+static const char * const duplicate_json[] = {
+    "{\"txpk\":{\"size\":1,\"size\":2}}",
+    "{\"txpk\":{\"x\":1,\"x\":2}}",
+    "{\"a\":1,\"a\":2,\"txpk\":{}}",
+    "{\"txpk\":{},\"txpk\":{}}",
+    "{\"txpk\":1,\"txpk\":{\"size\":1}}",
+    "{\"txpk\":{\"size\":1},\"txpk\":1}",
+    "{\"txpk\":{\"a\":{\"b\":1,\"b\":2}}}",
+    "{\"a\":[{\"b\":1,\"c\":{},\"b\":2}],\"txpk\":{}}",
+    "{\"txpk\":{\"imme\":true,\"im\\u006de\":false}}",
+    "{\"txpk\":{\"size\":1,\"size\\u0000x\":2}}",
+    "{\"a\\u0000b\":1,\"a\":2,\"txpk\":{}}",
+    "{\"txpk\\u0000\":{\"size\":1},\"txpk\":{}}"
+};
+
+static const char * const escaped_json[] = {
+    "{\"txpk\":{\"size\":3,\"data\":\"A\\u0051ID\"}}",
+    "{\"txpk\":{\"data\":\"AQ\\/D\"}}",
+    "{\"txpk\":{\"data\":\"\\u00e9\\u00E9\\u20ac\\ud83d\\ude00\\uDBFF\\uDFFF\\\"\\\\\\/\\b\\f\\n\\r\\t\"}}",
+    "{\"txpk\":{\"data\":\"\\u0001\\u007f\\u0080\\u07ff\\u0800\\uffff\"}}",
+    "{\"txpk\":{\"data\":\"\\ud83d\"}}",
+    "{\"txpk\":{\"data\":\"\\ud83dx\"}}",
+    "{\"txpk\":{\"data\":\"\\ud83d\\u0041\"}}",
+    "{\"txpk\":{\"data\":\"\\ud83d\\ud83d\"}}",
+    "{\"txpk\":{\"data\":\"\\ude00\"}}",
+    "{\"txpk\":{\"data\":\"\\ude00\\ud83d\"}}",
+    "{\"txpk\":{\"data\":\"\\ud83d\\ude0\"}}",
+    "{\"txpk\":{\"data\":\"AQ\\u0000ID\",\"size\":2}}",
+    "{\"txpk\":{\"data\":\"\\u0000\"}}",
+    "{\"txpk\":{\"modu\":\"LORA\\u0000x\",\"datr\":\"SF7BW125\\u0000\",\"codr\":\"4/5\\u0000/6\"}}",
+    "{\"txpk\":{\"data\":\"\\u12\"}}",
+    "{\"txpk\":{\"data\":\"\\u12g4\"}}",
+    "{\"txpk\":{\"data\":\"\\x41\"}}",
+    "{\"txpk\":{\"data\":\"\\\"}}",
+    "{\"\\u0074xpk\":{\"imme\":true}}",
+    "{\"txpk\\u0000z\":{\"imme\":true}}",
+    "{\"t\\u0000xpk\":{\"imme\":true}}",
+    "{\"txpk\":{\"\\u0073ize\":7,\"x\\ud83d\\ude00\":\"\\ud83d\\ude00\"}}"
+};
+
+/* taken by parson, refused by the JSON grammar */
+static const char * const strict_json[] = {
+    "{\"txpk\":{\"freq\":-inf}}",
+    "{\"txpk\":{\"freq\":-nan}}",
+    "{\"txpk\":{\"freq\":1.}}",
+    "{\"txpk\":{\"freq\":-.5}}",
+    "{\"txpk\":{\"freq\":1e999}}",
+    "{\"txpk\":{\"freq\":-1e999}}"
+};
+
+static const struct {
+    const char * name;
+    uint8_t coderate;
+} codr_map[] = {
+    { "4/5", CR_LORA_4_5 }, { "4/6", CR_LORA_4_6 }, { "2/3", CR_LORA_4_6 },
+    { "4/7", CR_LORA_4_7 }, { "4/8", CR_LORA_4_8 }, { "1/2", CR_LORA_4_8 }
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* parson type expected for a key, JSONError for the datarate which has two */
+static JSON_Value_Type key_type(enum txpk_key_e key) {
+    switch (key) {
+        case TXPK_IMME:
+        case TXPK_IPOL:
+        case TXPK_NCRC:
+        case TXPK_NHDR:
+            return JSONBoolean;
+        case TXPK_MODU:
+        case TXPK_CODR:
+        case TXPK_DATA:
+            return JSONString;
+        case TXPK_DATR:
+            return JSONError;
+        default:
+            return JSONNumber;
+    }
+}
+
+static uint8_t bandwidth_of(short bw) {
+    switch (bw) {
+        case 125: return BW_125KHZ;
+        case 250: return BW_250KHZ;
+        case 500: return BW_500KHZ;
+        default: return BW_UNDEFINED;
+    }
+}
+
+/* the txpk values decoded must be the ones read from parson, counts the mismatches */
+static unsigned check_values(const JSON_Object * txpk, const struct lgw_pkt_tx_s * pkt, const struct txpk_dec_s * dec) {
+    const JSON_Value * val;
+    const char * str;
+    double x;
+    bool b;
+    short sf, bw;
+    unsigned nb_err = 0;
+    unsigned i;
+    int k;
+
+    for (k = 0; k < TXPK_KEY_NB; k++) {
+        val = json_object_get_value(txpk, txpk_key_name((enum txpk_key_e)k));
+        if ((val != NULL) != ((dec->found & TXPK_FOUND(k)) != 0)) {
+            printf("  \"%s\" found by one decoder only\n", txpk_key_name((enum txpk_key_e)k));
+            nb_err += 1;
+            continue;
+        }
+        if (val == NULL) {
+            continue;
+        }
+        x = json_value_get_number(val);
+        b = (json_value_get_boolean(val) == 1);
+        str = json_value_get_string(val);
+        switch (k) {
+            case TXPK_IMME: nb_err += (dec->imme != b); break;
+            case TXPK_TMST: nb_err += (pkt->count_us != (uint32_t)x); break;
+            case TXPK_TMMS: nb_err += (dec->tmms != (uint64_t)x); break;
+            case TXPK_FREQ: nb_err += (pkt->freq_hz != (uint32_t)((double)(1.0e6) * x)); break;
+            case TXPK_RFCH: nb_err += (pkt->rf_chain != (uint8_t)x); break;
+            case TXPK_POWE: nb_err += (pkt->rf_power != (int8_t)x); break;
+            case TXPK_FDEV: nb_err += (pkt->f_dev != (uint8_t)(x / 1000.0)); break;
+            case TXPK_IPOL: nb_err += (pkt->invert_pol != b); break;
+            case TXPK_PREA: nb_err += (pkt->preamble != ((x < 0.0) ? 0 : ((x > 65535.0) ? 65535 : (uint16_t)x))); break;
+            case TXPK_SIZE: nb_err += (pkt->size != (uint16_t)x); break;
+            case TXPK_NCRC: nb_err += (pkt->no_crc != b); break;
+            case TXPK_NHDR: nb_err += (pkt->no_header != b); break;
+            case TXPK_DATA:
+                nb_err += ((dec->data_len != (int)strlen(str)) || (memcmp(dec->data, str, dec->data_len) != 0));
+                break;
+            case TXPK_MODU:
+                nb_err += (pkt->modulation != ((strcmp(str, "LORA") == 0) ? MOD_LORA : MOD_FSK));
+                break;
+            case TXPK_DATR:
+                if (pkt->modulation == MOD_FSK) {
+                    nb_err += (pkt->datarate != (uint32_t)x);
+                } else if ((pkt->modulation == MOD_LORA) && (sscanf(str, "SF%2hdBW%3hd", &sf, &bw) == 2)) {
+                    nb_err += ((pkt->datarate != (uint32_t)sf) || (pkt->bandwidth != bandwidth_of(bw)));
+                }
+                break;
+            case TXPK_CODR:
+                for (i = 0; (i < ARRAY_SIZE(codr_map)) && (strcmp(str, codr_map[i].name) != 0); i++);
+                nb_err += ((pkt->modulation == MOD_LORA) && (i < ARRAY_SIZE(codr_map)) && (pkt->coderate != codr_map[i].coderate));
+                break;
+            default:
+                break;
+        }
+    }
+
+    return nb_err;
+}
+
+/* decode a payload with both decoders, 1 if they disagree */
+static unsigned check_json(const char * json, size_t len) {
+    static char work[JSON_SIZE_MAX + 1];
+    static char text[JSON_SIZE_MAX + 1];
+    struct lgw_pkt_tx_s pkt;
+    struct txpk_dec_s dec;
+    enum txpk_dec_e res;
+    JSON_Value * root;
+    JSON_Object * txpk;
+    const char * expected;
+    bool match;
+
+    /* the payload is NUL terminated by the packet forwarder, truncated ones included */
+    memcpy(text, json, len);
+    text[len] = '\0';
+    memcpy(work, text, len + 1);
+    res = txpk_decode(work, &pkt, &dec);
+
+    root = json_parse_string_with_comments(text);
+    txpk = json_object_get_object(json_value_get_object(root), "txpk");
+    if (root == NULL) {
+        expected = "a syntax error";
+        match = (res == TXPK_DEC_ERR_JSON);
+    } else if (txpk == NULL) {
+        expected = "no txpk";
+        match = (res == TXPK_DEC_ERR_NO_TXPK);
+    } else if (res == TXPK_DEC_ERR_TYPE) {
+        expected = "a txpk key of the right type";
+        match = (json_value_get_type(json_object_get_value(txpk, txpk_key_name(dec.key))) != key_type(dec.key));
+    } else {
+        expected = "the same txpk values";
+        match = (res != TXPK_DEC_ERR_JSON) && (res != TXPK_DEC_ERR_NO_TXPK);
+        if (match && (res == TXPK_DEC_OK)) {
+            match = (check_values(txpk, &pkt, &dec) == 0);
+        }
+    }
+    json_value_free(root);
+
+    if (!match) {
+        printf("MISMATCH: %s\n  txpk_decode returned %d, parson gave %s\n", text, res, expected);
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned check_set(const char * name, const char * const * json, unsigned nb) {
+    unsigned nb_err = 0;
+    unsigned i;
+
+    for (i = 0; i < nb; i++) {
+        nb_err += check_json(json[i], strlen(json[i]));
+    }
+    printf("%-12s %3u payloads, %u mismatches\n", name, nb, nb_err);
+
+    return nb_err;
+}
+
+/* every prefix of the valid payloads, as cut by a short datagram */
+static unsigned check_truncated(void) {
+    unsigned nb_err = 0;
+    unsigned nb = 0;
+    unsigned i;
+    size_t len;
+
+    for (i = 0; i < ARRAY_SIZE(valid_json); i++) {
+        for (len = 0; len < strlen(valid_json[i]); len++) {
+            nb_err += check_json(valid_json[i], len);
+            nb += 1;
+        }
+    }
+    printf("%-12s %3u payloads, %u mismatches\n", "truncated", nb, nb_err);
+
+    return nb_err;
+}
+
+/* arrays and objects nested around the parson limit, before and inside the txpk object */
+static unsigned check_nesting(void) {
+    char json[JSON_SIZE_MAX];
+    unsigned nb_err = 0;
+    unsigned nb = 0;
+    int n, i, len;
+    int form;
+
+    for (n = NESTING_MIN; n <= NESTING_MAX; n++) {
+        for (form = 0; form < 4; form++) {
+            len = snprintf(json, sizeof json, (form < 2) ? "{\"a\":" : "{\"txpk\":{\"size\":1,\"a\":");
+            for (i = 0; i < n; i++) {
+                len += snprintf(json + len, sizeof json - len, ((form % 2) == 0) ? "[" : "{\"b\":");
+            }
+            len += snprintf(json + len, sizeof json - len, ((form % 2) == 0) ? "0" : "1");
+            for (i = 0; i < n; i++) {
+                len += snprintf(json + len, sizeof json - len, ((form % 2) == 0) ? "]" : "}");
+            }
+            len += snprintf(json + len, sizeof json - len, (form < 2) ? ",\"txpk\":{}}" : "}}");
+            nb_err += check_json(json, len);
+            nb += 1;
+        }
+    }
+    printf("%-12s %3u payloads, %u mismatches\n", "nested", nb, nb_err);
+
+    return nb_err;
+}
+
+/* the numbers out of the JSON grammar are refused, though parson takes them */
+static unsigned check_strict(void) {
+    char work[JSON_SIZE_MAX + 1];
+    struct lgw_pkt_tx_s pkt;
+    struct txpk_dec_s dec;
+    JSON_Value * root;
+    unsigned nb_err = 0;
+    unsigned i;
+
+    for (i = 0; i < ARRAY_SIZE(strict_json); i++) {
+        snprintf(work, sizeof work, "%s", strict_json[i]);
+        root = json_parse_string_with_comments(strict_json[i]);
+        if ((root == NULL) || (txpk_decode(work, &pkt, &dec) != TXPK_DEC_ERR_JSON)) {
+            printf("MISMATCH: %s\n  expected to be taken by parson only\n", strict_json[i]);
+            nb_err += 1;
+        }
+        json_value_free(root);
+    }
+    printf("%-12s %3u payloads, %u mismatches\n", "strict", (unsigned)ARRAY_SIZE(strict_json), nb_err);
+
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void) {
+    unsigned nb_err = 0;
+
+    printf("### txpk decoder check against parson ###\n");
+
+    nb_err += check_set("valid", valid_json, ARRAY_SIZE(valid_json));
+    nb_err += check_set("malformed", malformed_json, ARRAY_SIZE(malformed_json));
+    nb_err += check_set("duplicate", duplicate_json, ARRAY_SIZE(duplicate_json));
+    nb_err += check_set("escaped", escaped_json, ARRAY_SIZE(escaped_json));
+    nb_err += check_truncated();
+    nb_err += check_nesting();
+    nb_err += check_strict();
+    printf("check: %u mismatches\n", nb_err);
+
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
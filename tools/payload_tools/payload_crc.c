@@ -1,13 +1,26 @@
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
+#include <unistd.h>     /* getopt */
+#include <time.h>       /* clock_gettime */
+
+#include "crc16.h"
+#include "payload_io.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- SUBFUNCTIONS DECLARATION --------------------------------------------- */
 
 static void usage(void);
-uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size);
+static int batch(const char * path, bool binary, bool quiet);
 void remove_spaces(char *str);
 
 /* -------------------------------------------------------------------------- */
@@ -26,6 +39,36 @@ int main(int argc, char ** argv)
         return -1;
     }
 
+    /* Batch mode */
+    if (argv[1][0] == '-') {
+        const char * path = NULL;
+        bool binary = false;
+        bool quiet = false;
+        int i;
+
+        while ((i = getopt(argc, argv, "bf:hq")) != -1) {
+            switch (i) {
+                case 'b':
+                    binary = true;
+                    break;
+                case 'f':
+                    path = optarg;
+                    break;
+                case 'q':
+                    quiet = true;
+                    break;
+                default:
+                    usage();
+                    return -1;
+            }
+        }
+        if (path == NULL) {
+            usage();
+            return -1;
+        }
+        return batch(path, binary, quiet);
+    }
+
     /* Get payload hex string from command line */
     memcpy(hexstr, argv[1], strlen(argv[1]));
     hexstr[strlen(argv[1])] = '\0';
@@ -43,7 +86,7 @@ int main(int argc, char ** argv)
     }
 
     /* Compute CRC */
-    crc = sx1302_lora_payload_crc(payload, payload_size);
+    crc = crc16_lora(payload, payload_size);
     printf("Payload CRC_16: %04X\n", crc);
 
     return 0;
@@ -53,6 +96,68 @@ int main(int argc, char ** argv)
 
 void usage(void) {
     printf("Missing payload hex string\n");
+    printf("Usage: ./payload_crc <payload hex string>\n");
+    printf("       ./payload_crc -f <file> [-b] [-q]\n");
+    printf("       -f: file of payloads, \"-\" for stdin, one per line as \"<payload>[,<expected CRC>]\"\n");
+    printf("       -b: binary file, records of one size byte followed by the payload\n");
+    printf("       -q: only print the CRC mismatches and the statistics\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int batch(const char * path, bool binary, bool quiet) {
+    struct payload_reader_s r;
+    struct timespec start, end;
+    uint8_t payload[PAYLOAD_SIZE_MAX];
+    uint8_t expected[PAYLOAD_SIZE_MAX];
+    uint16_t crc, crc_exp;
+    int size, x;
+    unsigned long nb_payload = 0, nb_bytes = 0, nb_checked = 0, nb_failed = 0, nb_invalid = 0;
+    double duration;
+
+    if (payload_open(&r, path, binary) != 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (payload_next_record(&r) == 0) {
+        size = payload_read(&r, payload);
+        if (size < 0) {
+            printf("line %lu: invalid payload\n", r.line);
+            nb_invalid += 1;
+            continue;
+        }
+        crc = crc16_lora(payload, size);
+        nb_payload += 1;
+        nb_bytes += size;
+
+        /* optional expected CRC, hex lines only */
+        x = binary ? PAYLOAD_ERR_FIELD : payload_read(&r, expected);
+        if (x == 2) {
+            crc_exp = (uint16_t)((expected[0] << 8) | expected[1]);
+            nb_checked += 1;
+            if (crc != crc_exp) {
+                printf("line %lu: CRC mismatch (got:0x%04X calc:0x%04X)\n", r.line, crc_exp, crc);
+                nb_failed += 1;
+                continue;
+            }
+        } else if (x != PAYLOAD_ERR_FIELD) {
+            printf("line %lu: invalid expected CRC\n", r.line);
+            nb_invalid += 1;
+            continue;
+        }
+        if (quiet == false) {
+            printf("%04X\n", crc);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    payload_close(&r);
+
+    duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1E9;
+    printf("### %lu payloads (%lu bytes) in %.3f s, %lu CRC checked: %lu OK, %lu failed, %lu invalid lines\n",
+            nb_payload, nb_bytes, duration, nb_checked, nb_checked - nb_failed, nb_failed, nb_invalid);
+
+    return ((nb_failed > 0) || (nb_invalid > 0)) ? 1 : 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -71,40 +176,3 @@ void remove_spaces(char *str)
     }
     str[count] = '\0';
 }
-
-/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
-void lora_crc16(const char data, int *crc) {
-    int next = 0;
-    next  =  (((data>>0)&1) ^ ((*crc>>12)&1) ^ ((*crc>> 8)&1)                 )      ;
-    next += ((((data>>1)&1) ^ ((*crc>>13)&1) ^ ((*crc>> 9)&1)                 )<<1 ) ;
-    next += ((((data>>2)&1) ^ ((*crc>>14)&1) ^ ((*crc>>10)&1)                 )<<2 ) ;
-    next += ((((data>>3)&1) ^ ((*crc>>15)&1) ^ ((*crc>>11)&1)                 )<<3 ) ;
-    next += ((((data>>4)&1) ^ ((*crc>>12)&1)                                  )<<4 ) ;
-    next += ((((data>>5)&1) ^ ((*crc>>13)&1) ^ ((*crc>>12)&1) ^ ((*crc>> 8)&1))<<5 ) ;
-    next += ((((data>>6)&1) ^ ((*crc>>14)&1) ^ ((*crc>>13)&1) ^ ((*crc>> 9)&1))<<6 ) ;
-    next += ((((data>>7)&1) ^ ((*crc>>15)&1) ^ ((*crc>>14)&1) ^ ((*crc>>10)&1))<<7 ) ;
-    next += ((((*crc>>0)&1) ^ ((*crc>>15)&1) ^ ((*crc>>11)&1)                 )<<8 ) ;
-    next += ((((*crc>>1)&1) ^ ((*crc>>12)&1)                                  )<<9 ) ;
-    next += ((((*crc>>2)&1) ^ ((*crc>>13)&1)                                  )<<10) ;
-    next += ((((*crc>>3)&1) ^ ((*crc>>14)&1)                                  )<<11) ;
-    next += ((((*crc>>4)&1) ^ ((*crc>>15)&1) ^ ((*crc>>12)&1) ^ ((*crc>> 8)&1))<<12) ;
-    next += ((((*crc>>5)&1) ^ ((*crc>>13)&1) ^ ((*crc>> 9)&1)                 )<<13) ;
-    next += ((((*crc>>6)&1) ^ ((*crc>>14)&1) ^ ((*crc>>10)&1)                 )<<14) ;
-    next += ((((*crc>>7)&1) ^ ((*crc>>15)&1) ^ ((*crc>>11)&1)                 )<<15) ;
-    (*crc) = next;
-}
-
-/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
-uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size) {
-    int i;
-    int crc = 0;
-
-    for (i = 0; i < size; i++) {
-        lora_crc16(data[i], &crc);
-    }
-
-    //printf("CRC16: 0x%02X 0x%02X (%X)\n", (uint8_t)(crc >> 8), (uint8_t)crc, crc);
-    return (uint16_t)crc;
-}
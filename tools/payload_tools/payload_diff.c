@@ -1,7 +1,19 @@
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
+#include <unistd.h>     /* getopt */
+#include <time.h>       /* clock_gettime */
+
+#include "payload_io.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- MACROS --------------------------------------------------------------- */
@@ -12,6 +24,7 @@
 /* --- SUBFUNCTIONS DECLARATION --------------------------------------------- */
 
 static void usage(void);
+static int batch(const char * path, bool binary, bool quiet);
 void remove_spaces(char *str);
 
 /* -------------------------------------------------------------------------- */
@@ -27,6 +40,35 @@ int main(int argc, char ** argv)
     char hexstr[1024];
     uint16_t nb_bits_diff = 0;
 
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        /* Batch mode */
+        const char * path = NULL;
+        bool binary = false;
+        bool quiet = false;
+
+        while ((i = getopt(argc, argv, "bf:hq")) != -1) {
+            switch (i) {
+                case 'b':
+                    binary = true;
+                    break;
+                case 'f':
+                    path = optarg;
+                    break;
+                case 'q':
+                    quiet = true;
+                    break;
+                default:
+                    usage();
+                    return -1;
+            }
+        }
+        if (path == NULL) {
+            usage();
+            return -1;
+        }
+        return batch(path, binary, quiet);
+    }
+
     if (argc < 3) {
         usage();
         return -1;
@@ -95,6 +137,70 @@ int main(int argc, char ** argv)
 
 void usage(void) {
     printf("Missing payload hex strings for a & b\n");
+    printf("Usage: ./payload_diff <payload a hex string> <payload b hex string>\n");
+    printf("       ./payload_diff -f <file> [-b] [-q]\n");
+    printf("       -f: file of payload pairs, \"-\" for stdin, one per line as \"<payload a>,<payload b>\"\n");
+    printf("       -b: binary file, records of one size byte followed by the payload, a & b consecutive\n");
+    printf("       -q: only print the pairs which differ and the statistics\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int batch(const char * path, bool binary, bool quiet) {
+    struct payload_reader_s r;
+    struct timespec start, end;
+    uint8_t payload_a[PAYLOAD_SIZE_MAX];
+    uint8_t payload_b[PAYLOAD_SIZE_MAX];
+    int size_a, size_b;
+    unsigned nb_bits;
+    unsigned nb_bits_max = 0;
+    unsigned long nb_pair = 0, nb_diff = 0, nb_size = 0, nb_invalid = 0;
+    unsigned long long nb_bits_cmp = 0, nb_bits_diff = 0;
+    double duration;
+
+    if (payload_open(&r, path, binary) != 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (payload_next_record(&r) == 0) {
+        size_a = payload_read(&r, payload_a);
+        size_b = (size_a >= 0) ? payload_read(&r, payload_b) : size_a;
+        if ((size_a < 0) || (size_b < 0)) {
+            printf("line %lu: invalid payload pair\n", r.line);
+            nb_invalid += 1;
+            continue;
+        }
+        nb_pair += 1;
+        if (size_a != size_b) {
+            printf("line %lu: size mismatch (%d / %d bytes)\n", r.line, size_a, size_b);
+            nb_size += 1;
+            continue;
+        }
+
+        nb_bits = payload_bit_diff(payload_a, payload_b, size_a);
+        nb_bits_cmp += 8 * size_a;
+        nb_bits_diff += nb_bits;
+        if (nb_bits > 0) {
+            nb_diff += 1;
+            if (nb_bits > nb_bits_max) {
+                nb_bits_max = nb_bits;
+            }
+        }
+        if ((quiet == false) || (nb_bits > 0)) {
+            printf("line %lu: %u bits flipped\n", r.line, nb_bits);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    payload_close(&r);
+
+    duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1E9;
+    printf("### %lu pairs in %.3f s: %lu identical, %lu different, %lu size mismatch, %lu invalid lines\n",
+            nb_pair, duration, nb_pair - nb_diff - nb_size, nb_diff, nb_size, nb_invalid);
+    printf("### %llu bits flipped out of %llu (BER %.3e), %u at most in a pair\n",
+            nb_bits_diff, nb_bits_cmp, (nb_bits_cmp > 0) ? (double)nb_bits_diff / nb_bits_cmp : 0.0, nb_bits_max);
+
+    return ((nb_diff > 0) || (nb_size > 0) || (nb_invalid > 0)) ? 1 : 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -1,14 +1,28 @@
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
+#include <unistd.h>     /* getopt */
+#include <time.h>       /* clock_gettime */
 
 #include "tinymt32.h"
+#include "payload_io.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- SUBFUNCTIONS DECLARATION --------------------------------------------- */
 
 static void usage(void);
+static void generate(const uint8_t * dev_id, unsigned int packet_cnt, uint8_t payload_size, uint8_t * payload);
+static int batch_gen(const uint8_t * dev_id, unsigned int packet_cnt, uint8_t payload_size, unsigned long nb, bool binary);
+static int batch_check(const char * path, bool binary, bool quiet);
 void remove_spaces(char *str);
 
 /* -------------------------------------------------------------------------- */
@@ -21,9 +35,62 @@ int main(int argc, char ** argv)
     uint8_t payload[255];
     uint8_t payload_size;
     unsigned int packet_cnt;
-    tinymt32_t tinymt;
     char hexstr[32];
 
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        /* Batch mode */
+        const char * path = NULL;
+        bool binary = false;
+        bool quiet = false;
+        bool dev_id_set = false;
+        unsigned long nb = 1;
+        int i;
+
+        packet_cnt = 0;
+        payload_size = 16;
+        while ((i = getopt(argc, argv, "bc:d:f:hn:qs:")) != -1) {
+            switch (i) {
+                case 'b':
+                    binary = true;
+                    break;
+                case 'c':
+                    packet_cnt = strtoul(optarg, NULL, 0);
+                    break;
+                case 'd':
+                    if (payload_from_hex(optarg, strlen(optarg), payload) != 4) {
+                        printf("ERROR: dev_id must be a 4-byte hex string\n");
+                        return -1;
+                    }
+                    memcpy(dev_id, payload, 4);
+                    dev_id_set = true;
+                    break;
+                case 'f':
+                    path = optarg;
+                    break;
+                case 'n':
+                    nb = strtoul(optarg, NULL, 0);
+                    break;
+                case 'q':
+                    quiet = true;
+                    break;
+                case 's':
+                    payload_size = (uint8_t)atoi(optarg);
+                    break;
+                default:
+                    usage();
+                    return -1;
+            }
+        }
+        if (path != NULL) {
+            return batch_check(path, binary, quiet);
+        }
+        if (dev_id_set == false) {
+            usage();
+            return -1;
+        }
+        return batch_gen(dev_id, packet_cnt, payload_size, nb, binary);
+    }
+
     if (argc < 4) {
         usage();
         return -1;
@@ -50,24 +117,8 @@ int main(int argc, char ** argv)
     /* Get packet payload size */
     payload_size = (uint8_t)atoi(argv[3]);
 
-    /* Initialize the pseudo-random generator */
-    tinymt.mat1 = 0x8f7011ee;
-    tinymt.mat2 = 0xfc78ff1f;
-    tinymt.tmat = 0x3793fdff;
-    tinymt32_init(&tinymt, packet_cnt);
-
     /* Construct packet */
-    payload[0] = dev_id[0];
-    payload[1] = dev_id[1];
-    payload[2] = dev_id[2];
-    payload[3] = dev_id[3];
-    payload[4] = (uint8_t)(packet_cnt >> 24);
-    payload[5] = (uint8_t)(packet_cnt >> 16);
-    payload[6] = (uint8_t)(packet_cnt >> 8);
-    payload[7] = (uint8_t)(packet_cnt >> 0);
-    for (j = 8; j < payload_size; j++) {
-        payload[j] = (uint8_t)tinymt32_generate_uint32(&tinymt);
-    }
+    generate(dev_id, packet_cnt, payload_size, payload);
     for (j = 0; j < payload_size; j++) {
         printf("%02X ", payload[j]);
     }
@@ -104,6 +155,122 @@ void usage(void) {
     printf("       dev_id: hex string for 4-bytes dev_id\n");
     printf("       pkt_cnt: unsigned int used to initialize the pseudo-random generator\n");
     printf("       pkt_size: paylaod size in bytes [0..255]\n");
+    printf("Batch: ./payload_gen -d <dev_id> [-c <pkt_cnt>] [-s <pkt_size>] [-n <nb>] [-b]\n");
+    printf("       generate nb payloads from pkt_cnt, one hex string per line, or binary records with -b\n");
+    printf("       ./payload_gen -f <file> [-b] [-q]\n");
+    printf("       check a file of received payloads, \"-\" for stdin, one per line, or binary records with -b,\n");
+    printf("       against the payloads regenerated from their dev_id and pkt_cnt,\n");
+    printf("       -q to only print the payloads which differ and the statistics\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void generate(const uint8_t * dev_id, unsigned int packet_cnt, uint8_t payload_size, uint8_t * payload) {
+    tinymt32_t tinymt;
+    int j;
+
+    /* Initialize the pseudo-random generator */
+    tinymt.mat1 = 0x8f7011ee;
+    tinymt.mat2 = 0xfc78ff1f;
+    tinymt.tmat = 0x3793fdff;
+    tinymt32_init(&tinymt, packet_cnt);
+
+    payload[0] = dev_id[0];
+    payload[1] = dev_id[1];
+    payload[2] = dev_id[2];
+    payload[3] = dev_id[3];
+    payload[4] = (uint8_t)(packet_cnt >> 24);
+    payload[5] = (uint8_t)(packet_cnt >> 16);
+    payload[6] = (uint8_t)(packet_cnt >> 8);
+    payload[7] = (uint8_t)(packet_cnt >> 0);
+    for (j = 8; j < payload_size; j++) {
+        payload[j] = (uint8_t)tinymt32_generate_uint32(&tinymt);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int batch_gen(const uint8_t * dev_id, unsigned int packet_cnt, uint8_t payload_size, unsigned long nb, bool binary) {
+    static const char hex[] = "0123456789ABCDEF";
+    uint8_t payload[PAYLOAD_SIZE_MAX];
+    char line[2 * PAYLOAD_SIZE_MAX + 2];
+    unsigned long i;
+    int j;
+
+    if (payload_size < 8) {
+        printf("ERROR: pkt_size must be at least 8 bytes for the dev_id and pkt_cnt\n");
+        return -1;
+    }
+
+    for (i = 0; i < nb; i++) {
+        generate(dev_id, packet_cnt + i, payload_size, payload);
+        if (binary == true) {
+            putchar(payload_size);
+            fwrite(payload, 1, payload_size, stdout);
+        } else {
+            for (j = 0; j < payload_size; j++) {
+                line[2 * j] = hex[payload[j] >> 4];
+                line[2 * j + 1] = hex[payload[j] & 0x0F];
+            }
+            line[2 * j] = '\n';
+            fwrite(line, 1, 2 * j + 1, stdout);
+        }
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int batch_check(const char * path, bool binary, bool quiet) {
+    struct payload_reader_s r;
+    struct timespec start, end;
+    uint8_t payload[PAYLOAD_SIZE_MAX];
+    uint8_t reference[PAYLOAD_SIZE_MAX];
+    unsigned int packet_cnt;
+    unsigned nb_bits;
+    int size;
+    unsigned long nb_payload = 0, nb_diff = 0, nb_invalid = 0;
+    unsigned long long nb_bits_cmp = 0, nb_bits_diff = 0;
+    double duration;
+
+    if (payload_open(&r, path, binary) != 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (payload_next_record(&r) == 0) {
+        size = payload_read(&r, payload);
+        if (size < 8) {
+            printf("line %lu: invalid payload\n", r.line);
+            nb_invalid += 1;
+            continue;
+        }
+        nb_payload += 1;
+
+        /* the dev_id and pkt_cnt are taken as received, only the random part is checked */
+        packet_cnt = ((unsigned int)payload[4] << 24) | (payload[5] << 16) | (payload[6] << 8) | payload[7];
+        generate(payload, packet_cnt, size, reference);
+        nb_bits = payload_bit_diff(payload + 8, reference + 8, size - 8);
+        nb_bits_cmp += 8 * (size - 8);
+        nb_bits_diff += nb_bits;
+        if (nb_bits > 0) {
+            nb_diff += 1;
+        }
+        if ((quiet == false) || (nb_bits > 0)) {
+            printf("line %lu: pkt_cnt %u, %u bits flipped\n", r.line, packet_cnt, nb_bits);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    payload_close(&r);
+
+    duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1E9;
+    printf("### %lu payloads in %.3f s: %lu OK, %lu different, %lu invalid lines\n",
+            nb_payload, duration, nb_payload - nb_diff, nb_diff, nb_invalid);
+    printf("### %llu bits flipped out of %llu (BER %.3e)\n",
+            nb_bits_diff, nb_bits_cmp, (nb_bits_cmp > 0) ? (double)nb_bits_diff / nb_bits_cmp : 0.0);
+
+    return ((nb_diff > 0) || (nb_invalid > 0)) ? 1 : 0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -0,0 +1,191 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Reader of the payload files processed by the batch mode of the payload
+    tools.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* fopen, fgets, fread */
+#include <string.h>     /* strcmp, strcspn, memcpy */
+
+#include "payload_io.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int hex_value(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    } else if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    } else if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    } else {
+        return -1;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int payload_open(struct payload_reader_s * r, const char * path, bool binary) {
+    memset(r, 0, sizeof *r);
+    r->binary = binary;
+    if (strcmp(path, "-") == 0) {
+        r->file = stdin;
+    } else {
+        r->file = fopen(path, binary ? "rb" : "r");
+        if (r->file == NULL) {
+            printf("ERROR: failed to open %s\n", path);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void payload_close(struct payload_reader_s * r) {
+    if ((r->file != NULL) && (r->file != stdin)) {
+        fclose(r->file);
+    }
+    r->file = NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int payload_next_record(struct payload_reader_s * r) {
+    int len, c;
+
+    if (r->binary == true) {
+        /* no record boundary, only check there is something left to read */
+        c = getc(r->file);
+        if (c == EOF) {
+            return PAYLOAD_EOF;
+        }
+        ungetc(c, r->file);
+        r->line += 1;
+        return 0;
+    }
+
+    while (fgets(r->buf, sizeof r->buf, r->file) != NULL) {
+        r->line += 1;
+        len = strlen(r->buf);
+        r->too_long = false;
+        if ((len > 0) && (r->buf[len - 1] != '\n') && !feof(r->file)) {
+            /* skip the rest of the line */
+            r->too_long = true;
+            while (((c = getc(r->file)) != EOF) && (c != '\n'));
+        }
+        /* remove the end of line */
+        while ((len > 0) && ((r->buf[len - 1] == '\n') || (r->buf[len - 1] == '\r'))) {
+            r->buf[--len] = '\0';
+        }
+        if ((len == 0) || (r->buf[0] == '#')) {
+            continue;
+        }
+        r->next = r->buf;
+        return 0;
+    }
+
+    return PAYLOAD_EOF;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int payload_read(struct payload_reader_s * r, uint8_t * payload) {
+    int c, len;
+    char * field;
+
+    if (r->binary == true) {
+        c = getc(r->file);
+        if (c == EOF) {
+            return PAYLOAD_EOF;
+        }
+        if (fread(payload, 1, c, r->file) != (size_t)c) {
+            return PAYLOAD_EOF;
+        }
+        return c;
+    }
+
+    if (r->too_long == true) {
+        return PAYLOAD_ERR_FORMAT;
+    }
+    if (r->next == NULL) {
+        return PAYLOAD_ERR_FIELD;
+    }
+    field = r->next;
+    len = strcspn(field, ",;\t");
+    r->next = (field[len] != '\0') ? &field[len + 1] : NULL;
+
+    return payload_from_hex(field, len, payload);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int payload_from_hex(const char * str, int len, uint8_t * payload) {
+    int i, hi, lo;
+    int size = 0;
+    int nibble = -1; /* high nibble of the byte being converted */
+
+    for (i = 0; i < len; i++) {
+        if (str[i] == ' ') {
+            continue;
+        }
+        lo = hex_value(str[i]);
+        if (lo < 0) {
+            return PAYLOAD_ERR_FORMAT;
+        }
+        if (nibble < 0) {
+            nibble = lo;
+        } else {
+            if (size >= PAYLOAD_SIZE_MAX) {
+                return PAYLOAD_ERR_FORMAT;
+            }
+            hi = nibble;
+            payload[size++] = (uint8_t)((hi << 4) | lo);
+            nibble = -1;
+        }
+    }
+    if (nibble >= 0) {
+        return PAYLOAD_ERR_FORMAT; /* odd number of digits */
+    }
+
+    return size;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+unsigned payload_bit_diff(const uint8_t * a, const uint8_t * b, int size) {
+    uint64_t wa, wb;
+    unsigned nb_bits = 0;
+    int i = 0;
+
+    for (; (i + 8) <= size; i += 8) {
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        nb_bits += __builtin_popcountll(wa ^ wb);
+    }
+    for (; i < size; i++) {
+        nb_bits += __builtin_popcount(a[i] ^ b[i]);
+    }
+
+    return nb_bits;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,107 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Reader of the payload files processed by the batch mode of the payload
+    tools.
+
+    Hex-lines file: one record per line, made of fields separated by ',', ';'
+    or tabs. Each field is an hex string, spaces are ignored. Empty lines and
+    lines starting with '#' are skipped.
+    Binary file: records of one size byte followed by the size bytes of the
+    payload, the fields of a record are consecutive payloads.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _PAYLOAD_IO_H
+#define _PAYLOAD_IO_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* FILE */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define PAYLOAD_SIZE_MAX    255
+#define PAYLOAD_LINE_SIZE   2048    /* longest hex line accepted */
+
+#define PAYLOAD_EOF         -1      /* end of the file */
+#define PAYLOAD_ERR_FORMAT  -2      /* invalid hex string, or payload too long */
+#define PAYLOAD_ERR_FIELD   -3      /* no more field in the hex line */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct payload_reader_s {
+    FILE * file;
+    bool binary;
+    unsigned long line;             /* current line of an hex file, record of a binary file */
+    char buf[PAYLOAD_LINE_SIZE];
+    char * next;                    /* next field of the current line, NULL at the end of the line */
+    bool too_long;                  /* current line longer than PAYLOAD_LINE_SIZE, only read as an error */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Open a payload file
+@param r reader to be initialized
+@param path path of the file, "-" for the standard input
+@param binary true for a binary file, false for an hex-lines file
+@return 0 if no error, -1 otherwise
+*/
+int payload_open(struct payload_reader_s * r, const char * path, bool binary);
+
+/**
+@brief Close a payload file, the standard input is left open
+@param r reader
+*/
+void payload_close(struct payload_reader_s * r);
+
+/**
+@brief Move to the next record, skipping the fields not read of the current one
+@param r reader
+@return 0 if a record is available, PAYLOAD_EOF at the end of the file
+*/
+int payload_next_record(struct payload_reader_s * r);
+
+/**
+@brief Read the next field of the current record
+@param r reader
+@param payload receives up to PAYLOAD_SIZE_MAX bytes
+@return size of the payload, PAYLOAD_EOF, PAYLOAD_ERR_FORMAT or PAYLOAD_ERR_FIELD
+*/
+int payload_read(struct payload_reader_s * r, uint8_t * payload);
+
+/**
+@brief Convert an hex string to bytes, spaces are ignored
+@param str hex string
+@param len number of characters of str
+@param payload receives up to PAYLOAD_SIZE_MAX bytes
+@return number of bytes, PAYLOAD_ERR_FORMAT if str is not valid or too long
+*/
+int payload_from_hex(const char * str, int len, uint8_t * payload);
+
+/**
+@brief Count the bits different between two buffers, compared 64 bits at a time
+@param a first buffer
+@param b second buffer
+@param size number of bytes compared
+@return number of bits flipped
+*/
+unsigned payload_bit_diff(const uint8_t * a, const uint8_t * b, int size);
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,123 @@
+/*
+  ______                              _
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Programming of the concentrator MCU flash through its USB DFU bootloader
+    (STM32 DfuSe protocol), over the Linux usbdevfs interface.
+
+    The DFU device is found from the USB port of the TTY of the concentrator,
+    the MCU re-enumerates on the same port when switched to boot mode and
+    when leaving it, so that several boards can be updated at the same time.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _USB_DFU_H
+#define _USB_DFU_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define USB_DFU_SUCCESS      0
+#define USB_DFU_ERROR       -1
+
+#define USB_DFU_VID             0x0483  /* STM32 system bootloader */
+#define USB_DFU_PID             0xDF11
+#define USB_DFU_PORT_SIZE       32      /* size of a USB port path, as "1-1.2" */
+#define USB_DFU_SECTOR_GRP_MAX  8       /* groups of sectors in the flash layout */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct usb_dfu_s
+@brief DFU device opened on the internal flash alternate setting
+*/
+struct usb_dfu_s {
+    int         fd;                         /*!> usbdevfs file descriptor */
+    uint8_t     interface;                  /*!> DFU interface number */
+    uint8_t     alt;                        /*!> alternate setting of the internal flash */
+    uint16_t    xfer_size;                  /*!> wTransferSize of the DFU functional descriptor */
+    uint32_t    flash_addr;                 /*!> start address of the internal flash */
+    uint8_t     sector_grp_nb;              /*!> groups of sectors of the same size */
+    uint32_t    sector_nb[USB_DFU_SECTOR_GRP_MAX];
+    uint32_t    sector_size[USB_DFU_SECTOR_GRP_MAX];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Get the USB port of a TTY, from sysfs
+@param tty_path path of the TTY, symbolic links are followed
+@param port receives the port path, as "1-1.2"
+@param size size of port
+@return USB_DFU_SUCCESS if no error, USB_DFU_ERROR otherwise
+*/
+int usb_dfu_tty_port(const char * tty_path, char * port, size_t size);
+
+/**
+@brief Get the TTY enumerated on a USB port, from sysfs
+@param port USB port path
+@param tty_path receives the TTY path, as "/dev/ttyACM0"
+@param size size of tty_path
+@return USB_DFU_SUCCESS if a TTY is found, USB_DFU_ERROR otherwise
+*/
+int usb_dfu_port_tty(const char * port, char * tty_path, size_t size);
+
+/**
+@brief Wait for the DFU device to enumerate on a USB port, and open it
+@param dfu DFU device to be initialized
+@param port USB port path
+@param timeout_ms time allowed for the enumeration
+@return USB_DFU_SUCCESS if no error, USB_DFU_ERROR otherwise
+*/
+int usb_dfu_open(struct usb_dfu_s * dfu, const char * port, unsigned timeout_ms);
+
+/**
+@brief Erase the flash sectors covered by an image and write it, in chunks of xfer_size bytes
+@param dfu DFU device
+@param image image to be written at the start of the internal flash
+@param size size of the image in bytes
+@return USB_DFU_SUCCESS if no error, USB_DFU_ERROR otherwise
+*/
+int usb_dfu_download(struct usb_dfu_s * dfu, const uint8_t * image, uint32_t size);
+
+/**
+@brief Read back the flash and compare its CRC with the one of the image
+@param dfu DFU device
+@param image image written by usb_dfu_download
+@param size size of the image in bytes
+@return USB_DFU_SUCCESS if the CRCs match, USB_DFU_ERROR otherwise
+*/
+int usb_dfu_verify(struct usb_dfu_s * dfu, const uint8_t * image, uint32_t size);
+
+/**
+@brief Leave the bootloader, the MCU starts the firmware from the start of the flash
+@param dfu DFU device, closed
+@return USB_DFU_SUCCESS if no error, USB_DFU_ERROR otherwise
+*/
+int usb_dfu_leave(struct usb_dfu_s * dfu);
+
+/**
+@brief Close a DFU device, without leaving the bootloader
+@param dfu DFU device
+*/
+void usb_dfu_close(struct usb_dfu_s * dfu);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
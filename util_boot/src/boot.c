@@ -8,7 +8,8 @@
   (C)2020 Semtech
 
 Description:
-    Utility to switch the concentrator MCU in DFU boot mode (USB gateway)
+    Utility to switch the concentrator MCU in DFU boot mode (USB gateway), and
+    to update its firmware
 
 License: Revised BSD License, see LICENSE.TXT file include in the project
 */
@@ -33,10 +34,16 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <math.h>
 #include <signal.h>     /* sigaction */
 #include <getopt.h>     /* getopt_long */
+#include <stdbool.h>
+#include <ctype.h>      /* isdigit */
+#include <time.h>       /* clock_gettime */
+#include <pthread.h>
 
 #include "loragw_usb.h"
 #include "loragw_mcu.h"
 #include "loragw_hal.h"
+#include "loragw_aux.h"
+#include "usb_dfu.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -48,9 +55,39 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define TTY_PATH_DEFAULT "/dev/ttyACM0"
 
+#define IMAGE_SIZE_MAX      (512 * 1024)
+#define DFU_ENUM_TIMEOUT_MS 10000   /* time allowed to the MCU to enumerate in DFU mode */
+#define TTY_ENUM_TIMEOUT_MS 10000   /* time allowed to the MCU to restart its firmware */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+typedef enum {
+    UPDATE_NONE,
+    UPDATE_DONE,
+    UPDATE_SKIPPED,     /* same version already running */
+    UPDATE_FAILED
+} update_result_t;
+
+struct board_update_s {
+    uint8_t index;                  /* board index, for the per-thread state of the HAL */
+    const char * tty_path;
+    char tty_path_new[64];          /* TTY enumerated after the update */
+    char tty_name[64];              /* short name, as a prefix of the messages */
+    update_result_t result;
+    char version[10];               /* version running at the end */
+    double duration_s;
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
+static uint8_t * image = NULL;
+static uint32_t image_size = 0;
+static char image_version[10] = ""; /* V00.00.00 found in the image, empty if not found */
+static bool update_force = false;
+static bool update_verify = true;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
 
@@ -59,7 +96,210 @@ void usage(void) {
     printf("Library version information: %s\n", lgw_version_info());
     printf("Available options:\n");
     printf(" -h print this help\n");
-    printf(" -d [path]  TTY path to be used to access the concentrator\n");
+    printf(" -d [path]  TTY path to be used to access the concentrator, up to %d to update several boards in parallel\n", LGW_BOARD_NB_MAX);
+    printf(" -u [path]  update the MCU with the firmware image, instead of only switching it in DFU mode\n");
+    printf(" -f         update even if the MCU already runs the version of the image\n");
+    printf(" -n         do not read back the flash to check its CRC after the update\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static double time_s(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1E9;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int image_load(const char * path) {
+    FILE * f;
+    uint32_t i;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("ERROR: failed to open %s\n", path);
+        return -1;
+    }
+    image = malloc(IMAGE_SIZE_MAX);
+    if (image == NULL) {
+        fclose(f);
+        return -1;
+    }
+    image_size = fread(image, 1, IMAGE_SIZE_MAX, f);
+    if (!feof(f) || (image_size == 0)) {
+        printf("ERROR: %s is empty or larger than %u bytes\n", path, IMAGE_SIZE_MAX);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    /* version string embedded in the firmware, as returned by the PING */
+    for (i = 0; (i + 9) <= image_size; i++) {
+        if ((image[i] == 'V') && (image[i + 3] == '.') && (image[i + 6] == '.') &&
+            isdigit(image[i + 1]) && isdigit(image[i + 2]) && isdigit(image[i + 4]) &&
+            isdigit(image[i + 5]) && isdigit(image[i + 7]) && isdigit(image[i + 8])) {
+            memcpy(image_version, &image[i], 9);
+            image_version[9] = '\0';
+            break;
+        }
+    }
+    printf("INFO: firmware image %s, %u bytes, version %s\n", path, image_size, (image_version[0] != '\0') ? image_version : "unknown");
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* open the TTY and get the running version, the first character (release/debug) is not compared */
+static void * board_connect(struct board_update_s * b, int * fd, bool * up_to_date) {
+    void * com_target = NULL;
+    s_ping_info info;
+
+    if (lgw_usb_open(b->tty_path, &com_target) != 0) {
+        printf("[%s] ERROR: failed to open USB on %s\n", b->tty_name, b->tty_path);
+        return NULL;
+    }
+    *fd = *(int *)com_target;
+    if (mcu_ping(*fd, &info) != 0) {
+        printf("[%s] ERROR: failed to ping the MCU\n", b->tty_name);
+        lgw_usb_close(com_target);
+        return NULL;
+    }
+    strcpy(b->version, info.version);
+    *up_to_date = (image_version[0] != '\0') && (strncmp(info.version + 1, image_version + 1, 8) == 0);
+
+    return com_target;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void * thread_update(void * arg) {
+    struct board_update_s * b = arg;
+    struct usb_dfu_s dfu;
+    char port[USB_DFU_PORT_SIZE];
+    void * com_target;
+    int fd, waited_ms;
+    bool up_to_date;
+    double start, t;
+
+    lgw_board_cur = b->index; /* the MCU protocol state of each board is kept per thread */
+    start = time_s();
+    b->result = UPDATE_FAILED;
+
+    com_target = board_connect(b, &fd, &up_to_date);
+    if (com_target == NULL) {
+        return NULL;
+    }
+    printf("[%s] INFO: MCU version %s\n", b->tty_name, b->version);
+    if (up_to_date && !update_force) {
+        printf("[%s] INFO: the MCU already runs the version of the image, skipped\n", b->tty_name);
+        lgw_usb_close(com_target);
+        b->result = UPDATE_SKIPPED;
+        b->duration_s = time_s() - start;
+        return NULL;
+    }
+
+    /* the bootloader enumerates on the USB port of the TTY */
+    if (usb_dfu_tty_port(b->tty_path, port, sizeof port) != USB_DFU_SUCCESS) {
+        lgw_usb_close(com_target);
+        return NULL;
+    }
+    if (mcu_boot(fd) != 0) {
+        printf("[%s] ERROR: failed to switch MCU in BOOT mode\n", b->tty_name);
+        lgw_usb_close(com_target);
+        return NULL;
+    }
+    close(fd); /* no lgw_usb_close(), the bootloader would not answer its requests */
+    free(com_target);
+
+    if (usb_dfu_open(&dfu, port, DFU_ENUM_TIMEOUT_MS) != USB_DFU_SUCCESS) {
+        return NULL;
+    }
+    printf("[%s] INFO: DFU device on USB port %s, flash at 0x%08X, %u-byte transfers\n", b->tty_name, port, dfu.flash_addr, dfu.xfer_size);
+    t = time_s();
+    if (usb_dfu_download(&dfu, image, image_size) != USB_DFU_SUCCESS) {
+        printf("[%s] ERROR: download failed, the MCU is left in DFU mode\n", b->tty_name);
+        usb_dfu_close(&dfu);
+        return NULL;
+    }
+    t = time_s() - t;
+    printf("[%s] INFO: %u bytes erased and written in %.2f s (%.1f kB/s)\n", b->tty_name, image_size, t, image_size / 1024.0 / t);
+    if (update_verify && (usb_dfu_verify(&dfu, image, image_size) != USB_DFU_SUCCESS)) {
+        printf("[%s] ERROR: verification failed, the MCU is left in DFU mode\n", b->tty_name);
+        usb_dfu_close(&dfu);
+        return NULL;
+    }
+    if (usb_dfu_leave(&dfu) != USB_DFU_SUCCESS) {
+        return NULL;
+    }
+
+    /* the firmware enumerates again on the same port, maybe under another TTY name */
+    for (waited_ms = 0; waited_ms < TTY_ENUM_TIMEOUT_MS; waited_ms += 200) {
+        wait_ms(200);
+        if ((usb_dfu_port_tty(port, b->tty_path_new, sizeof b->tty_path_new) == USB_DFU_SUCCESS) && (access(b->tty_path_new, R_OK | W_OK) == 0)) {
+            break;
+        }
+    }
+    if (waited_ms >= TTY_ENUM_TIMEOUT_MS) {
+        printf("[%s] ERROR: no TTY on USB port %s after the update\n", b->tty_name, port);
+        return NULL;
+    }
+    b->tty_path = b->tty_path_new;
+    com_target = board_connect(b, &fd, &up_to_date);
+    if (com_target == NULL) {
+        return NULL;
+    }
+    lgw_usb_close(com_target);
+    if (!up_to_date && (image_version[0] != '\0')) {
+        printf("[%s] ERROR: the MCU runs %s after the update, expected %s\n", b->tty_name, b->version, image_version);
+        return NULL;
+    }
+
+    b->result = UPDATE_DONE;
+    b->duration_s = time_s() - start;
+    printf("[%s] INFO: MCU updated to %s on %s in %.1f s\n", b->tty_name, b->version, b->tty_path, b->duration_s);
+
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int update(const char ** tty_paths, int nb_tty) {
+    struct board_update_s boards[LGW_BOARD_NB_MAX];
+    pthread_t thrid[LGW_BOARD_NB_MAX];
+    bool started[LGW_BOARD_NB_MAX];
+    const char * name;
+    int i, nb_failed = 0;
+    static const char * result_name[] = { "NONE", "UPDATED", "SKIPPED", "FAILED" };
+
+    memset(boards, 0, sizeof boards);
+    for (i = 0; i < nb_tty; i++) {
+        boards[i].index = i;
+        boards[i].tty_path = tty_paths[i];
+        name = strrchr(tty_paths[i], '/');
+        snprintf(boards[i].tty_name, sizeof boards[i].tty_name, "%s", (name != NULL) ? name + 1 : tty_paths[i]);
+        started[i] = (pthread_create(&thrid[i], NULL, thread_update, &boards[i]) == 0);
+        if (!started[i]) {
+            printf("ERROR: failed to create the update thread of %s\n", tty_paths[i]);
+            boards[i].result = UPDATE_FAILED;
+        }
+    }
+
+    printf("##### MCU update #####\n");
+    for (i = 0; i < nb_tty; i++) {
+        if (started[i]) {
+            pthread_join(thrid[i], NULL);
+        }
+        printf("  %-16s %-8s %-10s %.1f s\n", tty_paths[i], result_name[boards[i].result], boards[i].version, boards[i].duration_s);
+        if (boards[i].result == UPDATE_FAILED) {
+            nb_failed += 1;
+        }
+    }
+    printf("######################\n");
+
+    return (nb_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -74,6 +314,9 @@ int main(int argc, char **argv)
     const char tty_path_default[] = TTY_PATH_DEFAULT;
     const char * tty_path = tty_path_default;
     void* com_target = NULL;
+    const char * tty_paths[LGW_BOARD_NB_MAX];
+    int nb_tty = 0;
+    const char * image_path = NULL;
 
     /* Parameter parsing */
     int option_index = 0;
@@ -82,7 +325,7 @@ int main(int argc, char **argv)
     };
 
     /* parse command line options */
-    while ((i = getopt_long (argc, argv, "hd:", long_options, &option_index)) != -1) {
+    while ((i = getopt_long (argc, argv, "hd:u:fn", long_options, &option_index)) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -90,7 +333,24 @@ int main(int argc, char **argv)
                 break;
 
             case 'd':
+                if (nb_tty >= LGW_BOARD_NB_MAX) {
+                    printf("ERROR: at most %d boards can be given\n", LGW_BOARD_NB_MAX);
+                    return -1;
+                }
                 tty_path = optarg;
+                tty_paths[nb_tty++] = optarg;
+                break;
+
+            case 'u':
+                image_path = optarg;
+                break;
+
+            case 'f':
+                update_force = true;
+                break;
+
+            case 'n':
+                update_verify = false;
                 break;
 
             default:
@@ -100,6 +360,19 @@ int main(int argc, char **argv)
         }
     }
 
+    /* Update the firmware of all the boards, in parallel */
+    if (image_path != NULL) {
+        if (image_load(image_path) != 0) {
+            return EXIT_FAILURE;
+        }
+        if (nb_tty == 0) {
+            tty_paths[nb_tty++] = tty_path_default;
+        }
+        x = update(tty_paths, nb_tty);
+        free(image);
+        return x;
+    }
+
     /* Open connexion with the MCU over USB */
     x = lgw_usb_open(tty_path, &com_target);
     if (x != 0) {
@@ -0,0 +1,557 @@
+/*
+  ______                              _
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2020 Semtech
+
+Description:
+    Programming of the concentrator MCU flash through its USB DFU bootloader
+    (STM32 DfuSe protocol), over the Linux usbdevfs interface.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>     /* PATH_MAX */
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+#include "usb_dfu.h"
+#include "crc16.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SYSFS_USB_DEVICES   "/sys/bus/usb/devices"
+
+#define CTRL_TIMEOUT_MS     5000
+#define STATUS_TIMEOUT_MS   30000   /* longest operation reported busy, a sector erase or a block write */
+#define XFER_SIZE_DEFAULT   2048    /* if the DFU functional descriptor is not found */
+#define DESC_SIZE_MAX       4096
+
+/* DFU class requests */
+#define DFU_DNLOAD          1
+#define DFU_UPLOAD          2
+#define DFU_GETSTATUS       3
+#define DFU_CLRSTATUS       4
+#define DFU_ABORT           6
+
+#define REQ_OUT             0x21    /* host to device, class, interface */
+#define REQ_IN              0xA1    /* device to host, class, interface */
+
+/* DFU states */
+#define DFU_STATE_IDLE          2
+#define DFU_STATE_DNLOAD_SYNC   3
+#define DFU_STATE_DNBUSY        4
+#define DFU_STATE_DNLOAD_IDLE   5
+#define DFU_STATE_MANIFEST_SYNC 6
+#define DFU_STATE_MANIFEST      7
+#define DFU_STATE_ERROR         10
+
+/* DfuSe commands, sent as a DNLOAD of block 0 */
+#define DFUSE_SET_ADDRESS   0x21
+#define DFUSE_ERASE         0x41
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
+
+static int ctrl(int fd, uint8_t type, uint8_t request, uint16_t value, uint16_t index, void * data, uint16_t len) {
+    struct usbdevfs_ctrltransfer c;
+
+    c.bRequestType = type;
+    c.bRequest = request;
+    c.wValue = value;
+    c.wIndex = index;
+    c.wLength = len;
+    c.timeout = CTRL_TIMEOUT_MS;
+    c.data = data;
+
+    return ioctl(fd, USBDEVFS_CONTROL, &c);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int read_sysfs(const char * port, const char * attr, char * buf, size_t size) {
+    char path[PATH_MAX];
+    FILE * f;
+
+    snprintf(path, sizeof path, SYSFS_USB_DEVICES "/%s/%s", port, attr);
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return USB_DFU_ERROR;
+    }
+    if (fgets(buf, size, f) == NULL) {
+        fclose(f);
+        return USB_DFU_ERROR;
+    }
+    fclose(f);
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* poll the status until the state expected, waiting for the time requested by the device when busy */
+static int wait_state(struct usb_dfu_s * dfu, uint8_t state) {
+    uint8_t status[6];
+    unsigned poll_ms;
+    unsigned waited_ms = 0;
+
+    while (waited_ms < STATUS_TIMEOUT_MS) {
+        if (ctrl(dfu->fd, REQ_IN, DFU_GETSTATUS, 0, dfu->interface, status, sizeof status) != sizeof status) {
+            printf("ERROR: DFU GETSTATUS failed\n");
+            return USB_DFU_ERROR;
+        }
+        if (status[0] != 0) {
+            printf("ERROR: DFU status 0x%02X in state %u\n", status[0], status[4]);
+            ctrl(dfu->fd, REQ_OUT, DFU_CLRSTATUS, 0, dfu->interface, NULL, 0);
+            return USB_DFU_ERROR;
+        }
+        if (status[4] == state) {
+            return USB_DFU_SUCCESS;
+        }
+        if ((status[4] != DFU_STATE_DNBUSY) && (status[4] != DFU_STATE_DNLOAD_SYNC) && (status[4] != DFU_STATE_MANIFEST_SYNC)) {
+            printf("ERROR: unexpected DFU state %u (expected %u)\n", status[4], state);
+            return USB_DFU_ERROR;
+        }
+        poll_ms = status[1] | (status[2] << 8) | (status[3] << 16);
+        usleep(poll_ms * 1000);
+        waited_ms += (poll_ms > 0) ? poll_ms : 1;
+    }
+
+    printf("ERROR: DFU device still busy after %u ms\n", STATUS_TIMEOUT_MS);
+    return USB_DFU_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int dfuse_command(struct usb_dfu_s * dfu, uint8_t command, uint32_t addr, bool with_addr) {
+    uint8_t buf[5];
+
+    buf[0] = command;
+    buf[1] = (uint8_t)(addr >> 0);
+    buf[2] = (uint8_t)(addr >> 8);
+    buf[3] = (uint8_t)(addr >> 16);
+    buf[4] = (uint8_t)(addr >> 24);
+    if (ctrl(dfu->fd, REQ_OUT, DFU_DNLOAD, 0, dfu->interface, buf, with_addr ? 5 : 1) < 0) {
+        printf("ERROR: DfuSe command 0x%02X failed at 0x%08X\n", command, addr);
+        return USB_DFU_ERROR;
+    }
+
+    return wait_state(dfu, DFU_STATE_DNLOAD_IDLE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* back to dfuIDLE, from any state but dfuERROR */
+static int to_idle(struct usb_dfu_s * dfu) {
+    if (ctrl(dfu->fd, REQ_OUT, DFU_ABORT, 0, dfu->interface, NULL, 0) < 0) {
+        printf("ERROR: DFU ABORT failed\n");
+        return USB_DFU_ERROR;
+    }
+
+    return wait_state(dfu, DFU_STATE_IDLE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int get_string(int fd, uint8_t index, char * str, size_t size) {
+    uint8_t buf[255];
+    int n, i;
+    size_t len = 0;
+
+    n = ctrl(fd, 0x80, 6, (3 << 8) | index, 0x0409, buf, sizeof buf); /* GET_DESCRIPTOR, string, english */
+    if (n < 2) {
+        return USB_DFU_ERROR;
+    }
+    for (i = 2; ((i + 1) < n) && (len < (size - 1)); i += 2) {
+        str[len++] = (char)buf[i]; /* UTF-16LE, the layouts are ASCII */
+    }
+    str[len] = '\0';
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* DfuSe memory layout, as "@Internal Flash  /0x08000000/064*0002Kg" */
+static int parse_layout(struct usb_dfu_s * dfu, const char * str) {
+    const char * p;
+    char * end;
+    unsigned long nb, size;
+
+    p = strchr(str, '/');
+    if (p == NULL) {
+        return USB_DFU_ERROR;
+    }
+    dfu->flash_addr = (uint32_t)strtoul(p + 1, &end, 16);
+    if (*end != '/') {
+        return USB_DFU_ERROR;
+    }
+    p = end;
+    dfu->sector_grp_nb = 0;
+    while ((*p == '/') || (*p == ',')) {
+        nb = strtoul(p + 1, &end, 10);
+        if (*end != '*') {
+            break;
+        }
+        size = strtoul(end + 1, &end, 10);
+        if (*end == 'K') {
+            size *= 1024;
+            end++;
+        } else if (*end == 'M') {
+            size *= 1024 * 1024;
+            end++;
+        } else if (*end == ' ') {
+            end++;
+        }
+        if (*end != '\0') {
+            end++; /* access type */
+        }
+        if ((nb == 0) || (size == 0) || (dfu->sector_grp_nb >= USB_DFU_SECTOR_GRP_MAX)) {
+            break;
+        }
+        dfu->sector_nb[dfu->sector_grp_nb] = nb;
+        dfu->sector_size[dfu->sector_grp_nb] = size;
+        dfu->sector_grp_nb += 1;
+        p = end;
+        if (*p == '/') {
+            break; /* next memory region, not used */
+        }
+    }
+
+    return (dfu->sector_grp_nb > 0) ? USB_DFU_SUCCESS : USB_DFU_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* select the DFU interface and alternate setting of the internal flash, from the raw descriptors */
+static int parse_descriptors(struct usb_dfu_s * dfu, const uint8_t * desc, int size) {
+    char str[256];
+    int i = 0;
+    bool in_dfu = false;
+    bool found = false;
+    uint8_t interface, alt, index;
+
+    dfu->xfer_size = XFER_SIZE_DEFAULT;
+    dfu->interface = 0;
+    dfu->alt = 0;
+    while ((i + 2) <= size) {
+        if ((desc[i] < 2) || ((i + desc[i]) > size)) {
+            break;
+        }
+        if ((desc[i + 1] == 4) && (desc[i] >= 9)) {
+            /* interface: application specific class, DFU subclass */
+            in_dfu = (desc[i + 5] == 0xFE) && (desc[i + 6] == 0x01);
+            if (in_dfu && !found) {
+                interface = desc[i + 2];
+                alt = desc[i + 3];
+                index = desc[i + 8];
+                if ((index != 0) && (get_string(dfu->fd, index, str, sizeof str) == USB_DFU_SUCCESS) && (strncmp(str, "@Internal Flash", 15) == 0)) {
+                    if (parse_layout(dfu, str) == USB_DFU_SUCCESS) {
+                        dfu->interface = interface;
+                        dfu->alt = alt;
+                        found = true;
+                    } else {
+                        printf("WARNING: unsupported DfuSe layout \"%s\"\n", str);
+                    }
+                }
+            }
+        } else if ((desc[i + 1] == 0x21) && (desc[i] >= 7) && in_dfu) {
+            /* DFU functional */
+            dfu->xfer_size = desc[i + 5] | (desc[i + 6] << 8);
+        }
+        i += desc[i];
+    }
+
+    if (!found) {
+        printf("ERROR: no internal flash alternate setting in the DFU descriptors\n");
+        return USB_DFU_ERROR;
+    }
+
+    return USB_DFU_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int usb_dfu_tty_port(const char * tty_path, char * port, size_t size) {
+    char path[PATH_MAX + 32];
+    char real[PATH_MAX];
+    const char * name;
+    char * p;
+
+    if (realpath(tty_path, real) == NULL) {
+        printf("ERROR: failed to resolve %s\n", tty_path);
+        return USB_DFU_ERROR;
+    }
+    name = strrchr(real, '/');
+    name = (name != NULL) ? name + 1 : real;
+
+    /* the device of the TTY is the USB interface, as ".../1-1.2/1-1.2:1.0" */
+    snprintf(path, sizeof path, "/sys/class/tty/%s/device", name);
+    if (realpath(path, real) == NULL) {
+        printf("ERROR: %s is not a USB TTY\n", tty_path);
+        return USB_DFU_ERROR;
+    }
+    name = strrchr(real, '/');
+    name = (name != NULL) ? name + 1 : real;
+    if (strlen(name) >= size) {
+        return USB_DFU_ERROR;
+    }
+    strcpy(port, name);
+    p = strchr(port, ':');
+    if (p == NULL) {
+        printf("ERROR: %s is not a USB TTY\n", tty_path);
+        return USB_DFU_ERROR;
+    }
+    *p = '\0';
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int usb_dfu_port_tty(const char * port, char * tty_path, size_t size) {
+    char path[PATH_MAX];
+    DIR * dir;
+    struct dirent * entry;
+    int i;
+
+    /* the ACM TTY is on the communication interface, the first one */
+    for (i = 0; i < 2; i++) {
+        snprintf(path, sizeof path, SYSFS_USB_DEVICES "/%s:1.%d/tty", port, i);
+        dir = opendir(path);
+        if (dir == NULL) {
+            continue;
+        }
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                snprintf(tty_path, size, "/dev/%s", entry->d_name);
+                closedir(dir);
+                return USB_DFU_SUCCESS;
+            }
+        }
+        closedir(dir);
+    }
+
+    return USB_DFU_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int usb_dfu_open(struct usb_dfu_s * dfu, const char * port, unsigned timeout_ms) {
+    char buf[32];
+    char path[PATH_MAX];
+    uint8_t desc[DESC_SIZE_MAX];
+    struct usbdevfs_setinterface setif;
+    unsigned vid = 0, pid = 0, bus, dev;
+    unsigned waited_ms;
+    unsigned int interface;
+    int fd, n;
+
+    memset(dfu, 0, sizeof *dfu);
+    dfu->fd = -1;
+
+    /* wait for the bootloader to enumerate on the port */
+    for (waited_ms = 0; waited_ms <= timeout_ms; waited_ms += 100) {
+        if ((read_sysfs(port, "idVendor", buf, sizeof buf) == USB_DFU_SUCCESS) && (sscanf(buf, "%x", &vid) == 1) &&
+            (read_sysfs(port, "idProduct", buf, sizeof buf) == USB_DFU_SUCCESS) && (sscanf(buf, "%x", &pid) == 1) &&
+            (vid == USB_DFU_VID) && (pid == USB_DFU_PID)) {
+            break;
+        }
+        usleep(100000);
+    }
+    if ((vid != USB_DFU_VID) || (pid != USB_DFU_PID)) {
+        printf("ERROR: no DFU device on USB port %s after %u ms\n", port, timeout_ms);
+        return USB_DFU_ERROR;
+    }
+    usleep(100000); /* let udev set the permissions of the device node */
+    if ((read_sysfs(port, "busnum", buf, sizeof buf) != USB_DFU_SUCCESS) || (sscanf(buf, "%u", &bus) != 1) ||
+        (read_sysfs(port, "devnum", buf, sizeof buf) != USB_DFU_SUCCESS) || (sscanf(buf, "%u", &dev) != 1)) {
+        printf("ERROR: failed to get the address of the DFU device on USB port %s\n", port);
+        return USB_DFU_ERROR;
+    }
+
+    /* raw descriptors of the active configuration */
+    snprintf(path, sizeof path, SYSFS_USB_DEVICES "/%s/descriptors", port);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("ERROR: failed to read the descriptors of the DFU device\n");
+        return USB_DFU_ERROR;
+    }
+    n = read(fd, desc, sizeof desc);
+    close(fd);
+
+    snprintf(path, sizeof path, "/dev/bus/usb/%03u/%03u", bus, dev);
+    dfu->fd = open(path, O_RDWR);
+    if (dfu->fd < 0) {
+        printf("ERROR: failed to open the DFU device %s\n", path);
+        return USB_DFU_ERROR;
+    }
+
+    if (parse_descriptors(dfu, desc, n) != USB_DFU_SUCCESS) {
+        usb_dfu_close(dfu);
+        return USB_DFU_ERROR;
+    }
+
+    interface = dfu->interface;
+    if (ioctl(dfu->fd, USBDEVFS_CLAIMINTERFACE, &interface) < 0) {
+        printf("ERROR: failed to claim the DFU interface %u\n", interface);
+        usb_dfu_close(dfu);
+        return USB_DFU_ERROR;
+    }
+    setif.interface = dfu->interface;
+    setif.altsetting = dfu->alt;
+    if (ioctl(dfu->fd, USBDEVFS_SETINTERFACE, &setif) < 0) {
+        printf("ERROR: failed to select the DFU alternate setting %u\n", dfu->alt);
+        usb_dfu_close(dfu);
+        return USB_DFU_ERROR;
+    }
+
+    /* start from dfuIDLE, the state is unknown if a previous update was interrupted */
+    ctrl(dfu->fd, REQ_OUT, DFU_CLRSTATUS, 0, dfu->interface, NULL, 0);
+    if (to_idle(dfu) != USB_DFU_SUCCESS) {
+        usb_dfu_close(dfu);
+        return USB_DFU_ERROR;
+    }
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int usb_dfu_download(struct usb_dfu_s * dfu, const uint8_t * image, uint32_t size) {
+    uint32_t addr = dfu->flash_addr;
+    uint32_t offset, len, n;
+    uint16_t block;
+    int i;
+
+    /* erase the sectors covered by the image only */
+    for (i = 0; (i < dfu->sector_grp_nb) && (addr < (dfu->flash_addr + size)); i++) {
+        for (n = 0; (n < dfu->sector_nb[i]) && (addr < (dfu->flash_addr + size)); n++) {
+            if (dfuse_command(dfu, DFUSE_ERASE, addr, true) != USB_DFU_SUCCESS) {
+                return USB_DFU_ERROR;
+            }
+            addr += dfu->sector_size[i];
+        }
+    }
+    if (addr < (dfu->flash_addr + size)) {
+        printf("ERROR: image of %u bytes larger than the flash\n", size);
+        return USB_DFU_ERROR;
+    }
+
+    /* write the image, the blocks are relative to the address pointer */
+    if (dfuse_command(dfu, DFUSE_SET_ADDRESS, dfu->flash_addr, true) != USB_DFU_SUCCESS) {
+        return USB_DFU_ERROR;
+    }
+    for (offset = 0, block = 2; offset < size; offset += len, block++) {
+        len = ((size - offset) < dfu->xfer_size) ? (size - offset) : dfu->xfer_size;
+        if (ctrl(dfu->fd, REQ_OUT, DFU_DNLOAD, block, dfu->interface, (void *)(image + offset), len) != (int)len) {
+            printf("ERROR: DFU download of block %u failed\n", block);
+            return USB_DFU_ERROR;
+        }
+        if (wait_state(dfu, DFU_STATE_DNLOAD_IDLE) != USB_DFU_SUCCESS) {
+            return USB_DFU_ERROR;
+        }
+    }
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int usb_dfu_verify(struct usb_dfu_s * dfu, const uint8_t * image, uint32_t size) {
+    uint8_t * flash;
+    uint32_t offset, len;
+    uint16_t block;
+    uint16_t crc_image, crc_flash;
+
+    flash = malloc(size);
+    if (flash == NULL) {
+        return USB_DFU_ERROR;
+    }
+
+    /* the upload starts at the address pointer, from dfuIDLE */
+    if ((dfuse_command(dfu, DFUSE_SET_ADDRESS, dfu->flash_addr, true) != USB_DFU_SUCCESS) || (to_idle(dfu) != USB_DFU_SUCCESS)) {
+        free(flash);
+        return USB_DFU_ERROR;
+    }
+    for (offset = 0, block = 2; offset < size; offset += len, block++) {
+        len = ((size - offset) < dfu->xfer_size) ? (size - offset) : dfu->xfer_size;
+        if (ctrl(dfu->fd, REQ_IN, DFU_UPLOAD, block, dfu->interface, flash + offset, len) != (int)len) {
+            printf("ERROR: DFU upload of block %u failed, is the flash read protected?\n", block);
+            free(flash);
+            to_idle(dfu);
+            return USB_DFU_ERROR;
+        }
+    }
+    to_idle(dfu);
+
+    crc_image = crc16_ccitt(image, size);
+    crc_flash = crc16_ccitt(flash, size);
+    free(flash);
+    if (crc_flash != crc_image) {
+        printf("ERROR: flash CRC 0x%04X differs from the image CRC 0x%04X\n", crc_flash, crc_image);
+        return USB_DFU_ERROR;
+    }
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int usb_dfu_leave(struct usb_dfu_s * dfu) {
+    uint8_t status[6];
+
+    /* a zero length download from dfuDNLOAD-IDLE jumps to the address pointer */
+    if (dfuse_command(dfu, DFUSE_SET_ADDRESS, dfu->flash_addr, true) != USB_DFU_SUCCESS) {
+        usb_dfu_close(dfu);
+        return USB_DFU_ERROR;
+    }
+    if (ctrl(dfu->fd, REQ_OUT, DFU_DNLOAD, 0, dfu->interface, NULL, 0) < 0) {
+        printf("ERROR: failed to leave the DFU mode\n");
+        usb_dfu_close(dfu);
+        return USB_DFU_ERROR;
+    }
+    /* starts the manifestation, the device resets and may not answer */
+    ctrl(dfu->fd, REQ_IN, DFU_GETSTATUS, 0, dfu->interface, status, sizeof status);
+    usb_dfu_close(dfu);
+
+    return USB_DFU_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void usb_dfu_close(struct usb_dfu_s * dfu) {
+    unsigned int interface = dfu->interface;
+
+    if (dfu->fd >= 0) {
+        ioctl(dfu->fd, USBDEVFS_RELEASEINTERFACE, &interface);
+        close(dfu->fd);
+        dfu->fd = -1;
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
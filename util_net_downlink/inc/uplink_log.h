@@ -0,0 +1,116 @@
+/*
+  ______                              _
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+ (C)2019 Semtech
+
+ Description:
+    Binary log of the uplinks received by net_downlink, and their conversion
+    to CSV.
+
+    The receive loop only copies each PUSH_DATA to a single producer, single
+    consumer ring buffer, a writer thread drains it to the log file with large
+    buffered writes. The log file starts with a uplink_log_file_hdr_s,
+    followed by records made of a uplink_log_hdr_s and of the size bytes of
+    the datagram following its 12-byte header. All the fields are in the byte
+    order of the host which wrote the file, given by the endian field.
+
+ License: Revised BSD License, see LICENSE.TXT file include in the project
+ */
+
+
+#ifndef _NET_DOWNLINK_UPLINK_LOG_H
+#define _NET_DOWNLINK_UPLINK_LOG_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* FILE */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define UPLINK_LOG_RING_SIZE    ( 1 << 22 ) /* bytes buffered for the writer thread, must be a power of 2 */
+#define UPLINK_LOG_BUF_SIZE     ( 1 << 20 ) /* stdio buffer of the log file, size of its writes */
+#define UPLINK_LOG_PERIOD_MS    50          /* time between two drains of the ring */
+
+#define UPLINK_LOG_MAGIC        "NETULOG"   /* NUL included, 8 bytes */
+#define UPLINK_LOG_VERSION      1
+#define UPLINK_LOG_ENDIAN       0x01020304  /* reads 0x04030201 in the other byte order */
+
+#define UPLINK_LOG_PUSH_DATA        0   /* record types, identifiers of the datagrams */
+#define UPLINK_LOG_PUSH_DATA_BIN    6
+
+#define UPLINK_LOG_CSV_HEADER   "tmst,ftime,chan,rfch,freq,mid,stat,modu,datr,bw,codr,rssic,rssis,lsnr,size,data\n"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct uplink_log_file_hdr_s
+{
+    char        magic[8];       /* UPLINK_LOG_MAGIC */
+    uint32_t    version;        /* UPLINK_LOG_VERSION */
+    uint32_t    endian;         /* UPLINK_LOG_ENDIAN, written by the host */
+};
+
+struct uplink_log_hdr_s
+{
+    int64_t     host_time_ns;   /* CLOCK_REALTIME at the reception of the datagram, in ns */
+    uint64_t    gw_mac;         /* MAC address of the gateway */
+    uint32_t    size;           /* number of bytes following the header */
+    uint8_t     type;           /* UPLINK_LOG_PUSH_DATA (JSON object) or UPLINK_LOG_PUSH_DATA_BIN */
+    uint8_t     reserved[3];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+ @brief Create the binary log file, and start the thread writing to it
+ @param path [in]   Path of the log file, overwritten if it exists
+ @return 0 if no error, -1 otherwise
+ */
+int uplink_log_start( const char * path );
+
+/**
+ @brief Stop the writer thread, after the records pending are written, and close the file
+ */
+void uplink_log_stop( void );
+
+/**
+ @brief Queue a datagram for the writer thread, to be called by a single thread
+ @brief Never blocks on the file, the datagram is dropped if the ring is full.
+ @param type [in]   Type of the datagram, UPLINK_LOG_PUSH_DATA or UPLINK_LOG_PUSH_DATA_BIN
+ @param gw_mac [in] MAC address of the gateway
+ @param buf [in]    Datagram, following its 12-byte header
+ @param size [in]   Number of bytes of buf
+ */
+void uplink_log_put( uint8_t type, uint64_t gw_mac, const uint8_t * buf, uint32_t size );
+
+/**
+ @brief Get the number of datagrams not logged because the ring buffer was full
+ @return The number of datagrams dropped since the log was started
+ */
+uint32_t uplink_log_dropped( void );
+
+/**
+ @brief Write one CSV line for each rxpk of a JSON PUSH_DATA
+ @param file [in]   CSV file
+ @param buf [in]    NUL terminated JSON object
+ */
+void uplink_log_csv( FILE * file, const uint8_t * buf );
+
+/**
+ @brief Write one CSV line for each rxpk of a binary PUSH_DATA, see PROTOCOL.md
+ @param file [in]   CSV file
+ @param buf [in]    Binary payload
+ @param size [in]   Number of bytes of buf
+ */
+void uplink_log_csv_bin( FILE * file, const uint8_t * buf, int size );
+
+#endif
+/* --- EOF ------------------------------------------------------------------ */
@@ -35,6 +35,7 @@
 #include <stdlib.h>     /* EXIT_* */
 #include <unistd.h>     /* usleep */
 #include <stdbool.h>    /* bool type */
+#include <math.h>       /* log */
 
 #include <string.h>     /* memset */
 #include <time.h>       /* time, clock_gettime, strftime, gmtime, clock_nanosleep*/
@@ -52,6 +53,8 @@
 
 #include "parson.h"
 #include "base64.h"
+#include "lz4blk.h"
+#include "uplink_log.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- MACROS & CONSTANTS --------------------------------------------------- */
@@ -82,6 +85,12 @@
 #define DEFAULT_LORA_PREAMBLE_SIZE  8       /* LoRa preamble size */
 #define DEFAULT_PAYLOAD_SIZE        4       /* payload size, bytes */
 #define PUSH_TIMEOUT_MS             100
+#define DEFAULT_CLASS_A_DELAY_MS    1000    /* delay between the gateway time and a class A downlink (RX1) */
+#define DEFAULT_ACK_DELAY_MS        30      /* artificial latency before sending a PUSH_ACK or PULL_ACK */
+
+#define DL_TOKEN_NB                 65536   /* number of PULL_RESP tokens (16 bits) */
+#define DL_LAT_BIN_NB               24      /* bin k > 0 holds the PULL_RESP to TX_ACK delays in [2^(k-1), 2^k[ us */
+#define DL_STATS_PERIOD_S           10      /* period of the downlink statistics report */
 
 /* -------------------------------------------------------------------------- */
 /* --- CUSTOM TYPES --------------------------------------------------------- */
@@ -93,9 +102,27 @@ typedef enum
     PKT_PULL_DATA = 2,
     PKT_PULL_RESP = 3,
     PKT_PULL_ACK = 4,
-    PKT_TX_ACK = 5
+    PKT_TX_ACK = 5,
+    PKT_PUSH_DATA_BIN = 6,
+    PKT_PUSH_DATA_LZ4 = 7
 } pkt_type_t;
 
+/* result of a downlink, as reported by the TX_ACK */
+typedef enum
+{
+    DL_RES_NONE = 0,
+    DL_RES_TOO_LATE,
+    DL_RES_TOO_EARLY,
+    DL_RES_COLLISION_PACKET,
+    DL_RES_COLLISION_BEACON,
+    DL_RES_FULL,
+    DL_RES_TX_FREQ,
+    DL_RES_TX_POWER,
+    DL_RES_GPS_UNLOCKED,
+    DL_RES_OTHER,
+    DL_RES_NB
+} dl_result_t;
+
 typedef struct
 {
     uint32_t    nb_loop[2]; /* number of downlinks to be sent on each RF chain */
@@ -116,6 +143,10 @@ typedef struct
     uint16_t    preamb_size[2];
     uint8_t     pl_size[2];
     bool        ipol;
+    bool        poisson; /* exponentially distributed delays of mean delay_ms between 2 downlinks */
+    uint8_t     class_a_pct; /* percentage of class A (timestamped) downlinks, the others are class C (immediate) */
+    uint32_t    class_a_delay_ms; /* delay between the gateway time and a class A downlink */
+    uint8_t     sf_mix[2]; /* random LoRa SF in [min,max] for each downlink, spread_factor is used if min is 0 */
 } thread_params_t;
 
 /* -------------------------------------------------------------------------- */
@@ -133,6 +164,31 @@ static socklen_t addr_len_down = sizeof dist_addr_down;
 /* Thread variables */
 static pthread_mutex_t mx_sockaddr = PTHREAD_MUTEX_INITIALIZER; /* control access to the sockaddr info */
 
+/* Gateway time, from the timestamp of the last uplink received */
+static pthread_mutex_t mx_gw_time = PTHREAD_MUTEX_INITIALIZER;
+static bool gw_time_valid = false;
+static uint32_t gw_time_tmst; /* concentrator counter of the last uplink */
+static int64_t gw_time_ns; /* local time at which it was received */
+
+/* Downlink statistics */
+static const char * dl_result_name[DL_RES_NB] = { "NONE", "TOO_LATE", "TOO_EARLY", "COLLISION_PACKET", "COLLISION_BEACON", "FULL", "TX_FREQ", "TX_POWER", "GPS_UNLOCKED", "OTHER" };
+static pthread_mutex_t mx_dl_stats = PTHREAD_MUTEX_INITIALIZER; /* control access to the downlink statistics */
+static uint16_t dl_token = 0; /* token of the last PULL_RESP */
+static int64_t dl_sent_ns[DL_TOKEN_NB]; /* local time at which each pending PULL_RESP was sent, 0 once acknowledged */
+static struct
+{
+    uint32_t    nb_sent; /* PULL_RESP sent */
+    uint32_t    nb_class_a; /* timestamped downlinks sent */
+    uint32_t    nb_no_gw_time; /* class A downlinks sent immediate, no uplink received yet */
+    uint32_t    nb_ack; /* TX_ACK received */
+    uint32_t    nb_ack_unknown; /* TX_ACK with no pending PULL_RESP for its token */
+    uint32_t    nb_result[DL_RES_NB];
+    uint32_t    lat_hist[DL_LAT_BIN_NB]; /* PULL_RESP to TX_ACK delays */
+    int64_t     lat_max_ns;
+    int64_t     first_ns; /* local time of the first PULL_RESP */
+    int64_t     last_ns; /* local time of the last PULL_RESP */
+} dl_stats;
+
 /* -------------------------------------------------------------------------- */
 /* --- SUBFUNCTIONS DECLARATION --------------------------------------------- */
 
@@ -140,7 +196,14 @@ static void sig_handler( int sigio );
 static void usage( void );
 static void * thread_down_rf0( const void * arg );
 static void * thread_down_rf1( const void * arg );
-static void log_csv(FILE * file, uint8_t * buf);
+static int64_t time_ns( void );
+static uint32_t get_le32( const uint8_t * buf );
+static void gw_time_update( const uint8_t * buf, int size, bool bin );
+static bool gw_time_get( uint32_t delay_ms, uint32_t * tmst );
+static uint16_t dl_sent( bool class_a, bool no_gw_time );
+static void dl_unsent( uint16_t token );
+static void dl_ack( uint16_t token, const uint8_t * buf, int size );
+static void dl_stats_report( void );
 
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
@@ -164,6 +227,7 @@ int main( int argc, char **argv )
     const char * log_fname = NULL; /* pointer to a string we won't touch */
     FILE * log_file = NULL;
     bool is_first = true;
+    const char * bin_log_fname = NULL; /* binary log written by a dedicated thread */
 
     /* Server socket creation */
     int sock; /* socket file descriptor */
@@ -185,8 +249,11 @@ int main( int argc, char **argv )
 
     /* Variables for receiving and sending packets */
     uint8_t databuf_up[32768];
+    uint8_t databuf_lz4[32768]; /* compressed JSON object of a PUSH_DATA_LZ4 */
+    uint32_t lz4_size; /* size of the JSON object once decompressed */
     uint8_t databuf_ack[4];
     int byte_nb;
+    int up_byte_nb; /* size of the uplink datagram, byte_nb is reused for the ACK */
 
     /* Variables for protocol management */
     uint32_t raw_mac_h; /* Most Significant Nibble, network order */
@@ -211,15 +278,21 @@ int main( int argc, char **argv )
         .pl_size = {DEFAULT_PAYLOAD_SIZE, DEFAULT_PAYLOAD_SIZE},
         .freq_step = 0.2,
         .freq_nb = 1,
-        .ipol = false
+        .ipol = false,
+        .poisson = false,
+        .class_a_pct = 0,
+        .class_a_delay_ms = DEFAULT_CLASS_A_DELAY_MS,
+        .sf_mix = {0, 0}
     };
+    int64_t report_ns = 0;
+    unsigned ack_delay_ms = DEFAULT_ACK_DELAY_MS;
 
     /* Threads ID */
     pthread_t thrid_down_rf0;
     pthread_t thrid_down_rf1;
 
     /* Parse command line options */
-    while( ( i = getopt( argc, argv, "b:c:f:hij:l:p:r:s:t:x:z:A:F:P:m:d:q:" ) ) != -1 )
+    while( ( i = getopt( argc, argv, "a:b:c:ef:g:hij:l:p:r:s:t:w:x:z:A:D:F:L:P:m:d:q:" ) ) != -1 )
     {
         switch( i )
         {
@@ -232,6 +305,10 @@ int main( int argc, char **argv )
                 log_fname = optarg;
                 break;
 
+            case 'L':
+                bin_log_fname = optarg;
+                break;
+
             case 'P':
                 port_arg = optarg;
                 break;
@@ -535,6 +612,54 @@ int main( int argc, char **argv )
                 thread_params.ipol = true;
                 break;
 
+            case 'e':
+                thread_params.poisson = true;
+                break;
+
+            case 'a': /* -a <uint> percentage of class A downlinks */
+                j = sscanf( optarg, "%u", &arg_u );
+                if( (j != 1) || (arg_u > 100) )
+                {
+                    printf( "ERROR: argument parsing of -a argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                thread_params.class_a_pct = (uint8_t)arg_u;
+                break;
+
+            case 'D': /* -D <uint> artificial ACK latency */
+                j = sscanf( optarg, "%u", &ack_delay_ms );
+                if( j != 1 )
+                {
+                    printf( "ERROR: argument parsing of -D argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'w': /* -w <uint> class A delay */
+                j = sscanf( optarg, "%u", &arg_u );
+                if( j != 1 )
+                {
+                    printf( "ERROR: argument parsing of -w argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                thread_params.class_a_delay_ms = (uint32_t)arg_u;
+                break;
+
+            case 'g': /* -g <uint>-<uint> LoRa SF range */
+                j = sscanf( optarg, "%u-%u", &arg_u, &arg_u2 );
+                if( (j != 2) || (arg_u < 5) || (arg_u2 > 12) || (arg_u > arg_u2) )
+                {
+                    printf( "ERROR: argument parsing of -g argument\n" );
+                    usage( );
+                    return EXIT_FAILURE;
+                }
+                thread_params.sf_mix[0] = (uint8_t)arg_u;
+                thread_params.sf_mix[1] = (uint8_t)arg_u2;
+                break;
+
             case 't':
                 j = sscanf( optarg, "%u,%u", &arg_u, &arg_u2 );
                 switch( j )
@@ -593,7 +718,7 @@ int main( int argc, char **argv )
     }
 
     /* Start message */
-    printf( "+++ Start of network uplink logger (30ms delay) +++\n" );
+    printf( "+++ Start of network uplink logger (%ums delay) +++\n", ack_delay_ms );
 
     /* Configure socket for uplink forwarding if required */
     if( fwd_uplink == true )
@@ -713,6 +838,14 @@ int main( int argc, char **argv )
             return EXIT_FAILURE;
         }
     }
+    if( bin_log_fname != NULL )
+    {
+        if( uplink_log_start( bin_log_fname ) != 0 )
+        {
+            return EXIT_FAILURE;
+        }
+        printf( "INFO: logging uplinks to binary file %s\n", bin_log_fname );
+    }
 
     /* Configure signal handling */
     sigemptyset( &sigact.sa_mask );
@@ -747,6 +880,7 @@ int main( int argc, char **argv )
             printf( "ERROR: recvfrom returned %s \n", strerror( errno ) );
             continue;
         }
+        up_byte_nb = byte_nb;
 
         /* Display info about the sender */
         x = getnameinfo( (struct sockaddr *)&dist_addr, addr_len, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST );
@@ -776,13 +910,42 @@ int main( int argc, char **argv )
         raw_mac_l = *( (uint32_t *)( databuf_up + 8 ) );
         gw_mac = ( (uint64_t)ntohl( raw_mac_h ) << 32 ) + (uint64_t)ntohl( raw_mac_l );
 
+        /* Decompress the JSON object, the datagram is then processed, and forwarded, as a PUSH_DATA */
+        if( databuf_up[3] == PKT_PUSH_DATA_LZ4 )
+        {
+            if( byte_nb < 16 )
+            {
+                printf( ", PUSH_DATA_LZ4 too short\n" );
+                continue;
+            }
+            lz4_size = databuf_up[12] | ( databuf_up[13] << 8 ) | ( databuf_up[14] << 16 ) | ( (uint32_t)databuf_up[15] << 24 );
+            memcpy( databuf_lz4, &databuf_up[16], byte_nb - 16 );
+            x = lz4blk_decompress( databuf_lz4, byte_nb - 16, &databuf_up[12], sizeof databuf_up - 13, lz4blk_dict_up, lz4blk_dict_up_size );
+            if( ( x < 0 ) || ( (uint32_t)x != lz4_size ) )
+            {
+                printf( ", PUSH_DATA_LZ4 decompression failed\n" );
+                continue;
+            }
+            printf( ", PUSH_DATA_LZ4 of %i bytes", x );
+            databuf_up[3] = PKT_PUSH_DATA;
+            databuf_up[12 + x] = 0; /* the JSON object is parsed as a string */
+            byte_nb = 12 + x;
+            up_byte_nb = byte_nb;
+        }
+
         /* Interpret gateway command and select ACK to be sent */
         switch( databuf_up[3] )
         {
             case PKT_PUSH_DATA:
-                printf( ", PUSH_DATA from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
+            case PKT_PUSH_DATA_BIN:
+                printf( ", %s from gateway 0x%08X%08X\n", ( databuf_up[3] == PKT_PUSH_DATA ) ? "PUSH_DATA" : "PUSH_DATA_BIN", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
                 ack_command = PKT_PUSH_ACK;
                 no_ack = false;
+                if( thread_params.class_a_pct > 0 )
+                {
+                    /* keep track of the gateway time for the timestamped downlinks */
+                    gw_time_update( &databuf_up[12], byte_nb - 12, ( databuf_up[3] == PKT_PUSH_DATA_BIN ) );
+                }
                 if( fwd_uplink == false )
                 {
                     printf( "<-  pkt out, PUSH_ACK for host %s (port %s)", host_name, port_name );
@@ -815,6 +978,7 @@ int main( int argc, char **argv )
             case PKT_TX_ACK:
                 printf( ", TX_ACK from gateway 0x%08X%08X\n", (uint32_t)( gw_mac >> 32 ), (uint32_t)( gw_mac & 0xFFFFFFFF ) );
                 no_ack = true;
+                dl_ack( (uint16_t)( ( databuf_up[1] << 8 ) | databuf_up[2] ), &databuf_up[12], byte_nb - 12 );
                 break;
 
             default:
@@ -822,12 +986,15 @@ int main( int argc, char **argv )
                 continue;
         }
 
-        /* Add some artificial latency */
-        usleep( 30000 ); /* 30 ms */
-
         /* Send acknowledge and check return value */
         if( no_ack == false )
         {
+            /* Add some artificial latency, not to the TX_ACK which would delay the next ones */
+            if( ack_delay_ms > 0 )
+            {
+                usleep( ack_delay_ms * 1000 );
+            }
+
             memset( databuf_ack, 0, 4 );
             databuf_ack[0] = PROTOCOL_VERSION;
             databuf_ack[1] = databuf_up[1];
@@ -845,27 +1012,54 @@ int main( int argc, char **argv )
         }
 
         /* Log uplinks to file */
-        if( databuf_up[3] == PKT_PUSH_DATA )
+        if( ( databuf_up[3] == PKT_PUSH_DATA ) || ( databuf_up[3] == PKT_PUSH_DATA_BIN ) )
         {
+            if( bin_log_fname != NULL )
+            {
+                /* only queued, the writer thread does the file accesses */
+                uplink_log_put( databuf_up[3], gw_mac, &databuf_up[12], up_byte_nb - 12 );
+            }
             if( log_fname != NULL )
             {
                 if( is_first == true )
                 {
-                    fprintf(log_file, "tmst,ftime,chan,rfch,freq,mid,stat,modu,datr,bw,codr,rssic,rssis,lsnr,size,data\n");
+                    fprintf(log_file, UPLINK_LOG_CSV_HEADER);
                     is_first = false;
                 }
-                log_csv( log_file, &databuf_up[12] );
+                if( databuf_up[3] == PKT_PUSH_DATA )
+                {
+                    uplink_log_csv( log_file, &databuf_up[12] );
+                }
+                else
+                {
+                    uplink_log_csv_bin( log_file, &databuf_up[12], up_byte_nb - 12 );
+                }
+                fflush(log_file);
             }
         }
+
+        /* Report the downlink statistics periodically */
+        if( ( time_ns( ) - report_ns ) >= ( DL_STATS_PERIOD_S * 1000000000LL ) )
+        {
+            dl_stats_report( );
+            report_ns = time_ns( );
+        }
     }
 
     /* Wait for downstream thread to finish */
     pthread_join( thrid_down_rf0, NULL );
     pthread_join( thrid_down_rf1, NULL );
 
+    dl_stats_report( );
+
     printf( "INFO: Exiting uplink logger\n" );
 
-    /* Close log file */
+    /* Close log files */
+    if( bin_log_fname != NULL )
+    {
+        uplink_log_stop( );
+        printf( "INFO: %u uplinks dropped from the binary log, ring buffer full\n", uplink_log_dropped( ) );
+    }
     if( (log_fname != NULL) && (log_file != NULL) )
     {
         fclose( log_file );
@@ -877,254 +1071,6 @@ int main( int argc, char **argv )
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-static void log_csv(FILE * file, uint8_t * buf)
-{
-    JSON_Object * rxpk = NULL;
-    JSON_Object * root = NULL;
-    JSON_Array * rxpk_array = NULL;
-    JSON_Value * root_val = NULL;
-    JSON_Value * val = NULL;
-    int i, j, rxpk_nb, x;
-    const char * str; /* pointer to sub-strings in the JSON data */
-    short x0, x1;
-    uint8_t payload[255];
-    uint8_t size;
-
-    if( file == NULL )
-    {
-        printf("ERROR: no file opened\n");
-        return;
-    }
-
-    /* Parse JSON string */
-    root_val = json_parse_string( (const char *)buf ); /* JSON offset */
-    root = json_value_get_object( root_val );
-    if( root == NULL )
-    {
-        printf( "ERROR: not a valid JSON string\n" );
-        json_value_free( root_val );
-        return;
-    }
-
-    /* Get all packets from array */
-    rxpk_array = json_object_get_array( root, "rxpk" );
-    if( rxpk_array != NULL)
-    {
-        rxpk_nb = (int)json_array_get_count( rxpk_array );
-        for( i = 0; i < rxpk_nb; i++ )
-        {
-            rxpk = json_array_get_object( rxpk_array, i );
-            if( rxpk == NULL)
-            {
-                printf("ERROR: failed to get rxpk object\n");
-                json_value_free( root_val );
-                return;
-            }
-
-            /* Parse rxpk fields */
-            val = json_object_get_value( rxpk, "tmst" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for tmst\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, "%u", (uint32_t)json_value_get_number( val ) );
-
-            /* optional field */
-            val = json_object_get_value( rxpk, "ftime" );
-            if( val != NULL )
-            {
-
-                if( json_value_get_type( val ) != JSONNumber )
-                {
-                    printf( "ERROR: wrong type for tmst\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%u", (uint32_t)json_value_get_number( val ) );
-            } else {
-                fprintf(file, "," );
-            }
-
-            val = json_object_get_value( rxpk, "chan" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for chan\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, ",%u", (uint8_t)json_value_get_number( val ) );
-
-            val = json_object_get_value( rxpk, "rfch" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for rfch\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, ",%u", (uint8_t)json_value_get_number( val ) );
-
-            val = json_object_get_value( rxpk, "freq" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for rfch\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, ",%f", json_value_get_number( val ) );
-
-            val = json_object_get_value( rxpk, "mid" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for mid\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, ",%u", (uint8_t)json_value_get_number( val ) );
-
-            val = json_object_get_value( rxpk, "stat" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for stat\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, ",%d", (int8_t)json_value_get_number( val ) );
-
-            val = json_object_get_value( rxpk, "modu" );
-            if( json_value_get_type( val ) != JSONString )
-            {
-                printf( "ERROR: wrong type for stat\n" );
-                json_value_free( root_val );
-                return;
-            }
-            str = json_value_get_string( val );
-            fprintf(file, ",%s", str );
-            if( strcmp( str, "LORA" ) == 0 )
-            {
-                val = json_object_get_value( rxpk, "datr" );
-                if( json_value_get_type( val ) != JSONString )
-                {
-                    printf( "ERROR: wrong type for datr\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                str = json_value_get_string( val );
-                x = sscanf( str, "SF%2hdBW%3hd", &x0, &x1 );
-                if( x != 2 )
-                {
-                    printf( "ERROR: format error in \"rxpk.datr\"\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%d,%d", x0, x1 );
-
-                val = json_object_get_value( rxpk, "codr" );
-                if( json_value_get_type( val ) != JSONString )
-                {
-                    printf( "ERROR: wrong type for codr\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%s", json_value_get_string( val ) );
-
-                val = json_object_get_value( rxpk, "rssi" );
-                if( json_value_get_type( val ) != JSONNumber )
-                {
-                    printf( "ERROR: wrong type for rssic\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%.1f", json_value_get_number( val ) );
-
-                val = json_object_get_value( rxpk, "rssis" );
-                if( json_value_get_type( val ) != JSONNumber )
-                {
-                    printf( "ERROR: wrong type for rssis\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%.1f", json_value_get_number( val ) );
-
-                val = json_object_get_value( rxpk, "lsnr" );
-                if( json_value_get_type( val ) != JSONNumber )
-                {
-                    printf( "ERROR: wrong type for lsnr\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%.1f", json_value_get_number( val ) );
-            }
-            else if( strcmp( str, "FSK" ) == 0 )
-            {
-                val = json_object_get_value( rxpk, "datr" );
-                if( json_value_get_type( val ) != JSONNumber )
-                {
-                    printf( "ERROR: wrong type for datr\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%d,,", (uint32_t)json_value_get_number( val ) ); /* bw,codr fields are left empty */
-
-                val = json_object_get_value( rxpk, "rssi" );
-                if( json_value_get_type( val ) != JSONNumber )
-                {
-                    printf( "ERROR: wrong type for rssic\n" );
-                    json_value_free( root_val );
-                    return;
-                }
-                fprintf(file, ",%.1f,,", json_value_get_number( val ) ); /* rssis,lsnr fields are left empty */
-            }
-            else
-            {
-                printf("ERROR: unknown modulation %s\n", str);
-                json_value_free( root_val );
-                return;
-            }
-
-            val = json_object_get_value( rxpk, "size" );
-            if( json_value_get_type( val ) != JSONNumber )
-            {
-                printf( "ERROR: wrong type for size\n" );
-                json_value_free( root_val );
-                return;
-            }
-            size = (uint8_t)json_value_get_number( val );
-            fprintf(file, ",%u", size );
-
-            val = json_object_get_value( rxpk, "data" );
-            if( json_value_get_type( val ) != JSONString )
-            {
-                printf( "ERROR: wrong type for data\n" );
-                json_value_free( root_val );
-                return;
-            }
-            str = json_value_get_string( val );
-            x = b64_to_bin( str, strlen( str ), payload, sizeof payload );
-            if( x != size )
-            {
-                printf( "ERROR: mismatch between .size and .data size once converter to binary\n" );
-                json_value_free( root_val );
-                return;
-            }
-            fprintf(file, "," );
-            for( j = 0; j < size; j++ )
-            {
-                fprintf(file, "%02x", payload[j] );
-            }
-
-            /* End line */
-            fprintf(file, "\n" );
-        }
-    }
-
-    fflush(file);
-    json_value_free( root_val );
-}
-
-/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
 static void usage( void )
 {
     printf( "~~~ Available options ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
@@ -1143,15 +1089,24 @@ static void usage( void )
     printf( " -i                 Set inverted polarity true\n" );
     printf( " -t <uint,uint>     Number of milliseconds between two downlinks for RF0,RF1\n" );
     printf( " -x <uint,uint>     Number of downlinks to be sent for RF0,RF1\n" );
+    printf( " -e                 Poisson arrivals, -t is the mean delay between two downlinks\n" );
+    printf( " -a <uint>          Percentage of class A (timestamped) downlinks, the others are class C (immediate)\n" );
+    printf( " -w <uint>          Class A: delay in milliseconds after the gateway time (default %u)\n", DEFAULT_CLASS_A_DELAY_MS );
+    printf( " -g <uint>-<uint>   Mixed SF: random LoRa Spreading Factor in the range for each downlink\n" );
     printf( " -P <udp port>      UDP port of the Packet Forwarder\n" );
     printf( " -A <ip address>    IP address to be used for uplink forwarding (optional)\n" );
     printf( " -F <udp port>      UDP port to be used for uplink forwarding (optional)\n" );
     printf( " -l <filename>      uplink logging CSV filename (optional)\n" );
+    printf( " -L <filename>      uplink logging binary filename, written by a dedicated thread (optional)\n" );
+    printf( " -D <uint>          Artificial latency in milliseconds before sending a PUSH_ACK/PULL_ACK (default %u)\n", DEFAULT_ACK_DELAY_MS );
     printf( " -B                 Bypass downlink, for uplink logging only (optional)\n" );
     printf( "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
     printf( "~~~ Examples ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
     printf( " Log uplinks into a CSV file, no downlink:\n" );
     printf( "   ./net_downlink -P 1730 -l log.csv\n" );
+    printf( " Log uplinks into a binary file at high rate, converted offline with uplink_log_csv:\n" );
+    printf( "   ./net_downlink -P 1730 -D 0 -L log.bin\n" );
+    printf( "   ./uplink_log_csv -i log.bin -o log.csv\n" );
     printf( " Send downlinks on RF chain 0 only:\n" );
     printf( "   ./net_downlink -f 865.1 -s 7 -b 125 -r 8 -t 500 -x 10 -P 1730\n" );
     printf( " Send downlinks on RF chain 1 only:\n" );
@@ -1162,6 +1117,8 @@ static void usage( void )
     printf( "   ./net_downlink -f 865.1,865.9 -s 11,12 -x 1,1 -r 65535,65535 -P 1730\n" );
     printf( " Log uplinks into CSV file while continuous TX is running (full_duplex testing):\n" );
     printf( "   ./net_downlink -f 864.5 -s 12 -x 1 -r 65535 -P 1730 -l log.csv\n" );
+    printf( " Downlink load of 20/s on RF chain 0, Poisson arrivals, half class A, SF7 to SF9:\n" );
+    printf( "   ./net_downlink -f 868.1 -t 50 -x 10000 -e -a 50 -g 7-9 -D 0 -P 1730\n" );
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -1180,7 +1137,7 @@ static void sig_handler( int sigio )
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-void prepare_downlink_json( const thread_params_t * params, uint8_t rf_chain, uint32_t pkt_sent, JSON_Value * root_val )
+void prepare_downlink_json( const thread_params_t * params, uint8_t rf_chain, uint32_t pkt_sent, uint8_t sf, bool class_a, uint32_t tmst, JSON_Value * root_val )
 {
     int j;
 
@@ -1192,7 +1149,6 @@ void prepare_downlink_json( const thread_params_t * params, uint8_t rf_chain, ui
     uint8_t payload[255];
     uint8_t payload_b64[341];
     double freq;
-    uint8_t sf;
     int8_t rf_pwr;
     uint16_t pream_sz;
     const char *modulation = (rf_chain == 0) ? params->modulation_rf0 : params->modulation_rf1;
@@ -1212,7 +1168,14 @@ void prepare_downlink_json( const thread_params_t * params, uint8_t rf_chain, ui
         obj = json_object_get_object( root_obj, "txpk" );
 
         /* Set downlink parameters */
-        json_object_set_boolean( obj, "imme", true );
+        if( class_a == true )
+        {
+            json_object_set_number( obj, "tmst", tmst );
+        }
+        else
+        {
+            json_object_set_boolean( obj, "imme", true );
+        }
         freq = params->freq_mhz[rf_chain] + ((pkt_sent % params->freq_nb) * params->freq_step);
         json_object_set_number( obj, "freq", freq );
         json_object_set_number( obj, "rfch", rf_chain );
@@ -1221,7 +1184,6 @@ void prepare_downlink_json( const thread_params_t * params, uint8_t rf_chain, ui
         if( strncmp( modulation, "LORA", 4 ) == 0 )
         {
             json_object_set_string( obj, "modu", "LORA" );
-            sf = params->spread_factor[rf_chain];
             sprintf( datarate_string, "SF%uBW%u", sf, params->bandwidth_khz);
             json_object_set_string( obj, "datr", datarate_string );
             json_object_set_string( obj, "codr", params->coding_rate );
@@ -1262,11 +1224,10 @@ void prepare_downlink_json( const thread_params_t * params, uint8_t rf_chain, ui
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-static void * thread_down_rf0( const void * arg )
+static void * down_loop( const thread_params_t * params, uint8_t rf_chain )
 {
     int x;
     int byte_nb;
-    const thread_params_t *params = ( (thread_params_t*)arg );
 
     /* Server socket creation */
     char host_name[64];
@@ -1281,8 +1242,19 @@ static void * thread_down_rf0( const void * arg )
     uint32_t nb_loop;
     uint32_t pkt_sent = 0;
 
+    /* Load profile variables */
+    unsigned int seed = (unsigned int)time( NULL ) + rf_chain;
+    struct timespec next_time; /* time of the next downlink */
+    double interval_us;
+    uint16_t token;
+    uint8_t sf;
+    bool class_a, no_gw_time;
+    uint32_t tmst = 0;
+
+    clock_gettime( CLOCK_MONOTONIC, &next_time );
+
     /* Global loop is the max loop defined */
-    nb_loop = params->nb_loop[0];
+    nb_loop = params->nb_loop[rf_chain];
     while( !exit_sig && !quit_sig && (pkt_sent < nb_loop) && (nb_loop > 0) )
     {
         /* Wait for socket address to be valid */
@@ -1292,6 +1264,7 @@ static void * thread_down_rf0( const void * arg )
             pthread_mutex_unlock( &mx_sockaddr );
             printf( "Waiting for socket to be ready...\n" );
             usleep( 500000 ); /* 500 ms */
+            clock_gettime( CLOCK_MONOTONIC, &next_time );
             continue;
         }
         pthread_mutex_unlock( &mx_sockaddr );
@@ -1305,6 +1278,20 @@ static void * thread_down_rf0( const void * arg )
             continue;
         }
 
+        /* Select the kind of downlink, class A ones need the gateway time */
+        sf = params->spread_factor[rf_chain];
+        if( params->sf_mix[0] != 0 )
+        {
+            sf = params->sf_mix[0] + (uint8_t)( rand_r( &seed ) % ( params->sf_mix[1] - params->sf_mix[0] + 1 ) );
+        }
+        class_a = ( (unsigned)( rand_r( &seed ) % 100 ) < params->class_a_pct );
+        no_gw_time = false;
+        if( ( class_a == true ) && ( gw_time_get( params->class_a_delay_ms, &tmst ) == false ) )
+        {
+            class_a = false;
+            no_gw_time = true;
+        }
+
         /* Prepare JSON object to be sent */
         root_val = json_value_init_object( );
         if( root_val == NULL )
@@ -1314,23 +1301,25 @@ static void * thread_down_rf0( const void * arg )
         else
         {
             /* Prepare the txpk JSON object */
-            prepare_downlink_json( params, 0, pkt_sent, root_val );
+            prepare_downlink_json( params, rf_chain, pkt_sent, sf, class_a, tmst, root_val );
 
             /* Convert JSON object to string */
             serialized_string = json_serialize_to_string( root_val );
             printf( "%s\n", serialized_string );
 
-            /* Send JSON string to socket */
+            /* Send JSON string to socket, with a token to match the TX_ACK */
+            token = dl_sent( class_a, no_gw_time );
             memset( databuf_down, 0, 4096 );
             databuf_down[0] = PROTOCOL_VERSION;
-            databuf_down[1] = 0;
-            databuf_down[2] = 0;
+            databuf_down[1] = (uint8_t)( token >> 8 );
+            databuf_down[2] = (uint8_t)( token & 0xFF );
             databuf_down[3] = PKT_PULL_RESP;
             memcpy( &databuf_down[4], (uint8_t*)serialized_string, strlen(serialized_string) );
             byte_nb = sendto( params->sock, (void *)databuf_down, strlen(serialized_string) + 4, 0, (struct sockaddr *)&dist_addr_down, addr_len_down );
             if( byte_nb == -1 )
             {
                 printf( "ERROR: failed to send downlink to socket - %s\n", strerror( errno ) );
+                dl_unsent( token );
             }
             else
             {
@@ -1344,106 +1333,306 @@ static void * thread_down_rf0( const void * arg )
 
         /* One more downlink sent */
         pkt_sent += 1;
-        /* Wait before sending next downlink */
-        usleep( params->delay_ms[0] * 1E3 );
+
+        /* Wait before sending next downlink, from the time planned for this one to keep the cadence */
+        interval_us = params->delay_ms[rf_chain] * 1E3;
+        if( params->poisson == true )
+        {
+            interval_us *= -log( 1.0 - ( (double)rand_r( &seed ) / ( (double)RAND_MAX + 1.0 ) ) );
+        }
+        next_time.tv_sec += (time_t)( interval_us / 1E6 );
+        next_time.tv_nsec += (long)( fmod( interval_us, 1E6 ) * 1E3 );
+        if( next_time.tv_nsec >= 1000000000 )
+        {
+            next_time.tv_sec += 1;
+            next_time.tv_nsec -= 1000000000;
+        }
+        while( ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next_time, NULL ) == EINTR ) && !exit_sig && !quit_sig );
     }
 
     /* Exit */
-    printf( "\nINFO: End of downstream thread for RF 0\n" );
+    printf( "\nINFO: End of downstream thread for RF%u\n", rf_chain );
     return NULL;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+static void * thread_down_rf0( const void * arg )
+{
+    return down_loop( (const thread_params_t *)arg, 0 );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 static void * thread_down_rf1( const void * arg )
 {
-    int x;
-    int byte_nb;
-    const thread_params_t *params = ( (thread_params_t*)arg );
+    return down_loop( (const thread_params_t *)arg, 1 );
+}
 
-    /* Server socket creation */
-    char host_name[64];
-    char port_name[64];
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* JSON variables */
-    JSON_Value *root_val = NULL;
-    char *serialized_string = NULL;
+static int64_t time_ns( void )
+{
+    struct timespec t;
 
-    /* Downstream data variables */
-    uint8_t databuf_down[4096];
-    uint32_t nb_loop;
-    uint32_t pkt_sent = 0;
+    clock_gettime( CLOCK_MONOTONIC, &t );
 
-    /* Global loop is the max loop defined */
-    nb_loop = params->nb_loop[1];
-    while( !exit_sig && !quit_sig && (pkt_sent < nb_loop) && (nb_loop > 0) )
+    return ( (int64_t)t.tv_sec * 1000000000LL ) + t.tv_nsec;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t get_le32( const uint8_t * buf )
+{
+    return (uint32_t)buf[0] | ( (uint32_t)buf[1] << 8 ) | ( (uint32_t)buf[2] << 16 ) | ( (uint32_t)buf[3] << 24 );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void gw_time_update( const uint8_t * buf, int size, bool bin )
+{
+    JSON_Value * root_val = NULL;
+    JSON_Array * rxpk_array = NULL;
+    JSON_Object * rxpk = NULL;
+    char json[4096];
+    int i, index, nb_rxpk;
+    bool found = false;
+    uint32_t tmst = 0;
+
+    if( size <= 0 )
     {
-        /* Wait for socket address to be valid */
-        pthread_mutex_lock( &mx_sockaddr );
-        if( sockaddr_valid == false )
+        return;
+    }
+
+    if( bin == true )
+    {
+        /* 52-byte fixed part followed by the payload, see PROTOCOL.md */
+        nb_rxpk = buf[0];
+        index = 2;
+        for( i = 0; ( i < nb_rxpk ) && ( index + 52 <= size ); i++ )
         {
-            pthread_mutex_unlock( &mx_sockaddr );
-            printf( "Waiting for socket to be ready...\n" );
-            usleep( 500000 ); /* 500 ms */
-            continue;
+            tmst = get_le32( buf + index + 1 );
+            found = true;
+            index += 52 + buf[index + 51];
         }
-        pthread_mutex_unlock( &mx_sockaddr );
+    }
+    else
+    {
+        if( size >= (int)sizeof json )
+        {
+            return;
+        }
+        memcpy( json, buf, size );
+        json[size] = '\0';
+        root_val = json_parse_string( json );
+        rxpk_array = json_object_get_array( json_value_get_object( root_val ), "rxpk" );
+        nb_rxpk = (int)json_array_get_count( rxpk_array );
+        if( nb_rxpk > 0 )
+        {
+            rxpk = json_array_get_object( rxpk_array, nb_rxpk - 1 );
+            if( json_value_get_type( json_object_get_value( rxpk, "tmst" ) ) == JSONNumber )
+            {
+                tmst = (uint32_t)json_object_get_number( rxpk, "tmst" );
+                found = true;
+            }
+        }
+        json_value_free( root_val );
+    }
 
-        /* Display info about the sender */
-        x = getnameinfo( (struct sockaddr *)&dist_addr_down, addr_len_down, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST );
-        if( x == -1 )
+    if( found == true )
+    {
+        pthread_mutex_lock( &mx_gw_time );
+        gw_time_tmst = tmst;
+        gw_time_ns = time_ns( );
+        gw_time_valid = true;
+        pthread_mutex_unlock( &mx_gw_time );
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool gw_time_get( uint32_t delay_ms, uint32_t * tmst )
+{
+    bool valid;
+
+    /* current gateway time, extrapolated from the last uplink, plus the class A delay */
+    pthread_mutex_lock( &mx_gw_time );
+    valid = gw_time_valid;
+    *tmst = gw_time_tmst + (uint32_t)( ( time_ns( ) - gw_time_ns ) / 1000 ) + ( delay_ms * 1000 );
+    pthread_mutex_unlock( &mx_gw_time );
+
+    return valid;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint16_t dl_sent( bool class_a, bool no_gw_time )
+{
+    uint16_t token;
+
+    pthread_mutex_lock( &mx_dl_stats );
+    dl_token += 1;
+    token = dl_token;
+    dl_sent_ns[token] = time_ns( );
+    if( dl_stats.nb_sent == 0 )
+    {
+        dl_stats.first_ns = dl_sent_ns[token];
+    }
+    dl_stats.last_ns = dl_sent_ns[token];
+    dl_stats.nb_sent += 1;
+    dl_stats.nb_class_a += ( class_a == true ) ? 1 : 0;
+    dl_stats.nb_no_gw_time += ( no_gw_time == true ) ? 1 : 0;
+    pthread_mutex_unlock( &mx_dl_stats );
+
+    return token;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void dl_unsent( uint16_t token )
+{
+    pthread_mutex_lock( &mx_dl_stats );
+    dl_sent_ns[token] = 0;
+    dl_stats.nb_sent -= 1;
+    pthread_mutex_unlock( &mx_dl_stats );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void dl_ack( uint16_t token, const uint8_t * buf, int size )
+{
+    JSON_Value * root_val = NULL;
+    JSON_Object * ack = NULL;
+    const char * str = NULL;
+    char json[1024];
+    dl_result_t res = DL_RES_NONE;
+    int64_t lat_ns;
+    uint64_t us;
+    int i, k;
+
+    /* no JSON object when there is nothing to report */
+    if( ( size > 0 ) && ( size < (int)sizeof json ) )
+    {
+        memcpy( json, buf, size );
+        json[size] = '\0';
+        root_val = json_parse_string( json );
+        ack = json_object_get_object( json_value_get_object( root_val ), "txpk_ack" );
+        str = json_object_get_string( ack, "error" );
+        if( str == NULL )
         {
-            printf( "ERROR: getnameinfo returned %s \n", gai_strerror( x ) );
-            usleep( 10000); /* 10 ms */
-            continue;
+            str = json_object_get_string( ack, "warn" );
         }
+        if( str != NULL )
+        {
+            res = DL_RES_OTHER;
+            for( i = 0; i < DL_RES_NB; i++ )
+            {
+                if( strcmp( str, dl_result_name[i] ) == 0 )
+                {
+                    res = (dl_result_t)i;
+                    break;
+                }
+            }
+        }
+        json_value_free( root_val );
+    }
 
-        /* Prepare JSON object to be sent */
-        root_val = json_value_init_object( );
-        if( root_val == NULL )
+    pthread_mutex_lock( &mx_dl_stats );
+    dl_stats.nb_ack += 1;
+    dl_stats.nb_result[res] += 1;
+    if( dl_sent_ns[token] == 0 )
+    {
+        dl_stats.nb_ack_unknown += 1;
+    }
+    else
+    {
+        lat_ns = time_ns( ) - dl_sent_ns[token];
+        dl_sent_ns[token] = 0;
+        us = (uint64_t)lat_ns / 1000;
+        k = ( us == 0 ) ? 0 : ( 64 - __builtin_clzll( us ) );
+        if( k >= DL_LAT_BIN_NB )
         {
-            printf( "ERROR: failed to initialize JSON root object\n" );
+            k = DL_LAT_BIN_NB - 1;
         }
-        else
+        dl_stats.lat_hist[k] += 1;
+        if( lat_ns > dl_stats.lat_max_ns )
         {
-            /* Prepare the txpk JSON object */
-            prepare_downlink_json( params, 1, pkt_sent, root_val );
+            dl_stats.lat_max_ns = lat_ns;
+        }
+    }
+    pthread_mutex_unlock( &mx_dl_stats );
+}
 
-            /* Convert JSON object to string */
-            serialized_string = json_serialize_to_string( root_val );
-            printf( "%s\n", serialized_string );
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-            /* Send JSON string to socket */
-            memset( databuf_down, 0, 4096 );
-            databuf_down[0] = PROTOCOL_VERSION;
-            databuf_down[1] = 0;
-            databuf_down[2] = 0;
-            databuf_down[3] = PKT_PULL_RESP;
-            memcpy( &databuf_down[4], (uint8_t*)serialized_string, strlen(serialized_string) );
-            byte_nb = sendto( params->sock, (void *)databuf_down, strlen(serialized_string) + 4, 0, (struct sockaddr *)&dist_addr_down, addr_len_down );
-            if( byte_nb == -1 )
+static void dl_stats_report( void )
+{
+    double elapsed_s;
+    uint32_t nb_lat = 0, acc = 0, nb_ok;
+    const unsigned per_mille[3] = { 500, 900, 990 };
+    unsigned p;
+    int i, k;
+
+    pthread_mutex_lock( &mx_dl_stats );
+    if( dl_stats.nb_sent == 0 )
+    {
+        pthread_mutex_unlock( &mx_dl_stats );
+        return;
+    }
+    /* rates over the time spent sending the downlinks */
+    elapsed_s = (double)( dl_stats.last_ns - dl_stats.first_ns ) / 1E9;
+    if( elapsed_s <= 0.0 )
+    {
+        elapsed_s = 1E-9;
+    }
+
+    /* a TX_POWER warning still means that the downlink has been queued */
+    nb_ok = dl_stats.nb_result[DL_RES_NONE] + dl_stats.nb_result[DL_RES_TX_POWER];
+    printf( "\n##### Downlink load: %u PULL_RESP in %.1f s (%.1f/s), %u class A (%u sent immediate, no gateway time)\n", dl_stats.nb_sent, elapsed_s, dl_stats.nb_sent / elapsed_s, dl_stats.nb_class_a, dl_stats.nb_no_gw_time );
+    printf( "# TX_ACK received: %u (%u with an unknown token), %u downlinks scheduled (%.1f/s)\n", dl_stats.nb_ack, dl_stats.nb_ack_unknown, nb_ok, nb_ok / elapsed_s );
+    printf( "# TX_ACK result:" );
+    for( i = 0; i < DL_RES_NB; i++ )
+    {
+        if( ( dl_stats.nb_result[i] > 0 ) || ( i == DL_RES_NONE ) )
+        {
+            printf( " %s:%u", dl_result_name[i], dl_stats.nb_result[i] );
+        }
+    }
+    printf( "\n" );
+
+    /* PULL_RESP to TX_ACK latency, percentiles are the upper bound of their bin */
+    for( k = 0; k < DL_LAT_BIN_NB; k++ )
+    {
+        nb_lat += dl_stats.lat_hist[k];
+    }
+    if( nb_lat > 0 )
+    {
+        printf( "# PULL_RESP to TX_ACK latency:" );
+        for( i = 0; i < 3; i++ )
+        {
+            acc = 0;
+            for( k = 0; k < ( DL_LAT_BIN_NB - 1 ); k++ )
             {
-                printf( "ERROR: failed to send downlink to socket - %s\n", strerror( errno ) );
+                acc += dl_stats.lat_hist[k];
+                if( ( (uint64_t)acc * 1000 ) >= ( (uint64_t)nb_lat * per_mille[i] ) )
+                {
+                    break;
+                }
             }
-            else
+            p = ( k == ( DL_LAT_BIN_NB - 1 ) ) ? (unsigned)( dl_stats.lat_max_ns / 1000 ) : ( 1U << k );
+            printf( " p%u<=%uus", per_mille[i] / 10, p );
+        }
+        printf( " max:%lldus\n", (long long)( dl_stats.lat_max_ns / 1000 ) );
+        for( k = 0; k < DL_LAT_BIN_NB; k++ )
+        {
+            if( dl_stats.lat_hist[k] > 0 )
             {
-                printf( "<-  pkt out, PULL_RESP for host %s (port %s), %i bytes sent for downlink (%d)\n", host_name, port_name, byte_nb, pkt_sent );
+                printf( "#   [%u, %u[ us: %u\n", ( k == 0 ) ? 0 : ( 1U << ( k - 1 ) ), 1U << k, dl_stats.lat_hist[k] );
             }
-
-            /* free JSON memory */
-            json_free_serialized_string( serialized_string );
-            json_value_free( root_val );
         }
-
-        /* One more downlink sent */
-        pkt_sent += 1;
-        /* Wait before sending next downlink */
-        usleep( params->delay_ms[1] * 1E3 );
     }
-
-    /* Exit */
-    printf( "\nINFO: End of downstream thread for RF1\n" );
-    return NULL;
+    printf( "##### END #####\n" );
+    pthread_mutex_unlock( &mx_dl_stats );
 }
 
 /* --- EOF ------------------------------------------------------------------ */
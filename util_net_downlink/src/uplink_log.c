@@ -0,0 +1,534 @@
+/*
+  ______                              _
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+ (C)2019 Semtech
+
+ Description:
+    Binary log of the uplinks received by net_downlink, and their conversion
+    to CSV.
+
+ License: Revised BSD License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* Fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+#define _XOPEN_SOURCE 600
+#else
+#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf, fprintf, fopen, fwrite, setvbuf */
+#include <stdlib.h>     /* malloc, free */
+#include <string.h>     /* memcpy, strcmp */
+#include <time.h>       /* clock_gettime, nanosleep */
+#include <pthread.h>
+
+#include "parson.h"
+#include "base64.h"
+#include "uplink_log.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* Single producer (receive loop), single consumer (writer) ring buffer, no lock */
+static uint8_t ring[UPLINK_LOG_RING_SIZE];
+static uint32_t ring_head = 0; /* next byte to be written, only modified by the producer */
+static uint32_t ring_tail = 0; /* next byte to be read, only modified by the writer */
+static uint32_t log_dropped = 0;
+
+static pthread_t thrid_log;
+static bool log_run = false;
+static FILE * log_file = NULL;
+static char * log_buf = NULL; /* stdio buffer of log_file */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint32_t get_le32( const uint8_t * buf )
+{
+    return (uint32_t)buf[0] | ( (uint32_t)buf[1] << 8 ) | ( (uint32_t)buf[2] << 16 ) | ( (uint32_t)buf[3] << 24 );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void ring_copy_in( uint32_t pos, const void * data, uint32_t size )
+{
+    uint32_t idx = pos & ( UPLINK_LOG_RING_SIZE - 1 );
+    uint32_t first = ( size < ( UPLINK_LOG_RING_SIZE - idx ) ) ? size : ( UPLINK_LOG_RING_SIZE - idx );
+
+    memcpy( &ring[idx], data, first );
+    memcpy( &ring[0], (const uint8_t *)data + first, size - first );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the records are written as they are in the ring, in one or two chunks */
+static void ring_drain( void )
+{
+    uint32_t head, tail, idx, len;
+
+    head = __atomic_load_n( &ring_head, __ATOMIC_ACQUIRE );
+    tail = ring_tail;
+    while( tail != head )
+    {
+        idx = tail & ( UPLINK_LOG_RING_SIZE - 1 );
+        len = ( ( head - tail ) < ( UPLINK_LOG_RING_SIZE - idx ) ) ? ( head - tail ) : ( UPLINK_LOG_RING_SIZE - idx );
+        if( fwrite( &ring[idx], 1, len, log_file ) != len )
+        {
+            printf( "ERROR: failed to write the uplink log\n" );
+        }
+        tail += len;
+    }
+    __atomic_store_n( &ring_tail, tail, __ATOMIC_RELEASE );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void * thread_log( void * arg )
+{
+    struct timespec period = { 0, UPLINK_LOG_PERIOD_MS * 1000000L };
+
+    (void)arg;
+
+    while( __atomic_load_n( &log_run, __ATOMIC_ACQUIRE ) == true )
+    {
+        ring_drain( );
+        nanosleep( &period, NULL );
+    }
+    ring_drain( );
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int uplink_log_start( const char * path )
+{
+    struct uplink_log_file_hdr_s hdr;
+
+    if( log_run == true )
+    {
+        return -1;
+    }
+
+    log_file = fopen( path, "wb" );
+    if( log_file == NULL )
+    {
+        printf( "ERROR: impossible to create uplink log file %s\n", path );
+        return -1;
+    }
+    log_buf = malloc( UPLINK_LOG_BUF_SIZE );
+    if( log_buf != NULL )
+    {
+        setvbuf( log_file, log_buf, _IOFBF, UPLINK_LOG_BUF_SIZE );
+    }
+
+    memset( &hdr, 0, sizeof hdr );
+    memcpy( hdr.magic, UPLINK_LOG_MAGIC, sizeof hdr.magic );
+    hdr.version = UPLINK_LOG_VERSION;
+    hdr.endian = UPLINK_LOG_ENDIAN;
+    fwrite( &hdr, sizeof hdr, 1, log_file );
+
+    ring_head = 0;
+    ring_tail = 0;
+    log_dropped = 0;
+
+    __atomic_store_n( &log_run, true, __ATOMIC_RELEASE );
+    if( pthread_create( &thrid_log, NULL, thread_log, NULL ) != 0 )
+    {
+        printf( "ERROR: impossible to create uplink log thread\n" );
+        __atomic_store_n( &log_run, false, __ATOMIC_RELEASE );
+        fclose( log_file );
+        log_file = NULL;
+        free( log_buf );
+        log_buf = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void uplink_log_stop( void )
+{
+    if( log_run == false )
+    {
+        return;
+    }
+
+    __atomic_store_n( &log_run, false, __ATOMIC_RELEASE );
+    pthread_join( thrid_log, NULL );
+
+    fclose( log_file );
+    log_file = NULL;
+    free( log_buf );
+    log_buf = NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void uplink_log_put( uint8_t type, uint64_t gw_mac, const uint8_t * buf, uint32_t size )
+{
+    struct uplink_log_hdr_s hdr;
+    struct timespec now;
+    uint32_t head;
+    uint32_t len = sizeof hdr + size;
+
+    if( __atomic_load_n( &log_run, __ATOMIC_ACQUIRE ) == false )
+    {
+        return;
+    }
+
+    head = ring_head;
+    if( ( UPLINK_LOG_RING_SIZE - ( head - __atomic_load_n( &ring_tail, __ATOMIC_ACQUIRE ) ) ) < len )
+    {
+        __atomic_fetch_add( &log_dropped, 1, __ATOMIC_RELAXED );
+        return;
+    }
+
+    clock_gettime( CLOCK_REALTIME, &now );
+    hdr.host_time_ns = ( (int64_t)now.tv_sec * 1000000000LL ) + now.tv_nsec;
+    hdr.gw_mac = gw_mac;
+    hdr.size = size;
+    hdr.type = type;
+    memset( hdr.reserved, 0, sizeof hdr.reserved );
+
+    ring_copy_in( head, &hdr, sizeof hdr );
+    ring_copy_in( head + sizeof hdr, buf, size );
+    __atomic_store_n( &ring_head, head + len, __ATOMIC_RELEASE );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t uplink_log_dropped( void )
+{
+    return __atomic_load_n( &log_dropped, __ATOMIC_RELAXED );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void uplink_log_csv( FILE * file, const uint8_t * buf )
+{
+    JSON_Object * rxpk = NULL;
+    JSON_Object * root = NULL;
+    JSON_Array * rxpk_array = NULL;
+    JSON_Value * root_val = NULL;
+    JSON_Value * val = NULL;
+    int i, j, rxpk_nb, x;
+    const char * str; /* pointer to sub-strings in the JSON data */
+    short x0, x1;
+    uint8_t payload[255];
+    uint8_t size;
+
+    if( file == NULL )
+    {
+        printf("ERROR: no file opened\n");
+        return;
+    }
+
+    /* Parse JSON string */
+    root_val = json_parse_string( (const char *)buf ); /* JSON offset */
+    root = json_value_get_object( root_val );
+    if( root == NULL )
+    {
+        printf( "ERROR: not a valid JSON string\n" );
+        json_value_free( root_val );
+        return;
+    }
+
+    /* Get all packets from array */
+    rxpk_array = json_object_get_array( root, "rxpk" );
+    if( rxpk_array != NULL)
+    {
+        rxpk_nb = (int)json_array_get_count( rxpk_array );
+        for( i = 0; i < rxpk_nb; i++ )
+        {
+            rxpk = json_array_get_object( rxpk_array, i );
+            if( rxpk == NULL)
+            {
+                printf("ERROR: failed to get rxpk object\n");
+                json_value_free( root_val );
+                return;
+            }
+
+            /* Parse rxpk fields */
+            val = json_object_get_value( rxpk, "tmst" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for tmst\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, "%u", (uint32_t)json_value_get_number( val ) );
+
+            /* optional field */
+            val = json_object_get_value( rxpk, "ftime" );
+            if( val != NULL )
+            {
+
+                if( json_value_get_type( val ) != JSONNumber )
+                {
+                    printf( "ERROR: wrong type for tmst\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%u", (uint32_t)json_value_get_number( val ) );
+            } else {
+                fprintf(file, "," );
+            }
+
+            val = json_object_get_value( rxpk, "chan" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for chan\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, ",%u", (uint8_t)json_value_get_number( val ) );
+
+            val = json_object_get_value( rxpk, "rfch" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for rfch\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, ",%u", (uint8_t)json_value_get_number( val ) );
+
+            val = json_object_get_value( rxpk, "freq" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for rfch\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, ",%f", json_value_get_number( val ) );
+
+            val = json_object_get_value( rxpk, "mid" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for mid\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, ",%u", (uint8_t)json_value_get_number( val ) );
+
+            val = json_object_get_value( rxpk, "stat" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for stat\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, ",%d", (int8_t)json_value_get_number( val ) );
+
+            val = json_object_get_value( rxpk, "modu" );
+            if( json_value_get_type( val ) != JSONString )
+            {
+                printf( "ERROR: wrong type for stat\n" );
+                json_value_free( root_val );
+                return;
+            }
+            str = json_value_get_string( val );
+            fprintf(file, ",%s", str );
+            if( strcmp( str, "LORA" ) == 0 )
+            {
+                val = json_object_get_value( rxpk, "datr" );
+                if( json_value_get_type( val ) != JSONString )
+                {
+                    printf( "ERROR: wrong type for datr\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                str = json_value_get_string( val );
+                x = sscanf( str, "SF%2hdBW%3hd", &x0, &x1 );
+                if( x != 2 )
+                {
+                    printf( "ERROR: format error in \"rxpk.datr\"\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%d,%d", x0, x1 );
+
+                val = json_object_get_value( rxpk, "codr" );
+                if( json_value_get_type( val ) != JSONString )
+                {
+                    printf( "ERROR: wrong type for codr\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%s", json_value_get_string( val ) );
+
+                val = json_object_get_value( rxpk, "rssi" );
+                if( json_value_get_type( val ) != JSONNumber )
+                {
+                    printf( "ERROR: wrong type for rssic\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%.1f", json_value_get_number( val ) );
+
+                val = json_object_get_value( rxpk, "rssis" );
+                if( json_value_get_type( val ) != JSONNumber )
+                {
+                    printf( "ERROR: wrong type for rssis\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%.1f", json_value_get_number( val ) );
+
+                val = json_object_get_value( rxpk, "lsnr" );
+                if( json_value_get_type( val ) != JSONNumber )
+                {
+                    printf( "ERROR: wrong type for lsnr\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%.1f", json_value_get_number( val ) );
+            }
+            else if( strcmp( str, "FSK" ) == 0 )
+            {
+                val = json_object_get_value( rxpk, "datr" );
+                if( json_value_get_type( val ) != JSONNumber )
+                {
+                    printf( "ERROR: wrong type for datr\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%d,,", (uint32_t)json_value_get_number( val ) ); /* bw,codr fields are left empty */
+
+                val = json_object_get_value( rxpk, "rssi" );
+                if( json_value_get_type( val ) != JSONNumber )
+                {
+                    printf( "ERROR: wrong type for rssic\n" );
+                    json_value_free( root_val );
+                    return;
+                }
+                fprintf(file, ",%.1f,,", json_value_get_number( val ) ); /* rssis,lsnr fields are left empty */
+            }
+            else
+            {
+                printf("ERROR: unknown modulation %s\n", str);
+                json_value_free( root_val );
+                return;
+            }
+
+            val = json_object_get_value( rxpk, "size" );
+            if( json_value_get_type( val ) != JSONNumber )
+            {
+                printf( "ERROR: wrong type for size\n" );
+                json_value_free( root_val );
+                return;
+            }
+            size = (uint8_t)json_value_get_number( val );
+            fprintf(file, ",%u", size );
+
+            val = json_object_get_value( rxpk, "data" );
+            if( json_value_get_type( val ) != JSONString )
+            {
+                printf( "ERROR: wrong type for data\n" );
+                json_value_free( root_val );
+                return;
+            }
+            str = json_value_get_string( val );
+            x = b64_to_bin( str, strlen( str ), payload, sizeof payload );
+            if( x != size )
+            {
+                printf( "ERROR: mismatch between .size and .data size once converter to binary\n" );
+                json_value_free( root_val );
+                return;
+            }
+            fprintf(file, "," );
+            for( j = 0; j < size; j++ )
+            {
+                fprintf(file, "%02x", payload[j] );
+            }
+
+            /* End line */
+            fprintf(file, "\n" );
+        }
+    }
+
+    json_value_free( root_val );
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void uplink_log_csv_bin( FILE * file, const uint8_t * buf, int size )
+{
+    const char * codr[] = { "OFF", "4/5", "4/6", "4/7", "4/8" };
+    int i, j, nb_rxpk, index;
+    const uint8_t * p;
+
+    if( file == NULL )
+    {
+        printf("ERROR: no file opened\n");
+        return;
+    }
+
+    if( size < 2 )
+    {
+        printf( "ERROR: binary PUSH_DATA too short\n" );
+        return;
+    }
+
+    /* Get all packets, 52-byte fixed part followed by the payload, see PROTOCOL.md */
+    nb_rxpk = buf[0];
+    index = 2;
+    for( i = 0; i < nb_rxpk; i++ )
+    {
+        p = buf + index;
+        if( ( index + 52 > size ) || ( index + 52 + p[51] > size ) )
+        {
+            printf( "ERROR: binary rxpk %d truncated\n", i );
+            return;
+        }
+
+        fprintf(file, "%u", get_le32( p + 1 ) );
+        if( p[0] & 0x04 )
+        {
+            fprintf(file, ",%u", get_le32( p + 5 ) );
+        } else {
+            fprintf(file, "," );
+        }
+        fprintf(file, ",%u,%u,%f,%u,%d", p[29], p[30], (double)get_le32( p + 25 ) / 1E6, p[31], (int8_t)p[32] );
+        if( p[33] == 1 )
+        {
+            fprintf(file, ",LORA,%u,%u,%s", get_le32( p + 34 ), p[38] | ( p[39] << 8 ), ( p[40] <= 4 ) ? codr[p[40]] : "?" );
+            fprintf(file, ",%.1f,%.1f,%.1f", (int16_t)( p[41] | ( p[42] << 8 ) ) / 10.0, (int16_t)( p[43] | ( p[44] << 8 ) ) / 10.0, (int16_t)( p[45] | ( p[46] << 8 ) ) / 10.0 );
+        }
+        else if( p[33] == 2 )
+        {
+            fprintf(file, ",FSK,%u,,", get_le32( p + 34 ) ); /* bw,codr fields are left empty */
+            fprintf(file, ",%.1f,,", (int16_t)( p[41] | ( p[42] << 8 ) ) / 10.0 ); /* rssis,lsnr fields are left empty */
+        }
+        else
+        {
+            printf("ERROR: unknown modulation %u\n", p[33]);
+            return;
+        }
+
+        fprintf(file, ",%u,", p[51] );
+        for( j = 0; j < p[51]; j++ )
+        {
+            fprintf(file, "%02x", p[52 + j] );
+        }
+
+        /* End line */
+        fprintf(file, "\n" );
+        index += 52 + p[51];
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,169 @@
+/*
+  ______                              _
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+ (C)2019 Semtech
+
+ Description:
+    Offline converter of the binary uplink log of net_downlink (-L option) to
+    the CSV format of the -l option.
+
+ License: Revised BSD License, see LICENSE.TXT file include in the project
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* Fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+#define _XOPEN_SOURCE 600
+#else
+#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* printf, fopen, fread, setvbuf */
+#include <stdlib.h>     /* EXIT_* */
+#include <unistd.h>     /* getopt */
+#include <string.h>     /* memcmp */
+
+#include "uplink_log.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define DATAGRAM_SIZE_MAX   32768   /* receive buffer of net_downlink */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
+
+static void usage( void )
+{
+    printf( "~~~ Available options ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
+    printf( " -h                 print this help\n" );
+    printf( " -i <filename>      binary uplink log written by net_downlink -L\n" );
+    printf( " -o <filename>      CSV file, overwritten if it exists (default: stdout)\n" );
+    printf( "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n" );
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main( int argc, char **argv )
+{
+    int i;
+    const char * in_fname = NULL;
+    const char * out_fname = NULL;
+    FILE * in_file;
+    FILE * out_file = stdout;
+    static char out_buf[UPLINK_LOG_BUF_SIZE];
+    static uint8_t buf[DATAGRAM_SIZE_MAX + 1];
+    struct uplink_log_file_hdr_s file_hdr;
+    struct uplink_log_hdr_s hdr;
+    unsigned long nb_record = 0;
+    unsigned long nb_skipped = 0;
+
+    /* Parse command line options */
+    while( ( i = getopt( argc, argv, "hi:o:" ) ) != -1 )
+    {
+        switch( i )
+        {
+            case 'h':
+                usage( );
+                return EXIT_SUCCESS;
+
+            case 'i':
+                in_fname = optarg;
+                break;
+
+            case 'o':
+                out_fname = optarg;
+                break;
+
+            default:
+                printf( "ERROR: argument parsing options, use -h option for help\n" );
+                usage( );
+                return EXIT_FAILURE;
+        }
+    }
+    if( in_fname == NULL )
+    {
+        printf( "ERROR: missing argument, use -h option for help\n" );
+        usage( );
+        return EXIT_FAILURE;
+    }
+
+    in_file = fopen( in_fname, "rb" );
+    if( in_file == NULL )
+    {
+        printf( "ERROR: impossible to open uplink log file %s\n", in_fname );
+        return EXIT_FAILURE;
+    }
+    if( ( fread( &file_hdr, sizeof file_hdr, 1, in_file ) != 1 ) || ( memcmp( file_hdr.magic, UPLINK_LOG_MAGIC, sizeof file_hdr.magic ) != 0 ) )
+    {
+        printf( "ERROR: %s is not an uplink log file\n", in_fname );
+        fclose( in_file );
+        return EXIT_FAILURE;
+    }
+    if( ( file_hdr.version != UPLINK_LOG_VERSION ) || ( file_hdr.endian != UPLINK_LOG_ENDIAN ) )
+    {
+        printf( "ERROR: unsupported uplink log version %u or byte order 0x%08X\n", file_hdr.version, file_hdr.endian );
+        fclose( in_file );
+        return EXIT_FAILURE;
+    }
+
+    if( out_fname != NULL )
+    {
+        out_file = fopen( out_fname, "w" );
+        if( out_file == NULL )
+        {
+            printf( "ERROR: impossible to create CSV file %s\n", out_fname );
+            fclose( in_file );
+            return EXIT_FAILURE;
+        }
+    }
+    setvbuf( out_file, out_buf, _IOFBF, sizeof out_buf );
+
+    fputs( UPLINK_LOG_CSV_HEADER, out_file );
+    while( fread( &hdr, sizeof hdr, 1, in_file ) == 1 )
+    {
+        if( ( hdr.size > DATAGRAM_SIZE_MAX ) || ( fread( buf, 1, hdr.size, in_file ) != hdr.size ) )
+        {
+            fprintf( stderr, "WARNING: record %lu truncated, end of the conversion\n", nb_record );
+            break;
+        }
+        buf[hdr.size] = '\0'; /* the JSON object is parsed as a string */
+        nb_record += 1;
+
+        if( hdr.type == UPLINK_LOG_PUSH_DATA )
+        {
+            uplink_log_csv( out_file, buf );
+        }
+        else if( hdr.type == UPLINK_LOG_PUSH_DATA_BIN )
+        {
+            uplink_log_csv_bin( out_file, buf, hdr.size );
+        }
+        else
+        {
+            nb_skipped += 1;
+        }
+    }
+
+    fclose( in_file );
+    if( out_file != stdout )
+    {
+        fclose( out_file );
+    }
+    else
+    {
+        fflush( out_file );
+    }
+    fprintf( stderr, "INFO: %lu datagrams converted, %lu of unknown type skipped\n", nb_record - nb_skipped, nb_skipped );
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -10,7 +10,7 @@
 #   (C)2020 Semtech
 #
 # Description:
-#    Spectral Scan CSV result file plot - v0.3.0
+#    Spectral Scan CSV or sweep binary result file plot - v0.4.0
 #
 # License: Revised BSD License, see LICENSE.TXT file include in the project
 
@@ -19,6 +19,7 @@ import pylab as pl
 import numpy as np
 import csv
 import sys
+import struct
 
 #Read argument
 if len(sys.argv) >= 2:
@@ -27,22 +28,47 @@ else:
     print ("Usage: %s <filename>" %sys.argv[0])
     sys.exit()
 
+SWEEP_MAGIC = b'SSCN'
+
 #Initiate array
 rssi = []
 freq = []
 
-#Process .csv file
-with open(filename, 'r') as csvfile:
-    reader = csv.reader(csvfile, delimiter=',', quotechar='|')
-    for row in reader:
-        f=int(row[0])//1000 #frequency
-        freq.append(f)
-        rssi_line=[]
-        rssi_val=[]
-        for k in range(1,(len(row)-1)//2):
-            rssi_line.append(int(row[k*2]))
-            rssi_val.append(int(row[k*2-1]))
-        rssi.append(rssi_line)
+#Process .bin sweep file: header, index of the channels, one record per scanned channel
+def read_sweep(f):
+    magic, version, nb_levels, nb_scan, nb_chan = struct.unpack('<4sBBHI', f.read(12))
+    if magic != SWEEP_MAGIC or version != 1:
+        print ("Unsupported sweep file %s" %filename)
+        sys.exit()
+    levels = struct.unpack('<%dh' %nb_levels, f.read(2*nb_levels))
+    index = [struct.unpack('<II', f.read(8)) for i in range(nb_chan)]
+    for (fr, offset) in index:
+        if offset == 0xFFFFFFFF: #channel not scanned
+            continue
+        f.seek(offset)
+        results = struct.unpack('<%dH' %nb_levels, f.read(2*nb_levels))
+        freq.append(fr//1000)
+        rssi.append(list(results[0:nb_levels-1]))
+    return list(levels[0:nb_levels-1])
+
+#Process the result file, sweep binary or .csv
+with open(filename, 'rb') as f:
+    is_sweep = (f.read(4) == SWEEP_MAGIC)
+if is_sweep:
+    with open(filename, 'rb') as f:
+        rssi_val = read_sweep(f)
+else:
+    with open(filename, 'r') as csvfile:
+        reader = csv.reader(csvfile, delimiter=',', quotechar='|')
+        for row in reader:
+            f=int(row[0])//1000 #frequency
+            freq.append(f)
+            rssi_line=[]
+            rssi_val=[]
+            for k in range(1,(len(row)-1)//2):
+                rssi_line.append(int(row[k*2]))
+                rssi_val.append(int(row[k*2-1]))
+            rssi.append(rssi_line)
 
 #Set x to frequency axis and y to signal level axis
 A = np.array(rssi).T
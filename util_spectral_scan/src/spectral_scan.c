@@ -25,6 +25,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>   /* PRIx64, PRIu64... */
@@ -33,6 +34,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <math.h>
 #include <signal.h>     /* sigaction */
 #include <getopt.h>     /* getopt_long */
+#include <sys/time.h>   /* gettimeofday */
 
 #include "loragw_hal.h"
 #include "loragw_aux.h"
@@ -56,6 +58,19 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define DEFAULT_LOG_NAME    "rssi_histogram"
 
+#define SCAN_POINT_NS       8200    /* time between 2 scan points of the SX1261 */
+#define SCAN_SETUP_US       2000    /* time for the SX1261 to start a scan on a new frequency */
+#define SCAN_POLL_US        500     /* time between status reads once a scan is expected to be completed */
+#define SCAN_TIMEOUT_MS     2000
+
+/* sweep binary file: header, index of the channels, then one record per scanned channel */
+#define SWEEP_MAGIC         "SSCN"
+#define SWEEP_VERSION       1
+#define SWEEP_HEADER_SIZE   (12 + (2 * LGW_SPECTRAL_SCAN_RESULT_SIZE))
+#define SWEEP_INDEX_SIZE    8
+#define SWEEP_RECORD_SIZE   (2 * LGW_SPECTRAL_SCAN_RESULT_SIZE)
+#define SWEEP_NO_RECORD     0xFFFFFFFF
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
@@ -77,6 +92,164 @@ void usage(void) {
     printf(" -s <uint>  Number of scan points per frequency step [1..65535]\n");
     printf(" -o <int>   RSSI Offset of the sx1261 path, in dB [-127..128]\n");
     printf(" -l <char>  Log file name\n");
+    printf(" -w         Sweep mode, retune while logging the previous channel, binary log file\n");
+}
+
+static void put_le16(uint8_t * buf, uint16_t val) {
+    buf[0] = (uint8_t)(val >> 0);
+    buf[1] = (uint8_t)(val >> 8);
+}
+
+static void put_le32(uint8_t * buf, uint32_t val) {
+    buf[0] = (uint8_t)(val >> 0);
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+static double elapsed_s(const struct timeval * start) {
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (double)(now.tv_sec - start->tv_sec) + ((double)(now.tv_usec - start->tv_usec) / 1E6);
+}
+
+/* wait for the expected scan duration, then poll the status until the scan is over */
+static int scan_wait(uint32_t scan_us, lgw_spectral_scan_status_t * status) {
+    struct timeval tm_start;
+
+    timeout_start(&tm_start);
+    wait_us(scan_us);
+    do {
+        *status = LGW_SPECTRAL_SCAN_STATUS_UNKNOWN;
+        if (lgw_spectral_scan_get_status(status) != 0) {
+            printf("ERROR: spectral scan status failed\n");
+            return -1;
+        }
+        if (*status != LGW_SPECTRAL_SCAN_STATUS_ON_GOING) {
+            return 0;
+        }
+        wait_us(SCAN_POLL_US);
+    } while (timeout_check(tm_start, SCAN_TIMEOUT_MS) == 0);
+
+    printf("ERROR: %s: TIMEOUT on Spectral Scan\n", __FUNCTION__);
+    return -1;
+}
+
+/* write the header and the index of a sweep file, at its beginning */
+static int sweep_write_index(FILE * file, uint16_t nb_scan, const int16_t * levels, uint32_t nb_channels, const uint32_t * freq, const uint32_t * offset) {
+    uint8_t buff[SWEEP_HEADER_SIZE];
+    uint32_t j;
+    int i;
+
+    memcpy(buff, SWEEP_MAGIC, 4);
+    buff[4] = SWEEP_VERSION;
+    buff[5] = LGW_SPECTRAL_SCAN_RESULT_SIZE;
+    put_le16(buff + 6, nb_scan);
+    put_le32(buff + 8, nb_channels);
+    for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
+        put_le16(buff + 12 + (2 * i), (uint16_t)levels[i]);
+    }
+    if ((fseek(file, 0, SEEK_SET) != 0) || (fwrite(buff, SWEEP_HEADER_SIZE, 1, file) != 1)) {
+        return -1;
+    }
+    for (j = 0; j < nb_channels; j++) {
+        put_le32(buff, freq[j]);
+        put_le32(buff + 4, offset[j]);
+        if (fwrite(buff, SWEEP_INDEX_SIZE, 1, file) != 1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* scan the channels back to back: once a scan is completed and its results read,
+   the next channel is tuned and scanned while the results are logged */
+static int sweep(FILE * file, uint32_t freq_start, uint8_t nb_channels, uint16_t nb_scan) {
+    int i, j, x;
+    uint32_t freq[256];
+    uint32_t offset[256];
+    int16_t levels[LGW_SPECTRAL_SCAN_RESULT_SIZE] = {0};
+    uint16_t results[LGW_SPECTRAL_SCAN_RESULT_SIZE];
+    uint8_t record[SWEEP_RECORD_SIZE];
+    uint32_t scan_us = ((uint32_t)nb_scan * SCAN_POINT_NS / 1000) + SCAN_SETUP_US;
+    bool started = false;
+    bool completed;
+    lgw_spectral_scan_status_t status;
+    long pos;
+
+    for (j = 0; j < nb_channels; j++) {
+        freq[j] = freq_start + (j * 200000); /* 200kHz channels */
+        offset[j] = SWEEP_NO_RECORD;
+    }
+    if (sweep_write_index(file, nb_scan, levels, nb_channels, freq, offset) != 0) {
+        printf("ERROR: failed to write sweep file index\n");
+        return -1;
+    }
+
+    for (j = 0; j < nb_channels; j++) {
+        if (started == false) {
+            if (lgw_spectral_scan_start(freq[j], nb_scan) != 0) {
+                printf("ERROR: spectral scan start failed\n");
+                continue;
+            }
+        }
+
+        /* get results, they are overwritten by the next scan */
+        completed = false;
+        x = scan_wait(scan_us, &status);
+        if (x != 0) {
+            lgw_spectral_scan_abort();
+        } else if (status == LGW_SPECTRAL_SCAN_STATUS_COMPLETED) {
+            if (lgw_spectral_scan_get_results(levels, results) == 0) {
+                completed = true;
+            } else {
+                printf("ERROR: spectral scan get results failed\n");
+            }
+        } else if (status == LGW_SPECTRAL_SCAN_STATUS_ABORTED) {
+            printf("INFO: spectral scan has been aborted\n");
+        } else {
+            printf("ERROR: spectral scan status us unexpected 0x%02X\n", status);
+        }
+
+        /* start next channel right away */
+        started = false;
+        if ((j + 1) < nb_channels) {
+            if (lgw_spectral_scan_start(freq[j + 1], nb_scan) == 0) {
+                started = true;
+            } else {
+                printf("ERROR: spectral scan start failed, retrying\n");
+            }
+        }
+
+        /* log results while the next channel is scanned */
+        if (completed == true) {
+            for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
+                put_le16(record + (2 * i), results[i]);
+            }
+            pos = ftell(file);
+            if ((pos < 0) || (fwrite(record, SWEEP_RECORD_SIZE, 1, file) != 1)) {
+                printf("ERROR: failed to write sweep file record\n");
+                return -1;
+            }
+            offset[j] = (uint32_t)pos;
+
+            printf("%u: ", freq[j]);
+            for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
+                printf("%u ", results[i]);
+            }
+            printf("\n");
+        }
+    }
+
+    /* index of the records actually written */
+    if (sweep_write_index(file, nb_scan, levels, nb_channels, freq, offset) != 0) {
+        printf("ERROR: failed to write sweep file index\n");
+        return -1;
+    }
+
+    return 0;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -112,7 +285,9 @@ int main(int argc, char **argv)
     FILE * log_file = NULL;
 
     struct timeval tm_start;
+    struct timeval tm_sweep;
     lgw_spectral_scan_status_t status;
+    bool sweep_mode = false;
 
     /* Parameter parsing */
     int option_index = 0;
@@ -121,7 +296,7 @@ int main(int argc, char **argv)
     };
 
     /* parse command line options */
-    while ((i = getopt_long (argc, argv, "hud:f:n:o:s:l:D:", long_options, &option_index)) != -1) {
+    while ((i = getopt_long (argc, argv, "hud:f:n:o:s:l:D:w", long_options, &option_index)) != -1) {
         switch (i) {
             case 'h':
                 usage();
@@ -202,6 +377,10 @@ int main(int argc, char **argv)
                 }
                 break;
 
+            case 'w':
+                sweep_mode = true;
+                break;
+
             default:
                 printf("ERROR: argument parsing\n");
                 usage();
@@ -276,73 +455,83 @@ int main(int argc, char **argv)
     }
 
     /* create log file */
-    strcat(log_file_name,".csv");
-    log_file = fopen(log_file_name, "w");
+    strcat(log_file_name, (sweep_mode == true) ? ".bin" : ".csv");
+    log_file = fopen(log_file_name, (sweep_mode == true) ? "wb" : "w");
     if (log_file == NULL) {
         printf("ERROR: impossible to create log file %s\n", log_file_name);
         return EXIT_FAILURE;
     }
 
+    gettimeofday(&tm_sweep, NULL);
+
     /* Launch Spectral Scan on each channels */
-    for (j = 0; j < nb_channels; j++) {
-        x = lgw_spectral_scan_start(freq_hz, nb_scan);
-        if (x != 0) {
-            printf("ERROR: spectral scan start failed\n");
-            continue;
+    if (sweep_mode == true) {
+        if (sweep(log_file, freq_hz, nb_channels, nb_scan) != 0) {
+            printf("ERROR: sweep failed\n");
         }
-
-        /* Wait for scan to be completed */
-        timeout_start(&tm_start);
-        do {
-            /* handle timeout */
-            if (timeout_check(tm_start, 2000) != 0) {
-                printf("ERROR: %s: TIMEOUT on Spectral Scan\n", __FUNCTION__);
+    } else {
+        for (j = 0; j < nb_channels; j++) {
+            x = lgw_spectral_scan_start(freq_hz, nb_scan);
+            if (x != 0) {
+                printf("ERROR: spectral scan start failed\n");
                 continue;
             }
 
-            /* get spectral scan status */
-            status = LGW_SPECTRAL_SCAN_STATUS_UNKNOWN;
-            x = lgw_spectral_scan_get_status(&status);
-            if (x != 0) {
-                printf("ERROR: spectral scan status failed\n");
-                break;
-            }
+            /* Wait for scan to be completed */
+            timeout_start(&tm_start);
+            do {
+                /* handle timeout */
+                if (timeout_check(tm_start, 2000) != 0) {
+                    printf("ERROR: %s: TIMEOUT on Spectral Scan\n", __FUNCTION__);
+                    continue;
+                }
 
-            wait_ms(10);
-        } while (status != LGW_SPECTRAL_SCAN_STATUS_COMPLETED && status != LGW_SPECTRAL_SCAN_STATUS_ABORTED);
+                /* get spectral scan status */
+                status = LGW_SPECTRAL_SCAN_STATUS_UNKNOWN;
+                x = lgw_spectral_scan_get_status(&status);
+                if (x != 0) {
+                    printf("ERROR: spectral scan status failed\n");
+                    break;
+                }
 
-        if (status == LGW_SPECTRAL_SCAN_STATUS_COMPLETED) {
-            memset(levels, 0, sizeof levels);
-            memset(results, 0, sizeof results);
-            x = lgw_spectral_scan_get_results(levels, results);
-            if (x != 0) {
-                printf("ERROR: spectral scan get results failed\n");
-                continue;
-            }
+                wait_ms(10);
+            } while (status != LGW_SPECTRAL_SCAN_STATUS_COMPLETED && status != LGW_SPECTRAL_SCAN_STATUS_ABORTED);
 
-            /* log results */
-            fprintf(log_file, "%u", freq_hz);
-            for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
-                fprintf(log_file, ",%d,%u", levels[i], results[i]);
-            }
-            fprintf(log_file, "\n");
+            if (status == LGW_SPECTRAL_SCAN_STATUS_COMPLETED) {
+                memset(levels, 0, sizeof levels);
+                memset(results, 0, sizeof results);
+                x = lgw_spectral_scan_get_results(levels, results);
+                if (x != 0) {
+                    printf("ERROR: spectral scan get results failed\n");
+                    continue;
+                }
 
-            /* print results */
-            printf("%u: ", freq_hz);
-            for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
-                printf("%u ", results[i]);
-            }
-            printf("\n");
+                /* log results */
+                fprintf(log_file, "%u", freq_hz);
+                for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
+                    fprintf(log_file, ",%d,%u", levels[i], results[i]);
+                }
+                fprintf(log_file, "\n");
 
-            /* Next frequency to scan */
-            freq_hz += 200000; /* 200kHz channels */
-        } else if (status == LGW_SPECTRAL_SCAN_STATUS_ABORTED) {
-            printf("INFO: spectral scan has been aborted\n");
-        } else {
-            printf("ERROR: spectral scan status us unexpected 0x%02X\n", status);
+                /* print results */
+                printf("%u: ", freq_hz);
+                for (i = 0; i < LGW_SPECTRAL_SCAN_RESULT_SIZE; i++) {
+                    printf("%u ", results[i]);
+                }
+                printf("\n");
+
+                /* Next frequency to scan */
+                freq_hz += 200000; /* 200kHz channels */
+            } else if (status == LGW_SPECTRAL_SCAN_STATUS_ABORTED) {
+                printf("INFO: spectral scan has been aborted\n");
+            } else {
+                printf("ERROR: spectral scan status us unexpected 0x%02X\n", status);
+            }
         }
     }
 
+    printf("INFO: scan duration %.3f s\n", elapsed_s(&tm_sweep));
+
     /* close log file */
     fclose(log_file);
 